@@ -183,6 +183,7 @@
         'file_version_info_unittest.cc',
         'gmock_unittest.cc',
         'id_map_unittest.cc',
+        'incoming_task_queue_unittest.cc',
         'i18n/break_iterator_unittest.cc',
         'i18n/char_iterator_unittest.cc',
         'i18n/case_conversion_unittest.cc',
@@ -220,6 +221,7 @@
         'message_loop_proxy_impl_unittest.cc',
         'message_loop_proxy_unittest.cc',
         'message_loop_unittest.cc',
+        'message_pump_epoll_unittest.cc',
         'message_pump_glib_unittest.cc',
         'message_pump_libevent_unittest.cc',
         'metrics/field_trial_unittest.cc',
@@ -275,6 +277,7 @@
         'time_unittest.cc',
         'time_win_unittest.cc',
         'timer_unittest.cc',
+        'timer_wheel_unittest.cc',
         'tools_sanity_unittest.cc',
         'tracked_objects_unittest.cc',
         'tuple_unittest.cc',
@@ -389,6 +392,11 @@
             'win/win_util_unittest.cc',
           ],
         }],
+        ['OS != "linux"', {
+          'sources!': [
+            'message_pump_epoll_unittest.cc',
+          ],
+        }],
         ['OS=="mac"', {
           'dependencies': [
             'closure_blocks_leopard_compat',
@@ -545,6 +553,34 @@
         },
       ],
     },
+    {
+      'target_name': 'base_perftests',
+      'type': 'executable',
+      'dependencies': [
+        'base',
+        'test_support_base',
+        'test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'sources': [
+        'debug/trace_event_perftest.cc',
+        'incoming_task_queue_perftest.cc',
+        'json/json_reader_perftest.cc',
+        'message_pump_epoll_perftest.cc',
+        'metrics/histogram_perftest.cc',
+        'threading/sequenced_worker_pool_perftest.cc',
+        'timer_perftest.cc',
+        'tracked_objects_perftest.cc',
+        'values_perftest.cc',
+      ],
+      'conditions': [
+        ['OS != "linux"', {
+          'sources!': [
+            'message_pump_epoll_perftest.cc',
+          ],
+        }],
+      ],
+    },
     {
       'target_name': 'test_support_perf',
       'type': 'static_library',
@@ -17,6 +17,7 @@
 #include "base/string_tokenizer.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/thread_local.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/utf_string_conversions.h"
 #include "base/stl_util.h"
 #include "base/sys_info.h"
@@ -43,6 +44,10 @@ namespace debug {
 const size_t kTraceEventBufferSize = 500000;
 const size_t kTraceEventBatchSize = 1000;
 
+// Number of events a thread records before handing its chunk over to the
+// shared buffer in the RECORD_PER_THREAD and RECORD_CONTINUOUSLY modes.
+const size_t kTraceEventsPerChunk = 64;
+
 #define TRACE_EVENT_MAX_CATEGORIES 100
 
 namespace {
@@ -68,6 +73,14 @@ int g_category_index = 3; // skip initial 3 categories
 LazyInstance<ThreadLocalPointer<const char> >::Leaky
     g_current_thread_name = LAZY_INSTANCE_INITIALIZER;
 
+// The current thread's ThreadLocalEventBuffer. A slot with a destructor, so
+// that a thread's last chunk is not lost when it exits.
+ThreadLocalStorage::StaticSlot g_thread_event_buffer = TLS_INITIALIZER;
+
+// Event ids handed out by AddEventToThreadBuffer() encode the chunk's
+// sequence number and the event's index within the chunk.
+const int kMaxChunkSeq = kint32max / kTraceEventsPerChunk;
+
 void AppendValueAsJSON(unsigned char type,
                        TraceEvent::TraceValue value,
                        std::string* out) {
@@ -310,6 +323,118 @@ void TraceResultBuffer::Finish() {
   output_callback_.Run("]");
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceBufferChunk
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// A fixed-size block of events recorded by one thread.
+class TraceBufferChunk {
+ public:
+  TraceBufferChunk() : size_(0), seq_(0) {}
+
+  bool IsFull() const { return size_ == kTraceEventsPerChunk; }
+  size_t size() const { return size_; }
+
+  int seq() const { return seq_; }
+  void set_seq(int seq) { seq_ = seq; }
+
+  // Returns the index of the new event.
+  size_t AddEvent(const TraceEvent& event) {
+    DCHECK(!IsFull());
+    events_[size_] = event;
+    return size_++;
+  }
+
+  const TraceEvent& GetEventAt(size_t index) const {
+    DCHECK_LT(index, size_);
+    return events_[index];
+  }
+
+  void RemoveEventAt(size_t index) {
+    DCHECK_LT(index, size_);
+    for (size_t i = index + 1; i < size_; ++i)
+      events_[i - 1] = events_[i];
+    events_[--size_] = TraceEvent();
+  }
+
+  void AppendEventsTo(std::vector<TraceEvent>* events) const {
+    events->insert(events->end(), events_, events_ + size_);
+  }
+
+  // Releases any copied parameters so the chunk can be reused.
+  void Clear() {
+    for (size_t i = 0; i < size_; ++i)
+      events_[i] = TraceEvent();
+    size_ = 0;
+  }
+
+ private:
+  TraceEvent events_[kTraceEventsPerChunk];
+  size_t size_;
+  int seq_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBufferChunk);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// ThreadLocalEventBuffer
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// The chunk a thread is currently recording into. |lock_| is uncontended
+// except while the TraceLog is collecting chunks, so taking it costs far less
+// than taking the TraceLog's lock on every event. A buffer is referenced from
+// its thread's TLS slot and from TraceLog::thread_event_buffers_.
+class ThreadLocalEventBuffer
+    : public RefCountedThreadSafe<ThreadLocalEventBuffer> {
+ public:
+  explicit ThreadLocalEventBuffer(TraceLog* trace_log)
+      : trace_log_(trace_log),
+        next_chunk_seq_(0) {
+  }
+
+  Lock& lock() { return lock_; }
+
+  // The TraceLog this buffer belongs to, or NULL once that TraceLog has been
+  // deleted or the thread has exited. Only changed by ~TraceLog and by
+  // TraceLog::OnThreadExit(), so the owning thread may read it without |lock_|.
+  TraceLog* trace_log() const { return trace_log_; }
+  void Detach() {
+    lock_.AssertAcquired();
+    trace_log_ = NULL;
+  }
+
+  TraceBufferChunk* chunk() {
+    lock_.AssertAcquired();
+    return chunk_.get();
+  }
+  void SetChunk(TraceBufferChunk* chunk) {
+    lock_.AssertAcquired();
+    DCHECK(!chunk_.get());
+    chunk->set_seq(next_chunk_seq_);
+    next_chunk_seq_ = (next_chunk_seq_ + 1) % kMaxChunkSeq;
+    chunk_.reset(chunk);
+  }
+  TraceBufferChunk* ReleaseChunk() {
+    lock_.AssertAcquired();
+    return chunk_.release();
+  }
+
+ private:
+  friend class RefCountedThreadSafe<ThreadLocalEventBuffer>;
+  ~ThreadLocalEventBuffer() {}
+
+  Lock lock_;
+  TraceLog* trace_log_;
+  scoped_ptr<TraceBufferChunk> chunk_;
+  int next_chunk_seq_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadLocalEventBuffer);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // TraceLog
@@ -323,6 +448,9 @@ TraceLog* TraceLog::GetInstance() {
 
 TraceLog::TraceLog()
     : enabled_(false)
+    , record_mode_(RECORD_UNTIL_FULL)
+    , max_chunks_(kTraceEventBufferSize / kTraceEventsPerChunk)
+    , num_live_chunks_(0)
     , dispatching_to_observer_list_(false) {
   // Trace is enabled or disabled on one thread while other threads are
   // accessing the enabled flag. We don't care whether edge-case events are
@@ -340,9 +468,21 @@ TraceLog::TraceLog()
 #else
   SetProcessID(static_cast<int>(base::GetCurrentProcId()));
 #endif
+  // The slot outlives the TraceLog, which may be deleted and resurrected.
+  if (!g_thread_event_buffer.initialized())
+    g_thread_event_buffer.Initialize(&TraceLog::OnThreadExit);
 }
 
 TraceLog::~TraceLog() {
+  // Threads still referencing their buffers will notice that they have been
+  // detached and create new ones for the next TraceLog.
+  for (size_t i = 0; i < thread_event_buffers_.size(); ++i) {
+    ThreadLocalEventBuffer* buffer = thread_event_buffers_[i];
+    AutoLock lock(buffer->lock());
+    buffer->Detach();
+    delete buffer->ReleaseChunk();
+  }
+  STLDeleteElements(&chunks_);
 }
 
 const unsigned char* TraceLog::GetCategoryEnabled(const char* name) {
@@ -448,6 +588,9 @@ void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
   dispatching_to_observer_list_ = false;
 
   logged_events_.reserve(1024);
+  // Drop chunks handed over by threads that exited after the last flush.
+  num_live_chunks_ -= chunks_.size();
+  STLDeleteElements(&chunks_);
   enabled_ = true;
   included_categories_ = included_categories;
   excluded_categories_ = excluded_categories;
@@ -525,6 +668,18 @@ void TraceLog::SetEnabled(bool enabled) {
     SetDisabled();
 }
 
+void TraceLog::SetRecordMode(RecordMode mode, size_t buffer_size_in_bytes) {
+  AutoLock lock(lock_);
+  DCHECK(!enabled_) << "Cannot change the record mode while tracing";
+  if (enabled_)
+    return;
+  record_mode_ = mode;
+  if (buffer_size_in_bytes == 0)
+    buffer_size_in_bytes = kTraceEventBufferSize * sizeof(TraceEvent);
+  max_chunks_ = std::max<size_t>(
+      1, buffer_size_in_bytes / sizeof(TraceBufferChunk));
+}
+
 void TraceLog::AddEnabledStateObserver(EnabledStateChangedObserver* listener) {
   enabled_state_observer_list_.AddObserver(listener);
 }
@@ -535,6 +690,10 @@ void TraceLog::RemoveEnabledStateObserver(
 }
 
 float TraceLog::GetBufferPercentFull() const {
+  if (record_mode_ != RECORD_UNTIL_FULL) {
+    return (float)std::min(
+        1.0, (double)num_live_chunks_ / (double)max_chunks_);
+  }
   return (float)((double)logged_events_.size()/(double)kTraceEventBufferSize);
 }
 
@@ -550,13 +709,40 @@ void TraceLog::SetBufferFullCallback(const TraceLog::BufferFullCallback& cb) {
 
 void TraceLog::Flush() {
   std::vector<TraceEvent> previous_logged_events;
+  std::deque<TraceBufferChunk*> previous_chunks;
+  std::vector<scoped_refptr<ThreadLocalEventBuffer> > thread_event_buffers;
   OutputCallback output_callback_copy;
   {
     AutoLock lock(lock_);
     previous_logged_events.swap(logged_events_);
+    previous_chunks.swap(chunks_);
+    num_live_chunks_ -= previous_chunks.size();
+    thread_event_buffers = thread_event_buffers_;
     output_callback_copy = output_callback_;
   }  // release lock
 
+  // Take the chunks that threads are still filling. The threads get a new
+  // chunk with their next event.
+  for (size_t i = 0; i < thread_event_buffers.size(); ++i) {
+    ThreadLocalEventBuffer* buffer = thread_event_buffers[i];
+    TraceBufferChunk* chunk = NULL;
+    {
+      AutoLock buffer_lock(buffer->lock());
+      chunk = buffer->ReleaseChunk();
+    }
+    if (chunk) {
+      AutoLock lock(lock_);
+      --num_live_chunks_;
+      previous_chunks.push_back(chunk);
+    }
+  }
+
+  for (size_t i = 0; i < previous_chunks.size(); ++i) {
+    if (!output_callback_copy.is_null())
+      previous_chunks[i]->AppendEventsTo(&previous_logged_events);
+    delete previous_chunks[i];
+  }
+
   if (output_callback_copy.is_null())
     return;
 
@@ -586,6 +772,25 @@ int TraceLog::AddTraceEvent(char phase,
                             unsigned char flags) {
   DCHECK(name);
   TimeTicks now = TimeTicks::HighResNow();
+
+  if (record_mode_ != RECORD_UNTIL_FULL) {
+    if (!*category_enabled)
+      return -1;
+    int thread_id = static_cast<int>(PlatformThread::CurrentId());
+    if (PlatformThread::GetName() != g_current_thread_name.Get().Get()) {
+      AutoLock lock(lock_);
+      UpdateCurrentThreadNameLocked(thread_id);
+    }
+    if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
+      id ^= process_id_hash_;
+    return AddEventToThreadBuffer(
+        TraceEvent(thread_id,
+                   now, phase, category_enabled, name, id,
+                   num_args, arg_names, arg_types, arg_values,
+                   flags),
+        threshold_begin_id, threshold);
+  }
+
   BufferFullCallback buffer_full_callback_copy;
   int ret_begin_id = -1;
   {
@@ -596,34 +801,7 @@ int TraceLog::AddTraceEvent(char phase,
       return -1;
 
     int thread_id = static_cast<int>(PlatformThread::CurrentId());
-
-    const char* new_name = PlatformThread::GetName();
-    // Check if the thread name has been set or changed since the previous
-    // call (if any), but don't bother if the new name is empty. Note this will
-    // not detect a thread name change within the same char* buffer address: we
-    // favor common case performance over corner case correctness.
-    if (new_name != g_current_thread_name.Get().Get() &&
-        new_name && *new_name) {
-      g_current_thread_name.Get().Set(new_name);
-      base::hash_map<int, std::string>::iterator existing_name =
-          thread_names_.find(thread_id);
-      if (existing_name == thread_names_.end()) {
-        // This is a new thread id, and a new name.
-        thread_names_[thread_id] = new_name;
-      } else {
-        // This is a thread id that we've seen before, but potentially with a
-        // new name.
-        std::vector<base::StringPiece> existing_names;
-        Tokenize(existing_name->second, ",", &existing_names);
-        bool found = std::find(existing_names.begin(),
-                               existing_names.end(),
-                               new_name) != existing_names.end();
-        if (!found) {
-          existing_name->second.push_back(',');
-          existing_name->second.append(new_name);
-        }
-      }
-    }
+    UpdateCurrentThreadNameLocked(thread_id);
 
     if (threshold_begin_id > -1) {
       DCHECK(phase == TRACE_EVENT_PHASE_END);
@@ -663,6 +841,121 @@ int TraceLog::AddTraceEvent(char phase,
   return ret_begin_id;
 }
 
+int TraceLog::AddEventToThreadBuffer(const TraceEvent& event,
+                                     int threshold_begin_id,
+                                     long long threshold) {
+  ThreadLocalEventBuffer* buffer = GetThreadEventBuffer();
+  BufferFullCallback buffer_full_callback_copy;
+  int ret_begin_id = -1;
+  {
+    AutoLock buffer_lock(buffer->lock());
+    TraceBufferChunk* chunk = buffer->chunk();
+
+    if (threshold_begin_id > -1) {
+      DCHECK(event.phase() == TRACE_EVENT_PHASE_END);
+      // The begin event can only be dropped while it is still in this
+      // thread's chunk. Otherwise the pair is kept.
+      size_t begin_i =
+          static_cast<size_t>(threshold_begin_id) % kTraceEventsPerChunk;
+      if (chunk &&
+          chunk->seq() == threshold_begin_id /
+              static_cast<int>(kTraceEventsPerChunk) &&
+          begin_i < chunk->size()) {
+        TimeDelta elapsed =
+            event.timestamp() - chunk->GetEventAt(begin_i).timestamp();
+        if (elapsed < TimeDelta::FromMicroseconds(threshold)) {
+          chunk->RemoveEventAt(begin_i);
+          return -1;
+        }
+      }
+    }
+
+    if (!chunk || chunk->IsFull()) {
+      // Taking |lock_| while holding a buffer's lock is the only permitted
+      // nesting of the two.
+      AutoLock lock(lock_);
+      chunk = ExchangeChunkLocked(buffer->ReleaseChunk(),
+                                  &buffer_full_callback_copy);
+      if (chunk)
+        buffer->SetChunk(chunk);
+    }
+
+    if (chunk) {
+      ret_begin_id = chunk->seq() * static_cast<int>(kTraceEventsPerChunk) +
+          static_cast<int>(chunk->AddEvent(event));
+    }
+  }  // release lock
+
+  if (!buffer_full_callback_copy.is_null())
+    buffer_full_callback_copy.Run();
+
+  return ret_begin_id;
+}
+
+ThreadLocalEventBuffer* TraceLog::GetThreadEventBuffer() {
+  ThreadLocalEventBuffer* buffer =
+      static_cast<ThreadLocalEventBuffer*>(g_thread_event_buffer.Get());
+  if (buffer && buffer->trace_log() == this)
+    return buffer;
+
+  // Either this is the thread's first chunked event or its buffer belonged to
+  // a TraceLog that has since been deleted.
+  if (buffer)
+    buffer->Release();
+  buffer = new ThreadLocalEventBuffer(this);
+  buffer->AddRef();  // Released by OnThreadExit().
+  g_thread_event_buffer.Set(buffer);
+
+  AutoLock lock(lock_);
+  thread_event_buffers_.push_back(buffer);
+  return buffer;
+}
+
+TraceBufferChunk* TraceLog::ExchangeChunkLocked(
+    TraceBufferChunk* full_chunk,
+    BufferFullCallback* buffer_full_callback) {
+  lock_.AssertAcquired();
+  if (full_chunk)
+    chunks_.push_back(full_chunk);
+
+  if (record_mode_ == RECORD_CONTINUOUSLY) {
+    if (num_live_chunks_ >= max_chunks_ && !chunks_.empty()) {
+      // Overwrite the oldest events.
+      TraceBufferChunk* chunk = chunks_.front();
+      chunks_.pop_front();
+      chunk->Clear();
+      return chunk;
+    }
+  } else {
+    if (num_live_chunks_ >= max_chunks_)
+      return NULL;
+    if (num_live_chunks_ + 1 == max_chunks_)
+      *buffer_full_callback = buffer_full_callback_;
+  }
+  ++num_live_chunks_;
+  return new TraceBufferChunk;
+}
+
+// static
+void TraceLog::OnThreadExit(void* value) {
+  ThreadLocalEventBuffer* buffer = static_cast<ThreadLocalEventBuffer*>(value);
+  {
+    AutoLock buffer_lock(buffer->lock());
+    TraceLog* trace_log = buffer->trace_log();
+    if (trace_log) {
+      AutoLock lock(trace_log->lock_);
+      TraceBufferChunk* chunk = buffer->ReleaseChunk();
+      if (chunk)
+        trace_log->chunks_.push_back(chunk);
+      std::vector<scoped_refptr<ThreadLocalEventBuffer> >& buffers =
+          trace_log->thread_event_buffers_;
+      buffers.erase(std::find(buffers.begin(), buffers.end(), buffer));
+      buffer->Detach();
+    }
+  }
+  buffer->Release();
+}
+
 void TraceLog::AddTraceEventEtw(char phase,
                                 const char* name,
                                 const void* id,
@@ -725,6 +1018,37 @@ void TraceLog::AddClockSyncMetadataEvents() {
 #endif
 }
 
+void TraceLog::UpdateCurrentThreadNameLocked(int thread_id) {
+  lock_.AssertAcquired();
+  const char* new_name = PlatformThread::GetName();
+  // Check if the thread name has been set or changed since the previous
+  // call (if any), but don't bother if the new name is empty. Note this will
+  // not detect a thread name change within the same char* buffer address: we
+  // favor common case performance over corner case correctness.
+  if (new_name != g_current_thread_name.Get().Get() &&
+      new_name && *new_name) {
+    g_current_thread_name.Get().Set(new_name);
+    base::hash_map<int, std::string>::iterator existing_name =
+        thread_names_.find(thread_id);
+    if (existing_name == thread_names_.end()) {
+      // This is a new thread id, and a new name.
+      thread_names_[thread_id] = new_name;
+    } else {
+      // This is a thread id that we've seen before, but potentially with a
+      // new name.
+      std::vector<base::StringPiece> existing_names;
+      Tokenize(existing_name->second, ",", &existing_names);
+      bool found = std::find(existing_names.begin(),
+                             existing_names.end(),
+                             new_name) != existing_names.end();
+      if (!found) {
+        existing_name->second.push_back(',');
+        existing_name->second.append(new_name);
+      }
+    }
+  }
+}
+
 void TraceLog::AddThreadNameMetadataEvents() {
   lock_.AssertAcquired();
   for(base::hash_map<int, std::string>::iterator it = thread_names_.begin();
@@ -9,6 +9,7 @@
 
 #include "build/build_config.h"
 
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -46,6 +47,9 @@ namespace debug {
 
 const int kTraceMaxNumArgs = 2;
 
+class ThreadLocalEventBuffer;
+class TraceBufferChunk;
+
 // Output records are "Events" and can be obtained via the
 // OutputCallback whenever the tracing system decides to flush. This
 // can happen at any time, on any thread, or you can programatically
@@ -83,6 +87,7 @@ class BASE_EXPORT TraceEvent {
   void AppendAsJSON(std::string* out) const;
 
   TimeTicks timestamp() const { return timestamp_; }
+  char phase() const { return phase_; }
 
   // Exposed for unittesting:
 
@@ -155,6 +160,26 @@ class BASE_EXPORT TraceResultBuffer {
 
 class BASE_EXPORT TraceLog {
  public:
+  // How trace events are buffered while tracing is enabled.
+  enum RecordMode {
+    // All threads append to one shared buffer under a lock. Recording stops
+    // when the buffer holds kTraceEventBufferSize events. This is the default.
+    RECORD_UNTIL_FULL,
+
+    // Each thread fills its own fixed-size chunk of events without taking the
+    // shared lock; only a full chunk is handed over to the shared buffer.
+    // Recording stops when the chunks use up the buffer size given to
+    // SetRecordMode(). Partially filled chunks are collected when tracing is
+    // disabled or flushed.
+    RECORD_PER_THREAD,
+
+    // Like RECORD_PER_THREAD, but the shared buffer is a ring: once it is
+    // full, the oldest chunk is recycled for new events. The buffer always
+    // holds the most recent events, so tracing can be left on as a flight
+    // recorder and flushed when something interesting happens.
+    RECORD_CONTINUOUSLY,
+  };
+
   static TraceLog* GetInstance();
 
   // Get set of known categories. This can change as new code paths are reached.
@@ -193,6 +218,15 @@ class BASE_EXPORT TraceLog {
   void SetEnabled(bool enabled);
   bool IsEnabled() { return enabled_; }
 
+  // Selects how events are buffered, starting with the next call to
+  // SetEnabled(). Must not be called while tracing is enabled.
+  // |buffer_size_in_bytes| bounds the memory used for events in the
+  // RECORD_PER_THREAD and RECORD_CONTINUOUSLY modes, excluding copied strings
+  // and the one chunk each recording thread may be filling; 0 selects a buffer
+  // as large as the RECORD_UNTIL_FULL one.
+  void SetRecordMode(RecordMode mode, size_t buffer_size_in_bytes);
+  RecordMode record_mode() const { return record_mode_; }
+
   // Enabled state listeners give a callback when tracing is enabled or
   // disabled. This can be used to tie into other library's tracing systems
   // on-demand.
@@ -225,7 +259,8 @@ class BASE_EXPORT TraceLog {
 
   // The trace buffer does not flush dynamically, so when it fills up,
   // subsequent trace events will be dropped. This callback is generated when
-  // the trace buffer is full. The callback must be thread safe.
+  // the trace buffer is full. The callback must be thread safe. It is never
+  // generated in RECORD_CONTINUOUSLY mode.
   typedef base::Callback<void(void)> BufferFullCallback;
   void SetBufferFullCallback(const BufferFullCallback& cb);
 
@@ -274,7 +309,8 @@ class BASE_EXPORT TraceLog {
   // Allows resurrecting our singleton instance post-AtExit processing.
   static void Resurrect();
 
-  // Allow tests to inspect TraceEvents.
+  // Allow tests to inspect TraceEvents. Only events in the shared buffer of
+  // RECORD_UNTIL_FULL mode are visible here.
   size_t GetEventsSize() const { return logged_events_.size(); }
   const TraceEvent& GetEventAt(size_t index) const {
     DCHECK(index < logged_events_.size());
@@ -294,13 +330,50 @@ class BASE_EXPORT TraceLog {
   void AddThreadNameMetadataEvents();
   void AddClockSyncMetadataEvents();
 
-  // TODO(nduca): switch to per-thread trace buffers to reduce thread
-  // synchronization.
+  // Records the name of the current thread if it changed since the thread's
+  // previous event. |lock_| must be held.
+  void UpdateCurrentThreadNameLocked(int thread_id);
+
+  // Adds |event| to the current thread's chunk in the RECORD_PER_THREAD and
+  // RECORD_CONTINUOUSLY modes. Arguments and return value are as for
+  // AddTraceEvent().
+  int AddEventToThreadBuffer(const TraceEvent& event,
+                             int threshold_begin_id,
+                             long long threshold);
+
+  // Returns the current thread's event buffer, creating it if needed.
+  ThreadLocalEventBuffer* GetThreadEventBuffer();
+
+  // Takes ownership of |full_chunk|, if any, and returns an empty chunk, or
+  // NULL if the buffer is full. Sets |*buffer_full_callback| if handing out
+  // the returned chunk filled the buffer. |lock_| must be held.
+  TraceBufferChunk* ExchangeChunkLocked(
+      TraceBufferChunk* full_chunk,
+      BufferFullCallback* buffer_full_callback);
+
+  // TLS destructor of a thread's ThreadLocalEventBuffer. Hands its partially
+  // filled chunk to the shared buffer.
+  static void OnThreadExit(void* buffer);
+
+  // Protects everything below. In the RECORD_PER_THREAD and
+  // RECORD_CONTINUOUSLY modes it is only taken once per chunk of events.
   Lock lock_;
   bool enabled_;
   OutputCallback output_callback_;
   BufferFullCallback buffer_full_callback_;
   std::vector<TraceEvent> logged_events_;
+
+  RecordMode record_mode_;
+  // Number of chunks the RECORD_PER_THREAD and RECORD_CONTINUOUSLY modes may
+  // keep in |chunks_|.
+  size_t max_chunks_;
+  // Full chunks, oldest first.
+  std::deque<TraceBufferChunk*> chunks_;
+  // Number of chunks in |chunks_| or being filled by a thread.
+  size_t num_live_chunks_;
+  // Buffers of every thread that has recorded into a chunk and not exited.
+  std::vector<scoped_refptr<ThreadLocalEventBuffer> > thread_event_buffers_;
+
   std::vector<std::string> included_categories_;
   std::vector<std::string> excluded_categories_;
   bool dispatching_to_observer_list_;
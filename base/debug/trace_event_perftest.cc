@@ -0,0 +1,91 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event.h"
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+// Small enough for the RECORD_UNTIL_FULL buffer to hold the events of all
+// threads.
+const int kEventsPerThread = 20000;
+
+class TraceEventsThread : public DelegateSimpleThread::Delegate {
+ public:
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kEventsPerThread; ++i) {
+      TRACE_EVENT_INSTANT1("perf", "perf event", "i", i);
+    }
+  }
+};
+
+const char* RecordModeName(TraceLog::RecordMode mode) {
+  switch (mode) {
+    case TraceLog::RECORD_UNTIL_FULL:
+      return "UntilFull";
+    case TraceLog::RECORD_PER_THREAD:
+      return "PerThread";
+    case TraceLog::RECORD_CONTINUOUSLY:
+      return "Continuously";
+  }
+  return "";
+}
+
+// Times |num_threads| threads recording events concurrently. The buffers are
+// large enough that no event is dropped.
+void TimeRecording(TraceLog::RecordMode mode, int num_threads) {
+  TraceLog* trace_log = TraceLog::GetInstance();
+  trace_log->SetRecordMode(
+      mode, num_threads * kEventsPerThread * sizeof(TraceEvent) * 2);
+  trace_log->SetEnabled(true);
+
+  TraceEventsThread delegate;
+  ScopedVector<DelegateSimpleThread> threads;
+  PerfTimer timer;
+  for (int i = 0; i < num_threads; ++i) {
+    DelegateSimpleThread* thread =
+        new DelegateSimpleThread(&delegate, "TracePerf");
+    threads.push_back(thread);
+    thread->Start();
+  }
+  for (int i = 0; i < num_threads; ++i)
+    threads[i]->Join();
+  double events_per_sec =
+      num_threads * kEventsPerThread / timer.Elapsed().InSecondsF();
+
+  // Dropping the events is not part of the measurement.
+  trace_log->SetEnabled(false);
+
+  LogPerfResult(StringPrintf("TraceLog_%s_%dthreads",
+                             RecordModeName(mode), num_threads).c_str(),
+                events_per_sec, "events/s");
+}
+
+}  // namespace
+
+TEST(TraceEventPerfTest, Record) {
+  const TraceLog::RecordMode kModes[] = {
+    TraceLog::RECORD_UNTIL_FULL,
+    TraceLog::RECORD_PER_THREAD,
+    TraceLog::RECORD_CONTINUOUSLY,
+  };
+  const int kThreadCounts[] = { 1, 4, 16 };
+  for (size_t i = 0; i < arraysize(kModes); ++i) {
+    for (size_t j = 0; j < arraysize(kThreadCounts); ++j)
+      TimeRecording(kModes[i], kThreadCounts[j]);
+  }
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_UNTIL_FULL, 0);
+}
+
+}  // namespace debug
+}  // namespace base
@@ -4,6 +4,8 @@
 
 #include "base/debug/trace_event.h"
 
+#include <set>
+
 #include "base/bind.h"
 #include "base/command_line.h"
 #include "base/json/json_reader.h"
@@ -629,6 +631,27 @@ void ValidateInstantEventPresentOnEveryThread(const ListValue& trace_parsed,
   }
 }
 
+// Returns the "event" argument of every "multi thread event" in
+// |trace_parsed|.
+std::set<int> GetInstantEventNumbers(const ListValue& trace_parsed) {
+  std::set<int> numbers;
+  for (size_t i = 0; i < trace_parsed.GetSize(); i++) {
+    DictionaryValue* dict = NULL;
+    std::string name;
+    int event = 0;
+    if (trace_parsed.GetDictionary(i, &dict) &&
+        dict->GetString("name", &name) && name == "multi thread event" &&
+        dict->GetInteger("args.event", &event)) {
+      numbers.insert(event);
+    }
+  }
+  return numbers;
+}
+
+void IncrementCounter(int* counter) {
+  ++*counter;
+}
+
 void TraceCallsWithCachedCategoryPointersPointers(const char* name_str) {
   TRACE_EVENT0("category name1", name_str);
   TRACE_EVENT_INSTANT0("category name2", name_str);
@@ -1114,6 +1137,146 @@ TEST_F(TraceEventTestFixture, DataCapturedManyThreads) {
                                            num_threads, num_events);
 }
 
+TEST_F(TraceEventTestFixture, DataCapturedPerThread) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_PER_THREAD, 0);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  TraceWithAllMacroVariants(NULL);
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  ValidateAllTraceMacrosCreatedData(trace_parsed_);
+}
+
+// Test that the chunks of threads that have exited and of threads that are
+// still running are both collected.
+TEST_F(TraceEventTestFixture, DataCapturedManyThreadsPerThread) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_PER_THREAD, 0);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  const int num_threads = 4;
+  const int num_events = 4000;
+  Thread* threads[num_threads];
+  WaitableEvent* task_complete_events[num_threads];
+  for (int i = 0; i < num_threads; i++) {
+    threads[i] = new Thread(StringPrintf("Thread %d", i).c_str());
+    task_complete_events[i] = new WaitableEvent(false, false);
+    threads[i]->Start();
+    threads[i]->message_loop()->PostTask(
+        FROM_HERE, base::Bind(&TraceManyInstantEvents,
+                              i, num_events, task_complete_events[i]));
+  }
+
+  for (int i = 0; i < num_threads; i++)
+    task_complete_events[i]->Wait();
+
+  // Stop half of the threads before tracing is disabled.
+  for (int i = 0; i < num_threads / 2; i++)
+    threads[i]->Stop();
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  for (int i = 0; i < num_threads; i++) {
+    threads[i]->Stop();
+    delete threads[i];
+    delete task_complete_events[i];
+  }
+
+  ValidateInstantEventPresentOnEveryThread(trace_parsed_,
+                                           num_threads, num_events);
+}
+
+TEST_F(TraceEventTestFixture, DataCapturedThresholdPerThread) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_PER_THREAD, 0);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  {
+    TRACE_EVENT_IF_LONGER_THAN0(100, "time", "threshold 100");
+    // 100+ seconds to avoid flakiness.
+    TRACE_EVENT_IF_LONGER_THAN0(100000000, "time", "threshold long1");
+    base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(20));
+  }
+  {
+    TRACE_EVENT_IF_LONGER_THAN0(100000000, "time", "2thresholdlong1");
+    TRACE_EVENT0("time", "nonthreshold1");
+  }
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  EXPECT_FIND_BE_("threshold 100");
+  EXPECT_NOT_FIND_BE_("threshold long1");
+  EXPECT_NOT_FIND_BE_("2thresholdlong1");
+  EXPECT_FIND_BE_("nonthreshold1");
+}
+
+// Test that RECORD_PER_THREAD keeps the oldest events and reports a full
+// buffer.
+TEST_F(TraceEventTestFixture, PerThreadBufferFull) {
+  ManualTestSetUp();
+  int buffer_full_count = 0;
+  TraceLog::GetInstance()->SetBufferFullCallback(
+      base::Bind(&IncrementCounter, &buffer_full_count));
+  // The smallest possible buffer holds a single chunk.
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_PER_THREAD, 1);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  const int num_events = 1000;
+  TraceManyInstantEvents(0, num_events, NULL);
+  EXPECT_EQ(1.0f, TraceLog::GetInstance()->GetBufferPercentFull());
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  EXPECT_EQ(1, buffer_full_count);
+  std::set<int> events = GetInstantEventNumbers(trace_parsed_);
+  ASSERT_FALSE(events.empty());
+  EXPECT_LT(events.size(), static_cast<size_t>(num_events));
+  EXPECT_EQ(0, *events.begin());
+  EXPECT_EQ(static_cast<int>(events.size()) - 1, *events.rbegin());
+}
+
+// Test that RECORD_CONTINUOUSLY keeps the most recent events.
+TEST_F(TraceEventTestFixture, ContinuousKeepsLatestEvents) {
+  ManualTestSetUp();
+  int buffer_full_count = 0;
+  TraceLog::GetInstance()->SetBufferFullCallback(
+      base::Bind(&IncrementCounter, &buffer_full_count));
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_CONTINUOUSLY, 1);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  const int num_events = 1000;
+  TraceManyInstantEvents(0, num_events, NULL);
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  EXPECT_EQ(0, buffer_full_count);
+  std::set<int> events = GetInstantEventNumbers(trace_parsed_);
+  ASSERT_FALSE(events.empty());
+  EXPECT_LT(events.size(), static_cast<size_t>(num_events));
+  EXPECT_EQ(num_events - 1, *events.rbegin());
+  EXPECT_EQ(num_events - static_cast<int>(events.size()), *events.begin());
+}
+
+// Test that a flight recorder can be flushed without stopping it.
+TEST_F(TraceEventTestFixture, ContinuousFlushWhileEnabled) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetRecordMode(TraceLog::RECORD_CONTINUOUSLY, 0);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  TRACE_EVENT_INSTANT0("all", "before flush");
+  TraceLog::GetInstance()->Flush();
+  EXPECT_TRUE(FindNamePhase("before flush", "I"));
+  EXPECT_TRUE(TraceLog::GetInstance()->IsEnabled());
+
+  Clear();
+  TRACE_EVENT_INSTANT0("all", "after flush");
+  TraceLog::GetInstance()->SetEnabled(false);
+  EXPECT_FALSE(FindNamePhase("before flush", "I"));
+  EXPECT_TRUE(FindNamePhase("after flush", "I"));
+}
+
 // Test that thread and process names show up in the trace
 TEST_F(TraceEventTestFixture, ThreadNames) {
   ManualTestSetUp();
@@ -0,0 +1,106 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/incoming_task_queue.h"
+
+#include "base/logging.h"
+#include "base/threading/platform_thread.h"
+
+namespace base {
+
+struct IncomingTaskQueue::TaskNode : public IncomingTaskQueue::Node {
+  explicit TaskNode(const PendingTask& pending_task) : task(pending_task) {}
+  PendingTask task;
+};
+
+IncomingTaskQueue::IncomingTaskQueue()
+    : head_(reinterpret_cast<subtle::AtomicWord>(&stub_)),
+      size_(0),
+      tail_(&stub_) {
+}
+
+IncomingTaskQueue::~IncomingTaskQueue() {
+  Clear();
+  DCHECK_EQ(&stub_, tail_);
+}
+
+bool IncomingTaskQueue::Push(PendingTask* pending_task) {
+  TaskNode* node = new TaskNode(*pending_task);
+  pending_task->task.Reset();
+
+  // Reserve the slot before publishing the node, so that the consumer never
+  // sees a task it has not accounted for.  The increment is a full barrier,
+  // which also orders the initialization of |node| before Link().
+  bool was_empty = subtle::Barrier_AtomicIncrement(&size_, 1) == 1;
+  Link(node);
+  // |this| may already be gone.
+  return was_empty;
+}
+
+void IncomingTaskQueue::ReloadWorkQueue(TaskQueue* queue) {
+  subtle::Atomic32 count = subtle::Acquire_Load(&size_);
+  if (!count)
+    return;
+
+  for (subtle::Atomic32 i = 0; i < count; ++i) {
+    TaskNode* node;
+    // A NULL here means a producer reserved a slot but has not linked its
+    // node yet.  It is a couple of instructions away from doing so.
+    while (!(node = Pop()))
+      PlatformThread::YieldCurrentThread();
+    queue->push(node->task);
+    delete node;
+  }
+  subtle::Barrier_AtomicIncrement(&size_, -count);
+}
+
+void IncomingTaskQueue::Clear() {
+  TaskQueue tasks;
+  ReloadWorkQueue(&tasks);
+}
+
+bool IncomingTaskQueue::IsEmpty() const {
+  return subtle::Acquire_Load(&size_) == 0;
+}
+
+IncomingTaskQueue::TaskNode* IncomingTaskQueue::Pop() {
+  Node* tail = tail_;
+  Node* next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  if (tail == &stub_) {
+    if (!next)
+      return NULL;
+    tail_ = next;
+    tail = next;
+    next = reinterpret_cast<Node*>(subtle::Acquire_Load(&next->next));
+  }
+  if (next) {
+    tail_ = next;
+    return static_cast<TaskNode*>(tail);
+  }
+
+  Node* head = reinterpret_cast<Node*>(subtle::Acquire_Load(&head_));
+  if (tail != head)
+    return NULL;  // A producer is between its exchange and its link.
+
+  // |tail| is the last node.  Re-insert the stub behind it so that |tail| can
+  // be handed out without leaving the list empty.
+  subtle::NoBarrier_Store(&stub_.next, 0);
+  subtle::MemoryBarrier();
+  Link(&stub_);
+  next = reinterpret_cast<Node*>(subtle::Acquire_Load(&tail->next));
+  if (next) {
+    tail_ = next;
+    return static_cast<TaskNode*>(tail);
+  }
+  return NULL;
+}
+
+void IncomingTaskQueue::Link(Node* node) {
+  Node* prev = reinterpret_cast<Node*>(subtle::NoBarrier_AtomicExchange(
+      &head_, reinterpret_cast<subtle::AtomicWord>(node)));
+  subtle::Release_Store(&prev->next,
+                        reinterpret_cast<subtle::AtomicWord>(node));
+}
+
+}  // namespace base
@@ -0,0 +1,88 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_INCOMING_TASK_QUEUE_H_
+#define BASE_INCOMING_TASK_QUEUE_H_
+#pragma once
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/pending_task.h"
+
+namespace base {
+
+// IncomingTaskQueue is a lock-free, multi-producer/single-consumer FIFO of
+// PendingTasks.  Any thread may call Push(); only the owning thread (the
+// MessageLoop's thread) may call ReloadWorkQueue() or Clear().
+//
+// The queue is an intrusive linked list in the style of Dmitry Vyukov's MPSC
+// queue: a producer publishes its node with a single atomic exchange on
+// |head_| and then links the previous head to it.  Tasks therefore become
+// visible to the consumer in the order in which the exchanges happened, which
+// preserves per-producer FIFO ordering exactly as the locked std::queue did.
+// Sequence numbers are still assigned by the consumer when it moves tasks to
+// its delayed work queue, so their ordering guarantees are unchanged.
+//
+// A producer can be preempted between the exchange and the link.  While that
+// happens, the tasks pushed after it are unreachable.  |size_| counts tasks
+// that have been reserved but not yet consumed, so ReloadWorkQueue() knows it
+// must wait for such a task rather than report the queue as drained.  The
+// window is two instructions wide, so the wait is a brief yield loop.
+class BASE_EXPORT IncomingTaskQueue {
+ public:
+  IncomingTaskQueue();
+  ~IncomingTaskQueue();
+
+  // Takes ownership of the task held by |pending_task| and appends it to the
+  // queue.  |pending_task->task| is Reset() before the task becomes visible to
+  // the consumer, so that the last reference to the closure is always dropped
+  // on the consuming thread.  Returns true if the queue was empty, in which
+  // case the caller is responsible for waking up the consumer.
+  //
+  // Once the task is visible the consumer may run it immediately, and that
+  // task may destroy the queue.  Push() does not touch |this| after that
+  // point, and callers must not either.
+  bool Push(PendingTask* pending_task);
+
+  // Moves every task that has been pushed so far onto the back of |queue|.
+  // Consumer thread only.
+  void ReloadWorkQueue(TaskQueue* queue);
+
+  // Deletes every task still in the queue.  Consumer thread only.
+  void Clear();
+
+  // Returns true if no task is pending.  This is racy by nature when called
+  // while producers are active, and is only meant for assertions.
+  bool IsEmpty() const;
+
+ private:
+  struct Node {
+    Node() : next(0) {}
+    subtle::AtomicWord next;
+  };
+  struct TaskNode;
+
+  // Returns the oldest fully linked node, or NULL if there is none.
+  TaskNode* Pop();
+
+  // Publishes |node| at the head of the list.
+  void Link(Node* node);
+
+  // Producers exchange themselves into |head_| and bump |size_|, while the
+  // consumer mostly works on |tail_|.  Keep the two sides on separate cache
+  // lines so that posting does not bounce the consumer's line.
+  subtle::AtomicWord head_;
+  // Number of tasks pushed and not yet handed to the consumer.
+  subtle::Atomic32 size_;
+  char pad_[64 - sizeof(subtle::AtomicWord) - sizeof(subtle::Atomic32)];
+  Node* tail_;
+  Node stub_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
+};
+
+}  // namespace base
+
+#endif  // BASE_INCOMING_TASK_QUEUE_H_
@@ -0,0 +1,160 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/incoming_task_queue.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kTasksPerThread = 100000;
+
+void DoNothing() {
+}
+
+// The queue MessageLoop used before IncomingTaskQueue: a std::queue guarded by
+// a lock, swapped out wholesale by the consumer.
+class LockedTaskQueue {
+ public:
+  bool Push(PendingTask* pending_task) {
+    AutoLock lock(lock_);
+    bool was_empty = queue_.empty();
+    queue_.push(*pending_task);
+    pending_task->task.Reset();
+    return was_empty;
+  }
+
+  void ReloadWorkQueue(TaskQueue* work_queue) {
+    AutoLock lock(lock_);
+    queue_.Swap(work_queue);
+  }
+
+ private:
+  Lock lock_;
+  TaskQueue queue_;
+};
+
+template <typename Queue>
+class Producer : public DelegateSimpleThread::Delegate {
+ public:
+  explicit Producer(Queue* queue) : queue_(queue) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kTasksPerThread; ++i) {
+      PendingTask task(FROM_HERE, Bind(&DoNothing));
+      queue_->Push(&task);
+    }
+  }
+
+ private:
+  Queue* queue_;
+};
+
+// Has |num_threads| threads push kTasksPerThread tasks each while the calling
+// thread drains the queue, and logs the time it took.
+template <typename Queue>
+void RunContention(const char* name, int num_threads) {
+  Queue queue;
+  ScopedVector<Producer<Queue> > producers;
+  DelegateSimpleThreadPool pool("Producer", num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    Producer<Queue>* producer = new Producer<Queue>(&queue);
+    producers.push_back(producer);
+    pool.AddWork(producer);
+  }
+
+  const int total = num_threads * kTasksPerThread;
+  int consumed = 0;
+  TaskQueue work_queue;
+  PerfTimeLogger timer(StringPrintf("%s_%dthreads", name, num_threads).c_str());
+  pool.Start();
+  while (consumed < total) {
+    queue.ReloadWorkQueue(&work_queue);
+    while (!work_queue.empty()) {
+      work_queue.pop();
+      ++consumed;
+    }
+  }
+  timer.Done();
+  pool.JoinAll();
+}
+
+class MessageLoopPoster : public DelegateSimpleThread::Delegate {
+ public:
+  MessageLoopPoster(MessageLoop* loop, WaitableEvent* done, int* remaining)
+      : loop_(loop), done_(done), remaining_(remaining) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kTasksPerThread; ++i) {
+      loop_->PostTask(FROM_HERE, Bind(&MessageLoopPoster::CountDown,
+                                      done_, remaining_));
+    }
+  }
+
+ private:
+  static void CountDown(WaitableEvent* done, int* remaining) {
+    if (--*remaining == 0)
+      done->Signal();
+  }
+
+  MessageLoop* loop_;
+  WaitableEvent* done_;
+  int* remaining_;
+};
+
+// End to end: many threads posting to a single IO MessageLoop, the pattern
+// that made the incoming queue lock hot.
+void RunMessageLoopContention(int num_threads) {
+  Thread thread("Consumer");
+  Thread::Options options;
+  options.message_loop_type = MessageLoop::TYPE_IO;
+  ASSERT_TRUE(thread.StartWithOptions(options));
+
+  WaitableEvent done(false, false);
+  int remaining = num_threads * kTasksPerThread;  // Only touched on |thread|.
+  ScopedVector<MessageLoopPoster> posters;
+  DelegateSimpleThreadPool pool("Poster", num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    MessageLoopPoster* poster =
+        new MessageLoopPoster(thread.message_loop(), &done, &remaining);
+    posters.push_back(poster);
+    pool.AddWork(poster);
+  }
+
+  PerfTimeLogger timer(
+      StringPrintf("MessageLoop_PostTask_%dthreads", num_threads).c_str());
+  pool.Start();
+  done.Wait();
+  timer.Done();
+  pool.JoinAll();
+}
+
+}  // namespace
+
+TEST(IncomingTaskQueuePerfTest, Contention) {
+  const int kThreadCounts[] = { 1, 2, 4, 8, 16 };
+  for (size_t i = 0; i < arraysize(kThreadCounts); ++i) {
+    RunContention<LockedTaskQueue>("LockedTaskQueue", kThreadCounts[i]);
+    RunContention<IncomingTaskQueue>("IncomingTaskQueue", kThreadCounts[i]);
+  }
+}
+
+TEST(IncomingTaskQueuePerfTest, MessageLoopPostTask) {
+  const int kThreadCounts[] = { 1, 4, 16 };
+  for (size_t i = 0; i < arraysize(kThreadCounts); ++i)
+    RunMessageLoopContention(kThreadCounts[i]);
+}
+
+}  // namespace base
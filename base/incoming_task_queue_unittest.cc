@@ -0,0 +1,170 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/incoming_task_queue.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void DoNothing() {
+}
+
+class RefCountedObject : public RefCountedThreadSafe<RefCountedObject> {
+ private:
+  friend class RefCountedThreadSafe<RefCountedObject>;
+  ~RefCountedObject() {}
+};
+
+void DoNothingWith(RefCountedObject* object) {
+}
+
+// Tags the task with |id| through its sequence number, which the queue copies
+// along with the rest of the task.
+PendingTask MakeTask(int id) {
+  PendingTask task(FROM_HERE, Bind(&DoNothing));
+  task.sequence_num = id;
+  return task;
+}
+
+class ProducerThread : public DelegateSimpleThread::Delegate {
+ public:
+  ProducerThread(IncomingTaskQueue* queue, int id, int count)
+      : queue_(queue), id_(id), count_(count) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < count_; ++i) {
+      PendingTask task(MakeTask(id_ * count_ + i));
+      queue_->Push(&task);
+    }
+  }
+
+ private:
+  IncomingTaskQueue* queue_;
+  int id_;
+  int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProducerThread);
+};
+
+}  // namespace
+
+TEST(IncomingTaskQueueTest, Empty) {
+  IncomingTaskQueue queue;
+  EXPECT_TRUE(queue.IsEmpty());
+
+  TaskQueue work_queue;
+  queue.ReloadWorkQueue(&work_queue);
+  EXPECT_TRUE(work_queue.empty());
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(IncomingTaskQueueTest, FifoOrder) {
+  IncomingTaskQueue queue;
+  for (int i = 0; i < 10; ++i) {
+    PendingTask task(MakeTask(i));
+    // Only the first push finds the queue empty.
+    EXPECT_EQ(i == 0, queue.Push(&task));
+    EXPECT_TRUE(task.task.is_null());
+  }
+  EXPECT_FALSE(queue.IsEmpty());
+
+  TaskQueue work_queue;
+  queue.ReloadWorkQueue(&work_queue);
+  EXPECT_TRUE(queue.IsEmpty());
+  ASSERT_EQ(10u, work_queue.size());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, work_queue.front().sequence_num);
+    EXPECT_FALSE(work_queue.front().task.is_null());
+    work_queue.pop();
+  }
+
+  // The queue reports empty again once drained.
+  PendingTask task(MakeTask(10));
+  EXPECT_TRUE(queue.Push(&task));
+  queue.ReloadWorkQueue(&work_queue);
+  ASSERT_EQ(1u, work_queue.size());
+  EXPECT_EQ(10, work_queue.front().sequence_num);
+}
+
+TEST(IncomingTaskQueueTest, ReloadAppends) {
+  IncomingTaskQueue queue;
+  TaskQueue work_queue;
+  work_queue.push(MakeTask(0));
+
+  PendingTask task(MakeTask(1));
+  queue.Push(&task);
+  queue.ReloadWorkQueue(&work_queue);
+  ASSERT_EQ(2u, work_queue.size());
+  EXPECT_EQ(0, work_queue.front().sequence_num);
+  EXPECT_EQ(1, work_queue.back().sequence_num);
+}
+
+TEST(IncomingTaskQueueTest, ClearReleasesTasks) {
+  scoped_refptr<RefCountedObject> object(new RefCountedObject);
+  {
+    IncomingTaskQueue queue;
+    PendingTask task(FROM_HERE, Bind(&DoNothingWith, object));
+    queue.Push(&task);
+    EXPECT_FALSE(object->HasOneRef());
+    queue.Clear();
+    EXPECT_TRUE(object->HasOneRef());
+    EXPECT_TRUE(queue.IsEmpty());
+
+    // Tasks left in the queue are released on destruction.
+    PendingTask task2(FROM_HERE, Bind(&DoNothingWith, object));
+    queue.Push(&task2);
+    EXPECT_FALSE(object->HasOneRef());
+  }
+  EXPECT_TRUE(object->HasOneRef());
+}
+
+// Several threads push concurrently while this thread keeps draining.  Every
+// task must be delivered exactly once and each producer's tasks must come out
+// in the order they were pushed.
+TEST(IncomingTaskQueueTest, MultipleProducers) {
+  const int kNumProducers = 8;
+  const int kTasksPerProducer = 10000;
+
+  IncomingTaskQueue queue;
+  ScopedVector<ProducerThread> producers;
+  DelegateSimpleThreadPool pool("IncomingTaskQueueTest", kNumProducers);
+  for (int i = 0; i < kNumProducers; ++i) {
+    ProducerThread* producer =
+        new ProducerThread(&queue, i, kTasksPerProducer);
+    producers.push_back(producer);
+    pool.AddWork(producer);
+  }
+  pool.Start();
+
+  std::vector<int> next_expected(kNumProducers, 0);
+  int received = 0;
+  TaskQueue work_queue;
+  while (received < kNumProducers * kTasksPerProducer) {
+    queue.ReloadWorkQueue(&work_queue);
+    while (!work_queue.empty()) {
+      int id = work_queue.front().sequence_num;
+      work_queue.pop();
+      int producer = id / kTasksPerProducer;
+      ASSERT_EQ(next_expected[producer], id % kTasksPerProducer);
+      ++next_expected[producer];
+      ++received;
+    }
+  }
+  pool.JoinAll();
+
+  EXPECT_TRUE(queue.IsEmpty());
+  for (int i = 0; i < kNumProducers; ++i)
+    EXPECT_EQ(kTasksPerProducer, next_expected[i]);
+}
+
+}  // namespace base
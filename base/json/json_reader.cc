@@ -4,6 +4,10 @@
 
 #include "base/json/json_reader.h"
 
+#include <string.h>
+
+#include <vector>
+
 #include "base/float_util.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
@@ -65,6 +69,105 @@ bool ReadHexDigits(base::JSONReader::Token& token, int digits) {
 
 namespace base {
 
+namespace {
+
+// Builds the Value tree returned by JSONReader::JsonToValue().
+class ValueBuilder : public JSONReader::Delegate {
+ public:
+  ValueBuilder() {}
+
+  virtual ~ValueBuilder() {
+    // Values not yet handed to a dictionary are only owned by its frame.
+    for (size_t i = 0; i < containers_.size(); ++i) {
+      FlatValueMap& entries = containers_[i].entries;
+      for (FlatValueMap::iterator it = entries.begin(); it != entries.end();
+           ++it) {
+        delete it->second;
+      }
+    }
+  }
+
+  Value* ReleaseRoot() { return root_.release(); }
+
+  virtual bool OnNull() OVERRIDE {
+    return Add(Value::CreateNullValue());
+  }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Add(Value::CreateBooleanValue(value));
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Add(Value::CreateIntegerValue(value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Add(Value::CreateDoubleValue(value));
+  }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    return Add(Value::CreateStringValue(value.as_string()));
+  }
+  virtual bool OnDictionaryBegin() OVERRIDE {
+    DictionaryValue* dictionary = new DictionaryValue;
+    Add(dictionary);
+    containers_.push_back(Container(dictionary));
+    return true;
+  }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    containers_.back().entries.push_back(
+        std::make_pair(key.as_string(), static_cast<Value*>(NULL)));
+    return true;
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE {
+    Container& container = containers_.back();
+    static_cast<DictionaryValue*>(container.value)->
+        SetEntriesWithoutPathExpansion(&container.entries);
+    containers_.pop_back();
+    return true;
+  }
+  virtual bool OnListBegin() OVERRIDE {
+    ListValue* list = new ListValue;
+    Add(list);
+    containers_.push_back(Container(list));
+    return true;
+  }
+  virtual bool OnListEnd() OVERRIDE {
+    containers_.pop_back();
+    return true;
+  }
+
+ private:
+  // Takes ownership of |value| and adds it to the innermost container.
+  bool Add(Value* value) {
+    if (containers_.empty()) {
+      DCHECK(!root_.get());
+      root_.reset(value);
+    } else if (containers_.back().value->IsType(Value::TYPE_LIST)) {
+      static_cast<ListValue*>(containers_.back().value)->Append(value);
+    } else {
+      // The entry was added by OnDictionaryKey().
+      DCHECK(!containers_.back().entries.back().second);
+      containers_.back().entries.back().second = value;
+    }
+    return true;
+  }
+
+  // A list or dictionary being built.
+  struct Container {
+    explicit Container(Value* value) : value(value) {}
+
+    // Owned by |root_|, or by the |entries| of the enclosing dictionary.
+    Value* value;
+    // For a dictionary, the members parsed so far. They are set all at once
+    // when the dictionary ends, so that it is stored compactly.
+    FlatValueMap entries;
+  };
+
+  scoped_ptr<Value> root_;
+  std::vector<Container> containers_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueBuilder);
+};
+
+}  // namespace
+
 const char* JSONReader::kBadRootElementType =
     "Root value must be an array or object.";
 const char* JSONReader::kInvalidEscape =
@@ -81,6 +184,8 @@ const char* JSONReader::kUnsupportedEncoding =
     "Unsupported encoding. JSON must be UTF-8.";
 const char* JSONReader::kUnquotedDictionaryKey =
     "Dictionary keys must be quoted.";
+const char* JSONReader::kStoppedByDelegate =
+    "Parsing stopped by the delegate.";
 
 JSONReader::JSONReader()
     : start_pos_(NULL),
@@ -137,6 +242,8 @@ std::string JSONReader::ErrorCodeToString(JsonParseError error_code) {
       return kUnsupportedEncoding;
     case JSON_UNQUOTED_DICTIONARY_KEY:
       return kUnquotedDictionaryKey;
+    case JSON_STOPPED_BY_DELEGATE:
+      return kStoppedByDelegate;
     default:
       NOTREACHED();
       return std::string();
@@ -150,10 +257,18 @@ std::string JSONReader::GetErrorMessage() const {
 
 Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
                                bool allow_trailing_comma) {
+  ValueBuilder builder;
+  if (!Parse(json, check_root, allow_trailing_comma, &builder))
+    return NULL;
+  return builder.ReleaseRoot();
+}
+
+bool JSONReader::Parse(const std::string& json, bool check_root,
+                       bool allow_trailing_comma, Delegate* delegate) {
   // The input must be in UTF-8.
   if (!IsStringUTF8(json.data())) {
     error_code_ = JSON_UNSUPPORTED_ENCODING;
-    return NULL;
+    return false;
   }
 
   start_pos_ = json.data();
@@ -161,8 +276,8 @@ Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
 
   // When the input JSON string starts with a UTF-8 Byte-Order-Mark (U+FEFF)
   // or <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // JSONReader::BuildValue() function from mis-treating a Unicode BOM as an
-  // invalid character and returning NULL.
+  // JSONReader::ParseValue() function from mis-treating a Unicode BOM as an
+  // invalid character and returning false.
   if (json.size() >= 3 && start_pos_[0] == 0xEF &&
       start_pos_[1] == 0xBB && start_pos_[2] == 0xBF) {
     start_pos_ += 3;
@@ -173,10 +288,9 @@ Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
   stack_depth_ = 0;
   error_code_ = JSON_NO_ERROR;
 
-  scoped_ptr<Value> root(BuildValue(check_root));
-  if (root.get()) {
+  if (ParseValue(check_root, delegate)) {
     if (ParseToken().type == Token::END_OF_INPUT) {
-      return root.release();
+      return true;
     } else {
       SetErrorCode(JSON_UNEXPECTED_DATA_AFTER_ROOT, json_pos_);
     }
@@ -186,7 +300,7 @@ Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
   if (error_code_ == 0)
     SetErrorCode(JSON_SYNTAX_ERROR, json_pos_);
 
-  return NULL;
+  return false;
 }
 
 // static
@@ -199,11 +313,11 @@ std::string JSONReader::FormatErrorMessage(int line, int column,
   return description;
 }
 
-Value* JSONReader::BuildValue(bool is_root) {
+bool JSONReader::ParseValue(bool is_root, Delegate* delegate) {
   ++stack_depth_;
   if (stack_depth_ > kStackLimit) {
     SetErrorCode(JSON_TOO_MUCH_NESTING, json_pos_);
-    return NULL;
+    return false;
   }
 
   Token token = ParseToken();
@@ -211,51 +325,64 @@ Value* JSONReader::BuildValue(bool is_root) {
   if (is_root && token.type != Token::OBJECT_BEGIN &&
       token.type != Token::ARRAY_BEGIN) {
     SetErrorCode(JSON_BAD_ROOT_ELEMENT_TYPE, json_pos_);
-    return NULL;
+    return false;
   }
 
-  scoped_ptr<Value> node;
-
   switch (token.type) {
     case Token::END_OF_INPUT:
     case Token::INVALID_TOKEN:
-      return NULL;
+      return false;
 
     case Token::NULL_TOKEN:
-      node.reset(Value::CreateNullValue());
+      if (!delegate->OnNull()) {
+        SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+        return false;
+      }
       break;
 
     case Token::BOOL_TRUE:
-      node.reset(Value::CreateBooleanValue(true));
+      if (!delegate->OnBoolean(true)) {
+        SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+        return false;
+      }
       break;
 
     case Token::BOOL_FALSE:
-      node.reset(Value::CreateBooleanValue(false));
+      if (!delegate->OnBoolean(false)) {
+        SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+        return false;
+      }
       break;
 
     case Token::NUMBER:
-      node.reset(DecodeNumber(token));
-      if (!node.get())
-        return NULL;
+      if (!DecodeNumber(token, delegate))
+        return false;
       break;
 
-    case Token::STRING:
-      node.reset(DecodeString(token));
-      if (!node.get())
-        return NULL;
+    case Token::STRING: {
+      StringPiece value;
+      if (!DecodeString(token, &value))
+        return false;
+      if (!delegate->OnString(value)) {
+        SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+        return false;
+      }
       break;
+    }
 
     case Token::ARRAY_BEGIN:
       {
+        if (!delegate->OnListBegin()) {
+          SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+          return false;
+        }
+
         json_pos_ += token.length;
         token = ParseToken();
 
-        node.reset(new ListValue());
         while (token.type != Token::ARRAY_END) {
-          Value* array_node = BuildValue(false);
-          if (!array_node)
-            return NULL;
-          static_cast<ListValue*>(node.get())->Append(array_node);
+          if (!ParseValue(false, delegate))
+            return false;
 
           // After a list value, we expect a comma or the end of the list.
           token = ParseToken();
@@ -267,54 +394,61 @@ Value* JSONReader::BuildValue(bool is_root) {
             if (token.type == Token::ARRAY_END) {
               if (!allow_trailing_comma_) {
                 SetErrorCode(JSON_TRAILING_COMMA, json_pos_);
-                return NULL;
+                return false;
               }
               // Trailing comma OK, stop parsing the Array.
               break;
             }
           } else if (token.type != Token::ARRAY_END) {
             // Unexpected value after list value.  Bail out.
-            return NULL;
+            return false;
           }
         }
         if (token.type != Token::ARRAY_END) {
-          return NULL;
+          return false;
+        }
+        if (!delegate->OnListEnd()) {
+          SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+          return false;
         }
         break;
       }
 
     case Token::OBJECT_BEGIN:
       {
+        if (!delegate->OnDictionaryBegin()) {
+          SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+          return false;
+        }
+
         json_pos_ += token.length;
         token = ParseToken();
 
-        node.reset(new DictionaryValue);
         while (token.type != Token::OBJECT_END) {
           if (token.type != Token::STRING) {
             SetErrorCode(JSON_UNQUOTED_DICTIONARY_KEY, json_pos_);
-            return NULL;
+            return false;
           }
-          scoped_ptr<Value> dict_key_value(DecodeString(token));
-          if (!dict_key_value.get())
-            return NULL;
-
-          // Convert the key into a wstring.
-          std::string dict_key;
-          bool success = dict_key_value->GetAsString(&dict_key);
-          DCHECK(success);
+          StringPiece dict_key;
+          if (!DecodeString(token, &dict_key))
+            return false;
 
           json_pos_ += token.length;
           token = ParseToken();
           if (token.type != Token::OBJECT_PAIR_SEPARATOR)
-            return NULL;
+            return false;
+
+          // The key is reported only once it is known to be followed by a
+          // value, and before that value can overwrite |decoded_string_|.
+          if (!delegate->OnDictionaryKey(dict_key)) {
+            SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+            return false;
+          }
 
           json_pos_ += token.length;
           token = ParseToken();
-          Value* dict_value = BuildValue(false);
-          if (!dict_value)
-            return NULL;
-          static_cast<DictionaryValue*>(node.get())->SetWithoutPathExpansion(
-              dict_key, dict_value);
+          if (!ParseValue(false, delegate))
+            return false;
 
           // After a key/value pair, we expect a comma or the end of the
           // object.
@@ -327,30 +461,34 @@ Value* JSONReader::BuildValue(bool is_root) {
             if (token.type == Token::OBJECT_END) {
               if (!allow_trailing_comma_) {
                 SetErrorCode(JSON_TRAILING_COMMA, json_pos_);
-                return NULL;
+                return false;
               }
               // Trailing comma OK, stop parsing the Object.
               break;
             }
           } else if (token.type != Token::OBJECT_END) {
             // Unexpected value after last object value.  Bail out.
-            return NULL;
+            return false;
           }
         }
         if (token.type != Token::OBJECT_END)
-          return NULL;
+          return false;
+        if (!delegate->OnDictionaryEnd()) {
+          SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+          return false;
+        }
 
         break;
       }
 
     default:
       // We got a token that's not a value.
-      return NULL;
+      return false;
   }
   json_pos_ += token.length;
 
   --stack_depth_;
-  return node.release();
+  return true;
 }
 
 JSONReader::Token JSONReader::ParseNumberToken() {
@@ -390,18 +528,24 @@ JSONReader::Token JSONReader::ParseNumberToken() {
   return token;
 }
 
-Value* JSONReader::DecodeNumber(const Token& token) {
-  const std::string num_string(token.begin, token.length);
+bool JSONReader::DecodeNumber(const Token& token, Delegate* delegate) {
+  const StringPiece num_string(token.begin, token.length);
 
+  bool reported;
   int num_int;
-  if (StringToInt(num_string, &num_int))
-    return Value::CreateIntegerValue(num_int);
-
   double num_double;
-  if (StringToDouble(num_string, &num_double) && base::IsFinite(num_double))
-    return Value::CreateDoubleValue(num_double);
+  if (StringToInt(num_string, &num_int)) {
+    reported = delegate->OnInteger(num_int);
+  } else if (StringToDouble(num_string.as_string(), &num_double) &&
+             base::IsFinite(num_double)) {
+    reported = delegate->OnDouble(num_double);
+  } else {
+    return false;
+  }
 
-  return NULL;
+  if (!reported)
+    SetErrorCode(JSON_STOPPED_BY_DELEGATE, json_pos_);
+  return reported;
 }
 
 JSONReader::Token JSONReader::ParseStringToken() {
@@ -449,9 +593,18 @@ JSONReader::Token JSONReader::ParseStringToken() {
   return Token::CreateInvalidToken();
 }
 
-Value* JSONReader::DecodeString(const Token& token) {
-  std::string decoded_str;
-  decoded_str.reserve(token.length - 2);
+bool JSONReader::DecodeString(const Token& token, StringPiece* decoded) {
+  // Most strings have no escape sequences and can be used in place.
+  const char* contents = token.begin + 1;
+  size_t contents_length = token.length - 2;
+  if (!memchr(contents, '\\', contents_length)) {
+    decoded->set(contents, contents_length);
+    return true;
+  }
+
+  std::string& decoded_str = decoded_string_;
+  decoded_str.clear();
+  decoded_str.reserve(contents_length);
 
   for (int i = 1; i < token.length - 1; ++i) {
     char c = *(token.begin + i);
@@ -485,31 +638,32 @@ Value* JSONReader::DecodeString(const Token& token) {
 
         case 'x': {
           if (i + 2 >= token.length)
-            return NULL;
+            return false;
           int hex_digit = 0;
           if (!HexStringToInt(StringPiece(token.begin + i + 1, 2), &hex_digit))
-            return NULL;
+            return false;
           decoded_str.push_back(hex_digit);
           i += 2;
           break;
         }
         case 'u':
           if (!ConvertUTF16Units(token, &i, &decoded_str))
-            return NULL;
+            return false;
           break;
 
         default:
           // We should only have valid strings at this point.  If not,
           // ParseStringToken didn't do it's job.
           NOTREACHED();
-          return NULL;
+          return false;
       }
     } else {
       // Not escaped
       decoded_str.push_back(c);
     }
   }
-  return Value::CreateStringValue(decoded_str);
+  decoded->set(decoded_str.data(), decoded_str.size());
+  return true;
 }
 
 bool JSONReader::ConvertUTF16Units(const Token& token,
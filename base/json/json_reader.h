@@ -3,7 +3,8 @@
 // found in the LICENSE file.
 //
 // A JSON parser.  Converts strings of JSON into a Value object (see
-// base/values.h).
+// base/values.h), or reports their contents to a JSONReader::Delegate as they
+// are parsed, without building any Value.
 // http://www.ietf.org/rfc/rfc4627.txt?number=4627
 //
 // Known limitations/deviations from the RFC:
@@ -33,6 +34,7 @@
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
+#include "base/string_piece.h"
 
 // Chromium and Chromium OS check out gtest to different places, so we're
 // unable to compile on both if we include gtest_prod.h here.  Instead, include
@@ -92,6 +94,28 @@ class BASE_EXPORT JSONReader {
     int length;
   };
 
+  // Receives the contents of a JSON document from Parse(), in document order.
+  // An object is reported as OnDictionaryBegin(), then OnDictionaryKey()
+  // followed by the value for each member, then OnDictionaryEnd(); arrays
+  // likewise. Numbers that fit in an int are reported with OnInteger(), others
+  // with OnDouble(). StringPiece arguments are only valid during the call.
+  // Returning false from any method stops parsing.
+  class BASE_EXPORT Delegate {
+   public:
+    virtual ~Delegate() {}
+
+    virtual bool OnNull() = 0;
+    virtual bool OnBoolean(bool value) = 0;
+    virtual bool OnInteger(int value) = 0;
+    virtual bool OnDouble(double value) = 0;
+    virtual bool OnString(const StringPiece& value) = 0;
+    virtual bool OnDictionaryBegin() = 0;
+    virtual bool OnDictionaryKey(const StringPiece& key) = 0;
+    virtual bool OnDictionaryEnd() = 0;
+    virtual bool OnListBegin() = 0;
+    virtual bool OnListEnd() = 0;
+  };
+
   // Error codes during parsing.
   enum JsonParseError {
     JSON_NO_ERROR = 0,
@@ -103,6 +127,7 @@ class BASE_EXPORT JSONReader {
     JSON_UNEXPECTED_DATA_AFTER_ROOT,
     JSON_UNSUPPORTED_ENCODING,
     JSON_UNQUOTED_DICTIONARY_KEY,
+    JSON_STOPPED_BY_DELEGATE,
   };
 
   // String versions of parse error codes.
@@ -114,6 +139,7 @@ class BASE_EXPORT JSONReader {
   static const char* kUnexpectedDataAfterRoot;
   static const char* kUnsupportedEncoding;
   static const char* kUnquotedDictionaryKey;
+  static const char* kStoppedByDelegate;
 
   JSONReader();
 
@@ -154,6 +180,15 @@ class BASE_EXPORT JSONReader {
   Value* JsonToValue(const std::string& json, bool check_root,
                      bool allow_trailing_comma);
 
+  // Parses |json| with the same rules as JsonToValue(), but reports its
+  // contents to |delegate| instead of building a Value. Returns false if
+  // |json| is not a properly formed JSON string or if |delegate| stopped the
+  // parse (JSON_STOPPED_BY_DELEGATE), in which case a detailed error can be
+  // retrieved from |error_message()|. |delegate| may have received some of the
+  // contents by then.
+  bool Parse(const std::string& json, bool check_root,
+             bool allow_trailing_comma, Delegate* delegate);
+
  private:
   FRIEND_TEST_ALL_PREFIXES(JSONReaderTest, Reading);
   FRIEND_TEST_ALL_PREFIXES(JSONReaderTest, ErrorMessages);
@@ -161,10 +196,11 @@ class BASE_EXPORT JSONReader {
   static std::string FormatErrorMessage(int line, int column,
                                         const std::string& description);
 
-  // Recursively build Value.  Returns NULL if we don't have a valid JSON
-  // string.  If |is_root| is true, we verify that the root element is either
-  // an object or an array.
-  Value* BuildValue(bool is_root);
+  // Recursively parse a value, reporting it to |delegate|.  Returns false if
+  // we don't have a valid JSON string or |delegate| returned false.  If
+  // |is_root| is true, we verify that the root element is either an object or
+  // an array.
+  bool ParseValue(bool is_root, Delegate* delegate);
 
   // Parses a sequence of characters into a Token::NUMBER. If the sequence of
   // characters is not a valid number, returns a Token::INVALID_TOKEN. Note
@@ -172,9 +208,10 @@ class BASE_EXPORT JSONReader {
   // int/double.
   Token ParseNumberToken();
 
-  // Try and convert the substring that token holds into an int or a double. If
-  // we can (ie., no overflow), return the value, else return NULL.
-  Value* DecodeNumber(const Token& token);
+  // Try and convert the substring that token holds into an int or a double,
+  // and report it to |delegate|. Returns false on overflow or if |delegate|
+  // returned false.
+  bool DecodeNumber(const Token& token, Delegate* delegate);
 
   // Parses a sequence of characters into a Token::STRING. If the sequence of
   // characters is not a valid string, returns a Token::INVALID_TOKEN. Note
@@ -183,8 +220,11 @@ class BASE_EXPORT JSONReader {
   Token ParseStringToken();
 
   // Convert the substring into a value string.  This should always succeed
-  // (otherwise ParseStringToken would have failed).
-  Value* DecodeString(const Token& token);
+  // (otherwise ParseStringToken would have failed).  |*decoded| points into
+  // the input if the string has no escape sequences, and into
+  // |decoded_string_| otherwise; either way it is only valid until the next
+  // call.
+  bool DecodeString(const Token& token, StringPiece* decoded);
 
   // Helper function for DecodeString that consumes UTF16 [0,2] code units and
   // convers them to UTF8 code untis.  |token| is the string token in which the
@@ -230,6 +270,10 @@ class BASE_EXPORT JSONReader {
   // A parser flag that allows trailing commas in objects and arrays.
   bool allow_trailing_comma_;
 
+  // Scratch space for strings with escape sequences, reused to avoid an
+  // allocation per string.
+  std::string decoded_string_;
+
   // Contains the error code for the last call to JsonToValue(), if any.
   JsonParseError error_code_;
   int error_line_;
@@ -0,0 +1,140 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_reader.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/json/json_value_converter.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kNumRecords = 20000;
+const int kIterations = 10;
+
+struct Record {
+  int id;
+  std::string name;
+  double score;
+  bool active;
+  ScopedVector<int> tags;
+
+  Record() : id(0), score(0), active(false) {}
+
+  static void RegisterJSONConverter(JSONValueConverter<Record>* converter) {
+    converter->RegisterIntField("id", &Record::id);
+    converter->RegisterStringField("name", &Record::name);
+    converter->RegisterDoubleField("score", &Record::score);
+    converter->RegisterBoolField("active", &Record::active);
+    converter->RegisterRepeatedInt("tags", &Record::tags);
+  }
+};
+
+struct RecordList {
+  ScopedVector<Record> records;
+
+  static void RegisterJSONConverter(
+      JSONValueConverter<RecordList>* converter) {
+    converter->RegisterRepeatedMessage("records", &RecordList::records);
+  }
+};
+
+// Returns a document shaped like a large sync or policy payload: a list of
+// small objects, with a few members that the converter does not bind.
+std::string MakeDocument() {
+  std::string json = "{\"version\": 3, \"records\": [";
+  for (int i = 0; i < kNumRecords; ++i) {
+    if (i > 0)
+      json += ",";
+    StringAppendF(&json,
+                  "{\"id\": %d, \"name\": \"record \\\"%d\\\"\", "
+                  "\"score\": %d.25, \"active\": %s, \"tags\": [%d, %d, %d], "
+                  "\"extra\": {\"note\": \"unbound\", \"list\": [null]}}",
+                  i, i, i, i % 2 ? "true" : "false", i, i + 1, i + 2);
+  }
+  json += "]}";
+  return json;
+}
+
+// Accepts everything, to time the parser alone.
+class NullDelegate : public JSONReader::Delegate {
+ public:
+  virtual bool OnNull() OVERRIDE { return true; }
+  virtual bool OnBoolean(bool value) OVERRIDE { return true; }
+  virtual bool OnInteger(int value) OVERRIDE { return true; }
+  virtual bool OnDouble(double value) OVERRIDE { return true; }
+  virtual bool OnString(const StringPiece& value) OVERRIDE { return true; }
+  virtual bool OnDictionaryBegin() OVERRIDE { return true; }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    return true;
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE { return true; }
+  virtual bool OnListBegin() OVERRIDE { return true; }
+  virtual bool OnListEnd() OVERRIDE { return true; }
+};
+
+void LogThroughput(const char* name, const PerfTimer& timer,
+                   const std::string& json) {
+  double megabytes = static_cast<double>(json.size()) * kIterations / 1e6;
+  LogPerfResult(name, megabytes / timer.Elapsed().InSecondsF(), "MB/s");
+}
+
+}  // namespace
+
+TEST(JSONReaderPerfTest, Read) {
+  std::string json = MakeDocument();
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    scoped_ptr<Value> value(JSONReader::Read(json, false));
+    ASSERT_TRUE(value.get());
+  }
+  LogThroughput("JSONReader_Read", timer, json);
+}
+
+TEST(JSONReaderPerfTest, ParseWithDelegate) {
+  std::string json = MakeDocument();
+  NullDelegate delegate;
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    JSONReader reader;
+    ASSERT_TRUE(reader.Parse(json, true, false, &delegate));
+  }
+  LogThroughput("JSONReader_ParseWithDelegate", timer, json);
+}
+
+TEST(JSONReaderPerfTest, ConvertValue) {
+  std::string json = MakeDocument();
+  JSONValueConverter<RecordList> converter;
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    scoped_ptr<Value> value(JSONReader::Read(json, false));
+    RecordList list;
+    ASSERT_TRUE(value.get() && converter.Convert(*value, &list));
+    ASSERT_EQ(static_cast<size_t>(kNumRecords), list.records.size());
+  }
+  LogThroughput("JSONValueConverter_Convert", timer, json);
+}
+
+TEST(JSONReaderPerfTest, ConvertJSON) {
+  std::string json = MakeDocument();
+  JSONValueConverter<RecordList> converter;
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    RecordList list;
+    ASSERT_TRUE(converter.ConvertJSON(json, &list));
+    ASSERT_EQ(static_cast<size_t>(kNumRecords), list.records.size());
+  }
+  LogThroughput("JSONValueConverter_ConvertJSON", timer, json);
+}
+
+}  // namespace base
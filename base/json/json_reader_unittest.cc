@@ -7,12 +7,69 @@
 #include "testing/gtest/include/gtest/gtest.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/string_piece.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "base/values.h"
 #include "build/build_config.h"
 
 namespace base {
 
+namespace {
+
+// Records the calls made by JSONReader::Parse() as a string, and stops the
+// parse at the call named |stop_at|, if any.
+class RecordingDelegate : public JSONReader::Delegate {
+ public:
+  explicit RecordingDelegate(const std::string& stop_at)
+      : stop_at_(stop_at) {}
+
+  const std::string& calls() const { return calls_; }
+
+  virtual bool OnNull() OVERRIDE {
+    return Record("null");
+  }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Record(value ? "true" : "false");
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Record(StringPrintf("int:%d", value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Record(StringPrintf("double:%g", value));
+  }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    return Record("string:" + value.as_string());
+  }
+  virtual bool OnDictionaryBegin() OVERRIDE {
+    return Record("{");
+  }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    return Record("key:" + key.as_string());
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE {
+    return Record("}");
+  }
+  virtual bool OnListBegin() OVERRIDE {
+    return Record("[");
+  }
+  virtual bool OnListEnd() OVERRIDE {
+    return Record("]");
+  }
+
+ private:
+  bool Record(const std::string& call) {
+    if (!calls_.empty())
+      calls_ += " ";
+    calls_ += call;
+    return call != stop_at_;
+  }
+
+  std::string stop_at_;
+  std::string calls_;
+};
+
+}  // namespace
+
 TEST(JSONReaderTest, Reading) {
   // some whitespace checking
   scoped_ptr<Value> root;
@@ -596,4 +653,46 @@ TEST(JSONReaderTest, ErrorMessages) {
   EXPECT_EQ(JSONReader::JSON_INVALID_ESCAPE, error_code);
 }
 
+TEST(JSONReaderTest, ParseWithDelegate) {
+  const char kJson[] =
+      "{\"a\": [1, -2.5, 1e10, true, false, null],"
+      " \"b\\n\": {\"c\": \"x\\u00e9y\", \"d\": []}, \"e\": {}}";
+
+  RecordingDelegate delegate("");
+  JSONReader reader;
+  EXPECT_TRUE(reader.Parse(kJson, true, false, &delegate));
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+  EXPECT_EQ("{ key:a [ int:1 double:-2.5 double:1e+10 true false null ]"
+            " key:b\n { key:c string:x\xc3\xa9y key:d [ ] } key:e { } }",
+            delegate.calls());
+
+  // Scalars are allowed at the root only if |check_root| is false.
+  RecordingDelegate scalar_delegate("");
+  EXPECT_TRUE(reader.Parse("\"root\"", false, false, &scalar_delegate));
+  EXPECT_EQ("string:root", scalar_delegate.calls());
+  EXPECT_FALSE(reader.Parse("\"root\"", true, false, &scalar_delegate));
+  EXPECT_EQ(JSONReader::JSON_BAD_ROOT_ELEMENT_TYPE, reader.error_code());
+}
+
+TEST(JSONReaderTest, ParseErrorsWithDelegate) {
+  JSONReader reader;
+
+  // A delegate can stop the parse.
+  RecordingDelegate stopping_delegate("int:2");
+  EXPECT_FALSE(reader.Parse("[1, 2, 3]", true, false, &stopping_delegate));
+  EXPECT_EQ(JSONReader::JSON_STOPPED_BY_DELEGATE, reader.error_code());
+  EXPECT_EQ("[ int:1 int:2", stopping_delegate.calls());
+  EXPECT_EQ("Line: 1, column: 5, Parsing stopped by the delegate.",
+            reader.GetErrorMessage());
+
+  // Errors are reported as by JsonToValue(), after the contents preceding
+  // them.
+  RecordingDelegate delegate("");
+  EXPECT_FALSE(reader.Parse("[true, false, ]", true, false, &delegate));
+  EXPECT_EQ(JSONReader::JSON_TRAILING_COMMA, reader.error_code());
+  EXPECT_EQ("[ true false", delegate.calls());
+  EXPECT_EQ("Line: 1, column: 15, Trailing comma not allowed.",
+            reader.GetErrorMessage());
+}
+
 }  // namespace base
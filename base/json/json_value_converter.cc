@@ -0,0 +1,242 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_value_converter.h"
+
+#include <vector>
+
+#include "base/json/json_reader.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+// Routes the contents reported by JSONReader::Parse() to the fields of the
+// struct being converted. Values with no registered field are skipped.
+class ConverterDelegate : public JSONReader::Delegate {
+ public:
+  ConverterDelegate(const ObjectSink* root_sink, void* root)
+      : root_sink_(root_sink),
+        root_(root),
+        skip_depth_(0),
+        target_type_(TARGET_NONE),
+        target_sink_(NULL),
+        target_field_(NULL) {
+  }
+
+  virtual bool OnNull() OVERRIDE {
+    // No field type accepts null, so a null is only fine where it is ignored.
+    return skip_depth_ > 0 || TakeTarget() != TARGET_FIELD;
+  }
+
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    if (skip_depth_ > 0 || TakeTarget() != TARGET_FIELD)
+      return true;
+    return target_sink_->SetBoolean(value, target_field_);
+  }
+
+  virtual bool OnInteger(int value) OVERRIDE {
+    if (skip_depth_ > 0 || TakeTarget() != TARGET_FIELD)
+      return true;
+    return target_sink_->SetInteger(value, target_field_);
+  }
+
+  virtual bool OnDouble(double value) OVERRIDE {
+    if (skip_depth_ > 0 || TakeTarget() != TARGET_FIELD)
+      return true;
+    return target_sink_->SetDouble(value, target_field_);
+  }
+
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    if (skip_depth_ > 0 || TakeTarget() != TARGET_FIELD)
+      return true;
+    return target_sink_->SetString(value, target_field_);
+  }
+
+  virtual bool OnDictionaryBegin() OVERRIDE {
+    if (skip_depth_ > 0) {
+      ++skip_depth_;
+      return true;
+    }
+    if (frames_.empty()) {
+      frames_.push_back(Frame(root_sink_, root_, std::string()));
+      return true;
+    }
+    switch (TakeTarget()) {
+      case TARGET_NONE:
+        skip_depth_ = 1;
+        return true;
+      case TARGET_PATH: {
+        // A dictionary holding fields with dotted paths.
+        Frame frame(frames_.back().object_sink, frames_.back().object,
+                    target_path_);
+        frames_.push_back(frame);
+        return true;
+      }
+      case TARGET_FIELD: {
+        const ObjectSink* object_sink = target_sink_->GetObjectSink();
+        if (!object_sink)
+          return false;
+        frames_.push_back(Frame(object_sink, target_field_, std::string()));
+        return true;
+      }
+    }
+    NOTREACHED();
+    return false;
+  }
+
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    if (skip_depth_ > 0)
+      return true;
+    const Frame& frame = frames_.back();
+    DCHECK(frame.object_sink);
+
+    // Field paths use '.' to reach into nested dictionaries, so a key that
+    // contains one can never match.
+    if (key.find('.') != StringPiece::npos) {
+      target_type_ = TARGET_NONE;
+      return true;
+    }
+    if (frame.path.empty()) {
+      key.CopyToString(&target_path_);
+    } else {
+      target_path_ = frame.path;
+      target_path_.push_back('.');
+      key.AppendToString(&target_path_);
+    }
+
+    target_sink_ = frame.object_sink->FindField(target_path_, frame.object,
+                                                &target_field_);
+    if (target_sink_)
+      target_type_ = TARGET_FIELD;
+    else if (frame.object_sink->HasFieldBelow(target_path_))
+      target_type_ = TARGET_PATH;
+    else
+      target_type_ = TARGET_NONE;
+    return true;
+  }
+
+  virtual bool OnDictionaryEnd() OVERRIDE {
+    return EndContainer();
+  }
+
+  virtual bool OnListBegin() OVERRIDE {
+    if (skip_depth_ > 0) {
+      ++skip_depth_;
+      return true;
+    }
+    // The root must be a dictionary.
+    if (frames_.empty())
+      return false;
+    if (TakeTarget() != TARGET_FIELD) {
+      skip_depth_ = 1;
+      return true;
+    }
+    const ListSink* list_sink = target_sink_->GetListSink();
+    if (!list_sink)
+      return false;
+    // A later list for the same key replaces the earlier one, as it does in
+    // the DictionaryValue that Convert() reads.
+    list_sink->ClearElements(target_field_);
+    frames_.push_back(Frame(list_sink, target_field_));
+    return true;
+  }
+
+  virtual bool OnListEnd() OVERRIDE {
+    return EndContainer();
+  }
+
+ private:
+  enum TargetType {
+    // The value is not converted.
+    TARGET_NONE,
+    // The value goes into |target_field_| through |target_sink_|.
+    TARGET_FIELD,
+    // The value is a dictionary with fields registered below |target_path_|.
+    TARGET_PATH,
+  };
+
+  // A dictionary or list being converted.
+  struct Frame {
+    Frame(const ObjectSink* object_sink, void* object, const std::string& path)
+        : object_sink(object_sink),
+          object(object),
+          path(path),
+          list_sink(NULL),
+          list(NULL) {
+    }
+    Frame(const ListSink* list_sink, void* list)
+        : object_sink(NULL),
+          object(NULL),
+          list_sink(list_sink),
+          list(list) {
+    }
+
+    // Set for a dictionary.
+    const ObjectSink* object_sink;
+    void* object;
+    // The path of the dictionary relative to |object|, for dotted paths.
+    std::string path;
+
+    // Set for a list.
+    const ListSink* list_sink;
+    void* list;
+  };
+
+  // Determines where the value being reported goes.
+  TargetType TakeTarget() {
+    DCHECK(!frames_.empty());
+    const Frame& frame = frames_.back();
+    if (frame.list_sink) {
+      target_sink_ = frame.list_sink->element_sink();
+      target_field_ = frame.list_sink->AppendElement(frame.list);
+      return TARGET_FIELD;
+    }
+    TargetType type = target_type_;
+    target_type_ = TARGET_NONE;
+    return type;
+  }
+
+  bool EndContainer() {
+    if (skip_depth_ > 0)
+      --skip_depth_;
+    else
+      frames_.pop_back();
+    return true;
+  }
+
+  const ObjectSink* root_sink_;
+  void* root_;
+  std::vector<Frame> frames_;
+
+  // Nesting depth within a value that is being skipped.
+  int skip_depth_;
+
+  // Where the next value of the innermost dictionary goes, as set by
+  // OnDictionaryKey().
+  TargetType target_type_;
+  const ValueSink* target_sink_;
+  void* target_field_;
+  std::string target_path_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConverterDelegate);
+};
+
+}  // namespace
+
+bool ConvertJSONToObject(const std::string& json,
+                         const ObjectSink* sink,
+                         void* object) {
+  ConverterDelegate delegate(sink, object);
+  JSONReader reader;
+  if (!reader.Parse(json, true, false, &delegate)) {
+    DVLOG(1) << "failed to convert JSON: " << reader.GetErrorMessage();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace internal
+}  // namespace base
@@ -9,6 +9,7 @@
 #include <string>
 #include <vector>
 
+#include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
@@ -16,6 +17,7 @@
 #include "base/stl_util.h"
 #include "base/string16.h"
 #include "base/string_piece.h"
+#include "base/utf_string_conversions.h"
 #include "base/values.h"
 
 // JSONValueConverter converts a JSON value into a C++ struct in a
@@ -47,6 +49,11 @@
 //   JSONValueConverter<Message> converter;
 //   converter.Convert(json, &message);
 //
+// If you have the JSON text rather than a Value, call ConvertJSON() instead.
+// It binds the fields while the text is parsed, without building a Value
+// tree, which is much cheaper for large inputs.
+//   converter.ConvertJSON(json_string, &message);
+//
 // Convert() returns false when it fails.  Here "fail" means that the value is
 // structurally different from expected, such like a string value appears
 // for an int field.  Do not report failures for missing fields.
@@ -91,6 +98,63 @@ class JSONValueConverter;
 
 namespace internal {
 
+class ListSink;
+class ObjectSink;
+
+// ConvertJSON() stores values into fields through these interfaces as the
+// JSON text is parsed. They take the field as a void* because one parse
+// visits fields of many types; a sink only ever receives fields of the type
+// it was created for.
+
+// Stores a value into a field. Each method returns false if the value does not
+// fit the field, like the corresponding ValueConverter::Convert() would.
+class BASE_EXPORT ValueSink {
+ public:
+  virtual ~ValueSink() {}
+  virtual bool SetBoolean(bool value, void* field) const { return false; }
+  virtual bool SetInteger(int value, void* field) const { return false; }
+  virtual bool SetDouble(double value, void* field) const { return false; }
+  virtual bool SetString(const StringPiece& value, void* field) const {
+    return false;
+  }
+  // Returns the fields of a struct field, or NULL if the field does not hold
+  // a struct.
+  virtual const ObjectSink* GetObjectSink() const { return NULL; }
+  // Returns the elements of a repeated field, or NULL if the field is not
+  // repeated.
+  virtual const ListSink* GetListSink() const { return NULL; }
+};
+
+// The fields registered for a struct.
+class BASE_EXPORT ObjectSink {
+ public:
+  virtual ~ObjectSink() {}
+  // Returns the sink of the field registered as |path| and sets |*field| to
+  // that field within |object|, or returns NULL if there is no such field.
+  virtual const ValueSink* FindField(const std::string& path,
+                                     void* object,
+                                     void** field) const = 0;
+  // Returns true if a field is registered with a path below |path|, e.g.
+  // "foo.bar" when |path| is "foo".
+  virtual bool HasFieldBelow(const std::string& path) const = 0;
+};
+
+// The elements of a repeated field.
+class BASE_EXPORT ListSink {
+ public:
+  virtual ~ListSink() {}
+  // Removes all elements from |list|.
+  virtual void ClearElements(void* list) const = 0;
+  // Appends a new element to |list| and returns it.
+  virtual void* AppendElement(void* list) const = 0;
+  virtual const ValueSink* element_sink() const = 0;
+};
+
+// Parses |json| and stores its contents into |object| through |sink|.
+BASE_EXPORT bool ConvertJSONToObject(const std::string& json,
+                                     const ObjectSink* sink,
+                                     void* object);
+
 template<typename StructType>
 class FieldConverterBase {
  public:
@@ -98,6 +162,8 @@ class FieldConverterBase {
   virtual ~FieldConverterBase() {}
   virtual bool ConvertField(const base::Value& value, StructType* obj)
       const = 0;
+  virtual void* GetField(StructType* obj) const = 0;
+  virtual const ValueSink* value_sink() const = 0;
   const std::string& field_path() const { return field_path_; }
 
  private:
@@ -106,7 +172,7 @@ class FieldConverterBase {
 };
 
 template <typename FieldType>
-class ValueConverter {
+class ValueConverter : public ValueSink {
  public:
   virtual ~ValueConverter() {}
   virtual bool Convert(const base::Value& value, FieldType* field) const = 0;
@@ -128,6 +194,14 @@ class FieldConverter : public FieldConverterBase<StructType> {
     return value_converter_->Convert(value, &(dst->*field_pointer_));
   }
 
+  virtual void* GetField(StructType* obj) const OVERRIDE {
+    return &(obj->*field_pointer_);
+  }
+
+  virtual const ValueSink* value_sink() const OVERRIDE {
+    return value_converter_.get();
+  }
+
  private:
   FieldType StructType::* field_pointer_;
   scoped_ptr<ValueConverter<FieldType> > value_converter_;
@@ -146,6 +220,11 @@ class BasicValueConverter<int> : public ValueConverter<int> {
     return value.GetAsInteger(field);
   }
 
+  virtual bool SetInteger(int value, void* field) const OVERRIDE {
+    *static_cast<int*>(field) = value;
+    return true;
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -160,6 +239,11 @@ class BasicValueConverter<std::string> : public ValueConverter<std::string> {
     return value.GetAsString(field);
   }
 
+  virtual bool SetString(const StringPiece& value, void* field) const OVERRIDE {
+    value.CopyToString(static_cast<std::string*>(field));
+    return true;
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -174,6 +258,11 @@ class BasicValueConverter<string16> : public ValueConverter<string16> {
     return value.GetAsString(field);
   }
 
+  virtual bool SetString(const StringPiece& value, void* field) const OVERRIDE {
+    *static_cast<string16*>(field) = UTF8ToUTF16(value);
+    return true;
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -187,6 +276,16 @@ class BasicValueConverter<double> : public ValueConverter<double> {
     return value.GetAsDouble(field);
   }
 
+  virtual bool SetInteger(int value, void* field) const OVERRIDE {
+    *static_cast<double*>(field) = value;
+    return true;
+  }
+
+  virtual bool SetDouble(double value, void* field) const OVERRIDE {
+    *static_cast<double*>(field) = value;
+    return true;
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -200,6 +299,11 @@ class BasicValueConverter<bool> : public ValueConverter<bool> {
     return value.GetAsBoolean(field);
   }
 
+  virtual bool SetBoolean(bool value, void* field) const OVERRIDE {
+    *static_cast<bool*>(field) = value;
+    return true;
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BasicValueConverter);
 };
@@ -219,6 +323,10 @@ class CustomFieldConverter : public ValueConverter<FieldType> {
         convert_func_(string_value, field);
   }
 
+  virtual bool SetString(const StringPiece& value, void* field) const OVERRIDE {
+    return convert_func_(value, static_cast<FieldType*>(field));
+  }
+
  private:
   ConvertFunc convert_func_;
 
@@ -235,13 +343,18 @@ class NestedValueConverter : public ValueConverter<NestedType> {
     return converter_.Convert(value, field);
   }
 
+  virtual const ObjectSink* GetObjectSink() const OVERRIDE {
+    return &converter_;
+  }
+
  private:
   JSONValueConverter<NestedType> converter_;
   DISALLOW_COPY_AND_ASSIGN(NestedValueConverter);
 };
 
 template <typename Element>
-class RepeatedValueConverter : public ValueConverter<ScopedVector<Element> > {
+class RepeatedValueConverter : public ValueConverter<ScopedVector<Element> >,
+                               public ListSink {
  public:
   RepeatedValueConverter() {}
 
@@ -270,6 +383,22 @@ class RepeatedValueConverter : public ValueConverter<ScopedVector<Element> > {
     return true;
   }
 
+  virtual const ListSink* GetListSink() const OVERRIDE { return this; }
+
+  virtual void ClearElements(void* list) const OVERRIDE {
+    static_cast<ScopedVector<Element>*>(list)->reset();
+  }
+
+  virtual void* AppendElement(void* list) const OVERRIDE {
+    Element* element = new Element;
+    static_cast<ScopedVector<Element>*>(list)->push_back(element);
+    return element;
+  }
+
+  virtual const ValueSink* element_sink() const OVERRIDE {
+    return &basic_converter_;
+  }
+
  private:
   BasicValueConverter<Element> basic_converter_;
   DISALLOW_COPY_AND_ASSIGN(RepeatedValueConverter);
@@ -277,7 +406,8 @@ class RepeatedValueConverter : public ValueConverter<ScopedVector<Element> > {
 
 template <typename NestedType>
 class RepeatedMessageConverter
-    : public ValueConverter<ScopedVector<NestedType> > {
+    : public ValueConverter<ScopedVector<NestedType> >,
+      public ListSink {
  public:
   RepeatedMessageConverter() {}
 
@@ -304,15 +434,31 @@ class RepeatedMessageConverter
     return true;
   }
 
+  virtual const ListSink* GetListSink() const OVERRIDE { return this; }
+
+  virtual void ClearElements(void* list) const OVERRIDE {
+    static_cast<ScopedVector<NestedType>*>(list)->reset();
+  }
+
+  virtual void* AppendElement(void* list) const OVERRIDE {
+    NestedType* element = new NestedType;
+    static_cast<ScopedVector<NestedType>*>(list)->push_back(element);
+    return element;
+  }
+
+  virtual const ValueSink* element_sink() const OVERRIDE {
+    return &converter_;
+  }
+
  private:
-  JSONValueConverter<NestedType> converter_;
+  NestedValueConverter<NestedType> converter_;
   DISALLOW_COPY_AND_ASSIGN(RepeatedMessageConverter);
 };
 
 }  // namespace internal
 
 template <class StructType>
-class JSONValueConverter {
+class JSONValueConverter : public internal::ObjectSink {
  public:
   JSONValueConverter() {
     StructType::RegisterJSONConverter(this);
@@ -436,6 +582,39 @@ class JSONValueConverter {
     return true;
   }
 
+  // Parses |json| and converts its root object like Convert(), but without
+  // building a Value. Returns false if |json| is malformed or if Convert()
+  // would fail for it. As with Convert(), the last of duplicate keys wins; a
+  // repeated field is emptied before the elements of each list are added.
+  bool ConvertJSON(const std::string& json, StructType* output) const {
+    return internal::ConvertJSONToObject(json, this, output);
+  }
+
+  // internal::ObjectSink implementation.
+  virtual const internal::ValueSink* FindField(const std::string& path,
+                                               void* object,
+                                               void** field) const OVERRIDE {
+    for (size_t i = 0; i < fields_.size(); ++i) {
+      if (fields_[i]->field_path() == path) {
+        *field = fields_[i]->GetField(static_cast<StructType*>(object));
+        return fields_[i]->value_sink();
+      }
+    }
+    return NULL;
+  }
+
+  virtual bool HasFieldBelow(const std::string& path) const OVERRIDE {
+    for (size_t i = 0; i < fields_.size(); ++i) {
+      const std::string& field_path = fields_[i]->field_path();
+      if (field_path.size() > path.size() &&
+          field_path[path.size()] == '.' &&
+          field_path.compare(0, path.size(), path) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
  private:
   ScopedVector<internal::FieldConverterBase<StructType> > fields_;
 
@@ -12,6 +12,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
 #include "base/string_piece.h"
+#include "base/utf_string_conversions.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -67,6 +68,20 @@ struct NestedMessage {
   }
 };
 
+// For fields reached through dotted paths.
+struct DottedPathMessage {
+  int depth;
+  string16 name;
+
+  DottedPathMessage() : depth(0) {}
+
+  static void RegisterJSONConverter(
+      base::JSONValueConverter<DottedPathMessage>* converter) {
+    converter->RegisterIntField("a.b.depth", &DottedPathMessage::depth);
+    converter->RegisterStringField("name", &DottedPathMessage::name);
+  }
+};
+
 }  // namespace
 
 TEST(JSONValueConverterTest, ParseSimpleMessage) {
@@ -210,4 +225,147 @@ TEST(JSONValueConverterTest, RepeatedValueErrorInTheMiddle) {
   // No check the values as mentioned above.
 }
 
+TEST(JSONValueConverterTest, ConvertJSONSimpleMessage) {
+  const char normal_data[] =
+      "{\n"
+      "  \"foo\": 1,\n"
+      "  \"bar\": \"b\\\"ar\",\n"
+      "  \"baz\": true,\n"
+      "  \"unknown\": [{\"foo\": \"not an int\"}, null],\n"
+      "  \"simple_enum\": \"foo\","
+      "  \"ints\": [1, 2]"
+      "}\n";
+
+  SimpleMessage message;
+  base::JSONValueConverter<SimpleMessage> converter;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+
+  EXPECT_EQ(1, message.foo);
+  EXPECT_EQ("b\"ar", message.bar);
+  EXPECT_TRUE(message.baz);
+  EXPECT_EQ(SimpleMessage::FOO, message.simple_enum);
+  EXPECT_EQ(2, static_cast<int>(message.ints.size()));
+  EXPECT_EQ(1, *(message.ints[0]));
+  EXPECT_EQ(2, *(message.ints[1]));
+}
+
+TEST(JSONValueConverterTest, ConvertJSONNestedMessage) {
+  const char normal_data[] =
+      "{\n"
+      "  \"foo\": 1,\n"
+      "  \"child\": {\n"
+      "    \"foo\": 1,\n"
+      "    \"bar\": \"bar\",\n"
+      "    \"baz\": true\n"
+      "  },\n"
+      "  \"children\": [{\n"
+      "    \"foo\": 2,\n"
+      "    \"bar\": \"foobar\",\n"
+      "    \"baz\": true\n"
+      "  },\n"
+      "  {\n"
+      "    \"foo\": 3,\n"
+      "    \"bar\": \"barbaz\",\n"
+      "    \"baz\": false\n"
+      "  }]\n"
+      "}\n";
+
+  NestedMessage message;
+  base::JSONValueConverter<NestedMessage> converter;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+
+  // An integer is accepted for a double field, as in Convert().
+  EXPECT_EQ(1.0, message.foo);
+  EXPECT_EQ(1, message.child.foo);
+  EXPECT_EQ("bar", message.child.bar);
+  EXPECT_TRUE(message.child.baz);
+
+  ASSERT_EQ(2, static_cast<int>(message.children.size()));
+  EXPECT_EQ(2, message.children[0]->foo);
+  EXPECT_EQ("foobar", message.children[0]->bar);
+  EXPECT_TRUE(message.children[0]->baz);
+  EXPECT_EQ(3, message.children[1]->foo);
+  EXPECT_EQ("barbaz", message.children[1]->bar);
+  EXPECT_FALSE(message.children[1]->baz);
+}
+
+TEST(JSONValueConverterTest, ConvertJSONDottedPath) {
+  const char normal_data[] =
+      "{\n"
+      "  \"a\": {\"b\": {\"depth\": 2}, \"c\": 3},\n"
+      "  \"a.b\": {\"depth\": 5},\n"
+      "  \"name\": \"\\u00e9t\\u00e9\"\n"
+      "}\n";
+
+  DottedPathMessage message;
+  base::JSONValueConverter<DottedPathMessage> converter;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+
+  // Like DictionaryValue::Get(), the path does not match the "a.b" key.
+  EXPECT_EQ(2, message.depth);
+  EXPECT_EQ(WideToUTF16(L"\x00e9t\x00e9"), message.name);
+
+  // Convert() on the parsed Value agrees.
+  scoped_ptr<Value> value(base::JSONReader::Read(normal_data, false));
+  DottedPathMessage value_message;
+  EXPECT_TRUE(converter.Convert(*value.get(), &value_message));
+  EXPECT_EQ(message.depth, value_message.depth);
+  EXPECT_EQ(message.name, value_message.name);
+}
+
+TEST(JSONValueConverterTest, ConvertJSONDuplicateKeys) {
+  const char normal_data[] =
+      "{\n"
+      "  \"foo\": 1,\n"
+      "  \"ints\": [1, 2, 3],\n"
+      "  \"foo\": 2,\n"
+      "  \"ints\": [4]\n"
+      "}\n";
+
+  SimpleMessage message;
+  base::JSONValueConverter<SimpleMessage> converter;
+  EXPECT_TRUE(converter.ConvertJSON(normal_data, &message));
+
+  // Convert() on the parsed Value agrees: the last value of a key wins.
+  scoped_ptr<Value> value(base::JSONReader::Read(normal_data, false));
+  SimpleMessage value_message;
+  EXPECT_TRUE(converter.Convert(*value.get(), &value_message));
+
+  EXPECT_EQ(2, message.foo);
+  EXPECT_EQ(value_message.foo, message.foo);
+  ASSERT_EQ(1, static_cast<int>(message.ints.size()));
+  ASSERT_EQ(value_message.ints.size(), message.ints.size());
+  EXPECT_EQ(4, *(message.ints[0]));
+  EXPECT_EQ(*(value_message.ints[0]), *(message.ints[0]));
+}
+
+TEST(JSONValueConverterTest, ConvertJSONFailures) {
+  const char* const kFailures[] = {
+    // "bar" is an integer.
+    "{\"foo\": 1, \"bar\": 2}",
+    // "foo" is a double.
+    "{\"foo\": 1.5}",
+    // "foo" is null.
+    "{\"foo\": null}",
+    // The enum parser fails.
+    "{\"simple_enum\": \"baz\"}",
+    // An element of "ints" is not an int.
+    "{\"ints\": [1, false]}",
+    // "ints" is not a list.
+    "{\"ints\": {\"0\": 1}}",
+    // "baz" is a dictionary.
+    "{\"baz\": {}}",
+    // The root is not a dictionary.
+    "[{\"foo\": 1}]",
+    // Malformed JSON.
+    "{\"foo\": 1",
+  };
+
+  base::JSONValueConverter<SimpleMessage> converter;
+  for (size_t i = 0; i < arraysize(kFailures); ++i) {
+    SimpleMessage message;
+    EXPECT_FALSE(converter.ConvertJSON(kFailures[i], &message)) << kFailures[i];
+  }
+}
+
 }  // namespace base
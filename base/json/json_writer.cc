@@ -170,18 +170,15 @@ void JSONWriter::BuildJSONString(const Value* const node, int depth) {
 
         const DictionaryValue* dict =
           static_cast<const DictionaryValue*>(node);
-        for (DictionaryValue::key_iterator key_itr = dict->begin_keys();
-             key_itr != dict->end_keys();
-             ++key_itr) {
-          Value* value = NULL;
-          bool result = dict->GetWithoutPathExpansion(*key_itr, &value);
-          DCHECK(result);
-
+        bool first_entry = true;
+        for (DictionaryValue::Iterator itr(*dict); itr.HasNext();
+             itr.Advance(), first_entry = false) {
+          const Value* value = &itr.value();
           if (omit_binary_values_ && value->GetType() == Value::TYPE_BINARY) {
             continue;
           }
 
-          if (key_itr != dict->begin_keys()) {
+          if (!first_entry) {
             json_string_->append(",");
             if (pretty_print_)
               json_string_->append(kPrettyPrintLineEnding);
@@ -189,7 +186,7 @@ void JSONWriter::BuildJSONString(const Value* const node, int depth) {
 
           if (pretty_print_)
             IndentLine(depth + 1);
-          AppendQuotedString(*key_itr);
+          AppendQuotedString(itr.key());
           if (pretty_print_) {
             json_string_->append(": ");
           } else {
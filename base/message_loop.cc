@@ -155,7 +155,7 @@ MessageLoop::MessageLoop(Type type)
 #define MESSAGE_PUMP_IO NULL
 #elif defined(OS_POSIX)  // POSIX but not MACOSX.
 #define MESSAGE_PUMP_UI new base::MessagePumpForUI()
-#define MESSAGE_PUMP_IO new base::MessagePumpLibevent()
+#define MESSAGE_PUMP_IO new base::MessagePumpForIO()
 #else
 #error Not implemented
 #endif
@@ -304,6 +304,18 @@ void MessageLoop::PostNonNestableDelayedTask(
   PostNonNestableDelayedTask(from_here, task, delay.InMillisecondsRoundedUp());
 }
 
+void MessageLoop::ScheduleTimer(base::TimerWheel::Entry* timer,
+                                TimeTicks deadline) {
+  DCHECK_EQ(this, current());
+  TimeTicks old_run_time = GetNextDelayedRunTime();
+  timer_wheel_.Schedule(timer, deadline);
+  TimeTicks new_run_time = GetNextDelayedRunTime();
+  // The pump only needs to hear about a deadline that moved earlier.  It will
+  // ask DoDelayedWork() for a new one if it wakes up with nothing to do.
+  if (old_run_time.is_null() || new_run_time < old_run_time)
+    pump_->ScheduleDelayedWork(new_run_time);
+}
+
 void MessageLoop::Run() {
   AutoRunState save_state(this);
   RunHandler();
@@ -371,9 +383,8 @@ void MessageLoop::RemoveTaskObserver(TaskObserver* task_observer) {
 }
 
 void MessageLoop::AssertIdle() const {
-  // We only check |incoming_queue_|, since we don't want to lock |work_queue_|.
-  base::AutoLock lock(incoming_queue_lock_);
-  DCHECK(incoming_queue_.empty());
+  // We only check |incoming_queue_|, since |work_queue_| is not thread safe.
+  DCHECK(incoming_queue_.IsEmpty());
 }
 
 bool MessageLoop::is_running() const {
@@ -469,7 +480,8 @@ void MessageLoop::RunTask(const PendingTask& pending_task) {
                     DidProcessTask(pending_task.time_posted));
 
   tracked_objects::ThreadData::TallyRunOnNamedThreadIfTracking(pending_task,
-      start_time, tracked_objects::ThreadData::NowForEndOfRun());
+      start_time,
+      tracked_objects::ThreadData::NowForEndOfRun(pending_task.birth_tally));
 
   nestable_tasks_allowed_ = true;
 }
@@ -501,19 +513,13 @@ void MessageLoop::AddToDelayedWorkQueue(const PendingTask& pending_task) {
 void MessageLoop::ReloadWorkQueue() {
   // We can improve performance of our loading tasks from incoming_queue_ to
   // work_queue_ by waiting until the last minute (work_queue_ is empty) to
-  // load.  That reduces the number of locks-per-task significantly when our
+  // load.  That reduces the number of atomic operations per task when our
   // queues get large.
   if (!work_queue_.empty())
-    return;  // Wait till we *really* need to lock and load.
+    return;  // Wait till we *really* need to load.
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  {
-    base::AutoLock lock(incoming_queue_lock_);
-    if (incoming_queue_.empty())
-      return;
-    incoming_queue_.Swap(&work_queue_);  // Constant time
-    DCHECK(incoming_queue_.empty());
-  }
+  // Acquire all we can from the inter-thread queue in one pass.
+  incoming_queue_.ReloadWorkQueue(&work_queue_);
 }
 
 bool MessageLoop::DeletePendingTasks() {
@@ -555,9 +561,23 @@ bool MessageLoop::DeletePendingTasks() {
     delayed_work_queue_.pop();
   }
   should_leak_tasks_ = true;
+
+  // The timers are owned by their users, who see them stop running.
+  did_work |= !timer_wheel_.empty();
+  timer_wheel_.CancelAll();
   return did_work;
 }
 
+TimeTicks MessageLoop::GetNextDelayedRunTime() const {
+  TimeTicks next_run_time = timer_wheel_.NextWakeTime();
+  if (!delayed_work_queue_.empty()) {
+    TimeTicks task_run_time = delayed_work_queue_.top().delayed_run_time;
+    if (next_run_time.is_null() || task_run_time < next_run_time)
+      next_run_time = task_run_time;
+  }
+  return next_run_time;
+}
+
 TimeTicks MessageLoop::CalculateDelayedRuntime(int64 delay_ms) {
   TimeTicks delayed_run_time;
   if (delay_ms > 0) {
@@ -603,22 +623,14 @@ void MessageLoop::AddToIncomingQueue(PendingTask* pending_task) {
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
-  scoped_refptr<base::MessagePump> pump;
-  {
-    base::AutoLock locked(incoming_queue_lock_);
-
-    bool was_empty = incoming_queue_.empty();
-    incoming_queue_.push(*pending_task);
-    pending_task->task.Reset();
-    if (!was_empty)
-      return;  // Someone else should have started the sub-pump.
-
-    pump = pump_;
-  }
   // Since the incoming_queue_ may contain a task that destroys this message
-  // loop, we cannot exit incoming_queue_lock_ until we are done with |this|.
-  // We use a stack-based reference to the message pump so that we can call
-  // ScheduleWork outside of incoming_queue_lock_.
+  // loop, we cannot touch |this| once the task has been pushed.  We take a
+  // stack-based reference to the message pump beforehand so that we can still
+  // call ScheduleWork afterwards.
+  scoped_refptr<base::MessagePump> pump(pump_);
+
+  if (!incoming_queue_.Push(pending_task))
+    return;  // Someone else should have started the sub-pump.
 
   pump->ScheduleWork();
 }
@@ -662,9 +674,10 @@ bool MessageLoop::DoWork() {
       work_queue_.pop();
       if (!pending_task.delayed_run_time.is_null()) {
         AddToDelayedWorkQueue(pending_task);
-        // If we changed the topmost task, then it is time to reschedule.
+        // If we changed the topmost task, then it is time to reschedule (unless
+        // a timer is due even earlier).
         if (delayed_work_queue_.top().task.Equals(pending_task.task))
-          pump_->ScheduleDelayedWork(pending_task.delayed_run_time);
+          pump_->ScheduleDelayedWork(GetNextDelayedRunTime());
       } else {
         if (DeferOrRunPendingTask(pending_task))
           return true;
@@ -677,7 +690,8 @@ bool MessageLoop::DoWork() {
 }
 
 bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
-  if (!nestable_tasks_allowed_ || delayed_work_queue_.empty()) {
+  if (!nestable_tasks_allowed_ ||
+      (delayed_work_queue_.empty() && timer_wheel_.empty())) {
     recent_time_ = *next_delayed_work_time = TimeTicks();
     return false;
   }
@@ -689,7 +703,7 @@ bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
   // fall behind (and have a lot of ready-to-run delayed tasks), the more
   // efficient we'll be at handling the tasks.
 
-  TimeTicks next_run_time = delayed_work_queue_.top().delayed_run_time;
+  TimeTicks next_run_time = GetNextDelayedRunTime();
   if (next_run_time > recent_time_) {
     recent_time_ = TimeTicks::Now();  // Get a better view of Now();
     if (next_run_time > recent_time_) {
@@ -698,11 +712,32 @@ bool MessageLoop::DoDelayedWork(TimeTicks* next_delayed_work_time) {
     }
   }
 
+  // Run the timer or the delayed task that was due first.
+  timer_wheel_.AdvanceTo(recent_time_);
+  base::TimerWheel::Entry* timer = timer_wheel_.first_due();
+  if (timer && (delayed_work_queue_.empty() ||
+                timer->deadline() <
+                    delayed_work_queue_.top().delayed_run_time)) {
+    timer_wheel_.Cancel(timer);
+    *next_delayed_work_time = GetNextDelayedRunTime();
+    // The timer may be deleted as it runs, but not before.
+    return DeferOrRunPendingTask(PendingTask(
+        timer->posted_from(),
+        base::Bind(&base::TimerWheel::Entry::Run, base::Unretained(timer))));
+  }
+
+  if (delayed_work_queue_.empty() ||
+      delayed_work_queue_.top().delayed_run_time > recent_time_) {
+    // The wheel only had to cascade its timers.
+    *next_delayed_work_time = GetNextDelayedRunTime();
+    return false;
+  }
+
   PendingTask pending_task = delayed_work_queue_.top();
   delayed_work_queue_.pop();
 
-  if (!delayed_work_queue_.empty())
-    *next_delayed_work_time = delayed_work_queue_.top().delayed_run_time;
+  if (!delayed_work_queue_.empty() || !timer_wheel_.empty())
+    *next_delayed_work_time = GetNextDelayedRunTime();
 
   return DeferOrRunPendingTask(pending_task);
 }
@@ -814,10 +849,10 @@ bool MessageLoopForIO::WatchFileDescriptor(int fd,
                                            Mode mode,
                                            FileDescriptorWatcher *controller,
                                            Watcher *delegate) {
-  return pump_libevent()->WatchFileDescriptor(
+  return pump_io()->WatchFileDescriptor(
       fd,
       persistent,
-      static_cast<base::MessagePumpLibevent::Mode>(mode),
+      static_cast<base::MessagePumpForIO::Mode>(mode),
       controller,
       delegate);
 }
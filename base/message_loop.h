@@ -12,6 +12,7 @@
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/callback_forward.h"
+#include "base/incoming_task_queue.h"
 #include "base/location.h"
 #include "base/memory/ref_counted.h"
 #include "base/message_loop_proxy.h"
@@ -22,13 +23,18 @@
 #include "base/synchronization/lock.h"
 #include "base/tracking_info.h"
 #include "base/time.h"
+#include "base/timer_wheel.h"
 
 #if defined(OS_WIN)
 // We need this to declare base::MessagePumpWin::Dispatcher, which we should
 // really just eliminate.
 #include "base/message_pump_win.h"
 #elif defined(OS_POSIX)
+#if defined(OS_LINUX)
+#include "base/message_pump_epoll.h"
+#else
 #include "base/message_pump_libevent.h"
+#endif
 #if !defined(OS_MACOSX) && !defined(OS_ANDROID)
 
 #if defined(USE_WAYLAND)
@@ -46,6 +52,12 @@
 
 namespace base {
 class Histogram;
+
+#if defined(OS_LINUX)
+typedef MessagePumpEpoll MessagePumpForIO;
+#elif defined(OS_POSIX)
+typedef MessagePumpLibevent MessagePumpForIO;
+#endif
 }
 
 // A MessageLoop is used to process events for a particular thread.  There is
@@ -226,6 +238,16 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
         this, from_here, object);
   }
 
+  // Schedules |timer| to run on this loop once |deadline| has passed.  If the
+  // timer was already scheduled, it is moved to the new deadline.  Unlike a
+  // delayed task, a timer can be cancelled (see TimerWheel::Entry::Cancel()),
+  // which removes it from the loop at once, and scheduling or cancelling it
+  // takes constant time.  Timers run as nestable tasks.
+  //
+  // NOTE: This method, and the cancellation of a timer, may only be called on
+  // the thread that executes MessageLoop::Run().
+  void ScheduleTimer(base::TimerWheel::Entry* timer, base::TimeTicks deadline);
+
   // Run the message loop.
   void Run();
 
@@ -405,10 +427,6 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   base::MessagePumpWin* pump_win() {
     return static_cast<base::MessagePumpWin*>(pump_.get());
   }
-#elif defined(OS_POSIX)
-  base::MessagePumpLibevent* pump_libevent() {
-    return static_cast<base::MessagePumpLibevent*>(pump_.get());
-  }
 #endif
 
   // A function to encapsulate all the exception handling capability in the
@@ -448,8 +466,8 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   void AddToIncomingQueue(base::PendingTask* pending_task);
 
   // Load tasks from the incoming_queue_ into work_queue_ if the latter is
-  // empty.  The former requires a lock to access, while the latter is directly
-  // accessible on this thread.
+  // empty.  The former is shared with posting threads, while the latter is
+  // directly accessible on this thread.
   void ReloadWorkQueue();
 
   // Delete tasks that haven't run yet without running them.  Used in the
@@ -460,6 +478,10 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   // Calculates the time at which a PendingTask should run.
   base::TimeTicks CalculateDelayedRuntime(int64 delay_ms);
 
+  // Returns the earliest time at which a delayed task or timer may be ready to
+  // run, or a null TimeTicks if there are none.
+  base::TimeTicks GetNextDelayedRunTime() const;
+
   // Start recording histogram info about events and action IF it was enabled
   // and IF the statistics recorder can accept a registration of our histogram.
   void StartHistogrammer();
@@ -483,7 +505,12 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   // Contains delayed tasks, sorted by their 'delayed_run_time' property.
   base::DelayedTaskQueue delayed_work_queue_;
 
-  // A recent snapshot of Time::Now(), used to check delayed_work_queue_.
+  // Timers that are scheduled to run on this loop.  Like delayed_work_queue_,
+  // this is only accessed by our current thread.
+  base::TimerWheel timer_wheel_;
+
+  // A recent snapshot of Time::Now(), used to check delayed_work_queue_ and
+  // timer_wheel_.
   base::TimeTicks recent_time_;
 
   // A queue of non-nestable tasks that we had to defer because when it came
@@ -505,13 +532,10 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   // A profiling histogram showing the counts of various messages and events.
   base::Histogram* message_histogram_;
 
-  // A null terminated list which creates an incoming_queue of tasks that are
-  // acquired under a mutex for processing on this instance's thread. These
-  // tasks have not yet been sorted out into items for our work_queue_ vs items
-  // that will be handled by the TimerManager.
-  base::TaskQueue incoming_queue_;
-  // Protect access to incoming_queue_.
-  mutable base::Lock incoming_queue_lock_;
+  // A lock-free queue of tasks posted from any thread for processing on this
+  // instance's thread. These tasks have not yet been sorted out into items for
+  // our work_queue_ vs items that will be handled by the TimerManager.
+  base::IncomingTaskQueue incoming_queue_;
 
   RunState* state_;
 
@@ -613,15 +637,15 @@ class BASE_EXPORT MessageLoopForIO : public MessageLoop {
   typedef base::MessagePumpForIO::IOContext IOContext;
   typedef base::MessagePumpForIO::IOObserver IOObserver;
 #elif defined(OS_POSIX)
-  typedef base::MessagePumpLibevent::Watcher Watcher;
-  typedef base::MessagePumpLibevent::FileDescriptorWatcher
+  typedef base::MessagePumpForIO::Watcher Watcher;
+  typedef base::MessagePumpForIO::FileDescriptorWatcher
       FileDescriptorWatcher;
-  typedef base::MessagePumpLibevent::IOObserver IOObserver;
+  typedef base::MessagePumpForIO::IOObserver IOObserver;
 
   enum Mode {
-    WATCH_READ = base::MessagePumpLibevent::WATCH_READ,
-    WATCH_WRITE = base::MessagePumpLibevent::WATCH_WRITE,
-    WATCH_READ_WRITE = base::MessagePumpLibevent::WATCH_READ_WRITE
+    WATCH_READ = base::MessagePumpForIO::WATCH_READ,
+    WATCH_WRITE = base::MessagePumpForIO::WATCH_WRITE,
+    WATCH_READ_WRITE = base::MessagePumpForIO::WATCH_READ_WRITE
   };
 
 #endif
@@ -656,7 +680,7 @@ class BASE_EXPORT MessageLoopForIO : public MessageLoop {
   }
 
 #elif defined(OS_POSIX)
-  // Please see MessagePumpLibevent for definition.
+  // Please see MessagePumpEpoll (or MessagePumpLibevent) for definition.
   bool WatchFileDescriptor(int fd,
                            bool persistent,
                            Mode mode,
@@ -664,8 +688,8 @@ class BASE_EXPORT MessageLoopForIO : public MessageLoop {
                            Watcher* delegate);
 
  private:
-  base::MessagePumpLibevent* pump_io() {
-    return static_cast<base::MessagePumpLibevent*>(pump_.get());
+  base::MessagePumpForIO* pump_io() {
+    return static_cast<base::MessagePumpForIO*>(pump_.get());
   }
 #endif  // defined(OS_POSIX)
 };
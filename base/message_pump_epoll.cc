@@ -0,0 +1,427 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_pump_epoll.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "base/auto_reset.h"
+#include "base/eintr_wrapper.h"
+#include "base/logging.h"
+
+// Lifecycle of a watch
+// Each file descriptor that is watched has an FdState in fds_, which lists
+// its FileDescriptorWatchers.  The file descriptor is registered with epoll
+// for the union of the events that its armed watchers wait for, and the
+// registration is only changed (with a system call) when that union changes.
+// If none of the armed watchers is persistent, the registration is
+// edge-triggered and one-shot: the kernel disarms it when it fires, and the
+// one-shot watchers are disarmed as they are called.  A watcher that is
+// stopped or destroyed leaves the list, and the file descriptor is removed
+// from epoll once no armed watchers remain.
+
+namespace base {
+
+MessagePumpEpoll::FileDescriptorWatcher::FileDescriptorWatcher()
+    : fd_(-1),
+      events_(0),
+      is_persistent_(false),
+      armed_(false),
+      watcher_(NULL),
+      prev_(NULL),
+      next_(NULL) {
+}
+
+MessagePumpEpoll::FileDescriptorWatcher::~FileDescriptorWatcher() {
+  if (pump_)
+    StopWatchingFileDescriptor();
+}
+
+bool MessagePumpEpoll::FileDescriptorWatcher::StopWatchingFileDescriptor() {
+  if (!pump_)
+    return true;
+
+  scoped_refptr<MessagePumpEpoll> pump;
+  pump.swap(pump_);
+  pump->DetachWatcher(this);
+  int fd = fd_;
+  fd_ = -1;
+  events_ = 0;
+  is_persistent_ = false;
+  armed_ = false;
+  watcher_ = NULL;
+  return pump->UpdateRegistration(fd);
+}
+
+void MessagePumpEpoll::FileDescriptorWatcher::OnFileCanReadWithoutBlocking(
+    int fd, MessagePumpEpoll* pump) {
+  DCHECK(watcher_);
+  pump->WillProcessIOEvent();
+  watcher_->OnFileCanReadWithoutBlocking(fd);
+  pump->DidProcessIOEvent();
+}
+
+void MessagePumpEpoll::FileDescriptorWatcher::OnFileCanWriteWithoutBlocking(
+    int fd, MessagePumpEpoll* pump) {
+  DCHECK(watcher_);
+  pump->WillProcessIOEvent();
+  watcher_->OnFileCanWriteWithoutBlocking(fd);
+  pump->DidProcessIOEvent();
+}
+
+MessagePumpEpoll::FdState::FdState()
+    : first_watcher(NULL),
+      armed_events(0),
+      registered(false) {
+}
+
+MessagePumpEpoll::MessagePumpEpoll()
+    : keep_running_(true),
+      in_run_(false),
+      epoll_fd_(-1),
+      wakeup_fd_(-1),
+      events_(new epoll_event[kMaxEvents]),
+      next_event_(0),
+      num_events_(0),
+      dispatch_cursor_(NULL) {
+  if (!Init())
+     NOTREACHED();
+}
+
+MessagePumpEpoll::~MessagePumpEpoll() {
+  DCHECK(!dispatch_cursor_);
+  if (wakeup_fd_ >= 0) {
+    if (HANDLE_EINTR(close(wakeup_fd_)) < 0)
+      DPLOG(ERROR) << "close";
+  }
+  if (epoll_fd_ >= 0) {
+    if (HANDLE_EINTR(close(epoll_fd_)) < 0)
+      DPLOG(ERROR) << "close";
+  }
+}
+
+bool MessagePumpEpoll::WatchFileDescriptor(int fd,
+                                           bool persistent,
+                                           Mode mode,
+                                           FileDescriptorWatcher *controller,
+                                           Watcher *delegate) {
+  DCHECK_GE(fd, 0);
+  DCHECK(controller);
+  DCHECK(delegate);
+  DCHECK(mode == WATCH_READ || mode == WATCH_WRITE || mode == WATCH_READ_WRITE);
+  // WatchFileDescriptor should be called on the pump thread. It is not
+  // threadsafe, and your watcher may never be registered.
+  DCHECK(watch_file_descriptor_caller_checker_.CalledOnValidThread());
+
+  uint32 events = 0;
+  if ((mode & WATCH_READ) != 0)
+    events |= EPOLLIN;
+  if ((mode & WATCH_WRITE) != 0)
+    events |= EPOLLOUT;
+
+  if (controller->pump_ && controller->pump_ != this)
+    controller->StopWatchingFileDescriptor();
+
+  if (controller->pump_) {
+    // It's illegal to use this function to listen on 2 separate fds with the
+    // same |controller|.
+    if (controller->fd_ != fd) {
+      NOTREACHED() << "FDs don't match" << controller->fd_ << "!=" << fd;
+      return false;
+    }
+    // Combine old/new event masks.
+    events |= controller->events_;
+    persistent |= controller->is_persistent_;
+  } else {
+    controller->fd_ = fd;
+    controller->pump_ = this;
+    AttachWatcher(controller);
+  }
+
+  controller->events_ = events;
+  controller->is_persistent_ = persistent;
+  controller->armed_ = true;
+  controller->watcher_ = delegate;
+
+  if (!UpdateRegistration(fd)) {
+    controller->StopWatchingFileDescriptor();
+    return false;
+  }
+  return true;
+}
+
+void MessagePumpEpoll::AddIOObserver(IOObserver *obs) {
+  io_observers_.AddObserver(obs);
+}
+
+void MessagePumpEpoll::RemoveIOObserver(IOObserver *obs) {
+  io_observers_.RemoveObserver(obs);
+}
+
+// Reentrant!
+void MessagePumpEpoll::Run(Delegate* delegate) {
+  DCHECK(keep_running_) << "Quit must have been called outside of Run!";
+  AutoReset<bool> auto_reset_in_run(&in_run_, true);
+
+  for (;;) {
+    bool did_work = delegate->DoWork();
+    if (!keep_running_)
+      break;
+
+    did_work |= ProcessEvents(0);
+    if (!keep_running_)
+      break;
+
+    did_work |= delegate->DoDelayedWork(&delayed_work_time_);
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    did_work = delegate->DoIdleWork();
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    if (delayed_work_time_.is_null()) {
+      ProcessEvents(-1);
+    } else {
+      TimeDelta delay = delayed_work_time_ - TimeTicks::Now();
+      if (delay > TimeDelta()) {
+        // Round up, so as not to wake up just before the delayed work is due.
+        int64 timeout_ms = std::min<int64>(delay.InMillisecondsRoundedUp(),
+                                           std::numeric_limits<int>::max());
+        ProcessEvents(static_cast<int>(timeout_ms));
+      } else {
+        // It looks like delayed_work_time_ indicates a time in the past, so we
+        // need to call DoDelayedWork now.
+        delayed_work_time_ = TimeTicks();
+      }
+    }
+  }
+
+  keep_running_ = true;
+}
+
+void MessagePumpEpoll::Quit() {
+  DCHECK(in_run_);
+  // Tell both epoll_wait() and Run that they should break out of their loops.
+  keep_running_ = false;
+  ScheduleWork();
+}
+
+void MessagePumpEpoll::ScheduleWork() {
+  // Wake up epoll_wait(), in a threadsafe way.
+  uint64 value = 1;
+  int nwrite = HANDLE_EINTR(write(wakeup_fd_, &value, sizeof(value)));
+  DCHECK(nwrite == sizeof(value) || errno == EAGAIN)
+      << "[nwrite:" << nwrite << "] [errno:" << errno << "]";
+}
+
+void MessagePumpEpoll::ScheduleDelayedWork(
+    const TimeTicks& delayed_work_time) {
+  // We know that we can't be blocked on Wait right now since this method can
+  // only be called on the same thread as Run, so we only need to update our
+  // record of how long to sleep when we do sleep.
+  delayed_work_time_ = delayed_work_time;
+}
+
+void MessagePumpEpoll::WillProcessIOEvent() {
+  FOR_EACH_OBSERVER(IOObserver, io_observers_, WillProcessIOEvent());
+}
+
+void MessagePumpEpoll::DidProcessIOEvent() {
+  FOR_EACH_OBSERVER(IOObserver, io_observers_, DidProcessIOEvent());
+}
+
+bool MessagePumpEpoll::Init() {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0) {
+    DLOG(ERROR) << "epoll_create1() failed, errno: " << errno;
+    return false;
+  }
+  wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0) {
+    DLOG(ERROR) << "eventfd() failed, errno: " << errno;
+    return false;
+  }
+
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = wakeup_fd_;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event)) {
+    DLOG(ERROR) << "epoll_ctl() failed, errno: " << errno;
+    return false;
+  }
+  return true;
+}
+
+void MessagePumpEpoll::AttachWatcher(FileDescriptorWatcher* controller) {
+  int fd = controller->fd_;
+  if (static_cast<size_t>(fd) >= fds_.size())
+    fds_.resize(fd + 1);
+  FdState& state = fds_[fd];
+  controller->prev_ = NULL;
+  controller->next_ = state.first_watcher;
+  if (state.first_watcher)
+    state.first_watcher->prev_ = controller;
+  state.first_watcher = controller;
+}
+
+void MessagePumpEpoll::DetachWatcher(FileDescriptorWatcher* controller) {
+  for (DispatchCursor* cursor = dispatch_cursor_; cursor;
+       cursor = cursor->outer) {
+    if (cursor->current == controller)
+      cursor->current = NULL;
+    if (cursor->next == controller)
+      cursor->next = controller->next_;
+  }
+
+  FdState& state = fds_[controller->fd_];
+  if (controller->prev_)
+    controller->prev_->next_ = controller->next_;
+  else
+    state.first_watcher = controller->next_;
+  if (controller->next_)
+    controller->next_->prev_ = controller->prev_;
+  controller->prev_ = NULL;
+  controller->next_ = NULL;
+}
+
+bool MessagePumpEpoll::UpdateRegistration(int fd) {
+  FdState& state = fds_[fd];
+  uint32 events = 0;
+  bool persistent = false;
+  for (FileDescriptorWatcher* controller = state.first_watcher; controller;
+       controller = controller->next_) {
+    if (!controller->armed_)
+      continue;
+    events |= controller->events_;
+    persistent |= controller->is_persistent_;
+  }
+  if (events && !persistent)
+    events |= EPOLLET | EPOLLONESHOT;
+
+  if (!events) {
+    // A registration that has fired as one-shot reports nothing more, and is
+    // left in place for when the file descriptor is watched again.  Anything
+    // else is removed, as the kernel would report errors and hangups on it.
+    if (!state.registered || !state.armed_events)
+      return true;
+    state.registered = false;
+    state.armed_events = 0;
+    epoll_event event;
+    int rv = epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &event);
+    // The file descriptor may have been closed, which removes it from epoll.
+    return rv == 0 || errno == EBADF || errno == ENOENT;
+  }
+
+  if (state.registered && state.armed_events == events)
+    return true;
+
+  epoll_event event;
+  event.events = events;
+  event.data.fd = fd;
+  int rv = -1;
+  if (state.registered) {
+    rv = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+    // If the file descriptor was closed (which removes it from epoll) and the
+    // number reused, it has to be added again.
+    if (rv < 0 && errno == ENOENT)
+      state.registered = false;
+  }
+  if (!state.registered)
+    rv = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+  if (rv < 0) {
+    DPLOG(ERROR) << "epoll_ctl";
+    state.registered = false;
+    state.armed_events = 0;
+    return false;
+  }
+  state.registered = true;
+  state.armed_events = events;
+  return true;
+}
+
+bool MessagePumpEpoll::ProcessEvents(int timeout_ms) {
+  if (next_event_ == num_events_) {
+    next_event_ = 0;
+    num_events_ = HANDLE_EINTR(
+        epoll_wait(epoll_fd_, events_.get(), kMaxEvents, timeout_ms));
+    if (num_events_ < 0) {
+      DPLOG(ERROR) << "epoll_wait";
+      num_events_ = 0;
+    }
+  }
+
+  bool processed = false;
+  while (next_event_ < num_events_ && keep_running_) {
+    const epoll_event& event = events_[next_event_++];
+    processed = true;
+    if (event.data.fd == wakeup_fd_)
+      OnWakeup();
+    else
+      DispatchEvents(event.data.fd, event.events);
+  }
+  return processed;
+}
+
+void MessagePumpEpoll::DispatchEvents(int fd, uint32 events) {
+  if (static_cast<size_t>(fd) >= fds_.size())
+    return;
+  FdState& state = fds_[fd];
+  if (state.armed_events & EPOLLONESHOT)
+    state.armed_events = 0;  // The kernel disarmed the registration.
+
+  // Like libevent, report errors and hangups as readiness for both reading and
+  // writing, so that the watchers find out as they try.
+  bool can_read = (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0;
+  bool can_write = (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0;
+
+  DispatchCursor cursor = { NULL, state.first_watcher, dispatch_cursor_ };
+  dispatch_cursor_ = &cursor;
+  while (cursor.next) {
+    FileDescriptorWatcher* controller = cursor.next;
+    cursor.current = controller;
+    cursor.next = controller->next_;
+    if (!controller->armed_)
+      continue;
+    bool read = can_read && (controller->events_ & EPOLLIN);
+    bool write = can_write && (controller->events_ & EPOLLOUT);
+    if (!read && !write)
+      continue;
+    if (!controller->is_persistent_)
+      controller->armed_ = false;
+
+    if (write)
+      controller->OnFileCanWriteWithoutBlocking(fd, this);
+    // Check |cursor.current| in case the controller was stopped or deleted in
+    // OnFileCanWriteWithoutBlocking().
+    if (read && cursor.current)
+      controller->OnFileCanReadWithoutBlocking(fd, this);
+  }
+  dispatch_cursor_ = cursor.outer;
+
+  // Re-arm the file descriptor for the watchers that are still waiting, or
+  // remove it if there are none.
+  UpdateRegistration(fd);
+}
+
+void MessagePumpEpoll::OnWakeup() {
+  // Reset the eventfd counter, however many times ScheduleWork() was called.
+  uint64 value;
+  int nread = HANDLE_EINTR(read(wakeup_fd_, &value, sizeof(value)));
+  DCHECK(nread == sizeof(value) || errno == EAGAIN);
+}
+
+}  // namespace base
@@ -0,0 +1,224 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_PUMP_EPOLL_H_
+#define BASE_MESSAGE_PUMP_EPOLL_H_
+#pragma once
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_pump.h"
+#include "base/observer_list.h"
+#include "base/threading/thread_checker.h"
+#include "base/time.h"
+
+// Declare the struct we need from sys/epoll.h rather than including it.
+struct epoll_event;
+
+namespace base {
+
+// Class to monitor sockets and issue callbacks when sockets are ready for I/O,
+// using epoll directly.  It has the same interface as MessagePumpLibevent,
+// and is the pump of MessageLoopForIO on Linux.
+//
+// Each epoll_wait() hands back a batch of ready file descriptors, which are
+// all dispatched before the pump waits again.  One-shot watches are
+// registered edge-triggered and one-shot, so that the kernel disarms them as
+// they fire, and watching again takes a single epoll_ctl().  Persistent
+// watches are level-triggered, and cost no system calls as they fire;  their
+// watchers need not read or write until the file descriptor would block.
+class BASE_EXPORT MessagePumpEpoll : public MessagePump {
+ public:
+  class IOObserver {
+   public:
+    IOObserver() {}
+
+    // An IOObserver is an object that receives IO notifications from the
+    // MessagePump.
+    //
+    // NOTE: An IOObserver implementation should be extremely fast!
+    virtual void WillProcessIOEvent() = 0;
+    virtual void DidProcessIOEvent() = 0;
+
+   protected:
+    virtual ~IOObserver() {}
+  };
+
+  class FileDescriptorWatcher;
+
+  // Used with WatchFileDescriptor to asynchronously monitor the I/O readiness
+  // of a file descriptor.
+  class Watcher {
+   public:
+    virtual ~Watcher() {}
+    // Called from MessageLoop::Run when an FD can be read from/written to
+    // without blocking
+    virtual void OnFileCanReadWithoutBlocking(int fd) = 0;
+    virtual void OnFileCanWriteWithoutBlocking(int fd) = 0;
+  };
+
+  // Object returned by WatchFileDescriptor to manage further watching.
+  class BASE_EXPORT FileDescriptorWatcher {
+   public:
+    FileDescriptorWatcher();
+    ~FileDescriptorWatcher();  // Implicitly calls StopWatchingFileDescriptor.
+
+    // Stop watching the FD, always safe to call.  No-op if there's nothing
+    // to do.
+    bool StopWatchingFileDescriptor();
+
+   private:
+    friend class MessagePumpEpoll;
+    friend class MessagePumpEpollTest;
+
+    void OnFileCanReadWithoutBlocking(int fd, MessagePumpEpoll* pump);
+    void OnFileCanWriteWithoutBlocking(int fd, MessagePumpEpoll* pump);
+
+    int fd_;
+    // The epoll events that are watched for, which accumulate over calls to
+    // WatchFileDescriptor() until watching stops.
+    uint32 events_;
+    bool is_persistent_;  // false if this watch is one-shot.
+    // True until a one-shot watch fires.
+    bool armed_;
+
+    // The pump is kept alive by the watchers that are attached to it, so that
+    // a watcher may outlive its MessageLoop.
+    scoped_refptr<MessagePumpEpoll> pump_;
+    Watcher* watcher_;
+
+    // Links in the list of watchers of fd_.
+    FileDescriptorWatcher* prev_;
+    FileDescriptorWatcher* next_;
+
+    DISALLOW_COPY_AND_ASSIGN(FileDescriptorWatcher);
+  };
+
+  enum Mode {
+    WATCH_READ = 1 << 0,
+    WATCH_WRITE = 1 << 1,
+    WATCH_READ_WRITE = WATCH_READ | WATCH_WRITE
+  };
+
+  MessagePumpEpoll();
+  virtual ~MessagePumpEpoll();
+
+  // Have the current thread's message loop watch for a a situation in which
+  // reading/writing to the FD can be performed without blocking.
+  // Callers must provide a preallocated FileDescriptorWatcher object which
+  // can later be used to manage the lifetime of this event.
+  // If a FileDescriptorWatcher is passed in which is already attached to
+  // an event, then the effect is cumulative i.e. after the call |controller|
+  // will watch both the previous event and the new one.
+  // Several FileDescriptorWatchers may watch the same FD.
+  // Returns true on success.
+  // Must be called on the same thread the message_pump is running on.
+  bool WatchFileDescriptor(int fd,
+                           bool persistent,
+                           Mode mode,
+                           FileDescriptorWatcher *controller,
+                           Watcher *delegate);
+
+  void AddIOObserver(IOObserver* obs);
+  void RemoveIOObserver(IOObserver* obs);
+
+  // MessagePump methods:
+  virtual void Run(Delegate* delegate) OVERRIDE;
+  virtual void Quit() OVERRIDE;
+  virtual void ScheduleWork() OVERRIDE;
+  virtual void ScheduleDelayedWork(const TimeTicks& delayed_work_time) OVERRIDE;
+
+ private:
+  friend class MessagePumpEpollTest;
+
+  // The most ready file descriptors that are taken from the kernel at once.
+  static const int kMaxEvents = 64;
+
+  // How a file descriptor is registered with epoll.
+  struct FdState {
+    FdState();
+
+    // The watchers of the file descriptor.
+    FileDescriptorWatcher* first_watcher;
+
+    // The events that the kernel reports for the file descriptor, or 0 if a
+    // one-shot registration has fired.  Only meaningful if |registered|.
+    uint32 armed_events;
+    bool registered;
+  };
+
+  // The position of a loop over the watchers of a file descriptor.  If the
+  // watcher being called stops watching, |current| is cleared, and if the
+  // one to be called next does, |next| is advanced.  Loops may be nested, if
+  // a watcher runs a nested MessageLoop.
+  struct DispatchCursor {
+    FileDescriptorWatcher* current;
+    FileDescriptorWatcher* next;
+    DispatchCursor* outer;
+  };
+
+  void WillProcessIOEvent();
+  void DidProcessIOEvent();
+
+  // Risky part of constructor.  Returns true on success.
+  bool Init();
+
+  // Adds |controller| to, or removes it from, the watchers of its fd_.
+  void AttachWatcher(FileDescriptorWatcher* controller);
+  void DetachWatcher(FileDescriptorWatcher* controller);
+
+  // Brings the epoll registration of |fd| in line with the events that its
+  // armed watchers wait for.  Returns false if epoll_ctl() failed.
+  bool UpdateRegistration(int fd);
+
+  // Dispatches the ready file descriptors that are left from the last
+  // epoll_wait(), or else waits up to |timeout_ms| (-1 meaning forever) for
+  // more.  Returns true if any were dispatched, or the pump was woken up.
+  bool ProcessEvents(int timeout_ms);
+
+  // Calls the armed watchers of |fd| that wait for |events|.
+  void DispatchEvents(int fd, uint32 events);
+
+  // Reads and discards the value of wakeup_fd_.
+  void OnWakeup();
+
+  // This flag is set to false when Run should return.
+  bool keep_running_;
+
+  // This flag is set when inside Run.
+  bool in_run_;
+
+  // The time at which we should call DoDelayedWork.
+  TimeTicks delayed_work_time_;
+
+  // The epoll instance that watches all file descriptors.
+  int epoll_fd_;
+
+  // eventfd used to implement ScheduleWork().
+  int wakeup_fd_;
+
+  // The watchers of each file descriptor, indexed by file descriptor.
+  std::vector<FdState> fds_;
+
+  // The batch of ready file descriptors from the last epoll_wait(), of which
+  // the ones from |next_event_| to |num_events_| remain to be dispatched.
+  scoped_array<epoll_event> events_;
+  int next_event_;
+  int num_events_;
+
+  // The innermost loop over the watchers of a file descriptor, if any.
+  DispatchCursor* dispatch_cursor_;
+
+  ObserverList<IOObserver> io_observers_;
+  ThreadChecker watch_file_descriptor_caller_checker_;
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpEpoll);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_PUMP_EPOLL_H_
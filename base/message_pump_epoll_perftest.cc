@@ -0,0 +1,167 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/eintr_wrapper.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_pump_epoll.h"
+#include "base/message_pump_libevent.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// The number of sockets that are watched, and of messages that are passed
+// between them at any time.
+const int kSockets = 4000;
+const int kMessagesInFlight = 64;
+
+const int kEvents = 500000;
+
+// Runs a pump until it is told to quit.
+class NoWorkDelegate : public MessagePump::Delegate {
+ public:
+  virtual bool DoWork() OVERRIDE { return false; }
+  virtual bool DoDelayedWork(TimeTicks* next_delayed_work_time) OVERRIDE {
+    return false;
+  }
+  virtual bool DoIdleWork() OVERRIDE { return false; }
+};
+
+template <class Pump>
+class Relay;
+
+// Passes one-byte messages around a ring of socket pairs, which are all
+// watched by one pump, until kEvents have been read.
+template <class Pump>
+class RelayRing {
+ public:
+  RelayRing(Pump* pump, bool persistent)
+      : pump_(pump), persistent_(persistent), events_(0) {
+    for (int i = 0; i < kSockets; ++i)
+      relays_.push_back(new Relay<Pump>(this, i));
+  }
+
+  Pump* pump() const { return pump_; }
+  bool persistent() const { return persistent_; }
+
+  // Called as a relay reads a message.  Returns the socket to send the
+  // message on to, or -1 once enough messages have been read.
+  int OnRead(int index) {
+    if (++events_ == kEvents) {
+      pump_->Quit();
+      return -1;
+    }
+    // Jump around the ring, as the sockets of a busy server would be ready in
+    // no particular order.
+    return relays_[(index * 7919 + 1) % kSockets]->peer_fd();
+  }
+
+  void Run(const std::string& name) {
+    for (int i = 0; i < kSockets; ++i)
+      relays_[i]->Watch();
+    for (int i = 0; i < kMessagesInFlight; ++i)
+      relays_[i * (kSockets / kMessagesInFlight)]->Send();
+
+    NoWorkDelegate delegate;
+    PerfTimer timer;
+    pump_->Run(&delegate);
+    LogPerfResult(name.c_str(),
+                  timer.Elapsed().InMicroseconds() * 1000.0 / kEvents,
+                  "ns/event");
+  }
+
+ private:
+  Pump* pump_;
+  bool persistent_;
+  int events_;
+  ScopedVector<Relay<Pump> > relays_;
+};
+
+template <class Pump>
+class Relay : public Pump::Watcher {
+ public:
+  Relay(RelayRing<Pump>* ring, int index) : ring_(ring), index_(index) {
+    CHECK_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+  }
+
+  virtual ~Relay() {
+    controller_.StopWatchingFileDescriptor();
+    for (int i = 0; i < 2; ++i)
+      HANDLE_EINTR(close(fds_[i]));
+  }
+
+  int peer_fd() const { return fds_[1]; }
+
+  void Watch() {
+    CHECK(ring_->pump()->WatchFileDescriptor(
+        fds_[0], ring_->persistent(), Pump::WATCH_READ, &controller_, this));
+  }
+
+  void Send() {
+    char buf = 0;
+    CHECK_EQ(1, HANDLE_EINTR(write(fds_[1], &buf, 1)));
+  }
+
+  // Pump::Watcher interface
+  virtual void OnFileCanReadWithoutBlocking(int fd) OVERRIDE {
+    char buf;
+    CHECK_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    int next_fd = ring_->OnRead(index_);
+    if (next_fd < 0)
+      return;
+    CHECK_EQ(1, HANDLE_EINTR(write(next_fd, &buf, 1)));
+    // A one-shot watch has to be renewed, as sockets do after each read.
+    if (!ring_->persistent())
+      Watch();
+  }
+  virtual void OnFileCanWriteWithoutBlocking(int fd) OVERRIDE {
+    NOTREACHED();
+  }
+
+ private:
+  RelayRing<Pump>* ring_;
+  int index_;
+  int fds_[2];
+  typename Pump::FileDescriptorWatcher controller_;
+
+  DISALLOW_COPY_AND_ASSIGN(Relay);
+};
+
+template <class Pump>
+void RunRelay(const char* pump_name, bool persistent) {
+  scoped_refptr<Pump> pump(new Pump);
+  RelayRing<Pump> ring(pump.get(), persistent);
+  ring.Run(StringPrintf("MessagePump_%s_%s_%dsockets", pump_name,
+                        persistent ? "Persistent" : "OneShot", kSockets));
+}
+
+}  // namespace
+
+TEST(MessagePumpEpollPerfTest, LibeventOneShot) {
+  RunRelay<MessagePumpLibevent>("Libevent", false);
+}
+
+TEST(MessagePumpEpollPerfTest, EpollOneShot) {
+  RunRelay<MessagePumpEpoll>("Epoll", false);
+}
+
+TEST(MessagePumpEpollPerfTest, LibeventPersistent) {
+  RunRelay<MessagePumpLibevent>("Libevent", true);
+}
+
+TEST(MessagePumpEpollPerfTest, EpollPersistent) {
+  RunRelay<MessagePumpEpoll>("Epoll", true);
+}
+
+}  // namespace base
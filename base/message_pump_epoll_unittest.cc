@@ -0,0 +1,266 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_pump_epoll.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "base/compiler_specific.h"
+#include "base/eintr_wrapper.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+// Runs a pump until it has nothing left to do.
+class RunUntilIdleDelegate : public MessagePump::Delegate {
+ public:
+  explicit RunUntilIdleDelegate(MessagePump* pump) : pump_(pump) {}
+
+  virtual bool DoWork() OVERRIDE { return false; }
+  virtual bool DoDelayedWork(TimeTicks* next_delayed_work_time) OVERRIDE {
+    return false;
+  }
+  virtual bool DoIdleWork() OVERRIDE {
+    pump_->Quit();
+    return false;
+  }
+
+ private:
+  MessagePump* pump_;
+};
+
+class MessagePumpEpollTest : public testing::Test {
+ protected:
+  MessagePumpEpollTest() : pump_(new MessagePumpEpoll) {}
+
+  virtual void SetUp() {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds_));
+  }
+
+  virtual void TearDown() {
+    for (int i = 0; i < 2; ++i) {
+      if (HANDLE_EINTR(close(fds_[i])) < 0)
+        PLOG(ERROR) << "close";
+    }
+  }
+
+  MessagePumpEpoll* pump() { return pump_.get(); }
+
+  void RunUntilIdle() {
+    RunUntilIdleDelegate delegate(pump_.get());
+    pump_->Run(&delegate);
+  }
+
+  // Writes |size| bytes to the other end of fd().
+  void WritePeer(int size) {
+    std::string data(size, 'x');
+    ASSERT_EQ(size, HANDLE_EINTR(write(fds_[1], data.data(), size)));
+  }
+
+  // Reports that fd() is ready for reading and writing, as if epoll had.
+  void SpoofEvents() {
+    pump_->DispatchEvents(fd(), EPOLLIN | EPOLLOUT);
+  }
+
+  int fd() const { return fds_[0]; }
+
+  scoped_refptr<MessagePumpEpoll> pump_;
+  int fds_[2];
+};
+
+namespace {
+
+// Counts its notifications, and reads a byte each time it can read.
+class CountingWatcher : public MessagePumpEpoll::Watcher {
+ public:
+  CountingWatcher() : reads_(0), writes_(0) {}
+  virtual ~CountingWatcher() {}
+
+  // base:MessagePumpEpoll::Watcher interface
+  virtual void OnFileCanReadWithoutBlocking(int fd) {
+    char buf;
+    EXPECT_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    ++reads_;
+  }
+  virtual void OnFileCanWriteWithoutBlocking(int fd) {
+    ++writes_;
+  }
+
+  int reads() const { return reads_; }
+  int writes() const { return writes_; }
+
+ private:
+  int reads_;
+  int writes_;
+};
+
+TEST_F(MessagePumpEpollTest, OneShot) {
+  MessagePumpEpoll::FileDescriptorWatcher controller;
+  CountingWatcher watcher;
+  WritePeer(2);
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_READ, &controller, &watcher));
+  RunUntilIdle();
+  EXPECT_EQ(1, watcher.reads());
+
+  // The watch fired, even though there is still data to read.
+  RunUntilIdle();
+  EXPECT_EQ(1, watcher.reads());
+
+  // Watching again finds the data that is left.
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_READ, &controller, &watcher));
+  RunUntilIdle();
+  EXPECT_EQ(2, watcher.reads());
+  EXPECT_EQ(0, watcher.writes());
+}
+
+// Persistent watchers are called for as long as the file descriptor is ready,
+// even if they do not read all there is.
+TEST_F(MessagePumpEpollTest, Persistent) {
+  MessagePumpEpoll::FileDescriptorWatcher controller;
+  CountingWatcher watcher;
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), true, MessagePumpEpoll::WATCH_READ, &controller, &watcher));
+  WritePeer(3);
+  RunUntilIdle();
+  EXPECT_EQ(3, watcher.reads());
+
+  WritePeer(1);
+  RunUntilIdle();
+  EXPECT_EQ(4, watcher.reads());
+
+  controller.StopWatchingFileDescriptor();
+  WritePeer(1);
+  RunUntilIdle();
+  EXPECT_EQ(4, watcher.reads());
+}
+
+// A file descriptor may have separate watchers for reading and writing, as
+// sockets do.  One of them firing does not disarm the other.
+TEST_F(MessagePumpEpollTest, SeparateReadAndWriteWatchers) {
+  MessagePumpEpoll::FileDescriptorWatcher read_controller;
+  MessagePumpEpoll::FileDescriptorWatcher write_controller;
+  CountingWatcher read_watcher;
+  CountingWatcher write_watcher;
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_READ, &read_controller,
+      &read_watcher));
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_WRITE, &write_controller,
+      &write_watcher));
+
+  // The socket is writable at once.
+  RunUntilIdle();
+  EXPECT_EQ(1, write_watcher.writes());
+  EXPECT_EQ(0, read_watcher.reads());
+
+  WritePeer(1);
+  RunUntilIdle();
+  EXPECT_EQ(1, read_watcher.reads());
+  EXPECT_EQ(1, write_watcher.writes());
+  EXPECT_EQ(0, read_watcher.writes());
+  EXPECT_EQ(0, write_watcher.reads());
+}
+
+// Watching again for another mode adds to the previous one.
+TEST_F(MessagePumpEpollTest, Cumulative) {
+  MessagePumpEpoll::FileDescriptorWatcher controller;
+  CountingWatcher watcher;
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_READ, &controller, &watcher));
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_WRITE, &controller, &watcher));
+  WritePeer(1);
+  RunUntilIdle();
+  EXPECT_EQ(1, watcher.reads());
+  EXPECT_EQ(1, watcher.writes());
+}
+
+// Stops watching a file descriptor, and a second watcher of it, as it is
+// notified.
+class StopWatcher : public MessagePumpEpoll::Watcher {
+ public:
+  StopWatcher(MessagePumpEpoll::FileDescriptorWatcher* controller,
+              MessagePumpEpoll::FileDescriptorWatcher* other_controller)
+      : controller_(controller),
+        other_controller_(other_controller),
+        notifications_(0) {
+  }
+  virtual ~StopWatcher() {}
+
+  // base:MessagePumpEpoll::Watcher interface
+  virtual void OnFileCanReadWithoutBlocking(int /* fd */) {
+    NOTREACHED();
+  }
+  virtual void OnFileCanWriteWithoutBlocking(int /* fd */) {
+    ++notifications_;
+    controller_->StopWatchingFileDescriptor();
+    other_controller_->StopWatchingFileDescriptor();
+  }
+
+  int notifications() const { return notifications_; }
+
+ private:
+  MessagePumpEpoll::FileDescriptorWatcher* const controller_;
+  MessagePumpEpoll::FileDescriptorWatcher* const other_controller_;
+  int notifications_;
+};
+
+TEST_F(MessagePumpEpollTest, StopWatchers) {
+  MessagePumpEpoll::FileDescriptorWatcher controller1;
+  MessagePumpEpoll::FileDescriptorWatcher controller2;
+  StopWatcher watcher1(&controller1, &controller2);
+  StopWatcher watcher2(&controller2, &controller1);
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), true, MessagePumpEpoll::WATCH_READ_WRITE, &controller1,
+      &watcher1));
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), true, MessagePumpEpoll::WATCH_READ_WRITE, &controller2,
+      &watcher2));
+
+  // Whichever watcher is called first stops both.
+  SpoofEvents();
+  EXPECT_EQ(1, watcher1.notifications() + watcher2.notifications());
+  RunUntilIdle();
+  EXPECT_EQ(1, watcher1.notifications() + watcher2.notifications());
+}
+
+// Deletes the controller of a file descriptor as it is notified.
+class DeleteWatcher : public MessagePumpEpoll::Watcher {
+ public:
+  explicit DeleteWatcher(MessagePumpEpoll::FileDescriptorWatcher* controller)
+      : controller_(controller) {
+    DCHECK(controller_);
+  }
+  virtual ~DeleteWatcher() {}
+
+  // base:MessagePumpEpoll::Watcher interface
+  virtual void OnFileCanReadWithoutBlocking(int /* fd */) {
+    NOTREACHED();
+  }
+  virtual void OnFileCanWriteWithoutBlocking(int /* fd */) {
+    delete controller_;
+  }
+
+ private:
+  MessagePumpEpoll::FileDescriptorWatcher* const controller_;
+};
+
+TEST_F(MessagePumpEpollTest, DeleteWatcher) {
+  MessagePumpEpoll::FileDescriptorWatcher* controller =
+      new MessagePumpEpoll::FileDescriptorWatcher;
+  DeleteWatcher watcher(controller);
+  ASSERT_TRUE(pump()->WatchFileDescriptor(
+      fd(), false, MessagePumpEpoll::WATCH_READ_WRITE, controller, &watcher));
+  SpoofEvents();
+}
+
+}  // namespace
+
+}  // namespace base
@@ -48,13 +48,13 @@ class MessagePumpLibeventTest : public testing::Test {
 
 namespace {
 
-// Concrete implementation of MessagePumpLibevent::Watcher that does
+// Concrete implementation of MessageLoopForIO::Watcher that does
 // nothing useful.
-class StupidWatcher : public MessagePumpLibevent::Watcher {
+class StupidWatcher : public MessageLoopForIO::Watcher {
  public:
   virtual ~StupidWatcher() {}
 
-  // base:MessagePumpLibevent::Watcher interface
+  // base:MessageLoopForIO::Watcher interface
   virtual void OnFileCanReadWithoutBlocking(int fd) {}
   virtual void OnFileCanWriteWithoutBlocking(int fd) {}
 };
@@ -64,7 +64,7 @@ class StupidWatcher : public MessagePumpLibevent::Watcher {
 // Test to make sure that we catch calling WatchFileDescriptor off of the
 // wrong thread.
 TEST_F(MessagePumpLibeventTest, TestWatchingFromBadThread) {
-  MessagePumpLibevent::FileDescriptorWatcher watcher;
+  MessageLoopForIO::FileDescriptorWatcher watcher;
   StupidWatcher delegate;
 
   ASSERT_DEATH(io_loop()->WatchFileDescriptor(
@@ -14,14 +14,99 @@
 #include <algorithm>
 #include <string>
 
+#include "base/bits.h"
 #include "base/debug/leak_annotations.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/stringprintf.h"
 #include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
 
 namespace base {
 
+namespace {
+
+// Samples below 2^kBucketIndexSubBits get a slot of the bucket index each;
+// above that, every power of two is split into 2^kBucketIndexSubBits slots.
+const int kBucketIndexSubBits = 3;
+
+// Map |value| to its slot in CachedRanges::bucket_index_.  Slots are in the
+// same order as the samples they hold, and none spans more than 1/8th of its
+// smallest sample.
+size_t BucketIndexSlot(Histogram::Sample value) {
+  DCHECK_GE(value, 0);
+  if (value < (1 << kBucketIndexSubBits))
+    return value;
+  int shift = bits::Log2Floor(value) - kBucketIndexSubBits;
+  size_t sub_slot = (value >> shift) & ((1 << kBucketIndexSubBits) - 1);
+  return ((shift + 1) << kBucketIndexSubBits) + sub_slot;
+}
+
+// The smallest sample that maps to |slot|.
+Histogram::Sample BucketIndexSlotStart(size_t slot) {
+  if (slot < (1u << kBucketIndexSubBits))
+    return static_cast<Histogram::Sample>(slot);
+  int shift = static_cast<int>(slot >> kBucketIndexSubBits) - 1;
+  int sub_slot = static_cast<int>(slot & ((1 << kBucketIndexSubBits) - 1));
+  return ((1 << kBucketIndexSubBits) + sub_slot) << shift;
+}
+
+// A 64-bit total that many threads can add to.  32-bit CPUs have no 64-bit
+// atomic increment, so there the total is split in two words and carries are
+// added to the high word after the low one.  A snapshot taken in between is
+// off by the carry, which is rare enough to be tolerated like other skew.
+#if defined(ARCH_CPU_64_BITS)
+struct AtomicTotal {
+  subtle::Atomic64 value;
+};
+
+void AddToTotal(AtomicTotal* total, int64 increment) {
+  subtle::NoBarrier_AtomicIncrement(&total->value, increment);
+}
+
+int64 ReadTotal(const AtomicTotal& total) {
+  return subtle::NoBarrier_Load(&total.value);
+}
+#else
+struct AtomicTotal {
+  subtle::Atomic32 low;
+  subtle::Atomic32 high;
+};
+
+void AddToTotal(AtomicTotal* total, int64 increment) {
+  uint32 low_increment = static_cast<uint32>(increment);
+  int32 high_increment = static_cast<int32>(increment >> 32);
+  uint32 low = static_cast<uint32>(subtle::NoBarrier_AtomicIncrement(
+      &total->low, static_cast<subtle::Atomic32>(low_increment)));
+  if (low < low_increment)
+    ++high_increment;  // The low word wrapped around.
+  if (high_increment)
+    subtle::NoBarrier_AtomicIncrement(&total->high, high_increment);
+}
+
+int64 ReadTotal(const AtomicTotal& total) {
+  subtle::Atomic32 high;
+  uint32 low;
+  do {
+    high = subtle::NoBarrier_Load(&total.high);
+    low = static_cast<uint32>(subtle::NoBarrier_Load(&total.low));
+  } while (high != subtle::NoBarrier_Load(&total.high));
+  return high * (static_cast<int64>(1) << 32) + low;
+}
+#endif  // defined(ARCH_CPU_64_BITS)
+
+// One more than the index of the calling thread's shard, or 0 if the thread
+// has not added to any histogram yet.
+LazyInstance<ThreadLocalStorage::Slot>::Leaky g_shard_slot =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Shards are handed out to threads round robin.
+subtle::Atomic32 g_last_shard = 0;
+
+}  // namespace
+
 // Static table of checksums for all possible 8 bit bytes.
 const uint32 Histogram::kCrcTable[256] = {0x0, 0x77073096L, 0xee0e612cL,
 0x990951baL, 0x76dc419L, 0x706af48fL, 0xe963a535L, 0x9e6495a3L, 0xedb8832L,
@@ -393,11 +478,8 @@ size_t Histogram::bucket_count() const {
   return bucket_count_;
 }
 
-// Do a safe atomic snapshot of sample data.
-// This implementation assumes we are on a safe single thread.
 void Histogram::SnapshotSample(SampleSet* sample) const {
-  // Note locking not done in this version!!!
-  *sample = sample_;
+  sample_.Snapshot(sample);
 }
 
 bool Histogram::HasConstructorArguments(Sample minimum,
@@ -491,6 +573,7 @@ void Histogram::InitializeBucketRange() {
     SetBucketRange(bucket_index, current);
   }
   ResetRangeChecksum();
+  cached_ranges_->InitializeBucketIndex();
 
   DCHECK_EQ(bucket_count(), bucket_index);
 }
@@ -500,10 +583,13 @@ bool Histogram::PrintEmptyBucket(size_t index) const {
 }
 
 size_t Histogram::BucketIndex(Sample value) const {
-  // Use simple binary search.  This is very general, but there are better
-  // approaches if we knew that the buckets were linearly distributed.
   DCHECK_LE(ranges(0), value);
   DCHECK_GT(ranges(bucket_count()), value);
+  if (cached_ranges_->has_bucket_index())
+    return cached_ranges_->FindBucket(value);
+
+  // Use simple binary search.  This is very general, but there are better
+  // approaches if we knew that the buckets were linearly distributed.
   size_t under = 0;
   size_t over = bucket_count();
   size_t mid;
@@ -553,7 +639,6 @@ const std::string Histogram::GetAsciiBucketRange(size_t i) const {
 
 // Update histogram data with new sample.
 void Histogram::Accumulate(Sample value, Count count, size_t index) {
-  // Note locking not done in this version!!!
   sample_.Accumulate(value, count, index);
 }
 
@@ -800,6 +885,115 @@ bool Histogram::SampleSet::Deserialize(PickleIterator* iter) {
   return count == redundant_count_;
 }
 
+//------------------------------------------------------------------------------
+// Methods for the Histogram::ShardedSampleSet class
+//------------------------------------------------------------------------------
+
+struct Histogram::ShardedSampleSet::Shard {
+  explicit Shard(size_t bucket_count)
+      : counts(new subtle::Atomic32[bucket_count]()),
+        sum(),
+        redundant_count() {
+  }
+
+  scoped_array<subtle::Atomic32> counts;
+  AtomicTotal sum;
+  AtomicTotal redundant_count;
+};
+
+Histogram::ShardedSampleSet::ShardedSampleSet()
+    : bucket_count_(0) {
+  for (size_t i = 0; i < kShardCount; ++i)
+    shards_[i] = 0;
+}
+
+Histogram::ShardedSampleSet::~ShardedSampleSet() {
+  for (size_t i = 0; i < kShardCount; ++i)
+    delete reinterpret_cast<Shard*>(shards_[i]);
+}
+
+void Histogram::ShardedSampleSet::Resize(const Histogram& histogram) {
+  for (size_t i = 0; i < kShardCount; ++i)
+    DCHECK(!shards_[i]);
+  bucket_count_ = histogram.bucket_count();
+}
+
+void Histogram::ShardedSampleSet::Accumulate(Sample value, Count count,
+                                             size_t index) {
+  DCHECK(count == 1 || count == -1);
+  DCHECK_LT(index, bucket_count_);
+  Shard* shard = GetShard();
+  subtle::NoBarrier_AtomicIncrement(&shard->counts[index], count);
+  AddToTotal(&shard->sum, static_cast<int64>(count) * value);
+  AddToTotal(&shard->redundant_count, count);
+}
+
+void Histogram::ShardedSampleSet::Add(const SampleSet& other) {
+  DCHECK_EQ(bucket_count_, other.counts_.size());
+  Shard* shard = GetShard();
+  size_t bucket_count = std::min(bucket_count_, other.counts_.size());
+  for (size_t index = 0; index < bucket_count; ++index) {
+    if (other.counts_[index])
+      subtle::NoBarrier_AtomicIncrement(&shard->counts[index],
+                                        other.counts_[index]);
+  }
+  AddToTotal(&shard->sum, other.sum_);
+  AddToTotal(&shard->redundant_count, other.redundant_count_);
+}
+
+void Histogram::ShardedSampleSet::Snapshot(SampleSet* sample) const {
+  sample->counts_.assign(bucket_count_, 0);
+  sample->sum_ = 0;
+  sample->redundant_count_ = 0;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    const Shard* shard =
+        reinterpret_cast<const Shard*>(subtle::Acquire_Load(&shards_[i]));
+    if (!shard)
+      continue;
+    for (size_t index = 0; index < bucket_count_; ++index)
+      sample->counts_[index] += subtle::NoBarrier_Load(&shard->counts[index]);
+    sample->sum_ += ReadTotal(shard->sum);
+    sample->redundant_count_ += ReadTotal(shard->redundant_count);
+  }
+}
+
+int64 Histogram::ShardedSampleSet::redundant_count() const {
+  int64 redundant_count = 0;
+  for (size_t i = 0; i < kShardCount; ++i) {
+    const Shard* shard =
+        reinterpret_cast<const Shard*>(subtle::Acquire_Load(&shards_[i]));
+    if (shard)
+      redundant_count += ReadTotal(shard->redundant_count);
+  }
+  return redundant_count;
+}
+
+Histogram::ShardedSampleSet::Shard* Histogram::ShardedSampleSet::GetShard() {
+  ThreadLocalStorage::Slot& slot = g_shard_slot.Get();
+  size_t shard_number = reinterpret_cast<size_t>(slot.Get());
+  if (!shard_number) {
+    uint32 last_shard = static_cast<uint32>(
+        subtle::NoBarrier_AtomicIncrement(&g_last_shard, 1));
+    shard_number = last_shard % kShardCount + 1;
+    slot.Set(reinterpret_cast<void*>(shard_number));
+  }
+
+  subtle::AtomicWord* shard_pointer = &shards_[shard_number - 1];
+  Shard* shard = reinterpret_cast<Shard*>(subtle::Acquire_Load(shard_pointer));
+  if (shard)
+    return shard;
+
+  // Other threads that share the shard may be allocating it too.  The first
+  // one to publish its allocation wins.
+  shard = new Shard(bucket_count_);
+  if (subtle::Release_CompareAndSwap(
+          shard_pointer, 0, reinterpret_cast<subtle::AtomicWord>(shard))) {
+    delete shard;
+    shard = reinterpret_cast<Shard*>(subtle::Acquire_Load(shard_pointer));
+  }
+  return shard;
+}
+
 //------------------------------------------------------------------------------
 // LinearHistogram: This histogram uses a traditional set of evenly spaced
 // buckets.
@@ -1310,6 +1504,36 @@ void CachedRanges::SetBucketRange(size_t i, Histogram::Sample value) {
   ranges_[i] = value;
 }
 
+void CachedRanges::InitializeBucketIndex() {
+  // The last range is the end of the overflow bucket, so the overflow bucket
+  // starts at the second to last one.
+  DCHECK_GE(ranges_.size(), 3u);
+  size_t overflow_bucket = ranges_.size() - 2;
+  size_t slot_count = BucketIndexSlot(ranges_[overflow_bucket]) + 1;
+  bucket_index_.resize(slot_count);
+  size_t bucket = 0;
+  for (size_t slot = 0; slot < slot_count; ++slot) {
+    Histogram::Sample slot_start = BucketIndexSlotStart(slot);
+    while (ranges_[bucket + 1] <= slot_start)
+      ++bucket;
+    DCHECK_LE(bucket, kuint16max);
+    bucket_index_[slot] = static_cast<uint16>(bucket);
+  }
+}
+
+size_t CachedRanges::FindBucket(Histogram::Sample value) const {
+  DCHECK(has_bucket_index());
+  size_t slot = BucketIndexSlot(value);
+  if (slot >= bucket_index_.size())
+    return ranges_.size() - 2;  // The overflow bucket.
+  // Where buckets are narrower than slots, a few of them may start inside
+  // the slot.
+  size_t bucket = bucket_index_[slot];
+  while (ranges_[bucket + 1] <= value)
+    ++bucket;
+  return bucket;
+}
+
 bool CachedRanges::Equals(CachedRanges* other) const {
   if (range_checksum_ != other->range_checksum_)
     return false;
@@ -379,6 +379,8 @@ class BASE_EXPORT Histogram {
     const char* description;  // Null means end of a list of pairs.
   };
 
+  class ShardedSampleSet;
+
   //----------------------------------------------------------------------------
   // Statistic values, developed over the life of the histogram.
 
@@ -420,6 +422,8 @@ class BASE_EXPORT Histogram {
     // Allow tests to corrupt our innards for testing purposes.
     FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptSampleCounts);
 
+    friend class ShardedSampleSet;  // To fill in snapshots.
+
     // To help identify memory corruption, we reduntantly save the number of
     // samples we've accumulated into all of our buckets.  We can compare this
     // count to the sum of the counts in all buckets, and detect problems.  Note
@@ -430,6 +434,53 @@ class BASE_EXPORT Histogram {
     int64 redundant_count_;
   };
 
+  //----------------------------------------------------------------------------
+  // The samples of a live histogram, which any number of threads may add to
+  // at once without a lock.  The counts are kept in several shards of atomic
+  // counters, and each thread adds to the shard it was assigned when it first
+  // touched a histogram, so that threads running on different cores rarely
+  // write to the same cache lines.  The shards are summed up by Snapshot().
+  // A shard is only allocated once a thread adds to it, so a histogram that
+  // is only used on one thread holds a single set of counts.
+
+  class BASE_EXPORT ShardedSampleSet {
+   public:
+    ShardedSampleSet();
+    ~ShardedSampleSet();
+
+    // Adjust the number of buckets for use with given histogram.  Must be
+    // called before anything is added.
+    void Resize(const Histogram& histogram);
+
+    // Accessor for histogram to make routine additions.
+    void Accumulate(Sample value, Count count, size_t index);
+
+    // Add all the samples of |other|.
+    void Add(const SampleSet& other);
+
+    // Sum up the shards into |*sample|.  Samples that are added while this
+    // runs may only be partially reflected, which FindCorruption() tolerates.
+    void Snapshot(SampleSet* sample) const;
+
+    int64 redundant_count() const;
+
+   private:
+    struct Shard;
+
+    // Threads are spread over this many shards.
+    static const size_t kShardCount = 8;
+
+    // Return the calling thread's shard, allocating it if needed.
+    Shard* GetShard();
+
+    size_t bucket_count_;
+
+    // Shard pointers, NULL until the shard is first used.
+    subtle::AtomicWord shards_[kShardCount];
+
+    DISALLOW_COPY_AND_ASSIGN(ShardedSampleSet);
+  };
+
   //----------------------------------------------------------------------------
   // For a valid histogram, input should follow these restrictions:
   // minimum > 0 (if a minimum below 1 is specified, it will implicitly be
@@ -519,7 +570,7 @@ class BASE_EXPORT Histogram {
     cached_ranges_ = cached_ranges;
   }
   // Snapshot the current complete set of sample data.
-  // Override with atomic/locked snapshot if needed.
+  // Override if the samples are kept elsewhere.
   virtual void SnapshotSample(SampleSet* sample) const;
 
   virtual bool HasConstructorArguments(Sample minimum, Sample maximum,
@@ -655,7 +706,7 @@ class BASE_EXPORT Histogram {
 
   // Finally, provide the state that changes with the addition of each new
   // sample.
-  SampleSet sample_;
+  ShardedSampleSet sample_;
 
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
@@ -880,6 +931,16 @@ class BASE_EXPORT CachedRanges {
   // Return true iff |other| object has same ranges_ as |this| object's ranges_.
   bool Equals(CachedRanges* other) const;
 
+  // Build a table that lets FindBucket() place samples without a search.  It
+  // suits exponential ranges, where buckets are no narrower than a fixed
+  // fraction of their starting value.  Must be called once ranges_ is final.
+  void InitializeBucketIndex();
+  bool has_bucket_index() const { return !bucket_index_.empty(); }
+
+  // Return the index of the bucket that holds |value|, using the table built
+  // by InitializeBucketIndex().
+  size_t FindBucket(Histogram::Sample value) const;
+
  private:
   // Allow tests to corrupt our innards for testing purposes.
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, CorruptBucketBounds);
@@ -894,6 +955,12 @@ class BASE_EXPORT CachedRanges {
   // possibly Equal() to this instance.
   uint32 range_checksum_;
 
+  // For each slot of sample values (see BucketIndexSlot() in histogram.cc),
+  // the index of the bucket holding the smallest value of the slot.  Slots
+  // past the end all belong to the overflow bucket.  Empty unless
+  // InitializeBucketIndex() was called.
+  std::vector<uint16> bucket_index_;
+
   DISALLOW_COPY_AND_ASSIGN(CachedRanges);
 };
 
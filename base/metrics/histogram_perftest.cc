@@ -0,0 +1,94 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/histogram.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kAddsPerThread = 2000000;
+
+// Spreads the samples over the whole range of the histograms below, the way
+// timings of a busy operation would be.
+Histogram::Sample SampleValue(int i) {
+  return static_cast<Histogram::Sample>((i * 2654435761u) % 20000);
+}
+
+// Adds kAddsPerThread samples to a histogram once |start| is signaled.
+class Adder : public DelegateSimpleThread::Delegate {
+ public:
+  Adder(Histogram* histogram, WaitableEvent* start)
+      : histogram_(histogram), start_(start) {}
+
+  virtual void Run() OVERRIDE {
+    start_->Wait();
+    for (int i = 0; i < kAddsPerThread; ++i)
+      histogram_->Add(SampleValue(i));
+  }
+
+ private:
+  Histogram* histogram_;
+  WaitableEvent* start_;
+
+  DISALLOW_COPY_AND_ASSIGN(Adder);
+};
+
+// Adds to one histogram from |num_threads| threads at once and logs the
+// average time per Add(), along with the number of samples that went missing.
+void RunAdd(int num_threads) {
+  std::string name = StringPrintf("Histogram_Add_%dthreads", num_threads);
+  Histogram* histogram = Histogram::FactoryGet(name, 1, 10000, 50,
+                                               Histogram::kNoFlags);
+  WaitableEvent start(true, false);
+  ScopedVector<Adder> adders;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    Adder* adder = new Adder(histogram, &start);
+    adders.push_back(adder);
+    DelegateSimpleThread* thread = new DelegateSimpleThread(adder, name);
+    threads.push_back(thread);
+    thread->Start();
+  }
+
+  PerfTimer timer;
+  start.Signal();
+  for (int i = 0; i < num_threads; ++i)
+    threads[i]->Join();
+  TimeDelta elapsed = timer.Elapsed();
+
+  Histogram::SampleSet snapshot;
+  histogram->SnapshotSample(&snapshot);
+  int64 expected = static_cast<int64>(num_threads) * kAddsPerThread;
+  LogPerfResult(name.c_str(), elapsed.InMicroseconds() * 1000.0 / expected,
+                "ns/add");
+  LogPerfResult((name + "_lost").c_str(),
+                static_cast<double>(expected - snapshot.TotalCount()),
+                "samples");
+}
+
+}  // namespace
+
+TEST(HistogramPerfTest, Add1Thread) {
+  RunAdd(1);
+}
+
+TEST(HistogramPerfTest, Add4Threads) {
+  RunAdd(4);
+}
+
+TEST(HistogramPerfTest, Add8Threads) {
+  RunAdd(8);
+}
+
+}  // namespace base
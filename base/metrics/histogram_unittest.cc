@@ -8,7 +8,10 @@
 #include <vector>
 
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/metrics/histogram.h"
+#include "base/stringprintf.h"
+#include "base/threading/simple_thread.h"
 #include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -347,6 +350,115 @@ TEST(HistogramTest, BucketPlacementTest) {
     EXPECT_EQ(i + 1, sample.counts(i));
 }
 
+// Check that the bucket index of exponential histograms finds the bucket that
+// holds each sample.
+TEST(HistogramTest, BucketIndexTest) {
+  struct {
+    Histogram::Sample minimum;
+    Histogram::Sample maximum;
+    size_t bucket_count;
+  } kCases[] = {
+    { 1, 64, 8 },
+    { 1, 100, 101 },  // All buckets are one wide.
+    { 1, 10000, 50 },
+    { 10, 180000, 50 },
+    { 1000, 500000, 50 },
+    { 1, Histogram::kSampleType_MAX - 1, 100 },
+  };
+  for (size_t i = 0; i < arraysize(kCases); ++i) {
+    Histogram* histogram(Histogram::FactoryGet(
+        StringPrintf("BucketIndexHistogram%d", static_cast<int>(i)),
+        kCases[i].minimum, kCases[i].maximum, kCases[i].bucket_count,
+        Histogram::kNoFlags));
+    CachedRanges* cached_ranges = histogram->cached_ranges();
+    ASSERT_TRUE(cached_ranges->has_bucket_index());
+
+    std::vector<Histogram::Sample> values;
+    for (Histogram::Sample value = 0; value < 20000; ++value)
+      values.push_back(value);
+    for (size_t bucket = 1; bucket < histogram->bucket_count(); ++bucket) {
+      values.push_back(histogram->ranges(bucket) - 1);
+      values.push_back(histogram->ranges(bucket));
+    }
+    for (int shift = 0; shift < 31; ++shift) {
+      Histogram::Sample power_of_2 = 1 << shift;
+      values.push_back(power_of_2 - 1);
+      values.push_back(power_of_2 + power_of_2 / 3);
+    }
+    values.push_back(Histogram::kSampleType_MAX - 1);
+
+    for (size_t j = 0; j < values.size(); ++j) {
+      Histogram::Sample value = values[j];
+      size_t bucket = cached_ranges->FindBucket(value);
+      ASSERT_LT(bucket, histogram->bucket_count());
+      EXPECT_LE(histogram->ranges(bucket), value) << i << ": " << value;
+      EXPECT_GT(histogram->ranges(bucket + 1), value) << i << ": " << value;
+    }
+  }
+}
+
+// Adds kAddsPerThread samples of |value| to |histogram|.
+class HistogramAdder : public DelegateSimpleThread::Delegate {
+ public:
+  static const int kAddsPerThread = 100000;
+
+  HistogramAdder(Histogram* histogram, Histogram::Sample value)
+      : histogram_(histogram), value_(value) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kAddsPerThread; ++i)
+      histogram_->Add(value_);
+  }
+
+ private:
+  Histogram* histogram_;
+  Histogram::Sample value_;
+
+  DISALLOW_COPY_AND_ASSIGN(HistogramAdder);
+};
+
+// Check that no samples are lost when many threads add to a histogram.
+TEST(HistogramTest, ThreadedAddTest) {
+  const int kNumThreads = 12;
+  Histogram* histogram(Histogram::FactoryGet(
+      "ThreadedHistogram", 1, 64, 8, Histogram::kNoFlags));
+
+  ScopedVector<HistogramAdder> adders;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    HistogramAdder* adder = new HistogramAdder(histogram, i);
+    adders.push_back(adder);
+    DelegateSimpleThread* thread =
+        new DelegateSimpleThread(adder, "HistogramAdder");
+    threads.push_back(thread);
+    thread->Start();
+  }
+  for (int i = 0; i < kNumThreads; ++i)
+    threads[i]->Join();
+
+  Histogram::SampleSet snapshot;
+  histogram->SnapshotSample(&snapshot);
+  const int kAdds = HistogramAdder::kAddsPerThread;
+  EXPECT_EQ(kNumThreads * kAdds, snapshot.TotalCount());
+  EXPECT_EQ(kNumThreads * kAdds, snapshot.redundant_count());
+  // The threads added 0 to 11: 0 | 1 | 2, 3 | 4 to 7 | 8 to 11.
+  EXPECT_EQ(kAdds, snapshot.counts(0));
+  EXPECT_EQ(kAdds, snapshot.counts(1));
+  EXPECT_EQ(2 * kAdds, snapshot.counts(2));
+  EXPECT_EQ(4 * kAdds, snapshot.counts(3));
+  EXPECT_EQ(4 * kAdds, snapshot.counts(4));
+  EXPECT_EQ(66 * kAdds, snapshot.sum());
+  EXPECT_EQ(0, histogram->FindCorruption(snapshot));
+
+  // Samples added from a snapshot are merged in as well.
+  histogram->AddSampleSet(snapshot);
+  Histogram::SampleSet doubled;
+  histogram->SnapshotSample(&doubled);
+  EXPECT_EQ(2 * kNumThreads * kAdds, doubled.TotalCount());
+  EXPECT_EQ(8 * kAdds, doubled.counts(4));
+  EXPECT_EQ(132 * kAdds, doubled.sum());
+}
+
 }  // namespace
 
 //------------------------------------------------------------------------------
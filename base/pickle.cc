@@ -8,6 +8,8 @@
 
 #include <algorithm>  // for max()
 
+#include "base/memory/ref_counted_memory.h"
+
 //------------------------------------------------------------------------------
 
 // static
@@ -15,9 +17,15 @@ const int Pickle::kPayloadUnit = 64;
 
 static const size_t kCapacityReadOnly = static_cast<size_t>(-1);
 
+// Padding that follows external data in the Pickle's segments.
+static const char kPadding[sizeof(uint32)] = { 0 };
+
 PickleIterator::PickleIterator(const Pickle& pickle)
     : read_ptr_(pickle.payload()),
       read_end_ptr_(pickle.end_of_payload()) {
+  // Data from the first external data on is not in the Pickle's buffer.
+  if (pickle.has_external_data())
+    read_end_ptr_ = read_ptr_ + pickle.external_data_[0].offset;
 }
 
 template <typename Type>
@@ -150,7 +158,8 @@ Pickle::Pickle()
     : header_(NULL),
       header_size_(sizeof(Header)),
       capacity_(0),
-      variable_buffer_offset_(0) {
+      variable_buffer_offset_(0),
+      external_size_(0) {
   Resize(kPayloadUnit);
   header_->payload_size = 0;
 }
@@ -159,7 +168,8 @@ Pickle::Pickle(int header_size)
     : header_(NULL),
       header_size_(AlignInt(header_size, sizeof(uint32))),
       capacity_(0),
-      variable_buffer_offset_(0) {
+      variable_buffer_offset_(0),
+      external_size_(0) {
   DCHECK_GE(static_cast<size_t>(header_size), sizeof(Header));
   DCHECK_LE(header_size, kPayloadUnit);
   Resize(kPayloadUnit);
@@ -170,7 +180,8 @@ Pickle::Pickle(const char* data, int data_len)
     : header_(reinterpret_cast<Header*>(const_cast<char*>(data))),
       header_size_(0),
       capacity_(kCapacityReadOnly),
-      variable_buffer_offset_(0) {
+      variable_buffer_offset_(0),
+      external_size_(0) {
   if (data_len >= static_cast<int>(sizeof(Header)))
     header_size_ = data_len - header_->payload_size;
 
@@ -189,11 +200,12 @@ Pickle::Pickle(const Pickle& other)
     : header_(NULL),
       header_size_(other.header_size_),
       capacity_(0),
-      variable_buffer_offset_(other.variable_buffer_offset_) {
+      variable_buffer_offset_(other.variable_buffer_offset_),
+      external_size_(0) {
   size_t payload_size = header_size_ + other.header_->payload_size;
   bool resized = Resize(payload_size);
   CHECK(resized);  // Realloc failed.
-  memcpy(header_, other.header_, payload_size);
+  other.CopyDataTo(reinterpret_cast<char*>(header_));
 }
 
 Pickle::~Pickle() {
@@ -215,14 +227,48 @@ Pickle& Pickle::operator=(const Pickle& other) {
     header_ = NULL;
     header_size_ = other.header_size_;
   }
+  external_data_.clear();
+  external_size_ = 0;
   bool resized = Resize(other.header_size_ + other.header_->payload_size);
   CHECK(resized);  // Realloc failed.
-  memcpy(header_, other.header_,
-         other.header_size_ + other.header_->payload_size);
+  other.CopyDataTo(reinterpret_cast<char*>(header_));
   variable_buffer_offset_ = other.variable_buffer_offset_;
   return *this;
 }
 
+void Pickle::GetSegment(size_t index, const char** data, size_t* size) const {
+  DCHECK_LT(index, segment_count());
+  const char* buffer = reinterpret_cast<const char*>(header_);
+
+  // The Pickle's buffer is split at each external data, which is followed by
+  // its padding: buffer, (external data, padding, buffer)*.
+  size_t external_index = index / 3;
+  switch (index % 3) {
+    case 0: {
+      size_t begin = external_index == 0 ?
+          0 : header_size_ + external_data_[external_index - 1].offset;
+      size_t end = external_index == external_data_.size() ?
+          header_size_ + inline_payload_size() :
+          header_size_ + external_data_[external_index].offset;
+      *data = buffer + begin;
+      *size = end - begin;
+      break;
+    }
+    case 1: {
+      const RefCountedMemory* memory = external_data_[external_index].data;
+      *data = reinterpret_cast<const char*>(memory->front());
+      *size = memory->size();
+      break;
+    }
+    case 2: {
+      size_t length = external_data_[external_index].data->size();
+      *data = kPadding;
+      *size = AlignInt(length, sizeof(uint32)) - length;
+      break;
+    }
+  }
+}
+
 bool Pickle::WriteString(const std::string& value) {
   if (!WriteInt(static_cast<int>(value.size())))
     return false;
@@ -250,6 +296,30 @@ bool Pickle::WriteData(const char* data, int length) {
   return length >= 0 && WriteInt(length) && WriteBytes(data, length);
 }
 
+bool Pickle::WriteExternalData(RefCountedMemory* data) {
+  DCHECK_NE(kCapacityReadOnly, capacity_) << "oops: pickle is readonly";
+
+  size_t length = data->size();
+  if (length > static_cast<size_t>(kint32max) ||
+      !WriteInt(static_cast<int>(length))) {
+    return false;
+  }
+
+  size_t aligned_length = AlignInt(length, sizeof(uint32));
+  if (aligned_length > kuint32max - header_->payload_size)
+    return false;
+  if (!length)
+    return true;
+
+  ExternalData external_data;
+  external_data.offset = inline_payload_size();
+  external_data.data = data;
+  external_data_.push_back(external_data);
+  external_size_ += aligned_length;
+  header_->payload_size += static_cast<uint32>(aligned_length);
+  return true;
+}
+
 bool Pickle::WriteBytes(const void* data, int data_len) {
   DCHECK_NE(kCapacityReadOnly, capacity_) << "oops: pickle is readonly";
 
@@ -274,8 +344,10 @@ char* Pickle::BeginWriteData(int length) {
   if (!data_ptr)
     return NULL;
 
+  // Record the offset the buffer will have once external data is copied in.
   variable_buffer_offset_ =
-      data_ptr - reinterpret_cast<char*>(header_) - sizeof(int);
+      data_ptr - reinterpret_cast<char*>(header_) - sizeof(int) +
+      external_size_;
 
   // EndWrite doesn't necessarily have to be called after the write operation,
   // so we call it here to pad out what the caller will eventually write.
@@ -287,8 +359,13 @@ void Pickle::TrimWriteData(int new_length) {
   DCHECK_NE(variable_buffer_offset_, 0U);
 
   // Fetch the the variable buffer size
+  DCHECK(!has_external_data() ||
+         external_data_.back().offset + header_size_ <=
+             variable_buffer_offset_ - external_size_)
+      << "Can't trim data that precedes external data";
   int* cur_length = reinterpret_cast<int*>(
-      reinterpret_cast<char*>(header_) + variable_buffer_offset_);
+      reinterpret_cast<char*>(header_) + variable_buffer_offset_ -
+      external_size_);
 
   if (new_length < 0 || new_length > *cur_length) {
     NOTREACHED() << "Invalid length in TrimWriteData.";
@@ -304,8 +381,10 @@ char* Pickle::BeginWrite(size_t length) {
   // write at a uint32-aligned offset from the beginning of the header
   size_t offset = AlignInt(header_->payload_size, sizeof(uint32));
 
+  // External data is not in the buffer, and is always a multiple of uint32 in
+  // size, so the write stays aligned.
   size_t new_size = offset + length;
-  size_t needed_size = header_size_ + new_size;
+  size_t needed_size = header_size_ + new_size - external_size_;
   if (needed_size > capacity_ && !Resize(std::max(capacity_ * 2, needed_size)))
     return NULL;
 
@@ -314,7 +393,7 @@ char* Pickle::BeginWrite(size_t length) {
 #endif
 
   header_->payload_size = static_cast<uint32>(new_size);
-  return payload() + offset;
+  return payload() + offset - external_size_;
 }
 
 void Pickle::EndWrite(char* dest, int length) {
@@ -337,6 +416,22 @@ bool Pickle::Resize(size_t new_capacity) {
   return true;
 }
 
+void Pickle::CopyDataTo(char* dest) const {
+  for (size_t i = 0; i < segment_count(); ++i) {
+    const char* data;
+    size_t size;
+    GetSegment(i, &data, &size);
+    memcpy(dest, data, size);
+    dest += size;
+  }
+}
+
+Pickle::ExternalData::ExternalData() : offset(0) {
+}
+
+Pickle::ExternalData::~ExternalData() {
+}
+
 // static
 const char* Pickle::FindNext(size_t header_size,
                              const char* start,
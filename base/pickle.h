@@ -7,15 +7,18 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/logging.h"
+#include "base/memory/ref_counted.h"
 #include "base/string16.h"
 
 class Pickle;
+class RefCountedMemory;
 
 // PickleIterator reads data from a Pickle. The Pickle object must remain valid
 // while the PickleIterator object is in use.
@@ -100,6 +103,10 @@ class BASE_EXPORT PickleIterator {
 // space is controlled by the header_size parameter passed to the Pickle
 // constructor.
 //
+// Large blocks of data can be added with WriteExternalData(), which references
+// the data instead of copying it into the Pickle's buffer.  The data is then
+// gathered in from the Pickle's segments when the Pickle is written out.
+//
 class BASE_EXPORT Pickle {
  public:
   // Initialize a Pickle object using the default header size.
@@ -126,14 +133,31 @@ class BASE_EXPORT Pickle {
   // destructor, suggesting at least some need to call more derived destructors.
   virtual ~Pickle();
 
-  // Performs a deep copy.
+  // Performs a deep copy.  External data is copied into the new Pickle's
+  // buffer, so the copy never has external data.
   Pickle& operator=(const Pickle& other);
 
   // Returns the size of the Pickle's data.
   size_t size() const { return header_size_ + header_->payload_size; }
 
-  // Returns the data for this Pickle.
-  const void* data() const { return header_; }
+  // Returns the data for this Pickle.  Must not be called on a Pickle with
+  // external data, whose data is only available through GetSegment().
+  const void* data() const {
+    DCHECK(!has_external_data());
+    return header_;
+  }
+
+  // Returns true if WriteExternalData() was used on this Pickle.
+  bool has_external_data() const { return !external_data_.empty(); }
+
+  // Returns the number of segments that make up the Pickle's data.  This is
+  // 1 unless the Pickle has external data.
+  size_t segment_count() const { return 1 + 3 * external_data_.size(); }
+
+  // Gets the |index|th segment of the Pickle's data.  Concatenated in order,
+  // the segments are size() bytes: the same bytes as data() would hold had
+  // the external data been written with WriteData().  Segments may be empty.
+  void GetSegment(size_t index, const char** data, size_t* size) const;
 
   // For compatibility, these older style read methods pass through to the
   // PickleIterator methods.
@@ -217,6 +241,13 @@ class BASE_EXPORT Pickle {
   bool WriteData(const char* data, int length);
   bool WriteBytes(const void* data, int data_len);
 
+  // Same as WriteData, but references |data| rather than copying it, which
+  // saves copying large blobs that are already in memory.  |data| must not be
+  // modified while the Pickle is alive.  The Pickle's data is then only
+  // available through GetSegment(), and a PickleIterator on the Pickle stops
+  // before the first external data; copy the Pickle to read all of it.
+  bool WriteExternalData(RefCountedMemory* data);
+
   // Same as WriteData, but allows the caller to write directly into the
   // Pickle. This saves a copy in cases where the data is not already
   // available in a buffer. The caller should take care to not write more
@@ -260,6 +291,11 @@ class BASE_EXPORT Pickle {
  protected:
   size_t payload_size() const { return header_->payload_size; }
 
+  // Returns the number of payload bytes held in the Pickle's own buffer.
+  size_t inline_payload_size() const {
+    return header_->payload_size - external_size_;
+  }
+
   char* payload() {
     return reinterpret_cast<char*>(header_) + header_size_;
   }
@@ -271,11 +307,11 @@ class BASE_EXPORT Pickle {
   // header + payload.
   char* end_of_payload() {
     // We must have a valid header_.
-    return payload() + payload_size();
+    return payload() + inline_payload_size();
   }
   const char* end_of_payload() const {
     // This object may be invalid.
-    return header_ ? payload() + payload_size() : NULL;
+    return header_ ? payload() + inline_payload_size() : NULL;
   }
 
   size_t capacity() const {
@@ -316,12 +352,31 @@ class BASE_EXPORT Pickle {
  private:
   friend class PickleIterator;
 
+  // A block of data written with WriteExternalData().
+  struct ExternalData {
+    ExternalData();
+    ~ExternalData();
+
+    // The offset in the Pickle's buffer that the data logically precedes.
+    size_t offset;
+    scoped_refptr<RefCountedMemory> data;
+  };
+
+  // Copies the Pickle's data, including any external data, to |dest|, which
+  // must have room for size() bytes.
+  void CopyDataTo(char* dest) const;
+
   Header* header_;
   size_t header_size_;  // Supports extra data between header and payload.
   // Allocation size of payload (or -1 if allocation is const).
   size_t capacity_;
   size_t variable_buffer_offset_;  // IF non-zero, then offset to a buffer.
 
+  // External data, in the order it was written, and the number of payload
+  // bytes it accounts for, including padding.
+  std::vector<ExternalData> external_data_;
+  size_t external_size_;
+
   FRIEND_TEST_ALL_PREFIXES(PickleTest, Resize);
   FRIEND_TEST_ALL_PREFIXES(PickleTest, FindNext);
   FRIEND_TEST_ALL_PREFIXES(PickleTest, FindNextWithIncompleteHeader);
@@ -3,8 +3,10 @@
 // found in the LICENSE file.
 
 #include <string>
+#include <vector>
 
 #include "base/basictypes.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/pickle.h"
 #include "base/string16.h"
@@ -61,6 +63,18 @@ void VerifyResult(const Pickle& pickle) {
   EXPECT_FALSE(pickle.ReadInt(&iter, &outint));
 }
 
+// Returns the data of |pickle| by concatenating its segments.
+std::string GetSegmentedData(const Pickle& pickle) {
+  std::string result;
+  for (size_t i = 0; i < pickle.segment_count(); ++i) {
+    const char* data;
+    size_t size;
+    pickle.GetSegment(i, &data, &size);
+    result.append(data, size);
+  }
+  return result;
+}
+
 }  // namespace
 
 TEST(PickleTest, EncodeDecode) {
@@ -334,3 +348,126 @@ TEST(PickleTest, ReadBytes) {
   memcpy(&outdata, outdata_char, sizeof(outdata));
   EXPECT_EQ(data, outdata);
 }
+
+// Check that external data is serialized exactly like WriteData() would
+// have, without being copied into the Pickle.
+TEST(PickleTest, ExternalData) {
+  scoped_refptr<RefCountedStaticMemory> data(new RefCountedStaticMemory(
+      reinterpret_cast<const unsigned char*>(testdata), testdatalen));
+  scoped_refptr<RefCountedStaticMemory> odd_data(new RefCountedStaticMemory(
+      reinterpret_cast<const unsigned char*>(teststr.data()), teststr.size()));
+
+  Pickle pickle;
+  EXPECT_FALSE(pickle.has_external_data());
+  EXPECT_EQ(1U, pickle.segment_count());
+  EXPECT_TRUE(pickle.WriteInt(testint));
+  EXPECT_TRUE(pickle.WriteExternalData(odd_data));
+  EXPECT_TRUE(pickle.WriteBool(testbool2));
+  EXPECT_TRUE(pickle.WriteExternalData(data));
+  EXPECT_TRUE(pickle.WriteExternalData(data));
+  EXPECT_TRUE(pickle.WriteUInt16(testuint16));
+  EXPECT_TRUE(pickle.has_external_data());
+  EXPECT_EQ(10U, pickle.segment_count());
+
+  Pickle expected;
+  EXPECT_TRUE(expected.WriteInt(testint));
+  EXPECT_TRUE(expected.WriteData(teststr.data(), teststr.size()));
+  EXPECT_TRUE(expected.WriteBool(testbool2));
+  EXPECT_TRUE(expected.WriteData(testdata, testdatalen));
+  EXPECT_TRUE(expected.WriteData(testdata, testdatalen));
+  EXPECT_TRUE(expected.WriteUInt16(testuint16));
+
+  ASSERT_EQ(expected.size(), pickle.size());
+  std::string serialized = GetSegmentedData(pickle);
+  EXPECT_EQ(std::string(static_cast<const char*>(expected.data()),
+                        expected.size()),
+            serialized);
+
+  // The external data is referenced, not copied.
+  const char* segment;
+  size_t segment_size;
+  pickle.GetSegment(1, &segment, &segment_size);
+  EXPECT_EQ(teststr.data(), segment);
+  EXPECT_EQ(teststr.size(), segment_size);
+
+  // Only the data before the first external data can be read in place.
+  PickleIterator inline_iter(pickle);
+  int outint;
+  EXPECT_TRUE(pickle.ReadInt(&inline_iter, &outint));
+  EXPECT_EQ(testint, outint);
+  EXPECT_TRUE(pickle.ReadInt(&inline_iter, &outint));
+  EXPECT_EQ(static_cast<int>(teststr.size()), outint);
+  EXPECT_FALSE(pickle.ReadInt(&inline_iter, &outint));
+
+  // Copies hold all the data inline.
+  Pickle copy(pickle);
+  EXPECT_FALSE(copy.has_external_data());
+  ASSERT_EQ(pickle.size(), copy.size());
+  EXPECT_EQ(0, memcmp(serialized.data(), copy.data(), copy.size()));
+  Pickle assigned;
+  assigned = pickle;
+  EXPECT_FALSE(assigned.has_external_data());
+  ASSERT_EQ(pickle.size(), assigned.size());
+  EXPECT_EQ(0, memcmp(serialized.data(), assigned.data(), assigned.size()));
+
+  Pickle received(serialized.data(), serialized.size());
+  PickleIterator iter(received);
+  EXPECT_TRUE(received.ReadInt(&iter, &outint));
+  EXPECT_EQ(testint, outint);
+  std::string outstr;
+  EXPECT_TRUE(received.ReadString(&iter, &outstr));
+  EXPECT_EQ(teststr, outstr);
+  bool outbool;
+  EXPECT_TRUE(received.ReadBool(&iter, &outbool));
+  EXPECT_EQ(testbool2, outbool);
+  for (int i = 0; i < 2; ++i) {
+    const char* outdata;
+    int outdatalen;
+    EXPECT_TRUE(received.ReadData(&iter, &outdata, &outdatalen));
+    EXPECT_EQ(testdatalen, outdatalen);
+    EXPECT_EQ(0, memcmp(testdata, outdata, outdatalen));
+  }
+  uint16 outuint16;
+  EXPECT_TRUE(received.ReadUInt16(&iter, &outuint16));
+  EXPECT_EQ(testuint16, outuint16);
+  EXPECT_FALSE(received.ReadInt(&iter, &outint));
+}
+
+// Check that empty external data is written inline, and that a variable
+// buffer can follow external data.
+TEST(PickleTest, ExternalDataAndVariableBuffer) {
+  scoped_refptr<RefCountedBytes> empty(new RefCountedBytes);
+  std::vector<unsigned char> bytes(teststr.begin(), teststr.end());
+  scoped_refptr<RefCountedBytes> data(new RefCountedBytes(bytes));
+
+  Pickle pickle;
+  EXPECT_TRUE(pickle.WriteExternalData(empty));
+  EXPECT_FALSE(pickle.has_external_data());
+  EXPECT_TRUE(pickle.WriteExternalData(data));
+  char* buffer = pickle.BeginWriteData(10);
+  ASSERT_TRUE(buffer);
+  memcpy(buffer, "abcde", 5);
+  pickle.TrimWriteData(5);
+
+  Pickle copy(pickle);
+  PickleIterator iter(copy);
+  const char* outdata;
+  int outdatalen;
+  EXPECT_TRUE(copy.ReadData(&iter, &outdata, &outdatalen));
+  EXPECT_EQ(0, outdatalen);
+  std::string outstr;
+  EXPECT_TRUE(copy.ReadString(&iter, &outstr));
+  EXPECT_EQ(teststr, outstr);
+  EXPECT_TRUE(copy.ReadData(&iter, &outdata, &outdatalen));
+  EXPECT_EQ("abcde", std::string(outdata, outdatalen));
+  EXPECT_EQ(GetSegmentedData(pickle),
+            std::string(static_cast<const char*>(copy.data()), copy.size()));
+
+  // The copy's variable buffer can still be trimmed.
+  copy.TrimWriteData(2);
+  iter = PickleIterator(copy);
+  EXPECT_TRUE(copy.ReadData(&iter, &outdata, &outdatalen));
+  EXPECT_TRUE(copy.ReadString(&iter, &outstr));
+  EXPECT_TRUE(copy.ReadData(&iter, &outdata, &outdatalen));
+  EXPECT_EQ("ab", std::string(outdata, outdatalen));
+}
@@ -4,6 +4,7 @@
 
 #include "base/threading/sequenced_worker_pool.h"
 
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
@@ -13,8 +14,10 @@
 #include "base/atomicops.h"
 #include "base/callback.h"
 #include "base/compiler_specific.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/linked_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop_proxy.h"
 #include "base/metrics/histogram.h"
 #include "base/stl_util.h"
@@ -23,6 +26,7 @@
 #include "base/synchronization/lock.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/simple_thread.h"
+#include "base/threading/thread_local.h"
 #include "base/time.h"
 #include "base/tracked_objects.h"
 
@@ -43,6 +47,29 @@ struct SequencedTask {
   Closure task;
 };
 
+// The deque of runnable work owned by one worker in WORK_STEALING mode. An
+// entry with a null |task| and a nonzero |sequence_token_id| stands for "the
+// next task of that sequence"; see SequencedWorkerPool::Inner.
+struct WorkQueue {
+  WorkQueue(const void* owner, size_t index)
+      : owner(owner), index(index), size(0) {}
+
+  // The Inner this queue belongs to, used to recognize our own workers.
+  const void* const owner;
+  const size_t index;
+
+  Lock lock;
+  std::deque<SequencedTask> items;
+
+  // Mirrors |items.size()| so that thieves can skip empty queues without
+  // taking |lock|.
+  volatile subtle::Atomic32 size;
+};
+
+// The WorkQueue owned by the current worker thread, if any.
+LazyInstance<ThreadLocalPointer<WorkQueue> >::Leaky g_current_work_queue =
+    LAZY_INSTANCE_INITIALIZER;
+
 }  // namespace
 
 // Worker ---------------------------------------------------------------------
@@ -59,8 +86,11 @@ class SequencedWorkerPool::Worker : public SimpleThread {
   // SimpleThread implementation. This actually runs the background thread.
   virtual void Run() OVERRIDE;
 
+  int thread_number() const { return thread_number_; }
+
  private:
   scoped_refptr<SequencedWorkerPool> worker_pool_;
+  const int thread_number_;
 
   DISALLOW_COPY_AND_ASSIGN(Worker);
 };
@@ -73,6 +103,7 @@ class SequencedWorkerPool::Inner {
   // by it).
   Inner(SequencedWorkerPool* worker_pool, size_t max_threads,
         const std::string& thread_name_prefix,
+        SchedulingMode mode,
         TestingObserver* observer);
 
   ~Inner();
@@ -156,8 +187,45 @@ class SequencedWorkerPool::Inner {
   // called inside the lock.
   bool CanShutdown() const;
 
+  // WORK_STEALING mode ------------------------------------------------------
+  //
+  // Runnable work lives in |work_queues_|, one per potential worker. Only
+  // the bookkeeping that is rare (thread creation, going idle, shutdown)
+  // takes |lock_|; posting and running tasks only touch the lock of a single
+  // work queue, plus |sequences_lock_| for sequenced tasks.
+
+  // PostTask() for WORK_STEALING mode. The token name has been resolved.
+  bool PostTaskWorkStealing(const SequencedTask& task);
+
+  // The worker loop for WORK_STEALING mode.
+  void ThreadLoopWorkStealing(Worker* this_worker);
+
+  // Adds |item| to the current worker's queue, or to the next queue in
+  // round-robin order when not called from one of our workers, and makes
+  // sure a worker will pick it up.
+  void PushWorkItem(const SequencedTask& item);
+
+  // Takes an item from the back of |own_queue|, or steals one from the front
+  // of another queue. Returns false if all queues looked empty.
+  bool TakeWorkItem(WorkQueue* own_queue, SequencedTask* item);
+
+  // Runs |item|. A sequence entry runs the oldest task of its sequence, and
+  // is queued again afterwards if the sequence has more tasks.
+  void RunWorkItem(SequencedTask* item);
+
+  // Runs or, during shutdown, discards |task| and updates the counters.
+  void RunOrDiscardTask(SequencedTask* task);
+
+  // Wakes up an idle worker, or starts a new one if that could help.
+  void WakeUpWorkerIfHelpful();
+
+  // Returns the calling worker's queue if it is one of ours, NULL otherwise.
+  WorkQueue* GetCurrentThreadWorkQueue() const;
+
   SequencedWorkerPool* const worker_pool_;
 
+  const SchedulingMode mode_;
+
   // The last sequence number used. Managed by GetSequenceToken, since this
   // only does threadsafe increment operations, you do not need to hold the
   // lock.
@@ -226,6 +294,48 @@ class SequencedWorkerPool::Inner {
 
   TestingObserver* const testing_observer_;
 
+  // WORK_STEALING mode state. Except where noted, these are not protected by
+  // |lock_|.
+
+  // One queue per potential worker, indexed by thread number - 1.
+  ScopedVector<WorkQueue> work_queues_;
+
+  // Picks the queue for tasks posted from outside the pool.
+  volatile subtle::Atomic32 next_work_queue_;
+
+  // Number of entries across all of |work_queues_|. Incremented before an
+  // entry is pushed and decremented after it is taken, so it is never lower
+  // than the real number of entries.
+  volatile subtle::Atomic32 runnable_item_count_;
+
+  // Tasks that have been posted and have not finished running or been
+  // discarded, including those waiting in |sequence_queues_|.
+  volatile subtle::Atomic32 unfinished_task_count_;
+
+  // Mirrors |waiting_thread_count_| (which is still only changed under
+  // |lock_|) for posting threads that don't take |lock_|.
+  volatile subtle::Atomic32 idle_thread_count_;
+
+  // BLOCK_SHUTDOWN tasks that have not started yet, and that are running.
+  // These replace |blocking_shutdown_pending_task_count_| and
+  // |blocking_shutdown_thread_count_|.
+  volatile subtle::Atomic32 blocking_shutdown_pending_count_;
+  volatile subtle::Atomic32 blocking_shutdown_running_count_;
+
+  // Mirrors |shutdown_called_| for threads that don't take |lock_|.
+  volatile subtle::Atomic32 shutting_down_;
+
+  // Set once |max_threads_| workers exist, so that posting stops looking at
+  // thread creation.
+  volatile subtle::Atomic32 all_threads_started_;
+
+  // Pending tasks of every sequence that currently has an entry in one of
+  // |work_queues_| or is being run by a worker. A sequence is in this map
+  // exactly as long as it is scheduled, even if its queue is empty.
+  typedef std::map<int, std::deque<SequencedTask> > SequenceQueueMap;
+  Lock sequences_lock_;
+  SequenceQueueMap sequence_queues_;
+
   DISALLOW_COPY_AND_ASSIGN(Inner);
 };
 
@@ -237,7 +347,8 @@ SequencedWorkerPool::Worker::Worker(
     const std::string& prefix)
     : SimpleThread(
           prefix + StringPrintf("Worker%d", thread_number).c_str()),
-      worker_pool_(worker_pool) {
+      worker_pool_(worker_pool),
+      thread_number_(thread_number) {
   Start();
 }
 
@@ -261,8 +372,10 @@ SequencedWorkerPool::Inner::Inner(
     SequencedWorkerPool* worker_pool,
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode mode,
     TestingObserver* observer)
     : worker_pool_(worker_pool),
+      mode_(mode),
       last_sequence_number_(0),
       lock_(),
       has_work_cv_(&lock_),
@@ -276,7 +389,20 @@ SequencedWorkerPool::Inner::Inner(
       pending_task_count_(0),
       blocking_shutdown_pending_task_count_(0),
       shutdown_called_(false),
-      testing_observer_(observer) {}
+      testing_observer_(observer),
+      next_work_queue_(0),
+      runnable_item_count_(0),
+      unfinished_task_count_(0),
+      idle_thread_count_(0),
+      blocking_shutdown_pending_count_(0),
+      blocking_shutdown_running_count_(0),
+      shutting_down_(0),
+      all_threads_started_(0) {
+  if (mode_ == WORK_STEALING) {
+    for (size_t i = 0; i < max_threads_; ++i)
+      work_queues_.push_back(new WorkQueue(this, i));
+  }
+}
 
 SequencedWorkerPool::Inner::~Inner() {
   // You must call Shutdown() before destroying the pool.
@@ -317,6 +443,14 @@ bool SequencedWorkerPool::Inner::PostTask(
   sequenced.location = from_here;
   sequenced.task = task;
 
+  if (mode_ == WORK_STEALING) {
+    if (optional_token_name) {
+      AutoLock lock(lock_);
+      sequenced.sequence_token_id = LockedGetNamedTokenID(*optional_token_name);
+    }
+    return PostTaskWorkStealing(sequenced);
+  }
+
   int create_thread_id = 0;
   {
     AutoLock lock(lock_);
@@ -346,6 +480,9 @@ bool SequencedWorkerPool::Inner::PostTask(
 }
 
 bool SequencedWorkerPool::Inner::RunsTasksOnCurrentThread() const {
+  if (mode_ == WORK_STEALING)
+    return GetCurrentThreadWorkQueue() != NULL;
+
   AutoLock lock(lock_);
   return ContainsKey(threads_, PlatformThread::CurrentId());
 }
@@ -371,6 +508,12 @@ void SequencedWorkerPool::Inner::Shutdown() {
     if (shutdown_called_)
       return;
     shutdown_called_ = true;
+    if (mode_ == WORK_STEALING) {
+      // Pairs with the barrier in PostTaskWorkStealing(): either the poster
+      // sees the flag, or CanShutdown() below sees the posted task.
+      subtle::NoBarrier_Store(&shutting_down_, 1);
+      subtle::MemoryBarrier();
+    }
 
     // Tickle the threads. This will wake up a waiting one so it will know that
     // it can exit, which in turn will wake up any other waiting ones.
@@ -399,6 +542,11 @@ void SequencedWorkerPool::Inner::Shutdown() {
 }
 
 void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
+  if (mode_ == WORK_STEALING) {
+    ThreadLoopWorkStealing(this_worker);
+    return;
+  }
+
   {
     AutoLock lock(lock_);
     DCHECK(thread_being_created_);
@@ -462,6 +610,10 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
 
 bool SequencedWorkerPool::Inner::IsIdle() const {
   lock_.AssertAcquired();
+  if (mode_ == WORK_STEALING) {
+    return subtle::Acquire_Load(&unfinished_task_count_) == 0 &&
+        waiting_thread_count_ == threads_.size();
+  }
   return pending_task_count_ == 0 && waiting_thread_count_ == threads_.size();
 }
 
@@ -647,6 +799,14 @@ int SequencedWorkerPool::Inner::PrepareToStartAdditionalThreadIfHelpful() {
       threads_.size() < max_threads_ &&
       waiting_thread_count_ == 0) {
     // We could use an additional thread if there's work to be done.
+    if (mode_ == WORK_STEALING) {
+      // Everything in the work queues is runnable.
+      if (subtle::Acquire_Load(&runnable_item_count_) > 0) {
+        thread_being_created_ = true;
+        return static_cast<int>(threads_.size() + 1);
+      }
+      return 0;
+    }
     for (std::list<SequencedTask>::iterator i = pending_tasks_.begin();
          i != pending_tasks_.end(); ++i) {
       if (IsSequenceTokenRunnable(i->sequence_token_id)) {
@@ -678,12 +838,272 @@ void SequencedWorkerPool::Inner::SignalHasWork() {
 
 bool SequencedWorkerPool::Inner::CanShutdown() const {
   lock_.AssertAcquired();
+  if (mode_ == WORK_STEALING) {
+    // A task is counted as running before it stops being counted as pending,
+    // so read the pending count first.
+    return !thread_being_created_ &&
+           subtle::Acquire_Load(&blocking_shutdown_pending_count_) == 0 &&
+           subtle::Acquire_Load(&blocking_shutdown_running_count_) == 0;
+  }
   // See PrepareToStartAdditionalThreadIfHelpful for how thread creation works.
   return !thread_being_created_ &&
          blocking_shutdown_thread_count_ == 0 &&
          blocking_shutdown_pending_task_count_ == 0;
 }
 
+bool SequencedWorkerPool::Inner::PostTaskWorkStealing(
+    const SequencedTask& task) {
+  DCHECK_EQ(WORK_STEALING, mode_);
+  const bool blocks_shutdown = task.shutdown_behavior == BLOCK_SHUTDOWN;
+
+  // Count the task before checking for shutdown. Shutdown() sets the flag
+  // before counting, and both sides use a full barrier, so either we see the
+  // flag or Shutdown() waits for this task.
+  if (blocks_shutdown)
+    subtle::Barrier_AtomicIncrement(&blocking_shutdown_pending_count_, 1);
+  if (subtle::Acquire_Load(&shutting_down_)) {
+    if (blocks_shutdown) {
+      subtle::Barrier_AtomicIncrement(&blocking_shutdown_pending_count_, -1);
+      AutoLock lock(lock_);
+      can_shutdown_cv_.Signal();
+    }
+    return false;
+  }
+  subtle::Barrier_AtomicIncrement(&unfinished_task_count_, 1);
+
+  if (!task.sequence_token_id) {
+    PushWorkItem(task);
+    return true;
+  }
+
+  bool sequence_was_idle;
+  {
+    AutoLock lock(sequences_lock_);
+    std::pair<SequenceQueueMap::iterator, bool> result =
+        sequence_queues_.insert(
+            std::make_pair(task.sequence_token_id,
+                           std::deque<SequencedTask>()));
+    result.first->second.push_back(task);
+    sequence_was_idle = result.second;
+  }
+  // If the sequence was already scheduled, whoever runs it next will get to
+  // this task.
+  if (sequence_was_idle) {
+    SequencedTask entry;
+    entry.sequence_token_id = task.sequence_token_id;
+    PushWorkItem(entry);
+  }
+  return true;
+}
+
+void SequencedWorkerPool::Inner::ThreadLoopWorkStealing(Worker* this_worker) {
+  DCHECK_GT(this_worker->thread_number(), 0);
+  WorkQueue* own_queue = work_queues_[this_worker->thread_number() - 1];
+  {
+    AutoLock lock(lock_);
+    DCHECK(thread_being_created_);
+    thread_being_created_ = false;
+    std::pair<ThreadMap::iterator, bool> result =
+        threads_.insert(
+            std::make_pair(this_worker->tid(), make_linked_ptr(this_worker)));
+    DCHECK(result.second);
+    if (threads_.size() == max_threads_)
+      subtle::Release_Store(&all_threads_started_, 1);
+  }
+  g_current_work_queue.Get().Set(own_queue);
+
+  while (true) {
+    SequencedTask item;
+    if (TakeWorkItem(own_queue, &item)) {
+      // If there is more work than we can take, get help before running our
+      // item, which could take arbitrarily long.
+      if (subtle::Acquire_Load(&runnable_item_count_) > 0)
+        WakeUpWorkerIfHelpful();
+      RunWorkItem(&item);
+      continue;
+    }
+
+    AutoLock lock(lock_);
+    // When we're terminating and there's no more work, we can shut down.
+    // BLOCK_SHUTDOWN tasks may still be waiting behind a running task of their
+    // sequence; stay around until they have started so that a late re-queue
+    // always finds a worker.
+    if (shutdown_called_ &&
+        subtle::Acquire_Load(&runnable_item_count_) == 0 &&
+        subtle::Acquire_Load(&blocking_shutdown_pending_count_) == 0) {
+      break;
+    }
+    waiting_thread_count_++;
+    // Pairs with the barrier in PushWorkItem(): either the poster sees us
+    // idle and signals, or we see its item here.
+    subtle::Barrier_AtomicIncrement(&idle_thread_count_, 1);
+    if (subtle::Acquire_Load(&runnable_item_count_) == 0) {
+      // This is the only time that IsIdle() can go to true.
+      if (IsIdle())
+        is_idle_cv_.Signal();
+      has_work_cv_.Wait();
+    }
+    subtle::Barrier_AtomicIncrement(&idle_thread_count_, -1);
+    waiting_thread_count_--;
+  }
+
+  g_current_work_queue.Get().Set(NULL);
+
+  // We noticed we should exit. Wake up the next worker so it knows it should
+  // exit as well (because the Shutdown() code only signals once).
+  SignalHasWork();
+
+  // Possibly unblock shutdown.
+  can_shutdown_cv_.Signal();
+}
+
+void SequencedWorkerPool::Inner::PushWorkItem(const SequencedTask& item) {
+  WorkQueue* queue = GetCurrentThreadWorkQueue();
+  if (!queue) {
+    uint32 index = static_cast<uint32>(
+        subtle::NoBarrier_AtomicIncrement(&next_work_queue_, 1));
+    queue = work_queues_[index % work_queues_.size()];
+  }
+
+  subtle::Barrier_AtomicIncrement(&runnable_item_count_, 1);
+  {
+    AutoLock lock(queue->lock);
+    queue->items.push_back(item);
+    subtle::NoBarrier_Store(&queue->size,
+                            static_cast<subtle::Atomic32>(queue->items.size()));
+  }
+  WakeUpWorkerIfHelpful();
+}
+
+bool SequencedWorkerPool::Inner::TakeWorkItem(WorkQueue* own_queue,
+                                              SequencedTask* item) {
+  // Our own queue is used as a stack: the most recently pushed work is the
+  // most likely to still be in cache.
+  if (subtle::NoBarrier_Load(&own_queue->size)) {
+    AutoLock lock(own_queue->lock);
+    if (!own_queue->items.empty()) {
+      *item = own_queue->items.back();
+      own_queue->items.pop_back();
+      subtle::NoBarrier_Store(
+          &own_queue->size,
+          static_cast<subtle::Atomic32>(own_queue->items.size()));
+      subtle::Barrier_AtomicIncrement(&runnable_item_count_, -1);
+      return true;
+    }
+  }
+
+  // Steal the oldest item of another queue, starting with our neighbor so that
+  // thieves spread out.
+  const size_t queue_count = work_queues_.size();
+  for (size_t i = 1; i < queue_count; ++i) {
+    WorkQueue* victim = work_queues_[(own_queue->index + i) % queue_count];
+    if (!subtle::NoBarrier_Load(&victim->size))
+      continue;
+    AutoLock lock(victim->lock);
+    if (victim->items.empty())
+      continue;
+    *item = victim->items.front();
+    victim->items.pop_front();
+    subtle::NoBarrier_Store(
+        &victim->size, static_cast<subtle::Atomic32>(victim->items.size()));
+    subtle::Barrier_AtomicIncrement(&runnable_item_count_, -1);
+    return true;
+  }
+  return false;
+}
+
+void SequencedWorkerPool::Inner::RunWorkItem(SequencedTask* item) {
+  const int sequence_token_id = item->sequence_token_id;
+  if (!sequence_token_id) {
+    RunOrDiscardTask(item);
+    return;
+  }
+
+  // We own the sequence until we either re-queue it or drop it from
+  // |sequence_queues_|, so its tasks can't run concurrently or out of order.
+  {
+    AutoLock lock(sequences_lock_);
+    SequenceQueueMap::iterator found = sequence_queues_.find(sequence_token_id);
+    DCHECK(found != sequence_queues_.end());
+    DCHECK(!found->second.empty());
+    *item = found->second.front();
+    found->second.pop_front();
+  }
+
+  RunOrDiscardTask(item);
+
+  bool has_more_tasks;
+  {
+    AutoLock lock(sequences_lock_);
+    SequenceQueueMap::iterator found = sequence_queues_.find(sequence_token_id);
+    DCHECK(found != sequence_queues_.end());
+    has_more_tasks = !found->second.empty();
+    if (!has_more_tasks)
+      sequence_queues_.erase(found);
+  }
+
+  // Hand the sequence on. It goes to the back of our own queue, so we will
+  // most likely run the next task ourselves, but an idle worker may steal it.
+  if (has_more_tasks) {
+    SequencedTask entry;
+    entry.sequence_token_id = sequence_token_id;
+    PushWorkItem(entry);
+  }
+}
+
+void SequencedWorkerPool::Inner::RunOrDiscardTask(SequencedTask* task) {
+  const bool blocks_shutdown = task->shutdown_behavior == BLOCK_SHUTDOWN;
+  if (blocks_shutdown) {
+    // Count as running before no longer counting as pending; see
+    // CanShutdown().
+    subtle::Barrier_AtomicIncrement(&blocking_shutdown_running_count_, 1);
+    subtle::Barrier_AtomicIncrement(&blocking_shutdown_pending_count_, -1);
+  }
+
+  // Tasks that don't block shutdown are deleted rather than run once shutdown
+  // has started, just like GetWork() does.
+  if (blocks_shutdown || !subtle::Acquire_Load(&shutting_down_))
+    task->task.Run();
+
+  // Make sure the closure is destroyed outside of any lock, since it may
+  // hold refs to objects that post tasks from their destructors.
+  task->task = Closure();
+
+  if (blocks_shutdown) {
+    subtle::Barrier_AtomicIncrement(&blocking_shutdown_running_count_, -1);
+    if (subtle::Acquire_Load(&shutting_down_)) {
+      AutoLock lock(lock_);
+      can_shutdown_cv_.Signal();
+    }
+  }
+  subtle::Barrier_AtomicIncrement(&unfinished_task_count_, -1);
+}
+
+void SequencedWorkerPool::Inner::WakeUpWorkerIfHelpful() {
+  if (subtle::Acquire_Load(&idle_thread_count_) > 0) {
+    // Take the lock so that the signal can't slip in between an idle worker's
+    // last look at |runnable_item_count_| and its Wait().
+    AutoLock lock(lock_);
+    SignalHasWork();
+    return;
+  }
+  if (subtle::Acquire_Load(&all_threads_started_))
+    return;
+
+  int create_thread_id = 0;
+  {
+    AutoLock lock(lock_);
+    create_thread_id = PrepareToStartAdditionalThreadIfHelpful();
+  }
+  if (create_thread_id)
+    FinishStartingAdditionalThread(create_thread_id);
+}
+
+WorkQueue* SequencedWorkerPool::Inner::GetCurrentThreadWorkQueue() const {
+  WorkQueue* queue = g_current_work_queue.Get().Get();
+  return queue && queue->owner == this ? queue : NULL;
+}
+
 // SequencedWorkerPool --------------------------------------------------------
 
 SequencedWorkerPool::SequencedWorkerPool(
@@ -691,16 +1111,27 @@ SequencedWorkerPool::SequencedWorkerPool(
     const std::string& thread_name_prefix)
     : constructor_message_loop_(MessageLoopProxy::current()),
       inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
-                       max_threads, thread_name_prefix, NULL)) {
+                       max_threads, thread_name_prefix, SHARED_QUEUE, NULL)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    TestingObserver* observer)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
+                       max_threads, thread_name_prefix, SHARED_QUEUE,
+                       observer)) {
 }
 
 SequencedWorkerPool::SequencedWorkerPool(
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode mode,
     TestingObserver* observer)
     : constructor_message_loop_(MessageLoopProxy::current()),
       inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
-                       max_threads, thread_name_prefix, observer)) {
+                       max_threads, thread_name_prefix, mode, observer)) {
 }
 
 SequencedWorkerPool::~SequencedWorkerPool() {}
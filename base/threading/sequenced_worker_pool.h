@@ -57,6 +57,13 @@ template <class T> class DeleteHelper;
 // threads to run. For the typical use case of random background work, we don't
 // necessarily want to be super aggressive about creating threads.
 //
+// Scheduling: by default every task goes through a single queue protected by
+// one lock, which is simple and fair but stops scaling past a handful of
+// cores. A pool constructed with WORK_STEALING gives each worker its own
+// deque of runnable work instead. Idle workers steal from the other deques,
+// and tasks sharing a sequence token wait in a per-sequence queue that is
+// handed from worker to worker. See SchedulingMode below.
+//
 // Note that SequencedWorkerPool is RefCountedThreadSafe (inherited
 // from TaskRunner).
 class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
@@ -99,6 +106,26 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
     BLOCK_SHUTDOWN,
   };
 
+  // Defines how pending tasks are handed to worker threads.
+  enum SchedulingMode {
+    // All pending tasks live in one list behind the pool's lock and are
+    // picked up roughly in posting order.
+    SHARED_QUEUE,
+
+    // Each worker owns a deque of runnable work and takes from its back.
+    // A worker that runs dry steals from the front of the other deques.
+    // Tasks posted from a worker go to that worker's deque. Tasks posted from
+    // other threads are spread round-robin. Unsequenced tasks may therefore
+    // run in a different order than they were posted.
+    //
+    // Sequenced tasks are queued per sequence token. The deques only hold one
+    // entry for the whole sequence, and the worker that runs a task of the
+    // sequence re-queues that entry when it is done. That keeps the sequence
+    // ordered without scanning unrunnable tasks. Shutdown behavior is the
+    // same as in SHARED_QUEUE mode.
+    WORK_STEALING,
+  };
+
   // Opaque identifier that defines sequencing of tasks posted to the worker
   // pool.
   class SequenceToken {
@@ -142,6 +169,12 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
                       const std::string& thread_name_prefix,
                       TestingObserver* observer);
 
+  // Like above, but uses the given scheduling |mode|. |observer| may be NULL.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      SchedulingMode mode,
+                      TestingObserver* observer);
+
   // Returns a unique token that can be used to sequence tasks posted to
   // PostSequencedWorkerTask(). Valid tokens are alwys nonzero.
   SequenceToken GetSequenceToken();
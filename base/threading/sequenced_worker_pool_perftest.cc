@@ -0,0 +1,175 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kNumTasks = 200000;
+const int kNumSequences = 64;
+
+// Counts completed tasks and signals when all of them have run. Each task does
+// a little arithmetic so that the pool's overhead is what gets measured.
+class TaskCounter : public RefCountedThreadSafe<TaskCounter> {
+ public:
+  explicit TaskCounter(int expected)
+      : remaining_(expected), done_(false, false) {}
+
+  void Run() {
+    volatile int sink = 0;
+    for (int i = 0; i < 100; ++i)
+      sink += i;
+    if (subtle::Barrier_AtomicIncrement(&remaining_, -1) == 0)
+      done_.Signal();
+  }
+
+  // Posts |fan_out| copies of itself, recursing |depth| times, from whatever
+  // thread it runs on. In WORK_STEALING mode these go to the worker's own
+  // queue and are spread by stealing.
+  void RunAndFanOut(const scoped_refptr<SequencedWorkerPool>& pool,
+                    int depth,
+                    int fan_out) {
+    if (depth > 0) {
+      for (int i = 0; i < fan_out; ++i) {
+        pool->PostWorkerTask(
+            FROM_HERE,
+            Bind(&TaskCounter::RunAndFanOut, this, pool, depth - 1, fan_out));
+      }
+    }
+    Run();
+  }
+
+  void Wait() { done_.Wait(); }
+
+ private:
+  friend class RefCountedThreadSafe<TaskCounter>;
+  ~TaskCounter() {}
+
+  volatile subtle::Atomic32 remaining_;
+  WaitableEvent done_;
+};
+
+const char* ModeName(SequencedWorkerPool::SchedulingMode mode) {
+  return mode == SequencedWorkerPool::WORK_STEALING ? "WorkStealing"
+                                                    : "SharedQueue";
+}
+
+void LogTasksPerSecond(const std::string& name, const PerfTimer& timer,
+                       int num_tasks) {
+  LogPerfResult(name.c_str(),
+                num_tasks / timer.Elapsed().InSecondsF(), "tasks/s");
+}
+
+// Unsequenced tasks posted from the main thread.
+void RunUnsequenced(SequencedWorkerPool::SchedulingMode mode,
+                    size_t num_threads) {
+  scoped_refptr<SequencedWorkerPool> pool(
+      new SequencedWorkerPool(num_threads, "Perf", mode, NULL));
+  scoped_refptr<TaskCounter> counter(new TaskCounter(kNumTasks));
+  Closure task = Bind(&TaskCounter::Run, counter);
+
+  PerfTimer timer;
+  for (int i = 0; i < kNumTasks; ++i)
+    pool->PostWorkerTask(FROM_HERE, task);
+  counter->Wait();
+  LogTasksPerSecond(StringPrintf("SequencedWorkerPool_Unsequenced_%s_%dthreads",
+                                 ModeName(mode),
+                                 static_cast<int>(num_threads)),
+                    timer, kNumTasks);
+  pool->Shutdown();
+}
+
+// Tasks spread over kNumSequences sequence tokens.
+void RunSequenced(SequencedWorkerPool::SchedulingMode mode,
+                  size_t num_threads) {
+  scoped_refptr<SequencedWorkerPool> pool(
+      new SequencedWorkerPool(num_threads, "Perf", mode, NULL));
+  scoped_refptr<TaskCounter> counter(new TaskCounter(kNumTasks));
+  Closure task = Bind(&TaskCounter::Run, counter);
+  SequencedWorkerPool::SequenceToken tokens[kNumSequences];
+  for (int i = 0; i < kNumSequences; ++i)
+    tokens[i] = pool->GetSequenceToken();
+
+  PerfTimer timer;
+  for (int i = 0; i < kNumTasks; ++i)
+    pool->PostSequencedWorkerTask(tokens[i % kNumSequences], FROM_HERE, task);
+  counter->Wait();
+  LogTasksPerSecond(StringPrintf("SequencedWorkerPool_Sequenced_%s_%dthreads",
+                                 ModeName(mode),
+                                 static_cast<int>(num_threads)),
+                    timer, kNumTasks);
+  pool->Shutdown();
+}
+
+// Tasks that post more tasks from the workers: 1 + 8 + 64 + ... + 8^5.
+void RunFanOut(SequencedWorkerPool::SchedulingMode mode, size_t num_threads) {
+  const int kDepth = 5;
+  const int kFanOut = 8;
+  int total = 0;
+  for (int i = 0, level = 1; i <= kDepth; ++i, level *= kFanOut)
+    total += level;
+
+  scoped_refptr<SequencedWorkerPool> pool(
+      new SequencedWorkerPool(num_threads, "Perf", mode, NULL));
+  scoped_refptr<TaskCounter> counter(new TaskCounter(total));
+
+  PerfTimer timer;
+  pool->PostWorkerTask(
+      FROM_HERE,
+      Bind(&TaskCounter::RunAndFanOut, counter, pool, kDepth, kFanOut));
+  counter->Wait();
+  LogTasksPerSecond(StringPrintf("SequencedWorkerPool_FanOut_%s_%dthreads",
+                                 ModeName(mode),
+                                 static_cast<int>(num_threads)),
+                    timer, total);
+  pool->Shutdown();
+}
+
+const size_t kThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+const SequencedWorkerPool::SchedulingMode kModes[] = {
+  SequencedWorkerPool::SHARED_QUEUE,
+  SequencedWorkerPool::WORK_STEALING,
+};
+
+}  // namespace
+
+// The pools are leaked at the end of each test: they are destroyed on
+// |message_loop|, which is never run again.
+
+TEST(SequencedWorkerPoolPerfTest, Unsequenced) {
+  MessageLoop message_loop;
+  for (size_t i = 0; i < arraysize(kModes); ++i) {
+    for (size_t j = 0; j < arraysize(kThreadCounts); ++j)
+      RunUnsequenced(kModes[i], kThreadCounts[j]);
+  }
+}
+
+TEST(SequencedWorkerPoolPerfTest, Sequenced) {
+  MessageLoop message_loop;
+  for (size_t i = 0; i < arraysize(kModes); ++i) {
+    for (size_t j = 0; j < arraysize(kThreadCounts); ++j)
+      RunSequenced(kModes[i], kThreadCounts[j]);
+  }
+}
+
+TEST(SequencedWorkerPoolPerfTest, FanOut) {
+  MessageLoop message_loop;
+  for (size_t i = 0; i < arraysize(kModes); ++i) {
+    for (size_t j = 0; j < arraysize(kThreadCounts); ++j)
+      RunFanOut(kModes[i], kThreadCounts[j]);
+  }
+}
+
+}  // namespace base
@@ -3,6 +3,8 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <map>
+#include <set>
 
 #include "base/bind.h"
 #include "base/compiler_specific.h"
@@ -155,10 +157,11 @@ class TestTracker : public base::RefCountedThreadSafe<TestTracker> {
 class SequencedWorkerPoolOwner : public SequencedWorkerPool::TestingObserver {
  public:
   SequencedWorkerPoolOwner(size_t max_threads,
-                           const std::string& thread_name_prefix)
+                           const std::string& thread_name_prefix,
+                           SequencedWorkerPool::SchedulingMode mode)
       : constructor_message_loop_(MessageLoop::current()),
         pool_(new SequencedWorkerPool(
-            max_threads, thread_name_prefix,
+            max_threads, thread_name_prefix, mode,
             ALLOW_THIS_IN_INITIALIZER_LIST(this))),
         has_work_call_count_(0) {}
 
@@ -211,10 +214,12 @@ class SequencedWorkerPoolOwner : public SequencedWorkerPool::TestingObserver {
   DISALLOW_COPY_AND_ASSIGN(SequencedWorkerPoolOwner);
 };
 
-class SequencedWorkerPoolTest : public testing::Test {
+// Runs every test against both scheduling modes.
+class SequencedWorkerPoolTest
+    : public testing::TestWithParam<SequencedWorkerPool::SchedulingMode> {
  public:
   SequencedWorkerPoolTest()
-      : pool_owner_(kNumWorkerThreads, "test"),
+      : pool_owner_(kNumWorkerThreads, "test", GetParam()),
         tracker_(new TestTracker) {}
 
   ~SequencedWorkerPoolTest() {}
@@ -277,6 +282,69 @@ class SequencedWorkerPoolTest : public testing::Test {
   const scoped_refptr<TestTracker> tracker_;
 };
 
+// Records the tasks of several sequences as they run, checking that each
+// sequence's tasks run in order and never concurrently.
+class SequenceChecker : public base::RefCountedThreadSafe<SequenceChecker> {
+ public:
+  explicit SequenceChecker(int total_tasks)
+      : lock_(),
+        cond_var_(&lock_),
+        remaining_tasks_(total_tasks) {
+  }
+
+  // Posts |count| tasks to |pool| with |token|, recorded as |sequence|.
+  void PostSequence(const scoped_refptr<SequencedWorkerPool>& pool,
+                    SequencedWorkerPool::SequenceToken token,
+                    int sequence,
+                    int count) {
+    for (int i = 0; i < count; ++i) {
+      pool->PostSequencedWorkerTask(
+          token, FROM_HERE,
+          base::Bind(&SequenceChecker::RunTask, this, sequence, i));
+    }
+  }
+
+  void WaitUntilDone() {
+    base::AutoLock lock(lock_);
+    while (remaining_tasks_ > 0)
+      cond_var_.Wait();
+  }
+
+  int next_expected(int sequence) {
+    base::AutoLock lock(lock_);
+    return next_expected_[sequence];
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<SequenceChecker>;
+  ~SequenceChecker() {}
+
+  void RunTask(int sequence, int index) {
+    {
+      base::AutoLock lock(lock_);
+      EXPECT_EQ(0u, running_.count(sequence));
+      EXPECT_EQ(next_expected_[sequence], index);
+      running_.insert(sequence);
+    }
+    // Give other workers a chance to pick up the same sequence if it were
+    // wrongly runnable.
+    base::PlatformThread::YieldCurrentThread();
+    {
+      base::AutoLock lock(lock_);
+      running_.erase(sequence);
+      next_expected_[sequence] = index + 1;
+      remaining_tasks_--;
+    }
+    cond_var_.Signal();
+  }
+
+  base::Lock lock_;
+  base::ConditionVariable cond_var_;
+  std::map<int, int> next_expected_;
+  std::multiset<int> running_;
+  int remaining_tasks_;
+};
+
 // Checks that the given number of entries are in the tasks to complete of
 // the given tracker, and then signals the given event the given number of
 // times. This is used to wakt up blocked background threads before blocking
@@ -293,7 +361,7 @@ void EnsureTasksToCompleteCountAndUnblock(scoped_refptr<TestTracker> tracker,
 }
 
 // Tests that same-named tokens have the same ID.
-TEST_F(SequencedWorkerPoolTest, NamedTokens) {
+TEST_P(SequencedWorkerPoolTest, NamedTokens) {
   const std::string name1("hello");
   SequencedWorkerPool::SequenceToken token1 =
       pool()->GetNamedSequenceToken(name1);
@@ -321,7 +389,7 @@ TEST_F(SequencedWorkerPoolTest, NamedTokens) {
 
 // Tests that posting a bunch of tasks (many more than the number of worker
 // threads) runs them all.
-TEST_F(SequencedWorkerPoolTest, LotsOfTasks) {
+TEST_P(SequencedWorkerPoolTest, LotsOfTasks) {
   pool()->PostWorkerTask(FROM_HERE,
                          base::Bind(&TestTracker::SlowTask, tracker(), 0));
 
@@ -339,9 +407,9 @@ TEST_F(SequencedWorkerPoolTest, LotsOfTasks) {
 // worker threads) to two pools simultaneously runs them all twice.
 // This test is meant to shake out any concurrency issues between
 // pools (like histograms).
-TEST_F(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
-  SequencedWorkerPoolOwner pool1(kNumWorkerThreads, "test1");
-  SequencedWorkerPoolOwner pool2(kNumWorkerThreads, "test2");
+TEST_P(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
+  SequencedWorkerPoolOwner pool1(kNumWorkerThreads, "test1", GetParam());
+  SequencedWorkerPoolOwner pool2(kNumWorkerThreads, "test2", GetParam());
 
   base::Closure slow_task = base::Bind(&TestTracker::SlowTask, tracker(), 0);
   pool1.pool()->PostWorkerTask(FROM_HERE, slow_task);
@@ -365,7 +433,7 @@ TEST_F(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
 
 // Test that tasks with the same sequence token are executed in order but don't
 // affect other tasks.
-TEST_F(SequencedWorkerPoolTest, Sequence) {
+TEST_P(SequencedWorkerPoolTest, Sequence) {
   // Fill all the worker threads except one.
   const size_t kNumBackgroundTasks = kNumWorkerThreads - 1;
   ThreadBlocker background_blocker;
@@ -426,7 +494,7 @@ TEST_F(SequencedWorkerPoolTest, Sequence) {
 
 // Tests that unrun tasks are discarded properly according to their shutdown
 // mode.
-TEST_F(SequencedWorkerPoolTest, DiscardOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, DiscardOnShutdown) {
   // Start tasks to take all the threads and block them.
   EnsureAllWorkersCreated();
   ThreadBlocker blocker;
@@ -471,7 +539,7 @@ TEST_F(SequencedWorkerPoolTest, DiscardOnShutdown) {
 }
 
 // Tests that CONTINUE_ON_SHUTDOWN tasks don't block shutdown.
-TEST_F(SequencedWorkerPoolTest, ContinueOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, ContinueOnShutdown) {
   EnsureAllWorkersCreated();
   ThreadBlocker blocker;
   pool()->PostWorkerTaskWithShutdownBehavior(
@@ -501,7 +569,7 @@ TEST_F(SequencedWorkerPoolTest, ContinueOnShutdown) {
 // Ensure all worker threads are created, and then trigger a spurious
 // work signal. This shouldn't cause any other work signals to be
 // triggered. This is a regression test for http://crbug.com/117469.
-TEST_F(SequencedWorkerPoolTest, SpuriousWorkSignal) {
+TEST_P(SequencedWorkerPoolTest, SpuriousWorkSignal) {
   EnsureAllWorkersCreated();
   int old_has_work_call_count = has_work_call_count();
   pool()->SignalHasWorkForTesting();
@@ -510,6 +578,30 @@ TEST_F(SequencedWorkerPoolTest, SpuriousWorkSignal) {
   EXPECT_EQ(old_has_work_call_count + 1, has_work_call_count());
 }
 
+// Tests that many tasks posted from worker threads to several sequences at
+// once run exactly once and in order within each sequence.
+TEST_P(SequencedWorkerPoolTest, ManySequencesFromWorkers) {
+  const int kNumSequences = 8;
+  const int kTasksPerSequence = 50;
+  scoped_refptr<SequenceChecker> checker(
+      new SequenceChecker(kNumSequences * kTasksPerSequence));
+  for (int i = 0; i < kNumSequences; ++i) {
+    pool()->PostWorkerTask(
+        FROM_HERE,
+        base::Bind(&SequenceChecker::PostSequence, checker, pool(),
+                   pool()->GetSequenceToken(), i, kTasksPerSequence));
+  }
+  checker->WaitUntilDone();
+  for (int i = 0; i < kNumSequences; ++i)
+    EXPECT_EQ(kTasksPerSequence, checker->next_expected(i));
+}
+
+INSTANTIATE_TEST_CASE_P(
+    SchedulingModes, SequencedWorkerPoolTest,
+    testing::Values(SequencedWorkerPool::SHARED_QUEUE,
+                    SequencedWorkerPool::WORK_STEALING));
+
+template <SequencedWorkerPool::SchedulingMode mode>
 class SequencedWorkerPoolTaskRunnerTestDelegate {
  public:
   SequencedWorkerPoolTaskRunnerTestDelegate() {}
@@ -518,7 +610,8 @@ class SequencedWorkerPoolTaskRunnerTestDelegate {
 
   void StartTaskRunner() {
     pool_owner_.reset(
-        new SequencedWorkerPoolOwner(10, "SequencedWorkerPoolTaskRunnerTest"));
+        new SequencedWorkerPoolOwner(10, "SequencedWorkerPoolTaskRunnerTest",
+                                     mode));
   }
 
   scoped_refptr<SequencedWorkerPool> GetTaskRunner() {
@@ -544,7 +637,13 @@ class SequencedWorkerPoolTaskRunnerTestDelegate {
 
 INSTANTIATE_TYPED_TEST_CASE_P(
     SequencedWorkerPool, TaskRunnerTest,
-    SequencedWorkerPoolTaskRunnerTestDelegate);
+    SequencedWorkerPoolTaskRunnerTestDelegate<
+        SequencedWorkerPool::SHARED_QUEUE>);
+
+INSTANTIATE_TYPED_TEST_CASE_P(
+    SequencedWorkerPoolWorkStealing, TaskRunnerTest,
+    SequencedWorkerPoolTaskRunnerTestDelegate<
+        SequencedWorkerPool::WORK_STEALING>);
 
 }  // namespace
 
@@ -4,28 +4,52 @@
 
 #include "base/timer.h"
 
-#include "base/bind.h"
-#include "base/bind_helpers.h"
 #include "base/message_loop.h"
 
 namespace base {
 
-void BaseTimer_Helper::OrphanDelayedTask() {
-  if (delayed_task_) {
-    delayed_task_->timer_ = NULL;
-    delayed_task_ = NULL;
+BaseTimer_Helper::~BaseTimer_Helper() {
+  if (delayed_task_ && delayed_task_->IsScheduled() &&
+      !IsOnLoopOfDelayedTask()) {
+    OrphanDelayedTask();
   }
+  delete delayed_task_;  // Cancels the task if it is still scheduled.
+}
+
+void BaseTimer_Helper::CancelDelayedTask() {
+  if (!delayed_task_ || !delayed_task_->IsScheduled())
+    return;
+  if (IsOnLoopOfDelayedTask())
+    delayed_task_->Cancel();
+  else
+    OrphanDelayedTask();
+}
+
+bool BaseTimer_Helper::IsOnLoopOfDelayedTask() const {
+  // The wheel of a loop may only be touched on its thread.
+  DCHECK_EQ(delayed_task_->loop_, MessageLoop::current());
+  return delayed_task_->loop_ == MessageLoop::current();
+}
+
+void BaseTimer_Helper::OrphanDelayedTask() {
+  delayed_task_->timer_ = NULL;
+  delayed_task_->loop_->DeleteSoon(FROM_HERE, delayed_task_);
+  delayed_task_ = NULL;
 }
 
 void BaseTimer_Helper::InitiateDelayedTask(TimerTask* timer_task) {
-  OrphanDelayedTask();
+  delete delayed_task_;
 
   delayed_task_ = timer_task;
   delayed_task_->timer_ = this;
-  MessageLoop::current()->PostDelayedTask(
-      timer_task->posted_from_,
-      base::Bind(&TimerTask::Run, base::Owned(timer_task)),
-      timer_task->delay_);
+  RestartDelayedTask();
+}
+
+void BaseTimer_Helper::RestartDelayedTask() {
+  DCHECK(!delayed_task_->IsScheduled() || IsOnLoopOfDelayedTask());
+  delayed_task_->loop_ = MessageLoop::current();
+  delayed_task_->loop_->ScheduleTimer(
+      delayed_task_, TimeTicks::Now() + delayed_task_->delay_);
 }
 
 }  // namespace base
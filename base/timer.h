@@ -49,9 +49,11 @@
 // should be able to tell the difference.
 
 #include "base/base_export.h"
+#include "base/compiler_specific.h"
 #include "base/location.h"
 #include "base/logging.h"
 #include "base/time.h"
+#include "base/timer_wheel.h"
 
 class MessageLoop;
 
@@ -63,16 +65,19 @@ namespace base {
 //
 // This class exists to share code between BaseTimer<T> template instantiations.
 //
+// A running timer is scheduled in the TimerWheel of the MessageLoop on which
+// it was started, so that stopping or resetting it does not leave a task
+// behind in the loop.  It must be stopped, reset and destroyed on the thread
+// of that loop; a timer that is not running can be destroyed anywhere.
+//
 class BASE_EXPORT BaseTimer_Helper {
  public:
   // Stops the timer.
-  ~BaseTimer_Helper() {
-    OrphanDelayedTask();
-  }
+  ~BaseTimer_Helper();
 
   // Returns true if the timer is running (i.e., not stopped).
   bool IsRunning() const {
-    return delayed_task_ != NULL;
+    return delayed_task_ && delayed_task_->IsScheduled();
   }
 
   // Returns the current delay for this timer.  May only call this method when
@@ -85,29 +90,42 @@ class BASE_EXPORT BaseTimer_Helper {
  protected:
   BaseTimer_Helper() : delayed_task_(NULL) {}
 
-  // We have access to the timer_ member so we can orphan this task.
-  class TimerTask {
+  // The entry that is scheduled while the timer runs.  It is owned by the
+  // timer, and reused each time the timer is reset or repeats.
+  class TimerTask : public TimerWheel::Entry {
    public:
     TimerTask(const tracked_objects::Location& posted_from,
               TimeDelta delay)
-        : posted_from_(posted_from),
+        : TimerWheel::Entry(posted_from),
+          delay_(delay),
           timer_(NULL),
-          delay_(delay) {
+          loop_(NULL) {
     }
-    virtual ~TimerTask() {}
-    virtual void Run() = 0;
-    tracked_objects::Location posted_from_;
-    BaseTimer_Helper* timer_;
     TimeDelta delay_;
+    // Null once the task is orphaned.
+    BaseTimer_Helper* timer_;
+    // The loop whose wheel the task was last scheduled in.
+    MessageLoop* loop_;
   };
 
-  // Used to orphan delayed_task_ so that when it runs it does nothing.
+  // Used to stop delayed_task_ from running.
+  void CancelDelayedTask();
+
+  // Returns true if delayed_task_ can be removed from its wheel on this
+  // thread.
+  bool IsOnLoopOfDelayedTask() const;
+
+  // Lets go of delayed_task_, which stays scheduled on another thread but
+  // does nothing once due, and is deleted by its loop.
   void OrphanDelayedTask();
 
-  // Used to initiated a new delayed task.  This has the side-effect of
-  // orphaning delayed_task_ if it is non-null.
+  // Used to start a new delayed task.  This has the side-effect of deleting
+  // delayed_task_ if it is non-null.
   void InitiateDelayedTask(TimerTask* timer_task);
 
+  // Schedules delayed_task_ to run once its delay has passed from now.
+  void RestartDelayedTask();
+
   TimerTask* delayed_task_;
 
   DISALLOW_COPY_AND_ASSIGN(BaseTimer_Helper);
@@ -134,13 +152,13 @@ class BaseTimer : public BaseTimer_Helper {
   // Call this method to stop the timer.  It is a no-op if the timer is not
   // running.
   void Stop() {
-    OrphanDelayedTask();
+    CancelDelayedTask();
   }
 
   // Call this method to reset the timer delay of an already running timer.
   void Reset() {
     DCHECK(IsRunning());
-    InitiateDelayedTask(static_cast<TimerTask*>(delayed_task_)->Clone());
+    RestartDelayedTask();
   }
 
  private:
@@ -157,52 +175,17 @@ class BaseTimer : public BaseTimer_Helper {
           method_(method) {
     }
 
-    virtual ~TimerTask() {
-      // This task may be getting cleared because the MessageLoop has been
-      // destructed.  If so, don't leave the Timer with a dangling pointer
-      // to this now-defunct task.
-      ClearBaseTimer();
-    }
-
-    virtual void Run() {
+    virtual void Run() OVERRIDE {
       if (!timer_)  // timer_ is null if we were orphaned.
         return;
       if (kIsRepeating)
-        ResetBaseTimer();
-      else
-        ClearBaseTimer();
+        static_cast<SelfType*>(timer_)->RestartDelayedTask();
+      // The receiver may stop, restart or delete the timer, and with it this
+      // task, so do not touch any members after this call.
       (receiver_->*method_)();
     }
 
-    TimerTask* Clone() const {
-      return new TimerTask(posted_from_, delay_, receiver_, method_);
-    }
-
    private:
-    // Inform the Base that the timer is no longer active.
-    void ClearBaseTimer() {
-      if (timer_) {
-        SelfType* self = static_cast<SelfType*>(timer_);
-        // It is possible that the Timer has already been reset, and that this
-        // Task is old.  So, if the Timer points to a different task, assume
-        // that the Timer has already taken care of properly setting the task.
-        if (self->delayed_task_ == this)
-          self->delayed_task_ = NULL;
-        // By now the delayed_task_ in the Timer does not point to us anymore.
-        // We should reset our own timer_ because the Timer can not do this
-        // for us in its destructor.
-        timer_ = NULL;
-      }
-    }
-
-    // Inform the Base that we're resetting the timer.
-    void ResetBaseTimer() {
-      DCHECK(timer_);
-      DCHECK(kIsRepeating);
-      SelfType* self = static_cast<SelfType*>(timer_);
-      self->Reset();
-    }
-
     Receiver* receiver_;
     ReceiverMethod method_;
   };
@@ -245,44 +228,21 @@ class DelayTimer {
   }
 
   void Reset() {
-    DelayFor(delay_);
+    // Pushing back the deadline of a running timer is cheap, so there is no
+    // need to let it expire early and check the time then.
+    if (timer_.IsRunning())
+      timer_.Reset();
+    else
+      timer_.Start(posted_from_, delay_, receiver_, method_);
   }
 
  private:
-  void DelayFor(TimeDelta delay) {
-    trigger_time_ = TimeTicks::Now() + delay;
-
-    // If we already have a timer that will expire at or before the given delay,
-    // then we have nothing more to do now.
-    if (timer_.IsRunning() && timer_.GetCurrentDelay() <= delay)
-      return;
-
-    // The timer isn't running, or will expire too late, so restart it.
-    timer_.Stop();
-    timer_.Start(posted_from_, delay, this, &DelayTimer<Receiver>::Check);
-  }
-
-  void Check() {
-    if (trigger_time_.is_null())
-      return;
-
-    // If we have not waited long enough, then wait some more.
-    const TimeTicks now = TimeTicks::Now();
-    if (now < trigger_time_) {
-      DelayFor(trigger_time_ - now);
-      return;
-    }
-
-    (receiver_->*method_)();
-  }
-
   tracked_objects::Location posted_from_;
   Receiver *const receiver_;
   const ReceiverMethod method_;
   const TimeDelta delay_;
 
-  OneShotTimer<DelayTimer<Receiver> > timer_;
-  TimeTicks trigger_time_;
+  OneShotTimer<Receiver> timer_;
 };
 
 }  // namespace base
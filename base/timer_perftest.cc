@@ -0,0 +1,116 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/timer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kTimers = 100000;
+
+class Receiver {
+ public:
+  Receiver() : count_(0) {}
+  void OnTimer() {
+    ++count_;
+  }
+  int count() const { return count_; }
+
+ private:
+  int count_;
+};
+
+typedef OneShotTimer<Receiver> Timer;
+
+// Starts kTimers timers with delays of up to |max_delay_ms|, the way the many
+// timeouts of a busy network stack would be, and returns them.
+void StartTimers(ScopedVector<Timer>* timers, Receiver* receiver,
+                 int max_delay_ms) {
+  for (int i = 0; i < kTimers; ++i) {
+    Timer* timer = new Timer;
+    timer->Start(FROM_HERE,
+                 TimeDelta::FromMilliseconds(1 + i % max_delay_ms),
+                 receiver, &Receiver::OnTimer);
+    timers->push_back(timer);
+  }
+}
+
+void LogPerTimer(const char* name, const PerfTimer& timer) {
+  LogPerfResult(name, timer.Elapsed().InMicroseconds() * 1000.0 / kTimers,
+                "ns/timer");
+}
+
+}  // namespace
+
+// Timeouts that are started and then stopped before they expire.
+TEST(TimerPerfTest, StartStop) {
+  MessageLoop loop;
+  Receiver receiver;
+  ScopedVector<Timer> timers;
+  {
+    PerfTimer timer;
+    StartTimers(&timers, &receiver, 30000);
+    LogPerTimer("Timer_Start", timer);
+  }
+  {
+    PerfTimer timer;
+    for (int i = 0; i < kTimers; ++i)
+      timers[i]->Stop();
+    LogPerTimer("Timer_Stop", timer);
+  }
+  {
+    // Stopped timers should leave nothing behind for the loop to go through.
+    PerfTimer timer;
+    loop.RunAllPending();
+    LogPerTimer("Timer_RunAfterStop", timer);
+  }
+  EXPECT_EQ(0, receiver.count());
+}
+
+// Timeouts that are pushed back, e.g. each time some data arrives.
+TEST(TimerPerfTest, Reset) {
+  MessageLoop loop;
+  Receiver receiver;
+  ScopedVector<Timer> timers;
+  StartTimers(&timers, &receiver, 30000);
+  {
+    PerfTimer timer;
+    for (int round = 0; round < 10; ++round) {
+      for (int i = 0; i < kTimers; ++i)
+        timers[i]->Reset();
+    }
+    LogPerfResult("Timer_Reset",
+                  timer.Elapsed().InMicroseconds() * 1000.0 / (10 * kTimers),
+                  "ns/reset");
+  }
+  {
+    PerfTimer timer;
+    timers.reset();
+    loop.RunAllPending();
+    LogPerTimer("Timer_DestroyAfterReset", timer);
+  }
+  EXPECT_EQ(0, receiver.count());
+}
+
+// Timeouts that expire.
+TEST(TimerPerfTest, Fire) {
+  MessageLoop loop;
+  Receiver receiver;
+  ScopedVector<Timer> timers;
+  StartTimers(&timers, &receiver, 50);
+  PerfTimer timer;
+  MessageLoop::current()->PostDelayedTask(
+      FROM_HERE, MessageLoop::QuitClosure(), TimeDelta::FromMilliseconds(60));
+  MessageLoop::current()->Run();
+  LogPerTimer("Timer_Fire", timer);
+  EXPECT_EQ(kTimers, receiver.count());
+}
+
+}  // namespace base
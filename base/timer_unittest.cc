@@ -2,6 +2,9 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <vector>
+
+#include "base/bind.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "base/timer.h"
@@ -269,6 +272,46 @@ void RunTest_DelayTimer_Deleted(MessageLoop::Type message_loop_type) {
   base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(100));
 }
 
+class OrderRecorder {
+ public:
+  explicit OrderRecorder(std::vector<int>* order) : order_(order) {}
+  void Record(int value) {
+    order_->push_back(value);
+  }
+  void RecordTimer() {
+    Record(2);
+  }
+ private:
+  std::vector<int>* order_;
+};
+
+void RunTest_TimerBetweenDelayedTasks(MessageLoop::Type message_loop_type) {
+  MessageLoop loop(message_loop_type);
+
+  std::vector<int> order;
+  OrderRecorder recorder(&order);
+  base::OneShotTimer<OrderRecorder> timer;
+  timer.Start(FROM_HERE, TimeDelta::FromMilliseconds(40), &recorder,
+              &OrderRecorder::RecordTimer);
+  MessageLoop::current()->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&OrderRecorder::Record, base::Unretained(&recorder), 1),
+      TimeDelta::FromMilliseconds(10));
+  MessageLoop::current()->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&OrderRecorder::Record, base::Unretained(&recorder), 3),
+      TimeDelta::FromMilliseconds(80));
+  MessageLoop::current()->PostDelayedTask(
+      FROM_HERE, MessageLoop::QuitClosure(), TimeDelta::FromMilliseconds(90));
+  MessageLoop::current()->Run();
+
+  ASSERT_EQ(3u, order.size());
+  EXPECT_EQ(1, order[0]);
+  EXPECT_EQ(2, order[1]);
+  EXPECT_EQ(3, order[2]);
+  EXPECT_FALSE(timer.IsRunning());
+}
+
 }  // namespace
 
 //-----------------------------------------------------------------------------
@@ -332,6 +375,14 @@ TEST(TimerTest, DelayTimer_Deleted) {
   RunTest_DelayTimer_Deleted(MessageLoop::TYPE_IO);
 }
 
+// Timers and delayed tasks share the loop, and run in the order in which they
+// become due.
+TEST(TimerTest, TimerBetweenDelayedTasks) {
+  RunTest_TimerBetweenDelayedTasks(MessageLoop::TYPE_DEFAULT);
+  RunTest_TimerBetweenDelayedTasks(MessageLoop::TYPE_UI);
+  RunTest_TimerBetweenDelayedTasks(MessageLoop::TYPE_IO);
+}
+
 TEST(TimerTest, MessageLoopShutdown) {
   // This test is designed to verify that shutdown of the
   // message loop does not cause crashes if there were pending
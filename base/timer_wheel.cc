@@ -0,0 +1,248 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/timer_wheel.h"
+
+#include "base/logging.h"
+
+namespace base {
+
+namespace {
+
+// Returns the index of the lowest set bit in |bits|, which must not be zero.
+int FindFirstSet(uint64 bits) {
+  DCHECK(bits);
+#if defined(COMPILER_GCC)
+  return __builtin_ctzll(bits);
+#else
+  int index = 0;
+  while (!(bits & 1)) {
+    bits >>= 1;
+    ++index;
+  }
+  return index;
+#endif
+}
+
+}  // namespace
+
+TimerWheel::Entry::Entry(const tracked_objects::Location& posted_from)
+    : posted_from_(posted_from),
+      tick_(0),
+      wheel_(NULL),
+      list_(NULL),
+      prev_(NULL),
+      next_(NULL) {
+}
+
+TimerWheel::Entry::~Entry() {
+  Cancel();
+}
+
+void TimerWheel::Entry::Cancel() {
+  if (wheel_)
+    wheel_->Cancel(this);
+}
+
+TimerWheel::TimerWheel()
+    : origin_(TimeTicks::Now()),
+      current_tick_(0),
+      due_(NULL),
+      size_(0) {
+  for (int level = 0; level < kLevels; ++level) {
+    for (int index = 0; index < kSlotsPerLevel; ++index)
+      slots_[level][index] = NULL;
+    occupied_[level] = 0;
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  CancelAll();
+}
+
+void TimerWheel::Schedule(Entry* entry, TimeTicks deadline) {
+  entry->Cancel();
+  entry->deadline_ = deadline;
+  entry->tick_ = TickForTime(deadline);
+  entry->wheel_ = this;
+  ++size_;
+  Place(entry);
+}
+
+void TimerWheel::Cancel(Entry* entry) {
+  DCHECK_EQ(this, entry->wheel_);
+  Remove(entry);
+  entry->wheel_ = NULL;
+  --size_;
+}
+
+void TimerWheel::CancelAll() {
+  for (int level = 0; level < kLevels; ++level) {
+    for (int index = 0; index < kSlotsPerLevel; ++index) {
+      while (slots_[level][index])
+        Cancel(slots_[level][index]);
+    }
+  }
+  while (due_)
+    Cancel(due_);
+  DCHECK_EQ(0u, size_);
+}
+
+void TimerWheel::AdvanceTo(TimeTicks now) {
+  if (now < origin_)
+    return;
+  int64 target = (now - origin_).InMilliseconds();
+
+  for (;;) {
+    int64 tick = NextTick();
+    if (tick < 0 || tick > target)
+      break;
+    current_tick_ = tick;
+
+    // Cascade the outer wheels first, as their entries may land in the slots
+    // of the inner wheels that are processed at this same tick.
+    for (int level = kLevels - 1; level > 0; --level) {
+      int shift = level * kBitsPerLevel;
+      if (tick & ((GG_INT64_C(1) << shift) - 1))
+        continue;  // Not on a boundary of this wheel.
+      int index = static_cast<int>((tick >> shift) & (kSlotsPerLevel - 1));
+      if (occupied_[level] & (GG_UINT64_C(1) << index))
+        Cascade(level, index);
+    }
+
+    Entry** slot = &slots_[0][tick & (kSlotsPerLevel - 1)];
+    while (*slot) {
+      Entry* entry = *slot;
+      Remove(entry);
+      Append(&due_, entry);
+    }
+    current_tick_ = tick + 1;
+  }
+
+  // Nothing is left in the slots for the ticks up to |target|.
+  if (current_tick_ <= target)
+    current_tick_ = target + 1;
+}
+
+TimeTicks TimerWheel::NextWakeTime() const {
+  if (due_)
+    return TimeForTick(due_->tick_);
+  int64 tick = NextTick();
+  if (tick < 0)
+    return TimeTicks();
+  return TimeForTick(tick);
+}
+
+int64 TimerWheel::TickForTime(TimeTicks time) const {
+  int64 microseconds = (time - origin_).InMicroseconds();
+  if (microseconds <= 0)
+    return 0;
+  return (microseconds + Time::kMicrosecondsPerMillisecond - 1) /
+      Time::kMicrosecondsPerMillisecond;
+}
+
+TimeTicks TimerWheel::TimeForTick(int64 tick) const {
+  return origin_ + TimeDelta::FromMilliseconds(tick);
+}
+
+int64 TimerWheel::NextTick() const {
+  int64 next_tick = -1;
+  for (int level = 0; level < kLevels; ++level) {
+    uint64 bits = occupied_[level];
+    if (!bits)
+      continue;
+    // Slots of this wheel are processed at the beginning of their period.
+    // Find the first period that begins at or after current_tick_, and then
+    // the first occupied slot, going around the wheel from that period.
+    int shift = level * kBitsPerLevel;
+    int64 period = (current_tick_ + (GG_INT64_C(1) << shift) - 1) >> shift;
+    int rotation = static_cast<int>(period & (kSlotsPerLevel - 1));
+    if (rotation)
+      bits = (bits >> rotation) | (bits << (kSlotsPerLevel - rotation));
+    int64 tick = (period + FindFirstSet(bits)) << shift;
+    if (next_tick < 0 || tick < next_tick)
+      next_tick = tick;
+  }
+  return next_tick;
+}
+
+void TimerWheel::Place(Entry* entry) {
+  if (entry->tick_ < current_tick_) {
+    // The tick has already passed.
+    Append(&due_, entry);
+    return;
+  }
+
+  // Use the innermost wheel that reaches the tick.  A tick beyond the reach of
+  // the outermost wheel is parked in its furthest slot, and placed again when
+  // that slot is cascaded.
+  int64 tick = entry->tick_;
+  int64 delta = tick - current_tick_;
+  int level = 0;
+  while (level < kLevels - 1 &&
+         delta >= (GG_INT64_C(1) << ((level + 1) * kBitsPerLevel))) {
+    ++level;
+  }
+  const int64 kMaxDelta = (GG_INT64_C(1) << (kLevels * kBitsPerLevel)) - 1;
+  if (delta > kMaxDelta)
+    tick = current_tick_ + kMaxDelta;
+
+  int index = static_cast<int>(
+      (tick >> (level * kBitsPerLevel)) & (kSlotsPerLevel - 1));
+  Append(&slots_[level][index], entry);
+  occupied_[level] |= GG_UINT64_C(1) << index;
+}
+
+void TimerWheel::Cascade(int level, int index) {
+  Entry* entry = slots_[level][index];
+  slots_[level][index] = NULL;
+  occupied_[level] &= ~(GG_UINT64_C(1) << index);
+  while (entry) {
+    Entry* next = entry->next_;
+    Place(entry);  // Replaces the links of |entry|.
+    entry = next;
+  }
+}
+
+void TimerWheel::Append(Entry** list, Entry* entry) {
+  entry->list_ = list;
+  entry->next_ = NULL;
+  Entry* first = *list;
+  if (!first) {
+    entry->prev_ = entry;
+    *list = entry;
+    return;
+  }
+  Entry* last = first->prev_;
+  last->next_ = entry;
+  entry->prev_ = last;
+  first->prev_ = entry;
+}
+
+void TimerWheel::Remove(Entry* entry) {
+  Entry** list = entry->list_;
+  Entry* first = *list;
+  if (entry == first) {
+    *list = entry->next_;
+    if (entry->next_)
+      entry->next_->prev_ = entry->prev_;
+  } else {
+    entry->prev_->next_ = entry->next_;
+    if (entry->next_)
+      entry->next_->prev_ = entry->prev_;
+    else
+      first->prev_ = entry->prev_;
+  }
+  entry->list_ = NULL;
+  entry->prev_ = NULL;
+  entry->next_ = NULL;
+
+  if (!*list && list != &due_) {
+    ptrdiff_t offset = list - &slots_[0][0];
+    occupied_[offset / kSlotsPerLevel] &=
+        ~(GG_UINT64_C(1) << (offset % kSlotsPerLevel));
+  }
+}
+
+}  // namespace base
@@ -0,0 +1,165 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// TimerWheel holds entries that each become due at a particular TimeTicks,
+// and hands them back once that time has come.  Unlike a priority queue, it
+// schedules and cancels an entry in constant time, and a cancelled entry is
+// removed at once (rather than lingering until its deadline).  This makes it
+// suitable for the many timeouts that are started, and then usually stopped or
+// pushed back long before they expire.
+//
+// Entries are kept in a hierarchy of wheels of slots (as described in
+// "Hashed and Hierarchical Timing Wheels" by Varghese and Lauck).  Each slot
+// of the innermost wheel holds the entries that are due in a particular
+// millisecond of the next 64, each slot of the next wheel holds the entries
+// that are due in a particular 64 millisecond period of the next 4096
+// milliseconds, and so on.  As time advances, the entries of the outer slots
+// are redistributed (cascaded) to the inner wheels, and the entries of the
+// innermost slots become due.  Deadlines are rounded up to whole milliseconds,
+// and entries that become due in the same millisecond are handed back in
+// roughly the order in which they were scheduled.
+//
+// TimerWheel is not thread safe.  MessageLoop owns one, which base::Timer uses
+// on the thread of the loop.
+
+#ifndef BASE_TIMER_WHEEL_H_
+#define BASE_TIMER_WHEEL_H_
+#pragma once
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/location.h"
+#include "base/time.h"
+
+namespace base {
+
+class BASE_EXPORT TimerWheel {
+ public:
+  // An item to be scheduled in a TimerWheel.  An Entry can be in at most one
+  // wheel at a time, and is removed from it when it is destroyed.
+  class BASE_EXPORT Entry {
+   public:
+    explicit Entry(const tracked_objects::Location& posted_from);
+    virtual ~Entry();
+
+    // Called by the owner of the wheel, once the entry is due and has been
+    // removed from the wheel.  This may delete the entry.
+    virtual void Run() = 0;
+
+    // Removes the entry from its wheel, if it is in one.
+    void Cancel();
+
+    // Returns true if the entry is in a wheel (due or not).
+    bool IsScheduled() const { return wheel_ != NULL; }
+
+    // The time at which the entry was last scheduled to become due.
+    TimeTicks deadline() const { return deadline_; }
+
+    const tracked_objects::Location& posted_from() const {
+      return posted_from_;
+    }
+
+   private:
+    friend class TimerWheel;
+
+    tracked_objects::Location posted_from_;
+    TimeTicks deadline_;
+
+    // The deadline, in whole milliseconds since the origin of the wheel.
+    int64 tick_;
+
+    // The wheel that holds this entry, and the list within that wheel.
+    TimerWheel* wheel_;
+    Entry** list_;
+
+    // Links in list_.  The first entry's prev_ points to the last entry, so
+    // that entries can be appended in constant time.
+    Entry* prev_;
+    Entry* next_;
+
+    DISALLOW_COPY_AND_ASSIGN(Entry);
+  };
+
+  TimerWheel();
+
+  // Cancels any entries that are still scheduled.
+  ~TimerWheel();
+
+  // Schedules |entry| to become due at |deadline|.  If the entry is already
+  // scheduled (in this or another wheel), it is cancelled first.
+  void Schedule(Entry* entry, TimeTicks deadline);
+
+  // Removes |entry| from this wheel, which must hold it.
+  void Cancel(Entry* entry);
+
+  // Removes all entries from the wheel, without running them.
+  void CancelAll();
+
+  // Moves the entries whose deadline has passed by |now| to the list of due
+  // entries.  As deadlines are rounded up to whole milliseconds, an entry may
+  // only be found up to a millisecond after its deadline, but never before.
+  void AdvanceTo(TimeTicks now);
+
+  // Returns the due entry that was found first by AdvanceTo(), or NULL if
+  // there is none.  The entry stays in the wheel until it is cancelled or
+  // rescheduled.
+  Entry* first_due() const { return due_; }
+
+  // Returns the earliest time at which an entry may be due, or a null
+  // TimeTicks if the wheel is empty.  AdvanceTo() may find nothing due at this
+  // time, if all it needs to do is cascade entries to the inner wheels.
+  TimeTicks NextWakeTime() const;
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+ private:
+  // Each wheel has 2^kBitsPerLevel slots.
+  static const int kBitsPerLevel = 6;
+  static const int kSlotsPerLevel = 1 << kBitsPerLevel;
+  static const int kLevels = 4;
+
+  // Returns the number of milliseconds from origin_ to |time|, rounded up.
+  int64 TickForTime(TimeTicks time) const;
+
+  // Returns the time at the beginning of |tick|.
+  TimeTicks TimeForTick(int64 tick) const;
+
+  // Returns the next tick, at or after current_tick_, at which an occupied
+  // slot must be processed, or -1 if all slots are empty.
+  int64 NextTick() const;
+
+  // Puts |entry| in the slot (or the due list) that matches its tick_.
+  void Place(Entry* entry);
+
+  // Redistributes the entries of slot |index| of wheel |level| to the inner
+  // wheels.
+  void Cascade(int level, int index);
+
+  // Appends |entry| to |list|, or removes it from the list it is in.
+  void Append(Entry** list, Entry* entry);
+  void Remove(Entry* entry);
+
+  // Time zero for the ticks.
+  const TimeTicks origin_;
+
+  // All ticks before this one have been processed by AdvanceTo().
+  int64 current_tick_;
+
+  // The slots of each wheel, and a bitmap of which slots are non-empty.
+  Entry* slots_[kLevels][kSlotsPerLevel];
+  uint64 occupied_[kLevels];
+
+  // Entries that are due, in the order they were found.
+  Entry* due_;
+
+  // The number of entries in the slots and in due_.
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace base
+
+#endif  // BASE_TIMER_WHEEL_H_
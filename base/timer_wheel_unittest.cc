@@ -0,0 +1,243 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/timer_wheel.h"
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/memory/scoped_vector.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class TestEntry : public TimerWheel::Entry {
+ public:
+  TestEntry() : TimerWheel::Entry(FROM_HERE) {}
+  virtual void Run() OVERRIDE {}
+};
+
+// A small deterministic random number generator, so that failures reproduce.
+class Random {
+ public:
+  Random() : state_(12345) {}
+  uint32 Next(uint32 range) {
+    state_ = state_ * GG_UINT64_C(6364136223846793005) +
+        GG_UINT64_C(1442695040888963407);
+    return static_cast<uint32>(state_ >> 33) % range;
+  }
+
+ private:
+  uint64 state_;
+};
+
+// Takes all due entries from |wheel|, checking that none of them was due
+// after |now|, and returns them.
+std::vector<TimerWheel::Entry*> TakeDue(TimerWheel* wheel, TimeTicks now) {
+  std::vector<TimerWheel::Entry*> due;
+  while (TimerWheel::Entry* entry = wheel->first_due()) {
+    EXPECT_LE(entry->deadline(), now);
+    wheel->Cancel(entry);
+    EXPECT_FALSE(entry->IsScheduled());
+    due.push_back(entry);
+  }
+  return due;
+}
+
+// Checks that none of |entries| that are still in |wheel| should have been
+// found by AdvanceTo(now), and that the wheel will wake up in time for them.
+void ExpectNoneOverdue(const TimerWheel& wheel,
+                       const std::vector<TestEntry*>& entries,
+                       TimeTicks now) {
+  const TimeDelta kRounding = TimeDelta::FromMilliseconds(1);
+  TimeTicks earliest;
+  size_t scheduled = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (!entries[i]->IsScheduled())
+      continue;
+    ++scheduled;
+    EXPECT_GT(entries[i]->deadline() + kRounding, now);
+    if (earliest.is_null() || entries[i]->deadline() < earliest)
+      earliest = entries[i]->deadline();
+  }
+  EXPECT_EQ(scheduled, wheel.size());
+  if (scheduled) {
+    EXPECT_FALSE(wheel.NextWakeTime().is_null());
+    EXPECT_LE(wheel.NextWakeTime(), earliest + kRounding);
+  } else {
+    EXPECT_TRUE(wheel.NextWakeTime().is_null());
+  }
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, Empty) {
+  TimerWheel wheel;
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_TRUE(wheel.NextWakeTime().is_null());
+  wheel.AdvanceTo(TimeTicks::Now() + TimeDelta::FromDays(1));
+  EXPECT_EQ(NULL, wheel.first_due());
+}
+
+TEST(TimerWheelTest, ScheduleAndCancel) {
+  TimerWheel wheel;
+  TimeTicks now = TimeTicks::Now();
+  TestEntry a, b;
+  wheel.Schedule(&a, now + TimeDelta::FromMilliseconds(10));
+  wheel.Schedule(&b, now + TimeDelta::FromMilliseconds(20));
+  EXPECT_TRUE(a.IsScheduled());
+  EXPECT_EQ(2u, wheel.size());
+
+  a.Cancel();
+  EXPECT_FALSE(a.IsScheduled());
+  EXPECT_EQ(1u, wheel.size());
+  wheel.AdvanceTo(now + TimeDelta::FromMilliseconds(15));
+  EXPECT_EQ(NULL, wheel.first_due());
+
+  wheel.AdvanceTo(now + TimeDelta::FromMilliseconds(21));
+  EXPECT_EQ(&b, wheel.first_due());
+  EXPECT_TRUE(b.IsScheduled());
+}
+
+TEST(TimerWheelTest, Reschedule) {
+  TimerWheel wheel;
+  TimeTicks now = TimeTicks::Now();
+  TestEntry entry;
+  wheel.Schedule(&entry, now + TimeDelta::FromMilliseconds(10));
+  wheel.Schedule(&entry, now + TimeDelta::FromSeconds(10));
+  EXPECT_EQ(1u, wheel.size());
+  wheel.AdvanceTo(now + TimeDelta::FromSeconds(5));
+  EXPECT_EQ(NULL, wheel.first_due());
+  wheel.AdvanceTo(now + TimeDelta::FromSeconds(11));
+  EXPECT_EQ(&entry, wheel.first_due());
+}
+
+TEST(TimerWheelTest, PastDeadline) {
+  TimerWheel wheel;
+  TimeTicks now = TimeTicks::Now();
+  wheel.AdvanceTo(now + TimeDelta::FromMilliseconds(100));
+  TestEntry entry;
+  wheel.Schedule(&entry, now);
+  EXPECT_EQ(&entry, wheel.first_due());
+  EXPECT_LE(wheel.NextWakeTime(), now + TimeDelta::FromMilliseconds(1));
+}
+
+TEST(TimerWheelTest, DestroyedEntryIsCancelled) {
+  TimerWheel wheel;
+  {
+    TestEntry entry;
+    wheel.Schedule(&entry, TimeTicks::Now() + TimeDelta::FromSeconds(1));
+  }
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, CancelAll) {
+  TestEntry a, b, c;
+  {
+    TimerWheel wheel;
+    TimeTicks now = TimeTicks::Now();
+    wheel.Schedule(&a, now + TimeDelta::FromMilliseconds(1));
+    wheel.Schedule(&b, now + TimeDelta::FromMinutes(1));
+    wheel.Schedule(&c, now + TimeDelta::FromDays(30));
+    wheel.AdvanceTo(now + TimeDelta::FromMilliseconds(2));
+    EXPECT_EQ(&a, wheel.first_due());
+    wheel.CancelAll();
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_FALSE(a.IsScheduled());
+    EXPECT_FALSE(c.IsScheduled());
+    wheel.Schedule(&b, now + TimeDelta::FromMinutes(1));
+  }
+  // The wheel cancelled |b| as it was destroyed.
+  EXPECT_FALSE(b.IsScheduled());
+}
+
+// Entries beyond the reach of the outermost wheel are found in time after
+// being cascaded more than once.
+TEST(TimerWheelTest, FarFuture) {
+  TimerWheel wheel;
+  TimeTicks now = TimeTicks::Now();
+  TestEntry entry;
+  TimeTicks deadline = now + TimeDelta::FromDays(20);
+  wheel.Schedule(&entry, deadline);
+  for (TimeTicks time = now; time < deadline - TimeDelta::FromHours(1);
+       time += TimeDelta::FromHours(1)) {
+    wheel.AdvanceTo(time);
+    ASSERT_EQ(NULL, wheel.first_due());
+  }
+  wheel.AdvanceTo(deadline - TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(NULL, wheel.first_due());
+  wheel.AdvanceTo(deadline + TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(&entry, wheel.first_due());
+}
+
+// Entries that are due in the same millisecond are found in the order in which
+// they were scheduled, when they were all cascaded together.
+TEST(TimerWheelTest, SameTick) {
+  TimerWheel wheel;
+  TimeTicks now = TimeTicks::Now();
+  TimeTicks deadline = now + TimeDelta::FromSeconds(2);
+  ScopedVector<TestEntry> entries;
+  for (int i = 0; i < 10; ++i) {
+    entries.push_back(new TestEntry);
+    wheel.Schedule(entries[i], deadline);
+  }
+  wheel.AdvanceTo(deadline + TimeDelta::FromMilliseconds(1));
+  std::vector<TimerWheel::Entry*> due =
+      TakeDue(&wheel, deadline + TimeDelta::FromMilliseconds(1));
+  ASSERT_EQ(10u, due.size());
+  for (int i = 0; i < 10; ++i)
+    EXPECT_EQ(entries[i], due[i]);
+}
+
+// Schedules, cancels and advances at random, and checks that every entry is
+// found neither before its deadline nor more than a millisecond after it.
+TEST(TimerWheelTest, Random) {
+  const int kEntries = 500;
+  const int kSteps = 5000;
+  Random random;
+  TimerWheel wheel;
+  TimeTicks now = TimeTicks::Now();
+  ScopedVector<TestEntry> entries;
+  for (int i = 0; i < kEntries; ++i)
+    entries.push_back(new TestEntry);
+
+  size_t found = 0;
+  for (int step = 0; step < kSteps; ++step) {
+    for (int i = 0; i < 20; ++i) {
+      TestEntry* entry = entries[random.Next(kEntries)];
+      switch (random.Next(8)) {
+        case 0:
+          entry->Cancel();
+          break;
+        case 1:
+          // Far enough to be clamped to the outermost wheel.
+          wheel.Schedule(entry, now + TimeDelta::FromHours(5 + random.Next(5)));
+          break;
+        case 2:
+          wheel.Schedule(entry,
+                         now + TimeDelta::FromMilliseconds(random.Next(20000)));
+          break;
+        default:
+          wheel.Schedule(
+              entry, now + TimeDelta::FromMicroseconds(random.Next(100000)));
+          break;
+      }
+    }
+
+    // Mostly move in small steps, but sometimes jump far ahead.
+    if (random.Next(100) == 0)
+      now += TimeDelta::FromMinutes(random.Next(600));
+    else
+      now += TimeDelta::FromMicroseconds(random.Next(5000));
+    wheel.AdvanceTo(now);
+    found += TakeDue(&wheel, now).size();
+    ExpectNoneOverdue(wheel, entries.get(), now);
+  }
+  EXPECT_GT(found, 0u);
+}
+
+}  // namespace base
@@ -6,6 +6,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "base/format_macros.h"
 #include "base/profiler/alternate_timer.h"
@@ -44,6 +45,31 @@ const ThreadData::Status kInitialStartupState =
 // can be flipped to efficiently disable this path (if there is a performance
 // problem with its presence).
 static const bool kAllowAlternateTimeSourceHandling = true;
+
+// The average number of births per tallied birth when the status is
+// PROFILING_SAMPLED_ACTIVE, unless SetSamplingInterval() says otherwise.  A
+// sampled task costs a few hundred nanoseconds to tally, so this keeps the
+// average cost to a few nanoseconds per task.
+const int kDefaultSamplingInterval = 100;
+
+// Spread keys over the slots of the per-thread tables.  The low bits of the
+// results are used, so the low (alignment) bits of pointers are shifted out.
+size_t HashPointer(const void* pointer) {
+  return (reinterpret_cast<uintptr_t>(pointer) >> 4) * 2654435761u;
+}
+
+size_t HashLocation(const Location& location) {
+  return (reinterpret_cast<uintptr_t>(location.file_name()) >> 2) +
+      static_cast<size_t>(location.line_number()) * 2654435761u;
+}
+
+// Equivalent to neither location being less than the other.
+bool SameLocation(const Location& a, const Location& b) {
+  return a.line_number() == b.line_number() &&
+      a.file_name() == b.file_name() &&
+      a.function_name() == b.function_name();
+}
+
 }  // namespace
 
 //------------------------------------------------------------------------------
@@ -71,9 +97,17 @@ DeathData::DeathData(int count) {
 void DeathData::RecordDeath(const int32 queue_duration,
                             const int32 run_duration,
                             int32 random_number) {
-  ++count_;
-  queue_duration_sum_ += queue_duration;
-  run_duration_sum_ += run_duration;
+  RecordDeaths(1, queue_duration, run_duration, random_number);
+}
+
+void DeathData::RecordDeaths(int count,
+                             const int32 queue_duration,
+                             const int32 run_duration,
+                             int32 random_number) {
+  DCHECK_GT(count, 0);
+  count_ += count;
+  queue_duration_sum_ += queue_duration * count;
+  run_duration_sum_ += run_duration * count;
 
   if (queue_duration_max_ < queue_duration)
     queue_duration_max_ = queue_duration;
@@ -81,11 +115,12 @@ void DeathData::RecordDeath(const int32 queue_duration,
     run_duration_max_ = run_duration;
 
   // Take a uniformly distributed sample over all durations ever supplied.
-  // The probability that we (instead) use this new sample is 1/count_.  This
-  // results in a completely uniform selection of the sample.
+  // The probability that we (instead) use this new sample is count/count_.
+  // This results in a completely uniform selection of the sample.
   // We ignore the fact that we correlated our selection of a sample of run
   // and queue times.
-  if (0 == (random_number % count_)) {
+  if (static_cast<uint32>(random_number) % count_ <
+      static_cast<uint32>(count)) {
     queue_duration_sample_ = queue_duration;
     run_duration_sample_ = run_duration;
   }
@@ -173,6 +208,8 @@ int Births::birth_count() const { return birth_count_; }
 
 void Births::RecordBirth() { ++birth_count_; }
 
+void Births::RecordBirths(int count) { birth_count_ += count; }
+
 void Births::ForgetBirth() { --birth_count_; }
 
 void Births::Clear() { birth_count_ = 0; }
@@ -204,7 +241,7 @@ int ThreadData::cleanup_count_ = 0;
 int ThreadData::incarnation_counter_ = 0;
 
 // static
-ThreadData* ThreadData::all_thread_data_list_head_ = NULL;
+base::subtle::AtomicWord ThreadData::all_thread_data_list_head_ = 0;
 
 // static
 ThreadData* ThreadData::first_retired_worker_ = NULL;
@@ -216,12 +253,17 @@ base::LazyInstance<base::Lock>::Leaky
 // static
 ThreadData::Status ThreadData::status_ = ThreadData::UNINITIALIZED;
 
+// static
+int ThreadData::sampling_interval_ = kDefaultSamplingInterval;
+
 ThreadData::ThreadData(const std::string& suggested_name)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(0),
+      sample_countdown_(1),
       incarnation_count_for_pool_(-1) {
   DCHECK_GE(suggested_name.size(), 0u);
+  memset(birth_slots_, 0, sizeof(birth_slots_));
   thread_name_ = suggested_name;
   PushToHeadOfList();  // Which sets real incarnation_count_for_pool_.
 }
@@ -230,8 +272,10 @@ ThreadData::ThreadData(int thread_number)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(thread_number),
+      sample_countdown_(1),
       incarnation_count_for_pool_(-1)  {
   CHECK_GT(thread_number, 0);
+  memset(birth_slots_, 0, sizeof(birth_slots_));
   base::StringAppendF(&thread_name_, "WorkerThread-%d", thread_number);
   PushToHeadOfList();  // Which sets real incarnation_count_for_pool_.
 }
@@ -246,16 +290,22 @@ void ThreadData::PushToHeadOfList() {
   random_number_ ^= (Now() - TrackedTime()).InMilliseconds();
 
   DCHECK(!next_);
-  base::AutoLock lock(*list_lock_.Pointer());
+  // The incarnation_counter_ only changes while we are single threaded (during
+  // initialization, and in tests), so we can read it without the list_lock_.
   incarnation_count_for_pool_ = incarnation_counter_;
-  next_ = all_thread_data_list_head_;
-  all_thread_data_list_head_ = this;
+  base::subtle::AtomicWord head;
+  do {
+    head = base::subtle::NoBarrier_Load(&all_thread_data_list_head_);
+    next_ = reinterpret_cast<ThreadData*>(head);
+  } while (base::subtle::Release_CompareAndSwap(
+               &all_thread_data_list_head_, head,
+               reinterpret_cast<base::subtle::AtomicWord>(this)) != head);
 }
 
 // static
 ThreadData* ThreadData::first() {
-  base::AutoLock lock(*list_lock_.Pointer());
-  return all_thread_data_list_head_;
+  return reinterpret_cast<ThreadData*>(
+      base::subtle::Acquire_Load(&all_thread_data_list_head_));
 }
 
 ThreadData* ThreadData::next() const { return next_; }
@@ -344,18 +394,49 @@ base::DictionaryValue* ThreadData::ToValue(bool reset_max) {
   return dictionary;
 }
 
-Births* ThreadData::TallyABirth(const Location& location) {
-  BirthMap::iterator it = birth_map_.find(location);
-  Births* child;
-  if (it != birth_map_.end()) {
-    child =  it->second;
-    child->RecordBirth();
-  } else {
+Births* ThreadData::TallyABirth(const Location& location, int count) {
+  Births* child = NULL;
+  base::subtle::AtomicWord* empty_slot = NULL;
+  size_t index = HashLocation(location);
+  for (size_t probe = 0; probe < kMaxTallyProbes; ++probe) {
+    base::subtle::AtomicWord* slot =
+        &birth_slots_[(index + probe) & (kTallySlots - 1)];
+    // Only this thread writes to the slots, so no barrier is needed here.
+    Births* births =
+        reinterpret_cast<Births*>(base::subtle::NoBarrier_Load(slot));
+    if (!births) {
+      empty_slot = slot;
+      break;
+    }
+    if (SameLocation(births->location(), location)) {
+      child = births;
+      break;
+    }
+  }
+
+  if (child) {
+    child->RecordBirths(count);
+  } else if (empty_slot) {
     child = new Births(location, *this);  // Leak this.
-    // Lock since the map may get relocated now, and other threads sometimes
-    // snapshot it (but they lock before copying it).
-    base::AutoLock lock(map_lock_);
-    birth_map_[location] = child;
+    child->RecordBirths(count - 1);  // Construction tallied the first birth.
+    // Publish the slot only once the Births is completely built.
+    base::subtle::Release_Store(
+        empty_slot, reinterpret_cast<base::subtle::AtomicWord>(child));
+  } else {
+    // All the slots we probed are taken by other locations, and remain so
+    // forever, so the location is (or will be) in the map instead.
+    BirthMap::iterator it = birth_map_.find(location);
+    if (it != birth_map_.end()) {
+      child =  it->second;
+      child->RecordBirths(count);
+    } else {
+      child = new Births(location, *this);  // Leak this.
+      child->RecordBirths(count - 1);
+      // Lock since the map may get relocated now, and other threads sometimes
+      // snapshot it (but they lock before copying it).
+      base::AutoLock lock(map_lock_);
+      birth_map_[location] = child;
+    }
   }
 
   if (kTrackParentChildLinks && status_ > PROFILING_ACTIVE &&
@@ -388,15 +469,47 @@ void ThreadData::TallyADeath(const Births& birth,
   if (kAllowAlternateTimeSourceHandling && now_function_)
     queue_duration = 0;
 
-  DeathMap::iterator it = death_map_.find(&birth);
-  DeathData* death_data;
-  if (it != death_map_.end()) {
-    death_data = &it->second;
+  // When sampling, this death stands in for those of the unsampled tasks.
+  int count = (status_ == PROFILING_SAMPLED_ACTIVE) ? sampling_interval_ : 1;
+
+  DeathData* death_data = NULL;
+  DeathSlot* empty_slot = NULL;
+  size_t index = HashPointer(&birth);
+  for (size_t probe = 0; probe < kMaxTallyProbes; ++probe) {
+    DeathSlot* slot = &death_slots_[(index + probe) & (kTallySlots - 1)];
+    // Only this thread writes to the slots, so no barrier is needed here.
+    const Births* births = reinterpret_cast<const Births*>(
+        base::subtle::NoBarrier_Load(&slot->birth));
+    if (!births) {
+      empty_slot = slot;
+      break;
+    }
+    if (births == &birth) {
+      death_data = &slot->death_data;
+      break;
+    }
+  }
+
+  if (empty_slot) {
+    // An unclaimed slot holds zeroed data.  Tally the death, and only then
+    // publish the slot, so that snapshots never see an empty DeathData.
+    empty_slot->death_data.RecordDeaths(count, queue_duration, run_duration,
+                                        random_number_);
+    base::subtle::Release_Store(
+        &empty_slot->birth, reinterpret_cast<base::subtle::AtomicWord>(&birth));
   } else {
-    base::AutoLock lock(map_lock_);  // Lock as the map may get relocated now.
-    death_data = &death_map_[&birth];
-  }  // Release lock ASAP.
-  death_data->RecordDeath(queue_duration, run_duration, random_number_);
+    if (!death_data) {
+      DeathMap::iterator it = death_map_.find(&birth);
+      if (it != death_map_.end()) {
+        death_data = &it->second;
+      } else {
+        base::AutoLock lock(map_lock_);  // Lock as the map may get relocated.
+        death_data = &death_map_[&birth];
+      }  // Release lock ASAP.
+    }
+    death_data->RecordDeaths(count, queue_duration, run_duration,
+                             random_number_);
+  }
 
   if (!kTrackParentChildLinks)
     return;
@@ -416,7 +529,24 @@ Births* ThreadData::TallyABirthIfActive(const Location& location) {
   ThreadData* current_thread_data = Get();
   if (!current_thread_data)
     return NULL;
-  return current_thread_data->TallyABirth(location);
+
+  int count = 1;
+  if (status_ == PROFILING_SAMPLED_ACTIVE) {
+    if (--current_thread_data->sample_countdown_ > 0)
+      return NULL;  // This task is not sampled, and will not be tallied.
+    count = sampling_interval_;
+    current_thread_data->sample_countdown_ =
+        current_thread_data->NextSampleCountdown(count);
+  }
+  return current_thread_data->TallyABirth(location, count);
+}
+
+int ThreadData::NextSampleCountdown(int interval) {
+  // Advance a linear congruential generator, and use its better (upper) bits
+  // to pick uniformly from [1, 2 * interval - 1].
+  uint32 random = static_cast<uint32>(random_number_) * 1103515245u + 12345u;
+  random_number_ = static_cast<int32>(random);
+  return 1 + static_cast<int>((random >> 8) % (2 * interval - 1));
 }
 
 // static
@@ -532,6 +662,23 @@ void ThreadData::SnapshotMaps(bool reset_max,
                               BirthMap* birth_map,
                               DeathMap* death_map,
                               ParentChildSet* parent_child_set) {
+  for (size_t i = 0; i < kTallySlots; ++i) {
+    Births* births = reinterpret_cast<Births*>(
+        base::subtle::Acquire_Load(&birth_slots_[i]));
+    if (births)
+      (*birth_map)[births->location()] = births;
+  }
+  for (size_t i = 0; i < kTallySlots; ++i) {
+    DeathSlot& slot = death_slots_[i];
+    const Births* births = reinterpret_cast<const Births*>(
+        base::subtle::Acquire_Load(&slot.birth));
+    if (!births)
+      continue;
+    (*death_map)[births] = slot.death_data;
+    if (reset_max)
+      slot.death_data.ResetMax();
+  }
+
   base::AutoLock lock(map_lock_);
   for (BirthMap::const_iterator it = birth_map_.begin();
        it != birth_map_.end(); ++it)
@@ -588,6 +735,15 @@ void ThreadData::ResetAllThreadData() {
 }
 
 void ThreadData::Reset() {
+  for (size_t i = 0; i < kTallySlots; ++i) {
+    Births* births = reinterpret_cast<Births*>(
+        base::subtle::Acquire_Load(&birth_slots_[i]));
+    if (births)
+      births->Clear();
+    if (base::subtle::Acquire_Load(&death_slots_[i].birth))
+      death_slots_[i].death_data.Clear();
+  }
+
   base::AutoLock lock(map_lock_);
   for (DeathMap::iterator it = death_map_.begin();
        it != death_map_.end(); ++it)
@@ -672,7 +828,7 @@ bool ThreadData::InitializeAndSetTrackingStatus(Status status) {
   if (!Initialize())  // No-op if already initialized.
     return false;  // Not compiled in.
 
-  if (!kTrackParentChildLinks && status > DEACTIVATED)
+  if (!kTrackParentChildLinks && status > PROFILING_ACTIVE)
     status = PROFILING_ACTIVE;
   status_ = status;
   return true;
@@ -688,6 +844,12 @@ bool ThreadData::TrackingStatus() {
   return status_ > DEACTIVATED;
 }
 
+// static
+void ThreadData::SetSamplingInterval(int interval) {
+  DCHECK_GT(interval, 0);
+  sampling_interval_ = interval;
+}
+
 // static
 bool ThreadData::TrackingParentChildStatus() {
   return status_ >= PROFILING_CHILDREN_ACTIVE;
@@ -695,6 +857,8 @@ bool ThreadData::TrackingParentChildStatus() {
 
 // static
 TrackedTime ThreadData::NowForStartOfRun(const Births* parent) {
+  if (!parent && status_ == PROFILING_SAMPLED_ACTIVE)
+    return TrackedTime();  // The task was not sampled, so won't be tallied.
   if (kTrackParentChildLinks && parent && status_ > PROFILING_ACTIVE) {
     ThreadData* current_thread_data = Get();
     if (current_thread_data)
@@ -704,7 +868,9 @@ TrackedTime ThreadData::NowForStartOfRun(const Births* parent) {
 }
 
 // static
-TrackedTime ThreadData::NowForEndOfRun() {
+TrackedTime ThreadData::NowForEndOfRun(const Births* birth) {
+  if (!birth && status_ == PROFILING_SAMPLED_ACTIVE)
+    return TrackedTime();  // The task was not sampled, so won't be tallied.
   return Now();
 }
 
@@ -746,8 +912,8 @@ void ThreadData::ShutdownSingleThreadedCleanup(bool leak) {
   ThreadData* thread_data_list;
   {
     base::AutoLock lock(*list_lock_.Pointer());
-    thread_data_list = all_thread_data_list_head_;
-    all_thread_data_list_head_ = NULL;
+    thread_data_list = reinterpret_cast<ThreadData*>(
+        base::subtle::NoBarrier_AtomicExchange(&all_thread_data_list_head_, 0));
     ++incarnation_counter_;
     // To be clean, break apart the retired worker list (though we leak them).
     while (first_retired_worker_) {
@@ -763,6 +929,7 @@ void ThreadData::ShutdownSingleThreadedCleanup(bool leak) {
   cleanup_count_ = 0;
   tls_index_.Set(NULL);
   status_ = DORMANT_DURING_TESTS;  // Almost UNINITIALIZED.
+  sampling_interval_ = kDefaultSamplingInterval;
 
   // To avoid any chance of racing in unit tests, which is the only place we
   // call this function, we may sometimes leak all the data structures we
@@ -777,6 +944,8 @@ void ThreadData::ShutdownSingleThreadedCleanup(bool leak) {
     ThreadData* next_thread_data = thread_data_list;
     thread_data_list = thread_data_list->next();
 
+    for (size_t i = 0; i < kTallySlots; ++i)
+      delete reinterpret_cast<Births*>(next_thread_data->birth_slots_[i]);
     for (BirthMap::iterator it = next_thread_data->birth_map_.begin();
          next_thread_data->birth_map_.end() != it; ++it)
       delete it->second;  // Delete the Birth Records.
@@ -13,6 +13,7 @@
 #include <utility>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/gtest_prod_util.h"
 #include "base/lazy_instance.h"
@@ -103,23 +104,34 @@
 // Each thread maintains a list of data items specific to that thread in a
 // ThreadData instance (for that specific thread only).  The two critical items
 // are lists of DeathData and Births instances.  These lists are maintained in
-// STL maps, which are indexed by Location. As noted earlier, we can compare
-// locations very efficiently as we consider the underlying data (file,
-// function, line) to be atoms, and hence pointer comparison is used rather than
-// (slow) string comparisons.
+// small fixed-size hash tables, indexed by Location (or by Births), whose slots
+// are claimed exclusively by the owning thread and are never released.  A slot
+// is published to other threads (with a release store) only after its contents
+// are in place, so neither the owning thread nor a snapshotting thread needs a
+// lock to use the tables.  In the rare case that too many locations collide in
+// a table, the overflow is kept in STL maps that are protected by a lock.  As
+// noted earlier, we can compare locations very efficiently as we consider the
+// underlying data (file, function, line) to be atoms, and hence pointer
+// comparison is used rather than (slow) string comparisons.
 //
 // To provide a mechanism for iterating over all "known threads," which means
 // threads that have recorded a birth or a death, we create a singly linked list
 // of ThreadData instances. Each such instance maintains a pointer to the next
 // one.  A static member of ThreadData provides a pointer to the first item on
-// this global list, and access via that all_thread_data_list_head_ item
-// requires the use of the list_lock_.
+// this global list, all_thread_data_list_head_, which is updated with an atomic
+// compare-and-swap.
 // When new ThreadData instances is added to the global list, it is pre-pended,
 // which ensures that any prior acquisition of the list is valid (i.e., the
 // holder can iterate over it without fear of it changing, or the necessity of
-// using an additional lock.  Iterations are actually pretty rare (used
-// primarilly for cleanup, or snapshotting data for display), so this lock has
-// very little global performance impact.
+// using an additional lock.
+//
+// Even without locks, tallying every task costs a couple of clock reads and
+// table lookups.  When the status is PROFILING_SAMPLED_ACTIVE, only about one
+// in every sampling interval's worth of tasks (chosen with a randomized
+// countdown on each thread) is tallied, and each tallied task counts as an
+// entire interval's worth of tasks.  Snapshots then hold estimates of the
+// totals, in the same form as when every task is tallied.  Tasks that are not
+// sampled only pay for a decrement of the countdown.
 //
 // The above description tries to define the high performance (run time)
 // portions of these classes.  After gathering statistics, calls instigated
@@ -230,6 +242,9 @@ class BASE_EXPORT Births: public BirthOnThread {
   // When we have a birth we update the count for this BirhPLace.
   void RecordBirth();
 
+  // When sampling, a single tallied birth stands in for |count| births.
+  void RecordBirths(int count);
+
   // When a birthplace is changed (updated), we need to decrement the counter
   // for the old instance.
   void ForgetBirth();
@@ -265,6 +280,13 @@ class BASE_EXPORT DeathData {
                    const int32 run_duration,
                    int random_number);
 
+  // Update stats as though |count| tasks had each been destroyed with the given
+  // durations.  This is used when only one in |count| tasks is being tallied.
+  void RecordDeaths(int count,
+                    const int32 queue_duration,
+                    const int32 run_duration,
+                    int random_number);
+
   // Metrics accessors, used only in tests.
   int count() const;
   int32 run_duration_sum() const;
@@ -347,6 +369,7 @@ class BASE_EXPORT ThreadData {
     UNINITIALIZED,              // PRistine, link-time state before running.
     DORMANT_DURING_TESTS,       // Only used during testing.
     DEACTIVATED,                // No longer recording profling.
+    PROFILING_SAMPLED_ACTIVE,   // Recording profiles of a sample of tasks.
     PROFILING_ACTIVE,           // Recording profiles (no parent-child links).
     PROFILING_CHILDREN_ACTIVE,  // Fully active, recording parent-child links.
   };
@@ -449,6 +472,13 @@ class BASE_EXPORT ThreadData {
   // DEACTIVATED).
   static bool TrackingStatus();
 
+  // Sets the average number of tasks that are born for each one that is tallied
+  // while the status is PROFILING_SAMPLED_ACTIVE.  Each tallied task is counted
+  // as |interval| tasks, so births, deaths and durations remain estimates of
+  // the totals.  Tasks that are born and die on either side of a change to the
+  // status or interval may leave those estimates slightly skewed.
+  static void SetSamplingInterval(int interval);
+
   // For testing only, indicate if the status of parent-child tracking is turned
   // on.  This is currently a compiled option, atop TrackingStatus().
   static bool TrackingParentChildStatus();
@@ -458,9 +488,10 @@ class BASE_EXPORT ThreadData {
   // side effects when we are tracking, so that we can deduce the amount of time
   // accumulated outside of execution of tracked runs.
   // The task that will be tracked is passed in as |parent| so that parent-child
-  // relationships can be (optionally) calculated.
+  // relationships can be (optionally) calculated.  When sampling, a NULL
+  // |parent| or |birth| is a task that was not sampled, and no time is taken.
   static TrackedTime NowForStartOfRun(const Births* parent);
-  static TrackedTime NowForEndOfRun();
+  static TrackedTime NowForEndOfRun(const Births* birth);
 
   // Provide a time function that does nothing (runs fast) when we don't have
   // the profiler enabled.  It will generally be optimized away when it is
@@ -489,6 +520,24 @@ class BASE_EXPORT ThreadData {
   FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, MinimalStartupShutdown);
   FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, TinyStartupShutdown);
   FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, ParentChildTest);
+  FRIEND_TEST_ALL_PREFIXES(TrackedObjectsTest, ManyLocationsSnapshot);
+
+  // Number of slots in each of the per-thread tables of births and deaths.
+  // This must be a power of two.
+  static const size_t kTallySlots = 128;
+
+  // Number of consecutive slots that are searched for a key, before the key is
+  // instead kept in the (locked) birth_map_ or death_map_.
+  static const size_t kMaxTallyProbes = 8;
+
+  // A slot in the table of deaths.  |birth| holds the const Births* that the
+  // slot accumulates DeathData for, or zero if the slot is still unclaimed.
+  struct DeathSlot {
+    DeathSlot() : birth(0) {}
+
+    base::subtle::AtomicWord birth;
+    DeathData death_data;
+  };
 
   // Worker thread construction creates a name since there is none.
   explicit ThreadData(int thread_number);
@@ -510,23 +559,30 @@ class BASE_EXPORT ThreadData {
   ThreadData* next() const;
 
 
-  // In this thread's data, record a new birth.
-  Births* TallyABirth(const Location& location);
+  // In this thread's data, record |count| new births.
+  Births* TallyABirth(const Location& location, int count);
+
+  // Stir random_number_, and use it to pick how many more births on this thread
+  // go untallied before the next sampled one.  The result averages |interval|,
+  // but is randomized so that periodic patterns of tasks are not aliased.
+  int NextSampleCountdown(int interval);
 
   // Find a place to record a death on this thread.
   void TallyADeath(const Births& birth, int32 queue_duration, int32 duration);
 
-  // Using our lock, make a copy of the specified maps.  This call may be made
-  // on  non-local threads, which necessitate the use of the lock to prevent
-  // the map(s) from being reallocaed while they are copied. If |reset_max| is
-  // true, then, just after we copy the DeathMap, we will set the max values to
-  // zero in the active DeathMap (not the snapshot).
+  // Make a copy of the births and deaths recorded in our slots and maps.  This
+  // call may be made on non-local threads, which necessitate the use of the
+  // lock to prevent the map(s) from being reallocaed while they are copied.
+  // The slots are read without a lock. If |reset_max| is true, then, just
+  // after we copy each DeathData, we will set the max values to zero in the
+  // active instance (not the snapshot).
   void SnapshotMaps(bool reset_max,
                     BirthMap* birth_map,
                     DeathMap* death_map,
                     ParentChildSet* parent_child_set);
 
-  // Using our lock to protect the iteration, Clear all birth and death data.
+  // Clear all birth and death data, using our lock to protect the iteration
+  // over the maps.
   void Reset();
 
   // This method is called by the TLS system when a thread terminates.
@@ -564,8 +620,8 @@ class BASE_EXPORT ThreadData {
 
   // Link to the most recently created instance (starts a null terminated list).
   // The list is traversed by about:profiler when it needs to snapshot data.
-  // This is only accessed while list_lock_ is held.
-  static ThreadData* all_thread_data_list_head_;
+  // This holds a ThreadData*, and is only modified with atomic operations.
+  static base::subtle::AtomicWord all_thread_data_list_head_;
 
   // The next available worker thread number.  This should only be accessed when
   // the list_lock_ is held.
@@ -577,11 +633,12 @@ class BASE_EXPORT ThreadData {
 
   // Incarnation sequence number, indicating how many times (during unittests)
   // we've either transitioned out of UNINITIALIZED, or into that state.  This
-  // value is only accessed while the list_lock_ is held.
+  // value is only changed while the list_lock_ is held, and while we are
+  // single threaded, so it may be read without the lock.
   static int incarnation_counter_;
 
-  // Protection for access to all_thread_data_list_head_, and to
-  // unregistered_thread_data_pool_.  This lock is leaked at shutdown.
+  // Protection for access to the retired worker list, and to the counters
+  // above.  This lock is leaked at shutdown.
   // The lock is very infrequently used, so we can afford to just make a lazy
   // instance and be safe.
   static base::LazyInstance<base::Lock>::Leaky list_lock_;
@@ -589,6 +646,10 @@ class BASE_EXPORT ThreadData {
   // We set status_ to SHUTDOWN when we shut down the tracking service.
   static Status status_;
 
+  // The average number of births per tallied birth, while status_ is
+  // PROFILING_SAMPLED_ACTIVE.
+  static int sampling_interval_;
+
   // Link to next instance (null terminated list). Used to globally track all
   // registered instances (corresponds to all registered threads where we keep
   // data).
@@ -609,16 +670,24 @@ class BASE_EXPORT ThreadData {
   // corresponding to the created thread name if it is a worker thread.
   int worker_thread_number_;
 
-  // A map used on each thread to keep track of Births on this thread.
-  // This map should only be accessed on the thread it was constructed on.
-  // When a snapshot is needed, this structure can be locked in place for the
-  // duration of the snapshotting activity.
-  BirthMap birth_map_;
+  // Table of the Births on this thread, holding Births* values.  Slots are
+  // claimed, and the Births they point to are updated, only on this thread.
+  // Other threads may read a slot at any time (with an acquire load).
+  base::subtle::AtomicWord birth_slots_[kTallySlots];
 
-  // Similar to birth_map_, this records informations about death of tracked
+  // Similar to birth_slots_, this records informations about death of tracked
   // instances (i.e., when a tracked instance was destroyed on this thread).
-  // It is locked before changing, and hence other threads may access it by
-  // locking before reading it.
+  DeathSlot death_slots_[kTallySlots];
+
+  // A map used on each thread to keep track of Births that did not fit in
+  // birth_slots_.  This map should only be accessed on the thread it was
+  // constructed on.  When a snapshot is needed, this structure can be locked in
+  // place for the duration of the snapshotting activity.
+  BirthMap birth_map_;
+
+  // Similar to birth_map_, this records the deaths that did not fit in
+  // death_slots_.  It is locked before changing, and hence other threads may
+  // access it by locking before reading it.
   DeathMap death_map_;
 
   // A set of parents that created children tasks on this thread. Each pair
@@ -650,6 +719,10 @@ class BASE_EXPORT ThreadData {
   // we stir in more and more as we go.
   int32 random_number_;
 
+  // The number of births on this thread, including the next one, that remain
+  // before a birth is sampled (when status_ is PROFILING_SAMPLED_ACTIVE).
+  int sample_countdown_;
+
   // Record of what the incarnation_counter_ was when this instance was created.
   // If the incarnation_counter_ has changed, then we avoid pushing into the
   // pool (this is only critical in tests which go through multiple
@@ -0,0 +1,56 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/perftimer.h"
+#include "base/tracked_objects.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace tracked_objects {
+
+namespace {
+
+const int kTasks = 2000000;
+
+// Number of distinct places that tasks are posted from.
+const int kLocations = 32;
+
+// Goes through the same tallying that MessageLoop does for each task it runs,
+// and logs the average time this takes for each task when |status| is in
+// effect.
+void RunTally(const std::string& name, ThreadData::Status status) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(status))
+    return;
+
+  PerfTimer timer;
+  for (int i = 0; i < kTasks; ++i) {
+    Location location("RunTally", "tracked_objects_perftest.cc",
+                      i % kLocations, NULL);
+    const Births* birth = ThreadData::TallyABirthIfActive(location);
+    TrackedTime time_posted = ThreadData::Now();
+    TrackedTime start_of_run = ThreadData::NowForStartOfRun(birth);
+    ThreadData::TallyRunOnWorkerThreadIfTracking(
+        birth, time_posted, start_of_run, ThreadData::NowForEndOfRun(birth));
+  }
+  LogPerfResult(name.c_str(),
+                timer.Elapsed().InMicroseconds() * 1000.0 / kTasks, "ns/task");
+}
+
+}  // namespace
+
+TEST(TrackedObjectsPerfTest, Deactivated) {
+  RunTally("TrackedObjects_Deactivated", ThreadData::DEACTIVATED);
+}
+
+TEST(TrackedObjectsPerfTest, Sampled) {
+  RunTally("TrackedObjects_Sampled", ThreadData::PROFILING_SAMPLED_ACTIVE);
+}
+
+TEST(TrackedObjectsPerfTest, Active) {
+  RunTally("TrackedObjects_Active", ThreadData::PROFILING_ACTIVE);
+}
+
+}  // namespace tracked_objects
@@ -104,7 +104,7 @@ TEST_F(TrackedObjectsTest, TinyStartupShutdown) {
   base::TimeTicks kBogusBirthTime;
   base::TrackingInfo pending_task(location, kBogusBirthTime);
   // Finally conclude the outer run.
-  TrackedTime end_time = ThreadData::NowForEndOfRun();
+  TrackedTime end_time = ThreadData::NowForEndOfRun(first_birth);
   ThreadData::TallyRunOnNamedThreadIfTracking(pending_task, start_time,
                                               end_time);
 
@@ -818,5 +818,137 @@ TEST_F(TrackedObjectsTest, DifferentLives) {
   EXPECT_EQ(one_line_result, json);
 }
 
+TEST_F(TrackedObjectsTest, ManyLocationsSnapshot) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+      ThreadData::PROFILING_ACTIVE))
+    return;
+
+  // Use more locations than fit in the per-thread slots, so that some of them
+  // are kept in the maps instead.
+  const int kLocationCount = 1000;
+  const char* kFile = "FixedFileName";
+  const char* kFunction = "ManyLocationsSnapshot";
+  const TrackedTime kTimePosted = TrackedTime() + Duration::FromMilliseconds(1);
+  const TrackedTime kStartOfRun = TrackedTime() + Duration::FromMilliseconds(5);
+  const TrackedTime kEndOfRun = TrackedTime() + Duration::FromMilliseconds(7);
+  for (int round = 0; round < 2; ++round) {
+    for (int line = 1; line <= kLocationCount; ++line) {
+      Location location(kFunction, kFile, line, NULL);
+      Births* birth = ThreadData::TallyABirthIfActive(location);
+      ASSERT_TRUE(birth);
+      ThreadData::TallyRunOnWorkerThreadIfTracking(birth, kTimePosted,
+                                                   kStartOfRun, kEndOfRun);
+    }
+  }
+
+  ThreadData* data = ThreadData::Get();
+  ASSERT_TRUE(data);
+  ThreadData::BirthMap birth_map;
+  ThreadData::DeathMap death_map;
+  ThreadData::ParentChildSet parent_child_set;
+  data->SnapshotMaps(false, &birth_map, &death_map, &parent_child_set);
+  EXPECT_EQ(static_cast<size_t>(kLocationCount), birth_map.size());
+  EXPECT_EQ(static_cast<size_t>(kLocationCount), death_map.size());
+  for (ThreadData::BirthMap::const_iterator it = birth_map.begin();
+       it != birth_map.end(); ++it) {
+    EXPECT_EQ(2, it->second->birth_count());
+    ASSERT_TRUE(death_map.find(it->second) != death_map.end());
+    const DeathData& death_data = death_map[it->second];
+    EXPECT_EQ(2, death_data.count());
+    EXPECT_EQ(4, death_data.run_duration_sum());
+    EXPECT_EQ(8, death_data.queue_duration_sum());
+  }
+}
+
+TEST_F(TrackedObjectsTest, SampledLifeCycleToValueMainThread) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+      ThreadData::PROFILING_SAMPLED_ACTIVE))
+    return;
+  ThreadData::SetSamplingInterval(5);
+
+  // Use a well named thread.
+  ThreadData::InitializeThreadContext("SomeMainThreadName");
+  const int kFakeLineNumber = 236;
+  const char* kFile = "FixedFileName";
+  const char* kFunction = "SampledLifeCycleToValueMainThread";
+  Location location(kFunction, kFile, kFakeLineNumber, NULL);
+
+  const base::TimeTicks kTimePosted = base::TimeTicks()
+      + base::TimeDelta::FromMilliseconds(1);
+  const base::TimeTicks kDelayedStartTime = base::TimeTicks();
+  // TrackingInfo will call TallyABirth() during construction.  The first birth
+  // on a thread is always sampled.
+  base::TrackingInfo pending_task(location, kDelayedStartTime);
+  pending_task.time_posted = kTimePosted;  // Overwrite implied Now().
+  EXPECT_NE(pending_task.birth_tally, reinterpret_cast<Births*>(NULL));
+
+  const TrackedTime kStartOfRun = TrackedTime() +
+      Duration::FromMilliseconds(5);
+  const TrackedTime kEndOfRun = TrackedTime() + Duration::FromMilliseconds(7);
+  ThreadData::TallyRunOnNamedThreadIfTracking(pending_task,
+      kStartOfRun, kEndOfRun);
+
+  // The sampled task stands in for the interval's worth of tasks.
+  scoped_ptr<base::Value> value(ThreadData::ToValue(false));
+  std::string json;
+  base::JSONWriter::Write(value.get(), &json);
+  std::string one_line_result = "{"
+      "\"descendants\":["
+      "],"
+      "\"list\":["
+        "{"
+          "\"birth_thread\":\"SomeMainThreadName\","
+          "\"death_data\":{"
+            "\"count\":5,"
+            "\"queue_ms\":20,"
+            "\"queue_ms_max\":4,"
+            "\"queue_ms_sample\":4,"
+            "\"run_ms\":10,"
+            "\"run_ms_max\":2,"
+            "\"run_ms_sample\":2"
+          "},"
+          "\"death_thread\":\"SomeMainThreadName\","
+          "\"location\":{"
+            "\"file_name\":\"FixedFileName\","
+            "\"function_name\":\"SampledLifeCycleToValueMainThread\","
+            "\"line_number\":236"
+          "}"
+        "}"
+      "]"
+    "}";
+  EXPECT_EQ(one_line_result, json);
+}
+
+TEST_F(TrackedObjectsTest, SampledBirthsAreEstimates) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+      ThreadData::PROFILING_SAMPLED_ACTIVE))
+    return;
+  const int kInterval = 10;
+  ThreadData::SetSamplingInterval(kInterval);
+
+  const int kBirths = 1000;
+  Location location("SampledBirthsAreEstimates", "FixedFileName", 173, NULL);
+  Births* tallied_birth = NULL;
+  int sampled = 0;
+  for (int i = 0; i < kBirths; ++i) {
+    Births* birth = ThreadData::TallyABirthIfActive(location);
+    if (!birth) {
+      // Unsampled tasks don't even read the clock.
+      EXPECT_TRUE(ThreadData::NowForStartOfRun(birth).is_null());
+      EXPECT_TRUE(ThreadData::NowForEndOfRun(birth).is_null());
+      continue;
+    }
+    ++sampled;
+    tallied_birth = birth;
+  }
+  ASSERT_TRUE(tallied_birth);
+
+  // Gaps between samples average kInterval, so the estimate is close to the
+  // real number of births.
+  EXPECT_EQ(sampled * kInterval, tallied_birth->birth_count());
+  EXPECT_LT(kBirths * 7 / 10, tallied_birth->birth_count());
+  EXPECT_GT(kBirths * 13 / 10, tallied_birth->birth_count());
+}
+
 
 }  // namespace tracked_objects
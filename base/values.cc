@@ -60,6 +60,37 @@ Value* CopyWithoutEmptyChildren(Value* node) {
   }
 }
 
+// Orders DictionaryValue entries by key, and compares them with keys for
+// std::lower_bound.
+struct EntryKeyLess {
+  bool operator()(const base::FlatValueMap::value_type& lhs,
+                  const base::FlatValueMap::value_type& rhs) const {
+    return lhs.first < rhs.first;
+  }
+  bool operator()(const base::FlatValueMap::value_type& entry,
+                  const base::StringPiece& key) const {
+    return base::StringPiece(entry.first) < key;
+  }
+  bool operator()(const base::StringPiece& key,
+                  const base::FlatValueMap::value_type& entry) const {
+    return key < base::StringPiece(entry.first);
+  }
+};
+
+// Returns true if the entries in [begin, end) are in order. Serialized
+// dictionaries usually are, since they are written from sorted storage.
+bool IsSortedByKey(base::FlatValueMap::const_iterator begin,
+                   base::FlatValueMap::const_iterator end) {
+  if (begin == end)
+    return true;
+  for (base::FlatValueMap::const_iterator next = begin + 1; next != end;
+       begin = next++) {
+    if (next->first < begin->first)
+      return false;
+  }
+  return true;
+}
+
 // A small functor for comparing Values for std::find_if and similar.
 class ValueEquals {
  public:
@@ -367,9 +398,7 @@ bool DictionaryValue::GetAsDictionary(const DictionaryValue** out_value) const {
 
 bool DictionaryValue::HasKey(const std::string& key) const {
   DCHECK(IsStringUTF8(key));
-  ValueMap::const_iterator current_entry = dictionary_.find(key);
-  DCHECK((current_entry == dictionary_.end()) || current_entry->second);
-  return current_entry != dictionary_.end();
+  return FindValue(key) != NULL;
 }
 
 void DictionaryValue::Clear() {
@@ -380,6 +409,12 @@ void DictionaryValue::Clear() {
   }
 
   dictionary_.clear();
+
+  for (FlatValueMap::iterator i(flat_dictionary_.begin());
+       i != flat_dictionary_.end(); ++i) {
+    delete i->second;
+  }
+  FlatValueMap().swap(flat_dictionary_);
 }
 
 void DictionaryValue::Set(const std::string& path, Value* in_value) {
@@ -430,6 +465,18 @@ void DictionaryValue::SetString(const std::string& path,
 
 void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
                                               Value* in_value) {
+  if (!flat_dictionary_.empty()) {
+    // Replacing a value keeps the flat storage, adding a key doesn't.
+    FlatValueMap::iterator entry_iterator = FindFlatEntry(key);
+    if (entry_iterator != flat_dictionary_.end()) {
+      DCHECK_NE(entry_iterator->second, in_value);  // This would be bogus
+      delete entry_iterator->second;
+      entry_iterator->second = in_value;
+      return;
+    }
+    MoveFlatEntriesToMap();
+  }
+
   // If there's an existing value here, we need to delete it, because
   // we own all our children.
   std::pair<ValueMap::iterator, bool> ins_res =
@@ -441,23 +488,57 @@ void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
   }
 }
 
+void DictionaryValue::SetEntriesWithoutPathExpansion(FlatValueMap* entries) {
+  if (!empty()) {
+    for (FlatValueMap::iterator i(entries->begin()); i != entries->end(); ++i)
+      SetWithoutPathExpansion(i->first, i->second);
+    entries->clear();
+    return;
+  }
+
+  // Sort the entries, stably so that the entries for each key stay in the
+  // order they were set.
+  flat_dictionary_.swap(*entries);
+  if (!IsSortedByKey(flat_dictionary_.begin(), flat_dictionary_.end())) {
+    std::stable_sort(flat_dictionary_.begin(), flat_dictionary_.end(),
+                     EntryKeyLess());
+  }
+
+  // Keep only the last value set for each key.
+  FlatValueMap::iterator out = flat_dictionary_.begin();
+  for (FlatValueMap::iterator i(flat_dictionary_.begin());
+       i != flat_dictionary_.end(); ++i) {
+    DCHECK(IsStringUTF8(i->first));
+    DCHECK(i->second);
+    FlatValueMap::iterator next = i + 1;
+    if (next != flat_dictionary_.end() && next->first == i->first) {
+      DCHECK_NE(next->second, i->second);  // This would be bogus
+      delete i->second;
+      continue;
+    }
+    if (out != i) {
+      out->first.swap(i->first);
+      out->second = i->second;
+    }
+    ++out;
+  }
+  flat_dictionary_.erase(out, flat_dictionary_.end());
+}
+
 bool DictionaryValue::Get(const std::string& path, Value** out_value) const {
   DCHECK(IsStringUTF8(path));
-  std::string current_path(path);
-  const DictionaryValue* current_dictionary = this;
-  for (size_t delimiter_position = current_path.find('.');
-       delimiter_position != std::string::npos;
-       delimiter_position = current_path.find('.')) {
-    DictionaryValue* child_dictionary = NULL;
-    if (!current_dictionary->GetDictionary(
-            current_path.substr(0, delimiter_position), &child_dictionary))
-      return false;
+  StringPiece key;
+  const DictionaryValue* current_dictionary = FindDictionaryForPath(path, &key);
+  if (!current_dictionary)
+    return false;
 
-    current_dictionary = child_dictionary;
-    current_path.erase(0, delimiter_position + 1);
-  }
+  Value* entry = current_dictionary->FindValue(key);
+  if (!entry)
+    return false;
 
-  return current_dictionary->GetWithoutPathExpansion(current_path, out_value);
+  if (out_value)
+    *out_value = entry;
+  return true;
 }
 
 bool DictionaryValue::GetBoolean(const std::string& path,
@@ -562,11 +643,10 @@ bool DictionaryValue::GetList(const std::string& path,
 bool DictionaryValue::GetWithoutPathExpansion(const std::string& key,
                                               Value** out_value) const {
   DCHECK(IsStringUTF8(key));
-  ValueMap::const_iterator entry_iterator = dictionary_.find(key);
-  if (entry_iterator == dictionary_.end())
+  Value* entry = FindValue(key);
+  if (!entry)
     return false;
 
-  Value* entry = entry_iterator->second;
   if (out_value)
     *out_value = entry;
   return true;
@@ -639,23 +719,25 @@ bool DictionaryValue::GetListWithoutPathExpansion(const std::string& key,
 
 bool DictionaryValue::Remove(const std::string& path, Value** out_value) {
   DCHECK(IsStringUTF8(path));
-  std::string current_path(path);
-  DictionaryValue* current_dictionary = this;
-  size_t delimiter_position = current_path.rfind('.');
-  if (delimiter_position != std::string::npos) {
-    if (!GetDictionary(current_path.substr(0, delimiter_position),
-                       &current_dictionary))
-      return false;
-    current_path.erase(0, delimiter_position + 1);
-  }
+  StringPiece key;
+  DictionaryValue* current_dictionary =
+      const_cast<DictionaryValue*>(FindDictionaryForPath(path, &key));
+  if (!current_dictionary)
+    return false;
 
-  return current_dictionary->RemoveWithoutPathExpansion(current_path,
+  return current_dictionary->RemoveWithoutPathExpansion(key.as_string(),
                                                         out_value);
 }
 
 bool DictionaryValue::RemoveWithoutPathExpansion(const std::string& key,
                                                  Value** out_value) {
   DCHECK(IsStringUTF8(key));
+  if (!flat_dictionary_.empty()) {
+    if (FindFlatEntry(key) == flat_dictionary_.end())
+      return false;
+    MoveFlatEntriesToMap();
+  }
+
   ValueMap::iterator entry_iterator = dictionary_.find(key);
   if (entry_iterator == dictionary_.end())
     return false;
@@ -703,6 +785,15 @@ DictionaryValue* DictionaryValue::DeepCopy() const {
                                     current_entry->second->DeepCopy());
   }
 
+  // Flat entries are already in order, so they can be appended directly.
+  result->flat_dictionary_.reserve(flat_dictionary_.size());
+  for (FlatValueMap::const_iterator current_entry(flat_dictionary_.begin());
+       current_entry != flat_dictionary_.end(); ++current_entry) {
+    result->flat_dictionary_.push_back(
+        std::make_pair(current_entry->first,
+                       current_entry->second->DeepCopy()));
+  }
+
   return result;
 }
 
@@ -712,26 +803,88 @@ bool DictionaryValue::Equals(const Value* other) const {
 
   const DictionaryValue* other_dict =
       static_cast<const DictionaryValue*>(other);
-  key_iterator lhs_it(begin_keys());
-  key_iterator rhs_it(other_dict->begin_keys());
-  while (lhs_it != end_keys() && rhs_it != other_dict->end_keys()) {
-    Value* lhs;
-    Value* rhs;
-    if (*lhs_it != *rhs_it ||
-        !GetWithoutPathExpansion(*lhs_it, &lhs) ||
-        !other_dict->GetWithoutPathExpansion(*rhs_it, &rhs) ||
-        !lhs->Equals(rhs)) {
+  if (size() != other_dict->size())
+    return false;
+
+  // Both storages iterate in key order, so entries are compared pairwise.
+  Iterator lhs_it(*this);
+  Iterator rhs_it(*other_dict);
+  for (; lhs_it.HasNext(); lhs_it.Advance(), rhs_it.Advance()) {
+    if (lhs_it.key() != rhs_it.key() ||
+        !lhs_it.value().Equals(&rhs_it.value())) {
       return false;
     }
-    ++lhs_it;
-    ++rhs_it;
   }
-  if (lhs_it != end_keys() || rhs_it != other_dict->end_keys())
-    return false;
 
   return true;
 }
 
+Value* DictionaryValue::FindValue(const std::string& key) const {
+  if (flat_dictionary_.empty()) {
+    ValueMap::const_iterator entry_iterator = dictionary_.find(key);
+    return entry_iterator == dictionary_.end() ? NULL : entry_iterator->second;
+  }
+  FlatValueMap::const_iterator entry_iterator = FindFlatEntry(key);
+  return entry_iterator == flat_dictionary_.end() ? NULL
+                                                  : entry_iterator->second;
+}
+
+Value* DictionaryValue::FindValue(const StringPiece& key) const {
+  if (flat_dictionary_.empty())
+    return FindValue(key.as_string());
+  FlatValueMap::const_iterator entry_iterator = FindFlatEntry(key);
+  return entry_iterator == flat_dictionary_.end() ? NULL
+                                                  : entry_iterator->second;
+}
+
+FlatValueMap::iterator DictionaryValue::FindFlatEntry(const StringPiece& key) {
+  FlatValueMap::iterator entry_iterator = std::lower_bound(
+      flat_dictionary_.begin(), flat_dictionary_.end(), key, EntryKeyLess());
+  if (entry_iterator != flat_dictionary_.end() &&
+      StringPiece(entry_iterator->first) != key) {
+    return flat_dictionary_.end();
+  }
+  return entry_iterator;
+}
+
+FlatValueMap::const_iterator DictionaryValue::FindFlatEntry(
+    const StringPiece& key) const {
+  return const_cast<DictionaryValue*>(this)->FindFlatEntry(key);
+}
+
+void DictionaryValue::MoveFlatEntriesToMap() {
+  DCHECK(dictionary_.empty());
+  // The entries are sorted, so each one is inserted in constant time.
+  for (FlatValueMap::iterator i(flat_dictionary_.begin());
+       i != flat_dictionary_.end(); ++i) {
+    dictionary_.insert(dictionary_.end(), ValueMap::value_type(i->first,
+                                                               i->second));
+  }
+  FlatValueMap().swap(flat_dictionary_);
+}
+
+const DictionaryValue* DictionaryValue::FindDictionaryForPath(
+    const std::string& path,
+    StringPiece* key) const {
+  const DictionaryValue* current_dictionary = this;
+  size_t start = 0;
+  for (size_t delimiter_position = path.find('.');
+       delimiter_position != std::string::npos;
+       delimiter_position = path.find('.', start)) {
+    // Assume that we're indexing into a dictionary.
+    Value* entry = current_dictionary->FindValue(
+        StringPiece(path.data() + start, delimiter_position - start));
+    if (!entry || !entry->IsType(TYPE_DICTIONARY))
+      return NULL;
+
+    current_dictionary = static_cast<const DictionaryValue*>(entry);
+    start = delimiter_position + 1;
+  }
+
+  *key = StringPiece(path.data() + start, path.size() - start);
+  return current_dictionary;
+}
+
 ///////////////////// ListValue ////////////////////
 
 ListValue::ListValue() : Value(TYPE_LIST) {
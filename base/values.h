@@ -25,12 +25,14 @@
 #include <iterator>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/string16.h"
+#include "base/string_piece.h"
 
 // This file declares "using base::Value", etc. at the bottom, so that
 // current code can use these classes without the base namespace. In
@@ -49,6 +51,10 @@ class Value;
 typedef std::vector<Value*> ValueVector;
 typedef std::map<std::string, Value*> ValueMap;
 
+// Key/value pairs in a vector, as handed to
+// DictionaryValue::SetEntriesWithoutPathExpansion().
+typedef std::vector<std::pair<std::string, Value*> > FlatValueMap;
+
 // The Value class is the base class for Values. A Value can be instantiated
 // via the Create*Value() factory methods, or by directly creating instances of
 // the subclasses.
@@ -226,10 +232,14 @@ class BASE_EXPORT DictionaryValue : public Value {
   bool HasKey(const std::string& key) const;
 
   // Returns the number of Values in this dictionary.
-  size_t size() const { return dictionary_.size(); }
+  size_t size() const {
+    return dictionary_.size() + flat_dictionary_.size();
+  }
 
   // Returns whether the dictionary is empty.
-  bool empty() const { return dictionary_.empty(); }
+  bool empty() const {
+    return dictionary_.empty() && flat_dictionary_.empty();
+  }
 
   // Clears any current contents of this dictionary.
   void Clear();
@@ -257,6 +267,15 @@ class BASE_EXPORT DictionaryValue : public Value {
   // be used as paths.
   void SetWithoutPathExpansion(const std::string& key, Value* in_value);
 
+  // Sets all the key/value pairs in |entries|, as if by calling
+  // SetWithoutPathExpansion() on each in order, and clears |entries|. When
+  // this dictionary is empty, it opts in to compact storage: the entries are
+  // kept in one vector sorted by key, which takes less memory and is faster
+  // to look up, copy and compare, e.g. for dictionaries built from a
+  // serialized form. The first call that adds or removes a key afterwards
+  // moves them to the regular storage.
+  void SetEntriesWithoutPathExpansion(FlatValueMap* entries);
+
   // Gets the Value associated with the given path starting from this object.
   // A path has the form "<key>" or "<key>.<key>.[...]", where "." indexes
   // into the next DictionaryValue down.  If the path can be resolved
@@ -322,6 +341,7 @@ class BASE_EXPORT DictionaryValue : public Value {
   // Swaps contents with the |other| dictionary.
   void Swap(DictionaryValue* other) {
     dictionary_.swap(other->dictionary_);
+    flat_dictionary_.swap(other->flat_dictionary_);
   }
 
   // This class provides an iterator for the keys in the dictionary.
@@ -333,37 +353,73 @@ class BASE_EXPORT DictionaryValue : public Value {
   class key_iterator
       : private std::iterator<std::input_iterator_tag, const std::string> {
    public:
-    explicit key_iterator(ValueMap::const_iterator itr) { itr_ = itr; }
+    // Iterates over [flat_itr, flat_end), then from |itr| on.
+    key_iterator(FlatValueMap::const_iterator flat_itr,
+                 FlatValueMap::const_iterator flat_end,
+                 ValueMap::const_iterator itr)
+        : flat_itr_(flat_itr), flat_end_(flat_end), itr_(itr) {}
     key_iterator operator++() {
-      ++itr_;
+      if (flat_itr_ != flat_end_)
+        ++flat_itr_;
+      else
+        ++itr_;
       return *this;
     }
-    const std::string& operator*() { return itr_->first; }
-    bool operator!=(const key_iterator& other) { return itr_ != other.itr_; }
-    bool operator==(const key_iterator& other) { return itr_ == other.itr_; }
+    const std::string& operator*() {
+      return flat_itr_ != flat_end_ ? flat_itr_->first : itr_->first;
+    }
+    bool operator!=(const key_iterator& other) { return !(*this == other); }
+    bool operator==(const key_iterator& other) {
+      return flat_itr_ == other.flat_itr_ && itr_ == other.itr_;
+    }
 
    private:
+    FlatValueMap::const_iterator flat_itr_;
+    FlatValueMap::const_iterator flat_end_;
     ValueMap::const_iterator itr_;
   };
 
-  key_iterator begin_keys() const { return key_iterator(dictionary_.begin()); }
-  key_iterator end_keys() const { return key_iterator(dictionary_.end()); }
+  key_iterator begin_keys() const {
+    return key_iterator(flat_dictionary_.begin(), flat_dictionary_.end(),
+                        dictionary_.begin());
+  }
+  key_iterator end_keys() const {
+    return key_iterator(flat_dictionary_.end(), flat_dictionary_.end(),
+                        dictionary_.end());
+  }
 
   // This class provides an iterator over both keys and values in the
   // dictionary.  It can't be used to modify the dictionary.
   class Iterator {
    public:
     explicit Iterator(const DictionaryValue& target)
-        : target_(target), it_(target.dictionary_.begin()) {}
+        : target_(target),
+          flat_it_(target.flat_dictionary_.begin()),
+          it_(target.dictionary_.begin()) {}
 
-    bool HasNext() const { return it_ != target_.dictionary_.end(); }
-    void Advance() { ++it_; }
+    bool HasNext() const {
+      return flat_it_ != target_.flat_dictionary_.end() ||
+             it_ != target_.dictionary_.end();
+    }
+    void Advance() {
+      if (flat_it_ != target_.flat_dictionary_.end())
+        ++flat_it_;
+      else
+        ++it_;
+    }
 
-    const std::string& key() const { return it_->first; }
-    const Value& value() const { return *it_->second; }
+    const std::string& key() const {
+      return flat_it_ != target_.flat_dictionary_.end() ? flat_it_->first
+                                                        : it_->first;
+    }
+    const Value& value() const {
+      return flat_it_ != target_.flat_dictionary_.end() ? *flat_it_->second
+                                                        : *it_->second;
+    }
 
    private:
     const DictionaryValue& target_;
+    FlatValueMap::const_iterator flat_it_;
     ValueMap::const_iterator it_;
   };
 
@@ -372,7 +428,29 @@ class BASE_EXPORT DictionaryValue : public Value {
   virtual bool Equals(const Value* other) const OVERRIDE;
 
  private:
+  // Returns the value for |key|, or NULL if there is none.
+  Value* FindValue(const std::string& key) const;
+  Value* FindValue(const StringPiece& key) const;
+
+  // Returns the entry of flat_dictionary_ for |key|, or its end.
+  FlatValueMap::iterator FindFlatEntry(const StringPiece& key);
+  FlatValueMap::const_iterator FindFlatEntry(const StringPiece& key) const;
+
+  // Moves the entries of flat_dictionary_ to dictionary_.
+  void MoveFlatEntriesToMap();
+
+  // Follows the dictionaries named by all but the last component of |path|.
+  // Returns the last dictionary reached, and sets |*key| to the last
+  // component. Returns NULL if some component does not name a dictionary.
+  const DictionaryValue* FindDictionaryForPath(const std::string& path,
+                                               StringPiece* key) const;
+
+  // The entries are kept in one of these, the other being empty.
+  // |flat_dictionary_| is sorted by key, and only used by dictionaries built
+  // with SetEntriesWithoutPathExpansion() until a key is added or removed,
+  // since those take linear time in a vector.
   ValueMap dictionary_;
+  FlatValueMap flat_dictionary_;
 
   DISALLOW_COPY_AND_ASSIGN(DictionaryValue);
 };
@@ -0,0 +1,164 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/values.h"
+
+#if defined(OS_LINUX)
+#include <malloc.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/rand_util.h"
+#include "base/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+// The shape of a large Preferences file: per-site content settings and
+// per-extension state, keyed by host or id, plus some flat settings.
+const int kNumSites = 20000;
+const int kNumExtensions = 500;
+const int kNumLookups = 1000000;
+
+std::string SiteKey(int i) {
+  return StringPrintf("http://www.site%d.example.com:80", i);
+}
+
+std::string ExtensionKey(int i) {
+  return StringPrintf("ext%08dabcdefghijklmnopqrstuv", i * 7919);
+}
+
+std::string MakePrefFile() {
+  // Keys are emitted in hashed order, as an arbitrary writer would, so that
+  // the parser cannot rely on them being sorted.
+  std::string json = "{\"profile\": {\"content_settings\": {\"pattern_pairs\":"
+                     " {";
+  for (int i = 0; i < kNumSites; ++i) {
+    int site = (i * 7907) % kNumSites;
+    if (i > 0)
+      json += ",";
+    StringAppendF(&json,
+                  "\"%s,*\": {\"cookies\": %d, \"images\": 1, "
+                  "\"per_plugin\": {\"flash\": 2}}",
+                  SiteKey(site).c_str(), site % 3);
+  }
+  json += "}}}, \"extensions\": {\"settings\": {";
+  for (int i = 0; i < kNumExtensions; ++i) {
+    if (i > 0)
+      json += ",";
+    StringAppendF(&json,
+                  "\"%s\": {\"state\": 1, \"location\": 1, \"path\": "
+                  "\"/home/user/.config/extensions/%d\", \"granted\": "
+                  "[\"tabs\", \"cookies\", \"http://*/*\"]}",
+                  ExtensionKey(i).c_str(), i);
+  }
+  json += "}}, \"homepage\": \"http://www.example.com/\", "
+          "\"homepage_is_newtabpage\": false}";
+  return json;
+}
+
+size_t HeapBytesInUse() {
+#if defined(OS_LINUX)
+  return mallinfo().uordblks;
+#else
+  return 0;
+#endif
+}
+
+}  // namespace
+
+TEST(ValuesPerfTest, LargePrefFile) {
+  std::string json = MakePrefFile();
+
+  size_t heap_before = HeapBytesInUse();
+  PerfTimer parse_timer;
+  scoped_ptr<Value> root(JSONReader::Read(json, false));
+  TimeDelta parse_time = parse_timer.Elapsed();
+  size_t heap_after = HeapBytesInUse();
+  ASSERT_TRUE(root.get() && root->IsType(Value::TYPE_DICTIONARY));
+  DictionaryValue* prefs = static_cast<DictionaryValue*>(root.get());
+  LogPerfResult("Values_PrefFile_Parse", parse_time.InMillisecondsF(), "ms");
+  if (heap_after || heap_before) {
+    LogPerfResult("Values_PrefFile_Memory",
+                  static_cast<double>(heap_after - heap_before) / 1024, "KB");
+  }
+
+  // Look up the settings of random sites, by path and by key.
+  DictionaryValue* pattern_pairs = NULL;
+  ASSERT_TRUE(prefs->GetDictionary("profile.content_settings.pattern_pairs",
+                                   &pattern_pairs));
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; ++i)
+    keys.push_back(SiteKey(RandInt(0, kNumSites - 1)) + ",*");
+  int sum = 0;
+  PerfTimer lookup_timer;
+  for (int i = 0; i < kNumLookups; ++i) {
+    DictionaryValue* site = NULL;
+    int setting = 0;
+    if (pattern_pairs->GetDictionaryWithoutPathExpansion(keys[i % 1000],
+                                                         &site) &&
+        site->GetInteger("per_plugin.flash", &setting)) {
+      sum += setting;
+    }
+  }
+  double lookup_ns = lookup_timer.Elapsed().InMicroseconds() * 1000.0 /
+                     kNumLookups;
+  EXPECT_EQ(2 * kNumLookups, sum);
+  LogPerfResult("Values_PrefFile_Lookup", lookup_ns, "ns");
+
+  PerfTimer path_timer;
+  bool homepage_is_ntp = true;
+  for (int i = 0; i < kNumLookups; ++i)
+    prefs->GetBoolean("homepage_is_newtabpage", &homepage_is_ntp);
+  EXPECT_FALSE(homepage_is_ntp);
+  LogPerfResult("Values_PrefFile_PathLookup",
+                path_timer.Elapsed().InMicroseconds() * 1000.0 / kNumLookups,
+                "ns");
+
+  PerfTimer copy_timer;
+  scoped_ptr<DictionaryValue> copy(prefs->DeepCopy());
+  LogPerfResult("Values_PrefFile_DeepCopy",
+                copy_timer.Elapsed().InMillisecondsF(), "ms");
+
+  PerfTimer equals_timer;
+  EXPECT_TRUE(copy->Equals(prefs));
+  LogPerfResult("Values_PrefFile_Equals",
+                equals_timer.Elapsed().InMillisecondsF(), "ms");
+
+  std::string output;
+  PerfTimer write_timer;
+  JSONWriter::Write(prefs, &output);
+  LogPerfResult("Values_PrefFile_Write",
+                write_timer.Elapsed().InMillisecondsF(), "ms");
+
+  PerfTimer destroy_timer;
+  root.reset();
+  copy.reset();
+  LogPerfResult("Values_PrefFile_Destroy",
+                destroy_timer.Elapsed().InMillisecondsF(), "ms");
+}
+
+TEST(ValuesPerfTest, BuildBySet) {
+  // Incremental construction, as PrefService does when settings change.
+  PerfTimer timer;
+  DictionaryValue dictionary;
+  for (int i = 0; i < kNumSites; ++i) {
+    int site = (i * 7907) % kNumSites;
+    dictionary.SetWithoutPathExpansion(SiteKey(site),
+                                       Value::CreateIntegerValue(i));
+  }
+  LogPerfResult("Values_BuildBySet", timer.Elapsed().InMillisecondsF(), "ms");
+  EXPECT_EQ(static_cast<size_t>(kNumSites), dictionary.size());
+}
+
+}  // namespace base
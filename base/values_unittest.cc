@@ -334,6 +334,138 @@ TEST(ValuesTest, DictionaryWithoutPathExpansion) {
   EXPECT_EQ(Value::TYPE_NULL, value4->GetType());
 }
 
+TEST(ValuesTest, DictionaryKeyOrder) {
+  DictionaryValue dict;
+  const char* keys[] = { "m", "b", "z", "a", "mm", "" };
+  for (size_t i = 0; i < arraysize(keys); ++i)
+    dict.SetWithoutPathExpansion(keys[i], Value::CreateIntegerValue(i));
+
+  // Keys are iterated in sorted order, however they were set.
+  std::string previous_key;
+  size_t count = 0;
+  for (DictionaryValue::Iterator it(dict); it.HasNext(); it.Advance()) {
+    if (count > 0)
+      EXPECT_LT(previous_key, it.key());
+    previous_key = it.key();
+    ++count;
+  }
+  EXPECT_EQ(arraysize(keys), count);
+
+  for (size_t i = 0; i < arraysize(keys); ++i) {
+    int value = -1;
+    EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion(keys[i], &value));
+    EXPECT_EQ(static_cast<int>(i), value);
+  }
+  EXPECT_FALSE(dict.HasKey("c"));
+  EXPECT_FALSE(dict.HasKey("zz"));
+}
+
+TEST(ValuesTest, SetEntriesWithoutPathExpansion) {
+  bool replaced_flag = false;
+  bool duplicate_flag = false;
+  bool kept_flag = false;
+  DictionaryValue dict;
+  dict.SetWithoutPathExpansion("kept", new DeletionTestValue(&kept_flag));
+  dict.SetWithoutPathExpansion("replaced",
+                               new DeletionTestValue(&replaced_flag));
+  dict.SetInteger("nested.value", 1);
+
+  FlatValueMap entries;
+  entries.push_back(std::make_pair(std::string("zebra"),
+                                   Value::CreateIntegerValue(1)));
+  entries.push_back(std::make_pair(std::string("duplicate"),
+                                   new DeletionTestValue(&duplicate_flag)));
+  entries.push_back(std::make_pair(std::string("replaced"),
+                                   Value::CreateIntegerValue(2)));
+  entries.push_back(std::make_pair(std::string("a.b"),
+                                   Value::CreateIntegerValue(3)));
+  entries.push_back(std::make_pair(std::string("duplicate"),
+                                   Value::CreateIntegerValue(4)));
+  dict.SetEntriesWithoutPathExpansion(&entries);
+  EXPECT_TRUE(entries.empty());
+
+  // As with SetWithoutPathExpansion(), replaced values are deleted and the
+  // last value set for a key wins.
+  EXPECT_FALSE(kept_flag);
+  EXPECT_TRUE(replaced_flag);
+  EXPECT_TRUE(duplicate_flag);
+  EXPECT_EQ(6U, dict.size());
+  int value = 0;
+  EXPECT_TRUE(dict.GetInteger("zebra", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(dict.GetInteger("replaced", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(dict.GetIntegerWithoutPathExpansion("a.b", &value));
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(dict.GetInteger("duplicate", &value));
+  EXPECT_EQ(4, value);
+  EXPECT_TRUE(dict.GetInteger("nested.value", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(dict.HasKey("kept"));
+
+  DictionaryValue::key_iterator key = dict.begin_keys();
+  const char* expected_keys[] = {
+    "a.b", "duplicate", "kept", "nested", "replaced", "zebra"
+  };
+  for (size_t i = 0; i < arraysize(expected_keys); ++i, ++key) {
+    ASSERT_TRUE(key != dict.end_keys());
+    EXPECT_EQ(expected_keys[i], *key);
+  }
+  EXPECT_TRUE(key == dict.end_keys());
+}
+
+TEST(ValuesTest, SetEntriesWithoutPathExpansionIntoEmpty) {
+  // An empty dictionary keeps bulk-set entries in flat storage, and moves
+  // them to its map when a key is added or removed.
+  bool duplicate_flag = false;
+  bool replaced_flag = false;
+  DictionaryValue dict;
+  FlatValueMap entries;
+  entries.push_back(std::make_pair(std::string("c"),
+                                   new DeletionTestValue(&duplicate_flag)));
+  entries.push_back(std::make_pair(std::string("a"),
+                                   new DeletionTestValue(&replaced_flag)));
+  entries.push_back(std::make_pair(std::string("c"),
+                                   Value::CreateIntegerValue(3)));
+  entries.push_back(std::make_pair(std::string("b"),
+                                   Value::CreateIntegerValue(2)));
+  dict.SetEntriesWithoutPathExpansion(&entries);
+  EXPECT_TRUE(entries.empty());
+  EXPECT_TRUE(duplicate_flag);
+  EXPECT_EQ(3U, dict.size());
+  scoped_ptr<DictionaryValue> copy(dict.DeepCopy());
+
+  dict.SetInteger("a", 1);
+  EXPECT_TRUE(replaced_flag);
+  dict.SetInteger("d", 4);
+  EXPECT_TRUE(dict.RemoveWithoutPathExpansion("b", NULL));
+  EXPECT_FALSE(dict.RemoveWithoutPathExpansion("b", NULL));
+  EXPECT_EQ(3U, dict.size());
+
+  const char* expected_keys[] = { "a", "c", "d" };
+  const int expected_values[] = { 1, 3, 4 };
+  size_t i = 0;
+  for (DictionaryValue::Iterator it(dict); it.HasNext(); it.Advance(), ++i) {
+    ASSERT_LT(i, arraysize(expected_keys));
+    EXPECT_EQ(expected_keys[i], it.key());
+    int value = 0;
+    EXPECT_TRUE(it.value().GetAsInteger(&value));
+    EXPECT_EQ(expected_values[i], value);
+  }
+  EXPECT_EQ(arraysize(expected_keys), i);
+
+  // Dictionaries compare equal however their entries are stored.
+  int value = 0;
+  EXPECT_TRUE(copy->GetInteger("c", &value));
+  EXPECT_EQ(3, value);
+  EXPECT_FALSE(copy->Equals(&dict));
+  copy->SetInteger("d", 4);
+  copy->SetInteger("a", 1);
+  copy->Remove("b", NULL);
+  EXPECT_TRUE(copy->Equals(&dict));
+  EXPECT_TRUE(dict.Equals(copy.get()));
+}
+
 TEST(ValuesTest, DeepCopy) {
   DictionaryValue original_dict;
   Value* original_null = Value::CreateNullValue();
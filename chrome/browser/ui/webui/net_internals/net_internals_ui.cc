@@ -879,10 +879,11 @@ void NetInternalsMessageHandler::IOThreadImpl::OnGetHostResolverInfo(
 
   ListValue* entry_list = new ListValue();
 
-  net::HostCache::EntryMap::Iterator it(cache->entries());
-  for (; it.HasNext(); it.Advance()) {
-    const net::HostCache::Key& key = it.key();
-    const net::HostCache::Entry& entry = it.value();
+  const net::HostCache::EntryMap& entries = cache->entries();
+  for (net::HostCache::EntryMap::const_iterator it = entries.begin();
+       it != entries.end(); ++it) {
+    const net::HostCache::Key& key = it->first;
+    const net::HostCache::Entry& entry = it->second;
 
     DictionaryValue* entry_dict = new DictionaryValue();
 
@@ -890,7 +891,7 @@ void NetInternalsMessageHandler::IOThreadImpl::OnGetHostResolverInfo(
     entry_dict->SetInteger("address_family",
         static_cast<int>(key.address_family));
     entry_dict->SetString("expiration",
-                          net::NetLog::TickCountToString(it.expiration()));
+                          net::NetLog::TickCountToString(entry.expiration));
 
     if (entry.error != net::OK) {
       entry_dict->SetInteger("error", entry.error);
@@ -9,7 +9,7 @@
 
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
-#include "base/message_pump_libevent.h"
+#include "base/message_loop.h"
 #include "build/build_config.h"
 #include "content/browser/gamepad/data_fetcher.h"
 #include "content/browser/gamepad/gamepad_standard_mappings.h"
@@ -25,7 +25,7 @@ namespace content {
 
 class GamepadPlatformDataFetcherLinux :
     public GamepadDataFetcher,
-    public base::MessagePumpLibevent::Watcher {
+    public MessageLoopForIO::Watcher {
  public:
   GamepadPlatformDataFetcherLinux();
   virtual ~GamepadPlatformDataFetcherLinux();
@@ -34,7 +34,7 @@ class GamepadPlatformDataFetcherLinux :
   virtual void GetGamepadData(WebKit::WebGamepads* pads,
                               bool devices_changed_hint) OVERRIDE;
 
-  // base::MessagePump:Libevent::Watcher:
+  // MessageLoopForIO::Watcher:
   virtual void OnFileCanReadWithoutBlocking(int fd) OVERRIDE;
   virtual void OnFileCanWriteWithoutBlocking(int fd) OVERRIDE;
 
@@ -48,7 +48,7 @@ class GamepadPlatformDataFetcherLinux :
   udev* udev_;
   udev_monitor* monitor_;
   int monitor_fd_;
-  base::MessagePumpLibevent::FileDescriptorWatcher monitor_watcher_;
+  MessageLoopForIO::FileDescriptorWatcher monitor_watcher_;
 
   // File descriptors for the /dev/input/js* devices. -1 if not in use.
   int device_fds_[WebKit::WebGamepads::itemsLengthCap];
@@ -26,7 +26,7 @@ namespace {
 
 // The class is used for watching the file descriptor used for D-Bus
 // communication.
-class Watch : public base::MessagePumpLibevent::Watcher {
+class Watch : public MessageLoopForIO::Watcher {
  public:
   Watch(DBusWatch* watch)
       : raw_watch_(watch) {
@@ -73,20 +73,20 @@ class Watch : public base::MessagePumpLibevent::Watcher {
   }
 
  private:
-  // Implement MessagePumpLibevent::Watcher.
+  // Implement MessageLoopForIO::Watcher.
   virtual void OnFileCanReadWithoutBlocking(int file_descriptor) {
     const bool success = dbus_watch_handle(raw_watch_, DBUS_WATCH_READABLE);
     CHECK(success) << "Unable to allocate memory";
   }
 
-  // Implement MessagePumpLibevent::Watcher.
+  // Implement MessageLoopForIO::Watcher.
   virtual void OnFileCanWriteWithoutBlocking(int file_descriptor) {
     const bool success = dbus_watch_handle(raw_watch_, DBUS_WATCH_WRITABLE);
     CHECK(success) << "Unable to allocate memory";
   }
 
   DBusWatch* raw_watch_;
-  base::MessagePumpLibevent::FileDescriptorWatcher file_descriptor_watcher_;
+  MessageLoopForIO::FileDescriptorWatcher file_descriptor_watcher_;
 };
 
 // The class is used for monitoring the timeout used for D-Bus method
@@ -74,6 +74,22 @@
         }]
       ],
     },
+    {
+      'target_name': 'ipc_perftests',
+      'type': 'executable',
+      'dependencies': [
+        'ipc',
+        '../base/base.gyp:base',
+        '../base/base.gyp:test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'include_dirs': [
+        '..'
+      ],
+      'sources': [
+        'ipc_perftests.cc',
+      ],
+    },
     {
       'target_name': 'test_support_ipc',
       'type': 'static_library',
@@ -6,15 +6,13 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stddef.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
-#include <sys/un.h>
-
-#if defined(OS_OPENBSD)
 #include <sys/uio.h>
-#endif
+#include <sys/un.h>
 
 #include <string>
 #include <map>
@@ -292,6 +290,13 @@ bool SocketWriteErrorIsRecoverable() {
 #endif  // OS_MACOSX
 }
 
+// The most iovecs to pass to one sendmsg() or writev() call.
+#if defined(IOV_MAX)
+const size_t kMaxIovecs = IOV_MAX;
+#else
+const size_t kMaxIovecs = 16;  // The POSIX minimum.
+#endif
+
 }  // namespace
 //------------------------------------------------------------------------------
 
@@ -478,6 +483,28 @@ bool Channel::ChannelImpl::Connect() {
   return did_connect;
 }
 
+size_t Channel::ChannelImpl::GetUnsentSegments(const Message& msg) {
+  send_iovecs_.clear();
+  size_t total_size = 0;
+  size_t skip = message_send_bytes_written_;
+  size_t segment_count = msg.segment_count();
+  for (size_t i = 0; i < segment_count && send_iovecs_.size() < kMaxIovecs;
+       ++i) {
+    const char* data;
+    size_t size;
+    msg.GetSegment(i, &data, &size);
+    if (size <= skip) {
+      skip -= size;
+      continue;
+    }
+    struct iovec iov = { const_cast<char*>(data) + skip, size - skip };
+    send_iovecs_.push_back(iov);
+    total_size += iov.iov_len;
+    skip = 0;
+  }
+  return total_size;
+}
+
 bool Channel::ChannelImpl::ProcessOutgoingMessages() {
   DCHECK(!waiting_connect_);  // Why are we trying to send messages if there's
                               // no connection?
@@ -492,15 +519,14 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
   while (!output_queue_.empty()) {
     Message* msg = output_queue_.front();
 
-    size_t amt_to_write = msg->size() - message_send_bytes_written_;
+    // Messages that reference external data are gathered from several
+    // segments, so that the data is not copied into the message.
+    size_t amt_to_write = GetUnsentSegments(*msg);
     DCHECK_NE(0U, amt_to_write);
-    const char* out_bytes = reinterpret_cast<const char*>(msg->data()) +
-        message_send_bytes_written_;
 
     struct msghdr msgh = {0};
-    struct iovec iov = {const_cast<char*>(out_bytes), amt_to_write};
-    msgh.msg_iov = &iov;
-    msgh.msg_iovlen = 1;
+    msgh.msg_iov = &send_iovecs_[0];
+    msgh.msg_iovlen = send_iovecs_.size();
     char buf[CMSG_SPACE(
         sizeof(int) * FileDescriptorSet::kMaxDescriptorsPerMessage)];
 
@@ -547,7 +573,7 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
         msgh.msg_iov = &fd_pipe_iov;
         fd_written = fd_pipe_;
         bytes_written = HANDLE_EINTR(sendmsg(fd_pipe_, &msgh, MSG_DONTWAIT));
-        msgh.msg_iov = &iov;
+        msgh.msg_iov = &send_iovecs_[0];
         msgh.msg_controllen = 0;
         if (bytes_written > 0) {
           msg->file_descriptor_set()->CommitAll();
@@ -563,7 +589,8 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
         DCHECK_EQ(msg->file_descriptor_set()->size(), 1U);
       }
       if (!msgh.msg_controllen) {
-        bytes_written = HANDLE_EINTR(write(pipe_, out_bytes, amt_to_write));
+        bytes_written = HANDLE_EINTR(writev(pipe_, &send_iovecs_[0],
+                                            send_iovecs_.size()));
       } else
 #endif  // IPC_USES_READWRITE
       {
@@ -607,6 +634,9 @@ bool Channel::ChannelImpl::ProcessOutgoingMessages() {
           &write_watcher_,
           this);
       return true;
+    } else if (message_send_bytes_written_ + bytes_written < msg->size()) {
+      // The message has more segments than fit in one write.
+      message_send_bytes_written_ += bytes_written;
     } else {
       message_send_bytes_written_ = 0;
 
@@ -75,6 +75,11 @@ class Channel::ChannelImpl : public internal::ChannelReader,
 
   bool ProcessOutgoingMessages();
 
+  // Fills |send_iovecs_| with the part of |msg| that is still to be sent,
+  // given that |message_send_bytes_written_| bytes of it have been, up to the
+  // most that can be written at once. Returns the number of bytes they hold.
+  size_t GetUnsentSegments(const Message& msg);
+
   bool AcceptConnection();
   void ClosePipeOnError();
   int GetHelloMessageProcId();
@@ -127,6 +132,10 @@ class Channel::ChannelImpl : public internal::ChannelReader,
   // to keep track of where we are.
   size_t message_send_bytes_written_;
 
+  // The segments of the message being sent, kept to avoid reallocating them
+  // for each message.
+  std::vector<struct iovec> send_iovecs_;
+
   // File descriptor we're listening on for new connections if we listen
   // for connections.
   int server_listen_pipe_;
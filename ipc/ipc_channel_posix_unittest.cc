@@ -11,10 +11,13 @@
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <vector>
+
 #include "base/basictypes.h"
 #include "base/eintr_wrapper.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
+#include "base/memory/ref_counted_memory.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "base/test/multiprocess_test.h"
@@ -90,6 +93,46 @@ class IPCChannelPosixTestListener : public IPC::Channel::Listener {
   bool quit_only_on_message_;
 };
 
+// Checks the payload of the messages sent by the SendExternalData test and
+// quits the run loop once the expected number of them has arrived.
+class ExternalDataListener : public IPC::Channel::Listener {
+ public:
+  ExternalDataListener(int expected_messages, size_t payload_size)
+      : expected_messages_(expected_messages),
+        payload_size_(payload_size),
+        received_messages_(0) {
+  }
+
+  virtual ~ExternalDataListener() {}
+
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
+    PickleIterator iter(message);
+    int index;
+    const char* data;
+    int length;
+    EXPECT_TRUE(message.ReadInt(&iter, &index));
+    EXPECT_EQ(received_messages_, index);
+    EXPECT_TRUE(message.ReadData(&iter, &data, &length));
+    EXPECT_EQ(payload_size_, static_cast<size_t>(length));
+    for (size_t i = 0; i < payload_size_; ++i) {
+      if (data[i] != static_cast<char>(i + index)) {
+        ADD_FAILURE() << "payload mismatch at offset " << i;
+        break;
+      }
+    }
+    if (++received_messages_ == expected_messages_)
+      MessageLoopForIO::current()->QuitNow();
+    return true;
+  }
+
+  int received_messages() const { return received_messages_; }
+
+ private:
+  int expected_messages_;
+  size_t payload_size_;
+  int received_messages_;
+};
+
 }  // namespace
 
 class IPCChannelPosixTest : public base::MultiProcessTest {
@@ -383,6 +426,44 @@ TEST_F(IPCChannelPosixTest, IsNamedServerInitialized) {
       kConnectionSocketTestName));
 }
 
+TEST_F(IPCChannelPosixTest, SendExternalData) {
+  // Messages whose payload is referenced rather than copied must arrive
+  // intact, even when they are too large to be written in one go.
+  const int kMessageCount = 3;
+  const size_t kPayloadSize = 4 * 1024 * 1024 + 3;
+  int pipe_fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pipe_fds));
+  ASSERT_GE(fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK), 0);
+  ASSERT_GE(fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK), 0);
+
+  IPCChannelPosixTestListener server_listener(true);
+  IPC::ChannelHandle server_handle("IPCChannelPosixTest_SendExternalData",
+                                   base::FileDescriptor(pipe_fds[0], true));
+  IPC::Channel server(server_handle, IPC::Channel::MODE_SERVER,
+                      &server_listener);
+  ExternalDataListener client_listener(kMessageCount, kPayloadSize);
+  IPC::ChannelHandle client_handle("IPCChannelPosixTest_SendExternalData",
+                                   base::FileDescriptor(pipe_fds[1], true));
+  IPC::Channel client(client_handle, IPC::Channel::MODE_CLIENT,
+                      &client_listener);
+  ASSERT_TRUE(server.Connect());
+  ASSERT_TRUE(client.Connect());
+
+  for (int i = 0; i < kMessageCount; ++i) {
+    std::vector<unsigned char> payload(kPayloadSize);
+    for (size_t j = 0; j < kPayloadSize; ++j)
+      payload[j] = static_cast<unsigned char>(j + i);
+    IPC::Message* message = new IPC::Message(0, 1,
+                                             IPC::Message::PRIORITY_NORMAL);
+    message->WriteInt(i);
+    ASSERT_TRUE(message->WriteExternalData(
+        RefCountedBytes::TakeVector(&payload)));
+    ASSERT_TRUE(server.Send(message));
+  }
+  SpinRunLoop(TestTimeouts::action_max_timeout_ms());
+  EXPECT_EQ(kMessageCount, client_listener.received_messages());
+}
+
 // A long running process that connects to us
 MULTIPROCESS_TEST_MAIN(IPCChannelPosixTestConnectionProc) {
   MessageLoopForIO message_loop;
@@ -87,6 +87,13 @@ bool Channel::ChannelImpl::Send(Message* message) {
   Logging::GetInstance()->OnSendMessage(message, "");
 #endif
 
+  // Overlapped writes take a single buffer, so external data is copied in.
+  if (message->has_external_data()) {
+    Message* flattened = new Message(*message);
+    delete message;
+    message = flattened;
+  }
+
   output_queue_.push(message);
   // ensure waiting to write
   if (!waiting_connect_) {
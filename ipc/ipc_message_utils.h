@@ -868,6 +868,10 @@ struct IPC_EXPORT ParamTraits<LogData> {
 template <>
 struct ParamTraits<Message> {
   static void Write(Message* m, const Message& p) {
+    if (p.has_external_data()) {
+      Write(m, Message(p));
+      return;
+    }
     DCHECK(p.size() <= INT_MAX);
     int message_size = static_cast<int>(p.size());
     m->WriteInt(message_size);
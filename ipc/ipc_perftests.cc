@@ -0,0 +1,154 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "ipc/ipc_channel.h"
+#include "ipc/ipc_message.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const char kChannelName[] = "IPCPerfTestChannel";
+const uint32 kPayloadMessage = 1;
+
+// How messages are built in the test.
+enum PayloadMode {
+  // The payload is copied into the message with WriteData().
+  PAYLOAD_COPIED,
+  // The message references the payload with WriteExternalData().
+  PAYLOAD_EXTERNAL,
+};
+
+// Sends messages of a fixed size from the server end of a channel to the
+// client end on the same thread, keeping a few in flight, and quits the
+// message loop when they have all arrived.
+class PayloadSender : public IPC::Channel::Listener {
+ public:
+  PayloadSender(PayloadMode mode, size_t payload_size, int message_count)
+      : mode_(mode),
+        message_count_(message_count),
+        sent_count_(0),
+        received_count_(0),
+        received_bytes_(0),
+        server_(NULL) {
+    std::vector<unsigned char> bytes(payload_size);
+    for (size_t i = 0; i < bytes.size(); ++i)
+      bytes[i] = static_cast<unsigned char>(i);
+    payload_ = RefCountedBytes::TakeVector(&bytes);
+  }
+
+  void Start(IPC::Channel* server) {
+    server_ = server;
+    for (int i = 0; i < kMessagesInFlight; ++i)
+      SendNext();
+  }
+
+  int received_count() const { return received_count_; }
+  int64 received_bytes() const { return received_bytes_; }
+
+  // IPC::Channel::Listener implementation, for the client end.
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
+    PickleIterator iter(message);
+    const char* data;
+    int length;
+    EXPECT_TRUE(message.ReadData(&iter, &data, &length));
+    received_bytes_ += length;
+    if (++received_count_ == message_count_)
+      MessageLoop::current()->QuitNow();
+    else
+      SendNext();
+    return true;
+  }
+
+  virtual void OnChannelError() OVERRIDE {
+    ADD_FAILURE() << "channel error";
+    MessageLoop::current()->QuitNow();
+  }
+
+ private:
+  static const int kMessagesInFlight = 2;
+
+  void SendNext() {
+    if (sent_count_ == message_count_)
+      return;
+    ++sent_count_;
+    IPC::Message* message = new IPC::Message(0, kPayloadMessage,
+                                             IPC::Message::PRIORITY_NORMAL);
+    if (mode_ == PAYLOAD_COPIED) {
+      message->WriteData(reinterpret_cast<const char*>(payload_->front()),
+                         payload_->size());
+    } else {
+      message->WriteExternalData(payload_);
+    }
+    server_->Send(message);
+  }
+
+  PayloadMode mode_;
+  int message_count_;
+  int sent_count_;
+  int received_count_;
+  int64 received_bytes_;
+  scoped_refptr<RefCountedBytes> payload_;
+  IPC::Channel* server_;
+
+  DISALLOW_COPY_AND_ASSIGN(PayloadSender);
+};
+
+// Ignores messages sent to the server end.
+class NullListener : public IPC::Channel::Listener {
+ public:
+  virtual bool OnMessageReceived(const IPC::Message& message) OVERRIDE {
+    return true;
+  }
+};
+
+class IPCPerfTest : public testing::TestWithParam<PayloadMode> {
+ protected:
+  void RunTest(size_t payload_size, int message_count) {
+    MessageLoopForIO message_loop;
+    NullListener server_listener;
+    PayloadSender sender(GetParam(), payload_size, message_count);
+    IPC::Channel server(kChannelName, IPC::Channel::MODE_SERVER,
+                        &server_listener);
+    ASSERT_TRUE(server.Connect());
+    IPC::Channel client(kChannelName, IPC::Channel::MODE_CLIENT, &sender);
+    ASSERT_TRUE(client.Connect());
+
+    PerfTimer timer;
+    sender.Start(&server);
+    message_loop.Run();
+    double seconds = timer.Elapsed().InSecondsF();
+
+    EXPECT_EQ(message_count, sender.received_count());
+    LogPerfResult(
+        StringPrintf("IPC_%s_%dKB",
+                     GetParam() == PAYLOAD_COPIED ? "Copied" : "External",
+                     static_cast<int>(payload_size / 1024)).c_str(),
+        sender.received_bytes() / seconds / (1024 * 1024), "MB/s");
+  }
+};
+
+TEST_P(IPCPerfTest, Throughput64KB) {
+  RunTest(64 * 1024, 4000);
+}
+
+TEST_P(IPCPerfTest, Throughput1MB) {
+  RunTest(1024 * 1024, 500);
+}
+
+TEST_P(IPCPerfTest, Throughput16MB) {
+  RunTest(16 * 1024 * 1024, 30);
+}
+
+INSTANTIATE_TEST_CASE_P(, IPCPerfTest,
+                        testing::Values(PAYLOAD_COPIED, PAYLOAD_EXTERNAL));
+
+}  // namespace
@@ -13,7 +13,8 @@ namespace net {
 
 HostCache::Entry::Entry(int error, const AddressList& addrlist)
     : error(error),
-      addrlist(addrlist) {
+      addrlist(addrlist),
+      hit_count(0) {
 }
 
 HostCache::Entry::~Entry() {
@@ -22,7 +23,8 @@ HostCache::Entry::~Entry() {
 //-----------------------------------------------------------------------------
 
 HostCache::HostCache(size_t max_entries)
-    : entries_(max_entries) {
+    : max_entries_(max_entries),
+      entries_(max_entries) {
 }
 
 HostCache::~HostCache() {
@@ -30,11 +32,31 @@ HostCache::~HostCache() {
 
 const HostCache::Entry* HostCache::Lookup(const Key& key,
                                           base::TimeTicks now) {
+  return LookupStale(key, now, base::TimeDelta());
+}
+
+const HostCache::Entry* HostCache::LookupStale(const Key& key,
+                                               base::TimeTicks now,
+                                               base::TimeDelta max_staleness) {
   DCHECK(CalledOnValidThread());
   if (caching_is_disabled())
     return NULL;
 
-  return entries_.Get(key, now);
+  // Look the entry up without touching the recency list, so that misses on
+  // expired entries don't keep them alive.
+  EntryMap::iterator it = entries_.Peek(key);
+  if (it == entries_.end())
+    return NULL;
+
+  Entry* entry = &it->second;
+  if (!entry->IsValid(now) &&
+      (entry->error != OK || now >= entry->expiration + max_staleness)) {
+    return NULL;
+  }
+
+  entries_.Get(key);
+  ++entry->hit_count;
+  return entry;
 }
 
 void HostCache::Set(const Key& key,
@@ -46,7 +68,10 @@ void HostCache::Set(const Key& key,
   if (caching_is_disabled())
     return;
 
-  entries_.Put(key, Entry(error, addrlist), now, ttl);
+  Entry entry(error, addrlist);
+  entry.expiration = now + ttl;
+  entry.ttl = ttl;
+  entries_.Put(key, entry);
 }
 
 void HostCache::clear() {
@@ -61,7 +86,7 @@ size_t HostCache::size() const {
 
 size_t HostCache::max_entries() const {
   DCHECK(CalledOnValidThread());
-  return entries_.max_entries();
+  return max_entries_;
 }
 
 // Note that this map may contain expired entries.
@@ -9,16 +9,83 @@
 #include <string>
 
 #include "base/gtest_prod_util.h"
+#include "base/hash_tables.h"
+#include "base/memory/mru_cache.h"
 #include "base/threading/non_thread_safe.h"
 #include "base/time.h"
 #include "net/base/address_family.h"
 #include "net/base/address_list.h"
-#include "net/base/expiring_cache.h"
 #include "net/base/net_export.h"
 
 namespace net {
 
+// Identifies an entry of HostCache, where it is known as HostCache::Key. It is
+// declared outside of HostCache so that it can be hashed by HostCache's
+// own entry map.
+struct HostCacheKey {
+  HostCacheKey(const std::string& hostname, AddressFamily address_family,
+               HostResolverFlags host_resolver_flags)
+      : hostname(hostname),
+        address_family(address_family),
+        host_resolver_flags(host_resolver_flags) {}
+
+  bool operator<(const HostCacheKey& other) const {
+    // |address_family| and |host_resolver_flags| are compared before
+    // |hostname| under assumption that integer comparisons are faster than
+    // string comparisons.
+    if (address_family != other.address_family)
+      return address_family < other.address_family;
+    if (host_resolver_flags != other.host_resolver_flags)
+      return host_resolver_flags < other.host_resolver_flags;
+    return hostname < other.hostname;
+  }
+
+  bool operator==(const HostCacheKey& other) const {
+    return address_family == other.address_family &&
+           host_resolver_flags == other.host_resolver_flags &&
+           hostname == other.hostname;
+  }
+
+  std::string hostname;
+  AddressFamily address_family;
+  HostResolverFlags host_resolver_flags;
+};
+
+}  // namespace net
+
+namespace BASE_HASH_NAMESPACE {
+#if defined(COMPILER_GCC)
+
+template<>
+struct hash<net::HostCacheKey> {
+  size_t operator()(const net::HostCacheKey& key) const {
+    return hash<std::string>()(key.hostname) ^
+        (static_cast<size_t>(key.address_family) << 8) ^
+        static_cast<size_t>(key.host_resolver_flags);
+  }
+};
+
+#elif defined(COMPILER_MSVC)
+
+inline size_t hash_value(const net::HostCacheKey& key) {
+  return hash_value(key.hostname) ^
+      (static_cast<size_t>(key.address_family) << 8) ^
+      static_cast<size_t>(key.host_resolver_flags);
+}
+
+#endif  // COMPILER
+
+}  // namespace BASE_HASH_NAMESPACE
+
+namespace net {
+
 // Cache used by HostResolver to map hostnames to their resolved result.
+//
+// Entries live in a hash table threaded onto a recency list, so lookups are
+// O(1) and, once the cache is full, inserting evicts the least recently used
+// entry in O(1). Expired entries are not dropped on lookup: they stay around
+// (until evicted or overwritten) so that LookupStale() can serve them while
+// the resolver refreshes them.
 class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
  public:
   // Stores the latest address list that was looked up for a hostname.
@@ -26,35 +93,26 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
     Entry(int error, const AddressList& addrlist);
     ~Entry();
 
+    // Returns true if the entry is still fresh at time |now|.
+    bool IsValid(base::TimeTicks now) const { return now < expiration; }
+
     // The resolve results for this entry.
     int error;
     AddressList addrlist;
-  };
 
-  struct Key {
-    Key(const std::string& hostname, AddressFamily address_family,
-        HostResolverFlags host_resolver_flags)
-        : hostname(hostname),
-          address_family(address_family),
-          host_resolver_flags(host_resolver_flags) {}
-
-    bool operator<(const Key& other) const {
-      // |address_family| and |host_resolver_flags| are compared before
-      // |hostname| under assumption that integer comparisons are faster than
-      // string comparisons.
-      if (address_family != other.address_family)
-        return address_family < other.address_family;
-      if (host_resolver_flags != other.host_resolver_flags)
-        return host_resolver_flags < other.host_resolver_flags;
-      return hostname < other.hostname;
-    }
-
-    std::string hostname;
-    AddressFamily address_family;
-    HostResolverFlags host_resolver_flags;
+    // The time at which this entry stops being fresh, and the TTL it was
+    // stored with.
+    base::TimeTicks expiration;
+    base::TimeDelta ttl;
+
+    // Number of lookups this entry has answered since it was last Set().
+    int hit_count;
   };
 
-  typedef ExpiringCache<Key, Entry> EntryMap;
+  typedef HostCacheKey Key;
+
+  // Ordered from the most to the least recently used entry.
+  typedef base::HashingMRUCache<Key, Entry> EntryMap;
 
   // Constructs a HostCache that stores up to |max_entries|.
   explicit HostCache(size_t max_entries);
@@ -62,9 +120,17 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   ~HostCache();
 
   // Returns a pointer to the entry for |key|, which is valid at time
-  // |now|. If there is no such entry, returns NULL.
+  // |now|. If there is no such entry, returns NULL. A hit counts towards the
+  // entry's |hit_count| and makes it the most recently used.
   const Entry* Lookup(const Key& key, base::TimeTicks now);
 
+  // Same as Lookup(), except that a successful entry is also returned up to
+  // |max_staleness| after it expired. Use Entry::IsValid() to tell a stale
+  // entry from a fresh one. Failed resolutions are never served stale.
+  const Entry* LookupStale(const Key& key,
+                           base::TimeTicks now,
+                           base::TimeDelta max_staleness);
+
   // Overwrites or creates an entry for |key|.
   // (|error|, |addrlist|) is the value to set, |now| is the current time
   // |ttl| is the "time to live".
@@ -93,9 +159,11 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
 
   // Returns true if this HostCache can contain no entries.
   bool caching_is_disabled() const {
-    return entries_.max_entries() == 0;
+    return max_entries_ == 0;
   }
 
+  size_t max_entries_;
+
   // Map from hostname (presumably in lowercase canonicalized format) to
   // a resolved result entry.
   EntryMap entries_;
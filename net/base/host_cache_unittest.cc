@@ -287,6 +287,106 @@ TEST(HostCacheTest, Clear) {
   EXPECT_EQ(0u, cache.size());
 }
 
+// Tests that a full cache evicts the least recently used entry.
+TEST(HostCacheTest, EvictLeastRecentlyUsed) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(3);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  cache.Set(Key("foobar1.com"), OK, AddressList(), now, kTTL);
+  cache.Set(Key("foobar2.com"), OK, AddressList(), now, kTTL);
+  cache.Set(Key("foobar3.com"), OK, AddressList(), now, kTTL);
+  EXPECT_EQ(3u, cache.size());
+
+  // Using "foobar1.com" leaves "foobar2.com" as the least recently used.
+  EXPECT_TRUE(cache.Lookup(Key("foobar1.com"), now));
+
+  cache.Set(Key("foobar4.com"), OK, AddressList(), now, kTTL);
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_TRUE(cache.Lookup(Key("foobar1.com"), now));
+  EXPECT_FALSE(cache.Lookup(Key("foobar2.com"), now));
+  EXPECT_TRUE(cache.Lookup(Key("foobar3.com"), now));
+  EXPECT_TRUE(cache.Lookup(Key("foobar4.com"), now));
+
+  // Overwriting an entry doesn't evict anything.
+  cache.Set(Key("foobar3.com"), OK, AddressList(), now, kTTL);
+  EXPECT_EQ(3u, cache.size());
+  EXPECT_TRUE(cache.Lookup(Key("foobar1.com"), now));
+  EXPECT_TRUE(cache.Lookup(Key("foobar4.com"), now));
+}
+
+TEST(HostCacheTest, LookupStale) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+  const base::TimeDelta kMaxStaleness = base::TimeDelta::FromSeconds(5);
+
+  HostCache cache(kMaxCacheEntries);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  HostCache::Key key1 = Key("foobar.com");
+  HostCache::Key key2 = Key("foobar2.com");
+
+  cache.Set(key1, OK, AddressList(), now, kTTL);
+  cache.Set(key2, ERR_NAME_NOT_RESOLVED, AddressList(), now, kTTL);
+
+  const HostCache::Entry* entry = cache.LookupStale(key1, now, kMaxStaleness);
+  ASSERT_TRUE(entry);
+  EXPECT_TRUE(entry->IsValid(now));
+
+  // Advance to t=10; both entries are now expired, but the successful one can
+  // still be served stale.
+  now += base::TimeDelta::FromSeconds(10);
+
+  EXPECT_FALSE(cache.Lookup(key1, now));
+  entry = cache.LookupStale(key1, now, kMaxStaleness);
+  ASSERT_TRUE(entry);
+  EXPECT_FALSE(entry->IsValid(now));
+  EXPECT_FALSE(cache.LookupStale(key2, now, kMaxStaleness));
+
+  // Expired entries are kept until they are evicted or overwritten.
+  EXPECT_EQ(2u, cache.size());
+
+  // Advance to t=15; key1 is now too stale to be served.
+  now += base::TimeDelta::FromSeconds(5);
+
+  EXPECT_FALSE(cache.LookupStale(key1, now, kMaxStaleness));
+
+  // Refreshing the entry makes it fresh again.
+  cache.Set(key1, OK, AddressList(), now, kTTL);
+  entry = cache.LookupStale(key1, now, kMaxStaleness);
+  ASSERT_TRUE(entry);
+  EXPECT_TRUE(entry->IsValid(now));
+}
+
+TEST(HostCacheTest, HitCount) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+
+  // Set t=0.
+  base::TimeTicks now;
+
+  HostCache::Key key1 = Key("foobar.com");
+
+  cache.Set(key1, OK, AddressList(), now, kTTL);
+  EXPECT_EQ(1, cache.Lookup(key1, now)->hit_count);
+  EXPECT_EQ(2, cache.Lookup(key1, now)->hit_count);
+  EXPECT_EQ(3, cache.Lookup(key1, now)->hit_count);
+
+  // Misses on the expired entry don't count.
+  now += base::TimeDelta::FromSeconds(10);
+  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_EQ(4, cache.LookupStale(key1, now, kTTL)->hit_count);
+
+  // Setting the entry again starts counting from scratch.
+  cache.Set(key1, OK, AddressList(), now, kTTL);
+  EXPECT_EQ(1, cache.Lookup(key1, now)->hit_count);
+}
+
 // Tests the less than and equal operators for HostCache::Key work.
 TEST(HostCacheTest, KeyComparators) {
   struct {
@@ -361,14 +461,17 @@ TEST(HostCacheTest, KeyComparators) {
       case -1:
         EXPECT_TRUE(key1 < key2);
         EXPECT_FALSE(key2 < key1);
+        EXPECT_FALSE(key1 == key2);
         break;
       case 0:
         EXPECT_FALSE(key1 < key2);
         EXPECT_FALSE(key2 < key1);
+        EXPECT_TRUE(key1 == key2);
         break;
       case 1:
         EXPECT_FALSE(key1 < key2);
         EXPECT_TRUE(key2 < key1);
+        EXPECT_FALSE(key1 == key2);
         break;
       default:
         FAIL() << "Invalid expectation. Can be only -1, 0, 1";
@@ -10,6 +10,7 @@
 #include <netdb.h>
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <utility>
 #include <vector>
@@ -63,6 +64,14 @@ const unsigned kCacheEntryTTLSeconds = 60;
 // Default TTL for unsuccessful resolutions with ProcTask.
 const unsigned kNegativeCacheEntryTTLSeconds = 0;
 
+// Number of cache hits after which an entry is considered hot, and is
+// re-resolved in the background shortly before it expires.
+const int kRefreshMinHits = 3;
+
+// A hot entry is re-resolved once less than 1/kRefreshTTLDivisor of its TTL
+// remains.
+const int kRefreshTTLDivisor = 10;
+
 // Maximum of 8 concurrent resolver threads (excluding retries).
 // Some routers (or resolvers) appear to start to provide host-not-found if
 // too many simultaneous resolutions are pending.  This number needs to be
@@ -453,6 +462,7 @@ HostResolver* CreateHostResolver(size_t max_concurrent_resolves,
       HostResolverImpl::ProcTaskParams(NULL, max_retry_attempts),
       config_service.Pass(),
       net_log);
+  resolver->set_refresh_hot_entries(true);
 
   return resolver;
 }
@@ -1038,7 +1048,9 @@ class HostResolverImpl::IPv6ProbeJob
 
 //-----------------------------------------------------------------------------
 
-// Resolves the hostname using DnsTransaction.
+// Resolves the hostname using DnsTransaction. Lookups for
+// ADDRESS_FAMILY_UNSPECIFIED run an A and an AAAA transaction in parallel and
+// merge their results.
 // TODO(szym): This could be moved to separate source file as well.
 class HostResolverImpl::DnsTask {
  public:
@@ -1050,67 +1062,148 @@ class HostResolverImpl::DnsTask {
           const Key& key,
           const Callback& callback,
           const BoundNetLog& job_net_log)
-      : callback_(callback), net_log_(job_net_log) {
+      : callback_(callback),
+        net_log_(job_net_log),
+        num_pending_transactions_(0),
+        net_error_(OK),
+        result_(DnsResponse::DNS_SUCCESS) {
     DCHECK(factory);
     DCHECK(!callback.is_null());
 
-    // For now we treat ADDRESS_FAMILY_UNSPEC as if it was IPV4.
-    uint16 qtype = (key.address_family == ADDRESS_FAMILY_IPV6)
-                   ? dns_protocol::kTypeAAAA
-                   : dns_protocol::kTypeA;
     // TODO(szym): Implement "happy eyeballs".
-    transaction_ = factory->CreateTransaction(
-        key.hostname,
-        qtype,
-        base::Bind(&DnsTask::OnTransactionComplete, base::Unretained(this),
-                   base::TimeTicks::Now()),
-        net_log_);
-    DCHECK(transaction_.get());
+    if (key.address_family != ADDRESS_FAMILY_IPV6) {
+      transaction_a_ = CreateTransaction(factory, key, dns_protocol::kTypeA);
+      DCHECK(transaction_a_.get());
+    }
+    if (key.address_family != ADDRESS_FAMILY_IPV4) {
+      transaction_aaaa_ = CreateTransaction(factory, key,
+                                            dns_protocol::kTypeAAAA);
+      DCHECK(transaction_aaaa_.get());
+    }
   }
 
   int Start() {
     net_log_.BeginEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK, NULL);
-    return transaction_->Start();
+    StartTransaction(transaction_a_.get());
+    StartTransaction(transaction_aaaa_.get());
+    if (num_pending_transactions_ > 0)
+      return ERR_IO_PENDING;
+    // Both transactions failed synchronously.
+    DCHECK_NE(OK, net_error_);
+    net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
+                      new DnsTaskFailedParams(net_error_, result_));
+    return net_error_;
   }
 
   void OnTransactionComplete(const base::TimeTicks& start_time,
                              DnsTransaction* transaction,
                              int net_error,
                              const DnsResponse* response) {
-    // Run |callback_| last since the owning Job will then delete this DnsTask.
     DnsResponse::Result result = DnsResponse::DNS_SUCCESS;
+    AddressList addr_list;
+    base::TimeDelta ttl;
     if (net_error == OK) {
       DNS_HISTOGRAM("AsyncDNS.TransactionSuccess",
                     base::TimeTicks::Now() - start_time);
-      AddressList addr_list;
-      base::TimeDelta ttl;
       result = response->ParseToAddressList(&addr_list, &ttl);
       UMA_HISTOGRAM_ENUMERATION("AsyncDNS.ParseToAddressList",
                                 result,
                                 DnsResponse::DNS_PARSE_RESULT_MAX);
-      if (result == DnsResponse::DNS_SUCCESS) {
-        net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
-                          new AddressListNetLogParam(addr_list));
-        callback_.Run(net_error, addr_list, ttl);
-        return;
-      }
-      net_error = ERR_DNS_MALFORMED_RESPONSE;
+      if (result != DnsResponse::DNS_SUCCESS)
+        net_error = ERR_DNS_MALFORMED_RESPONSE;
     } else {
       DNS_HISTOGRAM("AsyncDNS.TransactionFailure",
                     base::TimeTicks::Now() - start_time);
     }
+    AddResult(transaction->GetType(), net_error, result, addr_list, ttl);
+
+    DCHECK_GT(num_pending_transactions_, 0);
+    if (--num_pending_transactions_ > 0)
+      return;
+
+    // Run |callback_| last since the owning Job will then delete this DnsTask.
+    if (addr_list_.head() == NULL) {
+      net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
+                        new DnsTaskFailedParams(net_error_, result_));
+      callback_.Run(net_error_, AddressList(), base::TimeDelta());
+      return;
+    }
     net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
-                      new DnsTaskFailedParams(net_error, result));
-    callback_.Run(net_error, AddressList(), base::TimeDelta());
+                      new AddressListNetLogParam(addr_list_));
+    callback_.Run(OK, addr_list_, ttl_);
   }
 
  private:
+  scoped_ptr<DnsTransaction> CreateTransaction(DnsTransactionFactory* factory,
+                                               const Key& key,
+                                               uint16 qtype) {
+    return factory->CreateTransaction(
+        key.hostname,
+        qtype,
+        base::Bind(&DnsTask::OnTransactionComplete, base::Unretained(this),
+                   base::TimeTicks::Now()),
+        net_log_);
+  }
+
+  void StartTransaction(DnsTransaction* transaction) {
+    if (!transaction)
+      return;
+    int rv = transaction->Start();
+    if (rv == ERR_IO_PENDING) {
+      ++num_pending_transactions_;
+      return;
+    }
+    DCHECK_NE(OK, rv);
+    AddResult(transaction->GetType(), rv, DnsResponse::DNS_SUCCESS,
+              AddressList(), base::TimeDelta());
+  }
+
+  // Merges the result of the transaction for |qtype| into the result of the
+  // task. IPv4 addresses go first, as they did before AAAA was queried. The
+  // task fails only if all transactions fail, in which case the error of the
+  // A transaction takes precedence.
+  void AddResult(uint16 qtype,
+                 int net_error,
+                 DnsResponse::Result result,
+                 const AddressList& addr_list,
+                 base::TimeDelta ttl) {
+    if (net_error != OK) {
+      if (net_error_ == OK || qtype == dns_protocol::kTypeA) {
+        net_error_ = net_error;
+        result_ = result;
+      }
+      return;
+    }
+    if (addr_list_.head() == NULL) {
+      addr_list_ = addr_list;
+      ttl_ = ttl;
+      return;
+    }
+    if (qtype == dns_protocol::kTypeA) {
+      AddressList merged = addr_list;
+      merged.Append(addr_list_.head());
+      addr_list_ = merged;
+    } else {
+      addr_list_.Append(addr_list.head());
+    }
+    ttl_ = std::min(ttl_, ttl);
+  }
+
   // The listener to the results of this DnsTask.
   Callback callback_;
 
   const BoundNetLog net_log_;
 
-  scoped_ptr<DnsTransaction> transaction_;
+  scoped_ptr<DnsTransaction> transaction_a_;
+  scoped_ptr<DnsTransaction> transaction_aaaa_;
+  int num_pending_transactions_;
+
+  // Merged result of the completed transactions.
+  AddressList addr_list_;
+  base::TimeDelta ttl_;
+  // Error of the failed transactions.
+  int net_error_;
+  DnsResponse::Result result_;
 };
 
 //-----------------------------------------------------------------------------
@@ -1127,6 +1220,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
         key_(key),
         had_non_speculative_request_(false),
         had_dns_config_(false),
+        is_refresh_(false),
         net_log_(BoundNetLog::Make(request_net_log.net_log(),
                                    NetLog::SOURCE_HOST_RESOLVER_IMPL_JOB)) {
     request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CREATE_JOB, NULL);
@@ -1175,6 +1269,12 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
     handle_ = resolver_->dispatcher_.Add(this, priority);
   }
 
+  // Marks this Job as a background refresh of a cache entry. Such a Job runs
+  // to completion and caches its result even if no Request is attached.
+  void set_is_refresh() {
+    is_refresh_ = true;
+  }
+
   void AddRequest(scoped_ptr<Request> req) {
     DCHECK_EQ(key_.hostname, req->info().hostname());
 
@@ -1221,7 +1321,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
         make_scoped_refptr(new JobAttachParameters(
             req->request_net_log().source(), priority())));
 
-    if (num_active_requests() > 0) {
+    if (num_active_requests() > 0 || is_refresh_) {
       if (is_queued())
         handle_ = resolver_->dispatcher_.ChangePriority(handle_, priority());
     } else {
@@ -1257,7 +1357,10 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
   // Attempts to serve the job from HOSTS. Returns true if succeeded and
   // this Job was destroyed.
   bool ServeFromHosts() {
-    DCHECK_GT(num_active_requests(), 0u);
+    DCHECK(num_active_requests() > 0 || is_refresh_);
+    // HOSTS results are not cached, so there is nothing to refresh.
+    if (requests_.empty())
+      return false;
     AddressList addr_list;
     if (resolver_->ServeFromHosts(key(),
                                   requests_.front()->info(),
@@ -1409,7 +1512,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
       handle_.Reset();
     }
 
-    if (num_active_requests() == 0) {
+    if (num_active_requests() == 0 && !is_refresh_) {
       net_log_.AddEvent(NetLog::TYPE_CANCELLED, NULL);
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
                                         OK);
@@ -1419,15 +1522,19 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
     net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
                                       net_error);
 
-    DCHECK(!requests_.empty());
+    DCHECK(!requests_.empty() || is_refresh_);
 
     // We are the only consumer of |list|, so we can safely change the port
     // without copy-on-write. This pays off, when job has only one request.
-    if (net_error == OK)
+    if (net_error == OK && !requests_.empty())
       MutableSetPort(requests_.front()->info().port(), &list);
 
+    // A failure is cached for the Requests that are waiting for it. A refresh
+    // that fails with none attached leaves the entry it was refreshing in
+    // place.
     if ((net_error != ERR_ABORTED) &&
-        (net_error != ERR_HOST_RESOLVER_QUEUE_TOO_LARGE)) {
+        (net_error != ERR_HOST_RESOLVER_QUEUE_TOO_LARGE) &&
+        (net_error == OK || num_active_requests() > 0)) {
       resolver_->CacheResult(key_, net_error, list, ttl);
     }
 
@@ -1482,6 +1589,9 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
   // True if resolver had DnsConfig when the Job was started.
   bool had_dns_config_;
 
+  // True if this Job was started to refresh a cache entry.
+  bool is_refresh_;
+
   BoundNetLog net_log_;
 
   // Resolves the host using a HostResolverProc.
@@ -1519,6 +1629,7 @@ HostResolverImpl::HostResolverImpl(
     : cache_(cache),
       dispatcher_(job_limits),
       max_queued_jobs_(job_limits.total_jobs * 100u),
+      refresh_hot_entries_(false),
       proc_params_(proc_params),
       default_address_family_(ADDRESS_FAMILY_UNSPECIFIED),
       dns_client_(NULL),
@@ -1595,7 +1706,7 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
   // outstanding jobs map.
   Key key = GetEffectiveKeyForRequest(info);
 
-  int rv = ResolveHelper(key, info, addresses, request_net_log);
+  int rv = ResolveHelper(key, info, addresses, true, request_net_log);
   if (rv != ERR_DNS_CACHE_MISS) {
     LogFinishRequest(source_net_log, request_net_log, info, rv);
     return rv;
@@ -1644,6 +1755,7 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
 int HostResolverImpl::ResolveHelper(const Key& key,
                                     const RequestInfo& info,
                                     AddressList* addresses,
+                                    bool allow_refresh,
                                     const BoundNetLog& request_net_log) {
   // The result of |getaddrinfo| for empty hosts is inconsistent across systems.
   // On Windows it gives the default interface's address, whereas on Linux it
@@ -1654,7 +1766,8 @@ int HostResolverImpl::ResolveHelper(const Key& key,
   int net_error = ERR_UNEXPECTED;
   if (ResolveAsIP(key, info, &net_error, addresses))
     return net_error;
-  if (ServeFromCache(key, info, &net_error, addresses)) {
+  if (ServeFromCache(key, info, &net_error, addresses, allow_refresh,
+                     request_net_log)) {
     request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_HIT, NULL);
     return net_error;
   }
@@ -1682,7 +1795,7 @@ int HostResolverImpl::ResolveFromCache(const RequestInfo& info,
 
   Key key = GetEffectiveKeyForRequest(info);
 
-  int rv = ResolveHelper(key, info, addresses, request_net_log);
+  int rv = ResolveHelper(key, info, addresses, false, request_net_log);
   LogFinishRequest(source_net_log, request_net_log, info, rv);
   return rv;
 }
@@ -1748,20 +1861,26 @@ bool HostResolverImpl::ResolveAsIP(const Key& key,
 bool HostResolverImpl::ServeFromCache(const Key& key,
                                       const RequestInfo& info,
                                       int* net_error,
-                                      AddressList* addresses) {
+                                      AddressList* addresses,
+                                      bool allow_refresh,
+                                      const BoundNetLog& request_net_log) {
   DCHECK(addresses);
   DCHECK(net_error);
   if (!info.allow_cached_response() || !cache_.get())
     return false;
 
-  const HostCache::Entry* cache_entry = cache_->Lookup(
-      key, base::TimeTicks::Now());
+  base::TimeTicks now = base::TimeTicks::Now();
+  const HostCache::Entry* cache_entry = cache_->LookupStale(
+      key, now, allow_refresh ? max_cache_staleness_ : base::TimeDelta());
   if (!cache_entry)
     return false;
 
   *net_error = cache_entry->error;
   if (*net_error == OK)
     *addresses = CreateAddressListUsingPort(cache_entry->addrlist, info.port());
+
+  if (allow_refresh && ShouldRefreshEntry(*cache_entry, now))
+    StartRefreshJob(key, request_net_log);
   return true;
 }
 
@@ -1806,6 +1925,29 @@ void HostResolverImpl::CacheResult(const Key& key,
     cache_->Set(key, net_error, addr_list, base::TimeTicks::Now(), ttl);
 }
 
+bool HostResolverImpl::ShouldRefreshEntry(const HostCache::Entry& entry,
+                                          base::TimeTicks now) const {
+  if (!entry.IsValid(now))
+    return true;
+  if (!refresh_hot_entries_ || entry.error != OK ||
+      entry.hit_count < kRefreshMinHits) {
+    return false;
+  }
+  return entry.expiration - now < entry.ttl / kRefreshTTLDivisor;
+}
+
+void HostResolverImpl::StartRefreshJob(const Key& key,
+                                       const BoundNetLog& request_net_log) {
+  // Never evict real work from the queue to make room for a refresh.
+  if (jobs_.count(key) || dispatcher_.num_queued_jobs() >= max_queued_jobs_)
+    return;
+
+  Job* job = new Job(this, key, request_net_log);
+  job->set_is_refresh();
+  job->Schedule(IDLE);
+  jobs_.insert(std::make_pair(key, job));
+}
+
 void HostResolverImpl::RemoveJob(Job* job) {
   DCHECK(job);
   JobMap::iterator it = jobs_.find(job->key());
@@ -1896,6 +2038,8 @@ void HostResolverImpl::TryServingAllJobsFromHosts() {
 void HostResolverImpl::OnIPAddressChanged() {
   if (cache_.get())
     cache_->clear();
+  if (dns_client_.get())
+    dns_client_->ClearCache();
   if (ipv6_probe_monitoring_) {
     DiscardIPv6ProbeJob();
     ipv6_probe_job_ = new IPv6ProbeJob(this);
@@ -129,6 +129,22 @@ class NET_EXPORT HostResolverImpl
   // Only allowed when the queue is empty.
   void SetMaxQueuedJobs(size_t value);
 
+  // Allows successful cache entries to be served by Resolve() for up to
+  // |max_staleness| after they expire. Serving a stale entry starts a Job in
+  // the background to refresh it. ResolveFromCache() never serves expired
+  // entries, since it cannot start Jobs. Zero (the default) never serves
+  // expired entries.
+  void set_max_cache_staleness(base::TimeDelta max_staleness) {
+    max_cache_staleness_ = max_staleness;
+  }
+
+  // If true, an entry which keeps being served from the cache is re-resolved
+  // by Resolve() in the background shortly before it expires, so that its
+  // users don't stall on a cache miss. Off by default.
+  void set_refresh_hot_entries(bool refresh_hot_entries) {
+    refresh_hot_entries_ = refresh_hot_entries;
+  }
+
   // HostResolver methods:
   virtual int Resolve(const RequestInfo& info,
                       AddressList* addresses,
@@ -152,7 +168,12 @@ class NET_EXPORT HostResolverImpl
   FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest,
                            AbortOnlyExistingRequestsOnIPAddressChange);
   FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest, DnsTask);
+  FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest, DnsTaskBothFamilies);
   FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest, ServeFromHosts);
+  FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest, ServeStaleFromCache);
+  FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest,
+                           CacheFailedRefreshWithRequests);
+  FRIEND_TEST_ALL_PREFIXES(HostResolverImplTest, RefreshHotEntries);
   class Job;
   class ProcTask;
   class IPv6ProbeJob;
@@ -170,9 +191,11 @@ class NET_EXPORT HostResolverImpl
   // literal, cache and HOSTS lookup (if enabled), returns OK if successful,
   // ERR_NAME_NOT_RESOLVED if either hostname is invalid or IP literal is
   // incompatible, ERR_DNS_CACHE_MISS if entry was not found in cache and HOSTS.
+  // |allow_refresh| is passed on to ServeFromCache().
   int ResolveHelper(const Key& key,
                     const RequestInfo& info,
                     AddressList* addresses,
+                    bool allow_refresh,
                     const BoundNetLog& request_net_log);
 
   // Tries to resolve |key| as an IP, returns true and sets |net_error| if
@@ -184,11 +207,16 @@ class NET_EXPORT HostResolverImpl
 
   // If |key| is not found in cache returns false, otherwise returns
   // true, sets |net_error| to the cached error code and fills |addresses|
-  // if it is a positive entry.
+  // if it is a positive entry. Only if |allow_refresh|, which is the case for
+  // |Resolve()| but not for |ResolveFromCache()|, stale entries are served
+  // and a refresh Job is started if the entry served is stale or about to
+  // expire.
   bool ServeFromCache(const Key& key,
                       const RequestInfo& info,
                       int* net_error,
-                      AddressList* addresses);
+                      AddressList* addresses,
+                      bool allow_refresh,
+                      const BoundNetLog& request_net_log);
 
   // If |key| is not found in the HOSTS file or no HOSTS file known, returns
   // false, otherwise returns true and fills |addresses|.
@@ -213,6 +241,15 @@ class NET_EXPORT HostResolverImpl
                    const AddressList& addr_list,
                    base::TimeDelta ttl);
 
+  // Returns true if |entry|, just served from the cache at time |now|, should
+  // be re-resolved in the background.
+  bool ShouldRefreshEntry(const HostCache::Entry& entry,
+                          base::TimeTicks now) const;
+
+  // Starts a low priority Job to re-resolve |key| and update the cache,
+  // unless one is already running or the queue is full.
+  void StartRefreshJob(const Key& key, const BoundNetLog& request_net_log);
+
   // Removes |job| from |jobs_|, only if it exists.
   void RemoveJob(Job* job);
 
@@ -252,6 +289,12 @@ class NET_EXPORT HostResolverImpl
   // Limit on the maximum number of jobs queued in |dispatcher_|.
   size_t max_queued_jobs_;
 
+  // How long past expiration a successful cache entry may still be served.
+  base::TimeDelta max_cache_staleness_;
+
+  // True if hot cache entries are re-resolved before they expire.
+  bool refresh_hot_entries_;
+
   // Parameters for ProcTask.
   ProcTaskParams proc_params_;
 
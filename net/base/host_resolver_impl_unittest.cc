@@ -1857,6 +1857,40 @@ TEST_F(HostResolverImplTest, DnsTask) {
   EXPECT_EQ("192.168.1.102:80", FirstAddressToString(req6.addrlist()));
 }
 
+// Test that HostResolverImpl::DnsTask merges the results of its A and AAAA
+// transactions for ADDRESS_FAMILY_UNSPECIFIED.
+TEST_F(HostResolverImplTest, DnsTaskBothFamilies) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  scoped_ptr<HostResolverImpl> host_resolver(CreateHostResolverImpl(
+      resolver_proc));
+
+  resolver_proc->AddSimulatedFailure("*");
+
+  host_resolver->set_dns_client_for_tests(
+      CreateMockDnsClient(CreateValidDnsConfig()));
+
+  CountingDelegate delegate;
+
+  // Both transactions succeed.
+  ResolveRequest req1(host_resolver.get(), "ok_both", 80, &delegate);
+  // Only the A transaction succeeds.
+  ResolveRequest req2(host_resolver.get(), "v4_only", 80, &delegate);
+  // Only the AAAA transaction is started, and it fails.
+  HostResolver::RequestInfo info(HostPortPair("v4_only", 80));
+  info.set_address_family(ADDRESS_FAMILY_IPV6);
+  ResolveRequest req3(host_resolver.get(), info, &delegate);
+
+  delegate.WaitForCompletions(3);
+  EXPECT_EQ(OK, req1.result());
+  EXPECT_EQ("127.0.0.1:80", FirstAddressToString(req1.addrlist()));
+  EXPECT_EQ(2u, NumberOfAddresses(req1.addrlist()));
+  EXPECT_EQ(OK, req2.result());
+  EXPECT_EQ("127.0.0.1:80", FirstAddressToString(req2.addrlist()));
+  EXPECT_EQ(1u, NumberOfAddresses(req2.addrlist()));
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, req3.result());
+}
+
 TEST_F(HostResolverImplTest, ServeFromHosts) {
   scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
       new RuleBasedHostResolverProc(NULL));
@@ -1935,4 +1969,165 @@ TEST_F(HostResolverImplTest, ServeFromHosts) {
   EXPECT_EQ("127.0.0.1:80", FirstAddressToString(req7.addrlist()));
 }
 
+// Helper to create an AddressList holding the single IP literal |ip|.
+AddressList CreateAddressList(const std::string& ip) {
+  IPAddressNumber ip_number;
+  EXPECT_TRUE(ParseIPLiteralToNumber(ip, &ip_number));
+  return AddressList::CreateFromIPAddress(ip_number, 0);
+}
+
+TEST_F(HostResolverImplTest, ServeStaleFromCache) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddRule("just.testing", "192.168.1.42");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+
+  // Plant an entry which expired a minute ago.
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  HostCache::Key key = host_resolver->GetEffectiveKeyForRequest(info);
+  host_resolver->GetHostCache()->Set(
+      key, OK, CreateAddressList("192.168.1.1"),
+      TimeTicks::Now() - TimeDelta::FromMinutes(2), TimeDelta::FromMinutes(1));
+
+  // By default stale entries are not served.
+  AddressList addrlist;
+  EXPECT_EQ(ERR_DNS_CACHE_MISS,
+            host_resolver->ResolveFromCache(info, &addrlist, BoundNetLog()));
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+
+  // Even once allowed, ResolveFromCache() only serves fresh entries, and never
+  // starts a Job.
+  host_resolver->set_max_cache_staleness(TimeDelta::FromMinutes(5));
+  EXPECT_EQ(ERR_DNS_CACHE_MISS,
+            host_resolver->ResolveFromCache(info, &addrlist, BoundNetLog()));
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+
+  // Resolve() serves the stale entry and refreshes it in the background.
+  TestCompletionCallback callback;
+  EXPECT_EQ(OK,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ("192.168.1.1:80", FirstAddressToString(addrlist));
+  EXPECT_EQ(1u, host_resolver->jobs_.size());
+
+  // Further hits don't start another refresh.
+  EXPECT_EQ(OK,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ(1u, host_resolver->jobs_.size());
+
+  // A request which bypasses the cache joins the refresh.
+  info.set_allow_cached_response(false);
+  EXPECT_EQ(ERR_IO_PENDING,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ(1u, host_resolver->jobs_.size());
+  EXPECT_EQ(OK, callback.WaitForResult());
+  EXPECT_EQ("192.168.1.42:80", FirstAddressToString(addrlist));
+
+  // The refreshed entry is now fresh.
+  info.set_allow_cached_response(true);
+  EXPECT_EQ(OK,
+            host_resolver->ResolveFromCache(info, &addrlist, BoundNetLog()));
+  EXPECT_EQ("192.168.1.42:80", FirstAddressToString(addrlist));
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+}
+
+// A refresh which fails while a Request is attached to it caches the failure,
+// like any other Job, so the stale entry is no longer served.
+TEST_F(HostResolverImplTest, CacheFailedRefreshWithRequests) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddSimulatedFailure("just.testing");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+  host_resolver->set_max_cache_staleness(TimeDelta::FromMinutes(5));
+
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  HostCache::Key key = host_resolver->GetEffectiveKeyForRequest(info);
+  host_resolver->GetHostCache()->Set(
+      key, OK, CreateAddressList("192.168.1.1"),
+      TimeTicks::Now() - TimeDelta::FromMinutes(2), TimeDelta::FromMinutes(1));
+
+  AddressList addrlist;
+  TestCompletionCallback callback;
+  EXPECT_EQ(OK,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ(1u, host_resolver->jobs_.size());
+
+  info.set_allow_cached_response(false);
+  EXPECT_EQ(ERR_IO_PENDING,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, callback.WaitForResult());
+
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+  EXPECT_FALSE(host_resolver->GetHostCache()->LookupStale(
+      key, TimeTicks::Now(), TimeDelta::FromMinutes(5)));
+}
+
+TEST_F(HostResolverImplTest, RefreshHotEntries) {
+  scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+      new RuleBasedHostResolverProc(NULL));
+  resolver_proc->AddRule("just.testing", "192.168.1.42");
+
+  scoped_ptr<HostResolverImpl> host_resolver(
+      CreateHostResolverImpl(resolver_proc));
+  host_resolver->set_refresh_hot_entries(true);
+
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 80));
+  HostCache::Key key = host_resolver->GetEffectiveKeyForRequest(info);
+  HostCache* cache = host_resolver->GetHostCache();
+  AddressList addrlist;
+  TestCompletionCallback callback;
+
+  // A hot entry far from expiring is left alone.
+  cache->Set(key, OK, CreateAddressList("192.168.1.1"), TimeTicks::Now(),
+             TimeDelta::FromMinutes(1));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(OK,
+              host_resolver->Resolve(info, &addrlist, callback.callback(),
+                                     NULL, BoundNetLog()));
+  }
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+
+  // An entry about to expire is refreshed only once it has been used enough,
+  // and only by Resolve().
+  cache->Set(key, OK, CreateAddressList("192.168.1.1"),
+             TimeTicks::Now() - TimeDelta::FromSeconds(55),
+             TimeDelta::FromMinutes(1));
+  EXPECT_EQ(OK,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ(OK,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+  EXPECT_EQ(OK,
+            host_resolver->ResolveFromCache(info, &addrlist, BoundNetLog()));
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+  EXPECT_EQ(OK,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ("192.168.1.1:80", FirstAddressToString(addrlist));
+  EXPECT_EQ(1u, host_resolver->jobs_.size());
+
+  // Wait for the refresh by joining it.
+  info.set_allow_cached_response(false);
+  EXPECT_EQ(ERR_IO_PENDING,
+            host_resolver->Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  EXPECT_EQ(OK, callback.WaitForResult());
+
+  info.set_allow_cached_response(true);
+  EXPECT_EQ(OK,
+            host_resolver->ResolveFromCache(info, &addrlist, BoundNetLog()));
+  EXPECT_EQ("192.168.1.42:80", FirstAddressToString(addrlist));
+  EXPECT_TRUE(host_resolver->jobs_.empty());
+}
+
 }  // namespace net
@@ -0,0 +1,170 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "net/base/address_list.h"
+#include "net/base/host_cache.h"
+#include "net/base/host_resolver_impl.h"
+#include "net/base/mock_host_resolver.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/net_util.h"
+#include "net/base/test_completion_callback.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumHosts = 1000;
+const int kNumLookups = 200000;
+
+// Latency of the host resolver procedure behind HostResolverImpl.
+const int kResolveLatencyMs = 20;
+const int kNumSlowResolves = 20;
+
+std::string HostName(int i) {
+  return base::StringPrintf("host%d.example.com", i);
+}
+
+// Requests sent to HostResolverImpl ask for loopback addresses only, so that
+// their cache keys don't depend on the network setup of the machine running
+// the test.
+HostResolver::RequestInfo SlowRequestInfo(int i) {
+  HostResolver::RequestInfo info(HostPortPair(HostName(i), 80));
+  info.set_host_resolver_flags(HOST_RESOLVER_LOOPBACK_ONLY);
+  return info;
+}
+
+class HostResolverPerfTest : public testing::Test {
+ public:
+  HostResolverPerfTest() : message_loop_(new MessageLoopForIO()) {}
+
+ protected:
+  // Returns a HostResolverImpl whose lookups all take kResolveLatencyMs.
+  HostResolverImpl* CreateSlowResolver() {
+    scoped_refptr<RuleBasedHostResolverProc> resolver_proc(
+        new RuleBasedHostResolverProc(NULL));
+    resolver_proc->AddRuleWithLatency("*", "127.0.0.1", kResolveLatencyMs);
+    return new HostResolverImpl(
+        HostCache::CreateDefaultCache(),
+        PrioritizedDispatcher::Limits(NUM_PRIORITIES, 8),
+        HostResolverImpl::ProcTaskParams(resolver_proc, 0),
+        scoped_ptr<DnsConfigService>(NULL),
+        NULL);
+  }
+
+  // Fills the cache of |resolver| with entries for kNumSlowResolves hosts,
+  // all of which expired a second ago.
+  void AddExpiredEntries(HostResolverImpl* resolver) {
+    IPAddressNumber ip_number;
+    ASSERT_TRUE(ParseIPLiteralToNumber("127.0.0.1", &ip_number));
+    AddressList addrlist = AddressList::CreateFromIPAddress(ip_number, 0);
+    base::TimeTicks now = base::TimeTicks::Now();
+    for (int i = 0; i < kNumSlowResolves; ++i) {
+      resolver->GetHostCache()->Set(
+          HostCache::Key(HostName(i), ADDRESS_FAMILY_UNSPECIFIED,
+                         HOST_RESOLVER_LOOPBACK_ONLY),
+          OK, addrlist, now - base::TimeDelta::FromSeconds(61),
+          base::TimeDelta::FromSeconds(60));
+    }
+  }
+
+  // Logs the average time it takes |resolver| to answer for each of the
+  // hosts added by AddExpiredEntries().
+  void TimeExpiredResolves(const char* name, HostResolver* resolver) {
+    PerfTimeLogger timer(name);
+    for (int i = 0; i < kNumSlowResolves; ++i) {
+      AddressList addrlist;
+      TestCompletionCallback callback;
+      int rv = resolver->Resolve(SlowRequestInfo(i), &addrlist,
+                                 callback.callback(), NULL, BoundNetLog());
+      EXPECT_EQ(OK, callback.GetResult(rv));
+    }
+    timer.Done();
+  }
+
+ private:
+  scoped_ptr<MessageLoop> message_loop_;
+};
+
+}  // namespace
+
+TEST_F(HostResolverPerfTest, CacheLookups) {
+  HostCache cache(kNumHosts);
+  std::vector<HostCache::Key> keys;
+  base::TimeTicks now = base::TimeTicks::Now();
+  for (int i = 0; i < kNumHosts; ++i) {
+    keys.push_back(HostCache::Key(HostName(i), ADDRESS_FAMILY_UNSPECIFIED, 0));
+    cache.Set(keys.back(), OK, AddressList(), now,
+              base::TimeDelta::FromSeconds(60));
+  }
+
+  PerfTimeLogger timer("HostCache_Lookup");
+  for (int i = 0; i < kNumLookups; ++i)
+    EXPECT_TRUE(cache.Lookup(keys[(i * 7919) % kNumHosts], now));
+  timer.Done();
+}
+
+TEST_F(HostResolverPerfTest, CacheChurn) {
+  // Ten times as many names as fit in the cache, so that every Set() evicts.
+  HostCache cache(kNumHosts / 10);
+  std::vector<HostCache::Key> keys;
+  for (int i = 0; i < kNumHosts; ++i)
+    keys.push_back(HostCache::Key(HostName(i), ADDRESS_FAMILY_UNSPECIFIED, 0));
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  PerfTimeLogger timer("HostCache_SetWithEviction");
+  for (int i = 0; i < kNumLookups; ++i) {
+    cache.Set(keys[(i * 7919) % kNumHosts], OK, AddressList(), now,
+              base::TimeDelta::FromSeconds(60));
+  }
+  timer.Done();
+}
+
+TEST_F(HostResolverPerfTest, MockCachingResolverHits) {
+  MockCachingHostResolver resolver;
+  resolver.set_synchronous_mode(true);
+
+  // Warm the cache.
+  for (int i = 0; i < kNumSlowResolves; ++i) {
+    HostResolver::RequestInfo info(HostPortPair(HostName(i), 80));
+    AddressList addrlist;
+    TestCompletionCallback callback;
+    EXPECT_EQ(OK, resolver.Resolve(info, &addrlist, callback.callback(), NULL,
+                                   BoundNetLog()));
+  }
+
+  PerfTimeLogger timer("MockCachingHostResolver_CacheHit");
+  for (int i = 0; i < kNumLookups; ++i) {
+    HostResolver::RequestInfo info(
+        HostPortPair(HostName(i % kNumSlowResolves), 80));
+    AddressList addrlist;
+    EXPECT_EQ(OK, resolver.ResolveFromCache(info, &addrlist, BoundNetLog()));
+  }
+  timer.Done();
+}
+
+TEST_F(HostResolverPerfTest, ExpiredEntries) {
+  // Every lookup waits on the resolver procedure.
+  scoped_ptr<HostResolverImpl> resolver(CreateSlowResolver());
+  AddExpiredEntries(resolver.get());
+  TimeExpiredResolves("HostResolverImpl_Expired", resolver.get());
+
+  // Every lookup is answered from the cache, and refreshed in the background.
+  resolver.reset(CreateSlowResolver());
+  resolver->set_max_cache_staleness(base::TimeDelta::FromMinutes(5));
+  AddExpiredEntries(resolver.get());
+  TimeExpiredResolves("HostResolverImpl_ServeStale", resolver.get());
+}
+
+}  // namespace net
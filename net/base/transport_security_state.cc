@@ -19,13 +19,16 @@
 #include <utility>
 
 #include "base/base64.h"
+#include "base/hash_tables.h"
 #include "base/json/json_reader.h"
 #include "base/json/json_writer.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/histogram.h"
 #include "base/sha1.h"
 #include "base/string_number_conversions.h"
+#include "base/string_piece.h"
 #include "base/string_tokenizer.h"
 #include "base/string_util.h"
 #include "base/time.h"
@@ -158,6 +161,9 @@ bool TransportSecurityState::HasMetadata(DomainState* result,
       return true;
     }
 
+    if (enabled_hosts_.empty())
+      continue;
+
     std::map<std::string, DomainState>::iterator j =
         enabled_hosts_.find(HashHost(host_sub_chunk));
     if (j == enabled_hosts_.end())
@@ -1111,41 +1117,14 @@ struct HSTSPreload {
   SecondLevelDomainName second_level_domain_name;
 };
 
-static bool HasPreload(const struct HSTSPreload* entries, size_t num_entries,
-                       const std::string& canonicalized_host, size_t i,
-                       TransportSecurityState::DomainState* out, bool* ret) {
-  for (size_t j = 0; j < num_entries; j++) {
-    if (entries[j].length == canonicalized_host.size() - i &&
-        memcmp(entries[j].dns_name, &canonicalized_host[i],
-               entries[j].length) == 0) {
-      if (!entries[j].include_subdomains && i != 0) {
-        *ret = false;
-      } else {
-        out->include_subdomains = entries[j].include_subdomains;
-        *ret = true;
-        if (!entries[j].https_required)
-          out->mode = TransportSecurityState::DomainState::MODE_PINNING_ONLY;
-        if (entries[j].pins.required_hashes) {
-          const char* const* hash = entries[j].pins.required_hashes;
-          while (*hash) {
-            bool ok = AddHash(*hash, &out->preloaded_spki_hashes);
-            DCHECK(ok) << " failed to parse " << *hash;
-            hash++;
-          }
-        }
-        if (entries[j].pins.excluded_hashes) {
-          const char* const* hash = entries[j].pins.excluded_hashes;
-          while (*hash) {
-            bool ok = AddHash(*hash, &out->bad_preloaded_spki_hashes);
-            DCHECK(ok) << " failed to parse " << *hash;
-            hash++;
-          }
-        }
-      }
-      return true;
-    }
+// Parses a NULL-terminated list of pins, as found in PublicKeyPins.
+static void AddHashes(const char* const* hashes, FingerprintVector* out) {
+  if (!hashes)
+    return;
+  for (; *hashes; hashes++) {
+    bool ok = AddHash(*hashes, out);
+    DCHECK(ok) << " failed to parse " << *hashes;
   }
-  return false;
 }
 
 // kNoRejectedPublicKeys is a placeholder for when no public keys are rejected.
@@ -1492,6 +1471,81 @@ static const struct HSTSPreload kPreloadedSNISTS[] = {
 };
 static const size_t kNumPreloadedSNISTS = ARRAYSIZE_UNSAFE(kPreloadedSNISTS);
 
+// A preload entry together with its pins, parsed once up front.
+struct IndexedPreload {
+  const struct HSTSPreload* entry;
+  FingerprintVector required_hashes;
+  FingerprintVector excluded_hashes;
+};
+
+// PreloadIndex maps the DNS-form names of a preload list to their entries, so
+// that each label suffix of a host costs one hash lookup rather than a scan
+// of the whole list. The keys point into the static |dns_name| arrays. If a
+// name is listed twice, the first entry wins, as it did with the linear scan.
+class PreloadIndex {
+ public:
+  PreloadIndex(const struct HSTSPreload* entries, size_t num_entries) {
+    for (size_t i = 0; i < num_entries; i++) {
+      const struct HSTSPreload* entry = entries + i;
+      base::StringPiece name(entry->dns_name, entry->length);
+      if (index_.find(name) != index_.end())
+        continue;
+      IndexedPreload& indexed = index_[name];
+      indexed.entry = entry;
+      AddHashes(entry->pins.required_hashes, &indexed.required_hashes);
+      AddHashes(entry->pins.excluded_hashes, &indexed.excluded_hashes);
+    }
+  }
+
+  // Returns the entry whose name is exactly the suffix of
+  // |canonicalized_host| starting at offset |i|, or NULL if there is none.
+  const IndexedPreload* Find(const std::string& canonicalized_host,
+                             size_t i) const {
+    Index::const_iterator it = index_.find(base::StringPiece(
+        canonicalized_host.data() + i, canonicalized_host.size() - i));
+    return it == index_.end() ? NULL : &it->second;
+  }
+
+ private:
+  typedef base::hash_map<base::StringPiece, IndexedPreload> Index;
+  Index index_;
+};
+
+// Fills in |out| from |preload|, which matched the suffix of the
+// canonicalized host starting at offset |i|. Returns false if the entry does
+// not apply because it matched a parent domain but excludes subdomains.
+static bool ApplyPreload(const IndexedPreload& preload, size_t i,
+                         TransportSecurityState::DomainState* out) {
+  const struct HSTSPreload* entry = preload.entry;
+  if (!entry->include_subdomains && i != 0)
+    return false;
+
+  out->include_subdomains = entry->include_subdomains;
+  if (!entry->https_required)
+    out->mode = TransportSecurityState::DomainState::MODE_PINNING_ONLY;
+  out->preloaded_spki_hashes.insert(out->preloaded_spki_hashes.end(),
+                                    preload.required_hashes.begin(),
+                                    preload.required_hashes.end());
+  out->bad_preloaded_spki_hashes.insert(out->bad_preloaded_spki_hashes.end(),
+                                        preload.excluded_hashes.begin(),
+                                        preload.excluded_hashes.end());
+  return true;
+}
+
+// The indexes are built on first use and are read-only afterwards.
+struct PreloadIndexes {
+  PreloadIndexes()
+      : sts(kPreloadedSTS, kNumPreloadedSTS),
+        sni_sts(kPreloadedSNISTS, kNumPreloadedSNISTS) {
+  }
+
+  const PreloadIndex sts;
+  const PreloadIndex sni_sts;
+};
+
+static base::LazyInstance<PreloadIndexes>::Leaky g_preload_indexes =
+    LAZY_INSTANCE_INITIALIZER;
+
 // Returns the HSTSPreload entry for the |canonicalized_host| in |entries|,
 // or NULL if there is none. Prefers exact hostname matches to those that
 // match only because HSTSPreload.include_subdomains is true.
@@ -1500,20 +1554,11 @@ static const size_t kNumPreloadedSNISTS = ARRAYSIZE_UNSAFE(kPreloadedSNISTS);
 // CanonicalizeHost.
 static const struct HSTSPreload* GetHSTSPreload(
     const std::string& canonicalized_host,
-    const struct HSTSPreload* entries,
-    size_t num_entries) {
+    const PreloadIndex& index) {
   for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
-    for (size_t j = 0; j < num_entries; j++) {
-      const struct HSTSPreload* entry = entries + j;
-
-      if (i != 0 && !entry->include_subdomains)
-        continue;
-
-      if (entry->length == canonicalized_host.size() - i &&
-          memcmp(entry->dns_name, &canonicalized_host[i], entry->length) == 0) {
-        return entry;
-      }
-    }
+    const IndexedPreload* preload = index.Find(canonicalized_host, i);
+    if (preload && (i == 0 || preload->entry->include_subdomains))
+      return preload->entry;
   }
 
   return NULL;
@@ -1523,15 +1568,15 @@ static const struct HSTSPreload* GetHSTSPreload(
 bool TransportSecurityState::IsGooglePinnedProperty(const std::string& host,
                                                     bool sni_available) {
   std::string canonicalized_host = CanonicalizeHost(host);
+  const PreloadIndexes& indexes = g_preload_indexes.Get();
   const struct HSTSPreload* entry =
-      GetHSTSPreload(canonicalized_host, kPreloadedSTS, kNumPreloadedSTS);
+      GetHSTSPreload(canonicalized_host, indexes.sts);
 
   if (entry && entry->pins.required_hashes == kGoogleAcceptableCerts)
     return true;
 
   if (sni_available) {
-    entry = GetHSTSPreload(canonicalized_host, kPreloadedSNISTS,
-                           kNumPreloadedSNISTS);
+    entry = GetHSTSPreload(canonicalized_host, indexes.sni_sts);
     if (entry && entry->pins.required_hashes == kGoogleAcceptableCerts)
       return true;
   }
@@ -1543,13 +1588,12 @@ bool TransportSecurityState::IsGooglePinnedProperty(const std::string& host,
 void TransportSecurityState::ReportUMAOnPinFailure(const std::string& host) {
   std::string canonicalized_host = CanonicalizeHost(host);
 
+  const PreloadIndexes& indexes = g_preload_indexes.Get();
   const struct HSTSPreload* entry =
-      GetHSTSPreload(canonicalized_host, kPreloadedSTS, kNumPreloadedSTS);
+      GetHSTSPreload(canonicalized_host, indexes.sts);
 
-  if (!entry) {
-    entry = GetHSTSPreload(canonicalized_host, kPreloadedSNISTS,
-                           kNumPreloadedSNISTS);
-  }
+  if (!entry)
+    entry = GetHSTSPreload(canonicalized_host, indexes.sni_sts);
 
   DCHECK(entry);
   DCHECK(entry->pins.required_hashes);
@@ -1571,27 +1615,27 @@ bool TransportSecurityState::IsPreloadedSTS(
   out->mode = DomainState::MODE_STRICT;
   out->include_subdomains = false;
 
+  const PreloadIndexes& indexes = g_preload_indexes.Get();
   for (size_t i = 0; canonicalized_host[i]; i += canonicalized_host[i] + 1) {
     std::string host_sub_chunk(&canonicalized_host[i],
                                canonicalized_host.size() - i);
     out->domain = DNSDomainToString(host_sub_chunk);
-    std::string hashed_host(HashHost(host_sub_chunk));
-    if (forced_hosts_.find(hashed_host) != forced_hosts_.end()) {
-      *out = forced_hosts_[hashed_host];
-      out->domain = DNSDomainToString(host_sub_chunk);
-      out->preloaded = true;
-      return true;
-    }
-    bool ret;
-    if (HasPreload(kPreloadedSTS, kNumPreloadedSTS, canonicalized_host, i, out,
-                   &ret)) {
-      return ret;
-    }
-    if (sni_available &&
-        HasPreload(kPreloadedSNISTS, kNumPreloadedSNISTS, canonicalized_host, i,
-                   out, &ret)) {
-      return ret;
+    // Hashing the name is comparatively expensive, so skip it when there is
+    // nothing to look up.
+    if (!forced_hosts_.empty()) {
+      std::string hashed_host(HashHost(host_sub_chunk));
+      if (forced_hosts_.find(hashed_host) != forced_hosts_.end()) {
+        *out = forced_hosts_[hashed_host];
+        out->domain = DNSDomainToString(host_sub_chunk);
+        out->preloaded = true;
+        return true;
+      }
     }
+    const IndexedPreload* preload = indexes.sts.Find(canonicalized_host, i);
+    if (!preload && sni_available)
+      preload = indexes.sni_sts.Find(canonicalized_host, i);
+    if (preload)
+      return ApplyPreload(*preload, i, out);
   }
 
   return false;
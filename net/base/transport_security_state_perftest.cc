@@ -0,0 +1,95 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/perftimer.h"
+#include "base/time.h"
+#include "net/base/transport_security_state.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumIterations = 20000;
+
+// A mix of hosts that hit the preload lists exactly, hit them through a
+// parent domain, and miss them entirely. The misses are the common case on
+// the web and have to try every label suffix.
+const char* const kHosts[] = {
+  "www.paypal.com",
+  "chrome.google.com",
+  "foo.bar.chrome.google.com",
+  "mail.google.com",
+  "www.gmail.com",
+  "api.twitter.com",
+  "a.learn.doubleclick.net",
+  "www.example.com",
+  "images.static.example.co.uk",
+  "a.b.c.d.e.f.g.example.org",
+  "localhost",
+  "cdn1.media.news.example.net",
+};
+
+class TransportSecurityStatePerfTest : public testing::Test {
+ protected:
+  // Logs the average cost of one call to |lookup| for each of kHosts.
+  template <typename Lookup>
+  void TimeLookups(const char* name, Lookup lookup) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumIterations; ++i) {
+      for (size_t j = 0; j < arraysize(kHosts); ++j)
+        lookup(kHosts[j]);
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    LogPerfResult(name,
+                  elapsed.InMicroseconds() * 1000.0 /
+                      (kNumIterations * arraysize(kHosts)),
+                  "ns/host");
+  }
+};
+
+struct GetDomainState {
+  explicit GetDomainState(TransportSecurityState* state) : state_(state) {}
+  void operator()(const char* host) {
+    TransportSecurityState::DomainState domain_state;
+    state_->GetDomainState(&domain_state, host, true);
+  }
+  TransportSecurityState* state_;
+};
+
+struct HasPinsForHost {
+  explicit HasPinsForHost(TransportSecurityState* state) : state_(state) {}
+  void operator()(const char* host) {
+    TransportSecurityState::DomainState domain_state;
+    state_->HasPinsForHost(&domain_state, host, true);
+  }
+  TransportSecurityState* state_;
+};
+
+void IsGooglePinnedProperty(const char* host) {
+  TransportSecurityState::IsGooglePinnedProperty(host, true);
+}
+
+}  // namespace
+
+TEST_F(TransportSecurityStatePerfTest, PreloadLookups) {
+  TransportSecurityState state("");
+
+  // Sanity check that the hosts exercise both hits and misses.
+  TransportSecurityState::DomainState domain_state;
+  EXPECT_TRUE(state.GetDomainState(&domain_state, "www.paypal.com", true));
+  EXPECT_FALSE(state.GetDomainState(&domain_state, "www.example.com", true));
+
+  TimeLookups("TransportSecurityState_GetDomainState",
+              GetDomainState(&state));
+  TimeLookups("TransportSecurityState_HasPinsForHost",
+              HasPinsForHost(&state));
+  TimeLookups("TransportSecurityState_IsGooglePinnedProperty",
+              IsGooglePinnedProperty);
+}
+
+}  // namespace net
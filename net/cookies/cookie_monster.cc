@@ -100,6 +100,17 @@ const size_t CookieMonster::kMaxCookies                 = 3300;
 const size_t CookieMonster::kPurgeCookies               = 300;
 const int CookieMonster::kSafeFromGlobalPurgeDays       = 30;
 
+// Mozilla sorts on the path length (longest first), and then it
+// sorts by creation time (oldest first).
+// The RFC says the sort order for the domain attribute is undefined.
+bool CookieMonster::CookieSendOrder::operator()(
+    const CanonicalCookie* cc1,
+    const CanonicalCookie* cc2) const {
+  if (cc1->Path().length() == cc2->Path().length())
+    return cc1->CreationDate() < cc2->CreationDate();
+  return cc1->Path().length() > cc2->Path().length();
+}
+
 namespace {
 
 typedef std::vector<CookieMonster::CanonicalCookie*> CanonicalCookieVector;
@@ -111,9 +122,9 @@ const int kDefaultAccessUpdateThresholdSeconds = 60;
 // Comparator to sort cookies from highest creation date to lowest
 // creation date.
 struct OrderByCreationTimeDesc {
-  bool operator()(const CookieMonster::CookieMap::iterator& a,
-                  const CookieMonster::CookieMap::iterator& b) const {
-    return a->second->CreationDate() > b->second->CreationDate();
+  bool operator()(const CookieMonster::CookieShard::iterator& a,
+                  const CookieMonster::CookieShard::iterator& b) const {
+    return (*a)->CreationDate() > (*b)->CreationDate();
   }
 };
 
@@ -128,26 +139,19 @@ const int kVlogGetCookies = 9;
 const int kPersistentSessionCookieExpiryInDays = 14;
 #endif
 
-// Mozilla sorts on the path length (longest first), and then it
-// sorts by creation time (oldest first).
-// The RFC says the sort order for the domain attribute is undefined.
-bool CookieSorter(CookieMonster::CanonicalCookie* cc1,
-                  CookieMonster::CanonicalCookie* cc2) {
-  if (cc1->Path().length() == cc2->Path().length())
-    return cc1->CreationDate() < cc2->CreationDate();
-  return cc1->Path().length() > cc2->Path().length();
-}
+bool LRUCookieSorter(const CookieMonster::CookieIt& it1,
+                     const CookieMonster::CookieIt& it2) {
+  const CookieMonster::CanonicalCookie* cc1 = *it1.second;
+  const CookieMonster::CanonicalCookie* cc2 = *it2.second;
 
-bool LRUCookieSorter(const CookieMonster::CookieMap::iterator& it1,
-                     const CookieMonster::CookieMap::iterator& it2) {
   // Cookies accessed less recently should be deleted first.
-  if (it1->second->LastAccessDate() != it2->second->LastAccessDate())
-    return it1->second->LastAccessDate() < it2->second->LastAccessDate();
+  if (cc1->LastAccessDate() != cc2->LastAccessDate())
+    return cc1->LastAccessDate() < cc2->LastAccessDate();
 
   // In rare cases we might have two cookies with identical last access times.
   // To preserve the stability of the sort, in these cases prefer to delete
   // older cookies over newer ones.  CreationDate() is guaranteed to be unique.
-  return it1->second->CreationDate() < it2->second->CreationDate();
+  return cc1->CreationDate() < cc2->CreationDate();
 }
 
 // Our strategy to find duplicates is:
@@ -271,7 +275,7 @@ bool FindLeastRecentlyAccessed(
     size_t num_max,
     size_t num_purge,
     Time* lra_removed,
-    std::vector<CookieMonster::CookieMap::iterator>* cookie_its) {
+    std::vector<CookieMonster::CookieIt>* cookie_its) {
   DCHECK_LE(num_purge, num_max);
   if (cookie_its->size() > num_max) {
     VLOG(kVlogGarbageCollection)
@@ -283,7 +287,7 @@ bool FindLeastRecentlyAccessed(
     std::partial_sort(cookie_its->begin(), cookie_its->begin() + num_purge + 1,
                       cookie_its->end(), LRUCookieSorter);
     *lra_removed =
-        (*(cookie_its->begin() + num_purge))->second->LastAccessDate();
+        (*(cookie_its->begin() + num_purge)->second)->LastAccessDate();
     cookie_its->erase(cookie_its->begin() + num_purge, cookie_its->end());
     return true;
   }
@@ -362,7 +366,8 @@ void BuildCookieInfoList(const CanonicalCookieVector& cookies,
 bool CookieMonster::enable_file_scheme_ = false;
 
 CookieMonster::CookieMonster(PersistentCookieStore* store, Delegate* delegate)
-    : initialized_(false),
+    : num_cookies_(0),
+      initialized_(false),
       loaded_(false),
       store_(store),
       last_access_threshold_(
@@ -378,7 +383,8 @@ CookieMonster::CookieMonster(PersistentCookieStore* store, Delegate* delegate)
 CookieMonster::CookieMonster(PersistentCookieStore* store,
                              Delegate* delegate,
                              int last_access_threshold_milliseconds)
-    : initialized_(false),
+    : num_cookies_(0),
+      initialized_(false),
       loaded_(false),
       store_(store),
       last_access_threshold_(base::TimeDelta::FromMilliseconds(
@@ -1137,17 +1143,15 @@ CookieList CookieMonster::GetAllCookies() {
   //
   // Note that this does not prune cookies to be below our limits (if we've
   // exceeded them) the way that calling GarbageCollect() would.
-  GarbageCollectExpired(Time::Now(),
-                        CookieMapItPair(cookies_.begin(), cookies_.end()),
-                        NULL);
+  GarbageCollectAllExpired(Time::Now(), NULL);
 
   // Copy the CanonicalCookie pointers from the map so that we can use the same
-  // sorter as elsewhere, then copy the result out.
+  // sort order as elsewhere, then copy the result out.
   std::vector<CanonicalCookie*> cookie_ptrs;
-  cookie_ptrs.reserve(cookies_.size());
+  cookie_ptrs.reserve(num_cookies_);
   for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end(); ++it)
-    cookie_ptrs.push_back(it->second);
-  std::sort(cookie_ptrs.begin(), cookie_ptrs.end(), CookieSorter);
+    cookie_ptrs.insert(cookie_ptrs.end(), it->second.begin(), it->second.end());
+  std::sort(cookie_ptrs.begin(), cookie_ptrs.end(), CookieSendOrder());
 
   CookieList cookie_list;
   cookie_list.reserve(cookie_ptrs.size());
@@ -1165,7 +1169,6 @@ CookieList CookieMonster::GetAllCookiesForURLWithOptions(
 
   std::vector<CanonicalCookie*> cookie_ptrs;
   FindCookiesForHostAndDomain(url, options, false, &cookie_ptrs);
-  std::sort(cookie_ptrs.begin(), cookie_ptrs.end(), CookieSorter);
 
   CookieList cookies;
   for (std::vector<CanonicalCookie*>::const_iterator it = cookie_ptrs.begin();
@@ -1186,14 +1189,19 @@ int CookieMonster::DeleteAll(bool sync_to_store) {
   base::AutoLock autolock(lock_);
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    ++it;
-    InternalDeleteCookie(curit, sync_to_store,
-                         sync_to_store ? DELETE_COOKIE_EXPLICIT :
-                             DELETE_COOKIE_DONT_RECORD /* Destruction. */);
-    ++num_deleted;
+  for (CookieMap::iterator shard_it = cookies_.begin();
+       shard_it != cookies_.end(); ++shard_it) {
+    CookieShard* shard = &shard_it->second;
+    for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+      CookieShard::iterator curit = it;
+      ++it;
+      InternalDeleteCookie(CookieIt(shard, curit), sync_to_store,
+                           sync_to_store ? DELETE_COOKIE_EXPLICIT :
+                               DELETE_COOKIE_DONT_RECORD /* Destruction. */);
+      ++num_deleted;
+    }
   }
+  cookies_.clear();
 
   return num_deleted;
 }
@@ -1203,18 +1211,23 @@ int CookieMonster::DeleteAllCreatedBetween(const Time& delete_begin,
   base::AutoLock autolock(lock_);
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
-    CanonicalCookie* cc = curit->second;
-    ++it;
+  for (CookieMap::iterator shard_it = cookies_.begin();
+       shard_it != cookies_.end();) {
+    CookieShard* shard = &shard_it->second;
+    for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+      CookieShard::iterator curit = it;
+      CanonicalCookie* cc = *curit;
+      ++it;
 
-    if (cc->CreationDate() >= delete_begin &&
-        (delete_end.is_null() || cc->CreationDate() < delete_end)) {
-      InternalDeleteCookie(curit,
-                           true,  /*sync_to_store*/
-                           DELETE_COOKIE_EXPLICIT);
-      ++num_deleted;
+      if (cc->CreationDate() >= delete_begin &&
+          (delete_end.is_null() || cc->CreationDate() < delete_end)) {
+        InternalDeleteCookie(CookieIt(shard, curit),
+                             true,  /*sync_to_store*/
+                             DELETE_COOKIE_EXPLICIT);
+        ++num_deleted;
+      }
     }
+    shard_it = EraseShardIfEmpty(shard_it);
   }
 
   return num_deleted;
@@ -1233,31 +1246,40 @@ int CookieMonster::DeleteAllForHost(const GURL& url) {
   // domain cookies are stored with a leading ".".  So this is a pretty
   // simple lookup and per-cookie delete.
   int num_deleted = 0;
-  for (CookieMapItPair its = cookies_.equal_range(GetKey(host));
-       its.first != its.second;) {
-    CookieMap::iterator curit = its.first;
-    ++its.first;
+  CookieMap::iterator shard_it = cookies_.find(GetKey(host));
+  if (shard_it == cookies_.end())
+    return 0;
+  CookieShard* shard = &shard_it->second;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+    CookieShard::iterator curit = it;
+    ++it;
 
-    const CanonicalCookie* const cc = curit->second;
+    const CanonicalCookie* const cc = *curit;
 
     // Delete only on a match as a host cookie.
     if (cc->IsHostCookie() && cc->IsDomainMatch(scheme, host)) {
       num_deleted++;
 
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPLICIT);
+      InternalDeleteCookie(CookieIt(shard, curit), true,
+                           DELETE_COOKIE_EXPLICIT);
     }
   }
+  EraseShardIfEmpty(shard_it);
   return num_deleted;
 }
 
 bool CookieMonster::DeleteCanonicalCookie(const CanonicalCookie& cookie) {
   base::AutoLock autolock(lock_);
 
-  for (CookieMapItPair its = cookies_.equal_range(GetKey(cookie.Domain()));
-       its.first != its.second; ++its.first) {
+  CookieMap::iterator shard_it = cookies_.find(GetKey(cookie.Domain()));
+  if (shard_it == cookies_.end())
+    return false;
+  CookieShard* shard = &shard_it->second;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end(); ++it) {
     // The creation date acts as our unique index...
-    if (its.first->second->CreationDate() == cookie.CreationDate()) {
-      InternalDeleteCookie(its.first, true, DELETE_COOKIE_EXPLICIT);
+    if ((*it)->CreationDate() == cookie.CreationDate()) {
+      InternalDeleteCookie(CookieIt(shard, it), true, DELETE_COOKIE_EXPLICIT);
+      EraseShardIfEmpty(shard_it);
       return true;
     }
   }
@@ -1321,7 +1343,6 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
 
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, true, &cookies);
-  std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   std::string cookie_line = BuildCookieLine(cookies);
 
@@ -1348,7 +1369,6 @@ void CookieMonster::GetCookiesWithInfo(const GURL& url,
 
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, true, &cookies);
-  std::sort(cookies.begin(), cookies.end(), CookieSorter);
   *cookie_line = BuildCookieLine(cookies);
 
   histogram_time_get_->AddTime(TimeTicks::Now() - start_time);
@@ -1381,13 +1401,20 @@ void CookieMonster::DeleteCookie(const GURL& url,
     matching_cookies.insert(*it);
   }
 
-  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
-    CookieMap::iterator curit = it;
+  // All of the matching cookies live in the shard for the URL's host.
+  CookieMap::iterator shard_it = cookies_.find(GetKey(url.host()));
+  if (shard_it == cookies_.end())
+    return;
+  CookieShard* shard = &shard_it->second;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+    CookieShard::iterator curit = it;
     ++it;
-    if (matching_cookies.find(curit->second) != matching_cookies.end()) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPLICIT);
+    if (matching_cookies.find(*curit) != matching_cookies.end()) {
+      InternalDeleteCookie(CookieIt(shard, curit), true,
+                           DELETE_COOKIE_EXPLICIT);
     }
   }
+  EraseShardIfEmpty(shard_it);
 }
 
 CookieMonster* CookieMonster::GetCookieMonster() {
@@ -1530,16 +1557,11 @@ void CookieMonster::EnsureCookiesMapIsValid() {
   int num_duplicates_trimmed = 0;
 
   // Iterate through all the of the cookies, grouped by host.
-  CookieMap::iterator prev_range_end = cookies_.begin();
-  while (prev_range_end != cookies_.end()) {
-    CookieMap::iterator cur_range_begin = prev_range_end;
-    const std::string key = cur_range_begin->first;  // Keep a copy.
-    CookieMap::iterator cur_range_end = cookies_.upper_bound(key);
-    prev_range_end = cur_range_end;
-
+  for (CookieMap::iterator shard_it = cookies_.begin();
+       shard_it != cookies_.end(); ++shard_it) {
     // Ensure no equivalent cookies for this host.
     num_duplicates_trimmed +=
-        TrimDuplicateCookiesForKey(key, cur_range_begin, cur_range_end);
+        TrimDuplicateCookiesForKey(shard_it->first, &shard_it->second);
   }
 
   // Record how many duplicates were found in the database.
@@ -1547,14 +1569,12 @@ void CookieMonster::EnsureCookiesMapIsValid() {
   histogram_cookie_deletion_cause_->Add(num_duplicates_trimmed);
 }
 
-int CookieMonster::TrimDuplicateCookiesForKey(
-    const std::string& key,
-    CookieMap::iterator begin,
-    CookieMap::iterator end) {
+int CookieMonster::TrimDuplicateCookiesForKey(const std::string& key,
+                                              CookieShard* shard) {
   lock_.AssertAcquired();
 
   // Set of cookies ordered by creation time.
-  typedef std::set<CookieMap::iterator, OrderByCreationTimeDesc> CookieSet;
+  typedef std::set<CookieShard::iterator, OrderByCreationTimeDesc> CookieSet;
 
   // Helper map we populate to find the duplicates.
   typedef std::map<CookieSignature, CookieSet> EquivalenceMap;
@@ -1563,11 +1583,10 @@ int CookieMonster::TrimDuplicateCookiesForKey(
   // The number of duplicate cookies that have been found.
   int num_duplicates = 0;
 
-  // Iterate through all of the cookies in our range, and insert them into
+  // Iterate through all of the cookies in our shard, and insert them into
   // the equivalence map.
-  for (CookieMap::iterator it = begin; it != end; ++it) {
-    DCHECK_EQ(key, it->first);
-    CanonicalCookie* cookie = it->second;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end(); ++it) {
+    CanonicalCookie* cookie = *it;
 
     CookieSignature signature(cookie->Name(), cookie->Domain(),
                               cookie->Path());
@@ -1577,7 +1596,7 @@ int CookieMonster::TrimDuplicateCookiesForKey(
     if (!set.empty())
       num_duplicates++;
 
-    // We save the iterator into |cookies_| rather than the actual cookie
+    // We save the iterator into |shard| rather than the actual cookie
     // pointer, since we may need to delete it later.
     bool insert_success = set.insert(it).second;
     DCHECK(insert_success) <<
@@ -1617,12 +1636,12 @@ int CookieMonster::TrimDuplicateCookiesForKey(
         signature.path.c_str());
 
     // Remove all the cookies identified by |dupes|. It is valid to delete our
-    // list of iterators one at a time, since |cookies_| is a multimap (they
+    // list of iterators one at a time, since |shard| is a multiset (they
     // don't invalidate existing iterators following deletion).
     for (CookieSet::iterator dupes_it = dupes.begin();
          dupes_it != dupes.end();
          ++dupes_it) {
-      InternalDeleteCookie(*dupes_it, true,
+      InternalDeleteCookie(CookieIt(shard, *dupes_it), true,
                            DELETE_COOKIE_DUPLICATE_IN_BACKING_STORE);
     }
   }
@@ -1677,15 +1696,22 @@ void CookieMonster::FindCookiesForKey(
   const std::string host(url.host());
   bool secure = url.SchemeIsSecure();
 
-  for (CookieMapItPair its = cookies_.equal_range(key);
-       its.first != its.second; ) {
-    CookieMap::iterator curit = its.first;
-    CanonicalCookie* cc = curit->second;
-    ++its.first;
+  CookieMap::iterator shard_it = cookies_.find(key);
+  if (shard_it == cookies_.end())
+    return;
+
+  // The shard is already in send order, so the matching cookies come out
+  // sorted.
+  CookieShard* shard = &shard_it->second;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+    CookieShard::iterator curit = it;
+    CanonicalCookie* cc = *curit;
+    ++it;
 
     // If the cookie is expired, delete it.
     if (cc->IsExpired(current) && !keep_expired_cookies_) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPIRED);
+      InternalDeleteCookie(CookieIt(shard, curit), true,
+                           DELETE_COOKIE_EXPIRED);
       continue;
     }
 
@@ -1711,6 +1737,7 @@ void CookieMonster::FindCookiesForKey(
     }
     cookies->push_back(cc);
   }
+  EraseShardIfEmpty(shard_it);
 }
 
 bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
@@ -1721,11 +1748,14 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
 
   bool found_equivalent_cookie = false;
   bool skipped_httponly = false;
-  for (CookieMapItPair its = cookies_.equal_range(key);
-       its.first != its.second; ) {
-    CookieMap::iterator curit = its.first;
-    CanonicalCookie* cc = curit->second;
-    ++its.first;
+  CookieMap::iterator shard_it = cookies_.find(key);
+  if (shard_it == cookies_.end())
+    return false;
+  CookieShard* shard = &shard_it->second;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+    CookieShard::iterator curit = it;
+    CanonicalCookie* cc = *curit;
+    ++it;
 
     if (ecc.IsEquivalent(*cc)) {
       // We should never have more than one equivalent cookie, since they should
@@ -1735,7 +1765,7 @@ bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
       if (skip_httponly && cc->IsHttpOnly()) {
         skipped_httponly = true;
       } else {
-        InternalDeleteCookie(curit, true, already_expired ?
+        InternalDeleteCookie(CookieIt(shard, curit), true, already_expired ?
             DELETE_COOKIE_EXPIRED_OVERWRITE : DELETE_COOKIE_OVERWRITE);
       }
       found_equivalent_cookie = true;
@@ -1752,7 +1782,8 @@ void CookieMonster::InternalInsertCookie(const std::string& key,
   if ((cc->IsPersistent() || persist_session_cookies_) &&
       store_ && sync_to_store)
     store_->AddCookie(*cc);
-  cookies_.insert(CookieMap::value_type(key, cc));
+  cookies_[key].insert(cc);
+  ++num_cookies_;
   if (delegate_.get()) {
     delegate_->OnCookieChanged(
         *cc, false, CookieMonster::Delegate::CHANGE_COOKIE_EXPLICIT);
@@ -1871,7 +1902,7 @@ void CookieMonster::InternalUpdateCookieAccessTime(CanonicalCookie* cc,
     store_->UpdateCookieAccessTime(*cc);
 }
 
-void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
+void CookieMonster::InternalDeleteCookie(const CookieIt& it,
                                          bool sync_to_store,
                                          DeletionCause deletion_cause) {
   lock_.AssertAcquired();
@@ -1886,7 +1917,7 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
   if (deletion_cause != DELETE_COOKIE_DONT_RECORD)
     histogram_cookie_deletion_cause_->Add(deletion_cause);
 
-  CanonicalCookie* cc = it->second;
+  CanonicalCookie* cc = *it.second;
   VLOG(kVlogSetCookies) << "InternalDeleteCookie() cc: " << cc->DebugString();
 
   if ((cc->IsPersistent() || persist_session_cookies_)
@@ -1898,10 +1929,23 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
     if (mapping.notify)
       delegate_->OnCookieChanged(*cc, true, mapping.cause);
   }
-  cookies_.erase(it);
+  it.first->erase(it.second);
+  --num_cookies_;
   delete cc;
 }
 
+CookieMonster::CookieMap::iterator CookieMonster::EraseShardIfEmpty(
+    CookieMap::iterator shard_it) {
+  lock_.AssertAcquired();
+
+  if (!shard_it->second.empty())
+    return ++shard_it;
+  CookieMap::iterator next = shard_it;
+  ++next;
+  cookies_.erase(shard_it);
+  return next;
+}
+
 // Domain expiry behavior is unchanged by key/expiry scheme (the
 // meaning of the key is different, but that's not visible to this
 // routine).
@@ -1912,12 +1956,14 @@ int CookieMonster::GarbageCollect(const Time& current,
   int num_deleted = 0;
 
   // Collect garbage for this key.
-  if (cookies_.count(key) > kDomainMaxCookies) {
+  CookieMap::iterator shard_it = cookies_.find(key);
+  if (shard_it != cookies_.end() &&
+      shard_it->second.size() > kDomainMaxCookies) {
     VLOG(kVlogGarbageCollection) << "GarbageCollect() key: " << key;
 
-    std::vector<CookieMap::iterator> cookie_its;
+    std::vector<CookieIt> cookie_its;
     num_deleted += GarbageCollectExpired(
-        current, cookies_.equal_range(key), &cookie_its);
+        current, &shard_it->second, &cookie_its);
     base::Time oldest_removed;
     if (FindLeastRecentlyAccessed(kDomainMaxCookies, kDomainPurgeCookies,
                                   &oldest_removed, &cookie_its)) {
@@ -1945,15 +1991,14 @@ int CookieMonster::GarbageCollect(const Time& current,
   // Collect garbage for everything.  With firefox style we want to
   // preserve cookies touched in kSafeFromGlobalPurgeDays, otherwise
   // not.
-  if (cookies_.size() > kMaxCookies &&
+  if (num_cookies_ > kMaxCookies &&
       (earliest_access_time_ <
        Time::Now() - TimeDelta::FromDays(kSafeFromGlobalPurgeDays))) {
     VLOG(kVlogGarbageCollection) << "GarbageCollect() everything";
-    std::vector<CookieMap::iterator> cookie_its;
+    std::vector<CookieIt> cookie_its;
+    cookie_its.reserve(num_cookies_);
     base::Time oldest_left;
-    num_deleted += GarbageCollectExpired(
-        current, CookieMapItPair(cookies_.begin(), cookies_.end()),
-        &cookie_its);
+    num_deleted += GarbageCollectAllExpired(current, &cookie_its);
     if (FindLeastRecentlyAccessed(kMaxCookies, kPurgeCookies,
                                   &oldest_left, &cookie_its)) {
       Time oldest_safe_cookie(
@@ -1972,10 +2017,14 @@ int CookieMonster::GarbageCollect(const Time& current,
         earliest_access_time_ = oldest_left;
       } else {
         earliest_access_time_ =
-            (*(cookie_its.begin() + num_evicted))->second->LastAccessDate();
+            (*(cookie_its.begin() + num_evicted)->second)->LastAccessDate();
       }
       num_deleted += num_evicted;
     }
+
+    // The evictions above may have emptied some shards.
+    for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();)
+      it = EraseShardIfEmpty(it);
   }
 
   return num_deleted;
@@ -1983,41 +2032,59 @@ int CookieMonster::GarbageCollect(const Time& current,
 
 int CookieMonster::GarbageCollectExpired(
     const Time& current,
-    const CookieMapItPair& itpair,
-    std::vector<CookieMap::iterator>* cookie_its) {
+    CookieShard* shard,
+    std::vector<CookieIt>* cookie_its) {
   if (keep_expired_cookies_)
     return 0;
 
   lock_.AssertAcquired();
 
   int num_deleted = 0;
-  for (CookieMap::iterator it = itpair.first, end = itpair.second; it != end;) {
-    CookieMap::iterator curit = it;
+  for (CookieShard::iterator it = shard->begin(); it != shard->end();) {
+    CookieShard::iterator curit = it;
     ++it;
 
-    if (curit->second->IsExpired(current)) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPIRED);
+    if ((*curit)->IsExpired(current)) {
+      InternalDeleteCookie(CookieIt(shard, curit), true,
+                           DELETE_COOKIE_EXPIRED);
       ++num_deleted;
     } else if (cookie_its) {
-      cookie_its->push_back(curit);
+      cookie_its->push_back(CookieIt(shard, curit));
     }
   }
 
   return num_deleted;
 }
 
+int CookieMonster::GarbageCollectAllExpired(
+    const Time& current,
+    std::vector<CookieIt>* cookie_its) {
+  lock_.AssertAcquired();
+
+  int num_deleted = 0;
+  for (CookieMap::iterator it = cookies_.begin(); it != cookies_.end();) {
+    num_deleted += GarbageCollectExpired(current, &it->second, cookie_its);
+    // Erasing an empty shard leaves |cookie_its| valid, since none of its
+    // cookies can have come from that shard.
+    it = EraseShardIfEmpty(it);
+  }
+
+  return num_deleted;
+}
+
 int CookieMonster::GarbageCollectDeleteList(
     const Time& current,
     const Time& keep_accessed_after,
     DeletionCause cause,
-    std::vector<CookieMap::iterator>& cookie_its) {
+    std::vector<CookieIt>& cookie_its) {
   int num_deleted = 0;
-  for (std::vector<CookieMap::iterator>::iterator it = cookie_its.begin();
+  for (std::vector<CookieIt>::iterator it = cookie_its.begin();
        it != cookie_its.end(); it++) {
+    const CanonicalCookie* cc = *it->second;
     if (keep_accessed_after.is_null() ||
-        (*it)->second->LastAccessDate() < keep_accessed_after) {
+        cc->LastAccessDate() < keep_accessed_after) {
       histogram_evicted_last_access_minutes_->Add(
-          (current - (*it)->second->LastAccessDate()).InMinutes());
+          (current - cc->LastAccessDate()).InMinutes());
       InternalDeleteCookie((*it), true, cause);
       num_deleted++;
     }
@@ -2096,33 +2163,27 @@ void CookieMonster::RecordPeriodicStats(const base::Time& current_time) {
   }
 
   // See InitializeHistograms() for details.
-  histogram_count_->Add(cookies_.size());
+  histogram_count_->Add(num_cookies_);
 
   // More detailed statistics on cookie counts at different granularities.
   TimeTicks beginning_of_time(TimeTicks::Now());
 
   for (CookieMap::const_iterator it_key = cookies_.begin();
-       it_key != cookies_.end(); ) {
-    const std::string& key(it_key->first);
+       it_key != cookies_.end(); ++it_key) {
+    const CookieShard& shard(it_key->second);
 
-    int key_count = 0;
     typedef std::map<std::string, unsigned int> DomainMap;
     DomainMap domain_map;
-    CookieMapItPair its_cookies = cookies_.equal_range(key);
-    while (its_cookies.first != its_cookies.second) {
-      key_count++;
-      const std::string& cookie_domain(its_cookies.first->second->Domain());
+    for (CookieShard::const_iterator it = shard.begin(); it != shard.end();
+         ++it) {
+      const std::string& cookie_domain((*it)->Domain());
       domain_map[cookie_domain]++;
-
-      its_cookies.first++;
     }
-    histogram_etldp1_count_->Add(key_count);
+    histogram_etldp1_count_->Add(shard.size());
     histogram_domain_per_etldp1_count_->Add(domain_map.size());
     for (DomainMap::const_iterator domain_map_it = domain_map.begin();
          domain_map_it != domain_map.end(); domain_map_it++)
       histogram_domain_count_->Add(domain_map_it->second);
-
-    it_key = its_cookies.second;
   }
 
   VLOG(kVlogPeriodic)
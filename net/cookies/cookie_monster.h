@@ -19,6 +19,7 @@
 #include "base/basictypes.h"
 #include "base/callback_forward.h"
 #include "base/gtest_prod_util.h"
+#include "base/hash_tables.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/synchronization/lock.h"
@@ -85,7 +86,7 @@ class NET_EXPORT CookieMonster : public CookieStore {
   //      administrative control.
 
   // CookieMap is the central data structure of the CookieMonster.  It
-  // is a map whose values are pointers to CanonicalCookie data
+  // is a map whose values are sets of pointers to CanonicalCookie data
   // structures (the data structures are owned by the CookieMonster
   // and must be destroyed when removed from the map).  The key is based on the
   // effective domain of the cookies.  If the domain of the cookie has an
@@ -95,17 +96,22 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // excludes cookies for, e.g, ".com", ".co.uk", or ".internalnetwork".
   // This behavior is the same as the behavior in Firefox v 3.6.10.
 
-  // NOTE(deanm):
-  // I benchmarked hash_multimap vs multimap.  We're going to be query-heavy
-  // so it would seem like hashing would help.  However they were very
-  // close, with multimap being a tiny bit faster.  I think this is because
-  // our map is at max around 1000 entries, and the additional complexity
-  // for the hashing might not overcome the O(log(1000)) for querying
-  // a multimap.  Also, multimap is standard, another reason to use it.
-  // TODO(rdsmith): This benchmark should be re-done now that we're allowing
-  // subtantially more entries in the map.
-  typedef std::multimap<std::string, CanonicalCookie*> CookieMap;
-  typedef std::pair<CookieMap::iterator, CookieMap::iterator> CookieMapItPair;
+  // Each key maps to a shard holding that key's cookies.  The shards are
+  // kept in the order in which cookies are sent (see CookieSendOrder), so
+  // finding the cookies for a URL is a single hash lookup followed by a
+  // filtered walk of one shard, with no per-request sort.  A multimap
+  // sorted by key was used originally, which was fine at ~1000 entries but
+  // made lookups and sorting dominate with hundreds of thousands of cookies.
+  struct CookieSendOrder {
+    bool operator()(const CanonicalCookie* cc1,
+                    const CanonicalCookie* cc2) const;
+  };
+  typedef std::multiset<CanonicalCookie*, CookieSendOrder> CookieShard;
+  typedef base::hash_map<std::string, CookieShard> CookieMap;
+
+  // Identifies a single cookie in the CookieMap: the shard it lives in and
+  // its position within that shard.
+  typedef std::pair<CookieShard*, CookieShard::iterator> CookieIt;
 
   // The store passed in should not have had Init() called on it yet. This
   // class will take care of initializing it. The backing store is NOT owned by
@@ -457,12 +463,10 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // inconsistencies. (In other words, it does not have duplicate cookies).
   void EnsureCookiesMapIsValid();
 
-  // Checks for any duplicate cookies for CookieMap key |key| which lie between
-  // |begin| and |end|. If any are found, all but the most recent are deleted.
+  // Checks for any duplicate cookies in |shard|, the shard for CookieMap key
+  // |key|. If any are found, all but the most recent are deleted.
   // Returns the number of duplicate cookies that were deleted.
-  int TrimDuplicateCookiesForKey(const std::string& key,
-                                 CookieMap::iterator begin,
-                                 CookieMap::iterator end);
+  int TrimDuplicateCookiesForKey(const std::string& key, CookieShard* shard);
 
   void SetDefaultCookieableSchemes();
 
@@ -513,9 +517,15 @@ class NET_EXPORT CookieMonster : public CookieStore {
 
   // |deletion_cause| argument is used for collecting statistics and choosing
   // the correct Delegate::ChangeCause for OnCookieChanged notifications.
-  void InternalDeleteCookie(CookieMap::iterator it, bool sync_to_store,
+  // The cookie's shard is left in |cookies_| even if it becomes empty, so
+  // callers may keep walking it; see EraseShardIfEmpty().
+  void InternalDeleteCookie(const CookieIt& it, bool sync_to_store,
                             DeletionCause deletion_cause);
 
+  // Removes the shard at |shard_it| from |cookies_| if it holds no cookies.
+  // Returns the iterator following |shard_it|.
+  CookieMap::iterator EraseShardIfEmpty(CookieMap::iterator shard_it);
+
   // If the number of cookies for CookieMap key |key|, or globally, are
   // over the preset maximums above, garbage collect, first for the host and
   // then globally.  See comments above garbage collection threshold
@@ -525,13 +535,18 @@ class NET_EXPORT CookieMonster : public CookieStore {
   int GarbageCollect(const base::Time& current, const std::string& key);
 
   // Helper for GarbageCollect(); can be called directly as well.  Deletes
-  // all expired cookies in |itpair|.  If |cookie_its| is non-NULL, it is
-  // populated with all the non-expired cookies from |itpair|.
+  // all expired cookies in |shard|.  If |cookie_its| is non-NULL, it is
+  // populated with all the non-expired cookies from |shard|.
   //
   // Returns the number of cookies deleted.
   int GarbageCollectExpired(const base::Time& current,
-                            const CookieMapItPair& itpair,
-                            std::vector<CookieMap::iterator>* cookie_its);
+                            CookieShard* shard,
+                            std::vector<CookieIt>* cookie_its);
+
+  // Runs GarbageCollectExpired() over every shard, dropping shards that
+  // become empty.
+  int GarbageCollectAllExpired(const base::Time& current,
+                               std::vector<CookieIt>* cookie_its);
 
   // Helper for GarbageCollect().  Deletes all cookies in the list
   // that were accessed before |keep_accessed_after|, using DeletionCause
@@ -540,7 +555,7 @@ class NET_EXPORT CookieMonster : public CookieStore {
   int GarbageCollectDeleteList(const base::Time& current,
                                const base::Time& keep_accessed_after,
                                DeletionCause cause,
-                               std::vector<CookieMap::iterator>& cookie_its);
+                               std::vector<CookieIt>& cookie_its);
 
   // Find the key (for lookup in cookies_) based on the given domain.
   // See comment on keys before the CookieMap typedef.
@@ -588,6 +603,9 @@ class NET_EXPORT CookieMonster : public CookieStore {
 
   CookieMap cookies_;
 
+  // Total number of cookies in all the shards of |cookies_|.
+  size_t num_cookies_;
+
   // Indicates whether the cookie store has been initialized. This happens
   // lazily in InitStoreIfNecessary().
   bool initialized_;
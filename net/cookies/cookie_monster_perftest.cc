@@ -25,6 +25,10 @@ class CookieMonsterTest : public testing::Test {
 }
 
 static const int kNumCookies = 20000;
+// The large-store tests hold 100k cookies spread over enough eTLD+1s to stay
+// under the per-domain limit.
+static const int kNumLargeStoreCookies = 100000;
+static const int kNumLargeStoreHosts = 2000;
 static const char kCookieLine[] = "A  = \"b=;\\\"\"  ;secure;;;";
 
 namespace net {
@@ -52,6 +56,10 @@ TEST(ParsedCookieTest, TestParseBigCookies) {
 
 static const GURL kUrlGoogle("http://www.google.izzle");
 
+static int CountInString(const std::string& str, char c) {
+  return std::count(str.begin(), str.end(), c);
+}
+
 class BaseCallback {
  public:
   BaseCallback() : has_run_(false) {}
@@ -110,6 +118,23 @@ class GetCookiesCallback : public BaseCallback {
   net::CookieOptions options_;
 };
 
+class GetAllCookiesCallback : public BaseCallback {
+ public:
+  const CookieList& GetAllCookies(CookieMonster* cm) {
+    cm->GetAllCookiesAsync(base::Bind(&GetAllCookiesCallback::Run,
+                                      base::Unretained(this)));
+    WaitForCallback();
+    return cookies_;
+  }
+
+ private:
+  void Run(const CookieList& cookies) {
+    cookies_ = cookies;
+    BaseCallback::Run();
+  }
+  CookieList cookies_;
+};
+
 class GetCookiesWithInfoCallback : public BaseCallback {
  public:
   const std::string& GetCookiesWithInfo(CookieMonster* cm, const GURL& gurl) {
@@ -199,6 +224,62 @@ TEST_F(CookieMonsterTest, TestAddCookieOnManyHosts) {
   timer3.Done();
 }
 
+TEST_F(CookieMonsterTest, TestLargeStore) {
+  scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
+  const int cookies_per_host = kNumLargeStoreCookies / kNumLargeStoreHosts;
+  std::vector<GURL> gurls;
+  for (int i = 0; i < kNumLargeStoreHosts; ++i)
+    gurls.push_back(GURL(base::StringPrintf("https://www.h%04d.izzle/a/b", i)));
+
+  SetCookieCallback setCookieCallback;
+
+  // Spread each host's cookies over a few paths so that the send order
+  // matters.
+  PerfTimeLogger timer("Cookie_monster_large_store_add");
+  for (int i = 0; i < cookies_per_host; ++i) {
+    const char* path = (i % 3 == 0) ? "/" : (i % 3 == 1) ? "/a" : "/a/b";
+    const std::string cookie =
+        base::StringPrintf("c%02d=v; path=%s", i, path);
+    for (std::vector<GURL>::const_iterator it = gurls.begin();
+         it != gurls.end(); ++it) {
+      setCookieCallback.SetCookie(cm, *it, cookie);
+    }
+  }
+  timer.Done();
+
+  GetAllCookiesCallback getAllCookiesCallback;
+  EXPECT_EQ(static_cast<size_t>(kNumLargeStoreCookies),
+            getAllCookiesCallback.GetAllCookies(cm).size());
+
+  GetCookiesCallback getCookiesCallback;
+
+  PerfTimeLogger timer2("Cookie_monster_large_store_query");
+  for (int i = 0; i < kNumCookies; ++i) {
+    const std::string& cookie_line =
+        getCookiesCallback.GetCookies(cm, gurls[i % kNumLargeStoreHosts]);
+    EXPECT_EQ(cookies_per_host, CountInString(cookie_line, '='));
+  }
+  timer2.Done();
+
+  // Overwriting a cookie looks up and replaces its equivalent.
+  PerfTimeLogger timer3("Cookie_monster_large_store_overwrite");
+  for (int i = 0; i < kNumCookies; ++i) {
+    setCookieCallback.SetCookie(cm, gurls[i % kNumLargeStoreHosts],
+                                "c00=w; path=/");
+  }
+  timer3.Done();
+
+  PerfTimeLogger timer4("Cookie_monster_large_store_get_all");
+  EXPECT_EQ(static_cast<size_t>(kNumLargeStoreCookies),
+            getAllCookiesCallback.GetAllCookies(cm).size());
+  timer4.Done();
+
+  PerfTimeLogger timer5("Cookie_monster_large_store_deleteall");
+  cm->DeleteAllAsync(CookieMonster::DeleteCallback());
+  MessageLoop::current()->RunAllPending();
+  timer5.Done();
+}
+
 TEST_F(CookieMonsterTest, TestGetCookiesWithInfo) {
   scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
 
@@ -223,10 +304,6 @@ TEST_F(CookieMonsterTest, TestGetCookiesWithInfo) {
   timer.Done();
 }
 
-static int CountInString(const std::string& str, char c) {
-  return std::count(str.begin(), str.end(), c);
-}
-
 TEST_F(CookieMonsterTest, TestDomainTree) {
   scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
   GetCookiesCallback getCookiesCallback;
@@ -406,6 +483,16 @@ TEST_F(CookieMonsterTest, TestGCTimes) {
       // Few enough cookies that gc shouldn't happen at all.
       CookieMonster::kMaxCookies - 5,
       0,
+    }, {
+      // A large store of recent cookies; gc shouldn't happen.
+      "large_store_recent",
+      kNumLargeStoreCookies,
+      0,
+    }, {
+      // A large store that has to be purged down to kMaxCookies once.
+      "large_store_old",
+      kNumLargeStoreCookies,
+      kNumLargeStoreCookies - CookieMonster::kMaxCookies / 2,
     },
   };
   for (int ci = 0; ci < static_cast<int>(ARRAYSIZE_UNSAFE(test_cases)); ++ci) {
@@ -2169,21 +2169,22 @@ bool BackendImpl::CheckEntry(EntryImpl* cache_entry) {
 }
 
 int BackendImpl::MaxBuffersSize() {
-  static int64 total_memory = base::SysInfo::AmountOfPhysicalMemory();
-  static bool done = false;
+  // The shards of a ShardedBackend may get here at the same time, so the value
+  // is computed locally and stored at once.
+  static int max_buffers_size = 0;
 
-  if (!done) {
+  if (!max_buffers_size) {
     const int kMaxBuffersSize = 30 * 1024 * 1024;
 
     // We want to use up to 2% of the computer's memory.
-    total_memory = total_memory * 2 / 100;
+    int64 total_memory = base::SysInfo::AmountOfPhysicalMemory() * 2 / 100;
     if (total_memory > kMaxBuffersSize || total_memory <= 0)
       total_memory = kMaxBuffersSize;
 
-    done = true;
+    max_buffers_size = static_cast<int>(total_memory);
   }
 
-  return static_cast<int>(total_memory);
+  return max_buffers_size;
 }
 
 }  // namespace disk_cache
@@ -20,6 +20,7 @@
 #include "net/disk_cache/histogram_macros.h"
 #include "net/disk_cache/mapped_file.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 #if defined(OS_WIN)
@@ -73,6 +74,7 @@ class DiskCacheBackendTest : public DiskCacheTestWithCache {
   void BackendDisable2();
   void BackendDisable3();
   void BackendDisable4();
+  void RestartSimpleCache();
 };
 
 void DiskCacheBackendTest::BackendBasics() {
@@ -140,6 +142,11 @@ TEST_F(DiskCacheBackendTest, AppCacheBasics) {
   BackendBasics();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheBasics) {
+  SetSimpleCacheMode();
+  BackendBasics();
+}
+
 void DiskCacheBackendTest::BackendKeying() {
   InitCache();
   const char* kName1 = "the first key";
@@ -195,6 +202,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyKeying) {
   BackendKeying();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheKeying) {
+  SetSimpleCacheMode();
+  BackendKeying();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheKeying) {
   SetCacheType(net::APP_CACHE);
   BackendKeying();
@@ -591,6 +603,12 @@ TEST_F(DiskCacheBackendTest, AppCacheLoad) {
   BackendLoad();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheLoad) {
+  SetMaxSize(0x100000);
+  SetSimpleCacheMode();
+  BackendLoad();
+}
+
 // Tests the chaining of an entry to the current head.
 void DiskCacheBackendTest::BackendChain() {
   SetMask(0x1);  // 2-entry table.
@@ -1027,6 +1045,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyEnumerations) {
   BackendEnumerations();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheEnumerations) {
+  SetSimpleCacheMode();
+  BackendEnumerations();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheEnumerations) {
   SetCacheType(net::APP_CACHE);
   BackendEnumerations();
@@ -1258,6 +1281,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomRecent) {
   BackendDoomRecent();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheDoomRecent) {
+  SetSimpleCacheMode();
+  BackendDoomRecent();
+}
+
 void DiskCacheBackendTest::BackendDoomBetween() {
   InitCache();
 
@@ -1315,6 +1343,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomBetween) {
   BackendDoomBetween();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheDoomBetween) {
+  SetSimpleCacheMode();
+  BackendDoomBetween();
+}
+
 void DiskCacheBackendTest::BackendTransaction(const std::string& name,
                                               int num_entries, bool load) {
   success_ = false;
@@ -2319,6 +2352,11 @@ TEST_F(DiskCacheBackendTest, MemoryOnlyDoomAll) {
   BackendDoomAll();
 }
 
+TEST_F(DiskCacheBackendTest, SimpleCacheDoomAll) {
+  SetSimpleCacheMode();
+  BackendDoomAll();
+}
+
 TEST_F(DiskCacheBackendTest, AppCacheOnlyDoomAll) {
   SetCacheType(net::APP_CACHE);
   BackendDoomAll();
@@ -2574,3 +2612,153 @@ TEST_F(DiskCacheBackendTest, UpdateRankForExternalCacheHit) {
   ASSERT_EQ(net::OK, OpenEntry("key0", &entry));
   entry->Close();
 }
+
+// Restarts the simple cache, keeping its files.
+void DiskCacheBackendTest::RestartSimpleCache() {
+  FlushQueueForTest();
+  delete cache_;
+  cache_ = NULL;
+  simple_cache_impl_ = NULL;
+  MessageLoop::current()->RunAllPending();
+
+  DisableFirstCleanup();
+  InitCache();
+}
+
+// Tests that the entries of the simple cache, and their data, survive a
+// restart.
+TEST_F(DiskCacheBackendTest, SimpleCacheRestart) {
+  SetSimpleCacheMode();
+  InitCache();
+
+  const int kSize = 5000;
+  scoped_refptr<net::IOBuffer> buffer1(new net::IOBuffer(kSize));
+  scoped_refptr<net::IOBuffer> buffer2(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer1->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("the first key", &entry));
+  for (int i = 0; i < 3; i++)
+    EXPECT_EQ(kSize, WriteData(entry, i, 0, buffer1, kSize, false));
+  entry->Close();
+  ASSERT_EQ(net::OK, CreateEntry("the second key", &entry));
+  entry->Close();
+
+  RestartSimpleCache();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  ASSERT_EQ(net::OK, OpenEntry("the first key", &entry));
+  EXPECT_EQ("the first key", entry->GetKey());
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(kSize, entry->GetDataSize(i));
+    memset(buffer2->data(), 0, kSize);
+    EXPECT_EQ(kSize, ReadData(entry, i, 0, buffer2, kSize));
+    EXPECT_EQ(0, memcmp(buffer1->data(), buffer2->data(), kSize));
+  }
+  entry->Close();
+
+  ASSERT_EQ(net::OK, OpenEntry("the second key", &entry));
+  EXPECT_EQ(0, entry->GetDataSize(1));
+  entry->Close();
+}
+
+// Tests that the index is rebuilt from the files of the entries when it is
+// lost, as it would be after a crash.
+TEST_F(DiskCacheBackendTest, SimpleCacheLostIndex) {
+  SetSimpleCacheMode();
+  InitCache();
+
+  const int kNumEntries = 10;
+  disk_cache::Entry* entry;
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("key%d", i), &entry));
+    entry->Close();
+  }
+  FlushQueueForTest();
+  delete cache_;
+  cache_ = NULL;
+  simple_cache_impl_ = NULL;
+  MessageLoop::current()->RunAllPending();
+
+  FilePath index_path = cache_path_.AppendASCII("index-dir");
+  ASSERT_TRUE(file_util::PathExists(index_path.AppendASCII("index")));
+  ASSERT_TRUE(file_util::Delete(index_path, true));
+
+  DisableFirstCleanup();
+  InitCache();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(base::StringPrintf("key%d", i), &entry));
+    entry->Close();
+  }
+}
+
+// Tests that a damaged entry is removed from the simple cache, without
+// affecting the other entries.
+TEST_F(DiskCacheBackendTest, SimpleCacheCorruptEntry) {
+  SetSimpleCacheMode();
+  InitCache();
+
+  const int kSize = 200;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("the first key", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer, kSize, false));
+  entry->Close();
+  ASSERT_EQ(net::OK, CreateEntry("the second key", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer, kSize, false));
+  entry->Close();
+  RestartSimpleCache();
+
+  // Chop the end of the file, as if the entry was being written when the
+  // cache went away.
+  FilePath entry_path = cache_path_.AppendASCII(
+      disk_cache::GetFilenameFromEntryHash(
+          disk_cache::GetEntryHashKey("the first key")));
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(entry_path, &contents));
+  int size = static_cast<int>(contents.size()) - 10;
+  ASSERT_EQ(size, file_util::WriteFile(entry_path, contents.data(), size));
+
+  EXPECT_EQ(2, cache_->GetEntryCount());
+  EXPECT_NE(net::OK, OpenEntry("the first key", &entry));
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  FlushQueueForTest();
+  EXPECT_FALSE(file_util::PathExists(entry_path));
+
+  ASSERT_EQ(net::OK, OpenEntry("the second key", &entry));
+  EXPECT_EQ(kSize, entry->GetDataSize(1));
+  entry->Close();
+}
+
+// Tests that the least recently used entries of the simple cache are evicted
+// when it grows too big.
+TEST_F(DiskCacheBackendTest, SimpleCacheEviction) {
+  SetSimpleCacheMode();
+  const int kMaxSize = 0x100000;
+  SetMaxSize(kMaxSize);
+  InitCache();
+
+  const int kSize = 100 * 1024;
+  const int kNumEntries = 20;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, CreateEntry(base::StringPrintf("key%d", i), &entry));
+    EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer, kSize, false));
+    entry->Close();
+  }
+  FlushQueueForTest();
+
+  EXPECT_GT(kNumEntries, cache_->GetEntryCount());
+  EXPECT_LE(cache_->GetEntryCount() * kSize, kMaxSize);
+  EXPECT_NE(net::OK, OpenEntry("key0", &entry));
+  ASSERT_EQ(net::OK,
+            OpenEntry(base::StringPrintf("key%d", kNumEntries - 1), &entry));
+  EXPECT_EQ(kSize, entry->GetDataSize(1));
+  entry->Close();
+}
@@ -7,8 +7,12 @@
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/perftimer.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
 #include "base/threading/thread.h"
 #include "base/test/test_file_util.h"
 #include "base/timer.h"
@@ -21,6 +25,9 @@
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/hash.h"
+#include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/sharded_backend.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -138,6 +145,102 @@ bool TimeRead(int num_entries, disk_cache::Backend* cache,
   return (expected == helper.callbacks_called());
 }
 
+// The number of operations that are kept in flight by ConcurrentOperations,
+// as a busy network stack does.
+const int kOperationsInFlight = 256;
+
+// Performs an operation on each one of a set of entries, with up to
+// kOperationsInFlight of them going on at the same time. Each operation
+// creates an entry and writes its data, or opens an entry and reads its data,
+// and closes the entry.
+class ConcurrentOperations {
+ public:
+  ConcurrentOperations(disk_cache::Backend* cache, const TestEntries& entries,
+                       bool write)
+      : cache_(cache),
+        entries_(entries),
+        write_(write),
+        cache_entries_(entries.size()),
+        write_buffer_(new net::IOBuffer(kMaxSize)),
+        next_(0),
+        pending_(0),
+        failures_(0) {
+    CacheTestFillBuffer(write_buffer_->data(), kMaxSize, false);
+  }
+
+  // Runs all the operations, and returns the number of them that failed.
+  int Run() {
+    for (int i = 0; i < kOperationsInFlight; i++)
+      StartNext();
+    if (pending_)
+      MessageLoop::current()->Run();
+    return failures_;
+  }
+
+ private:
+  void StartNext() {
+    if (next_ == entries_.size())
+      return;
+
+    size_t index = next_++;
+    pending_++;
+    net::CompletionCallback callback =
+        base::Bind(&ConcurrentOperations::OnEntryReady, base::Unretained(this),
+                   index);
+    const std::string& key = entries_[index].key;
+    int rv = write_ ?
+        cache_->CreateEntry(key, &cache_entries_[index], callback) :
+        cache_->OpenEntry(key, &cache_entries_[index], callback);
+    if (rv != net::ERR_IO_PENDING)
+      OnEntryReady(index, rv);
+  }
+
+  void OnEntryReady(size_t index, int result) {
+    if (result != net::OK)
+      return OperationDone(false);
+
+    disk_cache::Entry* entry = cache_entries_[index];
+    int data_len = entries_[index].data_len;
+    net::CompletionCallback callback =
+        base::Bind(&ConcurrentOperations::OnIOComplete, base::Unretained(this),
+                   index);
+    int rv;
+    if (write_) {
+      rv = entry->WriteData(1, 0, write_buffer_, data_len, callback, false);
+    } else {
+      scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(data_len + 1));
+      rv = entry->ReadData(1, 0, buffer, data_len, callback);
+    }
+    if (rv != net::ERR_IO_PENDING)
+      OnIOComplete(index, rv);
+  }
+
+  void OnIOComplete(size_t index, int result) {
+    cache_entries_[index]->Close();
+    OperationDone(result == entries_[index].data_len);
+  }
+
+  void OperationDone(bool success) {
+    if (!success)
+      failures_++;
+    pending_--;
+    StartNext();
+    if (!pending_)
+      MessageLoop::current()->Quit();
+  }
+
+  disk_cache::Backend* cache_;
+  const TestEntries& entries_;
+  bool write_;
+  std::vector<disk_cache::Entry*> cache_entries_;
+  scoped_refptr<net::IOBuffer> write_buffer_;
+  size_t next_;
+  int pending_;
+  int failures_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentOperations);
+};
+
 int BlockSize() {
   // We can use form 1 to 4 blocks.
   return (rand() & 0x3) + 1;
@@ -206,6 +309,184 @@ TEST_F(DiskCacheTest, CacheBackendPerformance) {
   delete cache;
 }
 
+// Measures the throughput of the cache with hundreds of concurrent requests,
+// as a function of the number of shards of the backend.
+TEST_F(DiskCacheTest, ShardedBackendPerformance) {
+  const int kNumEntries = 4000;
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  TestEntries entries;
+  for (int i = 0; i < kNumEntries; i++) {
+    TestEntry entry;
+    entry.key = GenerateKey(true);
+    entry.data_len = rand() % kMaxSize;
+    entries.push_back(entry);
+  }
+
+  for (int num_shards = 1; num_shards <= 8; num_shards *= 2) {
+    ASSERT_TRUE(file_util::Delete(cache_path_, true));
+    net::TestCompletionCallback cb;
+    disk_cache::Backend* cache;
+    int rv = disk_cache::ShardedBackend::CreateBackend(
+        cache_path_, num_shards, false, 200 * 1024 * 1024, net::DISK_CACHE,
+        disk_cache::kNone, NULL, &cache, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+    PerfTimer write_timer;
+    ConcurrentOperations writes(cache, entries, true);
+    EXPECT_EQ(0, writes.Run());
+    LogPerfResult(base::StringPrintf("Sharded cache writes, %d shards",
+                                     num_shards).c_str(),
+                  kNumEntries / write_timer.Elapsed().InSecondsF(), "ops/s");
+
+    PerfTimer read_timer;
+    ConcurrentOperations reads(cache, entries, false);
+    EXPECT_EQ(0, reads.Run());
+    LogPerfResult(base::StringPrintf("Sharded cache reads, %d shards",
+                                     num_shards).c_str(),
+                  kNumEntries / read_timer.Elapsed().InSecondsF(), "ops/s");
+
+    MessageLoop::current()->RunAllPending();
+    delete cache;
+  }
+}
+
+// Compares the throughput of the simple backend, with one file per entry, to
+// the one of the block file backend, with hundreds of concurrent requests.
+TEST_F(DiskCacheTest, SimpleBackendPerformance) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+
+  const int kNumEntries = 4000;
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  TestEntries entries;
+  for (int i = 0; i < kNumEntries; i++) {
+    TestEntry entry;
+    entry.key = GenerateKey(true);
+    entry.data_len = rand() % kMaxSize;
+    entries.push_back(entry);
+  }
+
+  for (int simple = 0; simple < 2; simple++) {
+    const char* name = simple ? "Simple cache" : "Block file cache";
+    ASSERT_TRUE(file_util::Delete(cache_path_, true));
+    net::TestCompletionCallback cb;
+    disk_cache::Backend* cache;
+    int rv;
+    if (simple) {
+      rv = disk_cache::SimpleBackendImpl::CreateBackend(
+          cache_path_, 200 * 1024 * 1024, NULL, &cache, cb.callback());
+    } else {
+      rv = disk_cache::CreateCacheBackend(
+          net::DISK_CACHE, cache_path_, 200 * 1024 * 1024, false,
+          cache_thread.message_loop_proxy(), NULL, &cache, cb.callback());
+    }
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+    PerfTimer write_timer;
+    ConcurrentOperations writes(cache, entries, true);
+    EXPECT_EQ(0, writes.Run());
+    LogPerfResult(base::StringPrintf("%s writes", name).c_str(),
+                  kNumEntries / write_timer.Elapsed().InSecondsF(), "ops/s");
+
+    PerfTimer read_timer;
+    ConcurrentOperations reads(cache, entries, false);
+    EXPECT_EQ(0, reads.Run());
+    LogPerfResult(base::StringPrintf("%s reads", name).c_str(),
+                  kNumEntries / read_timer.Elapsed().InSecondsF(), "ops/s");
+
+    MessageLoop::current()->RunAllPending();
+    delete cache;
+  }
+}
+
+// Measures the throughput of the memory-only cache as entries are written in
+// small pieces, the way they come from the network, and evicted, and how much
+// memory it takes beyond the size of the data.
+TEST_F(DiskCacheTest, MemoryCachePerformance) {
+  const int kCacheSize = 64 * 1024 * 1024;
+  const int kNumEntries = 4000;
+  const int kMaxEntrySize = 128 * 1024;
+  const int kMaxPieceSize = 4096;
+  int seed = static_cast<int>(Time::Now().ToInternalValue());
+  srand(seed);
+
+  scoped_ptr<disk_cache::Backend> cache(
+      disk_cache::MemBackendImpl::CreateBackend(kCacheSize, NULL));
+  ASSERT_TRUE(cache.get());
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kMaxEntrySize));
+  CacheTestFillBuffer(buffer->data(), kMaxEntrySize, false);
+
+  std::vector<std::string> keys;
+  int64 bytes_written = 0;
+  PerfTimer write_timer;
+  for (int i = 0; i < kNumEntries; i++) {
+    keys.push_back(GenerateKey(true));
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, cache->CreateEntry(keys.back(), &entry,
+                                          net::CompletionCallback()));
+    int headers_size = rand() % kMaxPieceSize;
+    EXPECT_EQ(headers_size, entry->WriteData(0, 0, buffer, headers_size,
+                                             net::CompletionCallback(),
+                                             false));
+    int entry_size = rand() % kMaxEntrySize;
+    for (int offset = 0; offset < entry_size;) {
+      int piece_size = std::min(rand() % kMaxPieceSize + 1,
+                                entry_size - offset);
+      EXPECT_EQ(piece_size, entry->WriteData(1, offset, buffer, piece_size,
+                                             net::CompletionCallback(),
+                                             false));
+      offset += piece_size;
+    }
+    bytes_written += headers_size + entry_size;
+    entry->Close();
+  }
+  LogPerfResult("Memory cache writes",
+                bytes_written / 1024.0 / 1024 /
+                    write_timer.Elapsed().InSecondsF(),
+                "MB/s");
+
+  int64 bytes_read = 0;
+  PerfTimer read_timer;
+  for (size_t i = 0; i < keys.size(); i++) {
+    disk_cache::Entry* entry;
+    if (cache->OpenEntry(keys[i], &entry, net::CompletionCallback()) !=
+        net::OK) {
+      continue;  // Evicted.
+    }
+    for (int index = 0; index < 2; index++) {
+      int size = entry->GetDataSize(index);
+      EXPECT_EQ(size, entry->ReadData(index, 0, buffer, size,
+                                      net::CompletionCallback()));
+      bytes_read += size;
+    }
+    entry->Close();
+  }
+  LogPerfResult("Memory cache reads",
+                bytes_read / 1024.0 / 1024 /
+                    read_timer.Elapsed().InSecondsF(),
+                "MB/s");
+
+  std::vector<std::pair<std::string, std::string> > stats;
+  cache->GetStats(&stats);
+  int64 data_size = 0;
+  int64 reserved_memory = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == "Size")
+      base::StringToInt64(stats[i].second, &data_size);
+    else if (stats[i].first == "Reserved memory")
+      base::StringToInt64(stats[i].second, &reserved_memory);
+  }
+  ASSERT_LT(0, data_size);
+  LogPerfResult("Memory cache overhead",
+                100.0 * (reserved_memory - data_size) / data_size, "%");
+}
+
 // Creating and deleting "entries" on a block-file is something quite frequent
 // (after all, almost everything is stored on block files). The operation is
 // almost free when the file is empty, but can be expensive if the file gets
@@ -12,6 +12,7 @@
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 
 DiskCacheTest::DiskCacheTest() {
   cache_path_ = GetCacheFilePath();
@@ -47,10 +48,12 @@ DiskCacheTestWithCache::DiskCacheTestWithCache()
     : cache_(NULL),
       cache_impl_(NULL),
       mem_cache_(NULL),
+      simple_cache_impl_(NULL),
       mask_(0),
       size_(0),
       type_(net::DISK_CACHE),
       memory_only_(false),
+      simple_cache_mode_(false),
       implementation_(false),
       force_creation_(false),
       new_eviction_(false),
@@ -68,6 +71,8 @@ void DiskCacheTestWithCache::InitCache() {
 
   if (memory_only_)
     InitMemoryCache();
+  else if (simple_cache_mode_)
+    InitSimpleCache();
   else
     InitDiskCache();
 
@@ -151,6 +156,12 @@ int DiskCacheTestWithCache::OpenNextEntry(void** iter,
 }
 
 void DiskCacheTestWithCache::FlushQueueForTest() {
+  if (simple_cache_impl_) {
+    simple_cache_impl_->FlushWorkerPoolForTesting();
+    MessageLoop::current()->RunAllPending();
+    return;
+  }
+
   if (memory_only_ || !cache_impl_)
     return;
 
@@ -219,7 +230,7 @@ void DiskCacheTestWithCache::TearDown() {
   if (cache_thread_.IsRunning())
     cache_thread_.Stop();
 
-  if (!memory_only_ && integrity_) {
+  if (!memory_only_ && !simple_cache_mode_ && integrity_) {
     EXPECT_TRUE(CheckCacheIntegrity(cache_path_, new_eviction_, mask_));
   }
 
@@ -266,6 +277,18 @@ void DiskCacheTestWithCache::InitDiskCache() {
   ASSERT_EQ(net::OK, cb.GetResult(rv));
 }
 
+void DiskCacheTestWithCache::InitSimpleCache() {
+  // The index of the simple cache lives in a folder of its own.
+  if (first_cleanup_)
+    ASSERT_TRUE(file_util::Delete(cache_path_, true));
+
+  net::TestCompletionCallback cb;
+  int rv = disk_cache::SimpleBackendImpl::CreateBackend(
+      cache_path_, size_, NULL, &cache_, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  simple_cache_impl_ = static_cast<disk_cache::SimpleBackendImpl*>(cache_);
+}
+
 void DiskCacheTestWithCache::InitDiskCacheImpl() {
   scoped_refptr<base::MessageLoopProxy> thread =
       use_current_thread_ ? base::MessageLoopProxy::current() :
@@ -26,6 +26,7 @@ class Backend;
 class BackendImpl;
 class Entry;
 class MemBackendImpl;
+class SimpleBackendImpl;
 
 }  // namespace disk_cache
 
@@ -66,6 +67,11 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     memory_only_ = true;
   }
 
+  // Use the simple backend, with one file per entry, instead of BackendImpl.
+  void SetSimpleCacheMode() {
+    simple_cache_mode_ = true;
+  }
+
   // Use the implementation directly instead of the factory provided object.
   void SetDirectMode() {
     implementation_ = true;
@@ -138,11 +144,13 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   disk_cache::Backend* cache_;
   disk_cache::BackendImpl* cache_impl_;
   disk_cache::MemBackendImpl* mem_cache_;
+  disk_cache::SimpleBackendImpl* simple_cache_impl_;
 
   uint32 mask_;
   int size_;
   net::CacheType type_;
   bool memory_only_;
+  bool simple_cache_mode_;
   bool implementation_;
   bool force_creation_;
   bool new_eviction_;
@@ -156,6 +164,7 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   void InitMemoryCache();
   void InitDiskCache();
   void InitDiskCacheImpl();
+  void InitSimpleCache();
 
   base::Thread cache_thread_;
   DISALLOW_COPY_AND_ASSIGN(DiskCacheTestWithCache);
@@ -510,6 +510,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyExternalAsyncIO) {
   ExternalAsyncIO();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheExternalAsyncIO) {
+  SetSimpleCacheMode();
+  InitCache();
+  ExternalAsyncIO();
+}
+
 void DiskCacheEntryTest::StreamAccess() {
   disk_cache::Entry* entry = NULL;
   ASSERT_EQ(net::OK, CreateEntry("the first key", &entry));
@@ -544,6 +550,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyStreamAccess) {
   StreamAccess();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheStreamAccess) {
+  SetSimpleCacheMode();
+  InitCache();
+  StreamAccess();
+}
+
 void DiskCacheEntryTest::GetKey() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -598,6 +610,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGetKey) {
   GetKey();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheGetKey) {
+  SetSimpleCacheMode();
+  InitCache();
+  GetKey();
+}
+
 void DiskCacheEntryTest::GetTimes() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -735,6 +753,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyGrowData) {
   GrowData();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheGrowData) {
+  SetSimpleCacheMode();
+  InitCache();
+  GrowData();
+}
+
 void DiskCacheEntryTest::TruncateData() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -813,6 +837,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyTruncateData) {
   TruncateData();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheTruncateData) {
+  SetSimpleCacheMode();
+  InitCache();
+  TruncateData();
+}
+
 void DiskCacheEntryTest::ZeroLengthIO() {
   std::string key("the first key");
   disk_cache::Entry* entry;
@@ -869,6 +899,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyZeroLengthIO) {
   ZeroLengthIO();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheZeroLengthIO) {
+  SetSimpleCacheMode();
+  InitCache();
+  ZeroLengthIO();
+}
+
 // Tests that we handle the content correctly when buffering.
 void DiskCacheEntryTest::Buffering() {
   std::string key("the first key");
@@ -1184,6 +1220,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyInvalidData) {
   InvalidData();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheInvalidData) {
+  SetSimpleCacheMode();
+  InitCache();
+  InvalidData();
+}
+
 // Tests that the cache preserves the buffer of an IO operation.
 TEST_F(DiskCacheEntryTest, ReadWriteDestroyBuffer) {
   InitCache();
@@ -1250,6 +1292,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyDoomEntry) {
   DoomNormalEntry();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheDoomEntry) {
+  SetSimpleCacheMode();
+  InitCache();
+  DoomNormalEntry();
+}
+
 // Verify that basic operations work as expected with doomed entries.
 void DiskCacheEntryTest::DoomedEntry() {
   std::string key("the first key");
@@ -1291,6 +1339,12 @@ TEST_F(DiskCacheEntryTest, MemoryOnlyDoomedEntry) {
   DoomedEntry();
 }
 
+TEST_F(DiskCacheEntryTest, SimpleCacheDoomedEntry) {
+  SetSimpleCacheMode();
+  InitCache();
+  DoomedEntry();
+}
+
 // Tests that we discard entries if the data is missing.
 TEST_F(DiskCacheEntryTest, MissingData) {
   SetDirectMode();
@@ -7,8 +7,10 @@
 #include <fcntl.h>
 
 #include "base/bind.h"
+#include "base/lazy_instance.h"
 #include "base/location.h"
 #include "base/logging.h"
+#include "base/threading/thread_local.h"
 #include "base/threading/worker_pool.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/disk_cache.h"
@@ -146,22 +148,28 @@ void FileInFlightIO::OnOperationComplete(disk_cache::BackgroundIO* operation,
   callback->OnFileIOComplete(bytes);
 }
 
-// A static object tha will broker all async operations.
-FileInFlightIO* s_file_operations = NULL;
+// The objects that broker all async operations, one per cache thread (a
+// sharded backend runs several caches, each on its own thread, and the
+// completion of an operation must be delivered to the thread that started it).
+base::LazyInstance<base::ThreadLocalPointer<FileInFlightIO> >::Leaky
+    s_file_operations = LAZY_INSTANCE_INITIALIZER;
 
 // Returns the current FileInFlightIO.
 FileInFlightIO* GetFileInFlightIO() {
-  if (!s_file_operations) {
-    s_file_operations = new FileInFlightIO;
+  FileInFlightIO* file_operations = s_file_operations.Pointer()->Get();
+  if (!file_operations) {
+    file_operations = new FileInFlightIO;
+    s_file_operations.Pointer()->Set(file_operations);
   }
-  return s_file_operations;
+  return file_operations;
 }
 
 // Deletes the current FileInFlightIO.
 void DeleteFileInFlightIO() {
-  DCHECK(s_file_operations);
-  delete s_file_operations;
-  s_file_operations = NULL;
+  FileInFlightIO* file_operations = s_file_operations.Pointer()->Get();
+  DCHECK(file_operations);
+  delete file_operations;
+  s_file_operations.Pointer()->Set(NULL);
 }
 
 }  // namespace
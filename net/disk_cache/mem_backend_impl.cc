@@ -5,6 +5,7 @@
 #include "net/disk_cache/mem_backend_impl.h"
 
 #include "base/logging.h"
+#include "base/string_number_conversions.h"
 #include "base/sys_info.h"
 #include "net/base/net_errors.h"
 #include "net/disk_cache/cache_util.h"
@@ -188,6 +189,22 @@ void MemBackendImpl::EndEnumeration(void** iter) {
   *iter = NULL;
 }
 
+void MemBackendImpl::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  stats->push_back(std::make_pair(std::string("Entries"),
+                                  base::IntToString(GetEntryCount())));
+  stats->push_back(std::make_pair(std::string("Size"),
+                                  base::IntToString(current_size_)));
+  stats->push_back(std::make_pair(std::string("Max size"),
+                                  base::IntToString(max_size_)));
+  stats->push_back(std::make_pair(
+      std::string("Reserved memory"),
+      base::Int64ToString(chunk_pool_.reserved_bytes())));
+  stats->push_back(std::make_pair(
+      std::string("Chunk memory"),
+      base::Int64ToString(chunk_pool_.used_bytes())));
+}
+
 void MemBackendImpl::OnExternalCacheHit(const std::string& key) {
   EntryMap::iterator it = entries_.find(key);
   if (it != entries_.end()) {
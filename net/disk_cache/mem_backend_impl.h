@@ -11,6 +11,7 @@
 #include "base/compiler_specific.h"
 #include "base/hash_tables.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/mem_chunks.h"
 #include "net/disk_cache/mem_rankings.h"
 
 namespace net {
@@ -53,6 +54,9 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   // Returns the maximum size for a file to reside on the cache.
   int MaxFileSize() const;
 
+  // Returns the pool of memory for the data of the entries.
+  MemChunkPool* chunk_pool() { return &chunk_pool_; }
+
   // Insert an MemEntryImpl into the ranking list. This method is only called
   // from MemEntryImpl to insert child entries. The reference can be removed
   // by calling RemoveFromRankingList(|entry|).
@@ -80,7 +84,7 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
                             const CompletionCallback& callback) OVERRIDE;
   virtual void EndEnumeration(void** iter) OVERRIDE;
   virtual void GetStats(
-      std::vector<std::pair<std::string, std::string> >* stats) OVERRIDE {}
+      std::vector<std::pair<std::string, std::string> >* stats) OVERRIDE;
   virtual void OnExternalCacheHit(const std::string& key) OVERRIDE;
 
  private:
@@ -105,6 +109,7 @@ class NET_EXPORT_PRIVATE MemBackendImpl : public Backend {
   void AddStorageSize(int32 bytes);
   void SubstractStorageSize(int32 bytes);
 
+  MemChunkPool chunk_pool_;  // Must outlive the entries.
   EntryMap entries_;
   MemRankings rankings_;  // Rankings to be able to trim the cache.
   int32 max_size_;        // Maximum data size for this instance.
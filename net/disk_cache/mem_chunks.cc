@@ -0,0 +1,233 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/mem_chunks.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "base/bits.h"
+#include "base/logging.h"
+
+namespace {
+
+// The chunks of a buffer double in size up to kMaxChunkSize. The last chunk
+// that does so is kLastDoublingChunk, which ends at kDoublingBytes.
+const int kLastDoublingChunk = disk_cache::MemChunkPool::kNumSizeClasses;
+const int kDoublingBytes = disk_cache::MemChunkPool::kMaxChunkSize * 2;
+
+}  // namespace
+
+namespace disk_cache {
+
+struct MemChunkPool::Slab {
+  char* data;
+  int size_class;
+  int used_chunks;
+  int carved_chunks;  // The chunks past this one have never been used.
+  char* free_chunks;  // Each free chunk starts with the address of the next.
+  Slab* prev;  // In the list of slabs with free chunks.
+  Slab* next;
+};
+
+MemChunkPool::MemChunkPool() : reserved_bytes_(0), used_bytes_(0) {
+  for (int i = 0; i < kNumSizeClasses; i++)
+    free_slabs_[i] = NULL;
+}
+
+MemChunkPool::~MemChunkPool() {
+  DCHECK(!used_bytes_);
+  while (!slabs_.empty())
+    DeleteSlab(slabs_.begin()->second);
+}
+
+char* MemChunkPool::Allocate(int size_class) {
+  DCHECK_GE(size_class, 0);
+  DCHECK_LT(size_class, kNumSizeClasses);
+  Slab* slab = free_slabs_[size_class];
+  if (!slab)
+    slab = CreateSlab(size_class);
+
+  int chunk_size = GetChunkSize(size_class);
+  char* chunk;
+  if (slab->free_chunks) {
+    chunk = slab->free_chunks;
+    memcpy(&slab->free_chunks, chunk, sizeof(chunk));
+  } else {
+    chunk = slab->data + slab->carved_chunks * chunk_size;
+    slab->carved_chunks++;
+  }
+
+  slab->used_chunks++;
+  used_bytes_ += chunk_size;
+  if (slab->used_chunks == kSlabSize / chunk_size)
+    UnlinkSlab(slab);
+  return chunk;
+}
+
+void MemChunkPool::Free(int size_class, char* chunk) {
+  std::map<char*, Slab*>::iterator it = slabs_.upper_bound(chunk);
+  DCHECK(it != slabs_.begin());
+  Slab* slab = (--it)->second;
+  DCHECK_EQ(size_class, slab->size_class);
+  DCHECK_LT(chunk, slab->data + kSlabSize);
+
+  int chunk_size = GetChunkSize(size_class);
+  if (slab->used_chunks == kSlabSize / chunk_size)
+    LinkSlab(slab);
+  memcpy(chunk, &slab->free_chunks, sizeof(chunk));
+  slab->free_chunks = chunk;
+  slab->used_chunks--;
+  used_bytes_ -= chunk_size;
+
+  // Keep one slab around, to avoid thrashing when a single chunk comes and
+  // goes.
+  if (!slab->used_chunks &&
+      (free_slabs_[size_class] != slab || slab->next)) {
+    UnlinkSlab(slab);
+    DeleteSlab(slab);
+  }
+}
+
+MemChunkPool::Slab* MemChunkPool::CreateSlab(int size_class) {
+  Slab* slab = new Slab;
+  slab->data = new char[kSlabSize];
+  slab->size_class = size_class;
+  slab->used_chunks = 0;
+  slab->carved_chunks = 0;
+  slab->free_chunks = NULL;
+  slab->prev = NULL;
+  slab->next = NULL;
+  slabs_[slab->data] = slab;
+  reserved_bytes_ += kSlabSize;
+  LinkSlab(slab);
+  return slab;
+}
+
+void MemChunkPool::DeleteSlab(Slab* slab) {
+  slabs_.erase(slab->data);
+  reserved_bytes_ -= kSlabSize;
+  delete[] slab->data;
+  delete slab;
+}
+
+void MemChunkPool::LinkSlab(Slab* slab) {
+  Slab*& head = free_slabs_[slab->size_class];
+  slab->prev = NULL;
+  slab->next = head;
+  if (head)
+    head->prev = slab;
+  head = slab;
+}
+
+void MemChunkPool::UnlinkSlab(Slab* slab) {
+  if (slab->prev)
+    slab->prev->next = slab->next;
+  else
+    free_slabs_[slab->size_class] = slab->next;
+  if (slab->next)
+    slab->next->prev = slab->prev;
+  slab->prev = NULL;
+  slab->next = NULL;
+}
+
+// ------------------------------------------------------------------------
+
+MemChunkedBuffer::MemChunkedBuffer() : pool_(NULL) {
+}
+
+MemChunkedBuffer::~MemChunkedBuffer() {
+  Shrink(0);
+}
+
+void MemChunkedBuffer::Init(MemChunkPool* pool) {
+  DCHECK(!pool_);
+  pool_ = pool;
+}
+
+void MemChunkedBuffer::Reserve(int size) {
+  DCHECK(pool_);
+  while (capacity() < size)
+    chunks_.push_back(pool_->Allocate(GetSizeClass(chunks_.size())));
+}
+
+void MemChunkedBuffer::Shrink(int size) {
+  size_t num_chunks = size ? GetChunkIndex(size - 1) + 1 : 0;
+  while (chunks_.size() > num_chunks) {
+    pool_->Free(GetSizeClass(chunks_.size() - 1), chunks_.back());
+    chunks_.pop_back();
+  }
+}
+
+void MemChunkedBuffer::Read(int offset, char* data, int len) const {
+  DCHECK_LE(offset + len, capacity());
+  while (len) {
+    size_t index = GetChunkIndex(offset);
+    int chunk_offset = offset - GetChunkStart(index);
+    int bytes = std::min(len, GetChunkStart(index + 1) - offset);
+    memcpy(data, chunks_[index] + chunk_offset, bytes);
+    data += bytes;
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+void MemChunkedBuffer::Write(int offset, const char* data, int len) {
+  DCHECK_LE(offset + len, capacity());
+  while (len) {
+    size_t index = GetChunkIndex(offset);
+    int chunk_offset = offset - GetChunkStart(index);
+    int bytes = std::min(len, GetChunkStart(index + 1) - offset);
+    memcpy(chunks_[index] + chunk_offset, data, bytes);
+    data += bytes;
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+void MemChunkedBuffer::Clear(int offset, int len) {
+  DCHECK_LE(offset + len, capacity());
+  while (len) {
+    size_t index = GetChunkIndex(offset);
+    int chunk_offset = offset - GetChunkStart(index);
+    int bytes = std::min(len, GetChunkStart(index + 1) - offset);
+    memset(chunks_[index] + chunk_offset, 0, bytes);
+    offset += bytes;
+    len -= bytes;
+  }
+}
+
+// Static.
+int MemChunkedBuffer::GetChunkStart(size_t index) {
+  if (!index)
+    return 0;
+  if (index <= static_cast<size_t>(kLastDoublingChunk))
+    return MemChunkPool::kMinChunkSize << (index - 1);
+  return kDoublingBytes +
+         static_cast<int>(index - kLastDoublingChunk - 1) *
+             MemChunkPool::kMaxChunkSize;
+}
+
+// Static.
+size_t MemChunkedBuffer::GetChunkIndex(int offset) {
+  DCHECK_GE(offset, 0);
+  if (offset < MemChunkPool::kMinChunkSize)
+    return 0;
+  if (offset < kDoublingBytes) {
+    return base::bits::Log2Floor(offset) - MemChunkPool::kMinChunkShift + 1;
+  }
+  return kLastDoublingChunk + 1 +
+         (offset - kDoublingBytes) / MemChunkPool::kMaxChunkSize;
+}
+
+// Static.
+int MemChunkedBuffer::GetSizeClass(size_t index) {
+  if (!index)
+    return 0;
+  return std::min(static_cast<int>(index) - 1,
+                  MemChunkPool::kNumSizeClasses - 1);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,111 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface.
+
+#ifndef NET_DISK_CACHE_MEM_CHUNKS_H_
+#define NET_DISK_CACHE_MEM_CHUNKS_H_
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// This class hands out the blocks of memory that hold the data of the
+// memory-only cache. Chunks come in a few sizes (the size classes, from
+// kMinChunkSize to kMaxChunkSize), and are carved out of 64 KB slabs, each
+// one dedicated to a single size class. Chunks of the same size are reused
+// no matter which entry freed them, so the data of the cache does not
+// fragment the heap, and a slab is given back as soon as it is empty (unless
+// it is the last one of its size class with free chunks).
+class NET_EXPORT_PRIVATE MemChunkPool {
+ public:
+  enum {
+    kMinChunkShift = 8,
+    kMinChunkSize = 1 << kMinChunkShift,
+    kNumSizeClasses = 5,
+    kMaxChunkSize = kMinChunkSize << (kNumSizeClasses - 1),
+    kSlabSize = 64 * 1024
+  };
+
+  MemChunkPool();
+  ~MemChunkPool();
+
+  static int GetChunkSize(int size_class) {
+    return kMinChunkSize << size_class;
+  }
+
+  char* Allocate(int size_class);
+  void Free(int size_class, char* chunk);
+
+  // The memory taken by the slabs, and the part of it handed out as chunks.
+  int64 reserved_bytes() const { return reserved_bytes_; }
+  int64 used_bytes() const { return used_bytes_; }
+
+ private:
+  struct Slab;
+
+  Slab* CreateSlab(int size_class);
+  void DeleteSlab(Slab* slab);
+
+  // Adds or removes |slab| from the list of slabs with free chunks.
+  void LinkSlab(Slab* slab);
+  void UnlinkSlab(Slab* slab);
+
+  std::map<char*, Slab*> slabs_;  // By address, to find the slab of a chunk.
+  Slab* free_slabs_[kNumSizeClasses];  // The slabs with free chunks.
+  int64 reserved_bytes_;
+  int64 used_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemChunkPool);
+};
+
+// This class holds the data of one stream of a memory-only entry as a list of
+// chunks from a MemChunkPool. The chunks double in size up to kMaxChunkSize,
+// so a small stream wastes little memory, and growing a stream never copies
+// the data that is already there.
+class NET_EXPORT_PRIVATE MemChunkedBuffer {
+ public:
+  MemChunkedBuffer();
+  ~MemChunkedBuffer();
+
+  // Sets the pool of the chunks. Must be called before anything else.
+  void Init(MemChunkPool* pool);
+
+  // The number of bytes that can be stored without allocating more chunks.
+  int capacity() const { return GetChunkStart(chunks_.size()); }
+
+  // Makes sure that there is room for |size| bytes.
+  void Reserve(int size);
+
+  // Frees the chunks that are not needed to store |size| bytes.
+  void Shrink(int size);
+
+  // Copies data to or from the buffer, which must have enough capacity.
+  void Read(int offset, char* data, int len) const;
+  void Write(int offset, const char* data, int len);
+  void Clear(int offset, int len);
+
+ private:
+  // Returns the offset of the first byte of the chunk |index|.
+  static int GetChunkStart(size_t index);
+
+  // Returns the index of the chunk that holds the byte at |offset|.
+  static size_t GetChunkIndex(int offset);
+
+  static int GetSizeClass(size_t index);
+
+  MemChunkPool* pool_;
+  std::vector<char*> chunks_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemChunkedBuffer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_MEM_CHUNKS_H_
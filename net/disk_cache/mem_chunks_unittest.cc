@@ -0,0 +1,134 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/mem_chunks.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using disk_cache::MemChunkPool;
+using disk_cache::MemChunkedBuffer;
+
+TEST(MemChunkPoolTest, Basics) {
+  MemChunkPool pool;
+  EXPECT_EQ(0, pool.reserved_bytes());
+
+  char* chunk1 = pool.Allocate(0);
+  char* chunk2 = pool.Allocate(0);
+  ASSERT_TRUE(chunk1 && chunk2);
+  EXPECT_NE(chunk1, chunk2);
+  EXPECT_EQ(MemChunkPool::kSlabSize, pool.reserved_bytes());
+  EXPECT_EQ(2 * MemChunkPool::kMinChunkSize, pool.used_bytes());
+
+  // The chunks are independent.
+  memset(chunk1, 1, MemChunkPool::kMinChunkSize);
+  memset(chunk2, 2, MemChunkPool::kMinChunkSize);
+  EXPECT_EQ(1, chunk1[MemChunkPool::kMinChunkSize - 1]);
+
+  // A different size comes from a different slab.
+  char* chunk3 = pool.Allocate(MemChunkPool::kNumSizeClasses - 1);
+  EXPECT_EQ(2 * MemChunkPool::kSlabSize, pool.reserved_bytes());
+
+  // Freed chunks are reused.
+  pool.Free(0, chunk1);
+  EXPECT_EQ(chunk1, pool.Allocate(0));
+
+  pool.Free(0, chunk1);
+  pool.Free(0, chunk2);
+  pool.Free(MemChunkPool::kNumSizeClasses - 1, chunk3);
+  EXPECT_EQ(0, pool.used_bytes());
+}
+
+// Tests that empty slabs are given back.
+TEST(MemChunkPoolTest, ReleaseSlabs) {
+  MemChunkPool pool;
+  const int kSizeClass = MemChunkPool::kNumSizeClasses - 1;
+  const int kChunksPerSlab =
+      MemChunkPool::kSlabSize / MemChunkPool::GetChunkSize(kSizeClass);
+  const int kNumSlabs = 10;
+
+  std::vector<char*> chunks;
+  for (int i = 0; i < kChunksPerSlab * kNumSlabs; i++)
+    chunks.push_back(pool.Allocate(kSizeClass));
+  EXPECT_EQ(kNumSlabs * MemChunkPool::kSlabSize, pool.reserved_bytes());
+  EXPECT_EQ(pool.reserved_bytes(), pool.used_bytes());
+
+  for (size_t i = 0; i < chunks.size(); i++)
+    pool.Free(kSizeClass, chunks[i]);
+
+  // One slab is kept.
+  EXPECT_EQ(0, pool.used_bytes());
+  EXPECT_EQ(MemChunkPool::kSlabSize, pool.reserved_bytes());
+}
+
+TEST(MemChunkedBufferTest, ReadWrite) {
+  MemChunkPool pool;
+  MemChunkedBuffer buffer;
+  buffer.Init(&pool);
+  EXPECT_EQ(0, buffer.capacity());
+
+  const int kSize = 100 * 1024;
+  std::vector<char> data(kSize);
+  CacheTestFillBuffer(&data[0], kSize, false);
+
+  // Write in pieces of odd sizes, that straddle chunks.
+  for (int offset = 0; offset < kSize; offset += 999) {
+    int len = std::min(999, kSize - offset);
+    buffer.Reserve(offset + len);
+    buffer.Write(offset, &data[offset], len);
+  }
+  EXPECT_LE(kSize, buffer.capacity());
+  EXPECT_GT(kSize + MemChunkPool::kMaxChunkSize, buffer.capacity());
+
+  std::vector<char> result(kSize);
+  buffer.Read(0, &result[0], kSize);
+  EXPECT_EQ(0, memcmp(&data[0], &result[0], kSize));
+
+  memset(&result[0], 0, kSize);
+  buffer.Read(5000, &result[0], 20000);
+  EXPECT_EQ(0, memcmp(&data[5000], &result[0], 20000));
+
+  buffer.Clear(100, 10000);
+  buffer.Read(0, &result[0], 20000);
+  EXPECT_EQ(0, memcmp(&data[0], &result[0], 100));
+  EXPECT_EQ(std::vector<char>(10000, 0),
+            std::vector<char>(&result[100], &result[10100]));
+  EXPECT_EQ(0, memcmp(&data[10100], &result[10100], 9900));
+}
+
+// Tests that small buffers take little memory, and that shrinking a buffer
+// frees its memory.
+TEST(MemChunkedBufferTest, Capacity) {
+  MemChunkPool pool;
+  MemChunkedBuffer buffer;
+  buffer.Init(&pool);
+
+  buffer.Reserve(1);
+  EXPECT_EQ(MemChunkPool::kMinChunkSize, buffer.capacity());
+  buffer.Reserve(MemChunkPool::kMinChunkSize + 1);
+  EXPECT_EQ(2 * MemChunkPool::kMinChunkSize, buffer.capacity());
+
+  // The capacity doubles up to the largest chunk size.
+  for (int size = 2 * MemChunkPool::kMinChunkSize;
+       size <= MemChunkPool::kMaxChunkSize; size *= 2) {
+    buffer.Reserve(size + 1);
+    EXPECT_EQ(size * 2, buffer.capacity());
+  }
+  buffer.Reserve(10 * MemChunkPool::kMaxChunkSize);
+  EXPECT_EQ(10 * MemChunkPool::kMaxChunkSize, buffer.capacity());
+  EXPECT_EQ(buffer.capacity(), pool.used_bytes());
+
+  buffer.Shrink(MemChunkPool::kMinChunkSize);
+  EXPECT_EQ(MemChunkPool::kMinChunkSize, buffer.capacity());
+  EXPECT_EQ(MemChunkPool::kMinChunkSize, pool.used_bytes());
+
+  buffer.Shrink(0);
+  EXPECT_EQ(0, buffer.capacity());
+  EXPECT_EQ(0, pool.used_bytes());
+}
@@ -54,8 +54,10 @@ MemEntryImpl::MemEntryImpl(MemBackendImpl* backend) {
   child_first_pos_ = 0;
   next_ = NULL;
   prev_ = NULL;
-  for (int i = 0; i < NUM_STREAMS; i++)
+  for (int i = 0; i < NUM_STREAMS; i++) {
+    data_[i].Init(backend->chunk_pool());
     data_size_[i] = 0;
+  }
 }
 
 // ------------------------------------------------------------------------
@@ -286,7 +288,7 @@ int MemEntryImpl::InternalReadData(int index, int offset, IOBuffer* buf,
 
   UpdateRank(false);
 
-  memcpy(buf->data(), &(data_[index])[offset], buf_len);
+  data_[index].Read(offset, buf->data(), buf_len);
   return buf_len;
 }
 
@@ -320,6 +322,7 @@ int MemEntryImpl::InternalWriteData(int index, int offset, IOBuffer* buf,
     if (entry_size > offset + buf_len) {
       backend_->ModifyStorageSize(entry_size, offset + buf_len);
       data_size_[index] = offset + buf_len;
+      data_[index].Shrink(offset + buf_len);
     }
   }
 
@@ -328,7 +331,7 @@ int MemEntryImpl::InternalWriteData(int index, int offset, IOBuffer* buf,
   if (!buf_len)
     return 0;
 
-  memcpy(&(data_[index])[offset], buf->data(), buf_len);
+  data_[index].Write(offset, buf->data(), buf_len);
   return buf_len;
 }
 
@@ -507,15 +510,14 @@ void MemEntryImpl::PrepareTarget(int index, int offset, int buf_len) {
   if (entry_size >= offset + buf_len)
     return;  // Not growing the stored data.
 
-  if (static_cast<int>(data_[index].size()) < offset + buf_len)
-    data_[index].resize(offset + buf_len);
+  data_[index].Reserve(offset + buf_len);
 
   if (offset <= entry_size)
     return;  // There is no "hole" on the stored data.
 
   // Cleanup the hole not written by the user. The point is to avoid returning
   // random stuff later on.
-  memset(&(data_[index])[entry_size], 0, offset - entry_size);
+  data_[index].Clear(entry_size, offset - entry_size);
 }
 
 void MemEntryImpl::UpdateRank(bool modified) {
@@ -11,6 +11,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "net/base/net_log.h"
 #include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/mem_chunks.h"
 
 namespace disk_cache {
 
@@ -163,7 +164,7 @@ class MemEntryImpl : public Entry {
   void DetachChild(int child_id);
 
   std::string key_;
-  std::vector<char> data_[NUM_STREAMS];  // User data.
+  MemChunkedBuffer data_[NUM_STREAMS];  // User data.
   int32 data_size_[NUM_STREAMS];
   int ref_count_;
 
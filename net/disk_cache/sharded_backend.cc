@@ -0,0 +1,339 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/sharded_backend.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/stringprintf.h"
+#include "base/sys_info.h"
+#include "base/threading/thread.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/hash.h"
+#include "net/disk_cache/trace.h"
+
+namespace {
+
+// Figures out the size of the whole cache the way BackendImpl does it for a
+// single cache, counting the space used by the shards as available. Runs on
+// the thread of the first shard.
+void ComputeMaxSize(const FilePath& path, int* max_bytes) {
+  file_util::CreateDirectory(path);
+  int64 available = base::SysInfo::AmountOfFreeDiskSpace(path);
+  if (available < 0)
+    return;  // Let each shard decide.
+
+  available += file_util::ComputeDirectorySize(path);
+  *max_bytes = disk_cache::PreferedCacheSize(available);
+}
+
+// Collects the results of an operation that is performed by every shard, and
+// runs the callback of the operation with the first error reported by a
+// shard (or OK) when all of them are done.
+class ShardedOperation : public base::RefCounted<ShardedOperation> {
+ public:
+  explicit ShardedOperation(const net::CompletionCallback& callback)
+      : pending_(1), result_(net::OK), callback_(callback) {
+  }
+
+  // Returns the callback to pass to the next shard.
+  net::CompletionCallback AddShard() {
+    pending_++;
+    return base::Bind(&ShardedOperation::OnShardComplete, this);
+  }
+
+  // Accounts for the completion of the operation on one shard.
+  void OnShardComplete(int result) {
+    DCHECK_NE(net::ERR_IO_PENDING, result);
+    if (result_ == net::OK)
+      result_ = result;
+    if (!--pending_)
+      callback_.Run(result_);
+  }
+
+  // Called once the operation was handed to all the shards. Returns the final
+  // result if every shard is done, or ERR_IO_PENDING if the callback will be
+  // invoked later.
+  int WaitForShards() {
+    if (--pending_)
+      return net::ERR_IO_PENDING;
+    return result_;
+  }
+
+ private:
+  friend class base::RefCounted<ShardedOperation>;
+  ~ShardedOperation() {}
+
+  int pending_;
+  int result_;
+  net::CompletionCallback callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedOperation);
+};
+
+}  // namespace
+
+namespace disk_cache {
+
+ShardedBackend::ShardedBackend(const FilePath& path, bool force, int max_bytes,
+                               net::CacheType type, uint32 flags,
+                               net::NetLog* net_log)
+    : path_(path),
+      force_(force),
+      max_bytes_(max_bytes),
+      type_(type),
+      flags_(flags),
+      net_log_(net_log),
+      backend_(NULL),
+      new_shard_(NULL),
+      ALLOW_THIS_IN_INITIALIZER_LIST(ptr_factory_(this)) {
+}
+
+ShardedBackend::~ShardedBackend() {
+  // Each shard finishes its work on its own thread as it is deleted, and then
+  // the threads are stopped.
+  ptr_factory_.InvalidateWeakPtrs();
+  shards_.reset();
+  threads_.reset();
+}
+
+// Static.
+int ShardedBackend::CreateBackend(const FilePath& path, int num_shards,
+                                  bool force, int max_bytes,
+                                  net::CacheType type, uint32 flags,
+                                  net::NetLog* net_log, Backend** backend,
+                                  const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  DCHECK_NE(net::MEMORY_CACHE, type);
+  ShardedBackend* cache =
+      new ShardedBackend(path, force, max_bytes, type, flags, net_log);
+  int rv = cache->Init(num_shards, backend, callback);
+  if (rv != net::ERR_IO_PENDING) {
+    // The object is only deleted by itself once the creation is under way.
+    *backend = NULL;
+    delete cache;
+  }
+  return rv;
+}
+
+int ShardedBackend::GetShardIndex(const std::string& key) const {
+  // The index of each shard uses the low bits of the hash, so the shard is
+  // selected with the high bits.
+  uint64 hash = Hash(key);
+  return static_cast<int>((hash * shards_.size()) >> 32);
+}
+
+BackendImpl* ShardedBackend::GetShardForTest(int index) {
+  return shards_[index];
+}
+
+int32 ShardedBackend::GetEntryCount() const {
+  int32 count = 0;
+  for (size_t i = 0; i < shards_.size(); i++)
+    count += shards_[i]->GetEntryCount();
+  return count;
+}
+
+int ShardedBackend::OpenEntry(const std::string& key, Entry** entry,
+                              const CompletionCallback& callback) {
+  return shards_[GetShardIndex(key)]->OpenEntry(key, entry, callback);
+}
+
+int ShardedBackend::CreateEntry(const std::string& key, Entry** entry,
+                                const CompletionCallback& callback) {
+  return shards_[GetShardIndex(key)]->CreateEntry(key, entry, callback);
+}
+
+int ShardedBackend::DoomEntry(const std::string& key,
+                              const CompletionCallback& callback) {
+  return shards_[GetShardIndex(key)]->DoomEntry(key, callback);
+}
+
+int ShardedBackend::DoomAllEntries(const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  scoped_refptr<ShardedOperation> operation(new ShardedOperation(callback));
+  for (size_t i = 0; i < shards_.size(); i++) {
+    int rv = shards_[i]->DoomAllEntries(operation->AddShard());
+    if (rv != net::ERR_IO_PENDING)
+      operation->OnShardComplete(rv);
+  }
+  return operation->WaitForShards();
+}
+
+int ShardedBackend::DoomEntriesBetween(const base::Time initial_time,
+                                       const base::Time end_time,
+                                       const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  scoped_refptr<ShardedOperation> operation(new ShardedOperation(callback));
+  for (size_t i = 0; i < shards_.size(); i++) {
+    int rv = shards_[i]->DoomEntriesBetween(initial_time, end_time,
+                                            operation->AddShard());
+    if (rv != net::ERR_IO_PENDING)
+      operation->OnShardComplete(rv);
+  }
+  return operation->WaitForShards();
+}
+
+int ShardedBackend::DoomEntriesSince(const base::Time initial_time,
+                                     const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  scoped_refptr<ShardedOperation> operation(new ShardedOperation(callback));
+  for (size_t i = 0; i < shards_.size(); i++) {
+    int rv = shards_[i]->DoomEntriesSince(initial_time, operation->AddShard());
+    if (rv != net::ERR_IO_PENDING)
+      operation->OnShardComplete(rv);
+  }
+  return operation->WaitForShards();
+}
+
+int ShardedBackend::OpenNextEntry(void** iter, Entry** next_entry,
+                                  const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  if (!*iter)
+    *iter = new Iterator;
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  DCHECK_LT(iterator->shard, num_shards());
+
+  return shards_[iterator->shard]->OpenNextEntry(
+      &iterator->shard_iter, next_entry,
+      base::Bind(&ShardedBackend::OnNextEntry, ptr_factory_.GetWeakPtr(), iter,
+                 next_entry, callback));
+}
+
+void ShardedBackend::EndEnumeration(void** iter) {
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  *iter = NULL;
+  if (!iterator)
+    return;
+
+  if (iterator->shard_iter)
+    shards_[iterator->shard]->EndEnumeration(&iterator->shard_iter);
+  delete iterator;
+}
+
+void ShardedBackend::GetStats(StatsItems* stats) {
+  for (size_t i = 0; i < shards_.size(); i++) {
+    StatsItems shard_stats;
+    shards_[i]->GetStats(&shard_stats);
+    for (size_t j = 0; j < shard_stats.size(); j++) {
+      stats->push_back(std::make_pair(
+          base::StringPrintf("Shard %d: %s", static_cast<int>(i),
+                             shard_stats[j].first.c_str()),
+          shard_stats[j].second));
+    }
+  }
+}
+
+void ShardedBackend::OnExternalCacheHit(const std::string& key) {
+  shards_[GetShardIndex(key)]->OnExternalCacheHit(key);
+}
+
+// ------------------------------------------------------------------------
+
+int ShardedBackend::Init(int num_shards, Backend** backend,
+                         const CompletionCallback& callback) {
+  DCHECK_GT(num_shards, 0);
+  for (int i = 0; i < num_shards; i++) {
+    base::Thread* thread =
+        new base::Thread(base::StringPrintf("CacheThread_%d", i).c_str());
+    threads_.push_back(thread);
+    if (!thread->StartWithOptions(
+            base::Thread::Options(MessageLoop::TYPE_IO, 0))) {
+      return net::ERR_FAILED;
+    }
+  }
+
+  backend_ = backend;
+  init_callback_ = callback;
+  trace_object_ = TraceObject::GetTraceObject();
+
+  if (max_bytes_) {
+    CreateNextShard();
+    return net::ERR_IO_PENDING;
+  }
+
+  int* max_bytes = new int(0);
+  threads_[0]->message_loop_proxy()->PostTaskAndReply(
+      FROM_HERE, base::Bind(&ComputeMaxSize, path_, max_bytes),
+      base::Bind(&ShardedBackend::OnMaxSizeComputed, base::Unretained(this),
+                 base::Owned(max_bytes)));
+  return net::ERR_IO_PENDING;
+}
+
+void ShardedBackend::CreateNextShard() {
+  size_t index = shards_.size();
+  if (index == threads_.size())
+    return OnInitComplete(net::OK);
+
+  // A zero size would let the shard pick its own size.
+  int max_bytes = 0;
+  if (max_bytes_)
+    max_bytes = std::max(max_bytes_ / static_cast<int>(threads_.size()), 1);
+
+  shard_path_ = path_.AppendASCII(
+      base::StringPrintf("shard_%d", static_cast<int>(index)));
+  int rv = BackendImpl::CreateBackend(
+      shard_path_, force_, max_bytes, type_, flags_,
+      threads_[index]->message_loop_proxy(), net_log_, &new_shard_,
+      base::Bind(&ShardedBackend::OnShardCreated, base::Unretained(this)));
+  if (rv != net::ERR_IO_PENDING)
+    OnShardCreated(rv);
+}
+
+void ShardedBackend::OnShardCreated(int result) {
+  if (result != net::OK)
+    return OnInitComplete(result);
+
+  shards_.push_back(static_cast<BackendImpl*>(new_shard_));
+  new_shard_ = NULL;
+  CreateNextShard();
+}
+
+void ShardedBackend::OnInitComplete(int result) {
+  DCHECK_NE(net::ERR_IO_PENDING, result);
+  CompletionCallback callback = init_callback_;
+  init_callback_.Reset();
+  if (result == net::OK) {
+    *backend_ = this;
+  } else {
+    LOG(ERROR) << "Unable to create sharded cache";
+    *backend_ = NULL;
+    delete this;
+  }
+  callback.Run(result);
+}
+
+void ShardedBackend::OnMaxSizeComputed(const int* max_bytes) {
+  max_bytes_ = *max_bytes;
+  CreateNextShard();
+}
+
+void ShardedBackend::OnNextEntry(void** iter, Entry** next_entry,
+                                 const CompletionCallback& callback,
+                                 int result) {
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  if (result != net::OK) {
+    // This shard is done, move on to the next one.
+    if (iterator->shard_iter)
+      shards_[iterator->shard]->EndEnumeration(&iterator->shard_iter);
+    iterator->shard++;
+    if (iterator->shard < num_shards()) {
+      result = OpenNextEntry(iter, next_entry, callback);
+      if (result == net::ERR_IO_PENDING)
+        return;
+    } else {
+      delete iterator;
+      *iter = NULL;
+    }
+  }
+  callback.Run(result);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,145 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_SHARDED_BACKEND_H_
+#define NET_DISK_CACHE_SHARDED_BACKEND_H_
+#pragma once
+
+#include <string>
+
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
+#include "base/memory/weak_ptr.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/stats.h"
+
+namespace base {
+class Thread;
+}
+
+namespace net {
+class NetLog;
+}  // namespace net
+
+namespace disk_cache {
+
+class BackendImpl;
+class TraceObject;
+
+// This class implements the Backend interface on top of a number of
+// independent BackendImpl instances (shards), each one with its own index,
+// rankings, block files and cache thread. Entries are assigned to a shard by
+// the hash of their key, so operations on different entries proceed in
+// parallel instead of being serialized on a single cache thread.
+//
+// Shard |i| lives on the folder "shard_i" under the path of the cache. The
+// number of shards is part of the layout of the files: reopening a cache with
+// a different number of shards leaves some entries out of reach, until they
+// are evicted.
+class NET_EXPORT_PRIVATE ShardedBackend : public Backend {
+ public:
+  virtual ~ShardedBackend();
+
+  // Returns a new backend split in |num_shards| shards, with the same
+  // arguments as CreateCacheBackend() plus the BackendFlags of BackendImpl.
+  // |max_bytes| is divided evenly among the shards. The threads of the shards
+  // are owned by the backend, so there is no thread argument.
+  static int CreateBackend(const FilePath& path, int num_shards, bool force,
+                           int max_bytes, net::CacheType type, uint32 flags,
+                           net::NetLog* net_log, Backend** backend,
+                           const CompletionCallback& callback);
+
+  int num_shards() const {
+    return static_cast<int>(shards_.size());
+  }
+
+  // Returns the index of the shard that stores |key|.
+  int GetShardIndex(const std::string& key) const;
+
+  // Returns the shard at |index|, for tests.
+  BackendImpl* GetShardForTest(int index);
+
+  // Backend implementation.
+  virtual int32 GetEntryCount() const OVERRIDE;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntry(const std::string& key,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomAllEntries(const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               const CompletionCallback& callback) OVERRIDE;
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            const CompletionCallback& callback) OVERRIDE;
+  virtual void EndEnumeration(void** iter) OVERRIDE;
+  virtual void GetStats(StatsItems* stats) OVERRIDE;
+  virtual void OnExternalCacheHit(const std::string& key) OVERRIDE;
+
+ private:
+  // The state of an enumeration, which goes through the shards in order.
+  struct Iterator {
+    Iterator() : shard(0), shard_iter(NULL) {}
+
+    int shard;
+    void* shard_iter;  // The iterator of BackendImpl for |shard|.
+  };
+
+  ShardedBackend(const FilePath& path, bool force, int max_bytes,
+                 net::CacheType type, uint32 flags, net::NetLog* net_log);
+
+  // Starts the threads and the creation of the shards. |backend| and
+  // |callback| are the arguments of CreateBackend().
+  int Init(int num_shards, Backend** backend,
+           const CompletionCallback& callback);
+
+  // Creates the next shard, or reports the result of Init() once all of them
+  // are ready. The shards are created one at a time, because the
+  // initialization of BackendImpl touches state shared by all the caches.
+  void CreateNextShard();
+  void OnShardCreated(int result);
+  void OnInitComplete(int result);
+
+  // Called once the size of the whole cache has been figured out on the
+  // thread of the first shard.
+  void OnMaxSizeComputed(const int* max_bytes);
+
+  // Continues an enumeration once the shard being enumerated returns
+  // |result|.
+  void OnNextEntry(void** iter, Entry** next_entry,
+                   const CompletionCallback& callback, int result);
+
+  FilePath path_;  // The folder where the shards live.
+  bool force_;
+  int max_bytes_;  // Maximum data size for the whole cache.
+  net::CacheType type_;
+  uint32 flags_;
+  net::NetLog* net_log_;
+
+  // State of Init().
+  Backend** backend_;
+  CompletionCallback init_callback_;
+  FilePath shard_path_;  // Must outlive the creation of each shard.
+  Backend* new_shard_;
+
+  ScopedVector<base::Thread> threads_;
+  ScopedVector<BackendImpl> shards_;  // Must be deleted before the threads.
+
+  // Keeps the trace buffer alive while the shards come and go.
+  scoped_refptr<TraceObject> trace_object_;
+  base::WeakPtrFactory<ShardedBackend> ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SHARDED_BACKEND_H_
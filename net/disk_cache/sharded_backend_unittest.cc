@@ -0,0 +1,224 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/sharded_backend.h"
+
+#include <set>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/file_util.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/disk_cache_test_base.h"
+#include "net/disk_cache/disk_cache_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kNumShards = 4;
+const int kNumEntries = 40;
+
+std::string KeyForEntry(int i) {
+  return base::StringPrintf("the key %d", i);
+}
+
+class DiskCacheShardedBackendTest : public DiskCacheTest {
+ protected:
+  DiskCacheShardedBackendTest() : cache_(NULL) {}
+
+  virtual void SetUp() OVERRIDE {
+    DiskCacheTest::SetUp();
+    // CleanupCacheDir() leaves the folders of the shards behind.
+    ASSERT_TRUE(file_util::Delete(cache_path_, true));
+  }
+
+  virtual void TearDown() OVERRIDE {
+    delete cache_;
+    cache_ = NULL;
+    DiskCacheTest::TearDown();
+  }
+
+  void InitCache() {
+    delete cache_;
+    cache_ = NULL;
+    disk_cache::Backend* cache = NULL;
+    net::TestCompletionCallback cb;
+    int rv = disk_cache::ShardedBackend::CreateBackend(
+        cache_path_, kNumShards, false, 10 * 1024 * 1024, net::DISK_CACHE,
+        disk_cache::kNoRandom, NULL, &cache, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    ASSERT_TRUE(cache);
+    cache_ = static_cast<disk_cache::ShardedBackend*>(cache);
+  }
+
+  int OpenEntry(const std::string& key, disk_cache::Entry** entry) {
+    net::TestCompletionCallback cb;
+    int rv = cache_->OpenEntry(key, entry, cb.callback());
+    return cb.GetResult(rv);
+  }
+
+  int CreateEntry(const std::string& key, disk_cache::Entry** entry) {
+    net::TestCompletionCallback cb;
+    int rv = cache_->CreateEntry(key, entry, cb.callback());
+    return cb.GetResult(rv);
+  }
+
+  int OpenNextEntry(void** iter, disk_cache::Entry** next_entry) {
+    net::TestCompletionCallback cb;
+    int rv = cache_->OpenNextEntry(iter, next_entry, cb.callback());
+    return cb.GetResult(rv);
+  }
+
+  // Creates kNumEntries entries, and writes their key to each one, with a
+  // size that requires an external file for some of them.
+  void CreateEntries() {
+    for (int i = 0; i < kNumEntries; i++) {
+      std::string key = KeyForEntry(i);
+      disk_cache::Entry* entry;
+      ASSERT_EQ(net::OK, CreateEntry(key, &entry));
+      int size = (i % 4 == 0) ? 20000 : 500;
+      scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+      CacheTestFillBuffer(buffer->data(), size, false);
+      memcpy(buffer->data(), key.data(), key.size());
+      net::TestCompletionCallback cb;
+      int rv = entry->WriteData(1, 0, buffer, size, cb.callback(), false);
+      EXPECT_EQ(size, cb.GetResult(rv));
+      entry->Close();
+    }
+  }
+
+  disk_cache::ShardedBackend* cache_;
+};
+
+TEST_F(DiskCacheShardedBackendTest, Basics) {
+  InitCache();
+  ASSERT_EQ(kNumShards, cache_->num_shards());
+  CreateEntries();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+
+  // Each entry lives on the shard given by its key, and all the shards are in
+  // use.
+  int entries_per_shard[kNumShards] = {0};
+  for (int i = 0; i < kNumEntries; i++)
+    entries_per_shard[cache_->GetShardIndex(KeyForEntry(i))]++;
+  for (int i = 0; i < kNumShards; i++) {
+    EXPECT_LT(0, entries_per_shard[i]);
+    EXPECT_EQ(entries_per_shard[i],
+              cache_->GetShardForTest(i)->GetEntryCount());
+  }
+
+  // Entries survive a restart.
+  InitCache();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+  for (int i = 0; i < kNumEntries; i++) {
+    std::string key = KeyForEntry(i);
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, OpenEntry(key, &entry));
+    int size = entry->GetDataSize(1);
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+    net::TestCompletionCallback cb;
+    int rv = entry->ReadData(1, 0, buffer, size, cb.callback());
+    EXPECT_EQ(size, cb.GetResult(rv));
+    EXPECT_EQ(key, std::string(buffer->data(), key.size()));
+    entry->Close();
+  }
+
+  net::TestCompletionCallback cb;
+  int rv = cache_->DoomEntry(KeyForEntry(0), cb.callback());
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  disk_cache::Entry* entry;
+  EXPECT_NE(net::OK, OpenEntry(KeyForEntry(0), &entry));
+  EXPECT_EQ(kNumEntries - 1, cache_->GetEntryCount());
+}
+
+// Tests that an enumeration goes through all the shards.
+TEST_F(DiskCacheShardedBackendTest, Enumeration) {
+  InitCache();
+  CreateEntries();
+
+  std::set<std::string> keys;
+  void* iter = NULL;
+  disk_cache::Entry* entry;
+  while (OpenNextEntry(&iter, &entry) == net::OK) {
+    EXPECT_TRUE(keys.insert(entry->GetKey()).second);
+    entry->Close();
+  }
+  EXPECT_TRUE(iter == NULL);
+  EXPECT_EQ(static_cast<size_t>(kNumEntries), keys.size());
+
+  // An enumeration can also be abandoned.
+  ASSERT_EQ(net::OK, OpenNextEntry(&iter, &entry));
+  entry->Close();
+  cache_->EndEnumeration(&iter);
+  EXPECT_TRUE(iter == NULL);
+}
+
+TEST_F(DiskCacheShardedBackendTest, DoomAll) {
+  InitCache();
+  CreateEntries();
+
+  net::TestCompletionCallback cb;
+  int rv = cache_->DoomAllEntries(cb.callback());
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  for (int i = 0; i < kNumShards; i++)
+    EXPECT_EQ(0, cache_->GetShardForTest(i)->GetEntryCount());
+
+  CreateEntries();
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+}
+
+TEST_F(DiskCacheShardedBackendTest, DoomEntriesSince) {
+  InitCache();
+  CreateEntries();
+
+  base::Time initial = base::Time::Now() + base::TimeDelta::FromDays(1);
+  net::TestCompletionCallback cb;
+  int rv = cache_->DoomEntriesSince(initial, cb.callback());
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+
+  rv = cache_->DoomEntriesBetween(base::Time(), initial, cb.callback());
+  EXPECT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+// Tests that the size of the cache is split among the shards, and figured out
+// by the backend when not provided.
+TEST_F(DiskCacheShardedBackendTest, MaxSize) {
+  disk_cache::Backend* cache = NULL;
+  net::TestCompletionCallback cb;
+  int rv = disk_cache::ShardedBackend::CreateBackend(
+      cache_path_, kNumShards, false, 0, net::DISK_CACHE,
+      disk_cache::kNoRandom, NULL, &cache, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  ASSERT_TRUE(cache);
+  cache_ = static_cast<disk_cache::ShardedBackend*>(cache);
+
+  int max_file_size = cache_->GetShardForTest(0)->MaxFileSize();
+  EXPECT_LT(0, max_file_size);
+  for (int i = 1; i < kNumShards; i++)
+    EXPECT_EQ(max_file_size, cache_->GetShardForTest(i)->MaxFileSize());
+
+  InitCache();
+  EXPECT_EQ(10 * 1024 * 1024 / kNumShards / 8,
+            cache_->GetShardForTest(0)->MaxFileSize());
+}
+
+TEST_F(DiskCacheShardedBackendTest, Stats) {
+  InitCache();
+
+  std::vector<std::pair<std::string, std::string> > stats;
+  cache_->GetStats(&stats);
+  ASSERT_FALSE(stats.empty());
+  EXPECT_EQ("Shard 0: Entries", stats[0].first);
+  EXPECT_EQ("Shard 3: Entries", stats[3 * stats.size() / kNumShards].first);
+}
+
+}  // namespace
@@ -0,0 +1,335 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_backend_impl.h"
+
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/sys_info.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+#include "net/disk_cache/simple/simple_entry_impl.h"
+#include "net/disk_cache/simple/simple_index.h"
+#include "net/disk_cache/simple/simple_synchronous_entry.h"
+
+using base::Time;
+
+namespace {
+
+// The file operations block, so there are more threads than cores.
+const size_t kMaxWorkerThreads = 8;
+
+// The entries are spread over this many sequences of the worker pool. The
+// operations of one entry are always in the same sequence.
+const int kSequenceCount = 64;
+
+const int kDefaultCacheSize = 80 * 1024 * 1024;
+
+// Eviction brings the cache down to (1 - 1 / kEvictionMarginDivisor) of its
+// maximum size, so that it does not run for every new entry.
+const int kEvictionMarginDivisor = 10;
+
+// Creates the folder of the cache and figures out its size, on the worker
+// pool.
+void InitializeOnWorker(const FilePath& path, int* max_bytes, bool* success) {
+  *success = file_util::CreateDirectory(path);
+  if (!*success || *max_bytes)
+    return;
+
+  int64 available = base::SysInfo::AmountOfFreeDiskSpace(path);
+  if (available < 0) {
+    *max_bytes = kDefaultCacheSize;
+    return;
+  }
+  available += file_util::ComputeDirectorySize(path);
+  *max_bytes = disk_cache::PreferedCacheSize(available);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+SimpleBackendImpl::SimpleBackendImpl(const FilePath& path, int max_bytes)
+    : path_(path),
+      max_size_(max_bytes),
+      worker_pool_(new base::SequencedWorkerPool(kMaxWorkerThreads,
+                                                 "SimpleCache")),
+      ALLOW_THIS_IN_INITIALIZER_LIST(ptr_factory_(this)) {
+  for (int i = 0; i < kSequenceCount; i++)
+    sequence_tokens_.push_back(worker_pool_->GetSequenceToken());
+  index_.reset(new SimpleIndex(worker_pool_, path_));
+}
+
+SimpleBackendImpl::~SimpleBackendImpl() {
+  // Entries that are still open keep working without the backend, but their
+  // file operations fail from this point on.
+  ptr_factory_.InvalidateWeakPtrs();
+  index_->WriteToDisk(true);
+  worker_pool_->Shutdown();
+}
+
+// Static.
+int SimpleBackendImpl::CreateBackend(const FilePath& path, int max_bytes,
+                                     net::NetLog* net_log, Backend** backend,
+                                     const CompletionCallback& callback) {
+  DCHECK(!callback.is_null());
+  SimpleBackendImpl* cache = new SimpleBackendImpl(path, max_bytes);
+  return cache->Init(backend, callback);
+}
+
+base::WeakPtr<SimpleBackendImpl> SimpleBackendImpl::GetWeakPtr() {
+  return ptr_factory_.GetWeakPtr();
+}
+
+base::SequencedWorkerPool::SequenceToken
+SimpleBackendImpl::GetSequenceTokenForEntry(uint64 entry_hash) const {
+  return sequence_tokens_[entry_hash % sequence_tokens_.size()];
+}
+
+int SimpleBackendImpl::MaxFileSize() const {
+  return max_size_ / 8;
+}
+
+void SimpleBackendImpl::UpdateEntrySize(uint64 entry_hash, int64 entry_size) {
+  index_->UpdateEntrySize(entry_hash, entry_size);
+  if (index_->cache_size() > max_size_)
+    EvictEntries();
+}
+
+void SimpleBackendImpl::OnEntryUsed(uint64 entry_hash) {
+  index_->UseIfExists(entry_hash);
+}
+
+void SimpleBackendImpl::RemoveEntry(SimpleEntryImpl* entry) {
+  EntryMap::iterator it = active_entries_.find(entry->entry_hash());
+  if (it != active_entries_.end() && it->second == entry)
+    active_entries_.erase(it);
+  index_->Remove(entry->entry_hash());
+}
+
+void SimpleBackendImpl::OnEntryDestroyed(SimpleEntryImpl* entry) {
+  EntryMap::iterator it = active_entries_.find(entry->entry_hash());
+  if (it != active_entries_.end() && it->second == entry)
+    active_entries_.erase(it);
+}
+
+void SimpleBackendImpl::FlushWorkerPoolForTesting() {
+  worker_pool_->FlushForTesting();
+}
+
+int32 SimpleBackendImpl::GetEntryCount() const {
+  return index_->GetEntryCount();
+}
+
+int SimpleBackendImpl::OpenEntry(const std::string& key, Entry** entry,
+                                 const CompletionCallback& callback) {
+  uint64 entry_hash = GetEntryHashKey(key);
+  EntryMap::iterator it = active_entries_.find(entry_hash);
+  if (it == active_entries_.end()) {
+    // There is no need to look at the disk for an entry that is not there.
+    if (!index_->Has(entry_hash))
+      return net::ERR_FAILED;
+  } else if (!it->second->GetKey().empty() && it->second->GetKey() != key) {
+    return net::ERR_FAILED;
+  }
+
+  scoped_refptr<SimpleEntryImpl> simple_entry =
+      GetOrCreateEntry(entry_hash, key);
+  return simple_entry->OpenEntry(entry, callback);
+}
+
+int SimpleBackendImpl::CreateEntry(const std::string& key, Entry** entry,
+                                   const CompletionCallback& callback) {
+  uint64 entry_hash = GetEntryHashKey(key);
+  if (index_->Has(entry_hash) ||
+      active_entries_.find(entry_hash) != active_entries_.end()) {
+    return net::ERR_FAILED;
+  }
+
+  // Any file left behind for this entry is replaced.
+  index_->Insert(entry_hash);
+  scoped_refptr<SimpleEntryImpl> simple_entry =
+      GetOrCreateEntry(entry_hash, key);
+  return simple_entry->CreateEntry(entry);
+}
+
+int SimpleBackendImpl::DoomEntry(const std::string& key,
+                                 const CompletionCallback& callback) {
+  uint64 entry_hash = GetEntryHashKey(key);
+  if (!index_->Has(entry_hash))
+    return net::ERR_FAILED;
+
+  // The file is deleted before any later operation for the same key runs, so
+  // there is no need to wait.
+  DoomEntryFromHash(entry_hash);
+  return net::OK;
+}
+
+int SimpleBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  return DoomEntriesBetween(Time(), Time(), callback);
+}
+
+int SimpleBackendImpl::DoomEntriesBetween(const Time initial_time,
+                                          const Time end_time,
+                                          const CompletionCallback& callback) {
+  std::vector<uint64> entry_hashes;
+  index_->GetEntriesBetween(initial_time, end_time, &entry_hashes);
+  DoomEntries(entry_hashes);
+  return net::OK;
+}
+
+int SimpleBackendImpl::DoomEntriesSince(const Time initial_time,
+                                        const CompletionCallback& callback) {
+  return DoomEntriesBetween(initial_time, Time(), callback);
+}
+
+int SimpleBackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
+                                     const CompletionCallback& callback) {
+  if (!*iter) {
+    EnumerationIterator* entry_hashes = new EnumerationIterator;
+    index_->GetEntriesBetween(Time(), Time(), entry_hashes);
+    *iter = entry_hashes;
+  }
+  EnumerationIterator* entry_hashes =
+      reinterpret_cast<EnumerationIterator*>(*iter);
+
+  while (!entry_hashes->empty()) {
+    uint64 entry_hash = entry_hashes->back();
+    entry_hashes->pop_back();
+    if (!index_->Has(entry_hash))
+      continue;  // Doomed after the enumeration started.
+
+    // The key of the entry is read from its file.
+    scoped_refptr<SimpleEntryImpl> simple_entry =
+        GetOrCreateEntry(entry_hash, std::string());
+    int rv = simple_entry->OpenEntry(
+        next_entry,
+        base::Bind(&SimpleBackendImpl::OnEnumerationEntryOpened,
+                   ptr_factory_.GetWeakPtr(), iter, next_entry, callback));
+    if (rv == net::OK || rv == net::ERR_IO_PENDING)
+      return rv;
+  }
+
+  EndEnumeration(iter);
+  return net::ERR_FAILED;
+}
+
+void SimpleBackendImpl::EndEnumeration(void** iter) {
+  delete reinterpret_cast<EnumerationIterator*>(*iter);
+  *iter = NULL;
+}
+
+void SimpleBackendImpl::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  stats->push_back(std::make_pair(std::string("Entries"),
+                                  base::IntToString(GetEntryCount())));
+  stats->push_back(std::make_pair(std::string("Size"),
+                                  base::Int64ToString(index_->cache_size())));
+  stats->push_back(std::make_pair(std::string("Max size"),
+                                  base::IntToString(max_size_)));
+  stats->push_back(std::make_pair(
+      std::string("Entries in use"),
+      base::IntToString(static_cast<int>(active_entries_.size()))));
+}
+
+void SimpleBackendImpl::OnExternalCacheHit(const std::string& key) {
+  index_->UseIfExists(GetEntryHashKey(key));
+}
+
+// ------------------------------------------------------------------------
+
+int SimpleBackendImpl::Init(Backend** backend,
+                            const CompletionCallback& callback) {
+  int* max_bytes = new int(max_size_);
+  bool* success = new bool(false);
+  worker_pool_->PostTaskAndReply(
+      FROM_HERE, base::Bind(&InitializeOnWorker, path_, max_bytes, success),
+      base::Bind(&SimpleBackendImpl::OnInitialized, base::Unretained(this),
+                 backend, callback, base::Owned(max_bytes),
+                 base::Owned(success)));
+  return net::ERR_IO_PENDING;
+}
+
+void SimpleBackendImpl::OnInitialized(Backend** backend,
+                                      const CompletionCallback& callback,
+                                      const int* max_bytes,
+                                      const bool* success) {
+  if (!*success) {
+    LOG(ERROR) << "Unable to create simple cache";
+    *backend = NULL;
+    delete this;
+    callback.Run(net::ERR_FAILED);
+    return;
+  }
+
+  max_size_ = *max_bytes;
+  index_->Initialize(base::Bind(&SimpleBackendImpl::OnIndexLoaded,
+                                base::Unretained(this), backend, callback));
+}
+
+void SimpleBackendImpl::OnIndexLoaded(Backend** backend,
+                                      const CompletionCallback& callback) {
+  *backend = this;
+  callback.Run(net::OK);
+}
+
+scoped_refptr<SimpleEntryImpl> SimpleBackendImpl::GetOrCreateEntry(
+    uint64 entry_hash, const std::string& key) {
+  EntryMap::iterator it = active_entries_.find(entry_hash);
+  if (it != active_entries_.end())
+    return make_scoped_refptr(it->second);
+
+  scoped_refptr<SimpleEntryImpl> entry =
+      new SimpleEntryImpl(this, key, entry_hash);
+  active_entries_[entry_hash] = entry.get();
+  return entry;
+}
+
+void SimpleBackendImpl::DoomEntryFromHash(uint64 entry_hash) {
+  EntryMap::iterator it = active_entries_.find(entry_hash);
+  if (it != active_entries_.end()) {
+    it->second->Doom();
+    return;
+  }
+
+  index_->Remove(entry_hash);
+  worker_pool_->PostSequencedWorkerTask(
+      GetSequenceTokenForEntry(entry_hash), FROM_HERE,
+      base::Bind(&SimpleSynchronousEntry::DeleteFileForEntryHash, path_,
+                 entry_hash));
+}
+
+void SimpleBackendImpl::DoomEntries(const std::vector<uint64>& entry_hashes) {
+  for (size_t i = 0; i < entry_hashes.size(); i++)
+    DoomEntryFromHash(entry_hashes[i]);
+}
+
+void SimpleBackendImpl::OnEnumerationEntryOpened(
+    void** iter, Entry** next_entry, const CompletionCallback& callback,
+    int result) {
+  if (result != net::OK) {
+    // The file of the entry is gone; move on to the next one.
+    result = OpenNextEntry(iter, next_entry, callback);
+    if (result == net::ERR_IO_PENDING)
+      return;
+  }
+  callback.Run(result);
+}
+
+void SimpleBackendImpl::EvictEntries() {
+  int64 target_size = max_size_ - max_size_ / kEvictionMarginDivisor;
+  std::vector<uint64> entry_hashes;
+  index_->GetEntriesByLastUse(&entry_hashes);
+  for (size_t i = 0;
+       i < entry_hashes.size() && index_->cache_size() > target_size; i++) {
+    if (active_entries_.find(entry_hashes[i]) != active_entries_.end())
+      continue;
+    DoomEntryFromHash(entry_hashes[i]);
+  }
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,146 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_BACKEND_IMPL_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+class NetLog;
+}  // namespace net
+
+namespace disk_cache {
+
+class SimpleEntryImpl;
+class SimpleIndex;
+
+// This class implements the Backend interface with one file per entry, in
+// the folder of the cache, and an index of the entries in memory (see
+// SimpleIndex). There is no shared on-disk structure that every operation has
+// to go through, so the file operations of different entries run in parallel
+// on a pool of worker threads, while the operations of one entry run in
+// order. A crash loses the entries that were being modified, but not the rest
+// of the cache.
+//
+// The backend and its entries live on the thread that creates the backend,
+// which must have a message loop. Sparse data is not supported.
+class NET_EXPORT_PRIVATE SimpleBackendImpl : public Backend {
+ public:
+  virtual ~SimpleBackendImpl();
+
+  // Returns a new backend for the cache at |path|, with the same arguments as
+  // CreateCacheBackend(). If |max_bytes| is zero, the size of the cache is
+  // based on the available disk space.
+  static int CreateBackend(const FilePath& path, int max_bytes,
+                           net::NetLog* net_log, Backend** backend,
+                           const CompletionCallback& callback);
+
+  const FilePath& path() const { return path_; }
+  base::SequencedWorkerPool* worker_pool() { return worker_pool_; }
+  base::WeakPtr<SimpleBackendImpl> GetWeakPtr();
+
+  // Returns the sequence of the worker pool used for the operations of the
+  // entry with |entry_hash|.
+  base::SequencedWorkerPool::SequenceToken GetSequenceTokenForEntry(
+      uint64 entry_hash) const;
+
+  // Returns the maximum size for a file to reside on the cache.
+  int MaxFileSize() const;
+
+  // Called by an entry as it changes size.
+  void UpdateEntrySize(uint64 entry_hash, int64 entry_size);
+
+  // Called by an entry as its data is read or written.
+  void OnEntryUsed(uint64 entry_hash);
+
+  // Called by an entry that is doomed, or that turns out not to exist when
+  // it is opened: the entry is no longer in the index or in use.
+  void RemoveEntry(SimpleEntryImpl* entry);
+
+  // Called by an entry as it goes away.
+  void OnEntryDestroyed(SimpleEntryImpl* entry);
+
+  // Waits until the worker pool is idle, for tests.
+  void FlushWorkerPoolForTesting();
+
+  // Backend implementation.
+  virtual int32 GetEntryCount() const OVERRIDE;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntry(const std::string& key,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomAllEntries(const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               const CompletionCallback& callback) OVERRIDE;
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            const CompletionCallback& callback) OVERRIDE;
+  virtual void EndEnumeration(void** iter) OVERRIDE;
+  virtual void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats) OVERRIDE;
+  virtual void OnExternalCacheHit(const std::string& key) OVERRIDE;
+
+ private:
+  typedef base::hash_map<uint64, SimpleEntryImpl*> EntryMap;
+
+  // The entries that are left to visit by an enumeration.
+  typedef std::vector<uint64> EnumerationIterator;
+
+  SimpleBackendImpl(const FilePath& path, int max_bytes);
+
+  // Performs the initialization on the worker pool, and then loads the index.
+  int Init(Backend** backend, const CompletionCallback& callback);
+  void OnInitialized(Backend** backend, const CompletionCallback& callback,
+                     const int* max_bytes, const bool* success);
+  void OnIndexLoaded(Backend** backend, const CompletionCallback& callback);
+
+  // Returns the entry with |entry_hash| if it is in use, or a new one.
+  scoped_refptr<SimpleEntryImpl> GetOrCreateEntry(uint64 entry_hash,
+                                                  const std::string& key);
+
+  // Dooms the entry with |entry_hash|, whether it is in use or not.
+  void DoomEntryFromHash(uint64 entry_hash);
+  void DoomEntries(const std::vector<uint64>& entry_hashes);
+
+  // Continues an enumeration after an entry is opened.
+  void OnEnumerationEntryOpened(void** iter, Entry** next_entry,
+                                const CompletionCallback& callback,
+                                int result);
+
+  // Dooms the least recently used entries that are not in use, until the
+  // cache is comfortably below its maximum size.
+  void EvictEntries();
+
+  const FilePath path_;
+  int max_size_;
+  scoped_refptr<base::SequencedWorkerPool> worker_pool_;
+  std::vector<base::SequencedWorkerPool::SequenceToken> sequence_tokens_;
+  scoped_ptr<SimpleIndex> index_;
+  EntryMap active_entries_;  // The entries that are in use.
+  base::WeakPtrFactory<SimpleBackendImpl> ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_BACKEND_IMPL_H_
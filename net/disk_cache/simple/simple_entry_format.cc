@@ -0,0 +1,48 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_entry_format.h"
+
+#include "base/format_macros.h"
+#include "base/sha1.h"
+#include "base/stringprintf.h"
+
+namespace disk_cache {
+
+uint64 GetEntryHashKey(const std::string& key) {
+  // The first eight bytes of the SHA-1 of the key. The cache is only useful
+  // if there are no collisions, so the short hash of the blockfile cache is
+  // not good enough here.
+  std::string sha_hash = base::SHA1HashString(key);
+  uint64 hash = 0;
+  for (int i = 0; i < 8; i++)
+    hash = (hash << 8) | static_cast<uint8>(sha_hash[i]);
+  return hash;
+}
+
+std::string GetFilenameFromEntryHash(uint64 entry_hash) {
+  return base::StringPrintf("%016" PRIx64, entry_hash);
+}
+
+bool GetEntryHashFromFilename(const std::string& filename, uint64* entry_hash) {
+  if (filename.size() != 16)
+    return false;
+
+  uint64 hash = 0;
+  for (size_t i = 0; i < filename.size(); i++) {
+    char c = filename[i];
+    int value;
+    if (c >= '0' && c <= '9')
+      value = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      value = c - 'a' + 10;
+    else
+      return false;
+    hash = (hash << 4) | value;
+  }
+  *entry_hash = hash;
+  return true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,69 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FORMAT_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FORMAT_H_
+#pragma once
+
+#include <string>
+
+#include "base/basictypes.h"
+
+namespace disk_cache {
+
+// Each entry of the simple cache lives on its own file, named after the hash
+// of the key (see GetEntryHashKey()). The file looks like this:
+//
+//   SimpleFileHeader
+//   key
+//   stream 1 data
+//   stream 0 data
+//   stream 2 data
+//   SimpleFileEOF
+//
+// Stream 1 (the body of a resource) is read and written in place, so it goes
+// first. Streams 0 and 2 are small, so they are kept in memory while the entry
+// is open, and written along with the SimpleFileEOF record when the entry is
+// closed. The first write to stream 1 of an entry removes the record, so a
+// file without a valid record at its end is an entry that was being modified
+// when the browser went away, and that entry alone is discarded.
+
+const uint64 kSimpleInitialMagicNumber = GG_UINT64_C(0xfcfb6d1ba7725c30);
+const uint64 kSimpleFinalMagicNumber = GG_UINT64_C(0xf4fa6f45970d41d8);
+
+// A file with a different version is discarded when the entry is opened.
+const uint32 kSimpleVersion = 1;
+
+const int kSimpleEntryStreamCount = 3;
+
+struct SimpleFileHeader {
+  uint64 initial_magic_number;
+  uint32 version;
+  uint32 key_length;
+};
+COMPILE_ASSERT(sizeof(SimpleFileHeader) == 16, bad_SimpleFileHeader);
+
+struct SimpleFileEOF {
+  uint64 final_magic_number;
+  int64 last_used;      // Internal values of base::Time.
+  int64 last_modified;
+  int32 data_size[kSimpleEntryStreamCount];
+  int32 pad;
+};
+COMPILE_ASSERT(sizeof(SimpleFileEOF) == 40, bad_SimpleFileEOF);
+
+// Returns the hash of |key| that identifies the entry, both in the index and
+// on the name of its file.
+uint64 GetEntryHashKey(const std::string& key);
+
+// Returns the name of the file of the entry with |entry_hash|.
+std::string GetFilenameFromEntryHash(uint64 entry_hash);
+
+// Reverses GetFilenameFromEntryHash(). Returns false if |filename| is not the
+// name of an entry.
+bool GetEntryHashFromFilename(const std::string& filename, uint64* entry_hash);
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_FORMAT_H_
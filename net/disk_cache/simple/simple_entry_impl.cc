@@ -0,0 +1,409 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_entry_impl.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/message_loop_proxy.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/disk_cache/simple/simple_synchronous_entry.h"
+
+using base::Time;
+
+namespace {
+
+// The tasks that run on the worker pool. Each one stores the result of the
+// operation in |result|, which is owned by the reply of the operation.
+
+void OpenOnWorker(disk_cache::SimpleSynchronousEntry* entry,
+                  disk_cache::SimpleEntryStat* stat, int* result) {
+  *result = entry->Open(stat);
+}
+
+void CreateOnWorker(disk_cache::SimpleSynchronousEntry* entry, int* result) {
+  *result = entry->Create();
+}
+
+void ReadOnWorker(disk_cache::SimpleSynchronousEntry* entry, int offset,
+                  const scoped_refptr<net::IOBuffer>& buf, int buf_len,
+                  int* result) {
+  *result = entry->ReadData(offset, buf, buf_len);
+}
+
+void WriteOnWorker(disk_cache::SimpleSynchronousEntry* entry, int offset,
+                   const scoped_refptr<net::IOBuffer>& buf, int buf_len,
+                   bool truncate, int* result) {
+  *result = entry->WriteData(offset, buf, buf_len, truncate);
+}
+
+void WriteTailOnWorker(disk_cache::SimpleSynchronousEntry* entry,
+                       const disk_cache::SimpleEntryStat* stat, int* result) {
+  *result = entry->WriteTail(*stat);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+SimpleEntryImpl::SimpleEntryImpl(SimpleBackendImpl* backend,
+                                 const std::string& key, uint64 entry_hash)
+    : backend_(backend->GetWeakPtr()),
+      worker_pool_(backend->worker_pool()),
+      sequence_token_(backend->GetSequenceTokenForEntry(entry_hash)),
+      origin_loop_(base::MessageLoopProxy::current()),
+      key_(key),
+      entry_hash_(entry_hash),
+      state_(STATE_UNINITIALIZED),
+      open_count_(0),
+      doomed_(false),
+      modified_(false),
+      synchronous_entry_(
+          new SimpleSynchronousEntry(backend->path(), key, entry_hash)) {
+  for (int i = 0; i < kSimpleEntryStreamCount; i++)
+    data_size_[i] = 0;
+}
+
+int SimpleEntryImpl::OpenEntry(Entry** out_entry,
+                               const CompletionCallback& callback) {
+  switch (state_) {
+    case STATE_READY:
+      AddUser(out_entry);
+      return net::OK;
+
+    case STATE_FAILURE:
+      return net::ERR_FAILED;
+
+    case STATE_OPENING:
+      break;
+
+    case STATE_UNINITIALIZED: {
+      state_ = STATE_OPENING;
+      SimpleEntryStat* stat = new SimpleEntryStat;
+      int* result = new int(net::ERR_FAILED);
+      PostOperation(
+          base::Bind(&OpenOnWorker, synchronous_entry_, stat, result),
+          base::Bind(&SimpleEntryImpl::OnOpenComplete, base::Unretained(this),
+                     base::Owned(stat), base::Owned(result)));
+      break;
+    }
+  }
+
+  PendingOpen pending_open;
+  pending_open.out_entry = out_entry;
+  pending_open.callback = callback;
+  pending_opens_.push_back(pending_open);
+  return net::ERR_IO_PENDING;
+}
+
+int SimpleEntryImpl::CreateEntry(Entry** out_entry) {
+  DCHECK_EQ(STATE_UNINITIALIZED, state_);
+  state_ = STATE_READY;
+  last_used_ = last_modified_ = Time::Now();
+
+  int* result = new int(net::ERR_FAILED);
+  PostOperation(
+      base::Bind(&CreateOnWorker, synchronous_entry_, result),
+      base::Bind(&SimpleEntryImpl::OnCreateComplete, base::Unretained(this),
+                 base::Owned(result)));
+  OnEntryModified();
+  AddUser(out_entry);
+  return net::OK;
+}
+
+void SimpleEntryImpl::Doom() {
+  if (doomed_)
+    return;
+
+  doomed_ = true;
+  if (backend_)
+    backend_->RemoveEntry(this);
+
+  // Operations that are already queued keep working with the file.
+  PostOperation(base::Bind(&SimpleSynchronousEntry::Doom,
+                           base::Unretained(synchronous_entry_)),
+                base::Bind(&base::DoNothing));
+}
+
+void SimpleEntryImpl::Close() {
+  DCHECK_GT(open_count_, 0);
+  if (!--open_count_ && modified_ && !doomed_) {
+    SimpleEntryStat* stat = new SimpleEntryStat;
+    stat->key = key_;
+    stat->last_used = last_used_;
+    stat->last_modified = last_modified_;
+    for (int i = 0; i < kSimpleEntryStreamCount; i++) {
+      stat->data_size[i] = data_size_[i];
+      stat->stream_data[i] = stream_data_[i];
+    }
+    int* result = new int(net::ERR_FAILED);
+    PostOperation(
+        base::Bind(&WriteTailOnWorker, synchronous_entry_, stat, result),
+        base::Bind(&SimpleEntryImpl::OnTailWritten, base::Unretained(this),
+                   base::Owned(stat), base::Owned(result)));
+    modified_ = false;
+  }
+  Release();
+}
+
+std::string SimpleEntryImpl::GetKey() const {
+  return key_;
+}
+
+Time SimpleEntryImpl::GetLastUsed() const {
+  return last_used_;
+}
+
+Time SimpleEntryImpl::GetLastModified() const {
+  return last_modified_;
+}
+
+int32 SimpleEntryImpl::GetDataSize(int index) const {
+  if (index < 0 || index >= kSimpleEntryStreamCount)
+    return 0;
+  return data_size_[index];
+}
+
+int SimpleEntryImpl::ReadData(int index, int offset, net::IOBuffer* buf,
+                              int buf_len,
+                              const CompletionCallback& callback) {
+  DCHECK_EQ(STATE_READY, state_);
+  if (index < 0 || index >= kSimpleEntryStreamCount || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int entry_size = data_size_[index];
+  if (offset >= entry_size || offset < 0 || !buf_len)
+    return 0;
+  buf_len = std::min(buf_len, entry_size - offset);
+  OnEntryUsed();
+
+  if (index != 1) {
+    memcpy(buf->data(), stream_data_[index].data() + offset, buf_len);
+    return buf_len;
+  }
+
+  int* result = new int(net::ERR_FAILED);
+  PostOperation(
+      base::Bind(&ReadOnWorker, synchronous_entry_, offset,
+                 make_scoped_refptr(buf), buf_len, result),
+      base::Bind(&SimpleEntryImpl::OnIOComplete, base::Unretained(this),
+                 callback, base::Owned(result)));
+  return net::ERR_IO_PENDING;
+}
+
+int SimpleEntryImpl::WriteData(int index, int offset, net::IOBuffer* buf,
+                               int buf_len, const CompletionCallback& callback,
+                               bool truncate) {
+  DCHECK_EQ(STATE_READY, state_);
+  if (index < 0 || index >= kSimpleEntryStreamCount)
+    return net::ERR_INVALID_ARGUMENT;
+
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int max_file_size = backend_ ? backend_->MaxFileSize() : kint32max;
+
+  // offset of buf_len could be negative numbers.
+  if (offset > max_file_size || buf_len > max_file_size ||
+      offset + buf_len > max_file_size) {
+    return net::ERR_FAILED;
+  }
+
+  int end = offset + buf_len;
+  if (truncate || end > data_size_[index])
+    data_size_[index] = end;
+  last_modified_ = Time::Now();
+  OnEntryUsed();
+  OnEntryModified();
+
+  if (index != 1) {
+    std::string& data = stream_data_[index];
+    data.resize(data_size_[index]);
+    if (buf_len)
+      memcpy(&data[offset], buf->data(), buf_len);
+    return buf_len;
+  }
+
+  // Without a callback, the caller may reuse |buf| as soon as this returns.
+  scoped_refptr<net::IOBuffer> buffer(buf);
+  if (callback.is_null() && buf_len) {
+    buffer = new net::IOBuffer(buf_len);
+    memcpy(buffer->data(), buf->data(), buf_len);
+  }
+
+  int* result = new int(net::ERR_FAILED);
+  PostOperation(
+      base::Bind(&WriteOnWorker, synchronous_entry_, offset, buffer, buf_len,
+                 truncate, result),
+      base::Bind(&SimpleEntryImpl::OnIOComplete, base::Unretained(this),
+                 callback, base::Owned(result)));
+  return callback.is_null() ? buf_len : net::ERR_IO_PENDING;
+}
+
+int SimpleEntryImpl::ReadSparseData(int64 offset, net::IOBuffer* buf,
+                                    int buf_len,
+                                    const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int SimpleEntryImpl::WriteSparseData(int64 offset, net::IOBuffer* buf,
+                                     int buf_len,
+                                     const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int SimpleEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
+                                       const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+bool SimpleEntryImpl::CouldBeSparse() const {
+  return false;
+}
+
+void SimpleEntryImpl::CancelSparseIO() {
+}
+
+int SimpleEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return net::OK;
+}
+
+// ------------------------------------------------------------------------
+
+SimpleEntryImpl::~SimpleEntryImpl() {
+  DCHECK(!open_count_);
+  DCHECK(pending_replies_.empty());
+  if (backend_)
+    backend_->OnEntryDestroyed(this);
+
+  // The file is closed behind any operation that is still running.
+  if (!worker_pool_->PostSequencedWorkerTask(
+          sequence_token_, FROM_HERE,
+          base::Bind(&base::DeletePointer<SimpleSynchronousEntry>,
+                     synchronous_entry_))) {
+    delete synchronous_entry_;
+  }
+}
+
+void SimpleEntryImpl::AddUser(Entry** out_entry) {
+  open_count_++;
+  AddRef();
+  *out_entry = this;
+}
+
+int64 SimpleEntryImpl::GetFileSize() const {
+  int64 file_size = sizeof(SimpleFileHeader) + key_.size() +
+                    sizeof(SimpleFileEOF);
+  for (int i = 0; i < kSimpleEntryStreamCount; i++)
+    file_size += data_size_[i];
+  return file_size;
+}
+
+void SimpleEntryImpl::OnEntryUsed() {
+  last_used_ = Time::Now();
+  if (backend_ && !doomed_)
+    backend_->OnEntryUsed(entry_hash_);
+}
+
+void SimpleEntryImpl::OnEntryModified() {
+  modified_ = true;
+  if (backend_ && !doomed_)
+    backend_->UpdateEntrySize(entry_hash_, GetFileSize());
+}
+
+void SimpleEntryImpl::PostOperation(const base::Closure& task,
+                                    const base::Closure& reply) {
+  // The reply stays on this thread, so that the objects bound to it are not
+  // released on the worker pool.
+  AddRef();
+  pending_replies_.push(reply);
+  base::Closure done = base::Bind(&SimpleEntryImpl::OnOperationComplete,
+                                  base::Unretained(this));
+  if (!worker_pool_->PostSequencedWorkerTask(
+          sequence_token_, FROM_HERE,
+          base::Bind(&SimpleEntryImpl::RunOperation, task, origin_loop_,
+                     done))) {
+    // The backend is gone, so the operation fails.
+    origin_loop_->PostTask(FROM_HERE, done);
+  }
+}
+
+// Static.
+void SimpleEntryImpl::RunOperation(
+    const base::Closure& task,
+    const scoped_refptr<base::MessageLoopProxy>& origin_loop,
+    const base::Closure& done) {
+  task.Run();
+  origin_loop->PostTask(FROM_HERE, done);
+}
+
+void SimpleEntryImpl::OnOperationComplete() {
+  DCHECK(!pending_replies_.empty());
+  base::Closure reply = pending_replies_.front();
+  pending_replies_.pop();
+  reply.Run();
+  Release();  // May delete this object.
+}
+
+void SimpleEntryImpl::OnOpenComplete(SimpleEntryStat* stat,
+                                     const int* result) {
+  DCHECK_EQ(STATE_OPENING, state_);
+  int rv = *result;
+  std::vector<PendingOpen> pending_opens;
+  pending_opens.swap(pending_opens_);
+
+  if (rv == net::OK) {
+    state_ = STATE_READY;
+    if (key_.empty())
+      key_ = stat->key;
+    last_used_ = stat->last_used;
+    last_modified_ = stat->last_modified;
+    for (int i = 0; i < kSimpleEntryStreamCount; i++) {
+      data_size_[i] = stat->data_size[i];
+      stream_data_[i].swap(stat->stream_data[i]);
+    }
+    if (backend_ && !doomed_)
+      backend_->UpdateEntrySize(entry_hash_, GetFileSize());
+
+    // Every user gets the entry before any of them can close it.
+    for (size_t i = 0; i < pending_opens.size(); i++)
+      AddUser(pending_opens[i].out_entry);
+  } else {
+    state_ = STATE_FAILURE;
+    rv = net::ERR_FAILED;
+    if (backend_)
+      backend_->RemoveEntry(this);
+  }
+
+  for (size_t i = 0; i < pending_opens.size(); i++)
+    pending_opens[i].callback.Run(rv);
+}
+
+void SimpleEntryImpl::OnCreateComplete(const int* result) {
+  if (*result != net::OK)
+    Doom();
+}
+
+void SimpleEntryImpl::OnTailWritten(const SimpleEntryStat* stat,
+                                    const int* result) {
+  if (*result != net::OK)
+    Doom();
+}
+
+void SimpleEntryImpl::OnIOComplete(const CompletionCallback& callback,
+                                   const int* result) {
+  // The data of the entry cannot be trusted after a failure.
+  if (*result < 0)
+    Doom();
+  if (!callback.is_null())
+    callback.Run(*result);
+}
+
+}  // namespace disk_cache
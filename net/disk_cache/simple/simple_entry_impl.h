@@ -0,0 +1,163 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_IMPL_H_
+#pragma once
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/time.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+
+namespace base {
+class MessageLoopProxy;
+}
+
+namespace disk_cache {
+
+class SimpleBackendImpl;
+class SimpleSynchronousEntry;
+struct SimpleEntryStat;
+
+// This class implements the Entry interface for the simple cache. It lives on
+// the thread of the backend, and keeps streams 0 and 2 in memory while the
+// entry is in use. The file operations are performed by a
+// SimpleSynchronousEntry on the worker pool of the backend, in the order in
+// which they were requested; different entries do their I/O in parallel.
+//
+// There is only one object for each entry that is in use, no matter how many
+// times the entry is opened. Each user holds a reference, and pending
+// operations hold another one, so an entry can outlive both its users and the
+// backend.
+class SimpleEntryImpl : public Entry,
+                        public base::RefCounted<SimpleEntryImpl> {
+ public:
+  SimpleEntryImpl(SimpleBackendImpl* backend, const std::string& key,
+                  uint64 entry_hash);
+
+  // Opens the entry for one more user, reading its files the first time.
+  // An empty key opens the entry with the given hash, whatever its key is.
+  // Returns a net error code, and invokes |callback| later if the result is
+  // ERR_IO_PENDING. As with the other backends, the entry is not considered
+  // used until its data is read or written.
+  int OpenEntry(Entry** out_entry, const CompletionCallback& callback);
+
+  // Creates a new entry. The file is created in the background, and the
+  // operations issued meanwhile are queued behind it, so this completes
+  // synchronously.
+  int CreateEntry(Entry** out_entry);
+
+  uint64 entry_hash() const { return entry_hash_; }
+  bool doomed() const { return doomed_; }
+
+  // Entry interface.
+  virtual void Doom() OVERRIDE;
+  virtual void Close() OVERRIDE;
+  virtual std::string GetKey() const OVERRIDE;
+  virtual base::Time GetLastUsed() const OVERRIDE;
+  virtual base::Time GetLastModified() const OVERRIDE;
+  virtual int32 GetDataSize(int index) const OVERRIDE;
+  virtual int ReadData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                       const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteData(int index, int offset, net::IOBuffer* buf, int buf_len,
+                        const CompletionCallback& callback,
+                        bool truncate) OVERRIDE;
+  virtual int ReadSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                             const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteSparseData(int64 offset, net::IOBuffer* buf, int buf_len,
+                              const CompletionCallback& callback) OVERRIDE;
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                const CompletionCallback& callback) OVERRIDE;
+  virtual bool CouldBeSparse() const OVERRIDE;
+  virtual void CancelSparseIO() OVERRIDE;
+  virtual int ReadyForSparseIO(const CompletionCallback& callback) OVERRIDE;
+
+ private:
+  friend class base::RefCounted<SimpleEntryImpl>;
+
+  enum State {
+    STATE_UNINITIALIZED,
+    STATE_OPENING,
+    STATE_READY,
+    STATE_FAILURE
+  };
+
+  // A user waiting for the entry to be opened.
+  struct PendingOpen {
+    Entry** out_entry;
+    CompletionCallback callback;
+  };
+
+  virtual ~SimpleEntryImpl();
+
+  // Hands the entry to one more user.
+  void AddUser(Entry** out_entry);
+
+  // Returns the size of the file of the entry.
+  int64 GetFileSize() const;
+
+  // Updates the time of last use, here and in the index.
+  void OnEntryUsed();
+
+  // Tells the backend about a change of size, and marks the entry as
+  // modified.
+  void OnEntryModified();
+
+  // Runs |task| on the worker pool after every operation requested before,
+  // and then runs |reply| on this thread.
+  void PostOperation(const base::Closure& task, const base::Closure& reply);
+  static void RunOperation(
+      const base::Closure& task,
+      const scoped_refptr<base::MessageLoopProxy>& origin_loop,
+      const base::Closure& done);
+  void OnOperationComplete();
+
+  // Replies of the operations.
+  void OnOpenComplete(SimpleEntryStat* stat, const int* result);
+  void OnCreateComplete(const int* result);
+  void OnTailWritten(const SimpleEntryStat* stat, const int* result);
+  void OnIOComplete(const CompletionCallback& callback, const int* result);
+
+  base::WeakPtr<SimpleBackendImpl> backend_;
+  scoped_refptr<base::SequencedWorkerPool> worker_pool_;
+  base::SequencedWorkerPool::SequenceToken sequence_token_;
+  scoped_refptr<base::MessageLoopProxy> origin_loop_;
+
+  std::string key_;
+  const uint64 entry_hash_;
+  State state_;
+  int open_count_;
+  bool doomed_;
+  bool modified_;  // Since the last time the tail of the file was written.
+
+  base::Time last_used_;
+  base::Time last_modified_;
+  int32 data_size_[kSimpleEntryStreamCount];
+  std::string stream_data_[kSimpleEntryStreamCount];  // For streams 0 and 2.
+
+  std::vector<PendingOpen> pending_opens_;
+
+  // The replies of the operations that are running on the worker pool. The
+  // operations complete in order.
+  std::queue<base::Closure> pending_replies_;
+
+  // Owned by the entry, but only used and deleted on the worker pool.
+  SimpleSynchronousEntry* synchronous_entry_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_ENTRY_IMPL_H_
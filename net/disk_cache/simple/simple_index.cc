@@ -0,0 +1,294 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_index.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "net/disk_cache/hash.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+
+namespace {
+
+const char kIndexDirName[] = "index-dir";
+const char kIndexFileName[] = "index";
+const char kTempIndexFileName[] = "index.tmp";
+
+const uint64 kIndexMagicNumber = GG_UINT64_C(0x656e74657220796f);
+const uint32 kIndexVersion = 1;
+
+// How long the index waits to be written to disk after a change.
+const int kWriteToDiskDelaySecs = 20;
+
+struct IndexHeader {
+  uint64 magic_number;
+  uint32 version;
+  uint32 clean;         // Written when the cache was closed.
+  uint64 entry_count;
+  uint32 checksum;      // Of the records.
+  uint32 pad;
+};
+COMPILE_ASSERT(sizeof(IndexHeader) == 32, bad_IndexHeader);
+
+struct IndexRecord {
+  uint64 entry_hash;
+  int64 last_used;
+  int64 entry_size;
+};
+COMPILE_ASSERT(sizeof(IndexRecord) == 24, bad_IndexRecord);
+
+FilePath GetIndexFilePath(const FilePath& path) {
+  return path.AppendASCII(kIndexDirName).AppendASCII(kIndexFileName);
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+SimpleIndex::SimpleIndex(base::SequencedWorkerPool* worker_pool,
+                         const FilePath& path)
+    : worker_pool_(worker_pool),
+      write_sequence_token_(worker_pool->GetSequenceToken()),
+      path_(path),
+      cache_size_(0),
+      ALLOW_THIS_IN_INITIALIZER_LIST(ptr_factory_(this)) {
+}
+
+SimpleIndex::~SimpleIndex() {
+}
+
+void SimpleIndex::Initialize(const base::Closure& callback) {
+  EntrySet* entries = new EntrySet;
+  worker_pool_->PostTaskAndReply(
+      FROM_HERE, base::Bind(&SimpleIndex::LoadFromDisk, path_, entries),
+      base::Bind(&SimpleIndex::OnIndexLoaded, ptr_factory_.GetWeakPtr(),
+                 callback, base::Owned(entries)));
+}
+
+void SimpleIndex::Insert(uint64 entry_hash) {
+  EntryMetadata& metadata = entries_set_[entry_hash];
+  metadata.last_used = base::Time::Now();
+  ScheduleWriteToDisk();
+}
+
+void SimpleIndex::Remove(uint64 entry_hash) {
+  EntrySet::iterator it = entries_set_.find(entry_hash);
+  if (it == entries_set_.end())
+    return;
+
+  cache_size_ -= it->second.entry_size;
+  entries_set_.erase(it);
+  ScheduleWriteToDisk();
+}
+
+bool SimpleIndex::Has(uint64 entry_hash) const {
+  return entries_set_.find(entry_hash) != entries_set_.end();
+}
+
+bool SimpleIndex::UseIfExists(uint64 entry_hash) {
+  EntrySet::iterator it = entries_set_.find(entry_hash);
+  if (it == entries_set_.end())
+    return false;
+
+  it->second.last_used = base::Time::Now();
+  ScheduleWriteToDisk();
+  return true;
+}
+
+void SimpleIndex::UpdateEntrySize(uint64 entry_hash, int64 entry_size) {
+  EntrySet::iterator it = entries_set_.find(entry_hash);
+  if (it == entries_set_.end())
+    return;
+
+  cache_size_ += entry_size - it->second.entry_size;
+  it->second.entry_size = entry_size;
+  ScheduleWriteToDisk();
+}
+
+int32 SimpleIndex::GetEntryCount() const {
+  return static_cast<int32>(entries_set_.size());
+}
+
+void SimpleIndex::GetEntriesBetween(base::Time initial_time,
+                                    base::Time end_time,
+                                    std::vector<uint64>* entry_hashes) const {
+  for (EntrySet::const_iterator it = entries_set_.begin();
+       it != entries_set_.end(); ++it) {
+    const base::Time& last_used = it->second.last_used;
+    if (last_used >= initial_time &&
+        (end_time.is_null() || last_used < end_time)) {
+      entry_hashes->push_back(it->first);
+    }
+  }
+}
+
+void SimpleIndex::GetEntriesByLastUse(
+    std::vector<uint64>* entry_hashes) const {
+  std::vector<std::pair<base::Time, uint64> > entries;
+  entries.reserve(entries_set_.size());
+  for (EntrySet::const_iterator it = entries_set_.begin();
+       it != entries_set_.end(); ++it) {
+    entries.push_back(std::make_pair(it->second.last_used, it->first));
+  }
+  std::sort(entries.begin(), entries.end());
+
+  entry_hashes->reserve(entry_hashes->size() + entries.size());
+  for (size_t i = 0; i < entries.size(); i++)
+    entry_hashes->push_back(entries[i].second);
+}
+
+void SimpleIndex::WriteToDisk(bool clean) {
+  write_to_disk_timer_.Stop();
+
+  std::string contents(sizeof(IndexHeader) +
+                       entries_set_.size() * sizeof(IndexRecord), '\0');
+  IndexRecord* records =
+      reinterpret_cast<IndexRecord*>(&contents[sizeof(IndexHeader)]);
+  for (EntrySet::const_iterator it = entries_set_.begin();
+       it != entries_set_.end(); ++it, ++records) {
+    records->entry_hash = it->first;
+    records->last_used = it->second.last_used.ToInternalValue();
+    records->entry_size = it->second.entry_size;
+  }
+
+  IndexHeader* header = reinterpret_cast<IndexHeader*>(&contents[0]);
+  header->magic_number = kIndexMagicNumber;
+  header->version = kIndexVersion;
+  header->clean = clean ? 1 : 0;
+  header->entry_count = entries_set_.size();
+  header->checksum = Hash(contents.data() + sizeof(IndexHeader),
+                          contents.size() - sizeof(IndexHeader));
+  header->pad = 0;
+
+  // A write that is still pending when the backend goes away blocks the
+  // shutdown of the pool, so the final clean index always makes it to disk,
+  // after any earlier one.
+  worker_pool_->PostSequencedWorkerTask(
+      write_sequence_token_, FROM_HERE,
+      base::Bind(&SimpleIndex::WriteIndexFile, path_, contents));
+}
+
+// Static.
+void SimpleIndex::LoadFromDisk(const FilePath& path, EntrySet* entries) {
+  if (ReadIndexFile(path, entries))
+    return;
+
+  entries->clear();
+  RestoreFromDisk(path, entries);
+}
+
+// Static.
+bool SimpleIndex::ReadIndexFile(const FilePath& path, EntrySet* entries) {
+  FilePath index_path = GetIndexFilePath(path);
+  std::string contents;
+  if (!file_util::ReadFileToString(index_path, &contents))
+    return false;
+
+  // A clean index is only good once: if the cache is not closed properly
+  // after this point, the index has to be rebuilt.
+  base::PlatformFileInfo index_info;
+  base::PlatformFileInfo cache_info;
+  if (!file_util::GetFileInfo(index_path, &index_info) ||
+      !file_util::GetFileInfo(path, &cache_info) ||
+      !file_util::Delete(index_path, false)) {
+    return false;
+  }
+
+  if (contents.size() < sizeof(IndexHeader))
+    return false;
+  const IndexHeader* header =
+      reinterpret_cast<const IndexHeader*>(contents.data());
+  if (header->magic_number != kIndexMagicNumber ||
+      header->version != kIndexVersion ||
+      contents.size() != sizeof(IndexHeader) +
+                         header->entry_count * sizeof(IndexRecord) ||
+      header->checksum != Hash(contents.data() + sizeof(IndexHeader),
+                               contents.size() - sizeof(IndexHeader))) {
+    LOG(WARNING) << "Invalid index of the simple cache";
+    return false;
+  }
+
+  // Entries are added to and removed from the folder of the cache, so an
+  // index that was written while the cache was in use is stale if the folder
+  // changed after it.
+  if (!header->clean && index_info.last_modified <= cache_info.last_modified)
+    return false;
+
+  const IndexRecord* records = reinterpret_cast<const IndexRecord*>(
+      contents.data() + sizeof(IndexHeader));
+  for (uint64 i = 0; i < header->entry_count; i++) {
+    EntryMetadata& metadata = (*entries)[records[i].entry_hash];
+    metadata.last_used = base::Time::FromInternalValue(records[i].last_used);
+    metadata.entry_size = records[i].entry_size;
+  }
+  return true;
+}
+
+// Static.
+void SimpleIndex::RestoreFromDisk(const FilePath& path, EntrySet* entries) {
+  file_util::CreateDirectory(path);
+  file_util::FileEnumerator enumerator(path, false,
+                                       file_util::FileEnumerator::FILES);
+  for (FilePath file_path = enumerator.Next(); !file_path.empty();
+       file_path = enumerator.Next()) {
+    uint64 entry_hash;
+    if (!GetEntryHashFromFilename(file_path.BaseName().MaybeAsASCII(),
+                                  &entry_hash)) {
+      continue;
+    }
+
+    // The files are not opened here; an entry that turns out to be invalid
+    // is removed when it is opened.
+    file_util::FileEnumerator::FindInfo find_info;
+    enumerator.GetFindInfo(&find_info);
+    EntryMetadata& metadata = (*entries)[entry_hash];
+    metadata.last_used =
+        file_util::FileEnumerator::GetLastModifiedTime(find_info);
+    metadata.entry_size = file_util::FileEnumerator::GetFilesize(find_info);
+  }
+}
+
+// Static.
+void SimpleIndex::WriteIndexFile(const FilePath& path,
+                                 const std::string& contents) {
+  FilePath index_dir = path.AppendASCII(kIndexDirName);
+  FilePath temp_path = index_dir.AppendASCII(kTempIndexFileName);
+  int size = static_cast<int>(contents.size());
+  if (!file_util::CreateDirectory(index_dir) ||
+      file_util::WriteFile(temp_path, contents.data(), size) != size ||
+      !file_util::ReplaceFile(temp_path, GetIndexFilePath(path))) {
+    LOG(WARNING) << "Unable to write the index of the simple cache";
+  }
+}
+
+void SimpleIndex::OnIndexLoaded(const base::Closure& callback,
+                                EntrySet* entries) {
+  DCHECK(entries_set_.empty());
+  entries_set_.swap(*entries);
+  cache_size_ = 0;
+  for (EntrySet::const_iterator it = entries_set_.begin();
+       it != entries_set_.end(); ++it) {
+    cache_size_ += it->second.entry_size;
+  }
+  callback.Run();
+}
+
+void SimpleIndex::ScheduleWriteToDisk() {
+  if (!write_to_disk_timer_.IsRunning()) {
+    write_to_disk_timer_.Start(
+        FROM_HERE, base::TimeDelta::FromSeconds(kWriteToDiskDelaySecs), this,
+        &SimpleIndex::OnWriteToDiskTimer);
+  }
+}
+
+void SimpleIndex::OnWriteToDiskTimer() {
+  WriteToDisk(false);
+}
+
+}  // namespace disk_cache
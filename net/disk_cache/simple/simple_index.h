@@ -0,0 +1,115 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/callback.h"
+#include "base/file_path.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/weak_ptr.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/time.h"
+#include "base/timer.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// The in-memory index of the simple cache: the hash, time of last use and
+// size of every entry, which is all that is needed to answer whether an entry
+// exists, to enumerate the cache and to pick the entries to evict, without
+// touching the files of the entries.
+//
+// The index lives on the thread of the backend. It is written to disk a while
+// after it changes, and when the backend goes away. A copy written while the
+// cache was running is only trusted if no entry file was added or removed
+// after it was written, and otherwise the index is rebuilt from the names,
+// sizes and times of the files, so that a crash does not lose the cache.
+class NET_EXPORT_PRIVATE SimpleIndex {
+ public:
+  SimpleIndex(base::SequencedWorkerPool* worker_pool, const FilePath& path);
+  ~SimpleIndex();
+
+  // Loads the index from disk, or rebuilds it, on the worker pool. |callback|
+  // is invoked once the index can be used.
+  void Initialize(const base::Closure& callback);
+
+  // Adds a new entry, or marks an existing one as used.
+  void Insert(uint64 entry_hash);
+  void Remove(uint64 entry_hash);
+  bool Has(uint64 entry_hash) const;
+
+  // Updates the time of last use of an entry. Returns false if the entry is
+  // not in the index.
+  bool UseIfExists(uint64 entry_hash);
+
+  // Updates the size of an entry on disk, if the entry is in the index.
+  void UpdateEntrySize(uint64 entry_hash, int64 entry_size);
+
+  int32 GetEntryCount() const;
+
+  // The total size of the entries.
+  int64 cache_size() const { return cache_size_; }
+
+  // Returns the entries used between |initial_time| and |end_time|. A null
+  // |end_time| means no upper limit.
+  void GetEntriesBetween(base::Time initial_time, base::Time end_time,
+                         std::vector<uint64>* entry_hashes) const;
+
+  // Returns all the entries, from the least to the most recently used.
+  void GetEntriesByLastUse(std::vector<uint64>* entry_hashes) const;
+
+  // Writes the index to disk right away. A |clean| index is trusted when the
+  // cache is opened again, so it should only be written when the backend is
+  // going away. Writes reach the disk in the order they are requested.
+  void WriteToDisk(bool clean);
+
+ private:
+  struct EntryMetadata {
+    EntryMetadata() : entry_size(0) {}
+
+    base::Time last_used;
+    int64 entry_size;
+  };
+  typedef base::hash_map<uint64, EntryMetadata> EntrySet;
+
+  // Fills |entries| on the worker pool, from the index file in |path| when
+  // it can be trusted, or from the files of the entries.
+  static void LoadFromDisk(const FilePath& path, EntrySet* entries);
+  static bool ReadIndexFile(const FilePath& path, EntrySet* entries);
+  static void RestoreFromDisk(const FilePath& path, EntrySet* entries);
+
+  static void WriteIndexFile(const FilePath& path,
+                             const std::string& contents);
+
+  // Takes the contents of the index once they are loaded.
+  void OnIndexLoaded(const base::Closure& callback, EntrySet* entries);
+
+  // Makes sure the index is written to disk at some point.
+  void ScheduleWriteToDisk();
+  void OnWriteToDiskTimer();
+
+  scoped_refptr<base::SequencedWorkerPool> worker_pool_;
+  // All the writes of the index file run on this sequence, so that a write
+  // never races with another one, nor overwrites a more recent one.
+  const base::SequencedWorkerPool::SequenceToken write_sequence_token_;
+  const FilePath path_;
+  EntrySet entries_set_;
+  int64 cache_size_;
+
+  base::OneShotTimer<SimpleIndex> write_to_disk_timer_;
+  base::WeakPtrFactory<SimpleIndex> ptr_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleIndex);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_INDEX_H_
@@ -0,0 +1,260 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/simple/simple_synchronous_entry.h"
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+
+using base::ClosePlatformFile;
+using base::CreatePlatformFile;
+using base::PlatformFileInfo;
+using base::ReadPlatformFile;
+using base::TruncatePlatformFile;
+using base::WritePlatformFile;
+
+namespace {
+
+// Reads exactly |size| bytes at |offset|.
+bool ReadAll(base::PlatformFile file, int64 offset, char* data, int size) {
+  return ReadPlatformFile(file, offset, data, size) == size;
+}
+
+bool WriteAll(base::PlatformFile file, int64 offset, const char* data,
+              int size) {
+  return WritePlatformFile(file, offset, data, size) == size;
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+SimpleEntryStat::SimpleEntryStat() {
+  for (int i = 0; i < kSimpleEntryStreamCount; i++)
+    data_size[i] = 0;
+}
+
+SimpleEntryStat::~SimpleEntryStat() {
+}
+
+SimpleSynchronousEntry::SimpleSynchronousEntry(const FilePath& path,
+                                               const std::string& key,
+                                               uint64 entry_hash)
+    : file_path_(path.AppendASCII(GetFilenameFromEntryHash(entry_hash))),
+      key_(key),
+      file_(base::kInvalidPlatformFileValue),
+      stream1_size_(0),
+      tail_invalid_(false) {
+}
+
+SimpleSynchronousEntry::~SimpleSynchronousEntry() {
+  if (file_ != base::kInvalidPlatformFileValue)
+    ClosePlatformFile(file_);
+}
+
+int SimpleSynchronousEntry::Open(SimpleEntryStat* stat) {
+  DCHECK_EQ(base::kInvalidPlatformFileValue, file_);
+  int flags = base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_READ |
+              base::PLATFORM_FILE_WRITE;
+  file_ = CreatePlatformFile(file_path_, flags, NULL, NULL);
+  if (file_ == base::kInvalidPlatformFileValue)
+    return net::ERR_CACHE_OPEN_FAILURE;
+
+  if (!ReadEntry(stat)) {
+    // Most likely, the entry was being modified when the cache went away.
+    // Only this entry is lost.
+    LOG(WARNING) << "Discarding invalid cache entry "
+                 << file_path_.BaseName().value();
+    ClosePlatformFile(file_);
+    file_ = base::kInvalidPlatformFileValue;
+    file_util::Delete(file_path_, false);
+    return net::ERR_CACHE_OPEN_FAILURE;
+  }
+  return net::OK;
+}
+
+int SimpleSynchronousEntry::Create() {
+  DCHECK_EQ(base::kInvalidPlatformFileValue, file_);
+  DCHECK(!key_.empty());
+  int flags = base::PLATFORM_FILE_CREATE_ALWAYS | base::PLATFORM_FILE_READ |
+              base::PLATFORM_FILE_WRITE;
+  file_ = CreatePlatformFile(file_path_, flags, NULL, NULL);
+  if (file_ == base::kInvalidPlatformFileValue)
+    return net::ERR_CACHE_CREATE_FAILURE;
+
+  SimpleFileHeader header;
+  header.initial_magic_number = kSimpleInitialMagicNumber;
+  header.version = kSimpleVersion;
+  header.key_length = static_cast<uint32>(key_.size());
+  if (!WriteAll(file_, 0, reinterpret_cast<const char*>(&header),
+                sizeof(header)) ||
+      !WriteAll(file_, sizeof(header), key_.data(),
+                static_cast<int>(key_.size()))) {
+    ClosePlatformFile(file_);
+    file_ = base::kInvalidPlatformFileValue;
+    file_util::Delete(file_path_, false);
+    return net::ERR_CACHE_CREATE_FAILURE;
+  }
+
+  stream1_size_ = 0;
+  tail_invalid_ = true;
+  return net::OK;
+}
+
+int SimpleSynchronousEntry::ReadData(int offset, net::IOBuffer* buf,
+                                     int buf_len) {
+  if (file_ == base::kInvalidPlatformFileValue)
+    return net::ERR_CACHE_READ_FAILURE;
+
+  int rv = ReadPlatformFile(file_, GetStream1Offset() + offset, buf->data(),
+                            buf_len);
+  return rv < 0 ? net::ERR_CACHE_READ_FAILURE : rv;
+}
+
+int SimpleSynchronousEntry::WriteData(int offset, net::IOBuffer* buf,
+                                      int buf_len, bool truncate) {
+  if (file_ == base::kInvalidPlatformFileValue || !InvalidateTail())
+    return net::ERR_CACHE_WRITE_FAILURE;
+
+  int64 file_offset = GetStream1Offset() + offset;
+  if (buf_len && !WriteAll(file_, file_offset, buf->data(), buf_len))
+    return net::ERR_CACHE_WRITE_FAILURE;
+
+  // The file always ends with stream 1 at this point, so growing the file
+  // fills any gap with zeros.
+  int32 end = offset + buf_len;
+  if (truncate || (!buf_len && end > stream1_size_)) {
+    if (!TruncatePlatformFile(file_, file_offset + buf_len))
+      return net::ERR_CACHE_WRITE_FAILURE;
+    stream1_size_ = end;
+  } else if (end > stream1_size_) {
+    stream1_size_ = end;
+  }
+  return buf_len;
+}
+
+int SimpleSynchronousEntry::WriteTail(const SimpleEntryStat& stat) {
+  if (file_ == base::kInvalidPlatformFileValue || !InvalidateTail())
+    return net::ERR_CACHE_WRITE_FAILURE;
+  DCHECK_EQ(stat.data_size[1], stream1_size_);
+
+  int64 offset = GetStream1Offset() + stream1_size_;
+  for (int i = 0; i < kSimpleEntryStreamCount; i += 2) {
+    DCHECK_EQ(stat.data_size[i],
+              static_cast<int32>(stat.stream_data[i].size()));
+    if (!WriteAll(file_, offset, stat.stream_data[i].data(),
+                  stat.data_size[i])) {
+      return net::ERR_CACHE_WRITE_FAILURE;
+    }
+    offset += stat.data_size[i];
+  }
+
+  SimpleFileEOF eof;
+  eof.final_magic_number = kSimpleFinalMagicNumber;
+  eof.last_used = stat.last_used.ToInternalValue();
+  eof.last_modified = stat.last_modified.ToInternalValue();
+  for (int i = 0; i < kSimpleEntryStreamCount; i++)
+    eof.data_size[i] = stat.data_size[i];
+  eof.pad = 0;
+  if (!WriteAll(file_, offset, reinterpret_cast<const char*>(&eof),
+                sizeof(eof)) ||
+      !TruncatePlatformFile(file_, offset + sizeof(eof))) {
+    return net::ERR_CACHE_WRITE_FAILURE;
+  }
+
+  tail_invalid_ = false;
+  return net::OK;
+}
+
+void SimpleSynchronousEntry::Doom() {
+  file_util::Delete(file_path_, false);
+}
+
+// Static.
+void SimpleSynchronousEntry::DeleteFileForEntryHash(const FilePath& path,
+                                                    uint64 entry_hash) {
+  file_util::Delete(path.AppendASCII(GetFilenameFromEntryHash(entry_hash)),
+                    false);
+}
+
+int64 SimpleSynchronousEntry::GetStream1Offset() const {
+  return sizeof(SimpleFileHeader) + key_.size();
+}
+
+bool SimpleSynchronousEntry::ReadEntry(SimpleEntryStat* stat) {
+  PlatformFileInfo info;
+  if (!base::GetPlatformFileInfo(file_, &info))
+    return false;
+  int64 file_size = info.size;
+  if (file_size < static_cast<int64>(sizeof(SimpleFileHeader) +
+                                     sizeof(SimpleFileEOF))) {
+    return false;
+  }
+
+  SimpleFileHeader header;
+  if (!ReadAll(file_, 0, reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.initial_magic_number != kSimpleInitialMagicNumber ||
+      header.version != kSimpleVersion ||
+      static_cast<int64>(header.key_length) >
+          file_size - static_cast<int64>(sizeof(SimpleFileEOF))) {
+    return false;
+  }
+
+  std::string key(header.key_length, '\0');
+  if (header.key_length &&
+      !ReadAll(file_, sizeof(header), &key[0], header.key_length)) {
+    return false;
+  }
+  if (key_.empty())
+    key_ = key;
+  else if (key != key_)
+    return false;  // A collision of the hash.
+
+  SimpleFileEOF eof;
+  if (!ReadAll(file_, file_size - sizeof(eof), reinterpret_cast<char*>(&eof),
+               sizeof(eof)) ||
+      eof.final_magic_number != kSimpleFinalMagicNumber) {
+    return false;
+  }
+  int64 expected_size = GetStream1Offset() + sizeof(eof);
+  for (int i = 0; i < kSimpleEntryStreamCount; i++) {
+    if (eof.data_size[i] < 0)
+      return false;
+    expected_size += eof.data_size[i];
+  }
+  if (expected_size != file_size)
+    return false;
+
+  stream1_size_ = eof.data_size[1];
+  int64 offset = GetStream1Offset() + stream1_size_;
+  for (int i = 0; i < kSimpleEntryStreamCount; i += 2) {
+    stat->stream_data[i].resize(eof.data_size[i]);
+    if (eof.data_size[i] &&
+        !ReadAll(file_, offset, &stat->stream_data[i][0], eof.data_size[i])) {
+      return false;
+    }
+    offset += eof.data_size[i];
+  }
+
+  stat->key = key_;
+  stat->last_used = base::Time::FromInternalValue(eof.last_used);
+  stat->last_modified = base::Time::FromInternalValue(eof.last_modified);
+  for (int i = 0; i < kSimpleEntryStreamCount; i++)
+    stat->data_size[i] = eof.data_size[i];
+  tail_invalid_ = false;
+  return true;
+}
+
+bool SimpleSynchronousEntry::InvalidateTail() {
+  if (tail_invalid_)
+    return true;
+  if (!TruncatePlatformFile(file_, GetStream1Offset() + stream1_size_))
+    return false;
+  tail_invalid_ = true;
+  return true;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,108 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_SIMPLE_SIMPLE_SYNCHRONOUS_ENTRY_H_
+#define NET_DISK_CACHE_SIMPLE_SIMPLE_SYNCHRONOUS_ENTRY_H_
+#pragma once
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/platform_file.h"
+#include "base/time.h"
+#include "net/disk_cache/simple/simple_entry_format.h"
+
+namespace net {
+class IOBuffer;
+}  // namespace net
+
+namespace disk_cache {
+
+// The state of an entry that goes back and forth between the entry and its
+// files: what Open() finds on disk, and what WriteTail() stores.
+struct SimpleEntryStat {
+  SimpleEntryStat();
+  ~SimpleEntryStat();
+
+  std::string key;
+  base::Time last_used;
+  base::Time last_modified;
+  int32 data_size[kSimpleEntryStreamCount];
+
+  // The contents of streams 0 and 2. The string for stream 1 is not used.
+  std::string stream_data[kSimpleEntryStreamCount];
+};
+
+// This class performs the blocking file operations of a SimpleEntryImpl, on a
+// thread of the worker pool of the backend. The object is created on the
+// thread of the backend, but from that point on it is only used by tasks of
+// the worker pool, which are sequenced so that only one of them touches the
+// object at any given time.
+//
+// Only the data of stream 1 is read and written by this class as it changes;
+// see simple_entry_format.h for the layout of the file.
+class SimpleSynchronousEntry {
+ public:
+  // |path| is the folder of the cache. |key| can be empty when the entry is
+  // opened by its hash, in which case it is read from the file.
+  SimpleSynchronousEntry(const FilePath& path, const std::string& key,
+                         uint64 entry_hash);
+
+  // Closes the file, if it is open.
+  ~SimpleSynchronousEntry();
+
+  // Opens the file of an existing entry, and fills |stat| with its contents.
+  // A file that is not valid is deleted. Returns a net error code.
+  int Open(SimpleEntryStat* stat);
+
+  // Creates the file of a new entry, replacing any file left over for the
+  // same hash. Returns a net error code.
+  int Create();
+
+  // Reads and writes stream 1, returning the number of bytes transferred or
+  // a net error code.
+  int ReadData(int offset, net::IOBuffer* buf, int buf_len);
+  int WriteData(int offset, net::IOBuffer* buf, int buf_len, bool truncate);
+
+  // Stores streams 0 and 2 and the record that marks the entry as complete.
+  // Returns a net error code.
+  int WriteTail(const SimpleEntryStat& stat);
+
+  // Deletes the file of the entry. The file stays open, so any operation
+  // that is still queued for the entry works with the deleted file.
+  void Doom();
+
+  // Deletes the file of the entry with |entry_hash| on the cache at |path|.
+  static void DeleteFileForEntryHash(const FilePath& path, uint64 entry_hash);
+
+ private:
+  // Returns the offset of the data of stream 1 within the file.
+  int64 GetStream1Offset() const;
+
+  // Reads and validates the file of the entry. Returns false if the file is
+  // not valid for this entry.
+  bool ReadEntry(SimpleEntryStat* stat);
+
+  // Removes the tail of the file before stream 1 is modified, so that the
+  // entry is not valid until WriteTail() runs again.
+  bool InvalidateTail();
+
+  FilePath file_path_;
+  std::string key_;
+  base::PlatformFile file_;
+
+  // The size of stream 1 on disk.
+  int32 stream1_size_;
+
+  // True while the file does not have a valid tail; the file ends at the end
+  // of stream 1 in that case.
+  bool tail_invalid_;
+
+  DISALLOW_COPY_AND_ASSIGN(SimpleSynchronousEntry);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SIMPLE_SIMPLE_SYNCHRONOUS_ENTRY_H_
@@ -14,6 +14,11 @@
 // To test that the disk cache doesn't generate critical errors with regular
 // application level crashes, edit stress_support.h.
 
+// With --benchmark, the application instead runs a fixed number of the same
+// cache operations on a fresh cache, without crashing, and reports how many
+// of them it completed per second. --simple selects the simple backend
+// instead of the block-file one, for both modes.
+
 #include <string>
 #include <vector>
 
@@ -37,6 +42,7 @@
 #include "net/disk_cache/backend_impl.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/disk_cache_test_util.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
 #include "net/disk_cache/stress_support.h"
 #include "net/disk_cache/trace.h"
 
@@ -49,12 +55,20 @@ using base::Time;
 const int kError = -1;
 const int kExpectedCrash = 100;
 
+const char kBenchmarkSwitch[] = "benchmark";
+const char kSimpleSwitch[] = "simple";
+
+// The number of cache operations timed by --benchmark.
+const int kBenchmarkOperations = 20000;
+
 // Starts a new process.
 int RunSlave(int iteration) {
   FilePath exe;
   PathService::Get(base::FILE_EXE, &exe);
 
   CommandLine cmdline(exe);
+  if (CommandLine::ForCurrentProcess()->HasSwitch(kSimpleSwitch))
+    cmdline.AppendSwitch(kSimpleSwitch);
   cmdline.AppendArg(base::IntToString(iteration));
 
   base::ProcessHandle handle;
@@ -95,29 +109,53 @@ std::string GenerateStressKey() {
   return std::string(key);
 }
 
-// This thread will loop forever, adding and removing entries from the cache.
-// iteration is the current crash cycle, so the entries on the cache are marked
-// to know which instance of the application wrote them.
-void StressTheCache(int iteration) {
+// Returns the cache at |path|, or NULL on failure. The simple backend is used
+// if |simple|, and the block-file one, which runs on |cache_thread|, if not.
+disk_cache::Backend* CreateCache(const FilePath& path, bool simple,
+                                 base::Thread* cache_thread) {
   int cache_size = 0x2000000;  // 32MB.
   uint32 mask = 0xfff;  // 4096 entries.
-  FilePath path = GetCacheFilePath().InsertBeforeExtensionASCII("_stress");
 
-  base::Thread cache_thread("CacheThread");
-  if (!cache_thread.StartWithOptions(
-          base::Thread::Options(MessageLoop::TYPE_IO, 0)))
-    return;
+  net::TestCompletionCallback cb;
+  if (simple) {
+    disk_cache::Backend* cache = NULL;
+    int rv = disk_cache::SimpleBackendImpl::CreateBackend(
+        path, cache_size, NULL, &cache, cb.callback());
+    return cb.GetResult(rv) == net::OK ? cache : NULL;
+  }
 
   disk_cache::BackendImpl* cache =
-      new disk_cache::BackendImpl(path, mask, cache_thread.message_loop_proxy(),
-                                  NULL);
+      new disk_cache::BackendImpl(path, mask,
+                                  cache_thread->message_loop_proxy(), NULL);
   cache->SetMaxSize(cache_size);
   cache->SetFlags(disk_cache::kNoLoadProtection);
 
-  net::TestCompletionCallback cb;
   int rv = cache->Init(cb.callback());
-
   if (cb.GetResult(rv) != net::OK) {
+    delete cache;
+    return NULL;
+  }
+  return cache;
+}
+
+// This thread will loop forever, adding and removing entries from the cache.
+// iteration is the current crash cycle, so the entries on the cache are marked
+// to know which instance of the application wrote them. If |benchmark|, the
+// loop starts from an empty cache, stops after kBenchmarkOperations and
+// reports its speed instead.
+void StressTheCache(int iteration, bool simple, bool benchmark) {
+  FilePath path = GetCacheFilePath().InsertBeforeExtensionASCII(
+      simple ? "_stress_simple" : "_stress");
+  if (benchmark)
+    DeleteCache(path);
+
+  base::Thread cache_thread("CacheThread");
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(MessageLoop::TYPE_IO, 0)))
+    return;
+
+  disk_cache::Backend* cache = CreateCache(path, simple, &cache_thread);
+  if (!cache) {
     printf("Unable to initialize cache.\n");
     return;
   }
@@ -146,7 +184,9 @@ void StressTheCache(int iteration) {
   scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
   memset(buffer->data(), 'k', kSize);
 
-  for (int i = 0;; i++) {
+  int rv;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int i = 0; !benchmark || i < kBenchmarkOperations; i++) {
     int slot = rand() % kNumEntries;
     int key = rand() % kNumKeys;
     bool truncate = rand() % 2 ? false : true;
@@ -178,6 +218,18 @@ void StressTheCache(int iteration) {
     if (!(i % 100))
       printf("Entries: %d    \r", i);
   }
+
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+  printf("\n%s backend: %d operations in %d ms, %.0f operations/s\n",
+         simple ? "Simple" : "Block-file", kBenchmarkOperations,
+         static_cast<int>(elapsed.InMilliseconds()),
+         kBenchmarkOperations / elapsed.InSecondsF());
+
+  for (int i = 0; i < kNumEntries; i++) {
+    if (entries[i])
+      entries[i]->Close();
+  }
+  delete cache;
 }
 
 // We want to prevent the timer thread from killing the process while we are
@@ -255,7 +307,17 @@ int main(int argc, const char* argv[]) {
   // Setup an AtExitManager so Singleton objects will be destructed.
   base::AtExitManager at_exit_manager;
 
-  if (argc < 2)
+  CommandLine::Init(argc, argv);
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  bool simple = command_line.HasSwitch(kSimpleSwitch);
+
+  if (command_line.HasSwitch(kBenchmarkSwitch)) {
+    MessageLoop message_loop(MessageLoop::TYPE_IO);
+    StressTheCache(0, simple, true);
+    return 0;
+  }
+
+  if (command_line.GetArgs().empty())
     return MasterCode();
 
   logging::SetLogAssertHandler(CrashHandler);
@@ -264,7 +326,6 @@ int main(int argc, const char* argv[]) {
 #if defined(OS_WIN)
   logging::LogEventProvider::Initialize(kStressCacheTraceProviderName);
 #else
-  CommandLine::Init(argc, argv);
   logging::InitLogging(NULL, logging::LOG_ONLY_TO_SYSTEM_DEBUG_LOG,
                        logging::LOCK_LOG_FILE, logging::DELETE_OLD_LOG_FILE,
                        logging::DISABLE_DCHECK_FOR_NON_OFFICIAL_RELEASE_BUILDS);
@@ -274,14 +335,17 @@ int main(int argc, const char* argv[]) {
   base::PlatformThread::Sleep(base::TimeDelta::FromSeconds(3));
   MessageLoop message_loop(MessageLoop::TYPE_IO);
 
-  char* end;
-  long int iteration = strtol(argv[1], &end, 0);
+  int iteration;
+  if (!base::StringToInt(command_line.GetArgs()[0], &iteration)) {
+    printf("Invalid iteration\n");
+    return kError;
+  }
 
   if (!StartCrashThread()) {
     printf("failed to start thread\n");
     return kError;
   }
 
-  StressTheCache(iteration);
+  StressTheCache(iteration, simple, false);
   return 0;
 }
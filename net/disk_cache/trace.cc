@@ -9,7 +9,9 @@
 #include <windows.h>
 #endif
 
+#include "base/lazy_instance.h"
 #include "base/logging.h"
+#include "base/synchronization/lock.h"
 #include "net/disk_cache/stress_support.h"
 
 // Change this value to 1 to enable tracing on a release build. By default,
@@ -32,6 +34,10 @@ const int kNumberOfEntries = 5000;  // 240 KB.
 
 bool s_trace_enabled = false;
 
+// Protects the trace buffer and object, which are shared by all the caches
+// (and cache threads) of the process.
+base::LazyInstance<base::Lock>::Leaky s_trace_lock = LAZY_INSTANCE_INITIALIZER;
+
 struct TraceBuffer {
   int num_traces;
   int current;
@@ -59,6 +65,7 @@ static TraceObject* s_trace_object = NULL;
 
 // Static.
 TraceObject* TraceObject::GetTraceObject() {
+  base::AutoLock lock(s_trace_lock.Get());
   if (s_trace_object)
     return s_trace_object;
 
@@ -71,6 +78,7 @@ TraceObject::TraceObject() {
 }
 
 TraceObject::~TraceObject() {
+  base::AutoLock lock(s_trace_lock.Get());
   DestroyTrace();
 }
 
@@ -98,7 +106,11 @@ void DestroyTrace(void) {
 }
 
 void Trace(const char* format, ...) {
-  if (!s_trace_buffer || !s_trace_enabled)
+  if (!s_trace_enabled)
+    return;
+
+  base::AutoLock lock(s_trace_lock.Get());
+  if (!s_trace_buffer)
     return;
 
   va_list ap;
@@ -129,6 +141,7 @@ void Trace(const char* format, ...) {
 
 // Writes the last num_traces to the debugger output.
 void DumpTrace(int num_traces) {
+  base::AutoLock lock(s_trace_lock.Get());
   DCHECK(s_trace_buffer);
   DebugOutput("Last traces:\n");
 
@@ -40,6 +40,11 @@ class DnsClientImpl : public DnsClient {
     return session_.get() ? factory_.get() : NULL;
   }
 
+  virtual void ClearCache() OVERRIDE {
+    if (session_.get())
+      session_->ClearCache();
+  }
+
  private:
   scoped_refptr<DnsSession> session_;
   scoped_ptr<DnsTransactionFactory> factory_;
@@ -30,6 +30,9 @@ class NET_EXPORT DnsClient {
   // Returns NULL if the current config is not valid.
   virtual DnsTransactionFactory* GetTransactionFactory() = 0;
 
+  // Drops all responses cached by the transactions.
+  virtual void ClearCache() = 0;
+
   // Creates default client.
   static scoped_ptr<DnsClient> CreateClient(NetLog* net_log);
 };
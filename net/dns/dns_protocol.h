@@ -104,6 +104,7 @@ static const uint16 kClassIN = 1;
 // http://www.iana.org/assignments/dns-parameters
 static const uint16 kTypeA = 1;
 static const uint16 kTypeCNAME = 5;
+static const uint16 kTypeSOA = 6;
 static const uint16 kTypeTXT = 16;
 static const uint16 kTypeAAAA = 28;
 
@@ -190,6 +190,11 @@ unsigned DnsResponse::answer_count() const {
   return ntohs(header()->ancount);
 }
 
+unsigned DnsResponse::authority_count() const {
+  DCHECK(parser_.IsValid());
+  return ntohs(header()->nscount);
+}
+
 base::StringPiece DnsResponse::qname() const {
   DCHECK(parser_.IsValid());
   // The response is HEADER QNAME QTYPE QCLASS ANSWER.
@@ -106,7 +106,7 @@ class NET_EXPORT_PRIVATE DnsResponse {
 
   // Internal buffer accessor into which actual bytes of response will be
   // read.
-  IOBufferWithSize* io_buffer() { return io_buffer_.get(); }
+  IOBufferWithSize* io_buffer() const { return io_buffer_.get(); }
 
   // Returns false if the packet is shorter than the header or does not match
   // |query| id or question.
@@ -121,6 +121,7 @@ class NET_EXPORT_PRIVATE DnsResponse {
   uint16 flags() const;  // excluding rcode
   uint8 rcode() const;
   unsigned answer_count() const;
+  unsigned authority_count() const;
 
   // Accessors to the question. The qname is unparsed.
   base::StringPiece qname() const;
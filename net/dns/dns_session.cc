@@ -4,15 +4,80 @@
 
 #include "net/dns/dns_session.h"
 
+#include <algorithm>
+
 #include "base/basictypes.h"
 #include "base/bind.h"
+#include "base/logging.h"
+#include "base/sys_byteorder.h"
 #include "base/time.h"
+#include "net/base/big_endian.h"
+#include "net/base/io_buffer.h"
 #include "net/base/ip_endpoint.h"
 #include "net/dns/dns_config_service.h"
+#include "net/dns/dns_protocol.h"
+#include "net/dns/dns_query.h"
+#include "net/dns/dns_response.h"
 #include "net/socket/client_socket_factory.h"
 
 namespace net {
 
+namespace {
+
+// Maximum number of responses kept in the cache.
+const size_t kMaxCacheEntries = 256;
+
+// Lower bound of the RTT-based timeout, so that a handful of fast responses
+// cannot make us retransmit on the slightest jitter.
+const int kMinTimeoutMs = 100;
+
+// Size of the fixed fields at the end of SOA RDATA: SERIAL, REFRESH, RETRY,
+// EXPIRE and MINIMUM.
+const size_t kSOAFixedSize = 5 * sizeof(uint32);
+
+// Reads |count| records from |parser|, appending the offset of the TTL of
+// each to |ttl_offsets| and lowering |min_ttl| to the smallest TTL seen, or
+// to the negative TTL of an SOA record if |use_soa| is set. Returns false if
+// the records are malformed.
+bool ReadRecords(DnsRecordParser* parser,
+                 unsigned count,
+                 bool use_soa,
+                 std::vector<size_t>* ttl_offsets,
+                 uint32* min_ttl) {
+  DnsResourceRecord record;
+  for (unsigned i = 0; i < count; ++i) {
+    if (!parser->ReadRecord(&record))
+      return false;
+    // The TTL is followed by RDLENGTH and RDATA.
+    ttl_offsets->push_back(parser->GetOffset() - record.rdata.size() -
+                           sizeof(uint16) - sizeof(uint32));
+    if (!use_soa) {
+      *min_ttl = std::min(*min_ttl, record.ttl);
+    } else if (record.type == dns_protocol::kTypeSOA &&
+               record.rdata.size() >= kSOAFixedSize) {
+      // RFC 2308, section 5: the negative TTL is the smaller of the TTL of
+      // the SOA record and its MINIMUM field.
+      uint32 minimum;
+      ReadBigEndian<uint32>(record.rdata.data() + record.rdata.size() -
+                                sizeof(uint32),
+                            &minimum);
+      *min_ttl = std::min(*min_ttl, std::min(record.ttl, minimum));
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+DnsSession::ServerStats::ServerStats() : num_samples(0), num_failures(0) {
+}
+
+DnsSession::CacheEntry::CacheEntry() {
+}
+
+DnsSession::CacheEntry::~CacheEntry() {
+}
+
 DnsSession::DnsSession(const DnsConfig& config,
                        ClientSocketFactory* factory,
                        const RandIntCallback& rand_int_callback,
@@ -21,7 +86,9 @@ DnsSession::DnsSession(const DnsConfig& config,
       socket_factory_(factory),
       rand_callback_(base::Bind(rand_int_callback, 0, kuint16max)),
       net_log_(net_log),
-      server_index_(0) {
+      server_index_(0),
+      server_stats_(config.nameservers.size()),
+      cache_(kMaxCacheEntries) {
 }
 
 int DnsSession::NextQueryId() const {
@@ -29,16 +96,146 @@ int DnsSession::NextQueryId() const {
 }
 
 int DnsSession::NextFirstServerIndex() {
+  if (!config_.rotate) {
+    int index = 0;
+    for (size_t i = 1; i < server_stats_.size(); ++i) {
+      if (server_stats_[i].num_failures < server_stats_[index].num_failures)
+        index = i;
+    }
+    return index;
+  }
   int index = server_index_;
-  if (config_.rotate)
-    server_index_ = (server_index_ + 1) % config_.nameservers.size();
+  server_index_ = (server_index_ + 1) % config_.nameservers.size();
   return index;
 }
 
-base::TimeDelta DnsSession::NextTimeout(int attempt) {
+base::TimeDelta DnsSession::NextTimeout(int server_index, int attempt) {
+  DCHECK_GE(server_index, 0);
+  DCHECK_LT(static_cast<size_t>(server_index), server_stats_.size());
+  const ServerStats& stats = server_stats_[server_index];
+  base::TimeDelta timeout = config_.timeout;
+  if (stats.num_samples > 0) {
+    // RFC 6298, section 2: RTO = SRTT + 4 * RTTVAR, bounded by the configured
+    // timeout.
+    timeout = std::min(stats.srtt + stats.rttvar * 4, config_.timeout);
+    timeout = std::max(timeout,
+                       std::min(base::TimeDelta::FromMilliseconds(
+                                    kMinTimeoutMs),
+                                config_.timeout));
+  }
   // The timeout doubles every full round (each nameserver once).
-  // TODO(szym): Adapt timeout to observed RTT. http://crbug.com/110197
-  return config_.timeout * (1 << (attempt / config_.nameservers.size()));
+  return timeout * (1 << (attempt / config_.nameservers.size()));
+}
+
+base::TimeDelta DnsSession::QueryTimeout() const {
+  // The doubling rounds add up to 2^attempts - 1 times the first one.
+  int64 rounds = (GG_INT64_C(1) << config_.attempts) - 1;
+  return config_.timeout * rounds *
+      static_cast<int64>(config_.nameservers.size());
+}
+
+void DnsSession::RecordRTT(int server_index, base::TimeDelta rtt) {
+  DCHECK_GE(server_index, 0);
+  DCHECK_LT(static_cast<size_t>(server_index), server_stats_.size());
+  ServerStats& stats = server_stats_[server_index];
+  stats.num_failures = 0;
+  if (stats.num_samples++ == 0) {
+    stats.srtt = rtt;
+    stats.rttvar = rtt / 2;
+    return;
+  }
+  // RFC 6298, section 2.3, with alpha = 1/8 and beta = 1/4.
+  base::TimeDelta error = stats.srtt - rtt;
+  if (error < base::TimeDelta())
+    error = -error;
+  stats.rttvar = (stats.rttvar * 3 + error) / 4;
+  stats.srtt = (stats.srtt * 7 + rtt) / 8;
+}
+
+void DnsSession::RecordLostPacket(int server_index) {
+  DCHECK_GE(server_index, 0);
+  DCHECK_LT(static_cast<size_t>(server_index), server_stats_.size());
+  ++server_stats_[server_index].num_failures;
+}
+
+void DnsSession::CacheResponse(const DnsResponse& response,
+                               base::TimeTicks now) {
+  DCHECK(response.IsValid());
+  bool negative;
+  if (response.rcode() == dns_protocol::kRcodeNXDOMAIN) {
+    negative = true;
+  } else if (response.rcode() == dns_protocol::kRcodeNOERROR) {
+    negative = (response.answer_count() == 0);
+  } else {
+    return;
+  }
+
+  // Keep the answer section of positive responses and the authority section
+  // of negative ones, so that their TTLs can be aged.
+  CacheEntry entry;
+  uint32 min_ttl = kuint32max;
+  DnsRecordParser parser = response.Parser();
+  if (!ReadRecords(&parser, response.answer_count(), false,
+                   &entry.ttl_offsets, &min_ttl)) {
+    return;
+  }
+  unsigned authority_count = 0;
+  if (negative) {
+    authority_count = response.authority_count();
+    if (!ReadRecords(&parser, authority_count, true, &entry.ttl_offsets,
+                     &min_ttl)) {
+      return;
+    }
+  }
+  if (min_ttl == 0 || min_ttl == kuint32max)
+    return;
+
+  entry.packet.assign(response.io_buffer()->data(), parser.GetOffset());
+  dns_protocol::Header* header =
+      reinterpret_cast<dns_protocol::Header*>(&entry.packet[0]);
+  header->id = 0;
+  header->nscount = htons(authority_count);
+  header->arcount = 0;
+  entry.stored = now;
+  entry.expiration = now + base::TimeDelta::FromSeconds(min_ttl);
+
+  cache_.Put(std::make_pair(response.qname().as_string(), response.qtype()),
+             entry);
+}
+
+scoped_ptr<DnsResponse> DnsSession::GetCachedResponse(
+    const base::StringPiece& qname,
+    uint16 qtype,
+    base::TimeTicks now) {
+  ResponseCache::iterator it =
+      cache_.Get(std::make_pair(qname.as_string(), qtype));
+  if (it == cache_.end())
+    return scoped_ptr<DnsResponse>();
+  const CacheEntry& entry = it->second;
+  if (entry.expiration <= now) {
+    cache_.Erase(it);
+    return scoped_ptr<DnsResponse>();
+  }
+
+  scoped_ptr<DnsResponse> response(new DnsResponse());
+  char* packet = response->io_buffer()->data();
+  memcpy(packet, entry.packet.data(), entry.packet.size());
+  uint32 age = static_cast<uint32>((now - entry.stored).InSeconds());
+  for (size_t i = 0; i < entry.ttl_offsets.size(); ++i) {
+    uint32 ttl;
+    ReadBigEndian<uint32>(packet + entry.ttl_offsets[i], &ttl);
+    WriteBigEndian<uint32>(packet + entry.ttl_offsets[i],
+                           ttl > age ? ttl - age : 0);
+  }
+
+  DnsQuery query(0, qname, qtype);
+  bool rv = response->InitParse(entry.packet.size(), query);
+  DCHECK(rv);
+  return response.Pass();
+}
+
+void DnsSession::ClearCache() {
+  cache_.Clear();
 }
 
 DnsSession::~DnsSession() {}
@@ -6,8 +6,14 @@
 #define NET_DNS_DNS_SESSION_H_
 #pragma once
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/memory/mru_cache.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/string_piece.h"
 #include "base/time.h"
 #include "net/base/net_export.h"
 #include "net/base/rand_callback.h"
@@ -16,6 +22,7 @@
 namespace net {
 
 class ClientSocketFactory;
+class DnsResponse;
 class NetLog;
 
 // Session parameters and state shared between DNS transactions.
@@ -40,13 +47,77 @@ class NET_EXPORT_PRIVATE DnsSession
   int NextQueryId() const;
 
   // Return the index of the first configured server to use on first attempt.
+  // With |config_.rotate| the servers are used round-robin; otherwise the
+  // first server in config order that did not time out more often than the
+  // others is used.
   int NextFirstServerIndex();
 
-  // Return the timeout for the next query.
-  base::TimeDelta NextTimeout(int attempt);
+  // Return the timeout for the next query to |server_index|, which is
+  // |attempt| in a transaction. Before the first response from the server
+  // this is |config_.timeout|, afterwards it follows the RTT estimate of the
+  // server. Either doubles every full round (each nameserver once).
+  base::TimeDelta NextTimeout(int server_index, int attempt);
+
+  // Return how long a query waits for any of its attempts to be answered:
+  // |config_.attempts| full rounds of |config_.timeout|, doubling every
+  // round. NextTimeout() only paces the attempts within it.
+  base::TimeDelta QueryTimeout() const;
+
+  // Updates the RTT estimate of |server_index| with a response received
+  // |rtt| after its query was sent.
+  void RecordRTT(int server_index, base::TimeDelta rtt);
+
+  // Records that a query to |server_index| went unanswered until it timed
+  // out.
+  void RecordLostPacket(int server_index);
+
+  // Caches |response| until its records expire. Positive responses live for
+  // the smallest TTL in the answer section. NXDOMAIN and empty NOERROR
+  // responses live for the negative TTL of the SOA record in the authority
+  // section (RFC 2308), and are not cached if there is none.
+  void CacheResponse(const DnsResponse& response, base::TimeTicks now);
+
+  // Returns a copy of the response cached for |qname| (in DNS format) and
+  // |qtype| with the TTLs of its records reduced by the time spent in the
+  // cache, or NULL if there is no unexpired one. The returned response is
+  // valid and has the ID 0.
+  scoped_ptr<DnsResponse> GetCachedResponse(const base::StringPiece& qname,
+                                            uint16 qtype,
+                                            base::TimeTicks now);
+
+  // Removes all cached responses.
+  void ClearCache();
 
  private:
   friend class base::RefCounted<DnsSession>;
+
+  // Smoothed RTT state of a nameserver, as in RFC 6298.
+  struct ServerStats {
+    ServerStats();
+
+    // Number of responses the estimate is based on.
+    int num_samples;
+    base::TimeDelta srtt;
+    base::TimeDelta rttvar;
+    // Number of queries that timed out since the last response.
+    int num_failures;
+  };
+
+  // A response kept in |cache_|, with the offsets of the TTLs of its records.
+  struct CacheEntry {
+    CacheEntry();
+    ~CacheEntry();
+
+    std::string packet;
+    std::vector<size_t> ttl_offsets;
+    base::TimeTicks stored;
+    base::TimeTicks expiration;
+  };
+
+  // Keyed by qname and qtype.
+  typedef base::MRUCache<std::pair<std::string, uint16>, CacheEntry>
+      ResponseCache;
+
   ~DnsSession();
 
   const DnsConfig config_;
@@ -57,7 +128,11 @@ class NET_EXPORT_PRIVATE DnsSession
   // Current index into |config_.nameservers| to begin resolution with.
   int server_index_;
 
-  // TODO(szym): Add current RTT estimate.
+  // Indexed like |config_.nameservers|.
+  std::vector<ServerStats> server_stats_;
+
+  ResponseCache cache_;
+
   // TODO(szym): Add TCP connection pool to support DNS over TCP.
   // TODO(szym): Add UDP port pool to avoid NAT table overload.
 
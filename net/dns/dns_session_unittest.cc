@@ -0,0 +1,175 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/dns/dns_session.h"
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/rand_util.h"
+#include "base/sys_byteorder.h"
+#include "base/time.h"
+#include "net/base/address_list.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_util.h"
+#include "net/dns/dns_protocol.h"
+#include "net/dns/dns_query.h"
+#include "net/dns/dns_response.h"
+#include "net/dns/dns_test_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+using base::TimeDelta;
+using base::TimeTicks;
+
+base::StringPiece T0Qname() {
+  return base::StringPiece(kT0DnsName, arraysize(kT0DnsName));
+}
+
+class DnsSessionTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    IPAddressNumber dns_ip;
+    ASSERT_TRUE(ParseIPLiteralToNumber("192.168.1.0", &dns_ip));
+    for (int i = 0; i < 2; ++i) {
+      dns_ip[3] = i;
+      config_.nameservers.push_back(IPEndPoint(dns_ip,
+                                               dns_protocol::kDefaultPort));
+    }
+    config_.timeout = TimeDelta::FromSeconds(2);
+    CreateSession();
+  }
+
+  void CreateSession() {
+    session_ = new DnsSession(config_, NULL, base::Bind(&base::RandInt),
+                              NULL /* NetLog */);
+  }
+
+  // Returns |data| of |size| bytes parsed as a response to |query|.
+  scoped_ptr<DnsResponse> CreateResponse(const DnsQuery& query,
+                                         const char* data,
+                                         size_t size) {
+    scoped_ptr<DnsResponse> response(new DnsResponse());
+    memcpy(response->io_buffer()->data(), data, size);
+    EXPECT_TRUE(response->InitParse(size, query));
+    return response.Pass();
+  }
+
+  DnsConfig config_;
+  scoped_refptr<DnsSession> session_;
+};
+
+TEST_F(DnsSessionTest, TimeoutFollowsRTT) {
+  // Without a response from the server the configured timeout is used.
+  EXPECT_EQ(config_.timeout, session_->NextTimeout(0, 0));
+  EXPECT_EQ(config_.timeout * 2, session_->NextTimeout(0, 2));
+
+  // RTO = SRTT + 4 * RTTVAR = 200ms + 4 * 100ms.
+  session_->RecordRTT(0, TimeDelta::FromMilliseconds(200));
+  EXPECT_EQ(TimeDelta::FromMilliseconds(600), session_->NextTimeout(0, 0));
+  EXPECT_EQ(TimeDelta::FromMilliseconds(1200), session_->NextTimeout(0, 3));
+  EXPECT_EQ(config_.timeout, session_->NextTimeout(1, 1));
+
+  // Steady responses shrink the variance.
+  for (int i = 0; i < 20; ++i)
+    session_->RecordRTT(0, TimeDelta::FromMilliseconds(200));
+  EXPECT_LT(session_->NextTimeout(0, 0), TimeDelta::FromMilliseconds(210));
+
+  // The timeout is bounded on both sides.
+  session_->RecordRTT(1, TimeDelta::FromMicroseconds(100));
+  EXPECT_EQ(TimeDelta::FromMilliseconds(100), session_->NextTimeout(1, 0));
+  for (int i = 0; i < 20; ++i)
+    session_->RecordRTT(0, TimeDelta::FromSeconds(5));
+  EXPECT_EQ(config_.timeout, session_->NextTimeout(0, 0));
+}
+
+TEST_F(DnsSessionTest, ServerSelection) {
+  // The first server is preferred until it fails to respond.
+  EXPECT_EQ(0, session_->NextFirstServerIndex());
+  EXPECT_EQ(0, session_->NextFirstServerIndex());
+  session_->RecordLostPacket(0);
+  EXPECT_EQ(1, session_->NextFirstServerIndex());
+  session_->RecordLostPacket(1);
+  EXPECT_EQ(0, session_->NextFirstServerIndex());
+  session_->RecordRTT(0, TimeDelta::FromMilliseconds(10));
+  EXPECT_EQ(0, session_->NextFirstServerIndex());
+
+  // With rotation the servers are used round-robin regardless.
+  config_.rotate = true;
+  CreateSession();
+  session_->RecordLostPacket(1);
+  EXPECT_EQ(0, session_->NextFirstServerIndex());
+  EXPECT_EQ(1, session_->NextFirstServerIndex());
+  EXPECT_EQ(0, session_->NextFirstServerIndex());
+}
+
+TEST_F(DnsSessionTest, CachePositiveResponse) {
+  DnsQuery query(0, T0Qname(), kT0Qtype);
+  scoped_ptr<DnsResponse> response = CreateResponse(
+      query, reinterpret_cast<const char*>(kT0ResponseDatagram),
+      arraysize(kT0ResponseDatagram));
+
+  TimeTicks now = TimeTicks::Now();
+  session_->CacheResponse(*response, now);
+
+  scoped_ptr<DnsResponse> cached = session_->GetCachedResponse(
+      T0Qname(), kT0Qtype, now + TimeDelta::FromSeconds(28));
+  ASSERT_TRUE(cached.get());
+  EXPECT_EQ(dns_protocol::kRcodeNOERROR, cached->rcode());
+  EXPECT_EQ(arraysize(kT0IpAddresses) + 1, cached->answer_count());
+  AddressList addr_list;
+  TimeDelta ttl;
+  EXPECT_EQ(DnsResponse::DNS_SUCCESS,
+            cached->ParseToAddressList(&addr_list, &ttl));
+  // The TTLs have been aged.
+  EXPECT_EQ(TimeDelta::FromSeconds(kT0TTL - 28), ttl);
+
+  EXPECT_FALSE(session_->GetCachedResponse(
+      T0Qname(), dns_protocol::kTypeAAAA, now).get());
+  EXPECT_FALSE(session_->GetCachedResponse(
+      T0Qname(), kT0Qtype, now + TimeDelta::FromSeconds(kT0TTL)).get());
+
+  session_->CacheResponse(*response, now);
+  session_->ClearCache();
+  EXPECT_FALSE(session_->GetCachedResponse(T0Qname(), kT0Qtype, now).get());
+}
+
+TEST_F(DnsSessionTest, CacheNegativeResponse) {
+  DnsQuery query(0, T0Qname(), kT0Qtype);
+  std::string data = CreateNXDomainResponse(query, 60);
+  scoped_ptr<DnsResponse> response =
+      CreateResponse(query, data.data(), data.size());
+
+  TimeTicks now = TimeTicks::Now();
+  session_->CacheResponse(*response, now);
+
+  scoped_ptr<DnsResponse> cached = session_->GetCachedResponse(
+      T0Qname(), kT0Qtype, now + TimeDelta::FromSeconds(59));
+  ASSERT_TRUE(cached.get());
+  EXPECT_EQ(dns_protocol::kRcodeNXDOMAIN, cached->rcode());
+  EXPECT_EQ(1u, cached->authority_count());
+  EXPECT_FALSE(session_->GetCachedResponse(
+      T0Qname(), kT0Qtype, now + TimeDelta::FromSeconds(60)).get());
+
+  // Without an SOA record the negative TTL is unknown.
+  DnsQuery query2(0, T0Qname(), dns_protocol::kTypeAAAA);
+  data.assign(query2.io_buffer()->data(), query2.io_buffer()->size());
+  dns_protocol::Header* header =
+      reinterpret_cast<dns_protocol::Header*>(&data[0]);
+  header->flags |= htons(dns_protocol::kFlagResponse |
+                         dns_protocol::kRcodeNXDOMAIN);
+  response = CreateResponse(query2, data.data(), data.size());
+  session_->CacheResponse(*response, now);
+  EXPECT_FALSE(session_->GetCachedResponse(
+      T0Qname(), dns_protocol::kTypeAAAA, now).get());
+}
+
+}  // namespace
+
+}  // namespace net
@@ -26,8 +26,8 @@ namespace net {
 namespace {
 
 // A DnsTransaction which responds with loopback to all queries starting with
-// "ok", fails synchronously on all queries starting with "er", and NXDOMAIN to
-// all others.
+// "ok" and to A queries starting with "v4", fails synchronously on all queries
+// starting with "er", and NXDOMAIN to all others.
 class MockTransaction : public DnsTransaction,
                         public base::SupportsWeakPtr<MockTransaction> {
  public:
@@ -62,7 +62,9 @@ class MockTransaction : public DnsTransaction,
 
  private:
   void Finish() {
-    if (hostname_.substr(0, 2) == "ok") {
+    if (hostname_.substr(0, 2) == "ok" ||
+        (hostname_.substr(0, 2) == "v4" &&
+         qtype_ == dns_protocol::kTypeA)) {
       std::string qname;
       DNSDomainFromDot(hostname_, &qname);
       DnsQuery query(0, qname, qtype_);
@@ -150,6 +152,8 @@ class MockDnsClient : public DnsClient {
     return config_.IsValid() ? &factory_ : NULL;
   }
 
+  virtual void ClearCache() OVERRIDE {}
+
  private:
   DnsConfig config_;
   MockTransactionFactory factory_;
@@ -162,6 +166,42 @@ scoped_ptr<DnsClient> CreateMockDnsClient(const DnsConfig& config) {
   return scoped_ptr<DnsClient>(new MockDnsClient(config));
 }
 
+std::string CreateNXDomainResponse(const DnsQuery& query,
+                                   uint32 negative_ttl) {
+  const uint16 kPointerToQueryName =
+      static_cast<uint16>(0xc000 | sizeof(net::dns_protocol::Header));
+  // Root MNAME and RNAME, followed by SERIAL, REFRESH, RETRY, EXPIRE and
+  // MINIMUM.
+  const size_t kRdataSize = 2 + 5 * sizeof(uint32);
+  // Sizes of the compressed name reference, TYPE, CLASS, TTL and RDLENGTH.
+  const size_t kRecordSize = 12 + kRdataSize;
+
+  std::string response(query.io_buffer()->data(), query.io_buffer()->size());
+  response.resize(response.size() + kRecordSize);
+  dns_protocol::Header* header =
+      reinterpret_cast<dns_protocol::Header*>(&response[0]);
+  header->flags |= htons(dns_protocol::kFlagResponse |
+                         dns_protocol::kRcodeNXDOMAIN);
+  header->nscount = htons(1);
+
+  BigEndianWriter writer(&response[query.io_buffer()->size()], kRecordSize);
+  writer.WriteU16(kPointerToQueryName);
+  writer.WriteU16(dns_protocol::kTypeSOA);
+  writer.WriteU16(dns_protocol::kClassIN);
+  // The TTL of the record is larger than MINIMUM, which thus determines the
+  // negative TTL.
+  writer.WriteU32(negative_ttl * 2);
+  writer.WriteU16(kRdataSize);
+  writer.WriteU8(0);
+  writer.WriteU8(0);
+  writer.WriteU32(1);  // SERIAL
+  writer.WriteU32(3600);  // REFRESH
+  writer.WriteU32(600);  // RETRY
+  writer.WriteU32(86400);  // EXPIRE
+  writer.WriteU32(negative_ttl);  // MINIMUM
+  return response;
+}
+
 void MockDnsConfigService::Watch(const CallbackType& callback) {
   set_callback(callback);
 }
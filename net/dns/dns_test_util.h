@@ -6,6 +6,8 @@
 #define NET_DNS_DNS_TEST_UTIL_H_
 #pragma once
 
+#include <string>
+
 #include "base/basictypes.h"
 #include "base/memory/scoped_ptr.h"
 #include "net/dns/dns_config_service.h"
@@ -162,6 +164,11 @@ class DnsClient;
 // Creates mock DnsClient for testing HostResolverImpl.
 scoped_ptr<DnsClient> CreateMockDnsClient(const DnsConfig& config);
 
+class DnsQuery;
+// Returns an NXDOMAIN response to |query| with an SOA record in the authority
+// section that gives it a negative TTL of |negative_ttl| seconds.
+std::string CreateNXDomainResponse(const DnsQuery& query, uint32 negative_ttl);
+
 class MockDnsConfigService : public DnsConfigService {
  public:
   virtual ~MockDnsConfigService() {}
@@ -94,11 +94,13 @@ class ResponseParameters : public NetLog::EventParameters {
 class DnsUDPAttempt {
  public:
   DnsUDPAttempt(scoped_ptr<DatagramClientSocket> socket,
+                int server_index,
                 const IPEndPoint& server,
                 scoped_ptr<DnsQuery> query,
                 const CompletionCallback& callback)
       : next_state_(STATE_NONE),
         socket_(socket.Pass()),
+        server_index_(server_index),
         server_(server),
         query_(query.Pass()),
         callback_(callback) {
@@ -108,10 +110,20 @@ class DnsUDPAttempt {
   // and calls |callback| upon completion.
   int Start() {
     DCHECK_EQ(STATE_NONE, next_state_);
+    start_time_ = base::TimeTicks::Now();
     next_state_ = STATE_CONNECT;
     return DoLoop(OK);
   }
 
+  // Index of the server in DnsConfig::nameservers.
+  int server_index() const {
+    return server_index_;
+  }
+
+  base::TimeTicks start_time() const {
+    return start_time_;
+  }
+
   const DnsQuery* query() const {
     return query_.get();
   }
@@ -237,8 +249,10 @@ class DnsUDPAttempt {
   State next_state_;
 
   scoped_ptr<DatagramClientSocket> socket_;
+  int server_index_;
   IPEndPoint server_;
   scoped_ptr<DnsQuery> query_;
+  base::TimeTicks start_time_;
 
   scoped_ptr<DnsResponse> response_;
 
@@ -251,7 +265,10 @@ class DnsUDPAttempt {
 
 // Implements DnsTransaction. Configuration is supplied by DnsSession.
 // The suffix list is built according to the DnsConfig from the session.
-// The timeout for each DnsUDPAttempt is given by DnsSession::NextTimeout.
+// Each name is first looked up in the response cache of the session.
+// The timeout for each DnsUDPAttempt is given by DnsSession::NextTimeout,
+// but earlier attempts can still be answered until DnsSession::QueryTimeout
+// runs out.
 // The first server to attempt on each query is given by
 // DnsSession::NextFirstServerIndex, and the order is round-robin afterwards.
 // Each server is attempted DnsConfig::attempts times.
@@ -310,7 +327,7 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
           base::Bind(&DnsTransactionImpl::DoCallback,
                      base::Unretained(this),
                      OK,
-                     attempts_.back()));
+                     GetLastResponse()));
       return ERR_IO_PENDING;
     }
     if (rv != ERR_IO_PENDING) {
@@ -370,18 +387,24 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
     return qnames_.empty() ? ERR_NAME_NOT_RESOLVED : OK;
   }
 
-  void DoCallback(int rv, const DnsUDPAttempt* successful_attempt) {
+  void DoCallback(int rv, const DnsResponse* response) {
     if (callback_.is_null())
       return;
     DCHECK_NE(ERR_IO_PENDING, rv);
-    DCHECK(rv != OK || successful_attempt != NULL);
+    DCHECK(rv != OK || response != NULL);
 
     DnsTransactionFactory::CallbackType callback = callback_;
     callback_.Reset();
     net_log_.EndEventWithNetErrorCode(NetLog::TYPE_DNS_TRANSACTION, rv);
-    callback.Run(this,
-                 rv,
-                 successful_attempt ? successful_attempt->response() : NULL);
+    callback.Run(this, rv, rv == OK ? response : NULL);
+  }
+
+  // Returns the response which completed the current query synchronously:
+  // the cached one, or the one received by the last attempt.
+  const DnsResponse* GetLastResponse() const {
+    if (cached_response_.get())
+      return cached_response_.get();
+    return attempts_.empty() ? NULL : attempts_.back()->response();
   }
 
   // Makes another attempt at the current name, |qnames_.front()|, using the
@@ -418,34 +441,62 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
 
     const DnsConfig& config = session_->config();
 
-    unsigned server_index = first_server_index_ +
-        (attempt_number % config.nameservers.size());
+    unsigned server_index = (first_server_index_ + attempt_number) %
+        config.nameservers.size();
 
     DnsUDPAttempt* attempt = new DnsUDPAttempt(
         socket.Pass(),
+        server_index,
         config.nameservers[server_index],
         query.Pass(),
         base::Bind(&DnsTransactionImpl::OnAttemptComplete,
                    base::Unretained(this),
                    attempt_number));
 
-    base::TimeDelta timeout = session_->NextTimeout(attempt_number);
+    base::TimeDelta timeout = session_->NextTimeout(server_index,
+                                                    attempt_number);
     timer_.Start(FROM_HERE, timeout, this, &DnsTransactionImpl::OnTimeout);
     attempts_.push_back(attempt);
     return attempt->Start();
   }
 
-  // Begins query for the current name. Makes the first attempt.
+  // Begins query for the current name. Answers it from the cache of the
+  // session if possible, moving on to the next name on a cached NXDOMAIN.
+  // Otherwise makes the first attempt.
   int StartQuery() {
-    std::string dotted_qname = DNSDomainToString(qnames_.front());
-    net_log_.BeginEvent(
-        NetLog::TYPE_DNS_TRANSACTION_QUERY,
-        make_scoped_refptr(new NetLogStringParameter("qname", dotted_qname)));
-
-    first_server_index_ = session_->NextFirstServerIndex();
+    for (;;) {
+      std::string dotted_qname = DNSDomainToString(qnames_.front());
+      net_log_.BeginEvent(
+          NetLog::TYPE_DNS_TRANSACTION_QUERY,
+          make_scoped_refptr(new NetLogStringParameter("qname",
+                                                       dotted_qname)));
+
+      STLDeleteElements(&attempts_);
+      cached_response_ = session_->GetCachedResponse(qnames_.front(), qtype_,
+                                                     base::TimeTicks::Now());
+      if (!cached_response_.get()) {
+        first_server_index_ = session_->NextFirstServerIndex();
+        query_deadline_ = base::TimeTicks::Now() + session_->QueryTimeout();
+        return MakeAttempt();
+      }
 
-    STLDeleteElements(&attempts_);
-    return MakeAttempt();
+      net_log_.AddEvent(
+          NetLog::TYPE_DNS_TRANSACTION_RESPONSE,
+          make_scoped_refptr(
+              new ResponseParameters(cached_response_->rcode(),
+                                     cached_response_->answer_count(),
+                                     NetLog::Source())));
+      if (cached_response_->rcode() != dns_protocol::kRcodeNXDOMAIN) {
+        net_log_.EndEventWithNetErrorCode(NetLog::TYPE_DNS_TRANSACTION_QUERY,
+                                          OK);
+        return OK;
+      }
+      net_log_.EndEventWithNetErrorCode(NetLog::TYPE_DNS_TRANSACTION_QUERY,
+                                        ERR_NAME_NOT_RESOLVED);
+      qnames_.pop_front();
+      if (qnames_.empty())
+        return ERR_NAME_NOT_RESOLVED;
+    }
   }
 
   void OnAttemptComplete(unsigned attempt_number, int rv) {
@@ -455,6 +506,11 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
     const DnsUDPAttempt* attempt = attempts_[attempt_number];
 
     if (attempt->response()) {
+      base::TimeTicks now = base::TimeTicks::Now();
+      session_->RecordRTT(attempt->server_index(),
+                          now - attempt->start_time());
+      if (rv == OK || rv == ERR_NAME_NOT_RESOLVED)
+        session_->CacheResponse(*attempt->response(), now);
       net_log_.AddEvent(
           NetLog::TYPE_DNS_TRANSACTION_RESPONSE,
           make_scoped_refptr(
@@ -475,7 +531,7 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
           rv = StartQuery();
         break;
       case OK:
-        DoCallback(rv, attempt);
+        DoCallback(rv, attempt->response());
         return;
       default:
         // Some nameservers could fail so try the next one.
@@ -489,13 +545,22 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
         break;
     }
     if (rv != ERR_IO_PENDING)
-      DoCallback(rv, NULL);
+      DoCallback(rv, GetLastResponse());
   }
 
   void OnTimeout() {
+    session_->RecordLostPacket(attempts_.back()->server_index());
     const DnsConfig& config = session_->config();
     if (attempts_.size() == config.attempts * config.nameservers.size()) {
-      DoCallback(ERR_DNS_TIMED_OUT, NULL);
+      // The RTT estimates may have run through the attempts early, so wait
+      // for late responses until the configured timeout.
+      base::TimeDelta remaining = query_deadline_ - base::TimeTicks::Now();
+      if (remaining > base::TimeDelta()) {
+        timer_.Start(FROM_HERE, remaining, this,
+                     &DnsTransactionImpl::OnQueryTimeout);
+        return;
+      }
+      OnQueryTimeout();
       return;
     }
     int rv = MakeAttempt();
@@ -503,6 +568,10 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
       DoCallback(rv, NULL);
   }
 
+  void OnQueryTimeout() {
+    DoCallback(ERR_DNS_TIMED_OUT, NULL);
+  }
+
   scoped_refptr<DnsSession> session_;
   std::string hostname_;
   uint16 qtype_;
@@ -517,9 +586,15 @@ class DnsTransactionImpl : public DnsTransaction, public base::NonThreadSafe {
   // List of attempts for the current name.
   std::vector<DnsUDPAttempt*> attempts_;
 
+  // Response to the current name found in the cache of the session.
+  scoped_ptr<DnsResponse> cached_response_;
+
   // Index of the first server to try on each search query.
   int first_server_index_;
 
+  // When the current name times out, however fast its attempts were made.
+  base::TimeTicks query_deadline_;
+
   base::OneShotTimer<DnsTransactionImpl> timer_;
 
   DISALLOW_COPY_AND_ASSIGN(DnsTransactionImpl);
@@ -7,10 +7,13 @@
 #include "base/bind.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
 #include "base/rand_util.h"
 #include "base/test/test_timeouts.h"
 #include "net/base/big_endian.h"
 #include "net/base/dns_util.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
 #include "net/base/net_log.h"
 #include "net/base/sys_addrinfo.h"
 #include "net/dns/dns_protocol.h"
@@ -18,7 +21,9 @@
 #include "net/dns/dns_response.h"
 #include "net/dns/dns_session.h"
 #include "net/dns/dns_test_util.h"
+#include "net/socket/client_socket_factory.h"
 #include "net/socket/socket_test_util.h"
+#include "net/udp/udp_server_socket.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -553,6 +558,37 @@ TEST_F(DnsTransactionTest, ServerFallbackAndRotate) {
   CheckServerOrder(kOrder, arraysize(kOrder));
 }
 
+TEST_F(DnsTransactionTest, ServerFallbackPrefersRespondingServer) {
+  ConfigureNumServers(2);
+  // Use short timeout to speed up the test.
+  config_.timeout = base::TimeDelta::FromMilliseconds(
+      TestTimeouts::tiny_timeout_ms());
+  ConfigureFactory();
+
+  // Responses for first request.
+  AddTimeout(kT0HostName, kT0Qtype);
+  AddRcode(kT0HostName, kT0Qtype, dns_protocol::kRcodeNXDOMAIN);
+  // Response for second request.
+  AddRcode(kT1HostName, kT1Qtype, dns_protocol::kRcodeNXDOMAIN);
+  PrepareSockets();
+
+  TransactionHelper helper0(kT0HostName,
+                            kT0Qtype,
+                            ERR_NAME_NOT_RESOLVED);
+  TransactionHelper helper1(kT1HostName,
+                            kT1Qtype,
+                            ERR_NAME_NOT_RESOLVED);
+
+  EXPECT_TRUE(helper0.RunUntilDone(transaction_factory_.get()));
+  EXPECT_TRUE(helper1.Run(transaction_factory_.get()));
+
+  unsigned kOrder[] = {
+      0, 1,    // The first transaction.
+      1,       // The second transaction avoids the server that timed out.
+  };
+  CheckServerOrder(kOrder, arraysize(kOrder));
+}
+
 TEST_F(DnsTransactionTest, SuffixSearchAboveNdots) {
   config_.ndots = 2;
   config_.search.push_back("a");
@@ -712,6 +748,206 @@ TEST_F(DnsTransactionTest, SuffixSearchStop) {
   EXPECT_TRUE(helper0.Run(transaction_factory_.get()));
 }
 
+// A stand-in DNS server on a local UDP socket. Answers A queries for
+// kT0HostName with kT0ResponseDatagram, and all other queries with NXDOMAIN.
+class TestDnsServer {
+ public:
+  static const uint32 kNegativeTTL = 60;
+
+  TestDnsServer()
+      : socket_(NULL, NetLog::Source()),
+        read_buffer_(new IOBufferWithSize(dns_protocol::kMaxUDPSize)),
+        num_queries_(0) {
+  }
+
+  bool Start() {
+    IPAddressNumber localhost;
+    if (!ParseIPLiteralToNumber("127.0.0.1", &localhost))
+      return false;
+    if (socket_.Listen(IPEndPoint(localhost, 0)) != OK)
+      return false;
+    if (socket_.GetLocalAddress(&address_) != OK)
+      return false;
+    Read();
+    return true;
+  }
+
+  const IPEndPoint& address() const {
+    return address_;
+  }
+
+  int num_queries() const {
+    return num_queries_;
+  }
+
+  // Holds each response back for |delay|.
+  void set_response_delay(base::TimeDelta delay) {
+    response_delay_ = delay;
+  }
+
+ private:
+  void Read() {
+    for (;;) {
+      int rv = socket_.RecvFrom(read_buffer_, read_buffer_->size(), &client_,
+                                base::Bind(&TestDnsServer::OnRead,
+                                           base::Unretained(this)));
+      if (rv == ERR_IO_PENDING)
+        return;
+      HandleQuery(rv);
+    }
+  }
+
+  void OnRead(int rv) {
+    HandleQuery(rv);
+    Read();
+  }
+
+  void HandleQuery(int rv) {
+    const size_t kHeaderSize = sizeof(dns_protocol::Header);
+    ASSERT_GT(rv, static_cast<int>(kHeaderSize + 2 * sizeof(uint16)));
+    ++num_queries_;
+
+    // The query has a single question, QNAME followed by QTYPE and QCLASS.
+    const char* data = read_buffer_->data();
+    uint16 id;
+    ReadBigEndian<uint16>(data, &id);
+    base::StringPiece qname(data + kHeaderSize,
+                            rv - kHeaderSize - 2 * sizeof(uint16));
+    uint16 qtype;
+    ReadBigEndian<uint16>(qname.data() + qname.size(), &qtype);
+
+    std::string response;
+    if (qname == base::StringPiece(kT0DnsName, arraysize(kT0DnsName)) &&
+        qtype == kT0Qtype) {
+      response.assign(reinterpret_cast<const char*>(kT0ResponseDatagram),
+                      arraysize(kT0ResponseDatagram));
+      WriteBigEndian<uint16>(&response[0], id);
+    } else {
+      DnsQuery query(id, qname, qtype);
+      response = CreateNXDomainResponse(query, kNegativeTTL);
+    }
+
+    scoped_refptr<IOBufferWithSize> buffer(
+        new IOBufferWithSize(response.size()));
+    memcpy(buffer->data(), response.data(), response.size());
+    MessageLoop::current()->PostDelayedTask(
+        FROM_HERE,
+        base::Bind(&TestDnsServer::SendResponse, base::Unretained(this),
+                   buffer, client_),
+        response_delay_);
+  }
+
+  void SendResponse(scoped_refptr<IOBufferWithSize> buffer,
+                    const IPEndPoint& client) {
+    socket_.SendTo(buffer, buffer->size(), client,
+                   base::Bind(&TestDnsServer::OnWrite,
+                              base::Unretained(this)));
+  }
+
+  void OnWrite(int rv) {
+  }
+
+  UDPServerSocket socket_;
+  IPEndPoint address_;
+  scoped_refptr<IOBufferWithSize> read_buffer_;
+  IPEndPoint client_;
+  int num_queries_;
+  base::TimeDelta response_delay_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestDnsServer);
+};
+
+// Runs transactions over real sockets against TestDnsServer and checks that
+// the session caches their responses.
+TEST(DnsTransactionLocalServerTest, CachedResponses) {
+  TestDnsServer server;
+  ASSERT_TRUE(server.Start());
+
+  DnsConfig config;
+  config.nameservers.push_back(server.address());
+  config.attempts = 1;
+  config.timeout = TestTimeouts::action_timeout();
+  config.search.push_back("test");
+  scoped_refptr<DnsSession> session(new DnsSession(
+      config,
+      ClientSocketFactory::GetDefaultFactory(),
+      base::Bind(&base::RandInt),
+      NULL /* NetLog */));
+  scoped_ptr<DnsTransactionFactory> factory =
+      DnsTransactionFactory::CreateFactory(session.get());
+
+  TransactionHelper helper0(kT0HostName,
+                            kT0Qtype,
+                            arraysize(kT0IpAddresses) + 1);
+  EXPECT_TRUE(helper0.RunUntilDone(factory.get()));
+  EXPECT_EQ(1, server.num_queries());
+
+  // The server has responded, so the timeout follows its RTT now.
+  EXPECT_LT(session->NextTimeout(0, 0), config.timeout);
+
+  // Answered from the cache.
+  TransactionHelper helper1(kT0HostName,
+                            kT0Qtype,
+                            arraysize(kT0IpAddresses) + 1);
+  EXPECT_TRUE(helper1.RunUntilDone(factory.get()));
+  EXPECT_EQ(1, server.num_queries());
+
+  // The single-label name is only queried with the search suffix, "x.test".
+  TransactionHelper helper2("x", dns_protocol::kTypeAAAA,
+                            ERR_NAME_NOT_RESOLVED);
+  EXPECT_TRUE(helper2.RunUntilDone(factory.get()));
+  EXPECT_EQ(2, server.num_queries());
+
+  // The NXDOMAIN response is cached, so the transaction fails right away.
+  TransactionHelper helper3("x.test.", dns_protocol::kTypeAAAA,
+                            ERR_NAME_NOT_RESOLVED);
+  helper3.StartTransaction(factory.get());
+  EXPECT_TRUE(helper3.has_completed());
+  EXPECT_EQ(2, server.num_queries());
+
+  // Negative responses are per name and type.
+  TransactionHelper helper4("x.test.", dns_protocol::kTypeA,
+                            ERR_NAME_NOT_RESOLVED);
+  EXPECT_TRUE(helper4.RunUntilDone(factory.get()));
+  EXPECT_EQ(3, server.num_queries());
+}
+
+// Checks that a response slower than the RTT estimate of the server is still
+// accepted within the configured timeout.
+TEST(DnsTransactionLocalServerTest, SlowResponseAfterFastOnes) {
+  TestDnsServer server;
+  ASSERT_TRUE(server.Start());
+
+  DnsConfig config;
+  config.nameservers.push_back(server.address());
+  config.attempts = 1;
+  config.timeout = TestTimeouts::action_timeout();
+  scoped_refptr<DnsSession> session(new DnsSession(
+      config,
+      ClientSocketFactory::GetDefaultFactory(),
+      base::Bind(&base::RandInt),
+      NULL /* NetLog */));
+  scoped_ptr<DnsTransactionFactory> factory =
+      DnsTransactionFactory::CreateFactory(session.get());
+
+  const char* const kFastNames[] = { "a.", "b.", "c." };
+  for (size_t i = 0; i < arraysize(kFastNames); ++i) {
+    TransactionHelper helper(kFastNames[i], dns_protocol::kTypeA,
+                             ERR_NAME_NOT_RESOLVED);
+    EXPECT_TRUE(helper.RunUntilDone(factory.get()));
+  }
+  const base::TimeDelta kDelay = base::TimeDelta::FromMilliseconds(400);
+  ASSERT_LT(session->NextTimeout(0, 0), kDelay);
+
+  server.set_response_delay(kDelay);
+  TransactionHelper helper(kT0HostName,
+                           kT0Qtype,
+                           arraysize(kT0IpAddresses) + 1);
+  EXPECT_TRUE(helper.RunUntilDone(factory.get()));
+  EXPECT_EQ(static_cast<int>(arraysize(kFastNames)) + 1,
+            server.num_queries());
+}
+
 }  // namespace
 
 }  // namespace net
@@ -42,6 +42,10 @@ namespace net {
 
 namespace {
 
+// The size of the reads done to store the body of a response that is
+// revalidated in the background.
+const int kMaxBodyReadSize = 32 * 1024;
+
 HttpNetworkSession* CreateNetworkSession(
     HostResolver* host_resolver,
     CertVerifier* cert_verifier,
@@ -104,7 +108,10 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      streaming(false),
+      stream_truncated(false),
+      streamed_size(0) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -277,6 +284,90 @@ void HttpCache::MetadataWriter::OnIOComplete(int result) {
 
 //-----------------------------------------------------------------------------
 
+// This class revalidates a cached response in the background. It issues the
+// request with LOAD_VALIDATE_CACHE and, if the server sends a new response,
+// reads the body so that it gets stored. The entry stays available to other
+// transactions while the request is on the network.
+class HttpCache::AsyncValidation {
+ public:
+  AsyncValidation(HttpCache* cache, const std::string& key,
+                  const HttpRequestInfo& request);
+  ~AsyncValidation() {}
+
+  const std::string& key() const { return key_; }
+
+  void Start();
+
+ private:
+  void OnStartComplete(int result);
+  void ReadBody();
+  void OnReadComplete(int result);
+  void Done();
+
+  HttpCache* cache_;
+  std::string key_;
+  HttpRequestInfo request_;
+  scoped_ptr<HttpCache::Transaction> transaction_;
+  scoped_refptr<IOBuffer> buf_;
+  DISALLOW_COPY_AND_ASSIGN(AsyncValidation);
+};
+
+HttpCache::AsyncValidation::AsyncValidation(HttpCache* cache,
+                                            const std::string& key,
+                                            const HttpRequestInfo& request)
+    : cache_(cache),
+      key_(key),
+      request_(request) {
+  request_.load_flags |= LOAD_VALIDATE_CACHE;
+  request_.load_flags &= ~LOAD_PREFERRING_CACHE;
+  request_.priority = IDLE;
+}
+
+void HttpCache::AsyncValidation::Start() {
+  transaction_.reset(new HttpCache::Transaction(cache_));
+  transaction_->set_validating_in_background();
+  int rv = transaction_->Start(
+      &request_,
+      base::Bind(&AsyncValidation::OnStartComplete, base::Unretained(this)),
+      BoundNetLog());
+  if (rv != ERR_IO_PENDING)
+    OnStartComplete(rv);
+}
+
+void HttpCache::AsyncValidation::OnStartComplete(int result) {
+  // There is nothing to store if the cached response is still valid.
+  if (result != OK || transaction_->GetResponseInfo()->was_cached)
+    return Done();
+
+  buf_ = new IOBuffer(kMaxBodyReadSize);
+  ReadBody();
+}
+
+void HttpCache::AsyncValidation::ReadBody() {
+  for (;;) {
+    int rv = transaction_->Read(
+        buf_, kMaxBodyReadSize,
+        base::Bind(&AsyncValidation::OnReadComplete, base::Unretained(this)));
+    if (rv == ERR_IO_PENDING)
+      return;
+    if (rv <= 0)
+      return Done();
+  }
+}
+
+void HttpCache::AsyncValidation::OnReadComplete(int result) {
+  if (result <= 0)
+    return Done();
+  ReadBody();
+}
+
+void HttpCache::AsyncValidation::Done() {
+  // This deletes us.
+  cache_->OnAsyncValidationComplete(this);
+}
+
+//-----------------------------------------------------------------------------
+
 class HttpCache::SSLHostInfoFactoryAdaptor : public SSLHostInfoFactory {
  public:
   SSLHostInfoFactoryAdaptor(CertVerifier* cert_verifier, HttpCache* http_cache)
@@ -329,7 +420,8 @@ HttpCache::HttpCache(HostResolver* host_resolver,
                   http_auth_handler_factory,
                   network_delegate,
                   http_server_properties,
-                  net_log))) {
+                  net_log))),
+      use_stale_while_revalidate_(false) {
 }
 
 
@@ -342,7 +434,8 @@ HttpCache::HttpCache(HttpNetworkSession* session,
       ssl_host_info_factory_(new SSLHostInfoFactoryAdaptor(
           session->cert_verifier(),
           ALLOW_THIS_IN_INITIALIZER_LIST(this))),
-      network_layer_(new HttpNetworkLayer(session)) {
+      network_layer_(new HttpNetworkLayer(session)),
+      use_stale_while_revalidate_(false) {
 }
 
 HttpCache::HttpCache(HttpTransactionFactory* network_layer,
@@ -352,10 +445,14 @@ HttpCache::HttpCache(HttpTransactionFactory* network_layer,
       backend_factory_(backend_factory),
       building_backend_(false),
       mode_(NORMAL),
-      network_layer_(network_layer) {
+      network_layer_(network_layer),
+      use_stale_while_revalidate_(false) {
 }
 
 HttpCache::~HttpCache() {
+  // The background revalidations go away with their transactions.
+  STLDeleteValues(&async_validations_);
+
   // If we have any active entries remaining, then we need to deactivate them.
   // We may have some pending calls to OnProcessPendingQueue, but since those
   // won't run (due to our destruction), we can simply ignore the corresponding
@@ -365,6 +462,7 @@ HttpCache::~HttpCache() {
     entry->will_process_pending_queue = false;
     entry->pending_queue.clear();
     entry->readers.clear();
+    entry->waiting_readers.clear();
     entry->writer = NULL;
     DeactivateEntry(entry);
   }
@@ -806,12 +904,21 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
 
   // We implement a basic reader/writer lock for the disk cache entry.  If
   // there is already a writer, then everyone has to wait for the writer to
-  // finish before they can access the cache entry.  There can be multiple
-  // readers.
+  // finish before they can access the cache entry, unless the writer is
+  // already storing the response body (see StartStreaming).  There can be
+  // multiple readers.
   //
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
 
+  if (entry->streaming && entry->pending_queue.empty() &&
+      trans->CanFollowWriter()) {
+    DCHECK(entry->writer);
+    trans->FollowWriter();
+    entry->readers.push_back(trans);
+    return OK;
+  }
+
   if (entry->writer || entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
     return ERR_IO_PENDING;
@@ -846,8 +953,9 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
   if (entry->will_process_pending_queue && entry->readers.empty())
     return;
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
+  if (entry->writer == trans) {
+    // The readers following the writer will not get the rest of the body.
+    StopStreaming(entry, false);
 
     // Assume there was a failure.
     bool success = false;
@@ -864,7 +972,8 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 }
 
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
-  DCHECK(entry->readers.empty());
+  StopStreaming(entry, success);
+  DCHECK(entry->readers.empty() || entry->stream_truncated || success);
 
   entry->writer = NULL;
 
@@ -877,8 +986,15 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty()) {
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else if (!entry->doomed) {
+      // The readers that were following the writer keep the entry alive
+      // until they notice the failure.
+      int rv = DoomEntry(entry->disk_entry->GetKey(), NULL);
+      DCHECK_EQ(OK, rv);
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -891,15 +1007,16 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
-
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
   DCHECK(it != entry->readers.end());
 
   entry->readers.erase(it);
+  entry->waiting_readers.remove(trans);
 
-  ProcessPendingQueue(entry);
+  // The pending transactions are waiting for the writer, if any.
+  if (!entry->writer)
+    ProcessPendingQueue(entry);
 }
 
 void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
@@ -915,6 +1032,97 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::StartStreaming(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  DCHECK(!entry->streaming);
+  DCHECK(entry->readers.empty());
+
+  entry->streaming = true;
+  entry->stream_truncated = false;
+  entry->streamed_size = 0;
+
+  // Let the pending readers in, in order. Anyone else keeps waiting for the
+  // writer to finish.
+  while (!entry->pending_queue.empty() &&
+         entry->pending_queue.front()->CanFollowWriter()) {
+    Transaction* next = entry->pending_queue.front();
+    entry->pending_queue.pop_front();
+    next->FollowWriter();
+    entry->readers.push_back(next);
+    MessageLoop::current()->PostTask(FROM_HERE,
+                                     base::Bind(next->io_callback(), OK));
+  }
+}
+
+void HttpCache::OnStreamDataStored(ActiveEntry* entry, int size) {
+  if (!entry->streaming)
+    return;
+
+  DCHECK_GE(size, entry->streamed_size);
+  entry->streamed_size = size;
+  NotifyWaitingReaders(entry);
+}
+
+void HttpCache::StopStreaming(ActiveEntry* entry, bool complete) {
+  if (!entry->streaming)
+    return;
+
+  entry->streaming = false;
+  entry->stream_truncated = !complete;
+  NotifyWaitingReaders(entry);
+}
+
+void HttpCache::WaitForStreamData(ActiveEntry* entry, Transaction* trans) {
+  DCHECK(entry->streaming);
+  DCHECK(std::find(entry->waiting_readers.begin(),
+                   entry->waiting_readers.end(), trans) ==
+         entry->waiting_readers.end());
+  entry->waiting_readers.push_back(trans);
+}
+
+void HttpCache::NotifyWaitingReaders(ActiveEntry* entry) {
+  // The readers are notified asynchronously, because the writer is in the
+  // middle of its own IO. The IO callback of a transaction goes away with the
+  // transaction, so there is nothing to cancel if a reader is destroyed
+  // before the notification runs.
+  TransactionList waiting_readers;
+  waiting_readers.swap(entry->waiting_readers);
+  for (TransactionList::iterator it = waiting_readers.begin();
+       it != waiting_readers.end(); ++it) {
+    MessageLoop::current()->PostTask(FROM_HERE,
+                                     base::Bind((*it)->io_callback(), OK));
+  }
+}
+
+void HttpCache::RevalidateInBackground(const std::string& key,
+                                       const HttpRequestInfo& request) {
+  // Concurrent requests for a stale response share a single revalidation.
+  if (async_validations_.find(key) != async_validations_.end())
+    return;
+
+  async_validations_[key] = new AsyncValidation(this, key, request);
+
+  // The revalidation has to wait for the current user of the entry anyway,
+  // so there is no point in starting it right away.
+  MessageLoop::current()->PostTask(
+      FROM_HERE,
+      base::Bind(&HttpCache::StartAsyncValidation, AsWeakPtr(), key));
+}
+
+void HttpCache::StartAsyncValidation(const std::string& key) {
+  AsyncValidationMap::iterator it = async_validations_.find(key);
+  DCHECK(it != async_validations_.end());
+  it->second->Start();
+}
+
+void HttpCache::OnAsyncValidationComplete(AsyncValidation* validation) {
+  AsyncValidationMap::iterator it = async_validations_.find(validation->key());
+  DCHECK(it != async_validations_.end());
+  DCHECK_EQ(validation, it->second);
+  async_validations_.erase(it);
+  delete validation;
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
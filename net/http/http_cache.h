@@ -178,6 +178,15 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   void set_mode(Mode value) { mode_ = value; }
   Mode mode() { return mode_; }
 
+  // When enabled, a stale response that allows it via stale-while-revalidate
+  // is served right away, and it is revalidated in the background.
+  void set_use_stale_while_revalidate(bool value) {
+    use_stale_while_revalidate_ = value;
+  }
+  bool use_stale_while_revalidate() const {
+    return use_stale_while_revalidate_;
+  }
+
   // Close currently active sockets so that fresh page loads will not use any
   // recycled connections.  For sockets currently in use, they may not close
   // immediately, but they will not be reusable. This is for debugging.
@@ -210,6 +219,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
  private:
   // Types --------------------------------------------------------------------
 
+  class AsyncValidation;
   class MetadataWriter;
   class SSLHostInfoFactoryAdaptor;
   class Transaction;
@@ -230,12 +240,24 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+
+    // While |streaming| is true, |writer| is storing the body of a response
+    // that |readers| may follow as it lands on the entry. Only the first
+    // |streamed_size| bytes of the body are known to be stored, and the
+    // readers that caught up with |writer| wait in |waiting_readers|.
+    // |stream_truncated| is set if |writer| gives up before storing the
+    // whole body.
+    bool               streaming;
+    bool               stream_truncated;
+    int                streamed_size;
+    TransactionList    waiting_readers;
   };
 
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
   typedef base::hash_map<std::string, PendingOp*> PendingOpsMap;
   typedef std::set<ActiveEntry*> ActiveEntriesSet;
   typedef base::hash_map<std::string, int> PlaybackCacheMap;
+  typedef base::hash_map<std::string, AsyncValidation*> AsyncValidationMap;
 
   // Methods ------------------------------------------------------------------
 
@@ -329,6 +351,40 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| once it has stored the response headers
+  // and is about to store the body. Pending transactions that only need to
+  // read the response are added to the entry right away, and they follow the
+  // writer as the body is stored.
+  void StartStreaming(ActiveEntry* entry);
+
+  // Called by the writer of |entry| when the first |size| bytes of the body
+  // are stored.
+  void OnStreamDataStored(ActiveEntry* entry, int size);
+
+  // Called when the writer of |entry| stops storing the body. |complete| is
+  // false if the body stored so far is not the whole response.
+  void StopStreaming(ActiveEntry* entry, bool complete);
+
+  // Makes |trans| wait until the writer of |entry| stores more data (or stops
+  // storing data). |trans| will be notified via its IO callback.
+  void WaitForStreamData(ActiveEntry* entry, Transaction* trans);
+
+  // Wakes up the transactions waiting for more data from the writer of
+  // |entry|.
+  void NotifyWaitingReaders(ActiveEntry* entry);
+
+  // Revalidates the response stored under |key| in the background, by
+  // issuing |request| again. Does nothing if |key| is already being
+  // revalidated.
+  void RevalidateInBackground(const std::string& key,
+                              const HttpRequestInfo& request);
+
+  // Starts the background revalidation of |key|, if it is still needed.
+  void StartAsyncValidation(const std::string& key);
+
+  // Called by |validation| when it is done.
+  void OnAsyncValidationComplete(AsyncValidation* validation);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -395,6 +451,11 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
 
   scoped_ptr<PlaybackCacheMap> playback_cache_map_;
 
+  bool use_stale_while_revalidate_;
+
+  // The background revalidations in progress, indexed by cache key.
+  AsyncValidationMap async_validations_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpCache);
 };
 
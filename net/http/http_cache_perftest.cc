@@ -0,0 +1,157 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/time.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/http/http_transaction.h"
+#include "net/http/http_transaction_unittest.h"
+#include "net/http/mock_http_cache.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kNumRequests = 100;
+const int kBodySize = 4 * 1024 * 1024;
+const int kReadSize = 32 * 1024;
+
+// Drives one transaction to completion, keeping track of when the first
+// byte of the body arrives.
+class Consumer {
+ public:
+  explicit Consumer(int* num_pending)
+      : num_pending_(num_pending),
+        buf_(new net::IOBuffer(kReadSize)),
+        bytes_read_(0),
+        error_(net::OK) {
+  }
+
+  void Start(net::HttpCache* cache, const MockHttpRequest* request) {
+    start_time_ = base::TimeTicks::Now();
+    error_ = cache->CreateTransaction(&trans_);
+    if (error_ != net::OK) {
+      Done();
+      return;
+    }
+    int rv = trans_->Start(request,
+                           base::Bind(&Consumer::OnStartComplete,
+                                      base::Unretained(this)),
+                           net::BoundNetLog());
+    if (rv != net::ERR_IO_PENDING)
+      OnStartComplete(rv);
+  }
+
+  int bytes_read() const { return bytes_read_; }
+  int error() const { return error_; }
+  base::TimeDelta time_to_first_byte() const {
+    return first_byte_time_ - start_time_;
+  }
+
+ private:
+  void OnStartComplete(int result) {
+    if (result != net::OK) {
+      error_ = result;
+      Done();
+      return;
+    }
+    Read();
+  }
+
+  void Read() {
+    for (;;) {
+      int rv = trans_->Read(buf_, kReadSize,
+                            base::Bind(&Consumer::OnReadComplete,
+                                       base::Unretained(this)));
+      if (rv == net::ERR_IO_PENDING)
+        return;
+      if (!HandleReadResult(rv))
+        return;
+    }
+  }
+
+  void OnReadComplete(int result) {
+    if (HandleReadResult(result))
+      Read();
+  }
+
+  // Returns true if there is more data to read.
+  bool HandleReadResult(int result) {
+    if (result <= 0) {
+      error_ = result;
+      Done();
+      return false;
+    }
+    if (!bytes_read_)
+      first_byte_time_ = base::TimeTicks::Now();
+    bytes_read_ += result;
+    return true;
+  }
+
+  void Done() {
+    trans_.reset();
+    if (!--*num_pending_)
+      MessageLoop::current()->Quit();
+  }
+
+  int* num_pending_;
+  scoped_ptr<net::HttpTransaction> trans_;
+  scoped_refptr<net::IOBuffer> buf_;
+  int bytes_read_;
+  int error_;
+  base::TimeTicks start_time_;
+  base::TimeTicks first_byte_time_;
+};
+
+}  // namespace
+
+// Issues many concurrent requests for the same large response. Only one of
+// them goes to the network; the rest are served from the cache entry that is
+// being written.
+TEST(HttpCachePerfTest, ConcurrentRequestsForLargeResponse) {
+  MessageLoopForIO message_loop;
+  MockHttpCache cache;
+
+  const std::string body(kBodySize, 'a');
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.data = body.c_str();
+  MockHttpRequest request(transaction);
+
+  int num_pending = kNumRequests;
+  ScopedVector<Consumer> consumers;
+  for (int i = 0; i < kNumRequests; ++i)
+    consumers.push_back(new Consumer(&num_pending));
+
+  PerfTimeLogger timer("HttpCache_ConcurrentRequests_Total");
+  for (int i = 0; i < kNumRequests; ++i)
+    consumers[i]->Start(cache.http_cache(), &request);
+  MessageLoop::current()->Run();
+  timer.Done();
+
+  base::TimeDelta total_first_byte;
+  base::TimeDelta max_first_byte;
+  for (int i = 0; i < kNumRequests; ++i) {
+    EXPECT_EQ(net::OK, consumers[i]->error());
+    EXPECT_EQ(kBodySize, consumers[i]->bytes_read());
+    base::TimeDelta first_byte = consumers[i]->time_to_first_byte();
+    total_first_byte += first_byte;
+    if (first_byte > max_first_byte)
+      max_first_byte = first_byte;
+  }
+  LogPerfResult("HttpCache_ConcurrentRequests_AvgFirstByte",
+                total_first_byte.InMillisecondsF() / kNumRequests, "ms");
+  LogPerfResult("HttpCache_ConcurrentRequests_MaxFirstByte",
+                max_first_byte.InMillisecondsF(), "ms");
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
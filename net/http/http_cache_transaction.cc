@@ -10,6 +10,7 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <string>
 
 #include "base/bind.h"
@@ -118,6 +119,10 @@ HttpCache::Transaction::Transaction(HttpCache* cache)
       handling_206_(false),
       cache_pending_(false),
       done_reading_(false),
+      following_writer_(false),
+      must_wait_for_writer_(false),
+      validating_in_background_(false),
+      released_entry_(false),
       read_offset_(0),
       effective_load_flags_(0),
       write_len_(0),
@@ -199,6 +204,19 @@ bool HttpCache::Transaction::AddTruncatedFlag() {
   return true;
 }
 
+bool HttpCache::Transaction::CanFollowWriter() const {
+  // Range requests and validations need more than the stored response.
+  return (mode_ == READ || mode_ == READ_WRITE) && !partial_.get() &&
+         request_->method == "GET" &&
+         !(effective_load_flags_ & LOAD_VALIDATE_CACHE) &&
+         !must_wait_for_writer_;
+}
+
+void HttpCache::Transaction::FollowWriter() {
+  DCHECK(CanFollowWriter());
+  following_writer_ = true;
+}
+
 LoadState HttpCache::Transaction::GetWriterLoadState() const {
   if (network_trans_.get())
     return network_trans_->GetLoadState();
@@ -367,8 +385,12 @@ void HttpCache::Transaction::StopCaching() {
   // the next piece of code that executes know that we are now reading directly
   // from the net.
   if (cache_ && entry_ && (mode_ & WRITE) && network_trans_.get() &&
-      !is_sparse_ && !range_requested_)
+      !is_sparse_ && !range_requested_) {
     mode_ = NONE;
+    // Whoever is following us will not get the rest of the body from the
+    // cache.
+    cache_->StopStreaming(entry_, false);
+  }
 }
 
 void HttpCache::Transaction::DoneReading() {
@@ -752,6 +774,12 @@ int HttpCache::Transaction::DoSendRequestComplete(int result) {
 
 // We received the response headers and there is no error.
 int HttpCache::Transaction::DoSuccessfulSendRequest() {
+  if (released_entry_) {
+    // Take the entry back before doing anything with the response.
+    next_state_ = STATE_INIT_ENTRY;
+    return OK;
+  }
+
   DCHECK(!new_response_);
   const HttpResponseInfo* new_response = network_trans_->GetResponseInfo();
   if (new_response->headers->response_code() == 401 ||
@@ -920,6 +948,8 @@ int HttpCache::Transaction::DoCreateEntryComplete(int result) {
     // OpenOrCreate() method exposed by the disk cache.
     DLOG(WARNING) << "Unable to create cache entry";
     mode_ = NONE;
+    if (released_entry_)
+      return ResumeBackgroundValidation();
     if (partial_.get())
       partial_->RestoreHeaders(&custom_request_->extra_headers);
     next_state_ = STATE_SEND_REQUEST;
@@ -996,6 +1026,11 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
   entry_ = new_entry_;
   new_entry_ = NULL;
 
+  // The stale entry went away while it was being validated, so this is a new
+  // entry.
+  if (released_entry_ && mode_ == WRITE)
+    return ResumeBackgroundValidation();
+
   if (mode_ == WRITE) {
     if (partial_.get())
       partial_->RestoreHeaders(&custom_request_->extra_headers);
@@ -1179,6 +1214,14 @@ int HttpCache::Transaction::DoPartialHeadersReceived() {
       entry_->disk_entry->GetDataSize(kMetadataIndex))
     next_state_ = STATE_CACHE_READ_METADATA;
 
+  // We are about to store a whole new response body, so the transactions
+  // waiting for this response don't have to wait for all of it.
+  if (entry_ && mode_ == WRITE && !partial_.get() && !truncated_ &&
+      request_->method == "GET" &&
+      response_.headers->response_code() == 200) {
+    cache_->StartStreaming(entry_);
+  }
+
   if (!partial_.get())
     return OK;
 
@@ -1198,6 +1241,21 @@ int HttpCache::Transaction::DoPartialHeadersReceived() {
 
 int HttpCache::Transaction::DoCacheReadResponse() {
   DCHECK(entry_);
+  if (following_writer_) {
+    if (entry_->stream_truncated) {
+      // The writer failed, but we didn't return anything to the caller yet.
+      StopFollowingWriter();
+      next_state_ = STATE_INIT_ENTRY;
+      return OK;
+    }
+    if (entry_->streaming && !entry_->streamed_size) {
+      // Don't commit to this response until the writer stores some of the
+      // body, so that we can still start over if it fails right away.
+      next_state_ = STATE_CACHE_READ_RESPONSE;
+      cache_->WaitForStreamData(entry_, this);
+      return ERR_IO_PENDING;
+    }
+  }
   next_state_ = STATE_CACHE_READ_RESPONSE_COMPLETE;
 
   io_buf_len_ = entry_->disk_entry->GetDataSize(kResponseInfoIndex);
@@ -1210,12 +1268,32 @@ int HttpCache::Transaction::DoCacheReadResponse() {
 
 int HttpCache::Transaction::DoCacheReadResponseComplete(int result) {
   net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HTTP_CACHE_READ_INFO, result);
+
+  if (following_writer_ && entry_->stream_truncated) {
+    StopFollowingWriter();
+    next_state_ = STATE_INIT_ENTRY;
+    return OK;
+  }
+
   if (result != io_buf_len_ ||
       !HttpCache::ParseResponseInfo(read_buf_->data(), io_buf_len_,
                                     &response_, &truncated_)) {
+    if (released_entry_) {
+      // Leave whatever is stored alone.
+      DoneWritingToEntry(true);
+      return ResumeBackgroundValidation();
+    }
     return OnCacheReadError(result, true);
   }
 
+  if (released_entry_) {
+    // The response is only applied to the entry if the entry still holds the
+    // response that was validated.
+    if (response_.response_time != validated_response_time_ || truncated_)
+      DoneWritingToEntry(true);
+    return ResumeBackgroundValidation();
+  }
+
   // Some resources may have slipped in as truncated when they're not.
   int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
   if (response_.headers->GetContentLength() == current_size)
@@ -1323,6 +1401,26 @@ int HttpCache::Transaction::DoCacheReadData() {
   DCHECK(entry_);
   next_state_ = STATE_CACHE_READ_DATA_COMPLETE;
 
+  int read_len = io_buf_len_;
+  if (following_writer_) {
+    if (entry_->streaming) {
+      int available = entry_->streamed_size - read_offset_;
+      if (available <= 0) {
+        // We caught up with the writer, so wait for more data.
+        next_state_ = STATE_CACHE_READ_DATA;
+        cache_->WaitForStreamData(entry_, this);
+        return ERR_IO_PENDING;
+      }
+      read_len = std::min(read_len, available);
+    } else if (entry_->stream_truncated &&
+               read_offset_ >=
+                   entry_->disk_entry->GetDataSize(kResponseContentIndex)) {
+      // The rest of the body will never be stored.
+      next_state_ = STATE_NONE;
+      return ERR_CACHE_READ_FAILURE;
+    }
+  }
+
   if (net_log_.IsLoggingAllEvents())
     net_log_.BeginEvent(NetLog::TYPE_HTTP_CACHE_READ_DATA, NULL);
   if (partial_.get()) {
@@ -1331,7 +1429,7 @@ int HttpCache::Transaction::DoCacheReadData() {
   }
 
   return entry_->disk_entry->ReadData(kResponseContentIndex, read_offset_,
-                                      read_buf_, io_buf_len_, io_callback_);
+                                      read_buf_, read_len, io_callback_);
 }
 
 int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
@@ -1382,10 +1480,11 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
     // We want to ignore errors writing to disk and just keep reading from
     // the network.
     result = write_len_;
-  } else if (!done_reading_ && entry_) {
+  } else if (entry_) {
     int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
+    cache_->OnStreamDataStored(entry_, current_size);
     int64 body_size = response_.headers->GetContentLength();
-    if (body_size >= 0 && body_size <= current_size)
+    if (!done_reading_ && body_size >= 0 && body_size <= current_size)
       done_reading_ = true;
   }
 
@@ -1573,6 +1672,22 @@ int HttpCache::Transaction::BeginCacheValidation() {
   if ((partial_.get() && !partial_->IsCurrentRangeCached()) || invalid_range_)
     skip_validation = false;
 
+  bool revalidate_in_background = false;
+  if (!skip_validation && CanRevalidateInBackground()) {
+    skip_validation = true;
+    revalidate_in_background = true;
+  }
+
+  if (following_writer_ && !skip_validation) {
+    // We need exclusive access to the entry to validate it, so we have to
+    // wait for the writer after all.
+    new_entry_ = entry_;
+    StopFollowingWriter();
+    must_wait_for_writer_ = true;
+    next_state_ = STATE_ADD_TO_ENTRY;
+    return OK;
+  }
+
   if (skip_validation) {
     if (partial_.get()) {
       // We are going to return the saved response headers to the caller, so
@@ -1580,12 +1695,19 @@ int HttpCache::Transaction::BeginCacheValidation() {
       next_state_ = STATE_PARTIAL_HEADERS_RECEIVED;
       return OK;
     }
-    cache_->ConvertWriterToReader(entry_);
+    if (!following_writer_)
+      cache_->ConvertWriterToReader(entry_);
     mode_ = READ;
 
+    if (revalidate_in_background)
+      cache_->RevalidateInBackground(cache_key_, *request_);
+
     if (entry_->disk_entry->GetDataSize(kMetadataIndex))
       next_state_ = STATE_CACHE_READ_METADATA;
   } else {
+    if (validating_in_background_)
+      ReleaseEntryWhileValidating();
+
     // Make the network request conditional, to see if we may reuse our cached
     // response.  If we cannot do so, then we just resort to a normal fetch.
     // Our mode remains READ_WRITE for a conditional request.  We'll switch to
@@ -1736,6 +1858,51 @@ bool HttpCache::Transaction::RequiresValidation() {
   return false;
 }
 
+bool HttpCache::Transaction::CanRevalidateInBackground() {
+  if (!cache_->use_stale_while_revalidate() ||
+      cache_->mode() != net::HttpCache::NORMAL)
+    return false;
+
+  // Explicit validation requests have to wait for the server.
+  if (effective_load_flags_ & LOAD_VALIDATE_CACHE)
+    return false;
+
+  if (partial_.get() || truncated_ || request_->method != "GET")
+    return false;
+
+  if (response_.vary_data.is_valid() &&
+      !response_.vary_data.MatchesRequest(*request_, *response_.headers))
+    return false;
+
+  return response_.headers->IsStaleWhileRevalidateAllowed(
+      response_.request_time, response_.response_time, Time::Now());
+}
+
+void HttpCache::Transaction::ReleaseEntryWhileValidating() {
+  DCHECK_EQ(READ_WRITE, mode_);
+  DCHECK(!partial_.get());
+  validated_response_time_ = response_.response_time;
+  released_entry_ = true;
+
+  // Nothing has been written to the entry.
+  cache_->ConvertWriterToReader(entry_);
+  cache_->DoneReadingFromEntry(entry_, this);
+  entry_ = NULL;
+}
+
+int HttpCache::Transaction::ResumeBackgroundValidation() {
+  released_entry_ = false;
+
+  // A new entry cannot be made out of a "304 Not Modified".
+  if (mode_ == WRITE &&
+      network_trans_->GetResponseInfo()->headers->response_code() == 304) {
+    DoneWritingToEntry(false);
+  }
+
+  next_state_ = STATE_SUCCESSFUL_SEND_REQUEST;
+  return OK;
+}
+
 bool HttpCache::Transaction::ConditionalizeRequest() {
   DCHECK(response_.headers);
 
@@ -2042,6 +2209,12 @@ int HttpCache::Transaction::OnCacheReadError(int result, bool restart) {
   return ERR_CACHE_READ_FAILURE;
 }
 
+void HttpCache::Transaction::StopFollowingWriter() {
+  cache_->DoneReadingFromEntry(entry_, this);
+  entry_ = NULL;
+  following_writer_ = false;
+}
+
 void HttpCache::Transaction::DoomPartialEntry(bool delete_object) {
   DVLOG(2) << "DoomPartialEntry";
   int rv = cache_->DoomEntry(cache_key_, NULL);
@@ -96,6 +96,21 @@ class HttpCache::Transaction : public HttpTransaction {
 
   const CompletionCallback& io_callback() { return io_callback_; }
 
+  // Returns true if this transaction only needs to read the cached response,
+  // so it can start reading while another transaction is still storing the
+  // response body.
+  bool CanFollowWriter() const;
+
+  // Called when this transaction is added to an entry whose writer is still
+  // storing the response body.
+  void FollowWriter();
+
+  // Marks this transaction as the background revalidation of a stale
+  // response. It lets go of the entry while it waits for the server, so that
+  // the stale response can still be read, and only takes the entry again once
+  // the response arrives.
+  void set_validating_in_background() { validating_in_background_ = true; }
+
   const BoundNetLog& net_log() const;
 
   // HttpTransaction methods:
@@ -267,10 +282,21 @@ class HttpCache::Transaction : public HttpTransaction {
   // Called to determine if we need to validate the cache entry before using it.
   bool RequiresValidation();
 
+  // Returns true if the cached response needs validation, but it can be used
+  // right away while it is revalidated in the background.
+  bool CanRevalidateInBackground();
+
   // Called to make the request conditional (to ask the server if the cached
   // copy is valid).  Returns true if able to make the request conditional.
   bool ConditionalizeRequest();
 
+  // Lets go of the entry while a background validation is on the network.
+  void ReleaseEntryWhileValidating();
+
+  // Called once a background validation holds the entry again, to handle the
+  // response it got meanwhile.
+  int ResumeBackgroundValidation();
+
   // Makes sure that a 206 response is expected.  Returns true on success.
   // On success, handling_206_ will be set to true if we are processing a
   // partial entry.
@@ -312,6 +338,10 @@ class HttpCache::Transaction : public HttpTransaction {
   // transaction should be restarted.
   int OnCacheReadError(int result, bool restart);
 
+  // Leaves the entry that we were reading while its writer was still storing
+  // the response body.
+  void StopFollowingWriter();
+
   // Deletes the current partial cache entry (sparse), and optionally removes
   // the control object (partial_).
   void DoomPartialEntry(bool delete_object);
@@ -360,6 +390,11 @@ class HttpCache::Transaction : public HttpTransaction {
   bool handling_206_;  // We must deal with this 206 response.
   bool cache_pending_;  // We are waiting for the HttpCache.
   bool done_reading_;
+  bool following_writer_;  // The response body may not be stored yet.
+  bool must_wait_for_writer_;  // We cannot follow the writer.
+  bool validating_in_background_;
+  bool released_entry_;  // We let go of the entry until the response arrives.
+  base::Time validated_response_time_;  // Of the response being validated.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
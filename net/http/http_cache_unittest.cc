@@ -965,11 +965,12 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   c->result = c->callback.WaitForResult();
   ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
 
-  // Now we have 2 active readers and two queued transactions.
+  // Now we have 4 active readers: all of them followed the writer instead of
+  // waiting in the queue.
 
   EXPECT_EQ(net::LOAD_STATE_IDLE,
             context_list[2]->trans->GetLoadState());
-  EXPECT_EQ(net::LOAD_STATE_WAITING_FOR_CACHE,
+  EXPECT_EQ(net::LOAD_STATE_IDLE,
             context_list[3]->trans->GetLoadState());
 
   c = context_list[1];
@@ -978,10 +979,8 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   if (c->result == net::OK)
     ReadAndVerifyTransaction(c->trans.get(), kSimpleGET_Transaction);
 
-  // At this point we have one reader, two pending transactions and a task on
-  // the queue to move to the next transaction. Now we cancel the request that
-  // is the current reader, and expect the queued task to be able to start the
-  // next request.
+  // Now we cancel one of the readers, and expect the rest of them to be able
+  // to finish.
 
   c = context_list[2];
   c->trans.reset();
@@ -1006,6 +1005,119 @@ TEST(HttpCache, SimpleGET_RacingReaders) {
   }
 }
 
+// Tests that readers don't wait for the writer to store the whole response
+// body, but follow it as the body is stored.
+TEST(HttpCache, SimpleGET_ReadersFollowWriter) {
+  MockHttpCache cache;
+
+  const std::string body(20000, 'a');
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.data = body.c_str();
+  MockHttpRequest request(transaction);
+
+  ScopedVector<Context> context_list;
+  const int kNumTransactions = 4;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.http_cache()->CreateTransaction(&c->trans);
+    EXPECT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  Context* writer = context_list[0];
+  ASSERT_EQ(net::ERR_IO_PENDING, writer->result);
+  writer->result = writer->callback.WaitForResult();
+  EXPECT_EQ(net::OK, writer->result);
+
+  // Store the first part of the body.
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(5000));
+  int rv = writer->trans->Read(buf, 1000, writer->callback.callback());
+  EXPECT_EQ(1000, writer->callback.GetResult(rv));
+
+  // The readers can start reading right away...
+  Context* c = context_list[1];
+  ASSERT_EQ(net::ERR_IO_PENDING, c->result);
+  c->result = c->callback.WaitForResult();
+  EXPECT_EQ(net::OK, c->result);
+
+  rv = c->trans->Read(buf, 5000, c->callback.callback());
+  EXPECT_EQ(1000, c->callback.GetResult(rv));
+  EXPECT_EQ(0, memcmp(body.data(), buf->data(), 1000));
+
+  // ... but they have to wait for the writer to get more data.
+  rv = c->trans->Read(buf, 5000, c->callback.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(c->callback.have_result());
+
+  rv = writer->trans->Read(buf, 1000, writer->callback.callback());
+  EXPECT_EQ(1000, writer->callback.GetResult(rv));
+  EXPECT_EQ(1000, c->callback.WaitForResult());
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    if (c->result == net::ERR_IO_PENDING)
+      c->result = c->callback.WaitForResult();
+    EXPECT_EQ(net::OK, c->result);
+  }
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    std::string content;
+    EXPECT_EQ(net::OK, ReadTransaction(context_list[i]->trans.get(),
+                                       &content));
+    int expected_size = body.size() - (i < 2 ? 2000 : 0);
+    EXPECT_EQ(expected_size, static_cast<int>(content.size()));
+  }
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that readers that follow the writer fail if the writer goes away
+// before storing the whole response body.
+TEST(HttpCache, SimpleGET_ReadersFollowWriter_CancelWriter) {
+  MockHttpCache cache;
+
+  const std::string body(20000, 'a');
+  ScopedMockTransaction transaction(kSimpleGET_Transaction);
+  transaction.data = body.c_str();
+  MockHttpRequest request(transaction);
+
+  Context writer;
+  Context reader;
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&writer.trans));
+  EXPECT_EQ(net::OK, cache.http_cache()->CreateTransaction(&reader.trans));
+  writer.result = writer.trans->Start(&request, writer.callback.callback(),
+                                      net::BoundNetLog());
+  reader.result = reader.trans->Start(&request, reader.callback.callback(),
+                                      net::BoundNetLog());
+  EXPECT_EQ(net::OK, writer.callback.GetResult(writer.result));
+
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(5000));
+  int rv = writer.trans->Read(buf, 1000, writer.callback.callback());
+  EXPECT_EQ(1000, writer.callback.GetResult(rv));
+
+  EXPECT_EQ(net::OK, reader.callback.GetResult(reader.result));
+  rv = reader.trans->Read(buf, 5000, reader.callback.callback());
+  EXPECT_EQ(1000, reader.callback.GetResult(rv));
+
+  rv = reader.trans->Read(buf, 5000, reader.callback.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, rv);
+  writer.trans.reset();
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE, reader.callback.WaitForResult());
+  reader.trans.reset();
+
+  // The next request goes to the network.
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+}
+
 // Tests that we can doom an entry with pending transactions and delete one of
 // the pending transactions before the first one completes.
 // See http://code.google.com/p/chromium/issues/detail?id=25588
@@ -1595,6 +1707,148 @@ static void ETagGet_UnconditionalRequest_Handler(
       request->extra_headers.HasHeader(net::HttpRequestHeaders::kIfNoneMatch));
 }
 
+static const char kStaleWhileRevalidateHeaders[] =
+    "Cache-Control: max-age=0, stale-while-revalidate=86400\n"
+    "Etag: foopy\n";
+
+static void StaleWhileRevalidate_Handler(
+    const net::HttpRequestInfo* request,
+    std::string* response_status,
+    std::string* response_headers,
+    std::string* response_data) {
+  EXPECT_TRUE(
+      request->extra_headers.HasHeader(net::HttpRequestHeaders::kIfNoneMatch));
+  response_headers->assign("Cache-Control: max-age=10000\n"
+                           "Etag: bar\n");
+  response_data->assign("new data");
+}
+
+// Tests that a stale response is served right away if the server allows it,
+// and that it is revalidated in the background.
+TEST(HttpCache, ETagGET_StaleWhileRevalidate) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_stale_while_revalidate(true);
+
+  ScopedMockTransaction transaction(kETagGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+
+  // Write to the cache.
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+
+  // The next request gets the stored response, even though the server has a
+  // new one.
+  transaction.handler = StaleWhileRevalidate_Handler;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  // The new response is stored in the background.
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  transaction.handler = NULL;
+  transaction.data = "new data";
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+}
+
+// Tests that concurrent requests for a stale response trigger a single
+// revalidation.
+TEST(HttpCache, ETagGET_StaleWhileRevalidate_Coalesced) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_stale_while_revalidate(true);
+
+  ScopedMockTransaction transaction(kETagGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  transaction.handler = StaleWhileRevalidate_Handler;
+  MockHttpRequest request(transaction);
+
+  ScopedVector<Context> context_list;
+  const int kNumTransactions = 3;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.http_cache()->CreateTransaction(&c->trans);
+    EXPECT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    EXPECT_EQ(net::OK, c->callback.GetResult(c->result));
+    EXPECT_TRUE(c->trans->GetResponseInfo()->was_cached);
+    ReadAndVerifyTransaction(c->trans.get(), transaction);
+  }
+
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that the stale response can still be read while the background
+// revalidation waits for the server.
+TEST(HttpCache, ETagGET_StaleWhileRevalidate_NotBlocked) {
+  MockHttpCache cache;
+  cache.http_cache()->set_use_stale_while_revalidate(true);
+
+  ScopedMockTransaction transaction(kETagGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  // Start the revalidation, and hold it on the network.
+  cache.network_layer()->set_block_start(true);
+  transaction.handler = StaleWhileRevalidate_Handler;
+  RunTransactionTest(cache.http_cache(), transaction);
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+
+  // A new request is served from the cache without waiting for the server.
+  MockHttpRequest request(transaction);
+  Context c;
+  c.result = cache.http_cache()->CreateTransaction(&c.trans);
+  EXPECT_EQ(net::OK, c.result);
+  c.result = c.trans->Start(&request, c.callback.callback(),
+                            net::BoundNetLog());
+  MessageLoop::current()->RunAllPending();
+  ASSERT_TRUE(c.result == net::OK || c.callback.have_result());
+  EXPECT_EQ(net::OK, c.callback.GetResult(c.result));
+  EXPECT_TRUE(c.trans->GetResponseInfo()->was_cached);
+  ReadAndVerifyTransaction(c.trans.get(), transaction);
+  c.trans.reset();
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+
+  // Once the server answers, the new response is stored.
+  cache.network_layer()->ResumeBlockedStarts();
+  MessageLoop::current()->RunAllPending();
+
+  transaction.handler = NULL;
+  transaction.data = "new data";
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+}
+
+// Tests that a stale response is revalidated before it is used, unless the
+// cache is told to honor stale-while-revalidate.
+TEST(HttpCache, ETagGET_StaleWhileRevalidate_Disabled) {
+  MockHttpCache cache;
+
+  ScopedMockTransaction transaction(kETagGET_Transaction);
+  transaction.response_headers = kStaleWhileRevalidateHeaders;
+  RunTransactionTest(cache.http_cache(), transaction);
+
+  transaction.handler = StaleWhileRevalidate_Handler;
+  transaction.data = "new data";
+  RunTransactionTest(cache.http_cache(), transaction);
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+}
+
 TEST(HttpCache, ETagGET_Http10) {
   MockHttpCache cache;
 
@@ -61,34 +61,43 @@ HttpChunkedDecoder::HttpChunkedDecoder()
 }
 
 int HttpChunkedDecoder::FilterBuf(char* buf, int buf_len) {
+  // The chunk data is compacted towards the start of |buf| as the chunk
+  // markers are dropped, reading from |in| and writing at |buf| + |result|,
+  // so that every byte is moved at most once however many chunks there are.
+  const char* in = buf;
   int result = 0;
 
   while (buf_len) {
     if (chunk_remaining_) {
       int num = std::min(chunk_remaining_, buf_len);
+      if (in != buf + result)
+        memmove(buf + result, in, num);
 
       buf_len -= num;
       chunk_remaining_ -= num;
 
       result += num;
-      buf += num;
+      in += num;
 
       // After each chunk's data there should be a CRLF
       if (!chunk_remaining_)
         chunk_terminator_remaining_ = true;
       continue;
     } else if (reached_eof_) {
+      // Leave the extra bytes right after the data, where the caller looks
+      // for them.
+      if (in != buf + result)
+        memmove(buf + result, in, buf_len);
       bytes_after_eof_ += buf_len;
       break;  // Done!
     }
 
-    int bytes_consumed = ScanForChunkRemaining(buf, buf_len);
+    int bytes_consumed = ScanForChunkRemaining(in, buf_len);
     if (bytes_consumed < 0)
       return bytes_consumed; // Error
 
     buf_len -= bytes_consumed;
-    if (buf_len)
-      memmove(buf, buf + bytes_consumed, buf_len);
+    in += bytes_consumed;
   }
 
   return result;
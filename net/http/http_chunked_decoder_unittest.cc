@@ -307,3 +307,15 @@ TEST(HttpChunkedDecoderTest, MultipleExtraDataBlocks) {
   };
   RunTest(inputs, arraysize(inputs), "hello", true, 11);
 }
+
+// HttpStreamParser expects the data after the final CRLF to immediately
+// follow the decoded data.
+TEST(HttpChunkedDecoderTest, ExtraDataFollowsOutput) {
+  net::HttpChunkedDecoder decoder;
+  std::string input = "5\r\nhello\r\n1\r\n \r\n5\r\nworld\r\n0\r\n\r\nextra";
+  int n = decoder.FilterBuf(&input[0], static_cast<int>(input.size()));
+  ASSERT_EQ(11, n);
+  EXPECT_TRUE(decoder.reached_eof());
+  ASSERT_EQ(5, decoder.bytes_after_eof());
+  EXPECT_EQ("hello worldextra", input.substr(0, n + 5));
+}
@@ -143,6 +143,14 @@ struct HttpResponseHeaders::ParsedHeader {
   std::string::const_iterator name_end;
   std::string::const_iterator value_begin;
   std::string::const_iterator value_end;
+
+  // The HttpUtil::GetWellKnownHeaderId() of the name, or -1 if it is not a
+  // well-known header or this is a continuation.
+  int name_id;
+
+  // The index in parsed_ of the next header with the same well-known name,
+  // or -1 if there is none.
+  int next_same_name;
 };
 
 //-----------------------------------------------------------------------------
@@ -172,6 +180,7 @@ HttpResponseHeaders::HttpResponseHeaders(const std::string& raw_input)
 HttpResponseHeaders::HttpResponseHeaders(const Pickle& pickle,
                                          PickleIterator* iter)
     : response_code_(-1) {
+  IndexWellKnownHeaders();
   std::string raw_input;
   if (pickle.ReadString(iter, &raw_input))
     Parse(raw_input);
@@ -409,6 +418,7 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
 
   if (line_end == raw_input.end()) {
     raw_headers_.push_back('\0');  // Ensure the headers end with a double null.
+    IndexWellKnownHeaders();
 
     DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 2]);
     DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
@@ -440,6 +450,7 @@ void HttpResponseHeaders::Parse(const std::string& raw_input) {
               headers.values_begin(),
               headers.values_end());
   }
+  IndexWellKnownHeaders();
 
   DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 2]);
   DCHECK_EQ('\0', raw_headers_[raw_headers_.size() - 1]);
@@ -501,15 +512,16 @@ void HttpResponseHeaders::GetNormalizedHeaders(std::string* output) const {
 
 bool HttpResponseHeaders::GetNormalizedHeader(const std::string& name,
                                               std::string* value) const {
+  int name_id = HttpUtil::GetWellKnownHeaderId(name);
   // If you hit this assertion, please use EnumerateHeader instead!
-  DCHECK(!HttpUtil::IsNonCoalescingHeader(name));
+  DCHECK(!HttpUtil::IsNonCoalescingHeaderId(name_id));
 
   value->clear();
 
   bool found = false;
   size_t i = 0;
   while (i < parsed_.size()) {
-    i = FindHeader(i, name);
+    i = FindHeader(i, name, name_id);
     if (i == std::string::npos)
       break;
 
@@ -611,6 +623,7 @@ bool HttpResponseHeaders::HasHeader(const std::string& name) const {
 }
 
 HttpResponseHeaders::HttpResponseHeaders() : response_code_(-1) {
+  IndexWellKnownHeaders();
 }
 
 HttpResponseHeaders::~HttpResponseHeaders() {
@@ -735,8 +748,24 @@ void HttpResponseHeaders::ParseStatusLine(
 
 size_t HttpResponseHeaders::FindHeader(size_t from,
                                        const std::string& search) const {
+  return FindHeader(from, search, HttpUtil::GetWellKnownHeaderId(search));
+}
+
+size_t HttpResponseHeaders::FindHeader(size_t from,
+                                       const std::string& search,
+                                       int search_id) const {
+  if (search_id >= 0) {
+    for (int i = first_well_known_[search_id]; i >= 0;
+         i = parsed_[i].next_same_name) {
+      if (static_cast<size_t>(i) >= from)
+        return i;
+    }
+    return std::string::npos;
+  }
+
+  // Only headers that aren't well-known can have a name that isn't.
   for (size_t i = from; i < parsed_.size(); ++i) {
-    if (parsed_[i].is_continuation())
+    if (parsed_[i].is_continuation() || parsed_[i].name_id >= 0)
       continue;
     const std::string::const_iterator& name_begin = parsed_[i].name_begin;
     const std::string::const_iterator& name_end = parsed_[i].name_end;
@@ -753,16 +782,19 @@ void HttpResponseHeaders::AddHeader(std::string::const_iterator name_begin,
                                     std::string::const_iterator name_end,
                                     std::string::const_iterator values_begin,
                                     std::string::const_iterator values_end) {
+  int name_id = HttpUtil::GetWellKnownHeaderId(name_begin, name_end);
   // If the header can be coalesced, then we should split it up.
   if (values_begin == values_end ||
-      HttpUtil::IsNonCoalescingHeader(name_begin, name_end)) {
-    AddToParsed(name_begin, name_end, values_begin, values_end);
+      HttpUtil::IsNonCoalescingHeaderId(name_id)) {
+    AddToParsed(name_begin, name_end, values_begin, values_end, name_id);
   } else {
     HttpUtil::ValuesIterator it(values_begin, values_end, ',');
     while (it.GetNext()) {
-      AddToParsed(name_begin, name_end, it.value_begin(), it.value_end());
+      AddToParsed(name_begin, name_end, it.value_begin(), it.value_end(),
+                  name_id);
       // clobber these so that subsequent values are treated as continuations
       name_begin = name_end = raw_headers_.end();
+      name_id = -1;
     }
   }
 }
@@ -770,15 +802,31 @@ void HttpResponseHeaders::AddHeader(std::string::const_iterator name_begin,
 void HttpResponseHeaders::AddToParsed(std::string::const_iterator name_begin,
                                       std::string::const_iterator name_end,
                                       std::string::const_iterator value_begin,
-                                      std::string::const_iterator value_end) {
+                                      std::string::const_iterator value_end,
+                                      int name_id) {
   ParsedHeader header;
   header.name_begin = name_begin;
   header.name_end = name_end;
   header.value_begin = value_begin;
   header.value_end = value_end;
+  header.name_id = name_id;
+  header.next_same_name = -1;
   parsed_.push_back(header);
 }
 
+void HttpResponseHeaders::IndexWellKnownHeaders() {
+  std::fill(first_well_known_, first_well_known_ + arraysize(first_well_known_),
+            -1);
+  // Walk backwards so that each header is linked in front of the later ones.
+  for (int i = static_cast<int>(parsed_.size()) - 1; i >= 0; --i) {
+    int name_id = parsed_[i].name_id;
+    if (name_id < 0)
+      continue;
+    parsed_[i].next_same_name = first_well_known_[name_id];
+    first_well_known_[name_id] = i;
+  }
+}
+
 void HttpResponseHeaders::AddNonCacheableHeaders(HeaderSet* result) const {
   // Add server specified transients.  Any 'cache-control: no-cache="foo,bar"'
   // headers present in the response specify additional headers that we should
@@ -826,6 +874,33 @@ void HttpResponseHeaders::AddNonCacheableHeaders(HeaderSet* result) const {
   }
 }
 
+bool HttpResponseHeaders::GetCacheControlDirective(
+    const std::string& directive,
+    TimeDelta* result) const {
+  std::string name = "cache-control";
+  std::string value;
+
+  const std::string prefix = directive + "=";
+
+  void* iter = NULL;
+  while (EnumerateHeader(&iter, name, &value)) {
+    if (value.size() > prefix.size()) {
+      if (LowerCaseEqualsASCII(value.begin(),
+                               value.begin() + prefix.size(),
+                               prefix.c_str())) {
+        int64 seconds;
+        base::StringToInt64(StringPiece(value.begin() + prefix.size(),
+                                        value.end()),
+                            &seconds);
+        *result = TimeDelta::FromSeconds(seconds);
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
 void HttpResponseHeaders::AddHopByHopHeaders(HeaderSet* result) {
   for (size_t i = 0; i < arraysize(kHopByHopResponseHeaders); ++i)
     result->insert(std::string(kHopByHopResponseHeaders[i]));
@@ -932,6 +1007,37 @@ bool HttpResponseHeaders::RequiresValidation(const Time& request_time,
   return lifetime <= GetCurrentAge(request_time, response_time, current_time);
 }
 
+// From RFC 5861 section 3:
+//
+// When present in an HTTP response, the stale-while-revalidate Cache-Control
+// extension indicates that caches MAY serve the response in which it appears
+// after it becomes stale, up to the indicated number of seconds.
+//
+// The directives that prevent a response from being reused without
+// validation still apply, so must-revalidate and anything that makes the
+// response never fresh rule out stale-while-revalidate as well.
+//
+bool HttpResponseHeaders::IsStaleWhileRevalidateAllowed(
+    const Time& request_time,
+    const Time& response_time,
+    const Time& current_time) const {
+  TimeDelta stale_while_revalidate;
+  if (!GetStaleWhileRevalidateValue(&stale_while_revalidate))
+    return false;
+
+  if (HasHeaderValue("cache-control", "no-cache") ||
+      HasHeaderValue("cache-control", "no-store") ||
+      HasHeaderValue("cache-control", "must-revalidate") ||
+      HasHeaderValue("pragma", "no-cache") ||
+      HasHeaderValue("vary", "*"))
+    return false;
+
+  TimeDelta current_age =
+      GetCurrentAge(request_time, response_time, current_time);
+  return current_age <
+      GetFreshnessLifetime(response_time) + stale_while_revalidate;
+}
+
 // From RFC 2616 section 13.2.4:
 //
 // The max-age directive takes priority over Expires, so if max-age is present
@@ -1078,29 +1184,12 @@ TimeDelta HttpResponseHeaders::GetCurrentAge(const Time& request_time,
 }
 
 bool HttpResponseHeaders::GetMaxAgeValue(TimeDelta* result) const {
-  std::string name = "cache-control";
-  std::string value;
-
-  const char kMaxAgePrefix[] = "max-age=";
-  const size_t kMaxAgePrefixLen = arraysize(kMaxAgePrefix) - 1;
-
-  void* iter = NULL;
-  while (EnumerateHeader(&iter, name, &value)) {
-    if (value.size() > kMaxAgePrefixLen) {
-      if (LowerCaseEqualsASCII(value.begin(),
-                               value.begin() + kMaxAgePrefixLen,
-                               kMaxAgePrefix)) {
-        int64 seconds;
-        base::StringToInt64(StringPiece(value.begin() + kMaxAgePrefixLen,
-                                        value.end()),
-                            &seconds);
-        *result = TimeDelta::FromSeconds(seconds);
-        return true;
-      }
-    }
-  }
+  return GetCacheControlDirective("max-age", result);
+}
 
-  return false;
+bool HttpResponseHeaders::GetStaleWhileRevalidateValue(
+    TimeDelta* result) const {
+  return GetCacheControlDirective("stale-while-revalidate", result);
 }
 
 bool HttpResponseHeaders::GetAgeValue(TimeDelta* result) const {
@@ -13,6 +13,7 @@
 #include "base/hash_tables.h"
 #include "base/memory/ref_counted.h"
 #include "net/base/net_export.h"
+#include "net/http/http_util.h"
 #include "net/http/http_version.h"
 
 class Pickle;
@@ -195,6 +196,14 @@ class NET_EXPORT HttpResponseHeaders
                           const base::Time& response_time,
                           const base::Time& current_time) const;
 
+  // Returns true if the response is stale, but it can still be used while it
+  // is revalidated in the background, as allowed by the stale-while-revalidate
+  // directive (RFC 5861).  See RequiresValidation for a description of this
+  // method's parameters.
+  bool IsStaleWhileRevalidateAllowed(const base::Time& request_time,
+                                     const base::Time& response_time,
+                                     const base::Time& current_time) const;
+
   // Returns the amount of time the server claims the response is fresh from
   // the time the response was generated.  See section 13.2.4 of RFC 2616.  See
   // RequiresValidation for a description of the response_time parameter.
@@ -210,6 +219,7 @@ class NET_EXPORT HttpResponseHeaders
   // value is not present, then false is returned.  Otherwise, true is returned
   // and the out param is assigned to the corresponding value.
   bool GetMaxAgeValue(base::TimeDelta* value) const;
+  bool GetStaleWhileRevalidateValue(base::TimeDelta* value) const;
   bool GetAgeValue(base::TimeDelta* value) const;
   bool GetDateValue(base::Time* value) const;
   bool GetLastModifiedValue(base::Time* value) const;
@@ -289,6 +299,9 @@ class NET_EXPORT HttpResponseHeaders
   // index |from|.  Returns string::npos if not found.
   size_t FindHeader(size_t from, const std::string& name) const;
 
+  // Same as above, given HttpUtil::GetWellKnownHeaderId(name) as |name_id|.
+  size_t FindHeader(size_t from, const std::string& name, int name_id) const;
+
   // Add a header->value pair to our list.  If we already have header in our
   // list, append the value to it.
   void AddHeader(std::string::const_iterator name_begin,
@@ -300,7 +313,12 @@ class NET_EXPORT HttpResponseHeaders
   void AddToParsed(std::string::const_iterator name_begin,
                    std::string::const_iterator name_end,
                    std::string::const_iterator value_begin,
-                   std::string::const_iterator value_end);
+                   std::string::const_iterator value_end,
+                   int name_id);
+
+  // Links the headers of parsed_ that have a well-known name into
+  // first_well_known_ and their next_same_name fields.
+  void IndexWellKnownHeaders();
 
   // Replaces the current headers with the merged version of |raw_headers| and
   // the current headers without the headers in |headers_to_remove|. Note that
@@ -322,6 +340,11 @@ class NET_EXPORT HttpResponseHeaders
   // Adds the values from any 'cache-control: no-cache="foo,bar"' headers.
   void AddNonCacheableHeaders(HeaderSet* header_names) const;
 
+  // Extracts the value of a 'cache-control: <directive>=<seconds>' header,
+  // where |directive| is lowercase.  Returns false if it is not present.
+  bool GetCacheControlDirective(const std::string& directive,
+                                base::TimeDelta* result) const;
+
   // Adds the set of header names that contain cookie values.
   static void AddSensitiveHeaders(HeaderSet* header_names);
 
@@ -344,6 +367,12 @@ class NET_EXPORT HttpResponseHeaders
   // header-value pairs within raw_headers_.
   HeaderList parsed_;
 
+  // For each well-known header name, the index in parsed_ of the first header
+  // with that name, or -1 if there is none.  Headers with the same name are
+  // chained through ParsedHeader::next_same_name, so that looking one up
+  // doesn't take a scan of parsed_.
+  int first_well_known_[HttpUtil::kNumWellKnownHeaders];
+
   // The raw_headers_ consists of the normalized status line (terminated with a
   // null byte) and then followed by the raw null-terminated headers from the
   // input that was passed to our constructor.  We preserve the input [*] to
@@ -0,0 +1,238 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/perftimer.h"
+#include "base/time.h"
+#include "net/http/http_response_headers.h"
+#include "net/http/http_util.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumIterations = 20000;
+
+// Response header blocks along the lines of those sent by popular sites.
+const char* const kResponses[] = {
+  // A search results page.
+  "HTTP/1.1 200 OK\r\n"
+  "Date: Tue, 01 May 2012 18:00:00 GMT\r\n"
+  "Expires: -1\r\n"
+  "Cache-Control: private, max-age=0\r\n"
+  "Content-Type: text/html; charset=UTF-8\r\n"
+  "Set-Cookie: PREF=ID=0123456789abcdef:FF=0:TM=1335895200:LM=1335895200:"
+  "S=abcdefghijklmnop; expires=Thu, 01-May-2014 18:00:00 GMT; path=/; "
+  "domain=.example.com\r\n"
+  "Set-Cookie: NID=59=abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOP"
+  "QRSTUVWXYZ; expires=Wed, 31-Oct-2012 18:00:00 GMT; path=/; "
+  "domain=.example.com; HttpOnly\r\n"
+  "P3P: CP=\"This is not a P3P policy! See "
+  "http://www.example.com/support/accounts/bin/answer.py?answer=151657 "
+  "for more info.\"\r\n"
+  "Content-Encoding: gzip\r\n"
+  "Server: gws\r\n"
+  "Content-Length: 23142\r\n"
+  "X-XSS-Protection: 1; mode=block\r\n"
+  "X-Frame-Options: SAMEORIGIN\r\n"
+  "\r\n",
+  // A static asset served by a CDN.
+  "HTTP/1.1 200 OK\r\n"
+  "Accept-Ranges: bytes\r\n"
+  "Content-Type: application/javascript\r\n"
+  "Last-Modified: Mon, 30 Apr 2012 09:12:44 GMT\r\n"
+  "ETag: \"4f9e56ac-1a2b3\"\r\n"
+  "Cache-Control: public, max-age=31536000\r\n"
+  "Expires: Wed, 01 May 2013 18:00:00 GMT\r\n"
+  "Date: Tue, 01 May 2012 18:00:00 GMT\r\n"
+  "Age: 86213\r\n"
+  "Content-Length: 107187\r\n"
+  "Connection: keep-alive\r\n"
+  "Vary: Accept-Encoding\r\n"
+  "X-Cache: HIT from cache-lhr6321-LHR\r\n"
+  "X-Cache-Hits: 1937\r\n"
+  "Access-Control-Allow-Origin: *\r\n"
+  "Timing-Allow-Origin: *\r\n"
+  "Via: 1.1 varnish\r\n"
+  "\r\n",
+  // A social site that sets many cookies.
+  "HTTP/1.1 200 OK\r\n"
+  "Cache-Control: private, no-cache, no-store, must-revalidate\r\n"
+  "Expires: Sat, 01 Jan 2000 00:00:00 GMT\r\n"
+  "Pragma: no-cache\r\n"
+  "Strict-Transport-Security: max-age=2592000\r\n"
+  "Content-Type: text/html; charset=utf-8\r\n"
+  "X-Content-Type-Options: nosniff\r\n"
+  "X-Frame-Options: DENY\r\n"
+  "X-XSS-Protection: 0\r\n"
+  "Set-Cookie: datr=abcdefghijklmnopqrstuvwx; expires=Thu, 01-May-2014 "
+  "18:00:00 GMT; path=/; domain=.example.com; httponly\r\n"
+  "Set-Cookie: lu=RAabcdefghijklmnopqrstuvwx; expires=Thu, 01-May-2014 "
+  "18:00:00 GMT; path=/; domain=.example.com; httponly\r\n"
+  "Set-Cookie: reg_fb_gate=deleted; expires=Thu, 01-Jan-1970 00:00:01 GMT; "
+  "path=/; domain=.example.com; httponly\r\n"
+  "Set-Cookie: reg_fb_ref=deleted; expires=Thu, 01-Jan-1970 00:00:01 GMT; "
+  "path=/; domain=.example.com; httponly\r\n"
+  "Set-Cookie: wd=deleted; expires=Thu, 01-Jan-1970 00:00:01 GMT; path=/; "
+  "domain=.example.com; httponly\r\n"
+  "Set-Cookie: highContrast=deleted; expires=Thu, 01-Jan-1970 00:00:01 GMT; "
+  "path=/; domain=.example.com; httponly\r\n"
+  "X-FB-Debug: aBcDeFgHiJkLmNoPqRsTuVwXyZ0123456789abcdefg=\r\n"
+  "Date: Tue, 01 May 2012 18:00:00 GMT\r\n"
+  "Connection: keep-alive\r\n"
+  "Content-Length: 31864\r\n"
+  "\r\n",
+  // A revalidated resource.
+  "HTTP/1.1 304 Not Modified\r\n"
+  "Date: Tue, 01 May 2012 18:00:00 GMT\r\n"
+  "Server: Apache/2.2.22 (Unix) mod_ssl/2.2.22 OpenSSL/0.9.8e-fips-rhel5\r\n"
+  "Connection: Keep-Alive\r\n"
+  "Keep-Alive: timeout=5, max=100\r\n"
+  "ETag: \"2c0b7-5e3-4be3cbfa3a200\"\r\n"
+  "Expires: Tue, 08 May 2012 18:00:00 GMT\r\n"
+  "Cache-Control: max-age=604800\r\n"
+  "Vary: Accept-Encoding,User-Agent\r\n"
+  "\r\n",
+  // A redirect.
+  "HTTP/1.1 301 Moved Permanently\r\n"
+  "Server: nginx/1.0.15\r\n"
+  "Date: Tue, 01 May 2012 18:00:00 GMT\r\n"
+  "Content-Type: text/html\r\n"
+  "Content-Length: 185\r\n"
+  "Connection: keep-alive\r\n"
+  "Location: http://www.example.com/\r\n"
+  "\r\n",
+};
+
+// The lookups HttpCache, URLRequestHttpJob and friends make of every
+// response, which mostly miss.
+const char* const kNormalizedHeaderNames[] = {
+  "cache-control",
+  "content-type",
+  "content-encoding",
+  "content-length",
+  "transfer-encoding",
+  "connection",
+  "proxy-connection",
+  "vary",
+  "pragma",
+  "x-custom-header",
+};
+
+const char* const kAbsentHeaderNames[] = {
+  "content-range",
+  "strict-transport-security",
+  "public-key-pins",
+  "x-webkit-csp",
+  "x-chrome-variations",
+};
+
+class HttpResponseHeadersPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    for (size_t i = 0; i < arraysize(kResponses); ++i) {
+      std::string response(kResponses[i]);
+      raw_headers_.push_back(HttpUtil::AssembleRawHeaders(
+          response.data(), response.size()));
+      headers_.push_back(new HttpResponseHeaders(raw_headers_.back()));
+    }
+  }
+
+  // Logs the average cost of one call to |op| for each of kResponses.
+  template <typename Op>
+  void TimeOps(const char* name, const char* units, Op op) {
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumIterations; ++i) {
+      for (size_t j = 0; j < arraysize(kResponses); ++j)
+        op(j);
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    LogPerfResult(name,
+                  elapsed.InMicroseconds() * 1000.0 /
+                      (kNumIterations * arraysize(kResponses)),
+                  units);
+  }
+
+  std::vector<std::string> raw_headers_;
+  std::vector<scoped_refptr<HttpResponseHeaders> > headers_;
+};
+
+struct Construct {
+  explicit Construct(const std::vector<std::string>* raw_headers)
+      : raw_headers_(raw_headers) {}
+  void operator()(size_t i) {
+    scoped_refptr<HttpResponseHeaders> headers(
+        new HttpResponseHeaders((*raw_headers_)[i]));
+  }
+  const std::vector<std::string>* raw_headers_;
+};
+
+struct IterateHeaders {
+  void operator()(size_t i) {
+    std::string response(kResponses[i]);
+    HttpUtil::HeadersIterator it(response.begin(), response.end(), "\r\n");
+    while (it.GetNext()) {}
+  }
+};
+
+struct GetNormalizedHeaders {
+  explicit GetNormalizedHeaders(
+      const std::vector<scoped_refptr<HttpResponseHeaders> >* headers)
+      : headers_(headers) {}
+  void operator()(size_t i) {
+    std::string value;
+    for (size_t j = 0; j < arraysize(kNormalizedHeaderNames); ++j)
+      (*headers_)[i]->GetNormalizedHeader(kNormalizedHeaderNames[j], &value);
+  }
+  const std::vector<scoped_refptr<HttpResponseHeaders> >* headers_;
+};
+
+struct EnumerateHeaders {
+  explicit EnumerateHeaders(
+      const std::vector<scoped_refptr<HttpResponseHeaders> >* headers)
+      : headers_(headers) {}
+  void operator()(size_t i) {
+    std::string value;
+    void* iter = NULL;
+    while ((*headers_)[i]->EnumerateHeader(&iter, "cache-control", &value)) {}
+    iter = NULL;
+    while ((*headers_)[i]->EnumerateHeader(&iter, "set-cookie", &value)) {}
+  }
+  const std::vector<scoped_refptr<HttpResponseHeaders> >* headers_;
+};
+
+struct HasAbsentHeaders {
+  explicit HasAbsentHeaders(
+      const std::vector<scoped_refptr<HttpResponseHeaders> >* headers)
+      : headers_(headers) {}
+  void operator()(size_t i) {
+    for (size_t j = 0; j < arraysize(kAbsentHeaderNames); ++j)
+      (*headers_)[i]->HasHeader(kAbsentHeaderNames[j]);
+  }
+  const std::vector<scoped_refptr<HttpResponseHeaders> >* headers_;
+};
+
+}  // namespace
+
+TEST_F(HttpResponseHeadersPerfTest, Parse) {
+  TimeOps("HttpResponseHeaders_Construct", "ns/response",
+          Construct(&raw_headers_));
+  TimeOps("HttpUtil_HeadersIterator", "ns/response", IterateHeaders());
+}
+
+TEST_F(HttpResponseHeadersPerfTest, Lookups) {
+  TimeOps("HttpResponseHeaders_GetNormalizedHeader", "ns/response",
+          GetNormalizedHeaders(&headers_));
+  TimeOps("HttpResponseHeaders_EnumerateHeader", "ns/response",
+          EnumerateHeaders(&headers_));
+  TimeOps("HttpResponseHeaders_HasHeader", "ns/response",
+          HasAbsentHeaders(&headers_));
+}
+
+}  // namespace net
@@ -507,6 +507,40 @@ TEST(HttpResponseHeadersTest, EnumerateHeader_Coalesced) {
   EXPECT_FALSE(parsed->EnumerateHeader(&iter, "cache-control", &value));
 }
 
+TEST(HttpResponseHeadersTest, EnumerateHeader_Interleaved) {
+  // Well-known and other headers, repeated and out of order.
+  std::string headers =
+      "HTTP/1.1 200 OK\n"
+      "Vary: Accept-Encoding\n"
+      "X-Custom: a\n"
+      "Set-Cookie: x=1; path=/\n"
+      "x-custom: b, c\n"
+      "VARY: Cookie\n"
+      "set-cookie: y=2\n";
+  HeadersToRaw(&headers);
+  scoped_refptr<net::HttpResponseHeaders> parsed(
+      new net::HttpResponseHeaders(headers));
+
+  std::string value;
+  EXPECT_TRUE(parsed->GetNormalizedHeader("vary", &value));
+  EXPECT_EQ("Accept-Encoding, Cookie", value);
+  EXPECT_TRUE(parsed->GetNormalizedHeader("X-CUSTOM", &value));
+  EXPECT_EQ("a, b, c", value);
+  EXPECT_FALSE(parsed->GetNormalizedHeader("age", &value));
+  EXPECT_FALSE(parsed->GetNormalizedHeader("x-other", &value));
+
+  void* iter = NULL;
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "Set-Cookie", &value));
+  EXPECT_EQ("x=1; path=/", value);
+  EXPECT_TRUE(parsed->EnumerateHeader(&iter, "Set-Cookie", &value));
+  EXPECT_EQ("y=2", value);
+  EXPECT_FALSE(parsed->EnumerateHeader(&iter, "Set-Cookie", &value));
+
+  parsed->RemoveHeader("vary");
+  EXPECT_FALSE(parsed->HasHeader("Vary"));
+  EXPECT_TRUE(parsed->HasHeader("set-cookie"));
+}
+
 TEST(HttpResponseHeadersTest, EnumerateHeader_Challenge) {
   // Even though WWW-Authenticate has commas, it should not be treated as
   // coalesced values.
@@ -840,6 +874,81 @@ TEST(HttpResponseHeadersTest, RequiresValidation) {
   }
 }
 
+TEST(HttpResponseHeadersTest, IsStaleWhileRevalidateAllowed) {
+  const struct {
+    const char* headers;
+    bool allowed;
+  } tests[] = {
+    // no stale-while-revalidate
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "cache-control: max-age=100\n"
+      "\n",
+      false
+    },
+    // stale, but within the stale-while-revalidate window
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "cache-control: max-age=100, stale-while-revalidate=300\n"
+      "\n",
+      true
+    },
+    // stale for too long
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "cache-control: max-age=100, stale-while-revalidate=100\n"
+      "\n",
+      false
+    },
+    // never fresh, but may be revalidated in the background
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "cache-control: max-age=0\n"
+      "cache-control: stale-while-revalidate=1000\n"
+      "\n",
+      true
+    },
+    // expired already
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "expires: Wed, 28 Nov 2007 00:00:00 GMT\n"
+      "cache-control: stale-while-revalidate=1000\n"
+      "\n",
+      true
+    },
+    // must-revalidate overrides stale-while-revalidate
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "cache-control: max-age=100, stale-while-revalidate=1000\n"
+      "cache-control: must-revalidate\n"
+      "\n",
+      false
+    },
+    // no-cache overrides stale-while-revalidate
+    { "HTTP/1.1 200 OK\n"
+      "date: Wed, 28 Nov 2007 00:40:11 GMT\n"
+      "cache-control: no-cache, stale-while-revalidate=1000\n"
+      "\n",
+      false
+    },
+  };
+  base::Time request_time, response_time, current_time;
+  base::Time::FromString("Wed, 28 Nov 2007 00:40:09 GMT", &request_time);
+  base::Time::FromString("Wed, 28 Nov 2007 00:40:12 GMT", &response_time);
+  base::Time::FromString("Wed, 28 Nov 2007 00:45:20 GMT", &current_time);
+
+  for (size_t i = 0; i < ARRAYSIZE_UNSAFE(tests); ++i) {
+    std::string headers(tests[i].headers);
+    HeadersToRaw(&headers);
+    scoped_refptr<net::HttpResponseHeaders> parsed(
+        new net::HttpResponseHeaders(headers));
+
+    bool allowed = parsed->IsStaleWhileRevalidateAllowed(
+        request_time, response_time, current_time);
+    EXPECT_EQ(tests[i].allowed, allowed) << "Test case " << i;
+  }
+}
+
 TEST(HttpResponseHeadersTest, Update) {
   const struct {
     const char* orig_headers;
@@ -631,12 +631,22 @@ int HttpStreamParser::DoReadHeadersComplete(int result) {
 int HttpStreamParser::DoReadBody() {
   io_state_ = STATE_READ_BODY_COMPLETE;
 
+  // Don't take more than the rest of a body of known length, so that none of
+  // the next response, if any, lands in |user_read_buf_| and has to be copied
+  // back out of it.
+  int read_len = user_read_buf_len_;
+  if (!chunked_decoder_.get() && response_body_length_ >= 0) {
+    read_len = static_cast<int>(std::min<int64>(
+        read_len, std::max<int64>(
+            response_body_length_ - response_body_read_, 0)));
+  }
+
   // There may be some data left over from reading the response headers.
   if (read_buf_->offset()) {
     int available = read_buf_->offset() - read_buf_unused_offset_;
-    if (available) {
+    if (available && read_len) {
       CHECK_GT(available, 0);
-      int bytes_from_buffer = std::min(available, user_read_buf_len_);
+      int bytes_from_buffer = std::min(available, read_len);
       memcpy(user_read_buf_->data(),
              read_buf_->StartOfBuffer() + read_buf_unused_offset_,
              bytes_from_buffer);
@@ -646,7 +656,7 @@ int HttpStreamParser::DoReadBody() {
         read_buf_unused_offset_ = 0;
       }
       return bytes_from_buffer;
-    } else {
+    } else if (!available) {
       read_buf_->SetCapacity(0);
       read_buf_unused_offset_ = 0;
     }
@@ -656,9 +666,11 @@ int HttpStreamParser::DoReadBody() {
   if (IsResponseBodyComplete())
     return 0;
 
+  // The rest of the body goes straight from the socket into the caller's
+  // buffer. Chunked bodies are decoded there, in place, by
+  // DoReadBodyComplete().
   DCHECK_EQ(0, read_buf_->offset());
-  return connection_->socket()->Read(user_read_buf_, user_read_buf_len_,
-                                     io_callback_);
+  return connection_->socket()->Read(user_read_buf_, read_len, io_callback_);
 }
 
 int HttpStreamParser::DoReadBodyComplete(int result) {
@@ -0,0 +1,180 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/time.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/address_list.h"
+#include "net/base/io_buffer.h"
+#include "net/base/ip_endpoint.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/net_util.h"
+#include "net/base/test_completion_callback.h"
+#include "net/http/http_request_headers.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_response_info.h"
+#include "net/http/http_stream_parser.h"
+#include "net/socket/client_socket_handle.h"
+#include "net/socket/tcp_client_socket.h"
+#include "net/socket/tcp_server_socket.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kBodySize = 32 * 1024 * 1024;
+// The size of the buffers URLRequestHttpJob's consumers typically read into.
+const int kReadBufferSize = 32 * 1024;
+
+// Writes a canned response to a socket, as fast as the socket takes it.
+class ResponseWriter {
+ public:
+  ResponseWriter(StreamSocket* socket, const std::string& response)
+      : socket_(socket),
+        buffer_(new DrainableIOBuffer(new StringIOBuffer(response),
+                                      response.size())) {
+  }
+
+  void Start() {
+    int rv;
+    do {
+      rv = socket_->Write(
+          buffer_, buffer_->BytesRemaining(),
+          base::Bind(&ResponseWriter::OnWriteComplete,
+                     base::Unretained(this)));
+      if (rv > 0)
+        buffer_->DidConsume(rv);
+    } while (rv > 0 && buffer_->BytesRemaining() > 0);
+    ASSERT_TRUE(rv == ERR_IO_PENDING || rv > 0) << ErrorToString(rv);
+  }
+
+ private:
+  void OnWriteComplete(int result) {
+    ASSERT_GT(result, 0) << ErrorToString(result);
+    buffer_->DidConsume(result);
+    if (buffer_->BytesRemaining() > 0)
+      Start();
+  }
+
+  StreamSocket* const socket_;
+  scoped_refptr<DrainableIOBuffer> buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResponseWriter);
+};
+
+class HttpStreamParserPerfTest : public testing::Test {
+ public:
+  HttpStreamParserPerfTest()
+      : message_loop_(new MessageLoopForIO()),
+        server_socket_(NULL, NetLog::Source()) {
+  }
+
+ protected:
+  // Sends |response| over a loopback TCP connection, and logs the rate at
+  // which an HttpStreamParser reads its body, which has to be kBodySize
+  // bytes long.
+  void ReadResponse(const std::string& name, const std::string& response) {
+    IPAddressNumber loopback;
+    ASSERT_TRUE(ParseIPLiteralToNumber("127.0.0.1", &loopback));
+    ASSERT_EQ(OK, server_socket_.Listen(IPEndPoint(loopback, 0), 1));
+    IPEndPoint server_address;
+    ASSERT_EQ(OK, server_socket_.GetLocalAddress(&server_address));
+
+    TestCompletionCallback accept_callback;
+    scoped_ptr<StreamSocket> accepted_socket;
+    int accept_rv = server_socket_.Accept(&accepted_socket,
+                                          accept_callback.callback());
+    TestCompletionCallback connect_callback;
+    scoped_ptr<TCPClientSocket> client_socket(new TCPClientSocket(
+        AddressList::CreateFromIPAddress(loopback, server_address.port()),
+        NULL, NetLog::Source()));
+    ASSERT_EQ(OK, connect_callback.GetResult(
+        client_socket->Connect(connect_callback.callback())));
+    ASSERT_EQ(OK, accept_callback.GetResult(accept_rv));
+
+    ClientSocketHandle connection;
+    connection.set_socket(client_socket.release());
+    HttpRequestInfo request;
+    request.method = "GET";
+    request.url = GURL("http://127.0.0.1/");
+    scoped_refptr<GrowableIOBuffer> read_buffer(new GrowableIOBuffer);
+    HttpStreamParser parser(&connection, &request, read_buffer,
+                            BoundNetLog());
+    HttpResponseInfo response_info;
+    TestCompletionCallback callback;
+    ASSERT_EQ(OK, callback.GetResult(parser.SendRequest(
+        "GET / HTTP/1.1\r\n", HttpRequestHeaders(), NULL, &response_info,
+        callback.callback())));
+
+    ResponseWriter writer(accepted_socket.get(), response);
+    writer.Start();
+
+    base::TimeTicks start = base::TimeTicks::Now();
+    ASSERT_EQ(OK, callback.GetResult(
+        parser.ReadResponseHeaders(callback.callback())));
+    scoped_refptr<IOBuffer> buf(new IOBuffer(kReadBufferSize));
+    int64 body_read = 0;
+    int rv;
+    do {
+      rv = callback.GetResult(parser.ReadResponseBody(
+          buf, kReadBufferSize, callback.callback()));
+      if (rv > 0)
+        body_read += rv;
+    } while (rv > 0);
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    EXPECT_EQ(OK, rv);
+    EXPECT_EQ(kBodySize, body_read);
+    EXPECT_TRUE(parser.IsResponseBodyComplete());
+    LogPerfResult((name + "_Throughput").c_str(),
+                  body_read / elapsed.InSecondsF() / (1024 * 1024), "MB/s");
+  }
+
+  // Returns a response whose kBodySize bytes are sent in chunks of
+  // |chunk_size| bytes.
+  static std::string ChunkedResponse(int chunk_size) {
+    std::string response = "HTTP/1.1 200 OK\r\n"
+                           "Transfer-Encoding: chunked\r\n\r\n";
+    std::string chunk = base::StringPrintf("%X\r\n", chunk_size) +
+                        std::string(chunk_size, 'x') + "\r\n";
+    for (int i = 0; i < kBodySize / chunk_size; ++i)
+      response.append(chunk);
+    response.append("0\r\n\r\n");
+    return response;
+  }
+
+ private:
+  scoped_ptr<MessageLoop> message_loop_;
+  TCPServerSocket server_socket_;
+};
+
+}  // namespace
+
+TEST_F(HttpStreamParserPerfTest, ContentLength) {
+  std::string response = base::StringPrintf(
+      "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", kBodySize);
+  response.append(kBodySize, 'x');
+  ReadResponse("HttpStreamParser_ContentLength", response);
+}
+
+TEST_F(HttpStreamParserPerfTest, Chunked) {
+  ReadResponse("HttpStreamParser_Chunked16K", ChunkedResponse(16 * 1024));
+}
+
+// Many chunk markers per read, as sent by servers that flush often.
+TEST_F(HttpStreamParserPerfTest, SmallChunks) {
+  ReadResponse("HttpStreamParser_Chunked256", ChunkedResponse(256));
+}
+
+}  // namespace net
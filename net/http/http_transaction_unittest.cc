@@ -255,6 +255,13 @@ int MockNetworkTransaction::Start(const net::HttpRequestInfo* request,
   data_ = resp_data;
   test_mode_ = t->test_mode;
 
+  if (transaction_factory_.get() && transaction_factory_->block_start()) {
+    transaction_factory_->AddBlockedStart(
+        base::Bind(&MockNetworkTransaction::RunCallback,
+                   weak_factory_.GetWeakPtr(), callback, net::OK));
+    return net::ERR_IO_PENDING;
+  }
+
   if (test_mode_ & TEST_MODE_SYNC_NET_START)
     return net::OK;
 
@@ -332,7 +339,9 @@ void MockNetworkTransaction::RunCallback(
 }
 
 MockNetworkLayer::MockNetworkLayer()
-    : transaction_count_(0), done_reading_called_(false) {}
+    : transaction_count_(0),
+      done_reading_called_(false),
+      block_start_(false) {}
 
 MockNetworkLayer::~MockNetworkLayer() {}
 
@@ -340,6 +349,18 @@ void MockNetworkLayer::TransactionDoneReading() {
   done_reading_called_ = true;
 }
 
+void MockNetworkLayer::AddBlockedStart(const base::Closure& resume) {
+  blocked_starts_.push_back(resume);
+}
+
+void MockNetworkLayer::ResumeBlockedStarts() {
+  block_start_ = false;
+  std::vector<base::Closure> blocked;
+  blocked.swap(blocked_starts_);
+  for (size_t i = 0; i < blocked.size(); ++i)
+    MessageLoop::current()->PostTask(FROM_HERE, blocked[i]);
+}
+
 int MockNetworkLayer::CreateTransaction(
     scoped_ptr<net::HttpTransaction>* trans) {
   transaction_count_++;
@@ -9,6 +9,7 @@
 #include "net/http/http_transaction.h"
 
 #include <string>
+#include <vector>
 
 #include "base/callback.h"
 #include "base/compiler_specific.h"
@@ -209,6 +210,13 @@ class MockNetworkLayer : public net::HttpTransactionFactory,
   bool done_reading_called() const { return done_reading_called_; }
   void TransactionDoneReading();
 
+  // While set, new transactions do not complete Start() until
+  // ResumeBlockedStarts() is called.
+  void set_block_start(bool block) { block_start_ = block; }
+  bool block_start() const { return block_start_; }
+  void AddBlockedStart(const base::Closure& resume);
+  void ResumeBlockedStarts();
+
   // net::HttpTransactionFactory:
   virtual int CreateTransaction(
       scoped_ptr<net::HttpTransaction>* trans) OVERRIDE;
@@ -218,6 +226,8 @@ class MockNetworkLayer : public net::HttpTransactionFactory,
  private:
   int transaction_count_;
   bool done_reading_called_;
+  bool block_start_;
+  std::vector<base::Closure> blocked_starts_;
 };
 
 //-----------------------------------------------------------------------------
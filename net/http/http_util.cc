@@ -9,7 +9,12 @@
 
 #include <algorithm>
 
+#if __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
 #include "base/basictypes.h"
+#include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/stringprintf.h"
 #include "base/string_number_conversions.h"
@@ -20,6 +25,187 @@ using std::string;
 
 namespace net {
 
+namespace {
+
+struct WellKnownHeader {
+  const char* name;
+  bool is_non_coalescing;
+};
+
+// The header names most often found in requests and responses. Only their
+// order is significant, as they are numbered by it.
+const WellKnownHeader kWellKnownHeaders[] = {
+  { "accept", false },
+  { "accept-charset", false },
+  { "accept-encoding", false },
+  { "accept-language", false },
+  { "accept-ranges", false },
+  { "access-control-allow-origin", false },
+  { "age", false },
+  { "allow", false },
+  { "alternate-protocol", false },
+  { "authorization", false },
+  { "cache-control", false },
+  { "connection", false },
+  { "content-disposition", false },
+  { "content-encoding", false },
+  { "content-language", false },
+  { "content-length", false },
+  { "content-location", false },
+  { "content-md5", false },
+  { "content-range", false },
+  { "content-security-policy", false },
+  { "content-type", false },
+  { "cookie", false },
+  { "date", true },
+  { "etag", false },
+  { "expires", true },
+  { "host", false },
+  { "if-modified-since", false },
+  { "if-none-match", false },
+  { "if-range", false },
+  { "keep-alive", false },
+  { "last-modified", true },
+  { "link", false },
+  // See bug 1050541 for details.
+  { "location", true },
+  { "p3p", false },
+  { "pragma", false },
+  // The format of auth-challenges mixes both space separated tokens and
+  // comma separated properties, so coalescing on comma won't work.
+  { "proxy-authenticate", true },
+  { "proxy-authorization", false },
+  { "proxy-connection", false },
+  { "public-key-pins", false },
+  { "range", false },
+  { "referer", false },
+  { "refresh", false },
+  { "retry-after", true },
+  { "server", false },
+  { "set-cookie", true },
+  // NOTE: "set-cookie2" headers do not support expires attributes, so they
+  // can be coalesced.
+  { "set-cookie2", false },
+  { "status", false },
+  { "strict-transport-security", false },
+  { "trailer", false },
+  { "transfer-encoding", false },
+  { "upgrade", false },
+  { "user-agent", false },
+  { "vary", false },
+  { "version", false },
+  { "via", false },
+  { "warning", false },
+  { "www-authenticate", true },
+  { "x-cache", false },
+  { "x-content-type-options", false },
+  { "x-frame-options", false },
+  { "x-powered-by", false },
+  { "x-xss-protection", false },
+};
+
+COMPILE_ASSERT(arraysize(kWellKnownHeaders) == HttpUtil::kNumWellKnownHeaders,
+               well_known_headers_mismatch);
+
+// A hash of a non-empty header name that doesn't depend on its case.  It
+// looks at only a few characters, which tell the well-known names apart well
+// enough, so that hashing costs less than comparing names would.
+uint32 HashHeaderName(std::string::const_iterator name_begin,
+                      std::string::const_iterator name_end) {
+  size_t length = name_end - name_begin;
+  uint32 hash = length;
+  hash = hash * 31 + (name_begin[0] | 0x20);
+  hash = hash * 31 + (name_begin[length / 2] | 0x20);
+  hash = hash * 31 + (name_end[-1] | 0x20);
+  return hash;
+}
+
+// An open-addressed hash table of kWellKnownHeaders.
+class WellKnownHeaderTable {
+ public:
+  WellKnownHeaderTable() : max_length_(0) {
+    memset(slots_, 0, sizeof(slots_));
+    for (int id = 0; id < HttpUtil::kNumWellKnownHeaders; ++id) {
+      std::string name(kWellKnownHeaders[id].name);
+      lengths_[id] = name.size();
+      max_length_ = std::max(max_length_, name.size());
+      size_t slot = HashHeaderName(name.begin(), name.end()) & kSlotMask;
+      while (slots_[slot])
+        slot = (slot + 1) & kSlotMask;
+      slots_[slot] = id + 1;
+    }
+  }
+
+  int Find(std::string::const_iterator name_begin,
+           std::string::const_iterator name_end) const {
+    size_t length = name_end - name_begin;
+    if (length == 0 || length > max_length_)
+      return -1;
+    for (size_t slot = HashHeaderName(name_begin, name_end) & kSlotMask;
+         slots_[slot]; slot = (slot + 1) & kSlotMask) {
+      int id = slots_[slot] - 1;
+      if (lengths_[id] == length &&
+          LowerCaseEqualsASCII(name_begin, name_end,
+                               kWellKnownHeaders[id].name)) {
+        return id;
+      }
+    }
+    return -1;
+  }
+
+ private:
+  // Four times as many slots as headers keeps the probe sequences short.
+  static const size_t kSlotMask = 255;
+  COMPILE_ASSERT(HttpUtil::kNumWellKnownHeaders * 4 <= kSlotMask + 1,
+                 too_many_well_known_headers);
+
+  // The id of the header in each slot, plus one. Zero for empty slots.
+  uint8 slots_[kSlotMask + 1];
+  size_t lengths_[HttpUtil::kNumWellKnownHeaders];
+  size_t max_length_;
+
+  DISALLOW_COPY_AND_ASSIGN(WellKnownHeaderTable);
+};
+
+base::LazyInstance<WellKnownHeaderTable>::Leaky g_well_known_headers =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Returns the first character of [begin, end) that is one of |chars|, or
+// |end|. Header blocks are mostly long runs of characters that are none of
+// the line delimiters or ':' searched for, so where SSE2 is available they
+// are checked 16 at a time.
+const char* FindFirstOf(const char* begin,
+                        const char* end,
+                        const base::StringPiece& chars) {
+  DCHECK(!chars.empty());
+#if __SSE2__
+  if (chars.size() <= 4) {
+    __m128i wanted[4];
+    for (size_t i = 0; i < arraysize(wanted); ++i)
+      wanted[i] = _mm_set1_epi8(chars[std::min(i, chars.size() - 1)]);
+    for (; end - begin >= 16; begin += 16) {
+      __m128i bytes =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+      __m128i matches = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, wanted[0]),
+                       _mm_cmpeq_epi8(bytes, wanted[1])),
+          _mm_or_si128(_mm_cmpeq_epi8(bytes, wanted[2]),
+                       _mm_cmpeq_epi8(bytes, wanted[3])));
+      int mask = _mm_movemask_epi8(matches);
+      if (mask)
+        return begin + __builtin_ctz(mask);
+    }
+  }
+#endif  // __SSE2__
+  for (; begin != end; ++begin) {
+    if (chars.find(*begin) != base::StringPiece::npos)
+      break;
+  }
+  return begin;
+}
+
+}  // namespace
+
 //-----------------------------------------------------------------------------
 
 // Return the index of the closing quote of the string, if any.
@@ -377,25 +563,19 @@ std::string HttpUtil::StripHeaders(const std::string& headers,
 // static
 bool HttpUtil::IsNonCoalescingHeader(string::const_iterator name_begin,
                                      string::const_iterator name_end) {
-  // NOTE: "set-cookie2" headers do not support expires attributes, so we don't
-  // have to list them here.
-  const char* kNonCoalescingHeaders[] = {
-    "date",
-    "expires",
-    "last-modified",
-    "location",  // See bug 1050541 for details
-    "retry-after",
-    "set-cookie",
-    // The format of auth-challenges mixes both space separated tokens and
-    // comma separated properties, so coalescing on comma won't work.
-    "www-authenticate",
-    "proxy-authenticate"
-  };
-  for (size_t i = 0; i < arraysize(kNonCoalescingHeaders); ++i) {
-    if (LowerCaseEqualsASCII(name_begin, name_end, kNonCoalescingHeaders[i]))
-      return true;
-  }
-  return false;
+  return IsNonCoalescingHeaderId(GetWellKnownHeaderId(name_begin, name_end));
+}
+
+// static
+int HttpUtil::GetWellKnownHeaderId(string::const_iterator name_begin,
+                                   string::const_iterator name_end) {
+  return g_well_known_headers.Get().Find(name_begin, name_end);
+}
+
+// static
+bool HttpUtil::IsNonCoalescingHeaderId(int id) {
+  DCHECK_LT(id, kNumWellKnownHeaders);
+  return id >= 0 && kWellKnownHeaders[id].is_non_coalescing;
 }
 
 bool HttpUtil::IsLWS(char c) {
@@ -710,22 +890,45 @@ void HttpUtil::AppendHeaderIfMissing(const char* header_name,
 HttpUtil::HeadersIterator::HeadersIterator(string::const_iterator headers_begin,
                                            string::const_iterator headers_end,
                                            const std::string& line_delimiter)
-    : lines_(headers_begin, headers_end, line_delimiter) {
+    : headers_begin_(headers_begin),
+      headers_end_(headers_end),
+      delimiters_and_colon_(line_delimiter + ':'),
+      position_(headers_begin) {
 }
 
 HttpUtil::HeadersIterator::~HeadersIterator() {
 }
 
 bool HttpUtil::HeadersIterator::GetNext() {
-  while (lines_.GetNext()) {
-    name_begin_ = lines_.token_begin();
-    values_end_ = lines_.token_end();
+  const base::StringPiece delimiters(delimiters_and_colon_.data(),
+                                     delimiters_and_colon_.size() - 1);
+  while (position_ != headers_end_) {
+    // Skip the end of the previous line, and any empty lines.
+    if (delimiters.find(*position_) != base::StringPiece::npos) {
+      ++position_;
+      continue;
+    }
+
+    // Find the end of the line, and its first colon on the way there.
+    const char* line_begin = &*position_;
+    const char* end = line_begin + (headers_end_ - position_);
+    const char* line_end = FindFirstOf(line_begin, end, delimiters_and_colon_);
+    const char* colon = NULL;
+    if (line_end != end && *line_end == ':' &&
+        delimiters.find(':') == base::StringPiece::npos) {
+      colon = line_end;
+      line_end = FindFirstOf(colon + 1, end, delimiters);
+    }
+
+    name_begin_ = position_;
+    values_end_ = position_ + (line_end - line_begin);
+    position_ = values_end_;
 
-    string::const_iterator colon = std::find(name_begin_, values_end_, ':');
-    if (colon == values_end_)
+    if (!colon)
       continue;  // skip malformed header
 
-    name_end_ = colon;
+    string::const_iterator colon_it = name_begin_ + (colon - line_begin);
+    name_end_ = colon_it;
 
     // If the name starts with LWS, it is an invalid line.
     // Leading LWS implies a line continuation, and these should have
@@ -737,7 +940,7 @@ bool HttpUtil::HeadersIterator::GetNext() {
     if (name_begin_ == name_end_)
       continue;  // skip malformed header
 
-    values_begin_ = colon + 1;
+    values_begin_ = colon_it + 1;
     TrimLWS(&values_begin_, &values_end_);
 
     // if we got a header name, then we are done.
@@ -92,6 +92,23 @@ class NET_EXPORT HttpUtil {
     return IsNonCoalescingHeader(name.begin(), name.end());
   }
 
+  // The number of header names known to GetWellKnownHeaderId().
+  enum { kNumWellKnownHeaders = 62 };
+
+  // Returns a number in [0, kNumWellKnownHeaders) that stands for the header
+  // named [name_begin, name_end) if it is a common one, and -1 otherwise.
+  // Names are compared case insensitively, so that once interned, they can be
+  // compared as ints.
+  static int GetWellKnownHeaderId(std::string::const_iterator name_begin,
+                                  std::string::const_iterator name_end);
+  static int GetWellKnownHeaderId(const std::string& name) {
+    return GetWellKnownHeaderId(name.begin(), name.end());
+  }
+
+  // Like IsNonCoalescingHeader(), for the header identified by |id|, as
+  // returned by GetWellKnownHeaderId().
+  static bool IsNonCoalescingHeaderId(int id);
+
   // Return true if the character is HTTP "linear white space" (SP | HT).
   // This definition corresponds with the HTTP_LWS macro, and does not match
   // newlines.
@@ -212,7 +229,7 @@ class NET_EXPORT HttpUtil {
     bool AdvanceTo(const char* lowercase_name);
 
     void Reset() {
-      lines_.Reset();
+      position_ = headers_begin_;
     }
 
     std::string::const_iterator name_begin() const {
@@ -236,7 +253,12 @@ class NET_EXPORT HttpUtil {
     }
 
    private:
-    StringTokenizer lines_;
+    std::string::const_iterator headers_begin_;
+    std::string::const_iterator headers_end_;
+    // The characters that end lines, followed by ':'.
+    std::string delimiters_and_colon_;
+    // Where the next line is looked for.
+    std::string::const_iterator position_;
     std::string::const_iterator name_begin_;
     std::string::const_iterator name_end_;
     std::string::const_iterator values_begin_;
@@ -197,6 +197,49 @@ TEST(HttpUtilTest, HeadersIterator_Reset) {
   EXPECT_TRUE(it.AdvanceTo("foo"));
 }
 
+TEST(HttpUtilTest, HeadersIterator_LongLines) {
+  // Long enough for the line scanner to look at several characters at once,
+  // with the delimiters and colons at every offset.
+  std::string headers;
+  std::string value;
+  for (int i = 0; i < 40; ++i) {
+    headers.append(std::string(i + 1, 'n') + ":" + value + '\0');
+    value.append(i % 7 ? "v" : "v:");
+  }
+
+  HttpUtil::HeadersIterator it(headers.begin(), headers.end(),
+                               std::string(1, '\0'));
+  value.clear();
+  for (int i = 0; i < 40; ++i) {
+    ASSERT_TRUE(it.GetNext());
+    EXPECT_EQ(std::string(i + 1, 'n'), it.name());
+    EXPECT_EQ(value, it.values());
+    value.append(i % 7 ? "v" : "v:");
+  }
+  EXPECT_FALSE(it.GetNext());
+}
+
+TEST(HttpUtilTest, GetWellKnownHeaderId) {
+  int id = HttpUtil::GetWellKnownHeaderId("content-type");
+  ASSERT_GE(id, 0);
+  EXPECT_LT(id, HttpUtil::kNumWellKnownHeaders);
+  EXPECT_EQ(id, HttpUtil::GetWellKnownHeaderId("Content-Type"));
+  EXPECT_EQ(id, HttpUtil::GetWellKnownHeaderId("CONTENT-TYPE"));
+  EXPECT_NE(id, HttpUtil::GetWellKnownHeaderId("content-length"));
+
+  EXPECT_EQ(-1, HttpUtil::GetWellKnownHeaderId(""));
+  EXPECT_EQ(-1, HttpUtil::GetWellKnownHeaderId("content-typ"));
+  EXPECT_EQ(-1, HttpUtil::GetWellKnownHeaderId("content-type "));
+  EXPECT_EQ(-1, HttpUtil::GetWellKnownHeaderId("x-custom-header"));
+  EXPECT_EQ(-1, HttpUtil::GetWellKnownHeaderId(std::string(100, 'x')));
+
+  EXPECT_TRUE(HttpUtil::IsNonCoalescingHeaderId(
+      HttpUtil::GetWellKnownHeaderId("Set-Cookie")));
+  EXPECT_FALSE(HttpUtil::IsNonCoalescingHeaderId(
+      HttpUtil::GetWellKnownHeaderId("Set-Cookie2")));
+  EXPECT_FALSE(HttpUtil::IsNonCoalescingHeaderId(-1));
+}
+
 TEST(HttpUtilTest, ValuesIterator) {
   std::string values = " must-revalidate,   no-cache=\"foo, bar\"\t, private ";
 
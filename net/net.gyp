@@ -331,6 +331,8 @@
         'disk_cache/mapped_file_win.cc',
         'disk_cache/mem_backend_impl.cc',
         'disk_cache/mem_backend_impl.h',
+        'disk_cache/mem_chunks.cc',
+        'disk_cache/mem_chunks.h',
         'disk_cache/mem_entry_impl.cc',
         'disk_cache/mem_entry_impl.h',
         'disk_cache/mem_rankings.cc',
@@ -339,6 +341,18 @@
         'disk_cache/net_log_parameters.h',
         'disk_cache/rankings.cc',
         'disk_cache/rankings.h',
+        'disk_cache/sharded_backend.cc',
+        'disk_cache/sharded_backend.h',
+        'disk_cache/simple/simple_backend_impl.cc',
+        'disk_cache/simple/simple_backend_impl.h',
+        'disk_cache/simple/simple_entry_format.cc',
+        'disk_cache/simple/simple_entry_format.h',
+        'disk_cache/simple/simple_entry_impl.cc',
+        'disk_cache/simple/simple_entry_impl.h',
+        'disk_cache/simple/simple_index.cc',
+        'disk_cache/simple/simple_index.h',
+        'disk_cache/simple/simple_synchronous_entry.cc',
+        'disk_cache/simple/simple_synchronous_entry.h',
         'disk_cache/sparse_control.cc',
         'disk_cache/sparse_control.h',
         'disk_cache/stats.cc',
@@ -1109,6 +1123,8 @@
         'disk_cache/cache_util_unittest.cc',
         'disk_cache/entry_unittest.cc',
         'disk_cache/mapped_file_unittest.cc',
+        'disk_cache/mem_chunks_unittest.cc',
+        'disk_cache/sharded_backend_unittest.cc',
         'disk_cache/storage_block_unittest.cc',
         'dns/dns_config_service_posix_unittest.cc',
         'dns/dns_config_service_unittest.cc',
@@ -1116,6 +1132,7 @@
         'dns/dns_hosts_unittest.cc',
         'dns/dns_query_unittest.cc',
         'dns/dns_response_unittest.cc',
+        'dns/dns_session_unittest.cc',
         'dns/dns_transaction_unittest.cc',
         'dns/file_path_watcher_wrapper_unittest.cc',
         'dns/serial_worker_unittest.cc',
@@ -1245,6 +1262,11 @@
         'spdy/spdy_websocket_test_util_spdy3.cc',
         'spdy/spdy_websocket_test_util_spdy3.h',
         'test/python_utils_unittest.cc',
+        'tools/cache_replay/cache_replayer.cc',
+        'tools/cache_replay/cache_replayer.h',
+        'tools/cache_replay/cache_replayer_unittest.cc',
+        'tools/cache_replay/replay_log.cc',
+        'tools/cache_replay/replay_log.h',
         'tools/dump_cache/url_to_filename_encoder.cc',
         'tools/dump_cache/url_to_filename_encoder.h',
         'tools/dump_cache/url_to_filename_encoder_unittest.cc',
@@ -1450,9 +1472,19 @@
         '../testing/gtest.gyp:gtest',
       ],
       'sources': [
+        'base/host_resolver_perftest.cc',
+        'base/transport_security_state_perftest.cc',
         'cookies/cookie_monster_perftest.cc',
         'disk_cache/disk_cache_perftest.cc',
+        'http/http_cache_perftest.cc',
+        'http/http_response_headers_perftest.cc',
+        'http/http_stream_parser_perftest.cc',
+        'http/http_transaction_unittest.cc',
+        'http/http_transaction_unittest.h',
+        'http/mock_http_cache.cc',
+        'http/mock_http_cache.h',
         'proxy/proxy_resolver_perftest.cc',
+        'spdy/spdy_framer_perftest.cc',
       ],
       'conditions': [
         # This is needed to trigger the dll copy step on windows.
@@ -1465,6 +1497,22 @@
         ],
       ],
     },
+    {
+      'target_name': 'cache_replay',
+      'type': 'executable',
+      'dependencies': [
+        'net',
+        'net_test_support',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/cache_replay/cache_replay.cc',
+        'tools/cache_replay/cache_replayer.cc',
+        'tools/cache_replay/cache_replayer.h',
+        'tools/cache_replay/replay_log.cc',
+        'tools/cache_replay/replay_log.h',
+      ],
+    },
     {
       'target_name': 'stress_cache',
       'type': 'executable',
@@ -1649,6 +1697,19 @@
         'tools/fetch/fetch_client.cc',
       ],
     },
+    {
+      'target_name': 'load_client',
+      'type': 'executable',
+      'variables': { 'enable_wexit_time_destructors': 1, },
+      'dependencies': [
+        'net',
+        '../base/base.gyp:base',
+        '../build/temp_gyp/googleurl.gyp:googleurl',
+      ],
+      'sources': [
+        'tools/fetch/load_client.cc',
+      ],
+    },
     {
       'target_name': 'fetch_server',
       'type': 'executable',
@@ -1757,6 +1818,8 @@
              'tools/dump_cache/url_utilities.h',
              'tools/dump_cache/url_utilities.cc',
 
+             'tools/flip_server/accepted_connection_queue.cc',
+             'tools/flip_server/accepted_connection_queue.h',
              'tools/flip_server/acceptor_thread.h',
              'tools/flip_server/acceptor_thread.cc',
              'tools/flip_server/balsa_enums.h',
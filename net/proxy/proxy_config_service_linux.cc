@@ -904,7 +904,7 @@ bool SettingGetterImplGSettings::LoadAndCheckVersion(
 // Doing this allows the main Delegate code, as well as the unit tests
 // for it, to stay the same - and the settings map fairly well besides.
 class SettingGetterImplKDE : public ProxyConfigServiceLinux::SettingGetter,
-                             public base::MessagePumpLibevent::Watcher {
+                             public MessageLoopForIO::Watcher {
  public:
   explicit SettingGetterImplKDE(base::Environment* env_var_getter)
       : inotify_fd_(-1), notify_delegate_(NULL), indirect_manual_(false),
@@ -1035,7 +1035,7 @@ class SettingGetterImplKDE : public ProxyConfigServiceLinux::SettingGetter,
     return file_loop_;
   }
 
-  // Implement base::MessagePumpLibevent::Watcher.
+  // Implement MessageLoopForIO::Watcher.
   void OnFileCanReadWithoutBlocking(int fd) {
     DCHECK_EQ(fd, inotify_fd_);
     DCHECK(MessageLoop::current() == file_loop_);
@@ -1363,7 +1363,7 @@ class SettingGetterImplKDE : public ProxyConfigServiceLinux::SettingGetter,
                    std::vector<std::string> > strings_map_type;
 
   int inotify_fd_;
-  base::MessagePumpLibevent::FileDescriptorWatcher inotify_watcher_;
+  MessageLoopForIO::FileDescriptorWatcher inotify_watcher_;
   ProxyConfigServiceLinux::Delegate* notify_delegate_;
   base::OneShotTimer<SettingGetterImplKDE> debounce_timer_;
   FilePath kde_config_dir_;
@@ -11,11 +11,10 @@ namespace net {
 BufferedSpdyFramer::BufferedSpdyFramer(int version)
     : spdy_framer_(version),
       visitor_(NULL),
-      header_buffer_used_(0),
       header_buffer_valid_(false),
       header_stream_id_(SpdyFramer::kInvalidStream),
+      control_frame_(new SpdyFrame(SpdySynStreamControlFrame::size())),
       frames_received_(0) {
-  memset(header_buffer_, 0, sizeof(header_buffer_));
 }
 
 BufferedSpdyFramer::~BufferedSpdyFramer() {
@@ -78,16 +77,18 @@ bool BufferedSpdyFramer::OnControlFrameHeaderData(SpdyStreamId stream_id,
     // Indicates end-of-header-block.
     CHECK(header_buffer_valid_);
 
-    const linked_ptr<SpdyHeaderBlock> headers(new SpdyHeaderBlock);
-    bool parsed_headers = spdy_framer_.ParseHeaderBlockInBuffer(
-        header_buffer_, header_buffer_used_, headers.get());
-    if (!parsed_headers) {
+    if (!spdy_framer_.ParseHeaderBlockInArena(&header_arena_)) {
       visitor_->OnStreamError(
           stream_id, "Could not parse Spdy Control Frame Header.");
       return false;
     }
     SpdyControlFrame* control_frame =
         reinterpret_cast<SpdyControlFrame*>(control_frame_.get());
+    if (visitor_->OnControlFrameHeaders(*control_frame, header_arena_))
+      return true;
+
+    const linked_ptr<SpdyHeaderBlock> headers(new SpdyHeaderBlock);
+    header_arena_.CopyToHeaderBlock(headers.get());
     switch (control_frame->type()) {
       case SYN_STREAM:
         visitor_->OnSynStream(
@@ -111,15 +112,14 @@ bool BufferedSpdyFramer::OnControlFrameHeaderData(SpdyStreamId stream_id,
     return true;
   }
 
-  const size_t available = kHeaderBufferSize - header_buffer_used_;
+  const size_t available = kHeaderBufferSize - header_arena_.size();
   if (len > available) {
     header_buffer_valid_ = false;
     visitor_->OnStreamError(
         stream_id, "Received more data than the allocated size.");
     return false;
   }
-  memcpy(header_buffer_ + header_buffer_used_, header_data, len);
-  header_buffer_used_ += len;
+  header_arena_.Append(header_data, len);
   return true;
 }
 
@@ -250,8 +250,7 @@ bool BufferedSpdyFramer::IsCompressible(const SpdyFrame& frame) const {
 }
 
 void BufferedSpdyFramer::InitHeaderStreaming(const SpdyControlFrame* frame) {
-  memset(header_buffer_, 0, kHeaderBufferSize);
-  header_buffer_used_ = 0;
+  header_arena_.Clear();
   header_buffer_valid_ = true;
   header_stream_id_ = SpdyFramer::GetControlFrameStreamId(frame);
   DCHECK_NE(header_stream_id_, SpdyFramer::kInvalidStream);
@@ -271,7 +270,8 @@ void BufferedSpdyFramer::InitHeaderStreaming(const SpdyControlFrame* frame) {
       DCHECK(false);  // Error!
       break;
   }
-  control_frame_.reset(new SpdyFrame(frame_size_without_header_block));
+  // |control_frame_| is sized for the largest of these frames, and is reused
+  // to avoid an allocation per frame.
   memcpy(control_frame_.get()->data(), frame->data(),
          frame_size_without_header_block);
 }
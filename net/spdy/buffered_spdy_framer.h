@@ -30,6 +30,16 @@ class NET_EXPORT_PRIVATE BufferedSpdyFramerVisitorInterface {
   virtual void OnStreamError(SpdyStreamId stream_id,
                              const std::string& description) = 0;
 
+  // Called after all the header data for a SYN_STREAM, SYN_REPLY or HEADERS
+  // control frame is received, before the headers are copied into a
+  // SpdyHeaderBlock. |headers| points into a buffer that is reused for the
+  // next frame. A visitor that is done with the frame returns true, and
+  // OnSynStream(), OnSynReply() or OnHeaders() is not called for it.
+  virtual bool OnControlFrameHeaders(const SpdyControlFrame& frame,
+                                     const SpdyHeaderArena& headers) {
+    return false;
+  }
+
   // Called after all the header data for SYN_STREAM control frame is received.
   virtual void OnSynStream(const SpdySynStreamControlFrame& frame,
                            const linked_ptr<SpdyHeaderBlock>& headers) = 0;
@@ -146,7 +156,7 @@ class NET_EXPORT_PRIVATE BufferedSpdyFramer
   int frames_received() const { return frames_received_; }
 
  private:
-  // The size of the header_buffer_.
+  // The maximum size of a header block.
   enum { kHeaderBufferSize = 32 * 1024 };
 
   void InitHeaderStreaming(const SpdyControlFrame* frame);
@@ -155,8 +165,7 @@ class NET_EXPORT_PRIVATE BufferedSpdyFramer
   BufferedSpdyFramerVisitorInterface* visitor_;
 
   // Header block streaming state:
-  char header_buffer_[kHeaderBufferSize];
-  size_t header_buffer_used_;
+  SpdyHeaderArena header_arena_;
   bool header_buffer_valid_;
   SpdyStreamId header_stream_id_;
   scoped_ptr<SpdyFrame> control_frame_;
@@ -22,6 +22,8 @@ class TestBufferedSpdyVisitor : public BufferedSpdyFramerVisitorInterface {
       syn_frame_count_(0),
       syn_reply_frame_count_(0),
       headers_frame_count_(0),
+      header_arena_count_(0),
+      consume_header_arena_(false),
       header_stream_id_(-1) {
   }
 
@@ -37,6 +39,18 @@ class TestBufferedSpdyVisitor : public BufferedSpdyFramerVisitorInterface {
     error_count_++;
   }
 
+  bool OnControlFrameHeaders(const SpdyControlFrame& frame,
+                             const SpdyHeaderArena& headers) {
+    header_stream_id_ = SpdyFramer::GetControlFrameStreamId(&frame);
+    EXPECT_NE(header_stream_id_, SpdyFramer::kInvalidStream);
+    header_arena_count_++;
+    if (!consume_header_arena_)
+      return false;
+    headers_.clear();
+    headers.CopyToHeaderBlock(&headers_);
+    return true;
+  }
+
   void OnSynStream(const SpdySynStreamControlFrame& frame,
              const linked_ptr<SpdyHeaderBlock>& headers) {
     header_stream_id_ = frame.stream_id();
@@ -131,6 +145,10 @@ class TestBufferedSpdyVisitor : public BufferedSpdyFramerVisitorInterface {
   int syn_frame_count_;
   int syn_reply_frame_count_;
   int headers_frame_count_;
+  int header_arena_count_;
+
+  // Whether OnControlFrameHeaders() handles header blocks by itself.
+  bool consume_header_arena_;
 
   // Header block streaming state:
   SpdyStreamId header_stream_id_;
@@ -261,4 +279,32 @@ TEST_F(BufferedSpdyFramerSpdy2Test, ReadHeadersHeaderBlock) {
   EXPECT_EQ(1, visitor.headers_frame_count_);
   EXPECT_TRUE(CompareHeaderBlocks(&headers, &visitor.headers_));
 }
+
+TEST_F(BufferedSpdyFramerSpdy2Test, ReadHeaderBlockFromArena) {
+  SpdyHeaderBlock headers;
+  headers["alpha"] = "beta";
+  headers["gamma"] = "delta";
+  BufferedSpdyFramer framer(2);
+  TestBufferedSpdyVisitor visitor;
+  visitor.consume_header_arena_ = true;
+
+  // The arena is reused for the second frame.
+  for (SpdyStreamId stream_id = 1; stream_id <= 3; stream_id += 2) {
+    headers["stream"] = stream_id == 1 ? "one" : "three";
+    scoped_ptr<SpdySynReplyControlFrame> control_frame(
+        framer.CreateSynReply(stream_id,
+                              CONTROL_FLAG_NONE,
+                              true,                     // compress
+                              &headers));
+    ASSERT_TRUE(control_frame.get() != NULL);
+    visitor.SimulateInFramer(
+        reinterpret_cast<unsigned char*>(control_frame.get()->data()),
+        control_frame.get()->length() + SpdyControlFrame::kHeaderSize);
+    EXPECT_EQ(stream_id, visitor.header_stream_id_);
+    EXPECT_TRUE(CompareHeaderBlocks(&headers, &visitor.headers_));
+  }
+  EXPECT_EQ(0, visitor.error_count_);
+  EXPECT_EQ(2, visitor.header_arena_count_);
+  EXPECT_EQ(0, visitor.syn_reply_frame_count_);
+}
 }  // namespace net
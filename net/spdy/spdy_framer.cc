@@ -8,6 +8,8 @@
 
 #include "net/spdy/spdy_framer.h"
 
+#include <algorithm>
+
 #include "base/lazy_instance.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/metrics/stats_counters.h"
@@ -132,6 +134,38 @@ void SettingsFlagsAndId::ConvertFlagsAndIdForSpdy2(uint32* val) {
 SpdyCredential::SpdyCredential() : slot(0) { }
 SpdyCredential::~SpdyCredential() { }
 
+SpdyHeaderArena::SpdyHeaderArena() { }
+SpdyHeaderArena::~SpdyHeaderArena() { }
+
+void SpdyHeaderArena::Append(const char* data, size_t len) {
+  headers_.clear();
+  buffer_.append(data, len);
+}
+
+void SpdyHeaderArena::Clear() {
+  headers_.clear();
+  buffer_.clear();
+}
+
+bool SpdyHeaderArena::GetHeader(const base::StringPiece& name,
+                                base::StringPiece* value) const {
+  for (Headers::const_iterator it = headers_.begin();
+       it != headers_.end(); ++it) {
+    if (it->first == name) {
+      *value = it->second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SpdyHeaderArena::CopyToHeaderBlock(SpdyHeaderBlock* block) const {
+  for (Headers::const_iterator it = headers_.begin();
+       it != headers_.end(); ++it) {
+    it->second.CopyToString(&(*block)[it->first.as_string()]);
+  }
+}
+
 SpdyFramer::SpdyFramer(int version)
     : state_(SPDY_RESET),
       error_code_(SPDY_NO_ERROR),
@@ -948,6 +982,61 @@ void SpdyFramer::ExpandControlFrameBuffer(size_t size) {
 bool SpdyFramer::ParseHeaderBlockInBuffer(const char* header_data,
                                           size_t header_length,
                                           SpdyHeaderBlock* block) {
+  SpdyHeaderArena::Headers headers;
+  if (!ReadHeaderBlock(header_data, header_length, &headers))
+    return false;
+
+  for (size_t index = 0; index < headers.size(); ++index) {
+    // Ensure no duplicates.
+    std::pair<SpdyHeaderBlock::iterator, bool> inserted = block->insert(
+        std::make_pair(headers[index].first.as_string(), std::string()));
+    if (!inserted.second) {
+      DLOG(INFO) << "Duplicate header '" << headers[index].first << "' ("
+                 << index + 1 << " of " << headers.size() << ").";
+      return false;
+    }
+
+    // Store header.
+    headers[index].second.CopyToString(&inserted.first->second);
+  }
+  return true;
+}
+
+bool SpdyFramer::ParseHeaderBlockInBuffer(const char* header_data,
+                                          size_t header_length,
+                                          SpdyHeaderArena::Headers* headers) {
+  headers->clear();
+  if (!ReadHeaderBlock(header_data, header_length, headers))
+    return false;
+
+  // Ensure no duplicates. Sorting a copy of the names keeps this
+  // O(n log n) for huge header blocks, and the scratch vector is reused so
+  // that typical blocks don't allocate.
+  header_names_scratch_.clear();
+  for (SpdyHeaderArena::Headers::const_iterator it = headers->begin();
+       it != headers->end(); ++it) {
+    header_names_scratch_.push_back(it->first);
+  }
+  std::sort(header_names_scratch_.begin(), header_names_scratch_.end());
+  std::vector<base::StringPiece>::const_iterator duplicate =
+      std::adjacent_find(header_names_scratch_.begin(),
+                         header_names_scratch_.end());
+  if (duplicate != header_names_scratch_.end()) {
+    DLOG(INFO) << "Duplicate header '" << *duplicate << "'.";
+    headers->clear();
+    return false;
+  }
+  return true;
+}
+
+bool SpdyFramer::ParseHeaderBlockInArena(SpdyHeaderArena* arena) {
+  return ParseHeaderBlockInBuffer(arena->buffer_.data(), arena->buffer_.size(),
+                                  &arena->headers_);
+}
+
+bool SpdyFramer::ReadHeaderBlock(const char* header_data,
+                                 size_t header_length,
+                                 SpdyHeaderArena::Headers* headers) const {
   SpdyFrameReader reader(header_data, header_length);
 
   // Read number of headers.
@@ -968,37 +1057,25 @@ bool SpdyFramer::ParseHeaderBlockInBuffer(const char* header_data,
 
   // Read each header.
   for (uint32 index = 0; index < num_headers; ++index) {
-    base::StringPiece temp;
+    SpdyHeaderArena::Header header;
 
     // Read header name.
-    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&temp)
-                            : !reader.ReadStringPiece32(&temp)) {
+    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&header.first)
+                            : !reader.ReadStringPiece32(&header.first)) {
       DLOG(INFO) << "Unable to read header name (" << index + 1 << " of "
                  << num_headers << ").";
       return false;
     }
-    std::string name;
-    temp.CopyToString(&name);
 
     // Read header value.
-    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&temp)
-                            : !reader.ReadStringPiece32(&temp)) {
+    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&header.second)
+                            : !reader.ReadStringPiece32(&header.second)) {
       DLOG(INFO) << "Unable to read header value (" << index + 1 << " of "
                  << num_headers << ").";
       return false;
     }
-    std::string value;
-    temp.CopyToString(&value);
-
-    // Ensure no duplicates.
-    if (block->find(name) != block->end()) {
-      DLOG(INFO) << "Duplicate header '" << name << "' (" << index + 1 << " of "
-                 << num_headers << ").";
-      return false;
-    }
 
-    // Store header.
-    (*block)[name] = value;
+    headers->push_back(header);
   }
   return true;
 }
@@ -15,6 +15,7 @@
 #include "base/basictypes.h"
 #include "base/gtest_prod_util.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/string_piece.h"
 #include "base/sys_byteorder.h"
 #include "net/base/net_export.h"
 #include "net/spdy/spdy_protocol.h"
@@ -48,6 +49,48 @@ class TestSpdyVisitor;
 // SYN_STREAM or SYN_REPLY frame.
 typedef std::map<std::string, std::string> SpdyHeaderBlock;
 
+// A datastructure for holding the header block of one SYN_STREAM, SYN_REPLY
+// or HEADERS frame without a separate allocation per header. The decompressed
+// block is appended to the arena and then parsed in place, so the names and
+// values in headers() point into the arena's buffer. Clear() keeps the
+// memory, and an arena that is reused for every frame stops allocating once
+// it has held the largest header block.
+class NET_EXPORT_PRIVATE SpdyHeaderArena {
+ public:
+  typedef std::pair<base::StringPiece, base::StringPiece> Header;
+  typedef std::vector<Header> Headers;
+
+  SpdyHeaderArena();
+  ~SpdyHeaderArena();
+
+  // Appends a chunk of the serialized header block. This invalidates
+  // headers() until the block is parsed again.
+  void Append(const char* data, size_t len);
+
+  // Forgets the header block, keeping the memory for the next one.
+  void Clear();
+
+  // Looks up the header |name|, storing its value in |value|. Returns false
+  // if there is no such header.
+  bool GetHeader(const base::StringPiece& name,
+                 base::StringPiece* value) const;
+
+  // Copies the headers into |block|, for consumers of SpdyHeaderBlock.
+  void CopyToHeaderBlock(SpdyHeaderBlock* block) const;
+
+  const char* data() const { return buffer_.data(); }
+  size_t size() const { return buffer_.size(); }
+  const Headers& headers() const { return headers_; }
+
+ private:
+  friend class SpdyFramer;
+
+  std::string buffer_;
+  Headers headers_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyHeaderArena);
+};
+
 // A datastructure for holding the ID and flag fields for SETTINGS.
 // Conveniently handles converstion to/from wire format.
 class NET_EXPORT_PRIVATE SettingsFlagsAndId {
@@ -269,6 +312,15 @@ class NET_EXPORT_PRIVATE SpdyFramer {
                                 size_t header_length,
                                 SpdyHeaderBlock* block);
 
+  // Like ParseHeaderBlockInBuffer(), but without copying: the names and
+  // values stored in |headers| point into |header_data|.
+  bool ParseHeaderBlockInBuffer(const char* header_data,
+                                size_t header_length,
+                                SpdyHeaderArena::Headers* headers);
+
+  // Parses the header block held by |arena| in place.
+  bool ParseHeaderBlockInArena(SpdyHeaderArena* arena);
+
   // Create a SpdySynStreamControlFrame.
   // |stream_id| is the id for this stream.
   // |associated_stream_id| is the associated stream id for this stream.
@@ -500,6 +552,12 @@ class NET_EXPORT_PRIVATE SpdyFramer {
   size_t UpdateCurrentFrameBuffer(const char** data, size_t* len,
                                   size_t max_bytes);
 
+  // Reads the name/value pairs of a serialized header block into |headers|,
+  // without checking for duplicate names.
+  bool ReadHeaderBlock(const char* header_data,
+                       size_t header_length,
+                       SpdyHeaderArena::Headers* headers) const;
+
   // Retrieve serialized length of SpdyHeaderBlock.
   size_t GetSerializedLength(const SpdyHeaderBlock* headers) const;
 
@@ -565,6 +623,10 @@ class NET_EXPORT_PRIVATE SpdyFramer {
   // current_frame_buffer_.
   SpdySettingsScratch settings_scratch_;
 
+  // Scratch space for finding duplicate header names when parsing into a
+  // SpdyHeaderArena.
+  std::vector<base::StringPiece> header_names_scratch_;
+
   bool validate_control_frame_sizes_;
   bool enable_compression_;  // Controls all compression
   // SPDY header compressors.
@@ -0,0 +1,194 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+
+#include <new>
+#include <string>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/time.h"
+#include "net/spdy/buffered_spdy_framer.h"
+#include "net/spdy/spdy_framer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Set while a test wants the calls to operator new counted in
+// |g_allocations|. Other threads of net_perftests allocate too, so both are
+// accessed atomically.
+base::subtle::Atomic32 g_counting_allocations = 0;
+base::subtle::Atomic32 g_allocations = 0;
+
+void* CountedAllocation(size_t size) {
+  if (base::subtle::NoBarrier_Load(&g_counting_allocations))
+    base::subtle::NoBarrier_AtomicIncrement(&g_allocations, 1);
+  void* ptr = malloc(size ? size : 1);
+  CHECK(ptr);
+  return ptr;
+}
+
+}  // namespace
+
+// Replaces the global allocation functions of net_perftests, which are not
+// otherwise provided by the allocator shim, so that the number of allocations
+// made while decoding frames is measured rather than estimated.
+void* operator new(size_t size) {
+  return CountedAllocation(size);
+}
+
+void* operator new[](size_t size) {
+  return CountedAllocation(size);
+}
+
+void operator delete(void* ptr) {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) {
+  free(ptr);
+}
+
+namespace net {
+
+namespace {
+
+const int kNumFrames = 20000;
+
+// Response headers along the lines of those of a search results page.
+const char* const kResponseHeaders[][2] = {
+  { "status", "200 OK" },
+  { "version", "HTTP/1.1" },
+  { "cache-control", "private, max-age=0" },
+  { "content-encoding", "gzip" },
+  { "content-type", "text/html; charset=UTF-8" },
+  { "date", "Tue, 01 May 2012 18:00:00 GMT" },
+  { "expires", "-1" },
+  { "server", "gws" },
+  { "set-cookie", "PREF=ID=0123456789abcdef:FF=0:TM=1335895200; "
+                  "expires=Thu, 01-May-2014 18:00:00 GMT; path=/; "
+                  "domain=.example.com" },
+  { "x-frame-options", "SAMEORIGIN" },
+  { "x-xss-protection", "1; mode=block" },
+};
+
+// Counts the SYN_REPLY frames it sees, taking their headers either from the
+// arena or as a SpdyHeaderBlock.
+class HeaderCountingVisitor : public BufferedSpdyFramerVisitorInterface {
+ public:
+  explicit HeaderCountingVisitor(bool use_arena)
+      : use_arena_(use_arena),
+        frames_(0) {
+  }
+
+  virtual void OnError(int error_code) OVERRIDE {
+    ADD_FAILURE() << "SpdyFramer error " << error_code;
+  }
+  virtual void OnStreamError(SpdyStreamId stream_id,
+                             const std::string& description) OVERRIDE {
+    ADD_FAILURE() << description;
+  }
+
+  virtual bool OnControlFrameHeaders(const SpdyControlFrame& frame,
+                                     const SpdyHeaderArena& headers) OVERRIDE {
+    if (!use_arena_)
+      return false;
+    ++frames_;
+    return true;
+  }
+
+  virtual void OnSynReply(const SpdySynReplyControlFrame& frame,
+                          const linked_ptr<SpdyHeaderBlock>& headers) OVERRIDE {
+    ++frames_;
+  }
+
+  virtual void OnSynStream(
+      const SpdySynStreamControlFrame& frame,
+      const linked_ptr<SpdyHeaderBlock>& headers) OVERRIDE {}
+  virtual void OnHeaders(const SpdyHeadersControlFrame& frame,
+                         const linked_ptr<SpdyHeaderBlock>& headers) OVERRIDE {}
+  virtual void OnRstStream(const SpdyRstStreamControlFrame& frame) OVERRIDE {}
+  virtual void OnGoAway(const SpdyGoAwayControlFrame& frame) OVERRIDE {}
+  virtual void OnPing(const SpdyPingControlFrame& frame) OVERRIDE {}
+  virtual void OnWindowUpdate(
+      const SpdyWindowUpdateControlFrame& frame) OVERRIDE {}
+  virtual void OnStreamFrameData(SpdyStreamId stream_id,
+                                 const char* data,
+                                 size_t len) OVERRIDE {}
+  virtual void OnSetting(
+      SpdySettingsIds id, uint8 flags, uint32 value) OVERRIDE {}
+
+  int frames() const { return frames_; }
+
+ private:
+  const bool use_arena_;
+  int frames_;
+};
+
+class SpdyFramerPerfTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    BufferedSpdyFramer framer(3);
+    SpdyHeaderBlock headers;
+    for (size_t i = 0; i < arraysize(kResponseHeaders); ++i)
+      headers[kResponseHeaders[i][0]] = kResponseHeaders[i][1];
+    for (int i = 0; i < kNumFrames; ++i) {
+      scoped_ptr<SpdySynReplyControlFrame> frame(
+          framer.CreateSynReply(2 * i + 1, CONTROL_FLAG_NONE,
+                                true /* compress */, &headers));
+      frames_.append(frame->data(),
+                     frame->length() + SpdyControlFrame::kHeaderSize);
+    }
+  }
+
+  // Logs the rate at which a BufferedSpdyFramer decodes the frames, and the
+  // number of allocations per frame it makes to decode them and hand over
+  // their headers.
+  void DecodeFrames(const std::string& name, bool use_arena) {
+    BufferedSpdyFramer framer(3);
+    HeaderCountingVisitor visitor(use_arena);
+    framer.set_visitor(&visitor);
+
+    base::subtle::NoBarrier_Store(&g_allocations, 0);
+    base::subtle::NoBarrier_Store(&g_counting_allocations, 1);
+    base::TimeTicks start = base::TimeTicks::Now();
+    const char* data = frames_.data();
+    size_t len = frames_.size();
+    while (len > 0 && !framer.HasError()) {
+      size_t processed = framer.ProcessInput(data, len);
+      data += processed;
+      len -= processed;
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+    base::subtle::NoBarrier_Store(&g_counting_allocations, 0);
+
+    EXPECT_EQ(SpdyFramer::SPDY_NO_ERROR, framer.error_code());
+    ASSERT_EQ(kNumFrames, visitor.frames());
+    LogPerfResult((name + "_FramesPerSec").c_str(),
+                  kNumFrames / elapsed.InSecondsF(), "frames/s");
+    LogPerfResult((name + "_AllocationsPerFrame").c_str(),
+                  static_cast<double>(
+                      base::subtle::NoBarrier_Load(&g_allocations)) /
+                      kNumFrames,
+                  "allocs/frame");
+  }
+
+  std::string frames_;
+};
+
+}  // namespace
+
+TEST_F(SpdyFramerPerfTest, DecodeHeaderBlock) {
+  DecodeFrames("BufferedSpdyFramer_HeaderBlock", false);
+}
+
+TEST_F(SpdyFramerPerfTest, DecodeHeaderArena) {
+  DecodeFrames("BufferedSpdyFramer_HeaderArena", true);
+}
+
+}  // namespace net
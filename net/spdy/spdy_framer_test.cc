@@ -579,6 +579,54 @@ TEST_P(SpdyFramerTest, UndersizedHeaderBlockInBuffer) {
                                                &new_headers));
 }
 
+// Test that a header block parsed in place points into the arena, and that
+// the arena can be reused for the next block.
+TEST_P(SpdyFramerTest, HeaderBlockInArena) {
+  SpdyHeaderBlock headers;
+  headers["alpha"] = "beta";
+  headers["gamma"] = "charlie";
+  SpdyFramer framer(spdy_version_);
+
+  scoped_ptr<SpdySynStreamControlFrame> frame(
+      framer.CreateSynStream(1,  // stream id
+                             0,  // associated stream id
+                             1,  // priority
+                             0,  // credential slot
+                             CONTROL_FLAG_NONE,
+                             false,  // compress
+                             &headers));
+  ASSERT_TRUE(frame.get() != NULL);
+
+  // The block arrives in chunks, like it does from the decompressor.
+  SpdyHeaderArena arena;
+  const size_t split = frame->header_block_len() / 2;
+  arena.Append(frame->header_block(), split);
+  arena.Append(frame->header_block() + split,
+               frame->header_block_len() - split);
+  ASSERT_TRUE(framer.ParseHeaderBlockInArena(&arena));
+
+  ASSERT_EQ(2u, arena.headers().size());
+  for (size_t i = 0; i < arena.headers().size(); ++i) {
+    const base::StringPiece& name = arena.headers()[i].first;
+    EXPECT_GE(name.data(), arena.data());
+    EXPECT_LE(name.data() + name.size(), arena.data() + arena.size());
+  }
+  base::StringPiece value;
+  EXPECT_TRUE(arena.GetHeader("gamma", &value));
+  EXPECT_EQ("charlie", value);
+  EXPECT_FALSE(arena.GetHeader("beta", &value));
+
+  SpdyHeaderBlock new_headers;
+  arena.CopyToHeaderBlock(&new_headers);
+  EXPECT_EQ(headers, new_headers);
+
+  // An incomplete block doesn't parse.
+  arena.Clear();
+  EXPECT_TRUE(arena.headers().empty());
+  arena.Append(frame->header_block(), frame->header_block_len() - 2);
+  EXPECT_FALSE(framer.ParseHeaderBlockInArena(&arena));
+}
+
 TEST_P(SpdyFramerTest, OutOfOrderHeaders) {
   // Frame builder with plentiful buffer size.
   SpdyFrameBuilder frame(1024);
@@ -727,6 +775,11 @@ TEST_P(SpdyFramerTest, DuplicateHeader) {
   EXPECT_FALSE(framer.ParseHeaderBlockInBuffer(serialized_headers.c_str(),
                                                serialized_headers.size(),
                                                &new_headers));
+  SpdyHeaderArena::Headers header_pieces;
+  EXPECT_FALSE(framer.ParseHeaderBlockInBuffer(serialized_headers.c_str(),
+                                               serialized_headers.size(),
+                                               &header_pieces));
+  EXPECT_TRUE(header_pieces.empty());
 }
 
 TEST_P(SpdyFramerTest, MultiValueHeader) {
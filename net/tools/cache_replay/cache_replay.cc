@@ -0,0 +1,158 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This command-line program replays a log of cache operations (see
+// replay_log.h) against one of the cache backends, and prints the latency
+// percentiles of each kind of operation.
+
+#include <stdio.h>
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/message_loop.h"
+#include "base/string_number_conversions.h"
+#include "base/threading/thread.h"
+#include "net/base/cache_type.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/simple/simple_backend_impl.h"
+#include "net/tools/cache_replay/cache_replayer.h"
+#include "net/tools/cache_replay/replay_log.h"
+
+enum Errors {
+  ALL_GOOD = 0,
+  INVALID_ARGUMENT = 1,
+  FILE_ACCESS_ERROR,
+  INVALID_LOG,
+  CACHE_ERROR,
+};
+
+// The log to replay.
+const char kLog[] = "log";
+
+// The folder of the cache. The contents of the folder are deleted first,
+// unless --keep is used.
+const char kCache[] = "cache";
+
+// The backend to use: "blockfile" (the default), "simple" or "memory".
+const char kBackend[] = "backend";
+
+// The maximum size of the cache, in bytes.
+const char kCacheSize[] = "cache-size";
+
+// Replays the operations at the times of the log, instead of at full speed.
+const char kRealTime[] = "real-time";
+
+// Starts with the current contents of the cache.
+const char kKeep[] = "keep";
+
+int Help() {
+  printf("cache_replay --log=path1 --cache=path2\n");
+  printf("--backend=blockfile|simple|memory: the cache to use\n");
+  printf("--cache-size=bytes: the maximum size of the cache\n");
+  printf("--real-time: issue the operations at the times of the log\n");
+  printf("--keep: do not delete the current contents of the cache\n");
+  return INVALID_ARGUMENT;
+}
+
+void PrintResults(const disk_cache::CacheReplayer& replayer) {
+  printf("%-8s %8s %10s %10s %10s %10s %10s\n", "op", "count", "p50 us",
+         "p90 us", "p99 us", "p99.9 us", "max us");
+  for (int i = 0; i < disk_cache::ReplayOperation::TYPE_MAX; i++) {
+    disk_cache::ReplayOperation::Type type =
+        static_cast<disk_cache::ReplayOperation::Type>(i);
+    const disk_cache::LatencyStats& stats = replayer.latencies(type);
+    if (!stats.count())
+      continue;
+    printf("%-8s %8d %10d %10d %10d %10d %10d\n",
+           disk_cache::GetReplayOperationName(type),
+           static_cast<int>(stats.count()),
+           static_cast<int>(stats.GetPercentile(50).InMicroseconds()),
+           static_cast<int>(stats.GetPercentile(90).InMicroseconds()),
+           static_cast<int>(stats.GetPercentile(99).InMicroseconds()),
+           static_cast<int>(stats.GetPercentile(99.9).InMicroseconds()),
+           static_cast<int>(stats.GetPercentile(100).InMicroseconds()));
+  }
+  printf("%d failed, %d skipped, %.3f s\n", replayer.failures(),
+         replayer.skipped(), replayer.elapsed_time().InSecondsF());
+}
+
+int main(int argc, const char* argv[]) {
+  // Setup an AtExitManager so Singleton objects will be destroyed.
+  base::AtExitManager at_exit_manager;
+  MessageLoop message_loop(MessageLoop::TYPE_IO);
+
+  CommandLine::Init(argc, argv);
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  FilePath log_path = command_line.GetSwitchValuePath(kLog);
+  FilePath cache_path = command_line.GetSwitchValuePath(kCache);
+  std::string backend = command_line.GetSwitchValueASCII(kBackend);
+  if (backend.empty())
+    backend = "blockfile";
+  if (log_path.empty() || (cache_path.empty() && backend != "memory"))
+    return Help();
+
+  int cache_size = 0;
+  if (command_line.HasSwitch(kCacheSize) &&
+      !base::StringToInt(command_line.GetSwitchValueASCII(kCacheSize),
+                         &cache_size)) {
+    return Help();
+  }
+
+  std::string contents;
+  if (!file_util::ReadFileToString(log_path, &contents)) {
+    printf("Unable to read the log\n");
+    return FILE_ACCESS_ERROR;
+  }
+  disk_cache::ReplayLog log;
+  int error_line;
+  if (!disk_cache::ParseReplayLog(contents, &log, &error_line)) {
+    printf("Invalid log, line %d\n", error_line);
+    return INVALID_LOG;
+  }
+
+  if (!cache_path.empty() && !command_line.HasSwitch(kKeep))
+    file_util::Delete(cache_path, true);
+
+  base::Thread cache_thread("CacheThread");
+  if (!cache_thread.StartWithOptions(
+          base::Thread::Options(MessageLoop::TYPE_IO, 0))) {
+    return CACHE_ERROR;
+  }
+
+  net::TestCompletionCallback cb;
+  disk_cache::Backend* cache = NULL;
+  int rv = net::ERR_INVALID_ARGUMENT;
+  if (backend == "blockfile") {
+    rv = disk_cache::CreateCacheBackend(
+        net::DISK_CACHE, cache_path, cache_size, true,
+        cache_thread.message_loop_proxy(), NULL, &cache, cb.callback());
+  } else if (backend == "simple") {
+    rv = disk_cache::SimpleBackendImpl::CreateBackend(
+        cache_path, cache_size, NULL, &cache, cb.callback());
+  } else if (backend == "memory") {
+    cache = disk_cache::MemBackendImpl::CreateBackend(cache_size, NULL);
+    rv = cache ? net::OK : net::ERR_FAILED;
+  } else {
+    return Help();
+  }
+  if (cb.GetResult(rv) != net::OK) {
+    printf("Unable to create the cache\n");
+    return CACHE_ERROR;
+  }
+
+  disk_cache::CacheReplayer replayer(cache, log,
+                                     command_line.HasSwitch(kRealTime));
+  replayer.Run();
+  PrintResults(replayer);
+
+  delete cache;
+  message_loop.RunAllPending();
+  return ALL_GOOD;
+}
@@ -0,0 +1,236 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/cache_replay/cache_replayer.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace {
+
+// The number of operations that are kept in flight when the log is replayed
+// as fast as possible.
+const int kMaxOperationsInFlight = 256;
+
+bool NeedsOpenEntry(disk_cache::ReplayOperation::Type type) {
+  return type == disk_cache::ReplayOperation::CLOSE ||
+         type == disk_cache::ReplayOperation::READ ||
+         type == disk_cache::ReplayOperation::WRITE;
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+LatencyStats::LatencyStats() : sorted_(true) {
+}
+
+LatencyStats::~LatencyStats() {
+}
+
+void LatencyStats::Add(base::TimeDelta latency) {
+  latencies_.push_back(latency);
+  sorted_ = false;
+}
+
+base::TimeDelta LatencyStats::GetPercentile(double percentile) const {
+  DCHECK_GE(percentile, 0.0);
+  DCHECK_LE(percentile, 100.0);
+  if (latencies_.empty())
+    return base::TimeDelta();
+
+  if (!sorted_) {
+    std::sort(latencies_.begin(), latencies_.end());
+    sorted_ = true;
+  }
+
+  // The nearest rank.
+  size_t rank = static_cast<size_t>(percentile * latencies_.size() / 100);
+  return latencies_[std::min(rank, latencies_.size() - 1)];
+}
+
+CacheReplayer::EntryState::EntryState()
+    : entry(NULL), pending_entry(NULL), busy(false) {
+}
+
+CacheReplayer::EntryState::~EntryState() {
+}
+
+CacheReplayer::CacheReplayer(Backend* cache, const ReplayLog& log,
+                             bool real_time)
+    : cache_(cache),
+      log_(log),
+      real_time_(real_time),
+      start_times_(log.size()),
+      next_(0),
+      in_flight_(0),
+      waiting_(false),
+      failures_(0),
+      skipped_(0) {
+  int max_write = 1;
+  for (size_t i = 0; i < log.size(); i++) {
+    if (log[i].type == ReplayOperation::WRITE)
+      max_write = std::max(max_write, log[i].length);
+  }
+  write_buffer_ = new net::IOBuffer(max_write);
+  memset(write_buffer_->data(), 'x', max_write);
+}
+
+CacheReplayer::~CacheReplayer() {
+  DCHECK(!in_flight_);
+}
+
+void CacheReplayer::Run() {
+  replay_start_ = base::TimeTicks::Now();
+  IssueOperations();
+  if (next_ < log_.size() || in_flight_) {
+    waiting_ = true;
+    MessageLoop::current()->Run();
+  }
+  elapsed_time_ = base::TimeTicks::Now() - replay_start_;
+
+  for (std::map<std::string, EntryState>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    if (it->second.entry)
+      it->second.entry->Close();
+  }
+  entries_.clear();
+}
+
+void CacheReplayer::IssueOperations() {
+  while (next_ < log_.size()) {
+    if (real_time_) {
+      base::TimeDelta delay =
+          log_[next_].time - (base::TimeTicks::Now() - replay_start_);
+      if (delay > base::TimeDelta()) {
+        if (!timer_.IsRunning())
+          timer_.Start(FROM_HERE, delay, this, &CacheReplayer::OnTimer);
+        return;
+      }
+    } else if (in_flight_ >= kMaxOperationsInFlight) {
+      return;
+    }
+    Dispatch(next_++);
+  }
+
+  if (!in_flight_ && waiting_) {
+    waiting_ = false;
+    MessageLoop::current()->Quit();
+  }
+}
+
+void CacheReplayer::OnTimer() {
+  IssueOperations();
+}
+
+void CacheReplayer::Dispatch(size_t index) {
+  in_flight_++;
+  EntryState& state = entries_[log_[index].key];
+  if (state.busy) {
+    state.waiting.push_back(index);
+    return;
+  }
+  state.busy = true;
+  Start(index);
+}
+
+void CacheReplayer::Start(size_t index) {
+  // Operations that complete synchronously move on to the next operation of
+  // the entry right away.
+  for (;;) {
+    const ReplayOperation& operation = log_[index];
+    int rv = net::OK;
+    if (NeedsOpenEntry(operation.type) && !entries_[operation.key].entry) {
+      skipped_++;
+    } else {
+      start_times_[index] = base::TimeTicks::Now();
+      rv = Issue(index);
+      if (rv == net::ERR_IO_PENDING)
+        return;
+    }
+    if (!Finish(index, rv, &index))
+      return;
+  }
+}
+
+int CacheReplayer::Issue(size_t index) {
+  const ReplayOperation& operation = log_[index];
+  EntryState& state = entries_[operation.key];
+  net::CompletionCallback callback =
+      base::Bind(&CacheReplayer::OnIOComplete, base::Unretained(this), index);
+
+  switch (operation.type) {
+    case ReplayOperation::OPEN:
+      return cache_->OpenEntry(operation.key, &state.pending_entry, callback);
+    case ReplayOperation::CREATE:
+      return cache_->CreateEntry(operation.key, &state.pending_entry,
+                                 callback);
+    case ReplayOperation::CLOSE:
+      state.entry->Close();
+      state.entry = NULL;
+      return net::OK;
+    case ReplayOperation::DOOM:
+      return cache_->DoomEntry(operation.key, callback);
+    case ReplayOperation::READ: {
+      scoped_refptr<net::IOBuffer> buffer(
+          new net::IOBuffer(std::max(operation.length, 1)));
+      return state.entry->ReadData(operation.index, operation.offset, buffer,
+                                   operation.length, callback);
+    }
+    case ReplayOperation::WRITE:
+      return state.entry->WriteData(operation.index, operation.offset,
+                                    write_buffer_, operation.length, callback,
+                                    false);
+    default:
+      NOTREACHED();
+      return net::ERR_UNEXPECTED;
+  }
+}
+
+void CacheReplayer::OnIOComplete(size_t index, int result) {
+  size_t next;
+  if (Finish(index, result, &next))
+    Start(next);
+  IssueOperations();
+}
+
+bool CacheReplayer::Finish(size_t index, int result, size_t* next) {
+  const ReplayOperation& operation = log_[index];
+  if (!start_times_[index].is_null()) {
+    latencies_[operation.type].Add(base::TimeTicks::Now() -
+                                   start_times_[index]);
+  }
+  if (result < 0)
+    failures_++;
+
+  EntryState& state = entries_[operation.key];
+  if (operation.type == ReplayOperation::OPEN ||
+      operation.type == ReplayOperation::CREATE) {
+    if (result == net::OK) {
+      // The log may open an entry more than once.
+      if (state.entry)
+        state.entry->Close();
+      state.entry = state.pending_entry;
+    }
+    state.pending_entry = NULL;
+  }
+
+  in_flight_--;
+  if (state.waiting.empty()) {
+    state.busy = false;
+    return false;
+  }
+  *next = state.waiting.front();
+  state.waiting.pop_front();
+  return true;
+}
+
+}  // namespace disk_cache
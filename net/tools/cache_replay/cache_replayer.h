@@ -0,0 +1,130 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_CACHE_REPLAY_CACHE_REPLAYER_H_
+#define NET_TOOLS_CACHE_REPLAY_CACHE_REPLAYER_H_
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/time.h"
+#include "base/timer.h"
+#include "net/tools/cache_replay/replay_log.h"
+
+namespace net {
+class IOBuffer;
+}  // namespace net
+
+namespace disk_cache {
+
+class Backend;
+class Entry;
+
+// Collects the latencies of one kind of operation.
+class LatencyStats {
+ public:
+  LatencyStats();
+  ~LatencyStats();
+
+  void Add(base::TimeDelta latency);
+
+  size_t count() const { return latencies_.size(); }
+
+  // Returns the latency below which |percentile| percent of the operations
+  // completed, or zero if there are no operations.
+  base::TimeDelta GetPercentile(double percentile) const;
+
+ private:
+  // Sorted on demand.
+  mutable std::vector<base::TimeDelta> latencies_;
+  mutable bool sorted_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyStats);
+};
+
+// Replays a log of operations against a cache, and measures how long each
+// operation takes. The operations of each entry are issued in the order of the
+// log, one at a time, while the ones of different entries overlap like the
+// requests of a browser do.
+//
+// Reads, writes and closes of an entry that is not open are skipped. That is
+// the case when the log starts in the middle of the use of the entry, or when
+// the entry could not be opened by the replay.
+class CacheReplayer {
+ public:
+  // With |real_time|, each operation is issued at its time in the log instead
+  // of as soon as possible.
+  CacheReplayer(Backend* cache, const ReplayLog& log, bool real_time);
+  ~CacheReplayer();
+
+  // Replays the whole log on the current message loop, and returns when all
+  // the operations are done.
+  void Run();
+
+  const LatencyStats& latencies(ReplayOperation::Type type) const {
+    return latencies_[type];
+  }
+
+  // The number of operations that failed, including cache misses.
+  int failures() const { return failures_; }
+
+  // The number of operations that were not issued.
+  int skipped() const { return skipped_; }
+
+  base::TimeDelta elapsed_time() const { return elapsed_time_; }
+
+ private:
+  // The replay state of one entry.
+  struct EntryState {
+    EntryState();
+    ~EntryState();
+
+    Entry* entry;  // The open entry, if any.
+    Entry* pending_entry;  // The result of an open or a create.
+    bool busy;
+    std::deque<size_t> waiting;  // The operations that follow the busy one.
+  };
+
+  // Issues the operations that are due.
+  void IssueOperations();
+  void OnTimer();
+
+  // Starts the operation |index| of the log, or queues it behind the ones of
+  // the same entry.
+  void Dispatch(size_t index);
+  void Start(size_t index);
+  int Issue(size_t index);
+  void OnIOComplete(size_t index, int result);
+
+  // Accounts for the end of the operation |index|. Returns true and sets
+  // |next| if another operation of the same entry is waiting.
+  bool Finish(size_t index, int result, size_t* next);
+
+  Backend* cache_;
+  const ReplayLog& log_;
+  bool real_time_;
+  std::map<std::string, EntryState> entries_;
+  std::vector<base::TimeTicks> start_times_;
+  scoped_refptr<net::IOBuffer> write_buffer_;
+  base::TimeTicks replay_start_;
+  base::TimeDelta elapsed_time_;
+  base::OneShotTimer<CacheReplayer> timer_;
+  size_t next_;  // The next operation of the log to dispatch.
+  int in_flight_;
+  bool waiting_;  // For all the operations to complete.
+  int failures_;
+  int skipped_;
+  LatencyStats latencies_[ReplayOperation::TYPE_MAX];
+
+  DISALLOW_COPY_AND_ASSIGN(CacheReplayer);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_TOOLS_CACHE_REPLAY_CACHE_REPLAYER_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/cache_replay/cache_replayer.h"
+
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/mem_backend_impl.h"
+#include "net/tools/cache_replay/replay_log.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+namespace {
+
+const char kLog[] =
+    "# time operation key stream offset length\n"
+    "0 create 1a2b3c4d\n"
+    "10 write 1a2b3c4d 0 0 200\n"
+    "20 write 1a2b3c4d 1 0 3000\n"
+    "\n"
+    "30 close 1a2b3c4d\n"
+    "40 open 1a2b3c4d\n"
+    "50 open 9f8e7d6c\n"
+    "60 read 1a2b3c4d 1 1000 500\n"
+    "70 read 9f8e7d6c 1 0 500\n"
+    "2000 doom 1a2b3c4d\n";
+
+}  // namespace
+
+TEST(ReplayLogTest, Parse) {
+  ReplayLog log;
+  int error_line = 0;
+  ASSERT_TRUE(ParseReplayLog(kLog, &log, &error_line));
+  ASSERT_EQ(9U, log.size());
+
+  EXPECT_EQ(ReplayOperation::CREATE, log[0].type);
+  EXPECT_EQ("1a2b3c4d", log[0].key);
+  EXPECT_EQ(ReplayOperation::WRITE, log[2].type);
+  EXPECT_EQ(20, log[2].time.InMicroseconds());
+  EXPECT_EQ(1, log[2].index);
+  EXPECT_EQ(0, log[2].offset);
+  EXPECT_EQ(3000, log[2].length);
+  EXPECT_EQ(ReplayOperation::DOOM, log[8].type);
+  EXPECT_EQ(2000, log[8].time.InMicroseconds());
+
+  EXPECT_EQ("20 write 1a2b3c4d 1 0 3000", FormatReplayOperation(log[2]));
+  EXPECT_EQ("30 close 1a2b3c4d", FormatReplayOperation(log[3]));
+}
+
+TEST(ReplayLogTest, ParseErrors) {
+  const char* const kBadLogs[] = {
+    "0 create\n",
+    "0 rename 1a2b3c4d\n",
+    "-1 create 1a2b3c4d\n",
+    "0 read 1a2b3c4d 1 0\n",
+    "0 read 1a2b3c4d 1 0 -5\n",
+    "0 close 1a2b3c4d 1 0 5\n",
+    "foo create 1a2b3c4d\n",
+  };
+  for (size_t i = 0; i < arraysize(kBadLogs); i++) {
+    ReplayLog log;
+    int error_line = 0;
+    EXPECT_FALSE(ParseReplayLog(kBadLogs[i], &log, &error_line)) << i;
+    EXPECT_EQ(1, error_line) << i;
+  }
+
+  // Going back in time.
+  ReplayLog log;
+  int error_line = 0;
+  EXPECT_FALSE(ParseReplayLog("# comment\n10 create a\n5 close a\n", &log,
+                              &error_line));
+  EXPECT_EQ(3, error_line);
+}
+
+TEST(LatencyStatsTest, Percentiles) {
+  LatencyStats stats;
+  EXPECT_EQ(0, stats.GetPercentile(50).InMicroseconds());
+
+  for (int i = 100; i > 0; i--)
+    stats.Add(base::TimeDelta::FromMicroseconds(i));
+  EXPECT_EQ(100U, stats.count());
+  EXPECT_EQ(1, stats.GetPercentile(0).InMicroseconds());
+  EXPECT_EQ(51, stats.GetPercentile(50).InMicroseconds());
+  EXPECT_EQ(100, stats.GetPercentile(99).InMicroseconds());
+  EXPECT_EQ(100, stats.GetPercentile(100).InMicroseconds());
+}
+
+TEST(CacheReplayerTest, Replay) {
+  MessageLoop message_loop;
+  scoped_ptr<Backend> cache(MemBackendImpl::CreateBackend(1024 * 1024, NULL));
+  ASSERT_TRUE(cache.get());
+
+  ReplayLog log;
+  int error_line;
+  ASSERT_TRUE(ParseReplayLog(kLog, &log, &error_line));
+  CacheReplayer replayer(cache.get(), log, false);
+  replayer.Run();
+
+  EXPECT_EQ(1U, replayer.latencies(ReplayOperation::CREATE).count());
+  EXPECT_EQ(2U, replayer.latencies(ReplayOperation::WRITE).count());
+  EXPECT_EQ(2U, replayer.latencies(ReplayOperation::OPEN).count());
+  EXPECT_EQ(1U, replayer.latencies(ReplayOperation::DOOM).count());
+
+  // The second entry does not exist, so it cannot be opened or read.
+  EXPECT_EQ(1, replayer.failures());
+  EXPECT_EQ(1, replayer.skipped());
+  EXPECT_EQ(1U, replayer.latencies(ReplayOperation::READ).count());
+  EXPECT_EQ(0, cache->GetEntryCount());
+}
+
+TEST(CacheReplayerTest, RealTime) {
+  MessageLoop message_loop;
+  scoped_ptr<Backend> cache(MemBackendImpl::CreateBackend(1024 * 1024, NULL));
+  ASSERT_TRUE(cache.get());
+
+  ReplayLog log;
+  int error_line;
+  ASSERT_TRUE(ParseReplayLog("0 create a\n20000 close a\n", &log,
+                             &error_line));
+  CacheReplayer replayer(cache.get(), log, true);
+  replayer.Run();
+
+  EXPECT_EQ(0, replayer.failures());
+  EXPECT_EQ(1U, replayer.latencies(ReplayOperation::CLOSE).count());
+  EXPECT_LE(20, replayer.elapsed_time().InMilliseconds());
+  EXPECT_EQ(1, cache->GetEntryCount());
+}
+
+}  // namespace disk_cache
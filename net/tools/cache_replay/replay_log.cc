@@ -0,0 +1,108 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/cache_replay/replay_log.h"
+
+#include "base/basictypes.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/string_split.h"
+#include "base/stringprintf.h"
+
+namespace {
+
+const char* const kOperationNames[] = {
+  "open",
+  "create",
+  "close",
+  "doom",
+  "read",
+  "write",
+};
+COMPILE_ASSERT(arraysize(kOperationNames) ==
+                   disk_cache::ReplayOperation::TYPE_MAX,
+               bad_operation_names);
+
+bool ParseOperation(const std::vector<std::string>& tokens,
+                    disk_cache::ReplayOperation* operation) {
+  if (tokens.size() < 3)
+    return false;
+
+  int64 time;
+  if (!base::StringToInt64(tokens[0], &time) || time < 0)
+    return false;
+  operation->time = base::TimeDelta::FromMicroseconds(time);
+
+  int type = 0;
+  while (type < disk_cache::ReplayOperation::TYPE_MAX &&
+         tokens[1] != kOperationNames[type]) {
+    type++;
+  }
+  if (type == disk_cache::ReplayOperation::TYPE_MAX)
+    return false;
+  operation->type = static_cast<disk_cache::ReplayOperation::Type>(type);
+  operation->key = tokens[2];
+
+  if (operation->type != disk_cache::ReplayOperation::READ &&
+      operation->type != disk_cache::ReplayOperation::WRITE) {
+    return tokens.size() == 3;
+  }
+
+  return tokens.size() == 6 &&
+         base::StringToInt(tokens[3], &operation->index) &&
+         base::StringToInt(tokens[4], &operation->offset) &&
+         base::StringToInt(tokens[5], &operation->length) &&
+         operation->index >= 0 && operation->offset >= 0 &&
+         operation->length >= 0;
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+ReplayOperation::ReplayOperation()
+    : type(OPEN), index(0), offset(0), length(0) {
+}
+
+const char* GetReplayOperationName(ReplayOperation::Type type) {
+  DCHECK_GE(type, 0);
+  DCHECK_LT(type, ReplayOperation::TYPE_MAX);
+  return kOperationNames[type];
+}
+
+bool ParseReplayLog(const std::string& contents, ReplayLog* log,
+                    int* error_line) {
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::vector<std::string> tokens;
+    base::SplitStringAlongWhitespace(lines[i], &tokens);
+    if (tokens.empty() || tokens[0][0] == '#')
+      continue;
+
+    ReplayOperation operation;
+    if (!ParseOperation(tokens, &operation) ||
+        (!log->empty() && operation.time < log->back().time)) {
+      *error_line = static_cast<int>(i) + 1;
+      return false;
+    }
+    log->push_back(operation);
+  }
+  return true;
+}
+
+std::string FormatReplayOperation(const ReplayOperation& operation) {
+  std::string line = base::StringPrintf(
+      "%s %s %s", base::Int64ToString(operation.time.InMicroseconds()).c_str(),
+      GetReplayOperationName(operation.type), operation.key.c_str());
+  if (operation.type == ReplayOperation::READ ||
+      operation.type == ReplayOperation::WRITE) {
+    base::StringAppendF(&line, " %d %d %d", operation.index, operation.offset,
+                        operation.length);
+  }
+  return line;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,64 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The log of cache operations replayed by cache_replay. It is a text file
+// with one operation per line:
+//
+//   <time> <operation> <key> [<stream> <offset> <length>]
+//
+// where <time> is the number of microseconds since the start of the trace,
+// <operation> is one of "open", "create", "close", "doom", "read" or "write",
+// and <key> identifies the entry, usually with a hash of the real key. Only
+// reads and writes have a stream, an offset and a length. Empty lines and
+// lines that start with '#' are ignored.
+
+#ifndef NET_TOOLS_CACHE_REPLAY_REPLAY_LOG_H_
+#define NET_TOOLS_CACHE_REPLAY_REPLAY_LOG_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/time.h"
+
+namespace disk_cache {
+
+struct ReplayOperation {
+  enum Type {
+    OPEN,
+    CREATE,
+    CLOSE,
+    DOOM,
+    READ,
+    WRITE,
+    TYPE_MAX
+  };
+
+  ReplayOperation();
+
+  base::TimeDelta time;  // Since the start of the trace.
+  Type type;
+  std::string key;
+  int index;
+  int offset;
+  int length;
+};
+
+typedef std::vector<ReplayOperation> ReplayLog;
+
+// Returns the name of |type| in the log.
+const char* GetReplayOperationName(ReplayOperation::Type type);
+
+// Parses the contents of a log into |log|. Returns false and sets |error_line|
+// to the number of the first bad line (starting at 1) if the log is invalid,
+// which includes going back in time.
+bool ParseReplayLog(const std::string& contents, ReplayLog* log,
+                    int* error_line);
+
+// Returns the line of the log for |operation|, without the line break.
+std::string FormatReplayOperation(const ReplayOperation& operation);
+
+}  // namespace disk_cache
+
+#endif  // NET_TOOLS_CACHE_REPLAY_REPLAY_LOG_H_
@@ -0,0 +1,436 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A load generator for HTTP and SPDY servers, such as flip_server. It keeps
+// a fixed number of requests in flight through an HttpNetworkSession, and
+// reports their latency and the resulting throughput.
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/format_macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/metrics/histogram.h"
+#include "base/string_number_conversions.h"
+#include "base/time.h"
+#include "googleurl/src/gurl.h"
+#include "net/base/cert_verifier.h"
+#include "net/base/host_resolver.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/ssl_config_service_defaults.h"
+#include "net/http/http_auth_handler_factory.h"
+#include "net/http/http_network_layer.h"
+#include "net/http/http_network_session.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_response_headers.h"
+#include "net/http/http_response_info.h"
+#include "net/http/http_server_properties_impl.h"
+#include "net/http/http_stream_factory.h"
+#include "net/http/http_transaction.h"
+#include "net/proxy/proxy_service.h"
+#include "net/socket/client_socket_pool_manager.h"
+#include "net/socket/ssl_client_socket.h"
+#include "net/socket/transport_client_socket_pool.h"
+#include "net/spdy/spdy_session.h"
+
+namespace {
+
+const char kUsage[] =
+    "usage: %s --url=<url> [--protocol=http|pipelining|spdy2|spdy3]\n"
+    "    [--connections=<n>] [--streams=<m>] [--requests=<count>]\n"
+    "    [--histogram]\n"
+    "\n"
+    "  --protocol     How requests are sent. Defaults to http, which is\n"
+    "                 HTTP/1.1 with one request per connection at a time.\n"
+    "                 The SPDY protocols are spoken over TCP for http URLs\n"
+    "                 and over SSL for https URLs, without negotiation.\n"
+    "  --connections  The most connections opened to the server (6).\n"
+    "                 SPDY multiplexes all streams over one connection.\n"
+    "  --streams      The number of requests kept in flight (connections).\n"
+    "  --requests     The number of requests sent in all (1000).\n"
+    "  --histogram    Prints the latency histograms as well.\n";
+
+const int kBufferSize = 32 * 1024;
+
+// Latencies are recorded in microseconds, as requests to a server on the
+// local machine often complete in less than a millisecond.
+const int kMinLatencyUs = 10;
+const int kMaxLatencyUs = 60 * 1000 * 1000;
+const size_t kLatencyBuckets = 100;
+
+void Usage(const char* program_name) {
+  printf(kUsage, program_name);
+  exit(1);
+}
+
+int GetIntSwitch(const CommandLine& command_line,
+                 const char* name,
+                 int default_value) {
+  if (!command_line.HasSwitch(name))
+    return default_value;
+  int value;
+  if (!base::StringToInt(command_line.GetSwitchValueASCII(name), &value) ||
+      value <= 0) {
+    fprintf(stderr, "Invalid --%s\n", name);
+    exit(1);
+  }
+  return value;
+}
+
+// Latency samples of one kind, kept both in a histogram and in full so that
+// exact percentiles can be reported.
+class LatencyStats {
+ public:
+  explicit LatencyStats(const std::string& name)
+      : histogram_(base::Histogram::FactoryGet(
+            name, kMinLatencyUs, kMaxLatencyUs, kLatencyBuckets,
+            base::Histogram::kNoFlags)) {
+  }
+
+  void Add(base::TimeDelta latency) {
+    int64 us = latency.InMicroseconds();
+    histogram_->Add(static_cast<int>(std::min<int64>(us, kint32max)));
+    samples_.push_back(us);
+  }
+
+  void Print(const char* label, bool print_histogram) {
+    if (samples_.empty())
+      return;
+    std::sort(samples_.begin(), samples_.end());
+    printf("%-14s: min %.3fms  p50 %.3fms  p90 %.3fms  p99 %.3fms"
+           "  max %.3fms\n", label,
+           samples_.front() / 1000.0, Percentile(50) / 1000.0,
+           Percentile(90) / 1000.0, Percentile(99) / 1000.0,
+           samples_.back() / 1000.0);
+    if (print_histogram) {
+      std::string graph;
+      histogram_->WriteAscii(true, "\n", &graph);
+      printf("%s\n", graph.c_str());
+    }
+  }
+
+ private:
+  // |samples_| must be sorted.
+  int64 Percentile(int percentile) const {
+    size_t index = (samples_.size() - 1) * percentile / 100;
+    return samples_[index];
+  }
+
+  base::Histogram* histogram_;
+  std::vector<int64> samples_;
+};
+
+class LoadDriver;
+
+// Sends requests one after the other, for as long as the LoadDriver has any
+// left to send.
+class Requester {
+ public:
+  Requester(LoadDriver* driver, net::HttpTransactionFactory* factory,
+            const GURL& url);
+
+  void Start();
+
+ private:
+  void OnStartComplete(int result);
+  void ReadBody();
+  void OnReadComplete(int result);
+  void OnRequestComplete(int result);
+
+  LoadDriver* const driver_;
+  net::HttpTransactionFactory* const factory_;
+  net::HttpRequestInfo request_info_;
+  scoped_ptr<net::HttpTransaction> transaction_;
+  scoped_refptr<net::IOBuffer> buffer_;
+  base::TimeTicks start_time_;
+  int64 bytes_read_;
+
+  DISALLOW_COPY_AND_ASSIGN(Requester);
+};
+
+// Hands out the requests to send, and collects the statistics of the ones
+// that completed.
+class LoadDriver {
+ public:
+  LoadDriver(net::HttpTransactionFactory* factory,
+             const GURL& url,
+             int num_streams,
+             int num_requests)
+      : requests_left_(num_requests),
+        streams_running_(0),
+        completed_(0),
+        bytes_read_(0),
+        spdy_responses_(0),
+        non_2xx_responses_(0),
+        headers_latency_("LoadClient.TimeToHeaders"),
+        total_latency_("LoadClient.TotalTime") {
+    for (int i = 0; i < num_streams; ++i)
+      requesters_.push_back(new Requester(this, factory, url));
+  }
+
+  // Runs the message loop until all the requests completed.
+  void Run() {
+    start_time_ = base::TimeTicks::Now();
+    for (size_t i = 0; i < requesters_.size(); ++i) {
+      ++streams_running_;
+      MessageLoop::current()->PostTask(
+          FROM_HERE,
+          base::Bind(&Requester::Start, base::Unretained(requesters_[i])));
+    }
+    MessageLoop::current()->Run();
+    elapsed_ = base::TimeTicks::Now() - start_time_;
+    // Let the last transactions go.
+    MessageLoop::current()->RunAllPending();
+  }
+
+  // Returns false if there are no more requests to send, in which case the
+  // calling Requester is done.
+  bool TakeRequest() {
+    if (requests_left_ == 0) {
+      if (--streams_running_ == 0)
+        MessageLoop::current()->Quit();
+      return false;
+    }
+    --requests_left_;
+    return true;
+  }
+
+  void RecordHeaders(base::TimeDelta latency,
+                     const net::HttpResponseInfo& response_info) {
+    headers_latency_.Add(latency);
+    if (response_info.was_fetched_via_spdy)
+      ++spdy_responses_;
+    if (response_info.headers &&
+        response_info.headers->response_code() / 100 != 2) {
+      ++non_2xx_responses_;
+    }
+  }
+
+  void RecordCompletion(base::TimeDelta latency, int64 bytes_read) {
+    total_latency_.Add(latency);
+    bytes_read_ += bytes_read;
+    ++completed_;
+  }
+
+  void RecordError(int error) {
+    ++errors_[error];
+  }
+
+  void PrintResults(bool print_histograms) {
+    double seconds = elapsed_.InSecondsF();
+    printf("Requests      : %d completed", completed_);
+    for (std::map<int, int>::const_iterator it = errors_.begin();
+         it != errors_.end(); ++it) {
+      printf(", %d %s", it->second, net::ErrorToString(it->first));
+    }
+    printf("\n");
+    printf("Responses     : %d over SPDY, %d not 2xx\n", spdy_responses_,
+           non_2xx_responses_);
+    printf("Time          : %.3fs\n", seconds);
+    printf("Bytes read    : %" PRId64 "\n", bytes_read_);
+    if (seconds > 0) {
+      printf("Throughput    : %.1f requests/s, %.2f MB/s\n",
+             completed_ / seconds, bytes_read_ / seconds / (1024 * 1024));
+    }
+    headers_latency_.Print("Time to headers", print_histograms);
+    total_latency_.Print("Total time", print_histograms);
+  }
+
+ private:
+  ScopedVector<Requester> requesters_;
+  int requests_left_;
+  int streams_running_;
+
+  base::TimeTicks start_time_;
+  base::TimeDelta elapsed_;
+  int completed_;
+  int64 bytes_read_;
+  int spdy_responses_;
+  int non_2xx_responses_;
+  // Number of failed requests, by error.
+  std::map<int, int> errors_;
+  LatencyStats headers_latency_;
+  LatencyStats total_latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadDriver);
+};
+
+Requester::Requester(LoadDriver* driver,
+                     net::HttpTransactionFactory* factory,
+                     const GURL& url)
+    : driver_(driver),
+      factory_(factory),
+      buffer_(new net::IOBuffer(kBufferSize)),
+      bytes_read_(0) {
+  request_info_.url = url;
+  request_info_.method = "GET";
+}
+
+void Requester::Start() {
+  if (!driver_->TakeRequest())
+    return;
+  int rv = factory_->CreateTransaction(&transaction_);
+  DCHECK_EQ(net::OK, rv);
+  start_time_ = base::TimeTicks::Now();
+  bytes_read_ = 0;
+  rv = transaction_->Start(
+      &request_info_,
+      base::Bind(&Requester::OnStartComplete, base::Unretained(this)),
+      net::BoundNetLog());
+  if (rv != net::ERR_IO_PENDING)
+    OnStartComplete(rv);
+}
+
+void Requester::OnStartComplete(int result) {
+  if (result != net::OK) {
+    OnRequestComplete(result);
+    return;
+  }
+  driver_->RecordHeaders(base::TimeTicks::Now() - start_time_,
+                         *transaction_->GetResponseInfo());
+  ReadBody();
+}
+
+void Requester::ReadBody() {
+  int rv;
+  do {
+    rv = transaction_->Read(
+        buffer_.get(), kBufferSize,
+        base::Bind(&Requester::OnReadComplete, base::Unretained(this)));
+    if (rv > 0)
+      bytes_read_ += rv;
+  } while (rv > 0);
+  if (rv != net::ERR_IO_PENDING)
+    OnRequestComplete(rv);
+}
+
+void Requester::OnReadComplete(int result) {
+  if (result <= 0) {
+    OnRequestComplete(result);
+    return;
+  }
+  bytes_read_ += result;
+  ReadBody();
+}
+
+void Requester::OnRequestComplete(int result) {
+  if (result == net::OK)
+    driver_->RecordCompletion(base::TimeTicks::Now() - start_time_,
+                              bytes_read_);
+  else
+    driver_->RecordError(result);
+
+  // The transaction may still be on the stack, so it is only released, and
+  // the next request started, once this one has unwound.
+  MessageLoop::current()->DeleteSoon(FROM_HERE, transaction_.release());
+  MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&Requester::Start, base::Unretained(this)));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  base::AtExitManager exit_manager;
+  base::StatisticsRecorder statistics_recorder;
+
+  CommandLine::Init(argc, argv);
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+  GURL url(command_line.GetSwitchValueASCII("url"));
+  if (!url.is_valid() || !(url.SchemeIs("http") || url.SchemeIs("https")))
+    Usage(argv[0]);
+
+  int num_connections = GetIntSwitch(command_line, "connections", 6);
+  int num_streams = GetIntSwitch(command_line, "streams", num_connections);
+  int num_requests = GetIntSwitch(command_line, "requests", 1000);
+
+  std::string protocol = command_line.GetSwitchValueASCII("protocol");
+  bool use_pipelining = false;
+  if (protocol.empty() || protocol == "http") {
+    net::HttpStreamFactory::set_spdy_enabled(false);
+  } else if (protocol == "pipelining") {
+    net::HttpStreamFactory::set_spdy_enabled(false);
+    net::HttpStreamFactory::set_http_pipelining_enabled(true);
+    use_pipelining = true;
+  } else if (protocol == "spdy2" || protocol == "spdy3") {
+    net::HttpNetworkLayer::EnableSpdy(url.SchemeIsSecure() ? "ssl" : "no-ssl");
+    if (protocol == "spdy3") {
+      net::HttpStreamFactory::EnableSPDY3();
+      net::SpdySession::set_default_protocol(
+          net::SSLClientSocket::kProtoSPDY3);
+    }
+    // Load tests are usually run against servers with test certificates.
+    net::HttpStreamFactory::set_ignore_certificate_errors(true);
+  } else {
+    Usage(argv[0]);
+  }
+
+  // The socket pools are created with the session, so they have to be sized
+  // before.
+  net::ClientSocketPoolManager::set_max_sockets_per_group(
+      net::HttpNetworkSession::NORMAL_SOCKET_POOL, num_connections);
+  net::ClientSocketPoolManager::set_max_sockets_per_pool(
+      net::HttpNetworkSession::NORMAL_SOCKET_POOL,
+      std::max(num_connections,
+               net::ClientSocketPoolManager::max_sockets_per_pool(
+                   net::HttpNetworkSession::NORMAL_SOCKET_POOL)));
+  net::ClientSocketPoolManager::set_max_sockets_per_proxy_server(
+      net::HttpNetworkSession::NORMAL_SOCKET_POOL,
+      std::max(num_connections,
+               net::ClientSocketPoolManager::max_sockets_per_proxy_server(
+                   net::HttpNetworkSession::NORMAL_SOCKET_POOL)));
+
+  MessageLoop loop(MessageLoop::TYPE_IO);
+
+  scoped_ptr<net::HostResolver> host_resolver(
+      net::CreateSystemHostResolver(net::HostResolver::kDefaultParallelism,
+                                    net::HostResolver::kDefaultRetryAttempts,
+                                    NULL));
+  scoped_ptr<net::CertVerifier> cert_verifier(
+      net::CertVerifier::CreateDefault());
+  scoped_ptr<net::ProxyService> proxy_service(
+      net::ProxyService::CreateDirect());
+  scoped_refptr<net::SSLConfigService> ssl_config_service(
+      new net::SSLConfigServiceDefaults);
+  scoped_ptr<net::HttpAuthHandlerFactory> http_auth_handler_factory(
+      net::HttpAuthHandlerFactory::CreateDefault(host_resolver.get()));
+  net::HttpServerPropertiesImpl http_server_properties;
+
+  net::HttpNetworkSession::Params session_params;
+  session_params.host_resolver = host_resolver.get();
+  session_params.cert_verifier = cert_verifier.get();
+  session_params.proxy_service = proxy_service.get();
+  session_params.http_auth_handler_factory = http_auth_handler_factory.get();
+  session_params.http_server_properties = &http_server_properties;
+  session_params.ssl_config_service = ssl_config_service;
+  // Don't wait for the server to be found capable of pipelining first.
+  session_params.force_http_pipelining = use_pipelining;
+
+  scoped_refptr<net::HttpNetworkSession> network_session(
+      new net::HttpNetworkSession(session_params));
+  scoped_ptr<net::HttpTransactionFactory> factory(
+      new net::HttpNetworkLayer(network_session));
+
+  printf("Sending %d requests for %s, %d at a time over at most %d "
+         "connections (%s)\n", num_requests, url.spec().c_str(), num_streams,
+         num_connections, protocol.empty() ? "http" : protocol.c_str());
+
+  LoadDriver driver(factory.get(), url, num_streams, num_requests);
+  driver.Run();
+  driver.PrintResults(command_line.HasSwitch("histogram"));
+  printf("Idle sockets  : %d\n",
+         network_session->GetTransportSocketPool(
+             net::HttpNetworkSession::NORMAL_SOCKET_POOL)->IdleSocketCount());
+  return 0;
+}
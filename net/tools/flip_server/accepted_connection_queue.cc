@@ -0,0 +1,47 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/tools/flip_server/accepted_connection_queue.h"
+
+#include <unistd.h>
+
+namespace net {
+
+AcceptedConnectionQueue::AcceptedConnectionQueue() : head_(0), tail_(0) {
+}
+
+AcceptedConnectionQueue::~AcceptedConnectionQueue() {
+  Entry entry;
+  while (Pop(&entry))
+    close(entry.fd);
+}
+
+bool AcceptedConnectionQueue::Push(int fd,
+                                   const struct sockaddr_in& remote_addr) {
+  uint32 tail = base::subtle::NoBarrier_Load(&tail_);
+  uint32 head = base::subtle::Acquire_Load(&head_);
+  if (tail - head == kCapacity)
+    return false;
+  Entry& entry = entries_[tail % kCapacity];
+  entry.fd = fd;
+  entry.remote_addr = remote_addr;
+  // Publishes the entry to the consumer.
+  base::subtle::Release_Store(&tail_,
+                              static_cast<base::subtle::Atomic32>(tail + 1));
+  return true;
+}
+
+bool AcceptedConnectionQueue::Pop(Entry* entry) {
+  uint32 head = base::subtle::NoBarrier_Load(&head_);
+  uint32 tail = base::subtle::Acquire_Load(&tail_);
+  if (head == tail)
+    return false;
+  *entry = entries_[head % kCapacity];
+  // Hands the slot back to the producer.
+  base::subtle::Release_Store(&head_,
+                              static_cast<base::subtle::Atomic32>(head + 1));
+  return true;
+}
+
+}  // namespace net
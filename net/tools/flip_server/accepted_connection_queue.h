@@ -0,0 +1,53 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_TOOLS_FLIP_SERVER_ACCEPTED_CONNECTION_QUEUE_H_
+#define NET_TOOLS_FLIP_SERVER_ACCEPTED_CONNECTION_QUEUE_H_
+#pragma once
+
+#include <netinet/in.h>
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+
+namespace net {
+
+// A fixed size queue that hands accepted sockets from the thread that accepts
+// them to the thread that serves them. There is exactly one producer and one
+// consumer, so instead of taking a lock the two publish their ends of the
+// queue to each other with acquire/release stores.
+class AcceptedConnectionQueue {
+ public:
+  struct Entry {
+    int fd;
+    struct sockaddr_in remote_addr;
+  };
+
+  AcceptedConnectionQueue();
+  // Closes the sockets that were never popped.
+  ~AcceptedConnectionQueue();
+
+  // Called on the producer thread. Returns false if the queue is full, in
+  // which case the caller still owns |fd|.
+  bool Push(int fd, const struct sockaddr_in& remote_addr);
+
+  // Called on the consumer thread. Returns false if the queue is empty.
+  bool Pop(Entry* entry);
+
+ private:
+  // Must be a power of two.
+  enum { kCapacity = 1024 };
+
+  // Both indices only ever grow; they are reduced modulo kCapacity when the
+  // entries are accessed.
+  base::subtle::Atomic32 head_;  // Next entry to pop. Written by the consumer.
+  base::subtle::Atomic32 tail_;  // Next entry to push. Written by the producer.
+  Entry entries_[kCapacity];
+
+  DISALLOW_COPY_AND_ASSIGN(AcceptedConnectionQueue);
+};
+
+}  // namespace net
+
+#endif  // NET_TOOLS_FLIP_SERVER_ACCEPTED_CONNECTION_QUEUE_H_
@@ -28,7 +28,9 @@ SMAcceptorThread::SMAcceptorThread(FlipAcceptor *acceptor,
       use_ssl_(false),
       idle_socket_timeout_s_(acceptor->idle_socket_timeout_s_),
       quitting_(false),
-      memory_cache_(memory_cache) {
+      memory_cache_(memory_cache),
+      oldest_idle_time_(time(NULL)),
+      next_worker_(0) {
   if (!acceptor->ssl_cert_filename_.empty() &&
       !acceptor->ssl_key_filename_.empty()) {
     ssl_state_ = new SSLState;
@@ -80,6 +82,33 @@ void SMAcceptorThread::InitWorker() {
   epoll_server_.RegisterFD(acceptor_->listen_fd_, this, EPOLLIN | EPOLLET);
 }
 
+void SMAcceptorThread::AddWorker(SMAcceptorThread* worker) {
+  DCHECK_NE(this, worker);
+  workers_.push_back(worker);
+}
+
+void SMAcceptorThread::DispatchConnection(int fd,
+                                          struct sockaddr_in* remote_addr) {
+  size_t worker = next_worker_;
+  next_worker_ = (next_worker_ + 1) % (workers_.size() + 1);
+  if (worker > 0) {
+    SMAcceptorThread* thread = workers_[worker - 1];
+    if (thread->handoff_queue_.Push(fd, *remote_addr)) {
+      thread->epoll_server_.Wake();
+      return;
+    }
+    // The worker is too far behind; serve the connection here instead.
+    VLOG(1) << ACCEPTOR_CLIENT_IDENT << "Acceptor: Worker queue full.";
+  }
+  HandleConnection(fd, remote_addr);
+}
+
+void SMAcceptorThread::HandleQueuedConnections() {
+  AcceptedConnectionQueue::Entry entry;
+  while (handoff_queue_.Pop(&entry))
+    HandleConnection(entry.fd, &entry.remote_addr);
+}
+
 void SMAcceptorThread::HandleConnection(int server_fd,
                                         struct sockaddr_in *remote_addr) {
   int on = 1;
@@ -126,7 +155,7 @@ void SMAcceptorThread::AcceptFromListenFD() {
         break;
       }
       VLOG(1) << ACCEPTOR_CLIENT_IDENT << " Accepted connection";
-      HandleConnection(fd, (struct sockaddr_in *)&address);
+      DispatchConnection(fd, (struct sockaddr_in *)&address);
     }
   } else {
     while (true) {
@@ -142,18 +171,16 @@ void SMAcceptorThread::AcceptFromListenFD() {
         break;
       }
       VLOG(1) << ACCEPTOR_CLIENT_IDENT << "Accepted connection";
-      HandleConnection(fd, (struct sockaddr_in *)&address);
+      DispatchConnection(fd, (struct sockaddr_in *)&address);
     }
   }
 }
 
 void SMAcceptorThread::HandleConnectionIdleTimeout() {
-  static time_t oldest_time = time(NULL);
-
   int cur_time = time(NULL);
   // Only iterate the list if we speculate that a connection is ready to be
   // expired
-  if ((cur_time - oldest_time) < idle_socket_timeout_s_)
+  if ((cur_time - oldest_idle_time_) < idle_socket_timeout_s_)
     return;
 
   // TODO(mbelshe): This code could be optimized, active_server_connections_
@@ -167,18 +194,19 @@ void SMAcceptorThread::HandleConnectionIdleTimeout() {
       iter = active_server_connections_.erase(iter);
       continue;
     }
-    if (conn->last_read_time_ < oldest_time)
-      oldest_time = conn->last_read_time_;
+    if (conn->last_read_time_ < oldest_idle_time_)
+      oldest_idle_time_ = conn->last_read_time_;
     iter++;
   }
-  if ((cur_time - oldest_time) >= idle_socket_timeout_s_)
-    oldest_time = cur_time;
+  if ((cur_time - oldest_idle_time_) >= idle_socket_timeout_s_)
+    oldest_idle_time_ = cur_time;
 }
 
 void SMAcceptorThread::Run() {
   while (!quitting_.HasBeenNotified()) {
     epoll_server_.set_timeout_in_us(10 * 1000);  // 10 ms
     epoll_server_.WaitForEventsAndExecuteCallbacks();
+    HandleQueuedConnections();
     if (tmp_unused_server_connections_.size()) {
       VLOG(2) << "have " << tmp_unused_server_connections_.size()
               << " additional unused connections.  Total = "
@@ -11,6 +11,7 @@
 
 #include "base/compiler_specific.h"
 #include "base/threading/simple_thread.h"
+#include "net/tools/flip_server/accepted_connection_queue.h"
 #include "net/tools/flip_server/epoll_server.h"
 #include "net/tools/flip_server/sm_interface.h"
 #include "openssl/ssl.h"
@@ -68,6 +69,13 @@ class SMAcceptorThread : public base::SimpleThread,
   void HandleConnection(int server_fd, struct sockaddr_in *remote_addr);
   void AcceptFromListenFD();
 
+  // Makes this thread share the connections it accepts with |worker|, which
+  // serves the same acceptor with an EpollServer of its own. Connections are
+  // dealt out round-robin over this thread and its workers. Workers don't
+  // listen themselves, so InitWorker() is only called on the accepting
+  // thread. Must be called before either thread is started.
+  void AddWorker(SMAcceptorThread* worker);
+
   // Notify the Accept thread that it is time to terminate.
   void Quit() { quitting_.Notify(); }
 
@@ -78,6 +86,12 @@ class SMAcceptorThread : public base::SimpleThread,
   virtual void Run() OVERRIDE;
 
  private:
+  // Serves |fd| on this thread or hands it to the next worker in turn.
+  void DispatchConnection(int fd, struct sockaddr_in* remote_addr);
+
+  // Serves the connections that other threads have handed to this one.
+  void HandleQueuedConnections();
+
   EpollServer epoll_server_;
   FlipAcceptor* acceptor_;
   SSLState* ssl_state_;
@@ -90,6 +104,14 @@ class SMAcceptorThread : public base::SimpleThread,
   std::list<SMConnection*> active_server_connections_;
   Notification quitting_;
   MemoryCache* memory_cache_;
+  time_t oldest_idle_time_;
+
+  std::vector<SMAcceptorThread*> workers_;
+  // Index of the thread to serve the next accepted connection, where 0 is
+  // this thread and i is workers_[i - 1].
+  size_t next_worker_;
+  // Connections handed to this thread by the accepting thread.
+  AcceptedConnectionQueue handoff_queue_;
 };
 
 }  // namespace net
@@ -14,6 +14,7 @@
 #include "base/command_line.h"
 #include "base/logging.h"
 #include "base/synchronization/lock.h"
+#include "base/sys_info.h"
 #include "base/timer.h"
 #include "net/tools/flip_server/acceptor_thread.h"
 #include "net/tools/flip_server/constants.h"
@@ -53,6 +54,12 @@ bool FLAGS_force_spdy = false;
 //  reply);
 double FLAGS_server_think_time_in_s = 0;
 
+// The number of threads, each with its own epoll loop, that serve the
+//  connections of each listen socket. One of them accepts the connections
+//  and deals them out to the others. If set to 0, one thread per core is
+//  used.
+int32 FLAGS_threads = 1;
+
 net::FlipConfig g_proxy_config;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -204,6 +211,12 @@ int main (int argc, char**argv)
     cout << "\t--ssl-session-expiry=<seconds> (default is 300)\n";
     cout << "\t--ssl-disable-compression\n";
     cout << "\t--idle-timeout=<seconds> (default is 300)\n";
+    cout << "\t--threads=<n> (default is 1)\n";
+    cout << "\t  * Number of epoll threads serving each listen socket. 0 runs"
+         << " one per core.\n";
+    cout << "\t--mmap-cache\n";
+    cout << "\t  * Maps the cached files into memory instead of reading"
+         << " them.\n";
     cout << "\t--pidfile=<filepath> (default /var/run/flip-server.pid)\n";
     cout << "\t--help\n";
     exit(0);
@@ -272,6 +285,11 @@ int main (int argc, char**argv)
   if (cl.HasSwitch("force_spdy"))
     net::SMConnection::set_force_spdy(true);
 
+  if (cl.HasSwitch("threads"))
+    FLAGS_threads = atoi(cl.GetSwitchValueASCII("threads").c_str());
+  if (FLAGS_threads <= 0)
+    FLAGS_threads = base::SysInfo::NumberOfProcessors();
+
   InitLogging(g_proxy_config.log_filename_.c_str(),
               g_proxy_config.log_destination_,
               logging::DONT_LOCK_LOG_FILE,
@@ -299,6 +317,7 @@ int main (int argc, char**argv)
             << g_proxy_config.ssl_disable_compression_;
   LOG(INFO) << "Connection idle timeout : "
             << g_proxy_config.idle_socket_timeout_s_;
+  LOG(INFO) << "Threads per acceptor    : " << FLAGS_threads;
 
   // Proxy Acceptors
   while (true) {
@@ -331,6 +350,7 @@ int main (int argc, char**argv)
   // Spdy Server Acceptor
   net::MemoryCache spdy_memory_cache;
   if (cl.HasSwitch("spdy-server")) {
+    spdy_memory_cache.set_map_files(cl.HasSwitch("mmap-cache"));
     spdy_memory_cache.AddFiles();
     std::string value = cl.GetSwitchValueASCII("spdy-server");
     std::vector<std::string> valueArgs = split(value, ',');
@@ -352,6 +372,7 @@ int main (int argc, char**argv)
   // Spdy Server Acceptor
   net::MemoryCache http_memory_cache;
   if (cl.HasSwitch("http-server")) {
+    http_memory_cache.set_map_files(cl.HasSwitch("mmap-cache"));
     http_memory_cache.AddFiles();
     std::string value = cl.GetSwitchValueASCII("http-server");
     std::vector<std::string> valueArgs = split(value, ',');
@@ -375,21 +396,26 @@ int main (int argc, char**argv)
   for (i = 0; i < g_proxy_config.acceptors_.size(); i++) {
     net::FlipAcceptor *acceptor = g_proxy_config.acceptors_[i];
 
-    sm_worker_threads_.push_back(
-        new net::SMAcceptorThread(acceptor,
-                                  (net::MemoryCache *)acceptor->memory_cache_));
     // Note that spdy_memory_cache is not threadsafe, it is merely
-    // thread compatible. Thus, if ever we are to spawn multiple threads,
-    // we either must make the MemoryCache threadsafe, or use
-    // a separate MemoryCache for each thread.
-    //
-    // The latter is what is currently being done as we spawn
-    // a separate thread for each http and spdy server acceptor.
-
-    sm_worker_threads_.back()->InitWorker();
-    sm_worker_threads_.back()->Start();
+    // thread compatible. It is only read once it has been loaded, though,
+    // so the threads serving one acceptor can share its MemoryCache.
+    net::SMAcceptorThread* accept_thread =
+        new net::SMAcceptorThread(acceptor,
+                                  (net::MemoryCache *)acceptor->memory_cache_);
+    accept_thread->InitWorker();
+    sm_worker_threads_.push_back(accept_thread);
+    for (int j = 1; j < FLAGS_threads; ++j) {
+      net::SMAcceptorThread* worker_thread =
+          new net::SMAcceptorThread(
+              acceptor, (net::MemoryCache *)acceptor->memory_cache_);
+      accept_thread->AddWorker(worker_thread);
+      sm_worker_threads_.push_back(worker_thread);
+    }
   }
 
+  for (i = 0; i < sm_worker_threads_.size(); i++)
+    sm_worker_threads_[i]->Start();
+
   while (!wantExit) {
     // Close logfile when HUP signal is received. Logging system will
     // automatically reopen on next log message.
@@ -317,6 +317,33 @@ void HttpSM::SendDataFrameImpl(uint32 stream_id, const char* data, int64 len,
   EnqueueDataFrame(df);
 }
 
+void HttpSM::SendCachedDataFrame(const char* data, size_t len) {
+  // The body lives in the MemoryCache for as long as the server runs, so
+  // only the chunk framing is allocated and the body itself is not copied.
+  char chunk_buf[128];
+  int chunk_len = snprintf(chunk_buf, sizeof(chunk_buf), "%x\r\n",
+                           static_cast<unsigned int>(len));
+  DataFrame* df = new DataFrame;
+  df->size = chunk_len;
+  char* buffer = new char[df->size];
+  memcpy(buffer, chunk_buf, chunk_len);
+  df->data = buffer;
+  df->delete_when_done = true;
+  EnqueueDataFrame(df);
+
+  df = new DataFrame;
+  df->data = data;
+  df->size = len;
+  df->delete_when_done = false;
+  EnqueueDataFrame(df);
+
+  df = new DataFrame;
+  df->data = "\r\n";
+  df->size = 2;
+  df->delete_when_done = false;
+  EnqueueDataFrame(df);
+}
+
 void HttpSM::EnqueueDataFrame(DataFrame* df) {
   VLOG(2) << ACCEPTOR_CLIENT_IDENT << "HttpSM: Enqueue data frame: stream "
           << stream_id_;
@@ -338,21 +365,19 @@ void HttpSM::GetOutput() {
             << "header stream_id: [" << mci->stream_id << "]";
     return;
   }
-  if (mci->body_bytes_consumed >= mci->file_data->body.size()) {
+  base::StringPiece body = mci->file_data->GetBody();
+  if (mci->body_bytes_consumed >= body.size()) {
     SendEOF(mci->stream_id);
     output_ordering_.RemoveStreamId(mci->stream_id);
     VLOG(2) << ACCEPTOR_CLIENT_IDENT << "GetOutput remove_stream_id: ["
             << mci->stream_id << "]";
     return;
   }
-  size_t num_to_write =
-    mci->file_data->body.size() - mci->body_bytes_consumed;
+  size_t num_to_write = body.size() - mci->body_bytes_consumed;
   if (num_to_write > mci->max_segment_size)
     num_to_write = mci->max_segment_size;
 
-  SendDataFrame(mci->stream_id,
-                mci->file_data->body.data() + mci->body_bytes_consumed,
-                num_to_write, 0, true);
+  SendCachedDataFrame(body.data() + mci->body_bytes_consumed, num_to_write);
   VLOG(2) << ACCEPTOR_CLIENT_IDENT << "HttpSM: GetOutput SendDataFrame["
           << mci->stream_id << "]: " << num_to_write;
   mci->body_bytes_consumed += num_to_write;
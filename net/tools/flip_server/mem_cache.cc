@@ -13,6 +13,8 @@
 
 #include <deque>
 
+#include "base/file_path.h"
+#include "base/file_util.h"
 #include "base/string_piece.h"
 #include "net/tools/dump_cache/url_to_filename_encoder.h"
 #include "net/tools/dump_cache/url_utilities.h"
@@ -24,8 +26,25 @@ std::string FLAGS_cache_base_dir = ".";
 
 namespace net {
 
+StoreBodyAndHeadersVisitor::StoreBodyAndHeadersVisitor() : error_(false) {}
+
+StoreBodyAndHeadersVisitor::~StoreBodyAndHeadersVisitor() {}
+
 void StoreBodyAndHeadersVisitor::ProcessBodyData(const char *input,
                                                  size_t size) {
+  if (body.empty()) {
+    if (!body_in_input.data()) {
+      body_in_input.set(input, size);
+      return;
+    }
+    if (input == body_in_input.data() + body_in_input.size()) {
+      body_in_input.set(body_in_input.data(), body_in_input.size() + size);
+      return;
+    }
+    // The body is chunked after all.
+    body_in_input.CopyToString(&body);
+    body_in_input.clear();
+  }
   body.append(input, size);
 }
 
@@ -58,10 +77,18 @@ void FileData::CopyFrom(const FileData& file_data) {
     headers->CopyFrom(*(file_data.headers));
     filename = file_data.filename;
     related_files = file_data.related_files;
-    body = file_data.body;
+    // The copy may outlive the mapping of |file_data|.
+    file_data.GetBody().CopyToString(&body);
+    mapped_body.clear();
   }
 
-MemoryCache::MemoryCache() {}
+base::StringPiece FileData::GetBody() const {
+  if (mapped_body.data())
+    return mapped_body;
+  return body;
+}
+
+MemoryCache::MemoryCache() : map_files_(false) {}
 
 MemoryCache::~MemoryCache() {}
 
@@ -142,19 +169,37 @@ void MemoryCache::ReadAndStoreFileContents(const char* filename) {
   BalsaFrame framer;
   framer.set_balsa_visitor(&visitor);
   framer.set_balsa_headers(&(visitor.headers));
+  linked_ptr<file_util::MemoryMappedFile> mapped_file;
   std::string filename_contents;
-  ReadToString(filename, &filename_contents);
-
-  // Ugly hack to make everything look like 1.1.
-  if (filename_contents.find("HTTP/1.0") == 0)
-    filename_contents[7] = '1';
+  base::StringPiece contents;
+  if (map_files_) {
+    mapped_file.reset(new file_util::MemoryMappedFile);
+    if (mapped_file->Initialize(FilePath(filename))) {
+      contents.set(reinterpret_cast<const char*>(mapped_file->data()),
+                   mapped_file->length());
+    } else {
+      // Empty files can't be mapped.
+      mapped_file.reset();
+    }
+  }
+  if (!mapped_file.get()) {
+    ReadToString(filename, &filename_contents);
+    contents = filename_contents;
+  }
 
   size_t pos = 0;
+  // Ugly hack to make everything look like 1.1. The contents may be mapped
+  // read-only, so the framer is fed a fixed copy of the version instead.
+  if (contents.starts_with("HTTP/1.0")) {
+    pos = framer.ProcessInput("HTTP/1.1", 8);
+    DCHECK_EQ(8u, pos);
+  }
+
   size_t old_pos = 0;
   while (true) {
     old_pos = pos;
-    pos += framer.ProcessInput(filename_contents.data() + pos,
-                               filename_contents.size() - pos);
+    pos += framer.ProcessInput(contents.data() + pos,
+                               contents.size() - pos);
     if (framer.Error() || pos == old_pos) {
       LOG(ERROR) << "Unable to make forward progress, or error"
         " framing file: " << filename;
@@ -168,8 +213,8 @@ void MemoryCache::ReadAndStoreFileContents(const char* filename) {
       // If no Content-Length or Transfer-Encoding was captured in the
       // file, then the rest of the data is the body.  Many of the captures
       // from within Chrome don't have content-lengths.
-      if (!visitor.body.length())
-        visitor.body = filename_contents.substr(pos);
+      if (!visitor.body.length() && !visitor.body_in_input.length())
+        visitor.body_in_input = contents.substr(pos);
       break;
     }
   }
@@ -194,11 +239,20 @@ void MemoryCache::ReadAndStoreFileContents(const char* filename) {
   BalsaHeaders* headers = new BalsaHeaders;
   headers->CopyFrom(visitor.headers);
   std::string filename_stripped = std::string(filename).substr(cwd_.size() + 1);
-  LOG(INFO) << "Adding file (" << visitor.body.length() << " bytes): "
-            << filename_stripped;
   files_[filename_stripped] = FileData();
   FileData& fd = files_[filename_stripped];
   fd = FileData(headers, visitor.body);
+  if (visitor.body.empty()) {
+    if (mapped_file.get()) {
+      fd.mapped_body = visitor.body_in_input;
+      mapped_files_.push_back(mapped_file);
+    } else {
+      visitor.body_in_input.CopyToString(&fd.body);
+    }
+  }
+  LOG(INFO) << "Adding file (" << fd.GetBody().length() << " bytes"
+            << (fd.mapped_body.data() ? ", mapped" : "") << "): "
+            << filename_stripped;
   fd.filename = std::string(filename_stripped,
                             filename_stripped.find_first_of('/'));
 }
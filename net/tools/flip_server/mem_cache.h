@@ -10,14 +10,23 @@
 #include <vector>
 
 #include "base/compiler_specific.h"
+#include "base/memory/linked_ptr.h"
+#include "base/string_piece.h"
 #include "net/tools/flip_server/balsa_headers.h"
 #include "net/tools/flip_server/balsa_visitor_interface.h"
 #include "net/tools/flip_server/constants.h"
 
+namespace file_util {
+class MemoryMappedFile;
+}
+
 namespace net {
 
 class StoreBodyAndHeadersVisitor: public BalsaVisitorInterface {
  public:
+  StoreBodyAndHeadersVisitor();
+  virtual ~StoreBodyAndHeadersVisitor();
+
   void HandleError() { error_ = true; }
 
   // BalsaVisitorInterface:
@@ -56,6 +65,9 @@ class StoreBodyAndHeadersVisitor: public BalsaVisitorInterface {
   virtual void HandleBodyError(BalsaFrame* framer) OVERRIDE;
 
   BalsaHeaders headers;
+  // A body that arrived in one piece is left in the framed input and only
+  // referred to by |body_in_input|. Chunked bodies are assembled in |body|.
+  base::StringPiece body_in_input;
   std::string body;
   bool error_;
 };
@@ -68,11 +80,18 @@ struct FileData {
   ~FileData();
   void CopyFrom(const FileData& file_data);
 
+  // Returns the response body: |mapped_body| if the file is mapped into
+  // memory, |body| otherwise.
+  base::StringPiece GetBody() const;
+
   BalsaHeaders* headers;
   std::string filename;
   // priority, filename
   std::vector< std::pair<int, std::string> > related_files;
   std::string body;
+  // Points into a file mapped by the MemoryCache, which keeps the mapping
+  // for as long as it lives.
+  base::StringPiece mapped_body;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -116,6 +135,10 @@ class MemoryCache {
 
   void CloneFrom(const MemoryCache& mc);
 
+  // If set, AddFiles() maps the files into memory, and bodies are served
+  // straight from the mappings instead of from copies on the heap.
+  void set_map_files(bool map_files) { map_files_ = map_files; }
+
   void AddFiles();
 
   void ReadToString(const char* filename, std::string* output);
@@ -128,6 +151,10 @@ class MemoryCache {
 
   Files files_;
   std::string cwd_;
+
+ private:
+  bool map_files_;
+  std::vector<linked_ptr<file_util::MemoryMappedFile> > mapped_files_;
 };
 
 class NotifierInterface {
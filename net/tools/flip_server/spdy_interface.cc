@@ -489,6 +489,40 @@ void SpdySM::SendDataFrameImpl(uint32 stream_id, const char* data, int64 len,
   }
 }
 
+void SpdySM::SendCachedDataFrame(uint32 stream_id,
+                                 const char* data,
+                                 size_t len) {
+  // The body lives in the MemoryCache for as long as the server runs, so
+  // only the frame headers are allocated and the body itself is not copied.
+  while (len > 0) {
+    size_t size = std::min(len, static_cast<size_t>(kSpdySegmentSize));
+
+    char* header = new char[SpdyDataFrame::size()];
+    memset(header, 0, SpdyDataFrame::size());
+    SpdyDataFrame frame(header, false);
+    frame.set_stream_id(stream_id);
+    frame.set_flags(DATA_FLAG_NONE);
+    frame.set_length(size);
+    DataFrame* df = new DataFrame;
+    df->data = header;
+    df->size = SpdyDataFrame::size();
+    df->delete_when_done = true;
+    EnqueueDataFrame(df);
+
+    df = new DataFrame;
+    df->data = data;
+    df->size = size;
+    df->delete_when_done = false;
+    EnqueueDataFrame(df);
+
+    VLOG(2) << ACCEPTOR_CLIENT_IDENT << "SpdySM: Sending cached data frame "
+            << stream_id << " [" << size << "]";
+
+    data += size;
+    len -= size;
+  }
+}
+
 void SpdySM::EnqueueDataFrame(DataFrame* df) {
   connection_->EnqueueDataFrame(df);
 }
@@ -523,30 +557,20 @@ void SpdySM::GetOutput() {
       }
       return;
     }
-    if (mci->body_bytes_consumed >= mci->file_data->body.size()) {
+    base::StringPiece body = mci->file_data->GetBody();
+    if (mci->body_bytes_consumed >= body.size()) {
       VLOG(2) << ACCEPTOR_CLIENT_IDENT << "SpdySM: GetOutput "
               << "remove_stream_id: [" << mci->stream_id << "]";
       SendEOF(mci->stream_id);
       return;
     }
-    size_t num_to_write =
-      mci->file_data->body.size() - mci->body_bytes_consumed;
+    size_t num_to_write = body.size() - mci->body_bytes_consumed;
     if (num_to_write > mci->max_segment_size)
       num_to_write = mci->max_segment_size;
 
-    bool should_compress = false;
-    if (!mci->file_data->headers->HasHeader("content-encoding")) {
-      if (mci->file_data->headers->HasHeader("content-type")) {
-        std::string content_type =
-            mci->file_data->headers->GetHeader("content-type").as_string();
-        if (content_type.find("image") == content_type.npos)
-          should_compress = true;
-      }
-    }
-
-    SendDataFrame(mci->stream_id,
-                  mci->file_data->body.data() + mci->body_bytes_consumed,
-                  num_to_write, 0, should_compress);
+    SendCachedDataFrame(mci->stream_id,
+                        body.data() + mci->body_bytes_consumed,
+                        num_to_write);
     VLOG(2) << ACCEPTOR_CLIENT_IDENT << "SpdySM: GetOutput SendDataFrame["
             << mci->stream_id << "]: " << num_to_write;
     mci->body_bytes_consumed += num_to_write;
@@ -135,6 +135,9 @@ class SpdySM : public BufferedSpdyFramerVisitorInterface,
   size_t SendSynReplyImpl(uint32 stream_id, const BalsaHeaders& headers);
   void SendDataFrameImpl(uint32 stream_id, const char* data, int64 len,
                          SpdyDataFlags flags, bool compress);
+  // Sends |len| bytes of a body held by the MemoryCache as uncompressed data
+  // frames, without copying them.
+  void SendCachedDataFrame(uint32 stream_id, const char* data, size_t len);
   void EnqueueDataFrame(DataFrame* df);
   virtual void GetOutput() OVERRIDE;
  private:
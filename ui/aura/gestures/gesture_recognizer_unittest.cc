@@ -246,8 +246,10 @@ class TestOneShotGestureSequenceTimer
     : public base::OneShotTimer<GestureSequence> {
  public:
   void ForceTimeout() {
-    if (delayed_task_)
+    if (IsRunning()) {
+      delayed_task_->Cancel();
       delayed_task_->Run();
+    }
   }
 };
 